@@ -16,6 +16,7 @@
 #include <inttypes.h>
 
 #include <kernel/interrupt.h>
+#include <kernel/percpu.h>
 #include <kernel/thread.h>
 
 #include <platform.h>
@@ -329,6 +330,13 @@ extern "C" uint32_t arm64_irq(struct arm64_iframe_short* iframe, uint exception_
 
     LTRACEF("iframe %p, flags 0x%x\n", iframe, exception_flags);
 
+    // note where we were for the sampling profiler; the short iframe does
+    // not hold x29, but the entry code leaves it untouched so it is the
+    // caller's frame pointer saved in our own frame record
+    struct percpu* cpu = get_local_percpu();
+    cpu->irq_pc = iframe->elr;
+    cpu->irq_fp = *reinterpret_cast<uintptr_t*>(__GET_FRAME(0));
+
     int_handler_saved_state_t state;
     int_handler_start(&state);
 
@@ -19,6 +19,7 @@
 #include <debug.h>
 
 #include <kernel/interrupt.h>
+#include <kernel/percpu.h>
 #include <kernel/thread.h>
 
 #include <lib/crashlog.h>
@@ -466,6 +467,14 @@ void x86_exception_handler(x86_iframe_t* frame) {
     // did we come from user or kernel space?
     bool from_user = is_from_user(frame);
 
+    // note where we were for the sampling profiler; an NMI may land in
+    // the middle of another handler, so leave its context alone
+    if (frame->vector != X86_INT_NMI) {
+        struct percpu* cpu = get_local_percpu();
+        cpu->irq_pc = frame->ip;
+        cpu->irq_fp = frame->rbp;
+    }
+
     // deliver the interrupt
     ktrace_tiny(TAG_IRQ_ENTER, ((uint32_t)frame->vector << 8) | arch_curr_cpu_num());
 
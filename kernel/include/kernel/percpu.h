@@ -39,12 +39,20 @@ struct percpu {
     // thread/cpu level statistics
     struct cpu_stats stats;
 
+    // scheduler latency histograms
+    struct cpu_sched_latency sched_latency;
+
     // per cpu idle thread
     thread_t idle_thread;
 
     // kernel counters arena
     int64_t* counters;
 
+    // pc and frame pointer interrupted by the irq being handled, recorded
+    // by the arch irq entry code for the sampling profiler
+    uintptr_t irq_pc;
+    uintptr_t irq_fp;
+
     // dpc context
     list_node_t dpc_list;
     event_t dpc_event;
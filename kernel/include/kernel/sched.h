@@ -30,6 +30,10 @@ void sched_migrate(thread_t* t) TA_REQ(thread_lock);
 // pri should be <= MAX_PRIORITY, negative values disable priority inheritance.
 void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) TA_REQ(thread_lock);
 
+// end the priority donation a thread received in a synchronous call handoff, unlinking it
+// from its donor, and return if the caller should locally reschedule.
+void sched_end_donation(thread_t* donee, bool* local_resched) TA_REQ(thread_lock);
+
 // set the priority of a thread and reset the boost value. This function might reschedule.
 // pri should be 0 <= to <= MAX_PRIORITY.
 void sched_change_priority(thread_t* t, int pri) TA_REQ(thread_lock);
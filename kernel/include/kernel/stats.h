@@ -7,6 +7,7 @@
 
 #include <sys/types.h>
 #include <zircon/compiler.h>
+#include <zircon/syscalls/object.h>
 #include <zircon/types.h>
 
 __BEGIN_CDECLS
@@ -33,6 +34,14 @@ struct cpu_stats {
     ulong generic_ipis;
 };
 
+// per cpu scheduler latency histograms, in the bucket layout of ZX_INFO_SCHED_LATENCY.
+// only written by the local cpu with the thread lock held.
+struct cpu_sched_latency {
+    uint64_t wakeup[ZX_SCHED_LATENCY_BUCKETS];
+    uint64_t run_queue[ZX_SCHED_LATENCY_BUCKETS];
+    uint64_t preempted_slice[ZX_SCHED_LATENCY_BUCKETS];
+};
+
 __END_CDECLS
 
 // include after the cpu_stats definition above, since it is part of the percpu structure
@@ -32,6 +32,14 @@ enum thread_state {
     THREAD_DEATH,
 };
 
+// how a thread came to be in THREAD_READY
+enum thread_ready_reason {
+    THREAD_READY_NONE = 0,
+    THREAD_READY_WAKEUP,    // unblocked, or started for the first time
+    THREAD_READY_REQUEUED,  // yielded, rescheduled or migrated while running
+    THREAD_READY_PREEMPTED, // preempted while running
+};
+
 enum thread_user_state_change {
     THREAD_USER_STATE_EXIT,
     THREAD_USER_STATE_SUSPEND,
@@ -53,6 +61,7 @@ typedef void (*thread_tls_callback_t)(void* tls_value);
 #define THREAD_SIGNAL_KILL                   (1 << 0)
 #define THREAD_SIGNAL_SUSPEND                (1 << 1)
 #define THREAD_SIGNAL_POLICY_EXCEPTION       (1 << 2)
+#define THREAD_SIGNAL_SAMPLE                 (1 << 3)
 // clang-format on
 
 #define THREAD_MAGIC (0x74687264) // 'thrd'
@@ -90,22 +99,49 @@ typedef struct thread {
     unsigned int flags;
     unsigned int signals;
 
+    // why and when the thread last entered THREAD_READY, for the scheduler
+    // latency histograms. THREAD_READY_NONE once it has started running.
+    enum thread_ready_reason ready_reason;
+    zx_time_t ready_time;
+
     // Total time in THREAD_RUNNING state.  If the thread is currently in
     // THREAD_RUNNING state, this excludes the time it has accrued since it
     // left the scheduler.
     zx_duration_t runtime_ns;
 
+    // Hardware page faults taken by the thread. Only written by the thread
+    // itself; see VmMapping::PageFault() and VmObjectPaged::GetPageLocked().
+    struct {
+        uint64_t read;
+        uint64_t write;
+        uint64_t cow;
+        uint64_t zero_fill;
+    } page_faults;
+
     // priority: in the range of [MIN_PRIORITY, MAX_PRIORITY], from low to high.
     // base_priority is set at creation time, and can be tuned with thread_set_priority().
     // priority_boost is a signed value that is moved around within a range by the scheduler.
     // inherited_priority is temporarily set to >0 when inheriting a priority from another
     // thread blocked on a locking primitive this thread holds. -1 means no inherit.
-    // effective_priority is MAX(base_priority + priority boost, inherited_priority) and is
-    // the working priority for run queue decisions.
+    // donated_priority is set to >0 while running on behalf of a thread that handed off to
+    // this one in a synchronous call (see thread_handoff_begin()). -1 means no donation.
+    // effective_priority is MAX(base_priority + priority boost, inherited_priority,
+    // donated_priority) and is the working priority for run queue decisions.
     int effec_priority;
     int base_priority;
     int priority_boost;
     int inherited_priority;
+    int donated_priority;
+
+    // the two ends of a priority donation: the thread whose priority this one runs at, and
+    // the thread this one donated its priority to. protected by the thread lock.
+    struct thread* donor;
+    struct thread* donee;
+
+    // set between thread_handoff_begin() and thread_handoff_end(), only ever
+    // touched by the thread itself.
+    bool handoff_pending;
+    bool handoff_donate;
 
     // current cpu the thread is either running on or in the ready queue, undefined otherwise
     cpu_num_t curr_cpu;
@@ -232,6 +268,23 @@ void thread_construct_first(thread_t* t, const char* name);
 thread_t* thread_create_idle_thread(uint cpu_num);
 void thread_set_name(const char* name);
 void thread_set_priority(thread_t* t, int priority);
+
+// Directed handoff for synchronous IPC.
+//
+// Between thread_handoff_begin() and thread_handoff_end(), the first thread the
+// current thread wakes is queued at the head of the current cpu's run queue instead
+// of going through cpu selection, so it runs here as soon as the current thread
+// blocks. With |donate| set, the woken thread also runs at no less than the current
+// thread's priority; the current thread is expected to block right after, so no local
+// reschedule is requested. thread_handoff_end() returns whether a thread was handed off to.
+//
+// The donation lasts until the donee blocks or exits, the donee gives it back with
+// thread_release_donated_priority(), or the donor ends it with thread_end_donation().
+// Neither of the last two may be called with a mutex held, as they may reschedule.
+void thread_handoff_begin(bool donate);
+bool thread_handoff_end(void);
+void thread_end_donation(void);
+void thread_release_donated_priority(const thread_t* donor);
 void thread_set_user_callback(thread_t* t, thread_user_callback_t cb);
 thread_t* thread_create(const char* name, thread_start_routine entry, void* arg, int priority);
 thread_t* thread_create_etc(thread_t* t, const char* name, thread_start_routine entry, void* arg,
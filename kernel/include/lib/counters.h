@@ -11,6 +11,7 @@
 #include <kernel/percpu.h>
 
 #include <zircon/compiler.h>
+#include <zircon/kcounters.h>
 
 __BEGIN_CDECLS
 
@@ -20,8 +21,9 @@ __BEGIN_CDECLS
 //   - after N seconds how many outstanding <x> things are allocated?
 //   - up to this point has <Y> ever happened?
 //
-// Currently the only query interface to the counters is the console
-// k counters command. Issue 'k counters help' to learn what it can do.
+// The counters can be queried from the console with the k counters
+// command; issue 'k counters help' to learn what it can do.  They are
+// also exported to userspace as read-only VMOs, see <zircon/kcounters.h>.
 //
 // Kernel counters public API:
 // 1- define a new counter.
@@ -30,6 +32,11 @@ __BEGIN_CDECLS
 // 2- counters start at zero, increment the counter:
 //      kcounter_add(counter_name, 1);
 //
+// Histogram counters count values into log2 buckets (see
+// <zircon/kcounters.h> for the bucket bounds):
+//      KCOUNTER_HISTOGRAM(histogram_name, "<counter name>");
+//      kcounter_histogram_add(histogram_name, value);
+//
 //
 // Naming the counters
 // The naming convention is "kernel.subsystem.thing_or_action"
@@ -45,10 +52,12 @@ __BEGIN_CDECLS
 
 struct k_counter_desc {
     const char* name;
+    uint32_t type;
+    uint32_t bucket;
 };
 static_assert(sizeof(struct k_counter_desc) ==
-              sizeof(((struct percpu){}).counters[0]),
-              "the kernel.ld ASSERT knows that these sizes match");
+              2 * sizeof(((struct percpu){}).counters[0]),
+              "the kernel.ld ASSERT knows that a descriptor is twice the size of a slot");
 
 // Define the descriptor and reserve the arena space for the counters.
 // Because of -fdata-sections, each kcounter_arena_* array will be
@@ -62,7 +71,28 @@ static_assert(sizeof(struct k_counter_desc) ==
     __USED int64_t kcounter_arena_##var[SMP_MAX_CPUS]               \
         __asm__("kcounter." name);                                  \
     __USED __SECTION("kcountdesc." name)                            \
-    static const struct k_counter_desc var[] = { { name } }
+    static const struct k_counter_desc var[] = { { name, KCOUNTER_TYPE_SUM, 0 } }
+
+// Define a histogram, which takes KCOUNTER_HISTOGRAM_BUCKETS slots that
+// are laid out like that many counters of the same name.
+#define KCOUNTER_BUCKET_(name, b) { name, KCOUNTER_TYPE_HISTOGRAM, b }
+#define KCOUNTER_BUCKETS4_(name, b)                                      \
+    KCOUNTER_BUCKET_(name, b), KCOUNTER_BUCKET_(name, b + 1),            \
+    KCOUNTER_BUCKET_(name, b + 2), KCOUNTER_BUCKET_(name, b + 3)
+#define KCOUNTER_HISTOGRAM(var, name)                               \
+    __USED int64_t kcounter_arena_##var[SMP_MAX_CPUS *              \
+                                        KCOUNTER_HISTOGRAM_BUCKETS] \
+        __asm__("kcounter." name);                                  \
+    __USED __SECTION("kcountdesc." name)                            \
+    static const struct k_counter_desc var[] = {                    \
+        KCOUNTER_BUCKETS4_(name, 0), KCOUNTER_BUCKETS4_(name, 4),   \
+        KCOUNTER_BUCKETS4_(name, 8), KCOUNTER_BUCKETS4_(name, 12),  \
+        KCOUNTER_BUCKETS4_(name, 16), KCOUNTER_BUCKETS4_(name, 20), \
+        KCOUNTER_BUCKETS4_(name, 24), KCOUNTER_BUCKETS4_(name, 28), \
+    };                                                              \
+    static_assert(sizeof(var) / sizeof(var[0]) ==                   \
+                  KCOUNTER_HISTOGRAM_BUCKETS,                       \
+                  "KCOUNTER_HISTOGRAM initializes every bucket")
 
 // Via magic in kernel.ld, all the descriptors wind up in a contiguous
 // array bounded by these two symbols, sorted by name.
@@ -93,4 +123,19 @@ static inline void kcounter_add(const struct k_counter_desc* var,
 #endif
 }
 
+// Returns the bucket of a histogram that |value| is counted in.
+static inline uint32_t kcounter_histogram_bucket(int64_t value) {
+    if (value <= 0)
+        return 0;
+    uint32_t bucket = 64 - __builtin_clzll((uint64_t)value);
+    return bucket < KCOUNTER_HISTOGRAM_BUCKETS ?
+        bucket : KCOUNTER_HISTOGRAM_BUCKETS - 1;
+}
+
+// Counts |value| in the histogram |var|.
+static inline void kcounter_histogram_add(const struct k_counter_desc* var,
+                                          int64_t value) {
+    kcounter_add(&var[kcounter_histogram_bucket(value)], 1);
+}
+
 __END_CDECLS
@@ -21,13 +21,18 @@ struct ktrace_probe_info {
     uint32_t num;
 } __ALIGNED(16); // align on multiple of 16 to match linker packing of the ktrace_probe section
 
-void* ktrace_open(uint32_t tag);
+// Appends a record to the current cpu's trace ring.  The header is filled
+// in here; |payload| supplies the KTRACE_LEN(tag) - KTRACE_HDRSIZE bytes
+// that follow it.  Returns ZX_ERR_UNAVAILABLE if the record's group is
+// disabled or the record was dropped because the ring was full.
+zx_status_t ktrace_write_record(uint32_t tag, const void* payload);
+// Returns true if records with |tag| are currently being traced.  Callers
+// that have to do extra work to build a record can check this first.
+bool ktrace_tag_enabled(uint32_t tag);
 void ktrace_tiny(uint32_t tag, uint32_t arg);
 static inline void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
-    uint32_t* data = (uint32_t*) ktrace_open(tag);
-    if (data) {
-        data[0] = a; data[1] = b; data[2] = c; data[3] = d;
-    }
+    uint32_t data[4] = { a, b, c, d };
+    ktrace_write_record(tag, data);
 }
 
 static inline void ktrace_ptr(uint32_t tag, const void* ptr, uint32_t c, uint32_t d) {
@@ -41,24 +46,19 @@ static inline void ktrace_ptr(uint32_t tag, const void* ptr, uint32_t c, uint32_
 
 #define ktrace_probe0(_name) do {                               \
     _ktrace_probe_prologue(_name);                              \
-    ktrace_open(TAG_PROBE_16(info.num));                        \
+    ktrace_write_record(TAG_PROBE_16(info.num), NULL);          \
 } while (0)
 
 #define ktrace_probe2(_name,arg0,arg1) do {                  \
     _ktrace_probe_prologue(_name);                           \
-    uint32_t* args = (uint32_t*)ktrace_open(TAG_PROBE_24(info.num));    \
-    if (args) {                                              \
-      args[0] = arg0;                                        \
-      args[1] = arg1;                                        \
-    }                                                        \
+    uint32_t args[2] = { arg0, arg1 };                       \
+    ktrace_write_record(TAG_PROBE_24(info.num), args);       \
 } while (0)
 
 #define ktrace_probe64(_name,arg) do {                  \
     _ktrace_probe_prologue(_name);                           \
-    uint64_t* args = (uint64_t*)ktrace_open(TAG_PROBE_24(info.num));    \
-    if (args) {                                              \
-      *args = arg;                                           \
-    }                                                        \
+    uint64_t args = arg;                                     \
+    ktrace_write_record(TAG_PROBE_24(info.num), &args);      \
 } while (0)
 
 void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always);
@@ -70,9 +70,19 @@ ssize_t ktrace_read_user(void* ptr, uint32_t off, size_t len);
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr);
 
 #define KTRACE_DEFAULT_BUFSIZE 32 // MB
-#define KTRACE_DEFAULT_GRPMASK 0xFFF
+#define KTRACE_DEFAULT_GRPMASK KTRACE_GRP_ALL
 
 void ktrace_report_live_threads(void);
 void ktrace_report_live_processes(void);
 
 __END_CDECLS
+
+#ifdef __cplusplus
+#include <fbl/ref_ptr.h>
+
+class VmObject;
+
+// Returns the VMO selected by |which| (KTRACE_VMO_*), for
+// KTRACE_ACTION_GET_VMO.
+zx_status_t ktrace_get_vmo(uint32_t which, fbl::RefPtr<VmObject>* vmo);
+#endif
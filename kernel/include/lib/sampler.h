@@ -0,0 +1,34 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+// Timer driven sampling profiler.
+//
+// While a session is running, a timer on each cpu fires every
+// |period_ns| and records the interrupted pc and a bounded frame pointer
+// backtrace into that cpu's region of the sample buffer.  Samples of
+// threads running user code are taken when the thread next processes its
+// signals, on its way back to user mode, where the user stack can be
+// walked safely.  The buffer is handed to userspace as a VMO (see
+// lib/zircon-internal/sampler.h), and sessions are driven through
+// mtrace_control(MTRACE_KIND_SAMPLER, ...).
+
+#pragma once
+
+#include <fbl/ref_ptr.h>
+#include <lib/zircon-internal/sampler.h>
+#include <zircon/types.h>
+
+class VmObject;
+
+zx_status_t sampler_init(const zx_sampler_config_t* config);
+zx_status_t sampler_get_buffer(fbl::RefPtr<VmObject>* vmo);
+zx_status_t sampler_start();
+zx_status_t sampler_stop();
+zx_status_t sampler_fini();
+
+// Records a sample of the current thread's user stack.  Called from
+// thread_process_pending_signals() for THREAD_SIGNAL_SAMPLE.
+void sampler_sample_user_thread();
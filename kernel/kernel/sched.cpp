@@ -61,12 +61,25 @@ static void compute_effec_priority(thread_t* t) {
     if (t->inherited_priority > ep) {
         ep = t->inherited_priority;
     }
+    if (t->donated_priority > ep) {
+        ep = t->donated_priority;
+    }
 
     DEBUG_ASSERT(ep >= LOWEST_PRIORITY && ep <= HIGHEST_PRIORITY);
 
     t->effec_priority = ep;
 }
 
+// break the link between |donee| and the thread that donated its priority to it. the caller
+// recomputes the effective priority.
+static void unlink_donation(thread_t* donee) TA_REQ(thread_lock) {
+    DEBUG_ASSERT(donee->donor->donee == donee);
+
+    donee->donor->donee = nullptr;
+    donee->donor = nullptr;
+    donee->donated_priority = -1;
+}
+
 // boost the priority of the thread by +1
 static void boost_thread(thread_t* t) {
     if (NO_BOOST) {
@@ -212,6 +225,45 @@ static cpu_mask_t find_cpu_mask(thread_t* t) TA_REQ(thread_lock) {
     return mask;
 }
 
+// map a latency to its ZX_INFO_SCHED_LATENCY histogram bucket
+static uint latency_bucket(zx_duration_t d) {
+    if (d < (zx_duration_t)ZX_SCHED_LATENCY_SUB_BUCKETS) {
+        return d > 0 ? (uint)d : 0;
+    }
+    uint msb = 63 - __builtin_clzll((uint64_t)d);
+    uint bucket = (msb - 1) * ZX_SCHED_LATENCY_SUB_BUCKETS + (uint)((d >> (msb - 2)) & 3);
+    return MIN(bucket, ZX_SCHED_LATENCY_BUCKETS - 1);
+}
+
+// record the latency histograms for a switch from |oldthread| to |newthread| at |now|.
+// |old_runtime| is how long |oldthread| ran for.
+static void account_sched_latency(struct cpu_sched_latency* lat, thread_t* oldthread,
+                                  thread_t* newthread, zx_time_t now,
+                                  zx_duration_t old_runtime) TA_REQ(thread_lock) {
+    if (oldthread->state == THREAD_READY && !thread_is_idle(oldthread)) {
+        if (oldthread->ready_reason == THREAD_READY_PREEMPTED) {
+            lat->preempted_slice[latency_bucket(old_runtime)]++;
+        } else {
+            oldthread->ready_reason = THREAD_READY_REQUEUED;
+        }
+        oldthread->ready_time = now;
+    }
+
+    zx_duration_t wait = zx_time_sub_time(now, newthread->ready_time);
+    switch (newthread->ready_reason) {
+    case THREAD_READY_WAKEUP:
+        lat->wakeup[latency_bucket(wait)]++;
+        break;
+    case THREAD_READY_REQUEUED:
+    case THREAD_READY_PREEMPTED:
+        lat->run_queue[latency_bucket(wait)]++;
+        break;
+    case THREAD_READY_NONE:
+        break;
+    }
+    newthread->ready_reason = THREAD_READY_NONE;
+}
+
 // run queue manipulation
 static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) TA_REQ(thread_lock) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
@@ -286,19 +338,30 @@ void sched_init_thread(thread_t* t, int priority) {
     t->base_priority = priority;
     t->priority_boost = 0;
     t->inherited_priority = -1;
+    t->donated_priority = -1;
+    t->donor = nullptr;
+    t->donee = nullptr;
+    t->handoff_pending = false;
+    t->handoff_donate = false;
     compute_effec_priority(t);
 }
 
 void sched_block() {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
-    __UNUSED thread_t* current_thread = get_current_thread();
+    thread_t* current_thread = get_current_thread();
 
     DEBUG_ASSERT(current_thread->magic == THREAD_MAGIC);
     DEBUG_ASSERT(current_thread->state != THREAD_RUNNING);
 
     LOCAL_KTRACE0("sched_block");
 
+    // a donated priority only lasts while the donee is running on behalf of the caller
+    if (unlikely(current_thread->donor)) {
+        unlink_donation(current_thread);
+        compute_effec_priority(current_thread);
+    }
+
     // we are blocking on something. the blocking code should have already stuck us on a queue
     sched_resched_internal();
 }
@@ -328,6 +391,46 @@ static void find_cpu_and_insert(thread_t* t, bool* local_resched,
     }
 }
 
+// if the current thread has a handoff pending (see thread_handoff_begin()) and |t| may run
+// here, put |t| at the head of the local run queue, donating our priority if asked to.
+// returns false if the normal cpu selection should be used instead.
+static bool handoff_to_thread(thread_t* t, bool* local_resched) TA_REQ(thread_lock) {
+    thread_t* current_thread = get_current_thread();
+    if (likely(!current_thread->handoff_pending) || arch_blocking_disallowed()) {
+        return false;
+    }
+
+    cpu_num_t curr_cpu = arch_curr_cpu_num();
+    if (!(t->cpu_affinity & cpu_num_to_mask(curr_cpu))) {
+        return false;
+    }
+
+    // only the first thread woken gets the handoff
+    current_thread->handoff_pending = false;
+
+    if (current_thread->handoff_donate) {
+        // a blocked thread holds no donation, and we donate to one thread at a time
+        DEBUG_ASSERT(!t->donor);
+        if (current_thread->donee) {
+            sched_end_donation(current_thread->donee, local_resched);
+        }
+        current_thread->donee = t;
+        t->donor = current_thread;
+        t->donated_priority = current_thread->effec_priority;
+        compute_effec_priority(t);
+        // the current thread is about to block, at which point |t| is picked up
+        *local_resched = false;
+    } else {
+        *local_resched = t->effec_priority > current_thread->effec_priority;
+    }
+
+    t->curr_cpu = curr_cpu;
+    insert_in_run_queue_head(curr_cpu, t);
+
+    LOCAL_KTRACE2("sched_handoff", t->effec_priority, current_thread->handoff_donate);
+    return true;
+}
+
 bool sched_unblock(thread_t* t) {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
@@ -340,8 +443,14 @@ bool sched_unblock(thread_t* t) {
 
     // stuff the new thread in the run queue
     t->state = THREAD_READY;
+    t->ready_reason = THREAD_READY_WAKEUP;
+    t->ready_time = current_time();
 
     bool local_resched = false;
+    if (handoff_to_thread(t, &local_resched)) {
+        return local_resched;
+    }
+
     cpu_mask_t mask = 0;
     find_cpu_and_insert(t, &local_resched, &mask);
 
@@ -360,6 +469,7 @@ bool sched_unblock_list(struct list_node* list) {
     // pop the list of threads and shove into the scheduler
     bool local_resched = false;
     cpu_mask_t accum_cpu_mask = 0;
+    zx_time_t now = current_time();
     thread_t* t;
     while ((t = list_remove_tail_type(list, thread_t, queue_node))) {
         DEBUG_ASSERT(t->magic == THREAD_MAGIC);
@@ -370,6 +480,8 @@ bool sched_unblock_list(struct list_node* list) {
 
         // stuff the new thread in the run queue
         t->state = THREAD_READY;
+        t->ready_reason = THREAD_READY_WAKEUP;
+        t->ready_time = now;
         find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
     }
 
@@ -433,6 +545,8 @@ void sched_preempt() {
 
     // idle thread doesn't go in the run queue
     if (likely(!thread_is_idle(current_thread))) {
+        current_thread->ready_reason = THREAD_READY_PREEMPTED;
+
         if (current_thread->remaining_time_slice <= 0) {
             // if we're out of quantum, deboost the thread and put it at the tail of a queue
             deboost_thread(current_thread, true);
@@ -692,6 +806,29 @@ void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) {
     }
 }
 
+// end the priority donation |donee| is running under, if any
+void sched_end_donation(thread_t* donee, bool* local_resched) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    if (!donee->donor) {
+        return;
+    }
+
+    unlink_donation(donee);
+    int old_ep = donee->effec_priority;
+    compute_effec_priority(donee);
+    if (old_ep == donee->effec_priority) {
+        return;
+    }
+
+    cpu_mask_t accum_cpu_mask = 0;
+    sched_priority_changed(donee, old_ep, local_resched, &accum_cpu_mask);
+
+    if (accum_cpu_mask) {
+        mp_reschedule(accum_cpu_mask, 0);
+    }
+}
+
 // changes the thread's base priority and if the re-computed effective priority changed
 //  then the thread is moved to the proper queue on the same processor and a re-schedule
 //  might be issued.
@@ -806,6 +943,7 @@ void sched_resched_internal() {
 
     // if it's the same thread as we're already running, exit
     if (newthread == oldthread) {
+        newthread->ready_reason = THREAD_READY_NONE;
         return;
     }
 
@@ -818,6 +956,8 @@ void sched_resched_internal() {
     oldthread->remaining_time_slice = zx_duration_sub_duration(
         oldthread->remaining_time_slice, MIN(old_runtime, oldthread->remaining_time_slice));
 
+    account_sched_latency(&percpu[cpu].sched_latency, oldthread, newthread, now, old_runtime);
+
     // set up quantum for the new thread if it was consumed
     if (newthread->remaining_time_slice == 0) {
         newthread->remaining_time_slice = THREAD_INITIAL_TIME_SLICE;
@@ -36,6 +36,7 @@
 #include <lib/counters.h>
 #include <lib/heap.h>
 #include <lib/ktrace.h>
+#include <lib/sampler.h>
 
 #include <list.h>
 #include <malloc.h>
@@ -477,6 +478,13 @@ __NO_RETURN static void thread_exit_locked(thread_t* current_thread,
     // reusing the stack before the function exits
     dpc_t free_dpc = DPC_INITIAL_VALUE;
 
+    // drop out of any priority donation, as donor or as donee
+    bool unused_resched = false;
+    if (current_thread->donee) {
+        sched_end_donation(current_thread->donee, &unused_resched);
+    }
+    sched_end_donation(current_thread, &unused_resched);
+
     // enter the dead state
     current_thread->state = THREAD_DEATH;
     current_thread->retcode = retcode;
@@ -702,6 +710,19 @@ void thread_process_pending_signals(void) {
         return;
     }
 
+    // The sampling profiler interrupted us in user mode; walking the user
+    // stack may fault, so it is done here rather than in the timer.
+    if (current_thread->signals & THREAD_SIGNAL_SAMPLE) {
+        {
+            Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+            current_thread->signals &= ~THREAD_SIGNAL_SAMPLE;
+        }
+        sampler_sample_user_thread();
+        if (current_thread->signals == 0) {
+            return;
+        }
+    }
+
     // grab the thread lock so we can safely look at the signal mask
     Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
     if (check_kill_signal(current_thread)) {
@@ -1023,6 +1044,87 @@ void thread_set_priority(thread_t* t, int priority) {
     sched_change_priority(t, priority);
 }
 
+/**
+ * @brief Start a directed handoff to the next thread woken by this one
+ *
+ * See thread.h for the semantics. Only touches the current thread's state,
+ * so no locking is required.
+ */
+void thread_handoff_begin(bool donate) {
+    thread_t* current_thread = get_current_thread();
+    current_thread->handoff_donate = donate;
+    current_thread->handoff_pending = true;
+}
+
+/**
+ * @brief Cancel a handoff started by thread_handoff_begin() if it was not used
+ *
+ * @return true if a thread was woken and handed off to.
+ */
+bool thread_handoff_end(void) {
+    thread_t* current_thread = get_current_thread();
+    bool handed_off = !current_thread->handoff_pending;
+    current_thread->handoff_pending = false;
+    return handed_off;
+}
+
+/**
+ * @brief End the priority donation the current thread made in a handoff, if any
+ *
+ * Called by the donor once the synchronous call it donated for is over, however
+ * it ended.
+ */
+void thread_end_donation(void) {
+    thread_t* current_thread = get_current_thread();
+
+    // Only we set this, so an unlocked read can only be stale in the
+    // direction of a donee that has since dropped out.
+    if (likely(!current_thread->donee)) {
+        return;
+    }
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+
+    if (!current_thread->donee) {
+        return;
+    }
+
+    bool local_resched = false;
+    sched_end_donation(current_thread->donee, &local_resched);
+    if (local_resched) {
+        sched_reschedule();
+    }
+}
+
+/**
+ * @brief Give back the priority donated to the current thread by |donor|
+ *
+ * Called by the donee once it has replied to |donor|. A donation from any other
+ * thread is kept. |donor| is only compared against, never dereferenced, so it
+ * may already have exited.
+ */
+void thread_release_donated_priority(const thread_t* donor) {
+    thread_t* current_thread = get_current_thread();
+
+    // Only set while we are blocked, so an unlocked read can only be stale in
+    // the direction of a donor that has since ended the donation.
+    if (likely(!current_thread->donor)) {
+        return;
+    }
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+
+    if (current_thread->donor != donor) {
+        return;
+    }
+
+    bool local_resched = false;
+    sched_end_donation(current_thread, &local_resched);
+    if (local_resched) {
+        sched_reschedule();
+    }
+}
+
 /**
  * @brief  Become an idle thread
  *
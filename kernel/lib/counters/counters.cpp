@@ -5,10 +5,13 @@
 // https://opensource.org/licenses/MIT
 
 #include <lib/counters.h>
+#include <lib/counters/vmo.h>
 
 #include <string.h>
 
 #include <arch/ops.h>
+#include <assert.h>
+#include <err.h>
 #include <platform.h>
 
 #include <kernel/auto_lock.h>
@@ -19,6 +22,10 @@
 
 #include <fbl/alloc_checker.h>
 #include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
+
+#include <vm/vm_object_paged.h>
+#include <zircon/thread_annotations.h>
 
 #include <lk/init.h>
 
@@ -26,6 +33,7 @@
 
 // The arena is allocated in kernel.ld linker script.
 extern int64_t kcounters_arena[];
+extern int64_t kcounters_arena_end[];
 
 struct watched_counter_t {
     list_node node;
@@ -33,6 +41,14 @@ struct watched_counter_t {
     // TODO(cpu): add min, max.
 };
 
+// The exported VMOs are kept alive by the kernel: the arena VMO wraps
+// the pages of the live counters in .bss, which must never go back to the
+// PMM when the last user handle is closed.  This mirrors RoDso's handling
+// of the vDSO image.
+static fbl::Mutex kcounters_vmo_lock;
+static fbl::RefPtr<VmObject> kcounters_desc_vmo TA_GUARDED(kcounters_vmo_lock);
+static fbl::RefPtr<VmObject> kcounters_arena_vmo TA_GUARDED(kcounters_vmo_lock);
+
 static fbl::Mutex watcher_lock;
 static list_node watcher_list = LIST_INITIAL_VALUE(watcher_list);
 static thread_t* watcher_thread;
@@ -77,18 +93,70 @@ static void counters_init(unsigned level) {
     }
 }
 
-static void dump_counter(const k_counter_desc* desc) {
-    size_t counter_index = kcounter_index(desc);
+// Returns the first descriptor of the counter that |desc| is a slot of.
+static const k_counter_desc* counter_start(const k_counter_desc* desc) {
+    return desc->type == KCOUNTER_TYPE_HISTOGRAM ? desc - desc->bucket : desc;
+}
 
-    uint64_t sum = 0;
-    uint64_t values[SMP_MAX_CPUS];
+// Returns the descriptor following the counter that starts at |desc|.
+static const k_counter_desc* next_counter(const k_counter_desc* desc) {
+    return desc->type == KCOUNTER_TYPE_HISTOGRAM ? desc + KCOUNTER_HISTOGRAM_BUCKETS : desc + 1;
+}
+
+// Sums the slot of |counter_index| over every cpu into |*sum|, and stores
+// the per-cpu values in |values|.
+static void read_counter(size_t counter_index, uint64_t* sum, uint64_t values[SMP_MAX_CPUS]) {
+    *sum = 0;
     for (size_t ix = 0; ix != SMP_MAX_CPUS; ++ix) {
         // This value is not atomically consistent, therefore is just
         // an approximation. TODO(cpu): for ARM this might need some magic.
         values[ix] = percpu[ix].counters[counter_index];
-        sum += values[ix];
+        *sum += values[ix];
+    }
+}
+
+static void dump_histogram(const k_counter_desc* desc) {
+    size_t counter_index = kcounter_index(desc);
+
+    uint64_t sums[KCOUNTER_HISTOGRAM_BUCKETS];
+    uint64_t total = 0;
+    uint64_t values[SMP_MAX_CPUS];
+    for (uint32_t bucket = 0; bucket < KCOUNTER_HISTOGRAM_BUCKETS; ++bucket) {
+        read_counter(counter_index + bucket, &sums[bucket], values);
+        total += sums[bucket];
+    }
+
+    printf("[%.2zu] %s = %lu samples\n", counter_index, desc->name, total);
+    if (total == 0u)
+        return;
+
+    // Print the buckets that have samples, by their lower bound.
+    printf("     ");
+    for (uint32_t bucket = 0; bucket < KCOUNTER_HISTOGRAM_BUCKETS; ++bucket) {
+        if (sums[bucket] == 0)
+            continue;
+        if (bucket == 0) {
+            printf("[<=0:%lu]", sums[bucket]);
+        } else {
+            printf("[%ld:%lu]", kcounter_histogram_bucket_floor(bucket), sums[bucket]);
+        }
+    }
+    printf("\n");
+}
+
+static void dump_counter(const k_counter_desc* desc) {
+    desc = counter_start(desc);
+    if (desc->type == KCOUNTER_TYPE_HISTOGRAM) {
+        dump_histogram(desc);
+        return;
     }
 
+    size_t counter_index = kcounter_index(desc);
+
+    uint64_t sum;
+    uint64_t values[SMP_MAX_CPUS];
+    read_counter(counter_index, &sum, values);
+
     printf("[%.2zu] %s = %lu\n", counter_index, desc->name, sum);
     if (sum == 0u)
         return;
@@ -103,8 +171,8 @@ static void dump_counter(const k_counter_desc* desc) {
 }
 
 static void dump_all_counters() {
-    printf("%zu counters available:\n", get_num_counters());
-    for (auto it = kcountdesc_begin; it != kcountdesc_end; ++it) {
+    printf("%zu counter slots available:\n", get_num_counters());
+    for (auto it = kcountdesc_begin; it != kcountdesc_end; it = next_counter(it)) {
         dump_counter(it);
     }
 }
@@ -141,7 +209,7 @@ static int view_counter(int argc, const cmd_args* argv) {
                     break;
                 dump_counter(desc);
                 ++num_results;
-                ++desc;
+                desc = next_counter(desc);
             }
             if (num_results == 0) {
                 printf("counter '%s' not found, try --all\n", name);
@@ -231,10 +299,71 @@ static int cmd_counters(int argc, const cmd_args* argv, uint32_t flags) {
         "inspect system counters:\n"
         "  counters view <name>\n"
         "  counters watch <id>\n"
+        "histograms are shown as [<bucket lower bound>:<count>]\n"
     );
     return 0;
 }
 
+zx_status_t kcounters_create_vmos(fbl::RefPtr<VmObject>* desc_vmo,
+                                  fbl::RefPtr<VmObject>* arena_vmo) {
+    fbl::AutoLock lock(&kcounters_vmo_lock);
+    if (kcounters_arena_vmo != nullptr) {
+        *desc_vmo = kcounters_desc_vmo;
+        *arena_vmo = kcounters_arena_vmo;
+        return ZX_OK;
+    }
+
+    const size_t num_counters = get_num_counters();
+    const size_t desc_size = sizeof(kcounters_desc_vmo_t) +
+                             num_counters * sizeof(kcounter_desc_entry_t);
+
+    fbl::RefPtr<VmObject> desc;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u,
+                                               ROUNDUP(desc_size, PAGE_SIZE), &desc);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buffer(new (&ac) uint8_t[desc_size]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    memset(buffer.get(), 0, desc_size);
+
+    auto header = reinterpret_cast<kcounters_desc_vmo_t*>(buffer.get());
+    header->magic = KCOUNTERS_DESC_MAGIC;
+    header->num_counters = num_counters;
+    header->max_cpus = SMP_MAX_CPUS;
+    for (size_t ix = 0; ix != num_counters; ++ix) {
+        const k_counter_desc* it = &kcountdesc_begin[ix];
+        kcounter_desc_entry_t* entry = &header->descriptors[ix];
+        DEBUG_ASSERT_MSG(strlen(it->name) < sizeof(entry->name),
+                         "counter name '%s' is too long\n", it->name);
+        strlcpy(entry->name, it->name, sizeof(entry->name));
+        entry->type = it->type;
+        entry->bucket = it->bucket;
+    }
+    status = desc->Write(buffer.get(), 0, desc_size);
+    if (status != ZX_OK)
+        return status;
+    desc->set_name(KCOUNTERS_DESC_VMO_NAME, sizeof(KCOUNTERS_DESC_VMO_NAME) - 1);
+
+    // The arena VMO shares the pages of the live counters, so readers see
+    // them change.
+    fbl::RefPtr<VmObject> arena;
+    const size_t arena_size = reinterpret_cast<uintptr_t>(kcounters_arena_end) -
+                              reinterpret_cast<uintptr_t>(kcounters_arena);
+    status = VmObjectPaged::CreateFromROData(kcounters_arena, arena_size, &arena);
+    if (status != ZX_OK)
+        return status;
+    arena->set_name(KCOUNTERS_ARENA_VMO_NAME, sizeof(KCOUNTERS_ARENA_VMO_NAME) - 1);
+
+    kcounters_desc_vmo = fbl::move(desc);
+    kcounters_arena_vmo = fbl::move(arena);
+    *desc_vmo = kcounters_desc_vmo;
+    *arena_vmo = kcounters_arena_vmo;
+    return ZX_OK;
+}
+
 LK_INIT_HOOK(kcounters, counters_init, LK_INIT_LEVEL_PLATFORM_EARLY);
 
 STATIC_COMMAND_START
@@ -0,0 +1,19 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/ref_ptr.h>
+#include <vm/vm_object.h>
+#include <zircon/types.h>
+
+// Creates the VMOs that export the kernel counters to userspace, as
+// described in <zircon/kcounters.h>: |desc_vmo| gets a copy of the counter
+// descriptors, while |arena_vmo| shares the pages of the counters
+// themselves.  The kernel keeps its own reference to both, so later calls
+// return the same VMOs.  The VMOs should only be handed out read-only.
+zx_status_t kcounters_create_vmos(fbl::RefPtr<VmObject>* desc_vmo,
+                                  fbl::RefPtr<VmObject>* arena_vmo);
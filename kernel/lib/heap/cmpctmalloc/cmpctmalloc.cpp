@@ -1034,6 +1034,14 @@ void cmpct_free(void* payload) {
     unlock();
 }
 
+size_t cmpct_usable_size(const void* payload) {
+    const header_t* header = (const header_t*)payload - 1;
+    DEBUG_ASSERT(!is_tagged_as_free(header));
+    // The size of an allocated area doesn't change until it is freed, so
+    // there is no need to take the lock.
+    return header->size - sizeof(header_t);
+}
+
 void* cmpct_realloc(void* payload, size_t size) {
     if (payload == NULL) {
         return cmpct_alloc(size);
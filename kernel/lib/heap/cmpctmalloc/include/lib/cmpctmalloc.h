@@ -19,6 +19,10 @@ void* cmpct_realloc(void*, size_t);
 void cmpct_free(void*);
 void* cmpct_memalign(size_t size, size_t alignment);
 
+// Returns the number of usable bytes in an allocated area, which may be more
+// than were asked for.
+size_t cmpct_usable_size(const void*);
+
 void cmpct_init(void);
 void cmpct_dump(bool panic_time);
 void cmpct_get_info(size_t* size_bytes, size_t* free_bytes);
@@ -0,0 +1,350 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "heap_cache.h"
+
+#include <arch/ops.h>
+#include <assert.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <kernel/auto_lock.h>
+#include <kernel/spinlock.h>
+#include <lib/cmpctmalloc.h>
+#include <lib/counters.h>
+#include <stdio.h>
+#include <string.h>
+#include <zircon/thread_annotations.h>
+
+// cmpctmalloc serializes every allocation and free on a single mutex. Most
+// kernel allocations are small and short-lived, so recently freed small
+// blocks are kept in per-cpu "magazines" and handed straight back out on the
+// next allocation of the same size class, in the style of Bonwick and Adams'
+// magazine allocator.
+//
+// Every cached block is an ordinary cmpctmalloc allocation at least as large
+// as its size class, so a block can be returned to cmpctmalloc at any time,
+// and any block cmpctmalloc hands out can be freed through the caches.
+//
+// For each size class, every cpu has a |loaded| and a |previous| magazine,
+// guarded by a per-cpu spinlock. When both are empty (or full), whole
+// magazines are exchanged with the class's depot, which is guarded by a
+// per-class spinlock; that happens at most once every kRounds operations.
+// cmpctmalloc itself is only ever called with no spinlock held.
+
+KCOUNTER(heap_cache_hit_count, "kernel.heap.cache.hit");
+KCOUNTER(heap_cache_miss_count, "kernel.heap.cache.miss");
+KCOUNTER(heap_cache_depot_count, "kernel.heap.cache.depot");
+
+namespace {
+
+// Size classes are spaced 16 bytes apart up to 128 bytes, and then four per
+// power of two up to kMaxCachedSize. Each class is also a cmpctmalloc bucket
+// size, so rounding a request up to its class costs no extra memory.
+constexpr size_t kMaxCachedSize = 2048;
+constexpr size_t kNumClasses = 24;
+
+// The number of blocks in a magazine.
+constexpr size_t kRounds = 16;
+
+// The most full magazines a depot will hold on to for each size class.
+constexpr size_t kMaxDepotFull = 16;
+
+size_t class_to_size(size_t cls) {
+    if (cls < 8) {
+        return (cls + 1) * 16;
+    }
+    size_t shift = 7 + (cls - 8) / 4;
+    size_t step = 1ul << (shift - 2);
+    return (1ul << shift) + ((cls - 8) % 4 + 1) * step;
+}
+
+// Returns the smallest class that can hold |size| bytes.
+size_t size_to_class(size_t size) {
+    DEBUG_ASSERT(size > 0 && size <= kMaxCachedSize);
+    if (size <= 128) {
+        return (size + 15) / 16 - 1;
+    }
+    size_t s = size - 1;
+    size_t shift = sizeof(size_t) * 8 - 1 - __builtin_clzl(s);
+    return 8 + (shift - 7) * 4 + ((s - (1ul << shift)) >> (shift - 2));
+}
+
+struct Magazine {
+    Magazine* next;
+    size_t rounds;
+    void* objects[kRounds];
+};
+
+struct CpuCache {
+    SpinLock lock;
+    Magazine* loaded TA_GUARDED(lock);
+    Magazine* previous TA_GUARDED(lock);
+
+    uint64_t hits TA_GUARDED(lock);
+    uint64_t misses TA_GUARDED(lock);
+    uint64_t frees TA_GUARDED(lock);
+};
+
+struct Depot {
+    SpinLock lock;
+    Magazine* full TA_GUARDED(lock);
+    Magazine* empty TA_GUARDED(lock);
+    size_t full_count TA_GUARDED(lock);
+};
+
+CpuCache cpu_caches[SMP_MAX_CPUS][kNumClasses];
+Depot depots[kNumClasses];
+
+void push(Magazine** list, Magazine* mag) {
+    mag->next = *list;
+    *list = mag;
+}
+
+Magazine* pop(Magazine** list) {
+    Magazine* mag = *list;
+    if (mag != nullptr) {
+        *list = mag->next;
+    }
+    return mag;
+}
+
+// Returns a block from the current cpu's cache for |cls|, or nullptr.
+void* cache_alloc(size_t cls) {
+    CpuCache& cache = cpu_caches[arch_curr_cpu_num()][cls];
+    AutoSpinLock guard(&cache.lock);
+
+    Magazine* mag = cache.loaded;
+    if (mag == nullptr || mag->rounds == 0) {
+        if (cache.previous != nullptr && cache.previous->rounds > 0) {
+            cache.loaded = cache.previous;
+            cache.previous = mag;
+        } else {
+            // Trade our empty magazine for a full one from the depot.
+            Depot& depot = depots[cls];
+            AutoSpinLock depot_guard(&depot.lock);
+            Magazine* full = pop(&depot.full);
+            if (full == nullptr) {
+                cache.misses++;
+                return nullptr;
+            }
+            depot.full_count--;
+            if (cache.previous != nullptr) {
+                push(&depot.empty, cache.previous);
+            }
+            cache.previous = cache.loaded;
+            cache.loaded = full;
+            kcounter_add(heap_cache_depot_count, 1);
+        }
+        mag = cache.loaded;
+    }
+
+    cache.hits++;
+    return mag->objects[--mag->rounds];
+}
+
+// Puts |ptr| in the current cpu's cache for |cls|. Returns false if no empty
+// magazine was available. If the depot was already holding as many full
+// magazines as it should, one is returned in |overflow| for the caller to
+// free.
+bool cache_free(size_t cls, void* ptr, Magazine** overflow) {
+    CpuCache& cache = cpu_caches[arch_curr_cpu_num()][cls];
+    AutoSpinLock guard(&cache.lock);
+
+    Magazine* mag = cache.loaded;
+    if (mag == nullptr || mag->rounds == kRounds) {
+        if (cache.previous != nullptr && cache.previous->rounds < kRounds) {
+            cache.loaded = cache.previous;
+            cache.previous = mag;
+        } else {
+            // Trade our full magazine for an empty one from the depot.
+            Depot& depot = depots[cls];
+            AutoSpinLock depot_guard(&depot.lock);
+            Magazine* empty = pop(&depot.empty);
+            if (empty == nullptr) {
+                return false;
+            }
+            if (cache.previous != nullptr) {
+                if (depot.full_count < kMaxDepotFull) {
+                    push(&depot.full, cache.previous);
+                    depot.full_count++;
+                } else {
+                    *overflow = cache.previous;
+                }
+            }
+            cache.previous = cache.loaded;
+            cache.loaded = empty;
+            kcounter_add(heap_cache_depot_count, 1);
+        }
+        mag = cache.loaded;
+    }
+
+    cache.frees++;
+    mag->objects[mag->rounds++] = ptr;
+    return true;
+}
+
+// Returns a magazine and every block in it to cmpctmalloc.
+void free_magazines(Magazine* list) {
+    while (Magazine* mag = pop(&list)) {
+        for (size_t i = 0; i < mag->rounds; i++) {
+            cmpct_free(mag->objects[i]);
+        }
+        cmpct_free(mag);
+    }
+}
+
+void* alloc_or_trim(size_t size) {
+    void* ptr = cmpct_alloc(size);
+    if (unlikely(ptr == nullptr && size != 0)) {
+        // The caches may be holding on to the memory we need.
+        heap_cache_trim();
+        ptr = cmpct_alloc(size);
+    }
+    return ptr;
+}
+
+} // namespace
+
+void* heap_cache_alloc(size_t size) {
+    if (size == 0 || size > kMaxCachedSize) {
+        return alloc_or_trim(size);
+    }
+
+    size_t cls = size_to_class(size);
+    void* ptr = cache_alloc(cls);
+    if (ptr == nullptr) {
+        kcounter_add(heap_cache_miss_count, 1);
+        return alloc_or_trim(class_to_size(cls));
+    }
+
+    kcounter_add(heap_cache_hit_count, 1);
+#if LK_DEBUGLEVEL > 2
+    // Match cmpctmalloc, which fills new allocations to catch uses of
+    // uninitialized memory.
+    memset(ptr, 0x99, size);
+#endif
+    return ptr;
+}
+
+void heap_cache_free(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+
+    // Cache the block in the largest class it can hold. Blocks from
+    // cmpct_memalign() or cmpct_realloc() are fine too.
+    size_t usable = cmpct_usable_size(ptr);
+    if (usable < class_to_size(0) || usable > kMaxCachedSize) {
+        cmpct_free(ptr);
+        return;
+    }
+    size_t cls = size_to_class(usable);
+    if (class_to_size(cls) > usable) {
+        cls--;
+    }
+
+    // If no cpu has a spare empty magazine, make one and try again. Another
+    // cpu may take it first, so only try a couple of times.
+    for (int attempt = 0; attempt < 2; attempt++) {
+        Magazine* overflow = nullptr;
+        if (cache_free(cls, ptr, &overflow)) {
+            free_magazines(overflow);
+            return;
+        }
+
+        auto mag = static_cast<Magazine*>(cmpct_alloc(sizeof(Magazine)));
+        if (mag == nullptr) {
+            break;
+        }
+        mag->rounds = 0;
+        Depot& depot = depots[cls];
+        AutoSpinLock guard(&depot.lock);
+        push(&depot.empty, mag);
+    }
+    cmpct_free(ptr);
+}
+
+void heap_cache_trim() {
+    Magazine* list = nullptr;
+    for (size_t cls = 0; cls < kNumClasses; cls++) {
+        for (auto& caches : cpu_caches) {
+            CpuCache& cache = caches[cls];
+            AutoSpinLock guard(&cache.lock);
+            if (cache.loaded != nullptr) {
+                push(&list, cache.loaded);
+                cache.loaded = nullptr;
+            }
+            if (cache.previous != nullptr) {
+                push(&list, cache.previous);
+                cache.previous = nullptr;
+            }
+        }
+
+        Depot& depot = depots[cls];
+        AutoSpinLock guard(&depot.lock);
+        while (Magazine* mag = pop(&depot.full)) {
+            push(&list, mag);
+        }
+        while (Magazine* mag = pop(&depot.empty)) {
+            push(&list, mag);
+        }
+        depot.full_count = 0;
+    }
+    free_magazines(list);
+}
+
+size_t heap_cache_cached_bytes() {
+    size_t bytes = 0;
+    for (size_t cls = 0; cls < kNumClasses; cls++) {
+        size_t rounds = 0;
+        for (auto& caches : cpu_caches) {
+            CpuCache& cache = caches[cls];
+            AutoSpinLock guard(&cache.lock);
+            rounds += cache.loaded ? cache.loaded->rounds : 0;
+            rounds += cache.previous ? cache.previous->rounds : 0;
+        }
+        {
+            Depot& depot = depots[cls];
+            AutoSpinLock guard(&depot.lock);
+            rounds += depot.full_count * kRounds;
+        }
+        bytes += rounds * class_to_size(cls);
+    }
+    return bytes;
+}
+
+// At panic time the locks may be held by a cpu that will never release them,
+// so the counts are read without them.
+void heap_cache_dump(bool panic_time) TA_NO_THREAD_SAFETY_ANALYSIS {
+    printf("\tper-cpu caches:\n");
+    printf("\t%6s %8s %8s %12s %12s %12s\n",
+           "size", "cached", "depot", "hits", "misses", "frees");
+    for (size_t cls = 0; cls < kNumClasses; cls++) {
+        size_t cached = 0;
+        uint64_t hits = 0, misses = 0, frees = 0;
+        for (auto& caches : cpu_caches) {
+            CpuCache& cache = caches[cls];
+            spin_lock_saved_state_t state;
+            if (!panic_time) {
+                spin_lock_irqsave(cache.lock.GetInternal(), state);
+            }
+            cached += cache.loaded ? cache.loaded->rounds : 0;
+            cached += cache.previous ? cache.previous->rounds : 0;
+            hits += cache.hits;
+            misses += cache.misses;
+            frees += cache.frees;
+            if (!panic_time) {
+                spin_unlock_irqrestore(cache.lock.GetInternal(), state);
+            }
+        }
+        size_t depot_full = depots[cls].full_count;
+        if (hits + misses + frees == 0) {
+            continue;
+        }
+        printf("\t%6zu %8zu %8zu %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+               class_to_size(cls), cached, depot_full * kRounds, hits, misses, frees);
+    }
+}
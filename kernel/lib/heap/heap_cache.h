@@ -0,0 +1,29 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stddef.h>
+
+// Per-cpu caches of small heap blocks, layered on top of cmpctmalloc.
+// Internal to the heap; everyone else uses malloc() and free().
+
+// Allocates |size| bytes. Sizes the caches don't handle go straight to
+// cmpct_alloc().
+void* heap_cache_alloc(size_t size);
+
+// Frees |ptr|, which may be any block returned by cmpctmalloc.
+void heap_cache_free(void* ptr);
+
+// Returns every cached block to cmpctmalloc.
+void heap_cache_trim();
+
+// Returns the number of bytes held by the caches.
+size_t heap_cache_cached_bytes();
+
+// Prints per size class statistics. If |panic_time| is true, no locks are
+// taken.
+void heap_cache_dump(bool panic_time);
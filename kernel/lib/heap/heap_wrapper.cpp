@@ -23,6 +23,8 @@
 #include <vm/pmm.h>
 #include <vm/vm.h>
 
+#include "heap_cache.h"
+
 #define LOCAL_TRACE 0
 
 #ifndef HEAP_PANIC_ON_ALLOC_FAIL
@@ -133,6 +135,7 @@ void heap_init() {
 }
 
 void heap_trim() {
+    heap_cache_trim();
     cmpct_trim();
 }
 
@@ -143,7 +146,7 @@ void* malloc(size_t size) {
 
     add_stat(__GET_CALLER(), size);
 
-    void* ptr = cmpct_alloc(size);
+    void* ptr = heap_cache_alloc(size);
     if (unlikely(heap_trace)) {
         printf("caller %p malloc %zu -> %p\n", __GET_CALLER(), size, ptr);
     }
@@ -162,7 +165,7 @@ void* malloc_debug_caller_(size_t size, void* caller) {
 
     add_stat(caller, size);
 
-    void* ptr = cmpct_alloc(size);
+    void* ptr = heap_cache_alloc(size);
     if (unlikely(heap_trace)) {
         printf("caller %p malloc %zu -> %p\n", caller, size, ptr);
     }
@@ -202,7 +205,7 @@ void* calloc(size_t count, size_t size) {
 
     size_t realsize = count * size;
 
-    void* ptr = cmpct_alloc(realsize);
+    void* ptr = heap_cache_alloc(realsize);
     if (likely(ptr)) {
         memset(ptr, 0, realsize);
     }
@@ -239,15 +242,18 @@ void free(void* ptr) {
         printf("caller %p free %p\n", __GET_CALLER(), ptr);
     }
 
-    cmpct_free(ptr);
+    heap_cache_free(ptr);
 }
 
 static void heap_dump(bool panic_time) {
     cmpct_dump(panic_time);
+    heap_cache_dump(panic_time);
 }
 
 void heap_get_info(size_t* size_bytes, size_t* free_bytes) {
     cmpct_get_info(size_bytes, free_bytes);
+    // Blocks sitting in the per-cpu caches are free as far as callers care.
+    *free_bytes += heap_cache_cached_bytes();
 }
 
 static void heap_test() {
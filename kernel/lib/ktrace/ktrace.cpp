@@ -11,15 +11,19 @@
 
 #include <arch/ops.h>
 #include <arch/user_copy.h>
+#include <fbl/algorithm.h>
 #include <hypervisor/ktrace.h>
 #include <kernel/cmdline.h>
+#include <kernel/spinlock.h>
 #include <lib/ktrace.h>
 #include <lk/init.h>
 #include <object/thread_dispatcher.h>
+#include <vm/vm_address_region.h>
 #include <vm/vm_aspace.h>
+#include <vm/vm_object_paged.h>
 #include <zircon/thread_annotations.h>
 
-#define ktrace_timestamp() current_ticks();
+#define ktrace_timestamp() current_ticks()
 #define ktrace_ticks_per_ms() (ticks_per_second() / 1000)
 
 // Generated struct that has the syscall index and name.
@@ -75,88 +79,416 @@ static void ktrace_report_probes(void) {
     }
 }
 
-typedef struct ktrace_state {
-    // where the next record will be written
-    int offset;
+// The kernel's view of one cpu's ring.  Userspace can only read the
+// buffer, but nothing in it is trusted: the ring geometry and positions
+// used by the write path live here and are only published to |header|.
+typedef struct ktrace_cpu_state {
+    ktrace_cpu_header_t* header;
+    uint8_t* ring;
+
+    // monotonic byte counts, see ktrace_cpu_header_t
+    uint64_t head;
+    uint64_t tail;
+    uint64_t dropped;
+} ktrace_cpu_state_t;
 
+typedef struct ktrace_state {
     // mask of groups we allow, 0 == tracing disabled
     int grpmask;
 
-    // total size of the trace buffer
-    uint32_t bufsize;
+    // KTRACE_MODE_STREAMING or KTRACE_MODE_CIRCULAR
+    uint32_t mode;
+
+    // the trace buffer: a ktrace_buffer_header_t followed by one ring
+    // per cpu, mapped into the kernel for the lifetime of the system
+    ktrace_buffer_header_t* header;
 
-    // offset where tracing was stopped, 0 if tracing active
-    uint32_t marker;
+    // layout of the buffer, fixed at allocation
+    uint32_t num_cpus;
+    uint64_t ring_size;
+    ktrace_cpu_state_t cpus[SMP_MAX_CPUS];
 
-    // raw trace buffer
-    uint8_t* buffer;
+    // the consumer tails, one per cpu, only ever read as a hint
+    ktrace_cpu_control_t* control;
+
+    // backing store for |header| and |control|, handed out by
+    // ktrace_get_vmo()
+    fbl::RefPtr<VmObject> vmo;
+    fbl::RefPtr<VmObject> control_vmo;
 } ktrace_state_t;
 
 static ktrace_state_t KTRACE_STATE;
 
+// Serializes the control operations that touch the rings from outside
+// the write path (rewind, mode changes, linear reads).
+static fbl::Mutex ktrace_control_lock;
+
+// Copy |len| bytes into the ring of |cpu| at monotonic position |pos|.
+static void ktrace_ring_write(ktrace_state_t* ks, ktrace_cpu_state_t* cpu, uint64_t pos,
+                              const void* data, size_t len) {
+    size_t size = static_cast<size_t>(ks->ring_size);
+    size_t off = static_cast<size_t>(pos % size);
+    size_t first = fbl::min(len, size - off);
+    memcpy(cpu->ring + off, data, first);
+    memcpy(cpu->ring, static_cast<const uint8_t*>(data) + first, len - first);
+}
+
+// Append one record to the current cpu's ring.  |record| must have its
+// size encoded in the tag.  If |stamp| is set the header timestamp is
+// taken with interrupts disabled so each ring is ordered by time.
+static bool ktrace_commit(ktrace_state_t* ks, void* record, bool stamp) {
+    uint32_t tag = *static_cast<uint32_t*>(record);
+    uint32_t len = KTRACE_LEN(tag);
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+
+    uint32_t cpu_num = arch_curr_cpu_num();
+    ktrace_cpu_state_t* cpu = &ks->cpus[cpu_num];
+    uint64_t head = cpu->head;
+    uint64_t tail = cpu->tail;
+    bool written = true;
+
+    if (ks->mode == KTRACE_MODE_STREAMING) {
+        // Only accept a consumer tail that moves forward over live
+        // records, on a record boundary; anything else leaves the ring
+        // where it was.
+        uint64_t consumed = __atomic_load_n(&ks->control[cpu_num].tail, __ATOMIC_ACQUIRE);
+        if (consumed > tail && consumed <= head && (consumed % 8) == 0) {
+            tail = consumed;
+        }
+    }
+
+    if (head + len - tail > ks->ring_size) {
+        if (ks->mode == KTRACE_MODE_CIRCULAR) {
+            // drop whole records from the front until this one fits
+            while (head + len - tail > ks->ring_size) {
+                uint32_t old = *reinterpret_cast<uint32_t*>(cpu->ring + tail % ks->ring_size);
+                if (KTRACE_LEN(old) == 0) {
+                    tail = head;
+                    break;
+                }
+                tail += KTRACE_LEN(old);
+            }
+        } else {
+            cpu->dropped++;
+            cpu->header->dropped = cpu->dropped;
+            written = false;
+        }
+    }
+
+    if (tail != cpu->tail) {
+        cpu->tail = tail;
+        __atomic_store_n(&cpu->header->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    if (written) {
+        if (stamp) {
+            static_cast<ktrace_header_t*>(record)->ts = ktrace_timestamp();
+        }
+        ktrace_ring_write(ks, cpu, head, record, len);
+        cpu->head = head + len;
+        __atomic_store_n(&cpu->header->head, cpu->head, __ATOMIC_RELEASE);
+    }
+
+    arch_interrupt_restore(state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+    return written;
+}
+
+// Copy |len| bytes out of the ring of |cpu| at monotonic position |pos|.
+static void ktrace_ring_read(ktrace_state_t* ks, ktrace_cpu_state_t* cpu, uint64_t pos,
+                             void* data, size_t len) {
+    size_t size = static_cast<size_t>(ks->ring_size);
+    size_t off = static_cast<size_t>(pos % size);
+    size_t first = fbl::min(len, size - off);
+    memcpy(data, cpu->ring + off, first);
+    memcpy(static_cast<uint8_t*>(data) + first, cpu->ring, len - first);
+}
+
+// Copy up to |len| bytes of |cpu|'s ring starting at monotonic position
+// |pos| out to user memory.
+static zx_status_t ktrace_copy_to_user(ktrace_state_t* ks, uint8_t* ptr,
+                                       ktrace_cpu_state_t* cpu, uint64_t pos, size_t len) {
+    size_t size = static_cast<size_t>(ks->ring_size);
+    size_t off = static_cast<size_t>(pos % size);
+    size_t first = fbl::min(len, size - off);
+    zx_status_t status = arch_copy_to_user(ptr, cpu->ring + off, first);
+    if (status == ZX_OK && len > first) {
+        status = arch_copy_to_user(ptr + first, cpu->ring, len - first);
+    }
+    return status;
+}
+
+// Returns whether the bytes at |pos| in |cpu|'s ring, read just before
+// the call, were still live.  Writers move the tail past a record before
+// overwriting it (see ktrace_commit()), so a copy is intact if the tail
+// is not past it afterwards.
+static bool ktrace_still_live(ktrace_cpu_state_t* cpu, uint64_t pos) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&cpu->tail, __ATOMIC_ACQUIRE) <= pos;
+}
+
+// Name records carry no timestamp (see KTraceMerger::IsNameRecord()).
+static bool ktrace_is_name_record(uint32_t tag) {
+    return KTRACE_GROUP(tag) == KTRACE_GRP_META && (KTRACE_EVENT(tag) & 0xFF0) == 0x020;
+}
+
+// zx_ktrace_read() serves a single time-ordered stream merged from a
+// snapshot of the per-cpu rings.  Readers walk it in chunks at
+// increasing offsets, so the snapshot and the merge position are kept
+// between calls; a read at any other offset re-merges from the start.
+typedef struct ktrace_read_cursor {
+    bool valid;
+    // the snapshot: the live range of each ring when the stream began
+    uint64_t start[SMP_MAX_CPUS];
+    uint64_t end[SMP_MAX_CPUS];
+    // the position in each ring of the next record to merge, and the
+    // stream offset (past the metadata records) at which it goes
+    uint64_t pos[SMP_MAX_CPUS];
+    uint64_t off;
+    // the size of the stream, including the metadata records
+    uint64_t size;
+} ktrace_read_cursor_t;
+
+static ktrace_read_cursor_t ktrace_read_cursor TA_GUARDED(ktrace_control_lock);
+
+static void ktrace_read_snapshot(ktrace_state_t* ks, ktrace_read_cursor_t* cursor,
+                                 uint64_t meta_size) {
+    cursor->valid = true;
+    cursor->off = 0;
+    cursor->size = meta_size;
+    for (uint32_t i = 0; i < ks->num_cpus; i++) {
+        ktrace_cpu_state_t* cpu = &ks->cpus[i];
+        uint64_t head = __atomic_load_n(&cpu->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = __atomic_load_n(&cpu->tail, __ATOMIC_ACQUIRE);
+        uint64_t len = fbl::min(head - tail, ks->ring_size);
+        cursor->start[i] = head - len;
+        cursor->end[i] = head;
+        cursor->pos[i] = head - len;
+        cursor->size += len;
+    }
+}
+
+// Find the next record of the merged stream: a pending name record if
+// any cpu has one, else the oldest record.  Records overwritten since the
+// snapshot are skipped.  Returns false at the end of the stream.
+static bool ktrace_read_next(ktrace_state_t* ks, ktrace_read_cursor_t* cursor,
+                             uint32_t* next_cpu, uint32_t* next_len) {
+    bool found = false;
+    uint64_t next_ts = 0;
+    for (uint32_t i = 0; i < ks->num_cpus; i++) {
+        ktrace_cpu_state_t* cpu = &ks->cpus[i];
+        ktrace_header_t hdr = {};
+        uint32_t len;
+        for (;;) {
+            if (cursor->pos[i] + sizeof(uint32_t) > cursor->end[i]) {
+                len = 0;
+                break;
+            }
+            size_t n = static_cast<size_t>(
+                fbl::min<uint64_t>(sizeof(hdr), cursor->end[i] - cursor->pos[i]));
+            ktrace_ring_read(ks, cpu, cursor->pos[i], &hdr, n);
+            if (ktrace_still_live(cpu, cursor->pos[i])) {
+                len = KTRACE_LEN(hdr.tag);
+                if (len == 0 || len > cursor->end[i] - cursor->pos[i]) {
+                    // not a record; drop the rest of this ring
+                    cursor->pos[i] = cursor->end[i];
+                    len = 0;
+                }
+                break;
+            }
+            // overwritten since the snapshot: resume at the oldest record
+            cursor->pos[i] = fbl::min(__atomic_load_n(&cpu->tail, __ATOMIC_ACQUIRE),
+                                      cursor->end[i]);
+        }
+        if (len == 0) {
+            continue;
+        }
+        if (ktrace_is_name_record(hdr.tag)) {
+            *next_cpu = i;
+            *next_len = len;
+            return true;
+        }
+        if (!found || hdr.ts < next_ts) {
+            found = true;
+            next_ts = hdr.ts;
+            *next_cpu = i;
+            *next_len = len;
+        }
+    }
+    return found;
+}
+
 ssize_t ktrace_read_user(void* ptr, uint32_t off, size_t len) {
     ktrace_state_t* ks = &KTRACE_STATE;
+    if (ks->header == nullptr) {
+        return 0;
+    }
 
-    // Buffer size is limited by the marker if set,
-    // otherwise limited by offset (last written point).
-    // Offset can end up pointing past the end, so clip
-    // it to the actual buffer size to be safe.
-    uint32_t max;
-    if (ks->marker) {
-        max = ks->marker;
-    } else {
-        max = ks->offset;
-        if (max > ks->bufsize) {
-            max = ks->bufsize;
-        }
+    fbl::AutoLock lock(&ktrace_control_lock);
+    ktrace_read_cursor_t* cursor = &ktrace_read_cursor;
+
+    uint64_t ticks_per_ms = ktrace_ticks_per_ms();
+    ktrace_rec_32b_t meta[2] = {};
+    meta[0].tag = TAG_VERSION;
+    meta[0].a = KTRACE_VERSION;
+    meta[1].tag = TAG_TICKS_PER_MS;
+    meta[1].a = static_cast<uint32_t>(ticks_per_ms);
+    meta[1].b = static_cast<uint32_t>(ticks_per_ms >> 32);
+
+    // A size query or a read from the start begins a new stream, unless
+    // the current one has not been read past its start yet.
+    if (!cursor->valid || ptr == nullptr || (off == 0 && cursor->off != 0)) {
+        ktrace_read_snapshot(ks, cursor, sizeof(meta));
     }
 
     // null read is a query for trace buffer size
     if (ptr == nullptr) {
-        return max;
+        return static_cast<ssize_t>(cursor->size);
     }
 
     // constrain read to available buffer
-    if (off >= max) {
+    if (off >= cursor->size) {
         return 0;
     }
-    if (len > (max - off)) {
-        len = max - off;
+    if (len > (cursor->size - off)) {
+        len = static_cast<size_t>(cursor->size - off);
     }
 
-    if (arch_copy_to_user(ptr, ks->buffer + off, len) != ZX_OK) {
+    uint8_t* dst = static_cast<uint8_t*>(ptr);
+    size_t done = 0;
+    if (off < sizeof(meta)) {
+        size_t n = fbl::min(len, sizeof(meta) - off);
+        if (arch_copy_to_user(dst, reinterpret_cast<uint8_t*>(meta) + off, n) != ZX_OK) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        done = n;
+        if (done == len) {
+            return done;
+        }
+    }
+
+    uint64_t want = off + done - sizeof(meta);
+    if (want < cursor->off) {
+        // Not where the last read left off; merge again from the start.
+        for (uint32_t i = 0; i < ks->num_cpus; i++) {
+            cursor->pos[i] = cursor->start[i];
+        }
+        cursor->off = 0;
+    }
+
+    // Only whole records are returned, so a record is checked against the
+    // ring's tail once, right after it is copied.  A buffer too small for
+    // the next record gets the part of it that fits.
+    uint32_t i;
+    uint32_t rec_len;
+    while (done < len && ktrace_read_next(ks, cursor, &i, &rec_len)) {
+        ktrace_cpu_state_t* cpu = &ks->cpus[i];
+        uint64_t rec_pos = cursor->pos[i];
+        if (cursor->off + rec_len <= want) {
+            // before the requested offset
+            cursor->pos[i] += rec_len;
+            cursor->off += rec_len;
+            continue;
+        }
+        uint64_t skip = want - cursor->off;
+        size_t n = static_cast<size_t>(rec_len - skip);
+        if (n > len - done) {
+            if (done > 0) {
+                break;
+            }
+            n = len - done;
+        }
+        if (ktrace_copy_to_user(ks, dst + done, cpu, rec_pos + skip, n) != ZX_OK) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (!ktrace_still_live(cpu, rec_pos)) {
+            // Overwritten while we copied it; the next merge skips it.
+            continue;
+        }
+        done += n;
+        want += n;
+        if (skip + n == rec_len) {
+            cursor->pos[i] += rec_len;
+            cursor->off += rec_len;
+        }
+    }
+    return done;
+}
+
+zx_status_t ktrace_get_vmo(uint32_t which, fbl::RefPtr<VmObject>* vmo) {
+    ktrace_state_t* ks = &KTRACE_STATE;
+    if (ks->vmo == nullptr) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    switch (which) {
+    case KTRACE_VMO_BUFFER:
+        *vmo = ks->vmo;
+        return ZX_OK;
+    case KTRACE_VMO_CONTROL:
+        *vmo = ks->control_vmo;
+        return ZX_OK;
+    default:
         return ZX_ERR_INVALID_ARGS;
     }
-    return len;
+}
+
+static void ktrace_reset(ktrace_state_t* ks) TA_REQ(ktrace_control_lock) {
+    ktrace_read_cursor.valid = false;
+    for (uint32_t i = 0; i < ks->num_cpus; i++) {
+        ktrace_cpu_state_t* cpu = &ks->cpus[i];
+        __atomic_store_n(&cpu->head, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&cpu->tail, 0, __ATOMIC_RELEASE);
+        cpu->dropped = 0;
+        __atomic_store_n(&cpu->header->head, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&cpu->header->tail, 0, __ATOMIC_RELEASE);
+        cpu->header->dropped = 0;
+        __atomic_store_n(&ks->control[i].tail, 0, __ATOMIC_RELEASE);
+    }
 }
 
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
     ktrace_state_t* ks = &KTRACE_STATE;
     switch (action) {
     case KTRACE_ACTION_START:
+        if (ks->header == nullptr) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
         options = KTRACE_GRP_TO_MASK(options);
-        ks->marker = 0;
         atomic_store(&ks->grpmask, options ? options : KTRACE_GRP_TO_MASK(KTRACE_GRP_ALL));
         ktrace_report_live_processes();
         ktrace_report_live_threads();
         break;
-    case KTRACE_ACTION_STOP: {
-        atomic_store(&ks->grpmask, 0);
-        uint32_t n = ks->offset;
-        if (n > ks->bufsize) {
-            ks->marker = ks->bufsize;
+    case KTRACE_ACTION_STOP:
+        if (ks->mode == KTRACE_MODE_CIRCULAR && atomic_load(&ks->grpmask)) {
+            // The names emitted at start (or rewind) have likely been
+            // overwritten; report them again so the snapshot is usable.
+            ktrace_report_live_processes();
+            ktrace_report_live_threads();
+            atomic_store(&ks->grpmask, 0);
+            ktrace_report_syscalls(kt_syscall_info);
+            ktrace_report_probes();
+            ktrace_report_vcpu_meta();
         } else {
-            ks->marker = n;
+            atomic_store(&ks->grpmask, 0);
         }
         break;
-    }
-    case KTRACE_ACTION_REWIND:
-        // roll back to just after the metadata
-        atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
+    case KTRACE_ACTION_REWIND: {
+        if (ks->header == nullptr) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        if (atomic_load(&ks->grpmask)) {
+            return ZX_ERR_BAD_STATE;
+        }
+        {
+            fbl::AutoLock lock(&ktrace_control_lock);
+            ktrace_reset(ks);
+        }
         ktrace_report_syscalls(kt_syscall_info);
         ktrace_report_probes();
         ktrace_report_vcpu_meta();
         break;
+    }
     case KTRACE_ACTION_NEW_PROBE: {
         fbl::AutoLock lock(&probe_list_lock);
         ktrace_probe_info_t* probe;
@@ -172,6 +504,21 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
         ktrace_add_probe(probe);
         return probe->num;
     }
+    case KTRACE_ACTION_SET_MODE: {
+        if (options != KTRACE_MODE_STREAMING && options != KTRACE_MODE_CIRCULAR) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (ks->header == nullptr) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        if (atomic_load(&ks->grpmask)) {
+            return ZX_ERR_BAD_STATE;
+        }
+        fbl::AutoLock lock(&ktrace_control_lock);
+        ks->mode = options;
+        ks->header->mode = options;
+        break;
+    }
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -180,32 +527,116 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
 
 int trace_not_ready = 0;
 
+// Creates a committed VMO of |size| bytes and maps it into the kernel.
+// The pages are pinned so that they stay put under the write path, which
+// runs with interrupts disabled, whatever userspace does with its handle.
+static zx_status_t ktrace_create_vmo(size_t size, const char* name,
+                                     fbl::RefPtr<VmObject>* out, uint8_t** base) {
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, size, &vmo);
+    if (status != ZX_OK) {
+        return status;
+    }
+    vmo->set_name(name, strlen(name));
+    if ((status = vmo->CommitRange(0, size, nullptr)) != ZX_OK) {
+        return status;
+    }
+    if ((status = vmo->Pin(0, size)) != ZX_OK) {
+        return status;
+    }
+
+    fbl::RefPtr<VmMapping> mapping;
+    status = VmAspace::kernel_aspace()->RootVmar()->CreateVmMapping(
+        0, size, 0, 0, vmo, 0, ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE,
+        name, &mapping);
+    if (status != ZX_OK) {
+        vmo->Unpin(0, size);
+        return status;
+    }
+    if ((status = mapping->MapRange(0, size, true)) != ZX_OK) {
+        mapping->Destroy();
+        vmo->Unpin(0, size);
+        return status;
+    }
+
+    *out = fbl::move(vmo);
+    *base = reinterpret_cast<uint8_t*>(mapping->base());
+    return ZX_OK;
+}
+
+// Creates the trace buffer and control VMOs and lays out the per-cpu
+// rings.
+static zx_status_t ktrace_alloc_buffer(ktrace_state_t* ks, size_t size) {
+    uint32_t num_cpus = arch_max_num_cpus();
+    size_t stride = ROUNDDOWN((size - PAGE_SIZE) / num_cpus, PAGE_SIZE);
+    if (stride < 2 * PAGE_SIZE) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    fbl::RefPtr<VmObject> vmo;
+    uint8_t* base;
+    zx_status_t status = ktrace_create_vmo(size, "ktrace", &vmo, &base);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    fbl::RefPtr<VmObject> control_vmo;
+    uint8_t* control;
+    size_t control_size = ROUNDUP(num_cpus * sizeof(ktrace_cpu_control_t), PAGE_SIZE);
+    if ((status = ktrace_create_vmo(control_size, "ktrace-control",
+                                    &control_vmo, &control)) != ZX_OK) {
+        return status;
+    }
+
+    auto header = reinterpret_cast<ktrace_buffer_header_t*>(base);
+    header->magic = KTRACE_BUFFER_MAGIC;
+    header->version = KTRACE_VERSION;
+    header->num_cpus = num_cpus;
+    header->mode = ks->mode;
+    header->ticks_per_ms = ktrace_ticks_per_ms();
+    header->cpu_offset = PAGE_SIZE;
+    header->cpu_stride = stride;
+
+    ks->num_cpus = num_cpus;
+    ks->ring_size = stride - sizeof(ktrace_cpu_header_t);
+    for (uint32_t i = 0; i < num_cpus; i++) {
+        ktrace_cpu_state_t* cpu = &ks->cpus[i];
+        cpu->header = reinterpret_cast<ktrace_cpu_header_t*>(base + PAGE_SIZE + i * stride);
+        cpu->ring = reinterpret_cast<uint8_t*>(cpu->header + 1);
+        cpu->header->cpu = i;
+        cpu->header->size = ks->ring_size;
+    }
+
+    ks->control = reinterpret_cast<ktrace_cpu_control_t*>(control);
+    ks->header = header;
+    ks->vmo = fbl::move(vmo);
+    ks->control_vmo = fbl::move(control_vmo);
+    return ZX_OK;
+}
+
 void ktrace_init(unsigned level) {
     ktrace_state_t* ks = &KTRACE_STATE;
 
     uint32_t mb = cmdline_get_uint32("ktrace.bufsize", KTRACE_DEFAULT_BUFSIZE);
     uint32_t grpmask = cmdline_get_uint32("ktrace.grpmask", KTRACE_DEFAULT_GRPMASK);
+    const char* mode = cmdline_get("ktrace.mode");
 
     if (mb == 0) {
         dprintf(INFO, "ktrace: disabled\n");
         return;
     }
 
-    mb *= (1024*1024);
+    ks->mode = (mode && !strcmp(mode, "circular")) ? KTRACE_MODE_CIRCULAR
+                                                    : KTRACE_MODE_STREAMING;
 
     zx_status_t status;
-    VmAspace* aspace = VmAspace::kernel_aspace();
-    if ((status = aspace->Alloc("ktrace", mb, (void**)&ks->buffer, 0, VmAspace::VMM_FLAG_COMMIT,
-                                ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE)) < 0) {
+    if ((status = ktrace_alloc_buffer(ks, mb * (1024 * 1024))) != ZX_OK) {
         dprintf(INFO, "ktrace: cannot alloc buffer %d\n", status);
         return;
     }
 
-    // The last packet written can overhang the end of the buffer,
-    // so we reduce the reported size by the max size of a record
-    ks->bufsize = mb - 256;
-
-    dprintf(INFO, "ktrace: buffer at %p (%u bytes)\n", ks->buffer, mb);
+    dprintf(INFO, "ktrace: buffer at %p (%u MB, %u cpus, %s)\n", ks->header, mb,
+            ks->num_cpus, ks->mode == KTRACE_MODE_CIRCULAR ? "circular" : "streaming");
 
     // register all static probes
     {
@@ -217,19 +648,8 @@ void ktrace_init(unsigned level) {
         }
     }
 
-    // write metadata to the first two event slots
-    uint64_t n = ktrace_ticks_per_ms();
-    ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*) ks->buffer;
-    rec[0].tag = TAG_VERSION;
-    rec[0].a = KTRACE_VERSION;
-    rec[1].tag = TAG_TICKS_PER_MS;
-    rec[1].a = (uint32_t)n;
-    rec[1].b = (uint32_t)(n >> 32);
-
     // enable tracing
-    atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
     ktrace_report_syscalls(kt_syscall_info);
-    ktrace_report_probes();
     atomic_store(&ks->grpmask, KTRACE_GRP_TO_MASK(grpmask));
 
     // report names of existing threads
@@ -248,60 +668,54 @@ void ktrace_init(unsigned level) {
 void ktrace_tiny(uint32_t tag, uint32_t arg) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (tag & atomic_load(&ks->grpmask)) {
-        tag = (tag & 0xFFFFFFF0) | 2;
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_HDRSIZE)) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
-            hdr->ts = ktrace_timestamp();
-            hdr->tag = tag;
-            hdr->tid = arg;
-        }
+        ktrace_header_t hdr;
+        hdr.tag = (tag & 0xFFFFFFF0) | 2;
+        hdr.tid = arg;
+        ktrace_commit(ks, &hdr, true);
     }
 }
 
-void* ktrace_open(uint32_t tag) {
+bool ktrace_tag_enabled(uint32_t tag) {
     ktrace_state_t* ks = &KTRACE_STATE;
-    if (!(tag & atomic_load(&ks->grpmask))) {
-        return nullptr;
-    }
+    return (tag & atomic_load(&ks->grpmask)) != 0;
+}
 
-    int off;
-    if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-        // if we arrive at the end, stop
-        atomic_store(&ks->grpmask, 0);
-        return nullptr;
+zx_status_t ktrace_write_record(uint32_t tag, const void* payload) {
+    ktrace_state_t* ks = &KTRACE_STATE;
+    if (!(tag & atomic_load(&ks->grpmask))) {
+        return ZX_ERR_UNAVAILABLE;
     }
 
-    ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
-    hdr->ts = ktrace_timestamp();
+    uint64_t record[KTRACE_LEN(0xF) / sizeof(uint64_t)];
+    ktrace_header_t* hdr = reinterpret_cast<ktrace_header_t*>(record);
     hdr->tag = tag;
     hdr->tid = (uint32_t)get_current_thread()->user_tid;
-    return hdr + 1;
+    size_t len = KTRACE_LEN(tag) - KTRACE_HDRSIZE;
+    if (len > 0) {
+        memcpy(hdr + 1, payload, len);
+    }
+    return ktrace_commit(ks, record, true) ? ZX_OK : ZX_ERR_UNAVAILABLE;
 }
 
 void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always) {
     ktrace_state_t* ks = &KTRACE_STATE;
+    if (ks->header == nullptr) {
+        return;
+    }
     if ((tag & atomic_load(&ks->grpmask)) || always) {
         uint32_t len = static_cast<uint32_t>(strnlen(name, ZX_MAX_NAME_LEN - 1));
 
         // set size to: sizeof(hdr) + len + 1, round up to multiple of 8
         tag = (tag & 0xFFFFFFF0) | ((KTRACE_NAMESIZE + len + 1 + 7) >> 3);
 
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_rec_name_t* rec = (ktrace_rec_name_t*) (ks->buffer + off);
-            rec->tag = tag;
-            rec->id = id;
-            rec->arg = arg;
-            memcpy(rec->name, name, len);
-            rec->name[len] = 0;
-        }
+        uint64_t record[(KTRACE_NAMESIZE + ZX_MAX_NAME_LEN + 7) / sizeof(uint64_t)] = {};
+        ktrace_rec_name_t* rec = reinterpret_cast<ktrace_rec_name_t*>(record);
+        rec->tag = tag;
+        rec->id = id;
+        rec->arg = arg;
+        memcpy(rec->name, name, len);
+        rec->name[len] = 0;
+        ktrace_commit(ks, rec, false);
     }
 }
 
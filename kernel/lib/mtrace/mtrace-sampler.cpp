@@ -0,0 +1,81 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "lib/mtrace.h"
+#include "trace.h"
+
+#include <lib/sampler.h>
+#include <object/handle.h>
+#include <object/process_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
+
+#include <lib/zircon-internal/mtrace.h>
+
+#define LOCAL_TRACE 0
+
+zx_status_t mtrace_sampler_control(uint32_t action, uint32_t options,
+                                   user_inout_ptr<void> arg, size_t size) {
+    LTRACEF("action %u, options 0x%x, arg %p, size 0x%zx\n",
+            action, options, arg.get(), size);
+
+    if (options != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    switch (action) {
+    case MTRACE_SAMPLER_INIT: {
+        zx_sampler_config_t config;
+        if (size != sizeof(config))
+            return ZX_ERR_INVALID_ARGS;
+        zx_status_t status = arg.reinterpret<zx_sampler_config_t>().copy_from_user(&config);
+        if (status != ZX_OK)
+            return status;
+        return sampler_init(&config);
+    }
+
+    case MTRACE_SAMPLER_GET_BUFFER: {
+        if (size != sizeof(zx_handle_t))
+            return ZX_ERR_INVALID_ARGS;
+        fbl::RefPtr<VmObject> vmo;
+        zx_status_t status = sampler_get_buffer(&vmo);
+        if (status != ZX_OK)
+            return status;
+        fbl::RefPtr<Dispatcher> dispatcher;
+        zx_rights_t rights;
+        status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+        if (status != ZX_OK)
+            return status;
+        // The kernel writes the buffer; readers only get to look.
+        rights &= ~(ZX_RIGHT_WRITE | ZX_RIGHT_EXECUTE | ZX_RIGHT_SET_PROPERTY);
+        HandleOwner handle(Handle::Make(fbl::move(dispatcher), rights));
+        if (!handle)
+            return ZX_ERR_NO_MEMORY;
+        auto up = ProcessDispatcher::GetCurrent();
+        status = arg.reinterpret<zx_handle_t>().copy_to_user(up->MapHandleToValue(handle));
+        if (status != ZX_OK)
+            return status;
+        up->AddHandle(fbl::move(handle));
+        return ZX_OK;
+    }
+
+    case MTRACE_SAMPLER_START:
+        if (size != 0)
+            return ZX_ERR_INVALID_ARGS;
+        return sampler_start();
+
+    case MTRACE_SAMPLER_STOP:
+        if (size != 0)
+            return ZX_ERR_INVALID_ARGS;
+        return sampler_stop();
+
+    case MTRACE_SAMPLER_FINI:
+        if (size != 0)
+            return ZX_ERR_INVALID_ARGS;
+        return sampler_fini();
+
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+}
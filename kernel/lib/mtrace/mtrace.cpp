@@ -23,6 +23,8 @@ zx_status_t mtrace_control(uint32_t kind, uint32_t action, uint32_t options,
     case MTRACE_KIND_INSNTRACE:
         return mtrace_insntrace_control(action, options, arg, size);
 #endif
+    case MTRACE_KIND_SAMPLER:
+        return mtrace_sampler_control(action, options, arg, size);
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -11,6 +11,7 @@ MODULE := $(LOCAL_DIR)
 MODULE_SRCS += \
 	$(LOCAL_DIR)/mtrace.cpp \
 	$(LOCAL_DIR)/mtrace-ipm.cpp \
-	$(LOCAL_DIR)/mtrace-ipt.cpp
+	$(LOCAL_DIR)/mtrace-ipt.cpp \
+	$(LOCAL_DIR)/mtrace-sampler.cpp
 
 include make/module.mk
@@ -0,0 +1,321 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/sampler.h>
+
+#include <arch/debugger.h>
+#include <arch/ops.h>
+#include <arch/user_copy.h>
+#include <err.h>
+#include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
+#include <kernel/mp.h>
+#include <kernel/percpu.h>
+#include <kernel/thread.h>
+#include <kernel/thread_lock.h>
+#include <kernel/timer.h>
+#include <lib/counters.h>
+#include <platform.h>
+#include <string.h>
+#include <trace.h>
+#include <vm/vm.h>
+#include <vm/vm_address_region.h>
+#include <vm/vm_aspace.h>
+#include <vm/vm_object_paged.h>
+#include <zircon/syscalls/debug.h>
+
+#define LOCAL_TRACE 0
+
+KCOUNTER(sampler_ticks, "kernel.sampler.ticks");
+KCOUNTER(sampler_idle, "kernel.sampler.idle");
+
+namespace {
+
+// A sample under construction; records are built on the stack and then
+// copied into the current cpu's region with interrupts disabled.
+struct Sample {
+    sampler_record_t record;
+    uint64_t pc[SAMPLER_MAX_FRAMES];
+};
+
+fbl::Mutex session_lock;
+
+// Session state.  Set up and torn down under |session_lock|; read by the
+// timer callbacks only while |active| is true.
+zx_sampler_config_t config;
+fbl::RefPtr<VmObject> buffer_vmo;
+fbl::RefPtr<VmMapping> buffer_mapping;
+sampler_buffer_header_t* header;
+bool active;
+
+timer_t timers[SMP_MAX_CPUS];
+
+sampler_cpu_header_t* cpu_header(uint cpu) {
+    return reinterpret_cast<sampler_cpu_header_t*>(
+        reinterpret_cast<uint8_t*>(header) + header->cpu_offset + cpu * header->cpu_stride);
+}
+
+// Append |sample| to the current cpu's region.  Interrupts must be disabled.
+void commit(Sample* sample) {
+    uint cpu = arch_curr_cpu_num();
+    sampler_cpu_header_t* region = cpu_header(cpu);
+    size_t len = SAMPLER_RECORD_SIZE(sample->record.num_frames);
+
+    if (region->written + len > region->size) {
+        region->dropped++;
+        return;
+    }
+
+    sample->record.cpu = static_cast<uint16_t>(cpu);
+    memcpy(reinterpret_cast<uint8_t*>(region + 1) + region->written, sample, len);
+    region->samples++;
+    __atomic_store_n(&region->written, region->written + len, __ATOMIC_RELEASE);
+}
+
+void init_sample(Sample* sample, thread_t* t, uint16_t flags) {
+    sample->record.time = current_time();
+    sample->record.pid = t->user_pid;
+    sample->record.tid = t->user_tid;
+    sample->record.flags = flags;
+    sample->record.num_frames = 0;
+    sample->record.reserved = 0;
+}
+
+// Walk the kernel frame pointer chain of |t| starting at |fp|, staying
+// within its kernel stack.
+void walk_kernel_stack(thread_t* t, uintptr_t fp, Sample* sample) {
+    if (!WITH_FRAME_POINTERS) {
+        return;
+    }
+    const vaddr_t base = t->stack.base;
+    const vaddr_t top = t->stack.base + t->stack.size;
+    while (sample->record.num_frames < config.max_frames) {
+        if (fp < base || fp > top - 2 * sizeof(uintptr_t) || !IS_ALIGNED(fp, sizeof(uintptr_t))) {
+            break;
+        }
+        const uintptr_t* frame = reinterpret_cast<const uintptr_t*>(fp);
+        if (frame[1] == 0) {
+            break;
+        }
+        sample->pc[sample->record.num_frames++] = frame[1];
+        if (frame[0] <= fp) {
+            break;
+        }
+        fp = frame[0];
+    }
+}
+
+// Walk the user frame pointer chain starting at |fp|.  May fault.
+void walk_user_stack(uintptr_t fp, Sample* sample) {
+    while (sample->record.num_frames < config.max_frames) {
+        if (!is_user_address(fp) || !IS_ALIGNED(fp, sizeof(uintptr_t))) {
+            break;
+        }
+        uintptr_t frame[2];
+        if (arch_copy_from_user(frame, reinterpret_cast<const void*>(fp), sizeof(frame)) != ZX_OK) {
+            break;
+        }
+        if (frame[1] == 0) {
+            break;
+        }
+        sample->pc[sample->record.num_frames++] = frame[1];
+        if (frame[0] <= fp) {
+            break;
+        }
+        fp = frame[0];
+    }
+}
+
+void sampler_timer(timer_t* timer, zx_time_t now, void* arg) {
+    if (!__atomic_load_n(&active, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    kcounter_add(sampler_ticks, 1);
+
+    thread_t* t = get_current_thread();
+    const struct percpu* cpu = get_local_percpu();
+    if (thread_is_idle(t)) {
+        kcounter_add(sampler_idle, 1);
+    } else if (is_user_address(cpu->irq_pc)) {
+        if (config.flags & SAMPLER_FLAG_USER) {
+            // The user stack can fault, so leave it to the thread.
+            Guard<spin_lock_t, NoIrqSave> guard{ThreadLock::Get()};
+            t->signals |= THREAD_SIGNAL_SAMPLE;
+        }
+    } else if (config.flags & SAMPLER_FLAG_KERNEL) {
+        Sample sample;
+        init_sample(&sample, t, 0);
+        sample.pc[sample.record.num_frames++] = cpu->irq_pc;
+        walk_kernel_stack(t, cpu->irq_fp, &sample);
+        commit(&sample);
+    }
+
+    timer_set(timer, now + config.period_ns, TIMER_SLACK_LATE, config.period_ns / 10,
+              sampler_timer, nullptr);
+}
+
+void sync_cpu(void* arg) {}
+
+void start_cpu(void* arg) {
+    uint cpu = arch_curr_cpu_num();
+    timer_init(&timers[cpu]);
+    timer_set(&timers[cpu], current_time() + config.period_ns, TIMER_SLACK_LATE,
+              config.period_ns / 10, sampler_timer, nullptr);
+}
+
+} // namespace
+
+void sampler_sample_user_thread() {
+    if (!__atomic_load_n(&active, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    thread_t* t = get_current_thread();
+    zx_thread_state_general_regs_t regs;
+    if (arch_get_general_regs(t, &regs) != ZX_OK) {
+        return;
+    }
+
+    Sample sample;
+    init_sample(&sample, t, SAMPLER_RECORD_USER);
+#if ARCH_X86
+    sample.pc[sample.record.num_frames++] = regs.rip;
+    uintptr_t fp = regs.rbp;
+#elif ARCH_ARM64
+    sample.pc[sample.record.num_frames++] = regs.pc;
+    uintptr_t fp = regs.r[29];
+#endif
+
+    // Interrupts are normally off on the way out to user mode, but a user
+    // copy may need to take a page fault.
+    bool ints_disabled = arch_ints_disabled();
+    if (ints_disabled) {
+        arch_enable_ints();
+    }
+    walk_user_stack(fp, &sample);
+    arch_disable_ints();
+
+    // The session may have been torn down while we walked the stack.
+    if (__atomic_load_n(&active, __ATOMIC_ACQUIRE)) {
+        commit(&sample);
+    }
+
+    if (!ints_disabled) {
+        arch_enable_ints();
+    }
+}
+
+zx_status_t sampler_init(const zx_sampler_config_t* new_config) {
+    if (new_config->period_ns < SAMPLER_MIN_PERIOD_NS ||
+        new_config->max_frames == 0 || new_config->max_frames > SAMPLER_MAX_FRAMES ||
+        new_config->buffer_size < PAGE_SIZE ||
+        new_config->buffer_size > SAMPLER_MAX_BUFFER_SIZE ||
+        (new_config->flags & ~(SAMPLER_FLAG_KERNEL | SAMPLER_FLAG_USER)) != 0 ||
+        new_config->flags == 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    fbl::AutoLock lock(&session_lock);
+    if (header != nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    uint32_t num_cpus = arch_max_num_cpus();
+    size_t stride = ROUNDUP(sizeof(sampler_cpu_header_t) + new_config->buffer_size, PAGE_SIZE);
+    size_t size = PAGE_SIZE + num_cpus * stride;
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, size, &vmo);
+    if (status != ZX_OK) {
+        return status;
+    }
+    vmo->set_name("sampler", strlen("sampler"));
+    if ((status = vmo->CommitRange(0, size, nullptr)) != ZX_OK) {
+        return status;
+    }
+
+    fbl::RefPtr<VmMapping> mapping;
+    status = VmAspace::kernel_aspace()->RootVmar()->CreateVmMapping(
+        0, size, 0, 0, vmo, 0, ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE,
+        "sampler", &mapping);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if ((status = mapping->MapRange(0, size, true)) != ZX_OK) {
+        mapping->Destroy();
+        return status;
+    }
+
+    config = *new_config;
+    buffer_vmo = fbl::move(vmo);
+    buffer_mapping = fbl::move(mapping);
+    header = reinterpret_cast<sampler_buffer_header_t*>(buffer_mapping->base());
+    header->magic = SAMPLER_BUFFER_MAGIC;
+    header->num_cpus = num_cpus;
+    header->period_ns = config.period_ns;
+    header->cpu_offset = PAGE_SIZE;
+    header->cpu_stride = stride;
+    for (uint cpu = 0; cpu < num_cpus; cpu++) {
+        cpu_header(cpu)->size = stride - sizeof(sampler_cpu_header_t);
+    }
+
+    LTRACEF("%u cpus, %zu bytes per cpu, period %" PRIu64 "ns\n",
+            num_cpus, stride, config.period_ns);
+    return ZX_OK;
+}
+
+zx_status_t sampler_get_buffer(fbl::RefPtr<VmObject>* vmo) {
+    fbl::AutoLock lock(&session_lock);
+    if (header == nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+    *vmo = buffer_vmo;
+    return ZX_OK;
+}
+
+zx_status_t sampler_start() {
+    fbl::AutoLock lock(&session_lock);
+    if (header == nullptr || active) {
+        return ZX_ERR_BAD_STATE;
+    }
+    __atomic_store_n(&active, true, __ATOMIC_RELEASE);
+    mp_sync_exec(MP_IPI_TARGET_ALL, 0, start_cpu, nullptr);
+    return ZX_OK;
+}
+
+zx_status_t sampler_stop() {
+    fbl::AutoLock lock(&session_lock);
+    if (!active) {
+        return ZX_OK;
+    }
+    __atomic_store_n(&active, false, __ATOMIC_RELEASE);
+    for (uint cpu = 0; cpu < arch_max_num_cpus(); cpu++) {
+        if (timers[cpu].magic == TIMER_MAGIC) {
+            timer_cancel(&timers[cpu]);
+        }
+    }
+
+    // Samples are committed with interrupts disabled; once every cpu has
+    // taken an ipi, none can still be writing to the buffer.
+    mp_sync_exec(MP_IPI_TARGET_ALL, 0, sync_cpu, nullptr);
+    return ZX_OK;
+}
+
+zx_status_t sampler_fini() {
+    fbl::AutoLock lock(&session_lock);
+    if (active) {
+        return ZX_ERR_BAD_STATE;
+    }
+    if (header == nullptr) {
+        return ZX_OK;
+    }
+    header = nullptr;
+    buffer_mapping->Destroy();
+    buffer_mapping.reset();
+    buffer_vmo.reset();
+    return ZX_OK;
+}
@@ -0,0 +1,99 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <arch/user_copy.h>
+#include <fbl/algorithm.h>
+#include <lib/user_copy/user_ptr.h>
+#include <zircon/types.h>
+
+// user_*_iovec<> presents a list of user buffers, described by an array of zx_iovec_t, as a
+// single logically contiguous user buffer.
+//
+// The zx_iovec_t array itself must already live in kernel memory; only the buffers it describes
+// are in user memory.  The array is not owned and must outlive the user_iovec.
+//
+// user_iovec implements the subset of the user_ptr<void> interface that byte-stream consumers
+// use (byte_offset() and copy_array_{to,from}_user()), so code that is templated on a
+// user_ptr-like type works unchanged for scatter/gather I/O.
+
+namespace internal {
+
+template <InOutPolicy Policy>
+class user_iovec {
+public:
+    user_iovec(const zx_iovec_t* vec, size_t count)
+        : vec_(vec), count_(count), offset_(0u) {}
+
+    user_iovec(const user_iovec& other) = default;
+    user_iovec& operator=(const user_iovec& other) = default;
+
+    // Returns the total capacity of the described buffers, ignoring any byte offset.
+    size_t capacity() const {
+        size_t total = 0u;
+        for (size_t i = 0; i < count_; ++i) {
+            total += vec_[i].capacity;
+        }
+        return total;
+    }
+
+    // Returns a user_iovec offset by |offset| bytes from this one.
+    user_iovec byte_offset(size_t offset) const {
+        user_iovec result(*this);
+        result.offset_ += offset;
+        return result;
+    }
+
+    // Copies |len| bytes from |src| into the described user buffers.
+    zx_status_t copy_array_to_user(const void* src, size_t len) const {
+        static_assert(Policy & kOut, "can only copy to user for kOut or kInOut user_iovec");
+        return ForEachSegment(len, [src](void* user, size_t done, size_t seg_len) {
+            return arch_copy_to_user(user, static_cast<const char*>(src) + done, seg_len);
+        });
+    }
+
+    // Copies |len| bytes from the described user buffers into |dst|.
+    zx_status_t copy_array_from_user(void* dst, size_t len) const {
+        static_assert(Policy & kIn, "can only copy from user for kIn or kInOut user_iovec");
+        return ForEachSegment(len, [dst](void* user, size_t done, size_t seg_len) {
+            return arch_copy_from_user(static_cast<char*>(dst) + done, user, seg_len);
+        });
+    }
+
+private:
+    // Calls |func(user_ptr, bytes_done, segment_len)| for each contiguous user segment covering
+    // |len| bytes starting at |offset_|.  Returns ZX_ERR_INVALID_ARGS if the described buffers
+    // are too short.
+    template <typename Func>
+    zx_status_t ForEachSegment(size_t len, Func func) const {
+        size_t skip = offset_;
+        size_t done = 0u;
+        for (size_t i = 0; i < count_ && done < len; ++i) {
+            const size_t cap = vec_[i].capacity;
+            if (skip >= cap) {
+                skip -= cap;
+                continue;
+            }
+            const size_t seg_len = fbl::min(cap - skip, len - done);
+            void* user = static_cast<char*>(vec_[i].buffer) + skip;
+            zx_status_t status = func(user, done, seg_len);
+            if (status != ZX_OK) {
+                return status;
+            }
+            done += seg_len;
+            skip = 0u;
+        }
+        return (done == len) ? ZX_OK : ZX_ERR_INVALID_ARGS;
+    }
+
+    const zx_iovec_t* vec_;
+    size_t count_;
+    size_t offset_;
+};
+
+} // namespace internal
+
+using user_in_iovec = internal::user_iovec<internal::kIn>;
+using user_out_iovec = internal::user_iovec<internal::kOut>;
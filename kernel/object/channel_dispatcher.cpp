@@ -13,7 +13,9 @@
 #include <trace.h>
 
 #include <lib/counters.h>
+#include <lib/ktrace.h>
 #include <kernel/event.h>
+#include <kernel/thread.h>
 #include <platform.h>
 #include <object/handle.h>
 #include <object/message_packet.h>
@@ -21,6 +23,7 @@
 #include <object/thread_dispatcher.h>
 
 #include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/type_support.h>
 #include <zircon/rights.h>
@@ -34,6 +37,43 @@ KCOUNTER(channel_packet_depth_16, "kernel.channel.depth.16");
 KCOUNTER(channel_packet_depth_64, "kernel.channel.depth.64");
 KCOUNTER(channel_packet_depth_256, "kernel.channel.depth.256");
 KCOUNTER(channel_packet_depth_unbounded, "kernel.channel.depth.unbounded");
+KCOUNTER(channel_call_handoff, "kernel.channel.call.handoff");
+KCOUNTER(channel_reply_handoff, "kernel.channel.reply.handoff");
+
+// Source of the flow ids that link the CHANNEL_WRITE_FLOW and
+// CHANNEL_READ_FLOW records of a message.  0 is never handed out.
+static fbl::atomic<uint64_t> next_flow_id(1);
+
+// Writes the payload of a ktrace_rec_flow_t, which carries the full koid.
+static void TraceFlow(uint32_t tag, zx_koid_t koid, uint64_t flow_id, uint32_t txid) {
+    struct {
+        uint64_t koid;
+        uint64_t flow_id;
+        uint32_t txid;
+        uint32_t reserved;
+    } payload = { koid, flow_id, txid, 0 };
+    static_assert(sizeof(payload) == sizeof(ktrace_rec_flow_t) - KTRACE_HDRSIZE, "");
+    ktrace_write_record(tag, &payload);
+}
+
+// Traces the write of |msg| by endpoint |koid|, if IPC flow tracing is on.
+static void TraceWriteFlow(zx_koid_t koid, MessagePacket* msg) {
+    if (!ktrace_tag_enabled(TAG_CHANNEL_WRITE_FLOW))
+        return;
+    uint64_t flow_id = next_flow_id.fetch_add(1);
+    msg->set_flow_id(flow_id);
+    TraceFlow(TAG_CHANNEL_WRITE_FLOW, koid, flow_id, msg->get_txid());
+}
+
+// Traces the read of |msg| by endpoint |koid|, if its write was traced.
+static void TraceReadFlow(zx_koid_t koid, const MessagePacket& msg) {
+    uint64_t flow_id = msg.flow_id();
+    if (flow_id == 0)
+        return;
+    TraceFlow(TAG_CHANNEL_READ_FLOW, koid, flow_id, msg.get_txid());
+}
+
+DEFINE_OBJECT_CACHE(ChannelDispatcher, "channel");
 
 // static
 zx_status_t ChannelDispatcher::Create(fbl::RefPtr<Dispatcher>* dispatcher0,
@@ -195,6 +235,7 @@ zx_status_t ChannelDispatcher::Read(zx_koid_t owner,
 
     *msg = messages_.pop_front();
     message_count_--;
+    TraceReadFlow(get_koid(), **msg);
 
     if (messages_.is_empty())
         UpdateStateLocked(ZX_CHANNEL_READABLE, 0u);
@@ -205,20 +246,29 @@ zx_status_t ChannelDispatcher::Read(zx_koid_t owner,
 zx_status_t ChannelDispatcher::Write(zx_koid_t owner, fbl::unique_ptr<MessagePacket> msg) {
     canary_.Assert();
 
-    AutoReschedDisable resched_disable; // Must come before the lock guard.
-    resched_disable.Disable();
-    Guard<fbl::Mutex> guard{get_lock()};
+    const thread_t* caller;
+    {
+        AutoReschedDisable resched_disable; // Must come before the lock guard.
+        resched_disable.Disable();
+        Guard<fbl::Mutex> guard{get_lock()};
 
-    // Faling this test is only possible if this process has two threads racing:
-    // one thread is issuing channel_write() and one thread is moving the handle
-    // to another process.
-    if (owner != owner_)
-        return ZX_ERR_BAD_HANDLE;
+        // Faling this test is only possible if this process has two threads racing:
+        // one thread is issuing channel_write() and one thread is moving the handle
+        // to another process.
+        if (owner != owner_)
+            return ZX_ERR_BAD_HANDLE;
+
+        if (!peer_)
+            return ZX_ERR_PEER_CLOSED;
 
-    if (!peer_)
-        return ZX_ERR_PEER_CLOSED;
+        TraceWriteFlow(get_koid(), msg.get());
+        caller = peer_->WriteSelf(fbl::move(msg));
+    }
 
-    peer_->WriteSelf(fbl::move(msg));
+    // If that was the reply to a Call() that handed off to us, stop running
+    // at the caller's priority so it can run.
+    if (caller)
+        thread_release_donated_priority(caller);
 
     return ZX_OK;
 }
@@ -236,6 +286,7 @@ zx_status_t ChannelDispatcher::Call(zx_koid_t owner,
         return ZX_ERR_BAD_STATE;
     }
 
+    const thread_t* caller;
     {
         AutoReschedDisable resched_disable; // Must come before the lock guard.
         resched_disable.Disable();
@@ -268,15 +319,25 @@ alloc_txid:
         // Install our txid in the waiter and the outbound message
         waiter->set_txid(txid);
         msg->set_txid(txid);
+        TraceWriteFlow(get_koid(), msg.get());
 
         // (0) Before writing the outbound message and waiting, add our
         // waiter to the list.
         waiters_.push_back(waiter);
 
-        // (1) Write outbound message to opposing endpoint.
-        peer_->WriteSelf(fbl::move(msg));
+        // (1) Write outbound message to opposing endpoint. If that wakes a
+        // thread blocked waiting on the peer, hand this cpu and our priority
+        // to it: we are about to block in (2) anyway.
+        thread_handoff_begin(/* donate= */ true);
+        caller = peer_->WriteSelf(fbl::move(msg));
+        if (thread_handoff_end())
+            kcounter_add(channel_call_handoff, 1);
     }
 
+    // See Write().
+    if (caller)
+        thread_release_donated_priority(caller);
+
     // Reuse the code from the half-call used for retrying a Call after thread
     // suspend.
     return ResumeInterruptedCall(waiter, deadline, reply);
@@ -293,6 +354,11 @@ zx_status_t ChannelDispatcher::ResumeInterruptedCall(MessageWaiter* waiter,
         ThreadDispatcher::AutoBlocked by(ThreadDispatcher::Blocked::CHANNEL);
 
         zx_status_t status = waiter->Wait(deadline);
+
+        // Whatever woke us, the thread we handed off to in Call() is no
+        // longer working on our behalf.
+        thread_end_donation();
+
         if (status == ZX_ERR_INTERNAL_INTR_RETRY) {
             // If we got interrupted, return out to usermode, but
             // do not clear the waiter.
@@ -317,6 +383,8 @@ zx_status_t ChannelDispatcher::ResumeInterruptedCall(MessageWaiter* waiter,
         zx_status_t status = waiter->EndWait(reply);
         if (status == ZX_ERR_TIMED_OUT)
             waiters_.erase(*waiter);
+        else if (status == ZX_OK)
+            TraceReadFlow(get_koid(), **reply);
         return status;
     }
 }
@@ -325,7 +393,7 @@ size_t ChannelDispatcher::TxMessageMax() const {
     return SIZE_MAX;
 }
 
-void ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg) {
+const thread_t* ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg) {
     canary_.Assert();
 
     if (!waiters_.is_empty()) {
@@ -338,8 +406,15 @@ void ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg) {
             // Remove waiter from list.
             if (waiter.get_txid() == txid) {
                 waiters_.erase(waiter);
+
+                // Hand the cpu back to the caller. Any priority it donated
+                // to us is given back by our caller once the lock is dropped.
+                const thread_t* caller = waiter.thread();
+                thread_handoff_begin(/* donate= */ false);
                 waiter.Deliver(fbl::move(msg));
-                return;
+                if (thread_handoff_end())
+                    kcounter_add(channel_reply_handoff, 1);
+                return caller;
             }
         }
     }
@@ -350,6 +425,7 @@ void ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg) {
     }
 
     UpdateStateLocked(0u, ZX_CHANNEL_READABLE);
+    return nullptr;
 }
 
 zx_status_t ChannelDispatcher::UserSignalSelf(uint32_t clear_mask, uint32_t set_mask) {
@@ -373,6 +449,7 @@ zx_status_t ChannelDispatcher::MessageWaiter::BeginWait(fbl::RefPtr<ChannelDispa
 
     status_ = ZX_ERR_TIMED_OUT;
     channel_ = fbl::move(channel);
+    thread_ = get_current_thread();
     event_.Unsignal();
     return ZX_OK;
 }
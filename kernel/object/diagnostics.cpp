@@ -15,6 +15,7 @@
 #include <fbl/auto_lock.h>
 #include <object/handle.h>
 #include <object/job_dispatcher.h>
+#include <object/object_cache.h>
 #include <object/process_dispatcher.h>
 #include <object/vm_object_dispatcher.h>
 #include <pretty/sizes.h>
@@ -749,6 +750,7 @@ static int cmd_diagnostics(int argc, const cmd_args* argv, uint32_t flags) {
         printf("%s asd  <pid>|kernel : dump process/kernel address space\n",
                argv[0].str);
         printf("%s htinfo            : handle table info\n", argv[0].str);
+        printf("%s slabs             : object cache statistics\n", argv[0].str);
         return -1;
     }
 
@@ -817,6 +819,10 @@ static int cmd_diagnostics(int argc, const cmd_args* argv, uint32_t flags) {
         if (argc != 2)
             goto usage;
         DumpHandleTable();
+    } else if (strcmp(argv[1].str, "slabs") == 0) {
+        if (argc != 2)
+            goto usage;
+        ObjectCacheBase::DumpAll();
     } else {
         printf("unrecognized subcommand '%s'\n", argv[1].str);
         goto usage;
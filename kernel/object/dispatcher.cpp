@@ -26,6 +26,8 @@ KCOUNTER(dispatcher_observe_count, "kernel.dispatcher.observer.add");
 // counts the number of times observers have been canceled.
 KCOUNTER(dispatcher_cancel_bh_count, "kernel.dispatcher.observer.cancel.byhandle");
 KCOUNTER(dispatcher_cancel_bk_count, "kernel.dispatcher.observer.cancel.bykey");
+// counts the number of signal updates that did not need the dispatcher lock.
+KCOUNTER(dispatcher_update_state_fast_count, "kernel.dispatcher.update_state.fast");
 // counts the number of cookies set or changed (reset).
 KCOUNTER(dispatcher_cookie_set_count, "kernel.dispatcher.cookie.set");
 KCOUNTER(dispatcher_cookie_reset_count, "kernel.dispatcher.cookie.reset");
@@ -73,7 +75,7 @@ private:
 Dispatcher::Dispatcher(zx_signals_t signals)
     : koid_(GenerateKernelObjectId()),
       handle_count_(0u),
-      signals_(signals) {
+      state_(signals) {
 
     kcounter_add(dispatcher_create_count, 1);
 }
@@ -100,43 +102,9 @@ zx_status_t Dispatcher::add_observer(StateObserver* observer) {
     return ZX_OK;
 }
 
-namespace {
-
-template <typename Func, typename LockType>
-StateObserver::Flags CancelWithFunc(Dispatcher::ObserverList* observers,
-                                    Lock<LockType>* observer_lock, Func f) {
-    StateObserver::Flags flags = 0;
-
-    Dispatcher::ObserverList obs_to_remove;
-
-    {
-        Guard<LockType> guard{observer_lock};
-        for (auto it = observers->begin(); it != observers->end();) {
-            StateObserver::Flags it_flags = f(it.CopyPointer());
-            flags |= it_flags;
-            if (it_flags & StateObserver::kNeedRemoval) {
-                auto to_remove = it;
-                ++it;
-                obs_to_remove.push_back(observers->erase(to_remove));
-            } else {
-                ++it;
-            }
-        }
-    }
-
-    while (!obs_to_remove.is_empty()) {
-        obs_to_remove.pop_front()->OnRemoved();
-    }
-
-    // We've processed the removal flag, so strip it
-    return flags & (~StateObserver::kNeedRemoval);
-}
-
-}  // namespace
-
 // Since this conditionally takes the dispatcher's |lock_|, based on
 // the type of Mutex (either fbl::Mutex or fbl::NullLock), the thread
-// safety analysis is unable to prove that the accesses to |signals_|
+// safety analysis is unable to prove that the accesses to |state_|
 // and to |observers_| are always protected.
 template <typename LockType>
 void Dispatcher::AddObserverHelper(StateObserver* observer,
@@ -149,9 +117,15 @@ void Dispatcher::AddObserverHelper(StateObserver* observer,
     {
         Guard<LockType> guard{lock};
 
-        flags = observer->OnInitialize(signals_, cinfo);
+        // Publishing kHasObservers forces concurrent UpdateState() calls onto
+        // the locked path, so the signals read here cannot be changed under
+        // the observer's feet before it is on |observers_|.
+        uint64_t state = state_.fetch_or(kHasObservers, fbl::memory_order_acq_rel);
+
+        flags = observer->OnInitialize(static_cast<zx_signals_t>(state), cinfo);
         if (!(flags & StateObserver::kNeedRemoval))
             observers_.push_front(observer);
+        SyncObserverBitLocked();
     }
     if (flags & StateObserver::kNeedRemoval)
         observer->OnRemoved();
@@ -177,12 +151,51 @@ void Dispatcher::RemoveObserver(StateObserver* observer) {
     Guard<fbl::Mutex> guard{get_lock()};
     DEBUG_ASSERT(observer != nullptr);
     observers_.erase(*observer);
+    SyncObserverBitLocked();
+}
+
+void Dispatcher::SyncObserverBitLocked() {
+    if (observers_.is_empty()) {
+        state_.fetch_and(~kHasObservers, fbl::memory_order_release);
+    } else {
+        state_.fetch_or(kHasObservers, fbl::memory_order_release);
+    }
+}
+
+template <typename Func>
+StateObserver::Flags Dispatcher::CancelWithFunc(Func f) {
+    StateObserver::Flags flags = 0;
+
+    Dispatcher::ObserverList obs_to_remove;
+
+    {
+        Guard<fbl::Mutex> guard{get_lock()};
+        for (auto it = observers_.begin(); it != observers_.end();) {
+            StateObserver::Flags it_flags = f(it.CopyPointer());
+            flags |= it_flags;
+            if (it_flags & StateObserver::kNeedRemoval) {
+                auto to_remove = it;
+                ++it;
+                obs_to_remove.push_back(observers_.erase(to_remove));
+            } else {
+                ++it;
+            }
+        }
+        SyncObserverBitLocked();
+    }
+
+    while (!obs_to_remove.is_empty()) {
+        obs_to_remove.pop_front()->OnRemoved();
+    }
+
+    // We've processed the removal flag, so strip it
+    return flags & (~StateObserver::kNeedRemoval);
 }
 
 void Dispatcher::Cancel(const Handle* handle) {
     ZX_DEBUG_ASSERT(is_waitable());
 
-    CancelWithFunc(&observers_, get_lock(), [handle](StateObserver* obs) {
+    CancelWithFunc([handle](StateObserver* obs) {
         return obs->OnCancel(handle);
     });
 
@@ -192,8 +205,7 @@ void Dispatcher::Cancel(const Handle* handle) {
 bool Dispatcher::CancelByKey(const Handle* handle, const void* port, uint64_t key) {
     ZX_DEBUG_ASSERT(is_waitable());
 
-    StateObserver::Flags flags = CancelWithFunc(&observers_, get_lock(),
-                                                [handle, port, key](StateObserver* obs) {
+    StateObserver::Flags flags = CancelWithFunc([handle, port, key](StateObserver* obs) {
         return obs->OnCancelByKey(handle, port, key);
     });
 
@@ -204,7 +216,7 @@ bool Dispatcher::CancelByKey(const Handle* handle, const void* port, uint64_t ke
 
 // Since this conditionally takes the dispatcher's |lock_|, based on
 // the type of Mutex (either fbl::Mutex or fbl::NullLock), the thread
-// safety analysis is unable to prove that the accesses to |signals_|
+// safety analysis is unable to prove that the accesses to |observers_|
 // are always protected.
 template <typename LockType>
 void Dispatcher::UpdateStateHelper(zx_signals_t clear_mask,
@@ -214,14 +226,20 @@ void Dispatcher::UpdateStateHelper(zx_signals_t clear_mask,
     {
         Guard<LockType> guard{lock};
 
-        auto previous_signals = signals_;
-        signals_ &= ~clear_mask;
-        signals_ |= set_mask;
-
-        if (previous_signals == signals_)
-            return;
-
-        UpdateInternalLocked(&obs_to_remove, signals_);
+        // UpdateState() may still be changing the signals without the lock
+        // if there are no observers, so this has to be a compare-and-swap.
+        uint64_t previous = state_.load(fbl::memory_order_relaxed);
+        uint64_t state;
+        do {
+            state = (previous & ~static_cast<uint64_t>(clear_mask)) | set_mask;
+            if (previous == state)
+                return;
+        } while (!state_.compare_exchange_weak(&previous, state,
+                                               fbl::memory_order_acq_rel,
+                                               fbl::memory_order_relaxed));
+
+        if (state & kHasObservers)
+            UpdateInternalLocked(&obs_to_remove, static_cast<zx_signals_t>(state));
     }
 
     while (!obs_to_remove.is_empty()) {
@@ -231,6 +249,22 @@ void Dispatcher::UpdateStateHelper(zx_signals_t clear_mask,
 
 void Dispatcher::UpdateState(zx_signals_t clear_mask,
                              zx_signals_t set_mask) {
+    // Fast path: with nobody watching, the new signals only need to be
+    // published. kHasObservers is set under the lock before an observer reads
+    // the initial signals, so once it is seen here the locked path is taken.
+    uint64_t previous = state_.load(fbl::memory_order_relaxed);
+    while (!(previous & kHasObservers)) {
+        uint64_t state = (previous & ~static_cast<uint64_t>(clear_mask)) | set_mask;
+        if (previous == state)
+            return;
+        if (state_.compare_exchange_weak(&previous, state,
+                                         fbl::memory_order_acq_rel,
+                                         fbl::memory_order_relaxed)) {
+            kcounter_add(dispatcher_update_state_fast_count, 1);
+            return;
+        }
+    }
+
     UpdateStateHelper(clear_mask, set_mask, get_lock());
 }
 
@@ -255,6 +289,7 @@ void Dispatcher::UpdateInternalLocked(ObserverList* obs_to_remove, zx_signals_t
             ++it;
         }
     }
+    SyncObserverBitLocked();
 }
 
 zx_status_t Dispatcher::SetCookie(CookieJar* cookiejar, zx_koid_t scope, uint64_t cookie) {
@@ -11,6 +11,8 @@
 #include <zircon/rights.h>
 #include <fbl/alloc_checker.h>
 
+DEFINE_OBJECT_CACHE(EventDispatcher, "event");
+
 zx_status_t EventDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
                                     zx_rights_t* rights) {
     fbl::AllocChecker ac;
@@ -12,6 +12,8 @@
 #include <zircon/rights.h>
 #include <fbl/alloc_checker.h>
 
+DEFINE_OBJECT_CACHE(EventPairDispatcher, "eventpair");
+
 zx_status_t EventPairDispatcher::Create(fbl::RefPtr<Dispatcher>* dispatcher0,
                                         fbl::RefPtr<Dispatcher>* dispatcher1,
                                         zx_rights_t* rights) {
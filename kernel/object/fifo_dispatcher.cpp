@@ -13,6 +13,8 @@
 #include <fbl/auto_lock.h>
 #include <object/handle.h>
 
+DEFINE_OBJECT_CACHE(FifoDispatcher, "fifo");
+
 // static
 zx_status_t FifoDispatcher::Create(size_t count, size_t elemsize, uint32_t options,
                                    fbl::RefPtr<Dispatcher>* dispatcher0,
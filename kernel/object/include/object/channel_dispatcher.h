@@ -9,7 +9,9 @@
 #include <stdint.h>
 
 #include <kernel/event.h>
+#include <kernel/thread.h>
 #include <object/dispatcher.h>
+#include <object/object_cache.h>
 #include <object/message_packet.h>
 
 #include <zircon/rights.h>
@@ -24,6 +26,8 @@
 class ChannelDispatcher final :
     public PeeredDispatcher<ChannelDispatcher, ZX_DEFAULT_CHANNEL_RIGHTS> {
 public:
+    DECLARE_OBJECT_CACHE_ALLOCATED(ChannelDispatcher);
+
     class MessageWaiter;
 
     static zx_status_t Create(fbl::RefPtr<Dispatcher>* dispatcher0,
@@ -91,6 +95,7 @@ public:
         fbl::RefPtr<ChannelDispatcher> get_channel() { return channel_; }
         zx_txid_t get_txid() const { return txid_; }
         void set_txid(zx_txid_t txid) { txid_ = txid; };
+        const thread_t* thread() const { return thread_; }
         zx_status_t Wait(zx_time_t deadline);
         // Returns any delivered message via out and the status.
         zx_status_t EndWait(fbl::unique_ptr<MessagePacket>* out);
@@ -103,6 +108,8 @@ public:
         Event event_;
         zx_txid_t txid_;
         zx_status_t status_;
+        // The thread blocked in Call(); only used to match up priority donation.
+        const thread_t* thread_ = nullptr;
     };
 
     // PeeredDispatcher implementation.
@@ -119,7 +126,8 @@ private:
 
     explicit ChannelDispatcher(fbl::RefPtr<PeerHolder<ChannelDispatcher>> holder);
     void Init(fbl::RefPtr<ChannelDispatcher> other);
-    void WriteSelf(fbl::unique_ptr<MessagePacket> msg) TA_REQ(get_lock());
+    // Returns the thread blocked in Call() that |msg| was delivered to as a reply, if any.
+    const thread_t* WriteSelf(fbl::unique_ptr<MessagePacket> msg) TA_REQ(get_lock());
     zx_status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask) TA_REQ(get_lock());
 
     fbl::Canary<fbl::magic("CHAN")> canary_;
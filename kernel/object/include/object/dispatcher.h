@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
@@ -186,11 +187,13 @@ public:
 protected:
     // Notify others of a change in state (possibly waking them). (Clearing satisfied signals or
     // setting satisfiable signals should not wake anyone.)
+    //
+    // When no observers are attached, UpdateState() does not take the dispatcher lock.
     void UpdateState(zx_signals_t clear_mask, zx_signals_t set_mask);
     void UpdateStateLocked(zx_signals_t clear_mask, zx_signals_t set_mask) TA_REQ(get_lock());
 
     zx_signals_t GetSignalsStateLocked() const TA_REQ(get_lock()) {
-        return signals_;
+        return static_cast<zx_signals_t>(state_.load(fbl::memory_order_acquire));
     }
 
     // Dispatcher subtypes should use this lock to protect their internal state.
@@ -206,6 +209,10 @@ private:
                            zx_signals_t set_mask,
                            Lock<LockType>* lock);
 
+    // The common implementation of Cancel and CancelByKey.
+    template <typename Func>
+    StateObserver::Flags CancelWithFunc(Func f);
+
     // The common implementation of AddObserver and AddObserverLocked.
     template <typename LockType>
     void AddObserverHelper(StateObserver* observer,
@@ -215,10 +222,19 @@ private:
     void UpdateInternalLocked(ObserverList* obs_to_remove,
                               zx_signals_t signals) TA_REQ(get_lock());
 
+    // Sets or clears kHasObservers in |state_| to match |observers_|.
+    void SyncObserverBitLocked() TA_REQ(get_lock());
+
+    // The low 32 bits of |state_| hold the object's signals. kHasObservers is
+    // set while |observers_| is non-empty; it only changes under the lock.
+    // While it is clear, UpdateState() may change the signals with a
+    // compare-and-swap instead of taking the lock.
+    static constexpr uint64_t kHasObservers = 1ull << 32;
+
     const zx_koid_t koid_;
     uint32_t handle_count_ TA_GUARDED(Handle::ArenaLock::Get());
 
-    zx_signals_t signals_ TA_GUARDED(get_lock());
+    fbl::atomic<uint64_t> state_;
 
     // Active observers are elements in |observers_|.
     ObserverList observers_ TA_GUARDED(get_lock());
@@ -321,15 +337,14 @@ public:
     zx_koid_t get_related_koid() const final TA_REQ(get_lock()) { return peer_koid_; }
     bool is_waitable() const final { return default_rights() & ZX_RIGHT_WAIT; }
 
-    zx_status_t user_signal_self(uint32_t clear_mask, uint32_t set_mask) final
-        TA_NO_THREAD_SAFETY_ANALYSIS {
+    zx_status_t user_signal_self(uint32_t clear_mask, uint32_t set_mask) final {
         auto allowed_signals = ZX_USER_SIGNAL_ALL | extra_signals;
         if ((set_mask & ~allowed_signals) || (clear_mask & ~allowed_signals))
             return ZX_ERR_INVALID_ARGS;
 
-        Guard<fbl::Mutex> guard{get_lock()};
-
-        UpdateStateLocked(clear_mask, set_mask);
+        // Signalling ourselves does not touch |peer_|, so there is no need to
+        // take the shared lock unless someone is observing us.
+        UpdateState(clear_mask, set_mask);
         return ZX_OK;
     }
 
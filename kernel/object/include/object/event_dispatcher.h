@@ -11,12 +11,15 @@
 
 #include <fbl/canary.h>
 #include <object/dispatcher.h>
+#include <object/object_cache.h>
 
 #include <sys/types.h>
 
 class EventDispatcher final :
     public SoloDispatcher<EventDispatcher, ZX_DEFAULT_EVENT_RIGHTS, ZX_EVENT_SIGNALED> {
 public:
+    DECLARE_OBJECT_CACHE_ALLOCATED(EventDispatcher);
+
     static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
                               zx_rights_t* rights);
 
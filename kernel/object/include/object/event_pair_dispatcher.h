@@ -13,11 +13,14 @@
 #include <fbl/mutex.h>
 #include <fbl/ref_ptr.h>
 #include <object/dispatcher.h>
+#include <object/object_cache.h>
 #include <sys/types.h>
 
 class EventPairDispatcher final :
     public PeeredDispatcher<EventPairDispatcher, ZX_DEFAULT_EVENTPAIR_RIGHTS, ZX_EVENT_SIGNALED> {
 public:
+    DECLARE_OBJECT_CACHE_ALLOCATED(EventPairDispatcher);
+
     static zx_status_t Create(fbl::RefPtr<Dispatcher>* dispatcher0,
                               fbl::RefPtr<Dispatcher>* dispatcher1,
                               zx_rights_t* rights);
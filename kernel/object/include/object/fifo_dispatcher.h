@@ -9,6 +9,7 @@
 #include <stdint.h>
 
 #include <object/dispatcher.h>
+#include <object/object_cache.h>
 
 #include <zircon/rights.h>
 #include <zircon/types.h>
@@ -20,6 +21,8 @@
 
 class FifoDispatcher final : public PeeredDispatcher<FifoDispatcher, ZX_DEFAULT_FIFO_RIGHTS> {
 public:
+    DECLARE_OBJECT_CACHE_ALLOCATED(FifoDispatcher);
+
     static zx_status_t Create(size_t elem_count, size_t elem_size, uint32_t options,
                               fbl::RefPtr<Dispatcher>* dispatcher0,
                               fbl::RefPtr<Dispatcher>* dispatcher1,
@@ -8,14 +8,21 @@
 
 #include <stdint.h>
 
+#include <lib/user_copy/user_iovec.h>
 #include <lib/user_copy/user_ptr.h>
 #include <zircon/types.h>
 #include <fbl/intrusive_single_list.h>
+#include <vm/vm.h>
 
 // MBufChain is a container for storing a stream of bytes or a sequence of datagrams.
 //
 // It's designed to back sockets and channels.  Don't simultaneously store stream data and datagrams
 // in a single instance.
+//
+// Small writes are stored in heap-allocated MBufs.  Whenever at least a page worth of data remains
+// to be written, the data is stored in page-sized MBufs allocated directly from the PMM instead,
+// so bulk transfers are copied a page at a time and do not touch the kernel heap.  Pages released
+// by readers are kept on a bounded per-chain freelist and handed straight back to the writer.
 class MBufChain {
 public:
     MBufChain() = default;
@@ -26,6 +33,9 @@ public:
     // Returns an error on failure.
     zx_status_t WriteStream(user_in_ptr<const void> src, size_t len, size_t* written);
 
+    // Same as above, but gathers the data from a list of user buffers.
+    zx_status_t WriteStream(user_in_iovec src, size_t len, size_t* written);
+
     // Writes a datagram of |len| bytes from |src| and sets |written| to number of bytes written.
     //
     // This operation is atomic in that either the entire datagram is written successfully or the
@@ -36,6 +46,9 @@ public:
     // Returns an error on failure.
     zx_status_t WriteDatagram(user_in_ptr<const void> src, size_t len, size_t* written);
 
+    // Same as above, but gathers the datagram from a list of user buffers.
+    zx_status_t WriteDatagram(user_in_iovec src, size_t len, size_t* written);
+
     // Reads upto |len| bytes from chain into |dst|.
     //
     // When |datagram| is false, the data in the chain is treated as a stream (no boundaries).
@@ -47,6 +60,9 @@ public:
     // Returns number of bytes read.
     size_t Read(user_out_ptr<void> dst, size_t len, bool datagram);
 
+    // Same as above, but scatters the data into a list of user buffers.
+    size_t Read(user_out_iovec dst, size_t len, bool datagram);
+
     bool is_full() const;
     bool is_empty() const;
 
@@ -61,20 +77,37 @@ public:
     }
 
     // Returns the maximum number of bytes that can be stored in the chain.
-    size_t max_size() const { return kSizeMax; }
+    size_t max_size() const { return max_size_; }
+
+    // Returns the number of bytes that can be written before the chain is full.
+    size_t free_size() const { return size_ < max_size_ ? max_size_ - size_ : 0u; }
+
+    // Sets the maximum number of bytes that can be stored in the chain.
+    //
+    // |max_size| must be in the range [1, kSizeMaxLimit].  Shrinking the chain below its current
+    // size does not discard any data; the chain simply reports full until enough has been read.
+    zx_status_t set_max_size(size_t max_size);
 
 private:
-    // An MBuf is a small fixed-size chainable memory buffer.
+    // An MBuf is a chainable memory buffer.  The payload immediately follows the header and is
+    // either kPayloadSize bytes (heap MBufs) or kPagePayloadSize bytes (page MBufs).
     struct MBuf : public fbl::SinglyLinkedListable<MBuf*> {
         // 8 for the linked list and 4 for the explicit uint32_t fields.
         static constexpr size_t kHeaderSize = 8 + (4 * 4);
         // 16 is for the malloc header.
         static constexpr size_t kMallocSize = 2048 - 16;
         static constexpr size_t kPayloadSize = kMallocSize - kHeaderSize;
+        static constexpr size_t kPagePayloadSize = PAGE_SIZE - kHeaderSize;
+
+        explicit MBuf(uint32_t cap) : cap_(cap) {}
 
         // Returns number of bytes of free space in this MBuf.
         size_t rem() const;
 
+        bool is_page() const { return cap_ == kPagePayloadSize; }
+
+        char* data() { return reinterpret_cast<char*>(this) + kHeaderSize; }
+
         uint32_t off_ = 0u;
         uint32_t len_ = 0u;
         // pkt_len_ is set to the total number of bytes in a packet
@@ -83,19 +116,42 @@ private:
         //
         // Always 0 in ZX_SOCKET_STREAM mode.
         uint32_t pkt_len_ = 0u;
-        uint32_t unused_;
-        char data_[kPayloadSize] = {0};
-        // TODO: maybe union data_ with char* blocks for large messages
+        // Size of the payload following the header.
+        const uint32_t cap_;
     };
-    static_assert(sizeof(MBuf) == MBuf::kMallocSize, "");
+    static_assert(sizeof(MBuf) == MBuf::kHeaderSize, "");
+
+public:
+    // The default for max_size(), which is also the largest that unprivileged callers may set.
+    static constexpr size_t kSizeMaxDefault = 128 * MBuf::kPayloadSize;
+    // The upper bound for max_size().
+    static constexpr size_t kSizeMaxLimit = 4096 * PAGE_SIZE;
 
-    static constexpr size_t kSizeMax = 128 * MBuf::kPayloadSize;
+private:
+
+    // Page MBufs are only used once at least this many bytes remain to be written.
+    static constexpr size_t kPageThreshold = MBuf::kPagePayloadSize;
 
-    MBuf* AllocMBuf();
+    // Maximum number of released page MBufs kept for reuse by a single chain.
+    static constexpr size_t kPageFreelistMax = 16;
+
+    // Allocates a heap MBuf, or a page MBuf if |page| is true.
+    MBuf* AllocMBuf(bool page);
     void FreeMBuf(MBuf* buf);
+    static void DestroyMBuf(MBuf* buf);
+
+    template <typename PTR_IN>
+    zx_status_t WriteStreamCommon(PTR_IN src, size_t len, size_t* written);
+    template <typename PTR_IN>
+    zx_status_t WriteDatagramCommon(PTR_IN src, size_t len, size_t* written);
+    template <typename PTR_OUT>
+    size_t ReadCommon(PTR_OUT dst, size_t len, bool datagram);
 
     fbl::SinglyLinkedList<MBuf*> freelist_;
+    fbl::SinglyLinkedList<MBuf*> page_freelist_;
+    size_t page_freelist_len_ = 0u;
     fbl::SinglyLinkedList<MBuf*> tail_;
     MBuf* head_ = nullptr;
     size_t size_ = 0u;
+    size_t max_size_ = kSizeMaxDefault;
 };
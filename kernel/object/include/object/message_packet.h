@@ -70,11 +70,17 @@ public:
         }
     }
 
+    // Links the ktrace records of the packet's write and read.  0 if the
+    // packet was written while IPC flow tracing was off.
+    uint64_t flow_id() const { return flow_id_; }
+    void set_flow_id(uint64_t flow_id) { flow_id_ = flow_id; }
+
 private:
     MessagePacket(BufferChain* chain, uint32_t data_size, uint32_t payload_offset,
                   uint16_t num_handles, Handle** handles)
         : buffer_chain_(chain), handles_(handles), data_size_(data_size),
-          payload_offset_(payload_offset), num_handles_(num_handles), owns_handles_(false) {}
+          payload_offset_(payload_offset), num_handles_(num_handles), owns_handles_(false),
+          flow_id_(0) {}
 
     friend class fbl::unique_ptr<MessagePacket>;
     ~MessagePacket() {
@@ -99,4 +105,5 @@ private:
     const uint32_t payload_offset_;
     const uint16_t num_handles_;
     bool owns_handles_;
+    uint64_t flow_id_;
 };
@@ -0,0 +1,173 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/slab_allocator.h>
+#include <kernel/spinlock.h>
+#include <zircon/syscalls/object.h>
+#include <zircon/thread_annotations.h>
+
+// ObjectCache<T> is a slab cache for a frequently created and destroyed kernel
+// object type T, for example ChannelDispatcher.
+//
+// Objects are carved out of slabs managed by a fbl::SlabAllocator. Each cpu
+// also keeps a small cache of recently freed objects, so that create/destroy
+// churn on one cpu normally neither touches the heap nor the slab allocator's
+// lock.
+//
+// The slab allocator never gives a slab back, so each cache is capped at
+// kMaxSlabs slabs. Past that, objects come from the heap and go back to it when
+// freed, so a one-off burst of objects does not pin its peak memory forever.
+//
+// A type opts in by adding DECLARE_OBJECT_CACHE_ALLOCATED() to its class
+// definition and DEFINE_OBJECT_CACHE() to its .cpp file. After that, the usual
+// |new (&ac) T(...)| and |delete| go through the cache.
+class ObjectCacheBase {
+public:
+    // Fills |info| with a snapshot of this cache's statistics.
+    void GetInfo(zx_info_object_cache_t* info) const;
+
+    // The number of registered caches, and the |index|th one (or nullptr).
+    static size_t Count();
+    static const ObjectCacheBase* Get(size_t index);
+
+    // Prints the statistics for all caches to the console.
+    static void DumpAll();
+
+protected:
+    ObjectCacheBase(const char* name, size_t object_size);
+    ~ObjectCacheBase() = default;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ObjectCacheBase);
+
+    // Returns storage for one object, or nullptr, and arms |ac| accordingly.
+    void* Alloc(size_t size, fbl::AllocChecker* ac);
+    void Free(void* ptr);
+
+    // Backing slab allocator, implemented by ObjectCache<T>.
+    virtual void* SlabAlloc() = 0;
+    virtual void SlabFree(void* ptr) = 0;
+    virtual size_t slab_count() const = 0;
+    virtual size_t slab_size() const = 0;
+    // Objects handed out by the slab allocator or the heap, including cached ones.
+    virtual size_t obj_count() const = 0;
+    virtual size_t heap_obj_count() const = 0;
+
+private:
+    static constexpr size_t kCpuCacheSize = 16;
+
+    struct CpuCache {
+        mutable SpinLock lock;
+        size_t count TA_GUARDED(lock) = 0;
+        void* objects[kCpuCacheSize] TA_GUARDED(lock) = {};
+
+        uint64_t alloc_count TA_GUARDED(lock) = 0;
+        uint64_t free_count TA_GUARDED(lock) = 0;
+        uint64_t hits TA_GUARDED(lock) = 0;
+    };
+
+    const char* const name_;
+    const size_t object_size_;
+
+    // Caches are registered at construction and never go away.
+    ObjectCacheBase* next_ = nullptr;
+
+    CpuCache cpu_caches_[SMP_MAX_CPUS];
+};
+
+template <typename T>
+class ObjectCache final : public ObjectCacheBase {
+public:
+    // The most slabs a cache will hold on to.
+    static constexpr size_t kMaxSlabs = 64;
+
+    explicit ObjectCache(const char* name)
+        : ObjectCacheBase(name, sizeof(T)),
+          allocator_(kMaxSlabs) {}
+
+    void* New(size_t size, fbl::AllocChecker* ac) {
+        DEBUG_ASSERT(size <= sizeof(T));
+        return Alloc(size, ac);
+    }
+
+    void Delete(void* ptr) {
+        if (ptr != nullptr) {
+            Free(ptr);
+        }
+    }
+
+private:
+    struct Block;
+    using AllocatorTraits = fbl::ManualDeleteSlabAllocatorTraits<
+        Block*, fbl::DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE, fbl::Mutex, true>;
+
+    struct Block : public fbl::SlabAllocated<AllocatorTraits> {
+        alignas(T) uint8_t storage[sizeof(T)];
+        // Set for blocks that came from the heap once the slabs ran out.
+        // Kept past |storage| so T's destructor cannot clobber it.
+        bool from_heap = false;
+    };
+
+    void* SlabAlloc() final {
+        Block* block = allocator_.New();
+        if (block == nullptr) {
+            void* mem = malloc(sizeof(Block));
+            if (mem == nullptr) {
+                return nullptr;
+            }
+            block = new (mem) Block;
+            block->from_heap = true;
+            heap_count_.fetch_add(1);
+        }
+        return block->storage;
+    }
+
+    void SlabFree(void* ptr) final {
+        Block* block = reinterpret_cast<Block*>(ptr);
+        if (block->from_heap) {
+            block->~Block();
+            free(block);
+            heap_count_.fetch_sub(1);
+        } else {
+            allocator_.Delete(block);
+        }
+    }
+
+    size_t slab_count() const final { return allocator_.slab_count(); }
+    size_t slab_size() const final { return AllocatorTraits::SLAB_SIZE; }
+    size_t obj_count() const final { return allocator_.obj_count() + heap_obj_count(); }
+    size_t heap_obj_count() const final { return heap_count_.load(); }
+
+    fbl::SlabAllocator<AllocatorTraits> allocator_;
+    fbl::atomic<size_t> heap_count_{0};
+};
+
+// Declares the allocation functions of a type whose objects come from an
+// ObjectCache. Place inside the class definition.
+#define DECLARE_OBJECT_CACHE_ALLOCATED(T)                        \
+public:                                                          \
+    static void* operator new(size_t size, fbl::AllocChecker* ac); \
+    static void operator delete(void* ptr)
+
+// Defines the ObjectCache for |T| and its allocation functions. |name| is the
+// cache's name in diagnostics. Place in T's .cpp file.
+#define DEFINE_OBJECT_CACHE(T, name)                                 \
+    static ObjectCache<T> T##_object_cache(name);                    \
+    void* T::operator new(size_t size, fbl::AllocChecker* ac) {      \
+        return T##_object_cache.New(size, ac);                       \
+    }                                                                \
+    void T::operator delete(void* ptr) {                             \
+        T##_object_cache.Delete(ptr);                                \
+    }
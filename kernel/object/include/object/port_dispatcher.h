@@ -7,6 +7,7 @@
 #pragma once
 
 #include <object/dispatcher.h>
+#include <object/object_cache.h>
 #include <object/semaphore.h>
 #include <object/state_observer.h>
 
@@ -114,6 +115,8 @@ struct PortInterruptPacket final : public fbl::DoublyLinkedListable<PortInterrup
 // callbacks.
 class PortObserver final : public StateObserver {
 public:
+    DECLARE_OBJECT_CACHE_ALLOCATED(PortObserver);
+
     PortObserver(uint32_t type, const Handle* handle, fbl::RefPtr<PortDispatcher> port,
                  uint64_t key, zx_signals_t signals);
     ~PortObserver() = default;
@@ -163,6 +166,8 @@ private:
 
 class PortDispatcher final : public SoloDispatcher<PortDispatcher, ZX_DEFAULT_PORT_RIGHTS> {
 public:
+    DECLARE_OBJECT_CACHE_ALLOCATED(PortDispatcher);
+
     static void Init();
     static PortAllocator* DefaultPortAllocator();
     static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
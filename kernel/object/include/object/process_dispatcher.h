@@ -198,6 +198,11 @@ public:
     // Syscall helpers
     zx_status_t GetInfo(zx_info_process_t* info);
     zx_status_t GetStats(zx_info_task_stats_t* stats);
+    // Page fault and syscall counts summed over every thread the process
+    // has had. |syscalls| has ZX_SYS_COUNT zeroed entries, or is null to
+    // skip the syscall counts.
+    void GetThreadStats(zx_info_task_faults_t* faults,
+                        ThreadDispatcher::SyscallStats* syscalls);
     // NOTE: Code outside of the syscall layer should not typically know about
     // user_ptrs; do not use this pattern as an example.
     zx_status_t GetAspaceMaps(user_out_ptr<zx_info_maps_t> maps, size_t max,
@@ -313,6 +318,11 @@ private:
     using ThreadList = fbl::DoublyLinkedList<ThreadDispatcher*, ThreadDispatcher::ThreadListTraits>;
     ThreadList thread_list_ TA_GUARDED(get_lock());
 
+    // page fault and syscall counts of the threads that have left |thread_list_|
+    zx_info_task_faults_t exited_faults_ TA_GUARDED(get_lock()) = {};
+    // (null if syscall stats are disabled, see ThreadDispatcher::syscall_stats_enabled())
+    fbl::unique_ptr<ThreadDispatcher::SyscallStats[]> exited_syscalls_ TA_GUARDED(get_lock());
+
     // our address space
     fbl::RefPtr<VmAspace> aspace_;
 
@@ -8,8 +8,10 @@
 
 #include <stdint.h>
 
+#include <lib/user_copy/user_iovec.h>
 #include <lib/user_copy/user_ptr.h>
 #include <object/dispatcher.h>
+#include <object/object_cache.h>
 #include <object/handle.h>
 #include <object/mbuf.h>
 
@@ -24,6 +26,8 @@
 class SocketDispatcher final :
     public PeeredDispatcher<SocketDispatcher, ZX_DEFAULT_SOCKET_RIGHTS> {
 public:
+    DECLARE_OBJECT_CACHE_ALLOCATED(SocketDispatcher);
+
     static zx_status_t Create(uint32_t flags, fbl::RefPtr<Dispatcher>* dispatcher0,
                               fbl::RefPtr<Dispatcher>* dispatcher1, zx_rights_t* rights);
 
@@ -35,6 +39,9 @@ public:
     // Socket methods.
     zx_status_t Write(user_in_ptr<const void> src, size_t len, size_t* written);
 
+    // Same as above, but gathers the data from a list of user buffers.
+    zx_status_t Write(user_in_iovec src, size_t len, size_t* written);
+
     zx_status_t WriteControl(user_in_ptr<const void> src, size_t len);
 
     // Shut this endpoint of the socket down for reading, writing, or both.
@@ -44,6 +51,9 @@ public:
 
     zx_status_t Read(user_out_ptr<void> dst, size_t len, size_t* nread);
 
+    // Same as above, but scatters the data into a list of user buffers.
+    zx_status_t Read(user_out_iovec dst, size_t len, size_t* nread);
+
     zx_status_t ReadControl(user_out_ptr<void> dst, size_t len, size_t* nread);
 
     // On success, the share queue takes ownership of |h|. On failure,
@@ -55,6 +65,7 @@ public:
 
     // Property methods.
     size_t ReceiveBufferMax() const;
+    zx_status_t SetReceiveBufferMax(size_t value);
     size_t ReceiveBufferSize() const;
     size_t TransmitBufferMax() const;
     size_t TransmitBufferSize() const;
@@ -82,7 +93,12 @@ private:
                      zx_signals_t starting_signals, uint32_t flags,
                      fbl::unique_ptr<ControlMsg> control_msg);
     void Init(fbl::RefPtr<SocketDispatcher> other);
-    zx_status_t WriteSelfLocked(user_in_ptr<const void> src, size_t len, size_t* nwritten) TA_REQ(get_lock());
+    template <typename PTR_IN>
+    zx_status_t WriteCommon(PTR_IN src, size_t len, size_t* nwritten);
+    template <typename PTR_IN>
+    zx_status_t WriteSelfLocked(PTR_IN src, size_t len, size_t* nwritten) TA_REQ(get_lock());
+    template <typename PTR_OUT>
+    zx_status_t ReadCommon(PTR_OUT dst, size_t len, size_t* nread);
     zx_status_t WriteControlSelfLocked(user_in_ptr<const void> src, size_t len) TA_REQ(get_lock());
     zx_status_t UserSignalSelfLocked(uint32_t clear_mask, uint32_t set_mask) TA_REQ(get_lock());
     zx_status_t ShutdownOtherLocked(uint32_t how) TA_REQ(get_lock());
@@ -22,13 +22,16 @@
 #include <zircon/compiler.h>
 #include <zircon/syscalls/debug.h>
 #include <zircon/syscalls/exception.h>
+#include <zircon/syscalls/object.h>
 #include <zircon/types.h>
+#include <zircon/zx-syscall-numbers.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/string_piece.h>
+#include <fbl/unique_ptr.h>
 
 class ProcessDispatcher;
 
@@ -67,6 +70,12 @@ public:
         INTERRUPT,
     };
 
+    // Count and cumulative time of one syscall, see AccountSyscall().
+    struct SyscallStats {
+        uint64_t count;
+        zx_duration_t time;
+    };
+
     static zx_status_t Create(fbl::RefPtr<ProcessDispatcher> process, uint32_t flags,
                               fbl::StringPiece name,
                               fbl::RefPtr<Dispatcher>* out_dispatcher,
@@ -148,12 +157,32 @@ public:
     // Fetch per thread stats for userspace.
     zx_status_t GetStatsForUserspace(zx_info_thread_stats_t* info);
 
+    // Syscalls are only counted and timed when the kernel is booted with
+    // kernel.syscall-stats=true: the table costs over a kilobyte per thread
+    // and process, and the timing two clock reads per syscall.
+    static bool syscall_stats_enabled() { return syscall_stats_enabled_; }
+    static void InitSyscallStats();
+
+    // Called by the syscall dispatch on the current thread as syscall |num|
+    // returns, |time| after it was entered, if syscall stats are enabled.
+    void AccountSyscall(uint64_t num, zx_duration_t time) {
+        if (likely(num < ZX_SYS_COUNT) && syscall_stats_) {
+            syscall_stats_[num].count++;
+            syscall_stats_[num].time += time;
+        }
+    }
+
+    // Adds this thread's page fault counts to |faults| and, unless it is
+    // null, its syscall counts to |syscalls|, which has ZX_SYS_COUNT entries.
+    void AccumulateStats(zx_info_task_faults_t* faults, SyscallStats* syscalls) const;
+
     // For debugger usage.
     zx_status_t ReadState(zx_thread_state_topic_t state_kind, void* buffer, size_t buffer_len);
     zx_status_t WriteState(zx_thread_state_topic_t state_kind, const void* buffer,
                            size_t buffer_len);
     // Profile support
     zx_status_t SetPriority(int32_t priority);
+    zx_status_t SetCpuAffinity(cpu_mask_t mask);
 
     // For ChannelDispatcher use.
     ChannelDispatcher::MessageWaiter* GetMessageWaiter() { return &channel_waiter_; }
@@ -251,6 +280,12 @@ private:
     // Used to protect thread name read/writes
     mutable DECLARE_SPINLOCK(ThreadDispatcher) name_lock_;
 
+    // Per-syscall counts, indexed by syscall number, or null if syscall stats
+    // are disabled. Like |blocked_reason_|, only written by the thread itself
+    // and read without synchronization.
+    fbl::unique_ptr<SyscallStats[]> syscall_stats_;
+    static bool syscall_stats_enabled_;
+
     // Per-thread structure used while waiting in a ChannelDispatcher::Call.
     // Needed to support the requirements of being able to interrupt a Call
     // in order to suspend a thread.
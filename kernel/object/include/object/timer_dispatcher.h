@@ -15,11 +15,14 @@
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
 #include <object/dispatcher.h>
+#include <object/object_cache.h>
 
 #include <sys/types.h>
 
 class TimerDispatcher final : public SoloDispatcher<TimerDispatcher, ZX_DEFAULT_TIMERS_RIGHTS> {
 public:
+    DECLARE_OBJECT_CACHE_ALLOCATED(TimerDispatcher);
+
     static zx_status_t Create(uint32_t options,
                               fbl::RefPtr<Dispatcher>* dispatcher,
                               zx_rights_t* rights);
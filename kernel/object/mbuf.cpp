@@ -6,38 +6,84 @@
 
 #include <object/mbuf.h>
 
+#include <stdlib.h>
+
+#include <lib/user_copy/user_iovec.h>
 #include <lib/user_copy/user_ptr.h>
+#include <vm/page.h>
+#include <vm/physmap.h>
+#include <vm/pmm.h>
+#include <zxcpp/new.h>
 
 #include <fbl/algorithm.h>
-#include <fbl/alloc_checker.h>
 
 #define LOCAL_TRACE 0
 
 constexpr size_t MBufChain::MBuf::kHeaderSize;
 constexpr size_t MBufChain::MBuf::kMallocSize;
 constexpr size_t MBufChain::MBuf::kPayloadSize;
-constexpr size_t MBufChain::kSizeMax;
+constexpr size_t MBufChain::MBuf::kPagePayloadSize;
+constexpr size_t MBufChain::kSizeMaxDefault;
+constexpr size_t MBufChain::kSizeMaxLimit;
+constexpr size_t MBufChain::kPageThreshold;
+constexpr size_t MBufChain::kPageFreelistMax;
 
 size_t MBufChain::MBuf::rem() const {
-    return kPayloadSize - (off_ + len_);
+    return cap_ - (off_ + len_);
 }
 
 MBufChain::~MBufChain() {
     while (!tail_.is_empty())
-        delete tail_.pop_front();
+        DestroyMBuf(tail_.pop_front());
     while (!freelist_.is_empty())
-        delete freelist_.pop_front();
+        DestroyMBuf(freelist_.pop_front());
+    while (!page_freelist_.is_empty())
+        DestroyMBuf(page_freelist_.pop_front());
 }
 
 bool MBufChain::is_full() const {
-    return size_ >= kSizeMax;
+    return size_ >= max_size_;
 }
 
 bool MBufChain::is_empty() const {
     return size_ == 0;
 }
 
+zx_status_t MBufChain::set_max_size(size_t max_size) {
+    if (max_size == 0 || max_size > kSizeMaxLimit)
+        return ZX_ERR_OUT_OF_RANGE;
+    max_size_ = max_size;
+    return ZX_OK;
+}
+
 size_t MBufChain::Read(user_out_ptr<void> dst, size_t len, bool datagram) {
+    return ReadCommon(dst, len, datagram);
+}
+
+size_t MBufChain::Read(user_out_iovec dst, size_t len, bool datagram) {
+    return ReadCommon(dst, len, datagram);
+}
+
+zx_status_t MBufChain::WriteDatagram(user_in_ptr<const void> src, size_t len,
+                                     size_t* written) {
+    return WriteDatagramCommon(src, len, written);
+}
+
+zx_status_t MBufChain::WriteDatagram(user_in_iovec src, size_t len, size_t* written) {
+    return WriteDatagramCommon(src, len, written);
+}
+
+zx_status_t MBufChain::WriteStream(user_in_ptr<const void> src, size_t len, size_t* written) {
+    return WriteStreamCommon(src, len, written);
+}
+
+zx_status_t MBufChain::WriteStream(user_in_iovec src, size_t len, size_t* written) {
+    return WriteStreamCommon(src, len, written);
+}
+
+// |PTR_OUT| is a user_out_ptr-like type.
+template <typename PTR_OUT>
+size_t MBufChain::ReadCommon(PTR_OUT dst, size_t len, bool datagram) {
     if (size_ == 0) {
         return 0;
     }
@@ -48,7 +94,7 @@ size_t MBufChain::Read(user_out_ptr<void> dst, size_t len, bool datagram) {
     size_t pos = 0;
     while (pos < len && !tail_.is_empty()) {
         MBuf& cur = tail_.front();
-        char* src = cur.data_ + cur.off_;
+        char* src = cur.data() + cur.off_;
         size_t copy_len = MIN(cur.len_, len - pos);
         if (dst.byte_offset(pos).copy_array_to_user(src, copy_len) != ZX_OK)
             return pos;
@@ -76,31 +122,39 @@ size_t MBufChain::Read(user_out_ptr<void> dst, size_t len, bool datagram) {
     return pos;
 }
 
-zx_status_t MBufChain::WriteDatagram(user_in_ptr<const void> src, size_t len,
-                                     size_t* written) {
+// |PTR_IN| is a user_in_ptr-like type.
+template <typename PTR_IN>
+zx_status_t MBufChain::WriteDatagramCommon(PTR_IN src, size_t len, size_t* written) {
     if (len == 0) {
         return ZX_ERR_INVALID_ARGS;
     }
-    if (len > kSizeMax)
+    if (len > max_size_)
         return ZX_ERR_OUT_OF_RANGE;
-    if (len + size_ > kSizeMax)
+    if (len + size_ > max_size_)
         return ZX_ERR_SHOULD_WAIT;
 
+    // Allocate the buffers in packet order, using page MBufs while at least a page worth of the
+    // datagram remains.  The list is built back to front, so reverse it afterwards.
     fbl::SinglyLinkedList<MBuf*> bufs;
-    for (size_t need = 1 + ((len - 1) / MBuf::kPayloadSize); need != 0; need--) {
-        auto buf = AllocMBuf();
+    for (size_t rem = len; rem != 0;) {
+        auto buf = AllocMBuf(rem >= kPageThreshold);
         if (buf == nullptr) {
             while (!bufs.is_empty())
                 FreeMBuf(bufs.pop_front());
             return ZX_ERR_SHOULD_WAIT;
         }
+        rem -= fbl::min(static_cast<size_t>(buf->cap_), rem);
         bufs.push_front(buf);
     }
+    fbl::SinglyLinkedList<MBuf*> ordered;
+    while (!bufs.is_empty())
+        ordered.push_front(bufs.pop_front());
+    bufs.swap(ordered);
 
     size_t pos = 0;
     for (auto& buf : bufs) {
-        size_t copy_len = fbl::min(MBuf::kPayloadSize, len - pos);
-        if (src.byte_offset(pos).copy_array_from_user(buf.data_, copy_len) != ZX_OK) {
+        size_t copy_len = fbl::min(static_cast<size_t>(buf.cap_), len - pos);
+        if (src.byte_offset(pos).copy_array_from_user(buf.data(), copy_len) != ZX_OK) {
             while (!bufs.is_empty())
                 FreeMBuf(bufs.pop_front());
             return ZX_ERR_INVALID_ARGS; // Bad user buffer.
@@ -127,9 +181,11 @@ zx_status_t MBufChain::WriteDatagram(user_in_ptr<const void> src, size_t len,
     return ZX_OK;
 }
 
-zx_status_t MBufChain::WriteStream(user_in_ptr<const void> src, size_t len, size_t* written) {
+// |PTR_IN| is a user_in_ptr-like type.
+template <typename PTR_IN>
+zx_status_t MBufChain::WriteStreamCommon(PTR_IN src, size_t len, size_t* written) {
     if (head_ == nullptr) {
-        head_ = AllocMBuf();
+        head_ = AllocMBuf(len >= kPageThreshold);
         if (head_ == nullptr)
             return ZX_ERR_SHOULD_WAIT;
         tail_.push_front(head_);
@@ -138,18 +194,19 @@ zx_status_t MBufChain::WriteStream(user_in_ptr<const void> src, size_t len, size
     size_t pos = 0;
     while (pos < len) {
         if (head_->rem() == 0) {
-            auto next = AllocMBuf();
+            auto next = AllocMBuf(len - pos >= kPageThreshold);
             if (next == nullptr)
                 break;
             tail_.insert_after(tail_.make_iterator(*head_), next);
             head_ = next;
         }
-        void* dst = head_->data_ + head_->off_ + head_->len_;
+        void* dst = head_->data() + head_->off_ + head_->len_;
         size_t copy_len = fbl::min(head_->rem(), len - pos);
-        if (size_ + copy_len > kSizeMax) {
-            copy_len = kSizeMax - size_;
-            if (copy_len == 0)
+        if (size_ + copy_len > max_size_) {
+            // The limit may have been lowered below the current size.
+            if (size_ >= max_size_)
                 break;
+            copy_len = max_size_ - size_;
         }
         if (src.byte_offset(pos).copy_array_from_user(dst, copy_len) != ZX_OK)
             break;
@@ -165,11 +222,24 @@ zx_status_t MBufChain::WriteStream(user_in_ptr<const void> src, size_t len, size
     return ZX_OK;
 }
 
-MBufChain::MBuf* MBufChain::AllocMBuf() {
+MBufChain::MBuf* MBufChain::AllocMBuf(bool page) {
+    if (page) {
+        if (!page_freelist_.is_empty()) {
+            --page_freelist_len_;
+            return page_freelist_.pop_front();
+        }
+        vm_page_t* vm_page;
+        paddr_t pa;
+        if (pmm_alloc_page(0, &vm_page, &pa) != ZX_OK)
+            return nullptr;
+        vm_page->state = VM_PAGE_STATE_IPC;
+        return new (paddr_to_physmap(pa)) MBuf(static_cast<uint32_t>(MBuf::kPagePayloadSize));
+    }
     if (freelist_.is_empty()) {
-        fbl::AllocChecker ac;
-        MBuf* buf = new (&ac) MBuf();
-        return (!ac.check()) ? nullptr : buf;
+        void* mem = malloc(MBuf::kMallocSize);
+        if (mem == nullptr)
+            return nullptr;
+        return new (mem) MBuf(static_cast<uint32_t>(MBuf::kPayloadSize));
     }
     return freelist_.pop_front();
 }
@@ -177,5 +247,24 @@ MBufChain::MBuf* MBufChain::AllocMBuf() {
 void MBufChain::FreeMBuf(MBuf* buf) {
     buf->off_ = 0u;
     buf->len_ = 0u;
-    freelist_.push_front(buf);
+    buf->pkt_len_ = 0u;
+    if (!buf->is_page()) {
+        freelist_.push_front(buf);
+    } else if (page_freelist_len_ < kPageFreelistMax) {
+        ++page_freelist_len_;
+        page_freelist_.push_front(buf);
+    } else {
+        DestroyMBuf(buf);
+    }
+}
+
+// static
+void MBufChain::DestroyMBuf(MBuf* buf) {
+    const bool page = buf->is_page();
+    buf->~MBuf();
+    if (page) {
+        pmm_free_page(paddr_to_vm_page(physmap_to_paddr(buf)));
+    } else {
+        free(buf);
+    }
 }
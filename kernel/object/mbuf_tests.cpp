@@ -6,9 +6,11 @@
 
 #include <object/mbuf.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/unique_ptr.h>
 #include <lib/unittest/unittest.h>
 #include <lib/unittest/user_memory.h>
+#include <lib/user_copy/user_iovec.h>
 
 namespace {
 
@@ -335,6 +337,115 @@ static bool datagram_write_huge_packet() {
     END_TEST;
 }
 
+// Tests that a large stream write round-trips through page-sized buffers, including a read that
+// straddles buffer boundaries.
+static bool stream_write_large() {
+    BEGIN_TEST;
+    constexpr size_t kWriteLen = 5 * PAGE_SIZE + 123;
+
+    fbl::unique_ptr<UserMemory> mem = UserMemory::Create(kWriteLen);
+    auto mem_in = make_user_in_ptr(mem->in());
+    auto mem_out = make_user_out_ptr(mem->out());
+
+    fbl::AllocChecker ac;
+    auto buf = fbl::unique_ptr<char[]>(new (&ac) char[kWriteLen]);
+    ASSERT_TRUE(ac.check(), "");
+    for (size_t i = 0; i < kWriteLen; ++i) {
+        buf[i] = static_cast<char>(i * 7);
+    }
+    ASSERT_EQ(ZX_OK, mem_out.copy_array_to_user(buf.get(), kWriteLen), "");
+
+    MBufChain chain;
+    size_t written = 0;
+    ASSERT_EQ(ZX_OK, chain.WriteStream(mem_in, kWriteLen, &written), "");
+    ASSERT_EQ(kWriteLen, written, "");
+    EXPECT_EQ(kWriteLen, chain.size(), "");
+
+    // Read it back in two uneven pieces.
+    constexpr size_t kFirst = PAGE_SIZE + 1;
+    auto actual = fbl::unique_ptr<char[]>(new (&ac) char[kWriteLen]);
+    ASSERT_TRUE(ac.check(), "");
+    ASSERT_EQ(kFirst, chain.Read(mem_out, kFirst, false), "");
+    ASSERT_EQ(ZX_OK, mem_in.copy_array_from_user(actual.get(), kFirst), "");
+    ASSERT_EQ(kWriteLen - kFirst, chain.Read(mem_out, kWriteLen, false), "");
+    ASSERT_EQ(ZX_OK, mem_in.copy_array_from_user(actual.get() + kFirst, kWriteLen - kFirst), "");
+    EXPECT_TRUE(chain.is_empty(), "");
+    EXPECT_EQ(0, memcmp(buf.get(), actual.get(), kWriteLen), "");
+    END_TEST;
+}
+
+// Tests gathering a datagram from several user buffers and scattering it back out.
+static bool datagram_iovec() {
+    BEGIN_TEST;
+    constexpr size_t kLen = 2 * PAGE_SIZE + 10;
+    fbl::unique_ptr<UserMemory> mem = UserMemory::Create(kLen);
+    auto mem_in = make_user_in_ptr(mem->in());
+    auto mem_out = make_user_out_ptr(mem->out());
+
+    fbl::AllocChecker ac;
+    auto buf = fbl::unique_ptr<char[]>(new (&ac) char[kLen]);
+    ASSERT_TRUE(ac.check(), "");
+    for (size_t i = 0; i < kLen; ++i) {
+        buf[i] = static_cast<char>(i);
+    }
+    ASSERT_EQ(ZX_OK, mem_out.copy_array_to_user(buf.get(), kLen), "");
+
+    char* base = static_cast<char*>(mem->out());
+    const zx_iovec_t vec[] = {
+        {base, 10u},
+        {base + 10, 0u},
+        {base + 10, kLen - 10},
+    };
+
+    MBufChain chain;
+    size_t written = 0;
+    ASSERT_EQ(ZX_OK, chain.WriteDatagram(user_in_iovec(vec, fbl::count_of(vec)), kLen, &written),
+              "");
+    ASSERT_EQ(kLen, written, "");
+    EXPECT_EQ(kLen, chain.size(true), "");
+
+    memset(buf.get(), 0, kLen);
+    ASSERT_EQ(ZX_OK, mem_out.copy_array_to_user(buf.get(), kLen), "");
+    ASSERT_EQ(kLen, chain.Read(user_out_iovec(vec, fbl::count_of(vec)), kLen, true), "");
+    EXPECT_TRUE(chain.is_empty(), "");
+    ASSERT_EQ(ZX_OK, mem_in.copy_array_from_user(buf.get(), kLen), "");
+    for (size_t i = 0; i < kLen; ++i) {
+        ASSERT_EQ(static_cast<char>(i), buf[i], "");
+    }
+    END_TEST;
+}
+
+// Tests changing the maximum size of the chain.
+static bool set_max_size() {
+    BEGIN_TEST;
+    MBufChain chain;
+    EXPECT_EQ(MBufChain::kSizeMaxDefault, chain.max_size(), "");
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, chain.set_max_size(0), "");
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, chain.set_max_size(MBufChain::kSizeMaxLimit + 1), "");
+
+    constexpr size_t kWriteLen = 100;
+    fbl::unique_ptr<UserMemory> mem = UserMemory::Create(kWriteLen);
+    auto mem_in = make_user_in_ptr(mem->in());
+    auto mem_out = make_user_out_ptr(mem->out());
+
+    ASSERT_EQ(ZX_OK, chain.set_max_size(kWriteLen), "");
+    size_t written = 0;
+    ASSERT_EQ(ZX_OK, chain.WriteStream(mem_in, kWriteLen, &written), "");
+    EXPECT_EQ(kWriteLen, written, "");
+    EXPECT_TRUE(chain.is_full(), "");
+    EXPECT_EQ(0u, chain.free_size(), "");
+
+    // Shrinking below the current size keeps the data but refuses further writes.
+    ASSERT_EQ(ZX_OK, chain.set_max_size(kWriteLen / 2), "");
+    EXPECT_EQ(kWriteLen, chain.size(), "");
+    EXPECT_EQ(ZX_ERR_SHOULD_WAIT, chain.WriteStream(mem_in, 1, &written), "");
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, chain.WriteDatagram(mem_in, kWriteLen, &written), "");
+    EXPECT_EQ(kWriteLen, chain.Read(mem_out, kWriteLen, false), "");
+    EXPECT_FALSE(chain.is_full(), "");
+    EXPECT_EQ(kWriteLen / 2, chain.free_size(), "");
+    END_TEST;
+}
+
 } // namespace
 
 UNITTEST_START_TESTCASE(mbuf_tests)
@@ -351,4 +462,7 @@ UNITTEST("datagram_write_basic", datagram_write_basic)
 UNITTEST("datagram_write_zero", datagram_write_zero)
 UNITTEST("datagram_write_too_much", datagram_write_too_much)
 UNITTEST("datagram_write_huge_packet", datagram_write_huge_packet)
+UNITTEST("stream_write_large", stream_write_large)
+UNITTEST("datagram_iovec", datagram_iovec)
+UNITTEST("set_max_size", set_max_size)
 UNITTEST_END_TESTCASE(mbuf_tests, "mbuf", "MBuf test");
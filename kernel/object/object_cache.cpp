@@ -0,0 +1,130 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/object_cache.h>
+
+#include <arch/ops.h>
+#include <inttypes.h>
+#include <kernel/auto_lock.h>
+#include <lib/counters.h>
+#include <printf.h>
+#include <string.h>
+
+KCOUNTER(object_cache_slab_alloc_count, "kernel.object_cache.slab.alloc");
+KCOUNTER(object_cache_slab_free_count, "kernel.object_cache.slab.free");
+
+namespace {
+
+// The registered caches. Caches are global objects, so they are all
+// registered by the time the kernel runs anything that could allocate from
+// them, and they are never unregistered.
+ObjectCacheBase* cache_list_head = nullptr;
+size_t cache_list_count = 0;
+
+}  // namespace
+
+ObjectCacheBase::ObjectCacheBase(const char* name, size_t object_size)
+    : name_(name), object_size_(object_size), next_(nullptr) {
+    // Append so the list stays in registration order for stable output.
+    ObjectCacheBase** link = &cache_list_head;
+    while (*link != nullptr) {
+        link = &(*link)->next_;
+    }
+    *link = this;
+    cache_list_count++;
+}
+
+void* ObjectCacheBase::Alloc(size_t size, fbl::AllocChecker* ac) {
+    void* ptr = nullptr;
+    {
+        CpuCache& cache = cpu_caches_[arch_curr_cpu_num()];
+        AutoSpinLock guard(&cache.lock);
+        cache.alloc_count++;
+        if (cache.count > 0) {
+            ptr = cache.objects[--cache.count];
+            cache.hits++;
+        }
+    }
+
+    if (ptr == nullptr) {
+        ptr = SlabAlloc();
+        kcounter_add(object_cache_slab_alloc_count, 1);
+    }
+
+    ac->arm(size, ptr != nullptr);
+    return ptr;
+}
+
+void ObjectCacheBase::Free(void* ptr) {
+    {
+        // We may have migrated since the object was allocated; that's fine,
+        // any cpu's cache can take it.
+        CpuCache& cache = cpu_caches_[arch_curr_cpu_num()];
+        AutoSpinLock guard(&cache.lock);
+        cache.free_count++;
+        if (cache.count < kCpuCacheSize) {
+            cache.objects[cache.count++] = ptr;
+            return;
+        }
+    }
+
+    SlabFree(ptr);
+    kcounter_add(object_cache_slab_free_count, 1);
+}
+
+void ObjectCacheBase::GetInfo(zx_info_object_cache_t* info) const {
+    memset(info, 0, sizeof(*info));
+    strlcpy(info->name, name_, sizeof(info->name));
+    info->object_size = object_size_;
+    info->slab_count = slab_count();
+    info->slab_bytes = info->slab_count * slab_size();
+
+    uint64_t cached = 0;
+    for (const CpuCache& cache : cpu_caches_) {
+        AutoSpinLock guard(&cache.lock);
+        cached += cache.count;
+        info->alloc_count += cache.alloc_count;
+        info->free_count += cache.free_count;
+        info->cpu_cache_hits += cache.hits;
+    }
+    info->cached_objects = cached;
+    info->heap_objects = heap_obj_count();
+
+    // Racy with respect to the per-cpu caches, so clamp rather than wrap.
+    uint64_t handed_out = obj_count();
+    info->live_objects = handed_out > cached ? handed_out - cached : 0u;
+}
+
+// static
+size_t ObjectCacheBase::Count() {
+    return cache_list_count;
+}
+
+// static
+const ObjectCacheBase* ObjectCacheBase::Get(size_t index) {
+    const ObjectCacheBase* cache = cache_list_head;
+    while (cache != nullptr && index-- > 0) {
+        cache = cache->next_;
+    }
+    return cache;
+}
+
+// static
+void ObjectCacheBase::DumpAll() {
+    printf("%-16s %6s %6s %9s %9s %9s %9s %12s %12s %12s\n",
+           "name", "size", "slabs", "slab KB", "live", "cached", "heap",
+           "allocs", "frees", "cpu hits");
+    for (const ObjectCacheBase* cache = cache_list_head; cache != nullptr;
+         cache = cache->next_) {
+        zx_info_object_cache_t info;
+        cache->GetInfo(&info);
+        printf("%-16s %6" PRIu64 " %6" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64
+               " %9" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+               info.name, info.object_size, info.slab_count, info.slab_bytes / 1024,
+               info.live_objects, info.cached_objects, info.heap_objects, info.alloc_count,
+               info.free_count, info.cpu_cache_hits);
+    }
+}
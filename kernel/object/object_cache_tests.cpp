@@ -0,0 +1,102 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/object_cache.h>
+
+#include <fbl/slab_allocator.h>
+#include <lib/unittest/unittest.h>
+#include <object/event_dispatcher.h>
+#include <string.h>
+
+namespace {
+
+// Other cpus may be creating and destroying events while these tests run, so
+// the checks below only assert lower bounds on the shared "event" cache.
+
+static const ObjectCacheBase* find_cache(const char* name) {
+    for (size_t i = 0; i < ObjectCacheBase::Count(); i++) {
+        zx_info_object_cache_t info;
+        ObjectCacheBase::Get(i)->GetInfo(&info);
+        if (strcmp(info.name, name) == 0) {
+            return ObjectCacheBase::Get(i);
+        }
+    }
+    return nullptr;
+}
+
+static bool registered() {
+    BEGIN_TEST;
+    EXPECT_GE(ObjectCacheBase::Count(), 8u, "");
+    EXPECT_NONNULL(find_cache("channel"), "");
+    EXPECT_NONNULL(find_cache("event"), "");
+    EXPECT_NONNULL(find_cache("port-observer"), "");
+    EXPECT_NULL(find_cache("no-such-cache"), "");
+    EXPECT_NULL(ObjectCacheBase::Get(ObjectCacheBase::Count()), "");
+    END_TEST;
+}
+
+static bool slab_accounting() {
+    BEGIN_TEST;
+    const ObjectCacheBase* cache = find_cache("event");
+    ASSERT_NONNULL(cache, "");
+
+    zx_info_object_cache_t info;
+    cache->GetInfo(&info);
+    EXPECT_EQ(sizeof(EventDispatcher), info.object_size, "");
+    EXPECT_EQ(info.slab_count * fbl::DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE, info.slab_bytes, "");
+    EXPECT_LE(info.slab_count, ObjectCache<EventDispatcher>::kMaxSlabs, "");
+    EXPECT_LE(info.cpu_cache_hits, info.alloc_count, "");
+    END_TEST;
+}
+
+static bool alloc_free_counts() {
+    BEGIN_TEST;
+    constexpr size_t kCount = 64;
+    const ObjectCacheBase* cache = find_cache("event");
+    ASSERT_NONNULL(cache, "");
+
+    zx_info_object_cache_t before;
+    cache->GetInfo(&before);
+
+    fbl::RefPtr<Dispatcher> events[kCount];
+    for (auto& event : events) {
+        zx_rights_t rights;
+        ASSERT_EQ(ZX_OK, EventDispatcher::Create(0u, &event, &rights), "");
+    }
+
+    zx_info_object_cache_t during;
+    cache->GetInfo(&during);
+    EXPECT_GE(during.alloc_count, before.alloc_count + kCount, "");
+    EXPECT_GE(during.live_objects, kCount, "");
+    // Every cached object ultimately comes from a slab or, past the slab
+    // limit, the heap.
+    EXPECT_GT(during.slab_count + during.heap_objects, 0u, "");
+
+    for (auto& event : events) {
+        event.reset();
+    }
+
+    zx_info_object_cache_t after;
+    cache->GetInfo(&after);
+    EXPECT_GE(after.free_count, before.free_count + kCount, "");
+    // Freed objects are recycled, so a second round should hit the per-cpu caches.
+    for (auto& event : events) {
+        zx_rights_t rights;
+        ASSERT_EQ(ZX_OK, EventDispatcher::Create(0u, &event, &rights), "");
+        event.reset();
+    }
+    cache->GetInfo(&after);
+    EXPECT_GE(after.cpu_cache_hits, during.cpu_cache_hits + 1, "");
+    END_TEST;
+}
+
+} // namespace
+
+UNITTEST_START_TESTCASE(object_cache_tests)
+UNITTEST("registered", registered)
+UNITTEST("slab_accounting", slab_accounting)
+UNITTEST("alloc_free_counts", alloc_free_counts)
+UNITTEST_END_TESTCASE(object_cache_tests, "object_cache", "Object cache tests");
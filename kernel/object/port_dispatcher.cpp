@@ -37,6 +37,9 @@ static_assert(sizeof(zx_packet_guest_vcpu_t) == sizeof(zx_packet_user_t),
 KCOUNTER(port_arena_count, "kernel.port.arena.count");
 KCOUNTER(port_full_count, "kernel.port.full.count");
 
+DEFINE_OBJECT_CACHE(PortDispatcher, "port");
+DEFINE_OBJECT_CACHE(PortObserver, "port-observer");
+
 class ArenaPortAllocator final : public PortAllocator {
 public:
     zx_status_t Init();
@@ -81,7 +84,7 @@ PortPacket::PortPacket(const void* handle, PortAllocator* allocator)
     // Note that packet is initialized to zeros.
     if (handle) {
         // Currently |handle| is only valid if the packets are not ephemeral
-        // which means that PortObserver always uses the kernel heap.
+        // which means that the packet is embedded in a PortObserver.
         DEBUG_ASSERT(allocator == nullptr);
     }
 }
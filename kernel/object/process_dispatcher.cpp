@@ -65,6 +65,14 @@ zx_status_t ProcessDispatcher::Create(
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
+    if (ThreadDispatcher::syscall_stats_enabled()) {
+        Guard<fbl::Mutex> guard{process->get_lock()};
+        process->exited_syscalls_.reset(
+            new (&ac) ThreadDispatcher::SyscallStats[ZX_SYS_COUNT]());
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+    }
+
     if (!job->AddChildProcess(process))
         return ZX_ERR_BAD_STATE;
 
@@ -279,9 +287,10 @@ void ProcessDispatcher::RemoveThread(ThreadDispatcher* t) {
         // we're going to check for state and possibly transition below
         Guard<fbl::Mutex> guard{get_lock()};
 
-        // remove the thread from our list
+        // remove the thread from our list, keeping its counts
         DEBUG_ASSERT(t != nullptr);
         thread_list_.erase(*t);
+        t->AccumulateStats(&exited_faults_, exited_syscalls_.get());
 
         // if this was the last thread, transition directly to DEAD state
         if (thread_list_.is_empty()) {
@@ -557,6 +566,20 @@ zx_status_t ProcessDispatcher::GetStats(zx_info_task_stats_t* stats) {
     return ZX_OK;
 }
 
+void ProcessDispatcher::GetThreadStats(zx_info_task_faults_t* faults,
+                                      ThreadDispatcher::SyscallStats* syscalls) {
+    DEBUG_ASSERT(faults != nullptr);
+    Guard<fbl::Mutex> guard{get_lock()};
+    *faults = exited_faults_;
+    if (syscalls != nullptr && exited_syscalls_) {
+        memcpy(syscalls, exited_syscalls_.get(),
+               ZX_SYS_COUNT * sizeof(ThreadDispatcher::SyscallStats));
+    }
+    for (const auto& thread : thread_list_) {
+        thread.AccumulateStats(faults, syscalls);
+    }
+}
+
 zx_status_t ProcessDispatcher::GetAspaceMaps(
     user_out_ptr<zx_info_maps_t> maps, size_t max,
     size_t* actual, size_t* available) {
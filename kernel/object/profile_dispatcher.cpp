@@ -6,7 +6,10 @@
 
 #include <object/profile_dispatcher.h>
 
+#include <arch/ops.h>
 #include <err.h>
+#include <kernel/cpu.h>
+#include <limits.h>
 
 #include <fbl/alloc_checker.h>
 #include <fbl/ref_ptr.h>
@@ -16,12 +19,23 @@
 #include <zircon/rights.h>
 
 zx_status_t validate_profile(const zx_profile_info_t& info) {
-    if (info.type != ZX_PROFILE_INFO_SCHEDULER)
+    switch (info.type) {
+    case ZX_PROFILE_INFO_SCHEDULER:
+        if ((info.scheduler.priority < LOWEST_PRIORITY) ||
+            (info.scheduler.priority  > HIGHEST_PRIORITY))
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    case ZX_PROFILE_INFO_CPU_MASK: {
+        cpu_mask_t valid = (arch_max_num_cpus() < sizeof(cpu_mask_t) * CHAR_BIT)
+                               ? cpu_num_to_mask(arch_max_num_cpus()) - 1
+                               : CPU_MASK_ALL;
+        if (info.cpu_mask.mask == 0 || (info.cpu_mask.mask & ~valid) != 0)
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    }
+    default:
         return ZX_ERR_NOT_SUPPORTED;
-    if ((info.scheduler.priority < LOWEST_PRIORITY) ||
-        (info.scheduler.priority  > HIGHEST_PRIORITY))
-        return ZX_ERR_INVALID_ARGS;
-    return ZX_OK;
+    }
 }
 
 zx_status_t ProfileDispatcher::Create(const zx_profile_info_t& info,
@@ -48,6 +62,12 @@ ProfileDispatcher::~ProfileDispatcher() {
 }
 
 zx_status_t ProfileDispatcher::ApplyProfile(fbl::RefPtr<ThreadDispatcher> thread) {
-    // At the moment, the only thing we support is the priority.
-    return thread->SetPriority(info_.scheduler.priority);
+    switch (info_.type) {
+    case ZX_PROFILE_INFO_SCHEDULER:
+        return thread->SetPriority(info_.scheduler.priority);
+    case ZX_PROFILE_INFO_CPU_MASK:
+        return thread->SetCpuAffinity(info_.cpu_mask.mask);
+    default:
+        return ZX_ERR_NOT_SUPPORTED;
+    }
 }
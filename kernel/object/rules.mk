@@ -32,6 +32,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/log_dispatcher.cpp \
     $(LOCAL_DIR)/mbuf.cpp \
     $(LOCAL_DIR)/message_packet.cpp \
+    $(LOCAL_DIR)/object_cache.cpp \
     $(LOCAL_DIR)/pci_device_dispatcher.cpp \
     $(LOCAL_DIR)/pci_interrupt_dispatcher.cpp \
     $(LOCAL_DIR)/pinned_memory_token_dispatcher.cpp \
@@ -57,6 +58,7 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/buffer_chain_tests.cpp \
     $(LOCAL_DIR)/mbuf_tests.cpp \
     $(LOCAL_DIR)/message_packet_tests.cpp \
+    $(LOCAL_DIR)/object_cache_tests.cpp \
     $(LOCAL_DIR)/state_tracker_tests.cpp \
 
 MODULE_DEPS := \
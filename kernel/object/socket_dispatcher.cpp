@@ -24,6 +24,8 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 
+DEFINE_OBJECT_CACHE(SocketDispatcher, "socket");
+
 #define LOCAL_TRACE 0
 
 // static
@@ -183,7 +185,18 @@ zx_status_t SocketDispatcher::ShutdownOtherLocked(uint32_t how) {
 }
 
 zx_status_t SocketDispatcher::Write(user_in_ptr<const void> src, size_t len,
-                                    size_t* nwritten) TA_NO_THREAD_SAFETY_ANALYSIS {
+                                    size_t* nwritten) {
+    return WriteCommon(src, len, nwritten);
+}
+
+zx_status_t SocketDispatcher::Write(user_in_iovec src, size_t len, size_t* nwritten) {
+    return WriteCommon(src, len, nwritten);
+}
+
+// |PTR_IN| is a user_in_ptr-like type.
+template <typename PTR_IN>
+zx_status_t SocketDispatcher::WriteCommon(PTR_IN src, size_t len,
+                                          size_t* nwritten) TA_NO_THREAD_SAFETY_ANALYSIS {
     canary_.Assert();
 
     LTRACE_ENTRY;
@@ -245,7 +258,8 @@ zx_status_t SocketDispatcher::WriteControlSelfLocked(user_in_ptr<const void> src
     return ZX_OK;
 }
 
-zx_status_t SocketDispatcher::WriteSelfLocked(user_in_ptr<const void> src, size_t len,
+template <typename PTR_IN>
+zx_status_t SocketDispatcher::WriteSelfLocked(PTR_IN src, size_t len,
                                               size_t* written) TA_NO_THREAD_SAFETY_ANALYSIS {
     canary_.Assert();
 
@@ -280,7 +294,7 @@ zx_status_t SocketDispatcher::WriteSelfLocked(user_in_ptr<const void> src, size_
             size_t peer_write_threshold = peer_->write_threshold_;
             // If free space falls below threshold, de-signal
             if ((peer_write_threshold > 0) &&
-                ((data_.max_size() - data_.size()) < peer_write_threshold))
+                (data_.free_size() < peer_write_threshold))
                 clear |= ZX_SOCKET_WRITE_THRESHOLD;
         }
     }
@@ -297,18 +311,30 @@ zx_status_t SocketDispatcher::WriteSelfLocked(user_in_ptr<const void> src, size_
 
 zx_status_t SocketDispatcher::Read(user_out_ptr<void> dst, size_t len,
                                    size_t* nread) TA_NO_THREAD_SAFETY_ANALYSIS {
+    if (!dst && len == 0) {
+        // Just query for bytes outstanding.
+        canary_.Assert();
+        Guard<fbl::Mutex> guard{get_lock()};
+        *nread = data_.size(flags_ & ZX_SOCKET_DATAGRAM);
+        return ZX_OK;
+    }
+    return ReadCommon(dst, len, nread);
+}
+
+zx_status_t SocketDispatcher::Read(user_out_iovec dst, size_t len, size_t* nread) {
+    return ReadCommon(dst, len, nread);
+}
+
+// |PTR_OUT| is a user_out_ptr-like type.
+template <typename PTR_OUT>
+zx_status_t SocketDispatcher::ReadCommon(PTR_OUT dst, size_t len,
+                                         size_t* nread) TA_NO_THREAD_SAFETY_ANALYSIS {
     canary_.Assert();
 
     LTRACE_ENTRY;
 
     Guard<fbl::Mutex> guard{get_lock()};
 
-    // Just query for bytes outstanding.
-    if (!dst && len == 0) {
-        *nread = data_.size(flags_ & ZX_SOCKET_DATAGRAM);
-        return ZX_OK;
-    }
-
     if (len != (size_t)((uint32_t)len))
         return ZX_ERR_INVALID_ARGS;
 
@@ -345,7 +371,7 @@ zx_status_t SocketDispatcher::Read(user_out_ptr<void> dst, size_t len,
         // threshold.
         size_t peer_write_threshold = peer_->write_threshold_;
         if (peer_write_threshold > 0 &&
-            ((data_.max_size() - data_.size()) >= peer_write_threshold))
+            (data_.free_size() >= peer_write_threshold))
             set |= ZX_SOCKET_WRITE_THRESHOLD;
         if (was_full && (st > 0))
             set |= ZX_SOCKET_WRITABLE;
@@ -450,6 +476,41 @@ size_t SocketDispatcher::ReceiveBufferMax() const {
     return data_.max_size();
 }
 
+zx_status_t SocketDispatcher::SetReceiveBufferMax(size_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
+    canary_.Assert();
+    Guard<fbl::Mutex> guard{get_lock()};
+    if (value < read_threshold_)
+        return ZX_ERR_INVALID_ARGS;
+    if (peer_ && value < peer_->write_threshold_)
+        return ZX_ERR_INVALID_ARGS;
+    zx_status_t status = data_.set_max_size(value);
+    if (status != ZX_OK)
+        return status;
+
+    // Our receive buffer is our peer's transmit buffer, so re-evaluate the peer's writability.
+    if (peer_) {
+        zx_signals_t clear = 0u;
+        zx_signals_t set = 0u;
+        if (!(peer_->GetSignalsStateLocked() & ZX_SOCKET_WRITE_DISABLED)) {
+            if (is_full()) {
+                clear |= ZX_SOCKET_WRITABLE;
+            } else {
+                set |= ZX_SOCKET_WRITABLE;
+            }
+        }
+        size_t peer_write_threshold = peer_->write_threshold_;
+        if (peer_write_threshold > 0) {
+            if (data_.free_size() >= peer_write_threshold) {
+                set |= ZX_SOCKET_WRITE_THRESHOLD;
+            } else {
+                clear |= ZX_SOCKET_WRITE_THRESHOLD;
+            }
+        }
+        peer_->UpdateStateLocked(clear, set);
+    }
+    return ZX_OK;
+}
+
 size_t SocketDispatcher::ReceiveBufferSize() const {
     canary_.Assert();
     Guard<fbl::Mutex> guard{get_lock()};
@@ -531,7 +592,7 @@ zx_status_t SocketDispatcher::SetWriteThreshold(size_t value) TA_NO_THREAD_SAFET
         UpdateStateLocked(ZX_SOCKET_WRITE_THRESHOLD, 0u);
     } else {
         // Assert signal if we have available space above the write threshold
-        if ((peer_->data_.max_size() - peer_->data_.size()) >= write_threshold_) {
+        if (peer_->data_.free_size() >= write_threshold_) {
             // Assert signal if we have available space above the write threshold
             UpdateStateLocked(0u, ZX_SOCKET_WRITE_THRESHOLD);
         } else {
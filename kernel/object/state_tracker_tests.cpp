@@ -22,6 +22,10 @@ public:
         UpdateState(0, 1);
     }
 
+    void CallUpdateState(zx_signals_t clear_mask, zx_signals_t set_mask) {
+        UpdateState(clear_mask, set_mask);
+    }
+
     // Helper: Causes most On*() hooks (except for OnInitialized) to
     // be called on all of |st|'s observers.
     void CallAllOnHooks() {
@@ -180,6 +184,81 @@ bool on_cancel_by_key() {
 
 } // namespace removal
 
+// Tests for signal updates with and without observers attached
+namespace signals {
+
+class RecordingObserver : public StateObserver {
+public:
+    RecordingObserver() = default;
+
+    zx_signals_t last_state() const { return last_state_; }
+    int changes() const { return changes_; }
+
+private:
+    Flags OnInitialize(zx_signals_t initial_state,
+                       const StateObserver::CountInfo* cinfo) override {
+        last_state_ = initial_state;
+        return 0;
+    }
+    Flags OnStateChange(zx_signals_t new_state) override {
+        last_state_ = new_state;
+        changes_++;
+        return 0;
+    }
+    Flags OnCancel(const Handle* handle) override { return kNeedRemoval; }
+
+    zx_signals_t last_state_ = 0u;
+    int changes_ = 0;
+};
+
+bool unobserved_updates_are_visible() {
+    BEGIN_TEST;
+
+    TestDispatcher st;
+
+    // No observers: these take the lock-free path.
+    st.CallUpdateState(0u, ZX_USER_SIGNAL_0 | ZX_USER_SIGNAL_1);
+    st.CallUpdateState(ZX_USER_SIGNAL_0, 0u);
+
+    RecordingObserver obs;
+    st.AddObserver(&obs, nullptr);
+    EXPECT_EQ(ZX_USER_SIGNAL_1, obs.last_state(), "");
+    EXPECT_EQ(0, obs.changes(), "");
+
+    END_TEST;
+}
+
+bool observed_updates_notify() {
+    BEGIN_TEST;
+
+    TestDispatcher st;
+    RecordingObserver obs;
+    st.AddObserver(&obs, nullptr);
+
+    st.CallUpdateState(0u, ZX_USER_SIGNAL_2);
+    EXPECT_EQ(1, obs.changes(), "");
+    EXPECT_EQ(ZX_USER_SIGNAL_2, obs.last_state(), "");
+
+    // Updates that change nothing do not notify.
+    st.CallUpdateState(0u, ZX_USER_SIGNAL_2);
+    EXPECT_EQ(1, obs.changes(), "");
+
+    // Once the last observer is gone, updates stop reaching it but are
+    // still recorded.
+    st.Cancel(/* handle= */ nullptr);
+    st.CallUpdateState(ZX_USER_SIGNAL_2, ZX_USER_SIGNAL_3);
+    EXPECT_EQ(1, obs.changes(), "");
+
+    RecordingObserver obs2;
+    st.AddObserver(&obs2, nullptr);
+    EXPECT_EQ(ZX_USER_SIGNAL_3, obs2.last_state(), "");
+    st.RemoveObserver(&obs2);
+
+    END_TEST;
+}
+
+} // namespace signals
+
 #define ST_UNITTEST(fname) UNITTEST(#fname, fname)
 
 UNITTEST_START_TESTCASE(state_tracker_tests)
@@ -188,6 +267,8 @@ ST_UNITTEST(removal::on_initialize)
 ST_UNITTEST(removal::on_state_change_via_update_state)
 ST_UNITTEST(removal::on_cancel)
 ST_UNITTEST(removal::on_cancel_by_key)
+ST_UNITTEST(signals::unobserved_updates_are_visible)
+ST_UNITTEST(signals::observed_updates_notify)
 
 UNITTEST_END_TESTCASE(
     state_tracker_tests, "statetracker", "StateTracker test");
@@ -16,7 +16,11 @@
 #include <arch/debugger.h>
 #include <arch/exception.h>
 
+#include <kernel/cmdline.h>
+#include <kernel/mp.h>
 #include <kernel/thread.h>
+#include <kernel/thread_lock.h>
+#include <lk/init.h>
 #include <vm/kstack.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
@@ -40,6 +44,19 @@
 
 #define LOCAL_TRACE 0
 
+bool ThreadDispatcher::syscall_stats_enabled_ = false;
+
+// static
+void ThreadDispatcher::InitSyscallStats() {
+    syscall_stats_enabled_ = cmdline_get_bool("kernel.syscall-stats", false);
+}
+
+static void syscall_stats_init_hook(uint) {
+    ThreadDispatcher::InitSyscallStats();
+}
+
+LK_INIT_HOOK(syscall_stats, syscall_stats_init_hook, LK_INIT_LEVEL_THREADING - 1);
+
 // static
 zx_status_t ThreadDispatcher::Create(fbl::RefPtr<ProcessDispatcher> process, uint32_t flags,
                                      fbl::StringPiece name,
@@ -50,6 +67,12 @@ zx_status_t ThreadDispatcher::Create(fbl::RefPtr<ProcessDispatcher> process, uin
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
+    if (syscall_stats_enabled_) {
+        disp->syscall_stats_.reset(new (&ac) SyscallStats[ZX_SYS_COUNT]());
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+    }
+
     auto result = disp->Initialize(name.data(), name.length());
     if (result != ZX_OK)
         return result;
@@ -838,9 +861,30 @@ zx_status_t ThreadDispatcher::GetStatsForUserspace(zx_info_thread_stats_t* info)
     *info = {};
 
     info->total_runtime = runtime_ns();
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+    info->last_scheduled_cpu =
+        thread_.last_cpu == INVALID_CPU ? ZX_INFO_INVALID_CPU : thread_.last_cpu;
     return ZX_OK;
 }
 
+void ThreadDispatcher::AccumulateStats(zx_info_task_faults_t* faults,
+                                       SyscallStats* syscalls) const {
+    canary_.Assert();
+
+    faults->read_faults += thread_.page_faults.read;
+    faults->write_faults += thread_.page_faults.write;
+    faults->cow_faults += thread_.page_faults.cow;
+    faults->zero_fill_faults += thread_.page_faults.zero_fill;
+
+    if (syscalls == nullptr || !syscall_stats_)
+        return;
+    for (size_t i = 0; i < ZX_SYS_COUNT; i++) {
+        syscalls[i].count += syscall_stats_[i].count;
+        syscalls[i].time += syscall_stats_[i].time;
+    }
+}
+
 zx_status_t ThreadDispatcher::GetExceptionReport(zx_exception_report_t* report) {
     canary_.Assert();
 
@@ -975,6 +1019,22 @@ zx_status_t ThreadDispatcher::SetPriority(int32_t priority) {
     return ZX_OK;
 }
 
+zx_status_t ThreadDispatcher::SetCpuAffinity(cpu_mask_t mask) {
+    Guard<fbl::Mutex> guard{get_lock()};
+    if ((state_.lifecycle() == ThreadState::Lifecycle::INITIAL) ||
+        (state_.lifecycle() == ThreadState::Lifecycle::DYING) ||
+        (state_.lifecycle() == ThreadState::Lifecycle::DEAD)) {
+        return ZX_ERR_BAD_STATE;
+    }
+    // The mask was validated against the possible cpus by the Profile
+    // dispatcher, but at least one of them must also be online.
+    if ((mask & mp_get_active_mask()) == 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    thread_set_cpu_affinity(&thread_, mask);
+    return ZX_OK;
+}
+
 void get_user_thread_process_name(const void* user_thread,
                                   char out_name[ZX_MAX_NAME_LEN]) {
     const ThreadDispatcher* ut =
@@ -18,6 +18,8 @@
 #include <zircon/rights.h>
 #include <zircon/types.h>
 
+DEFINE_OBJECT_CACHE(TimerDispatcher, "timer");
+
 static void timer_irq_callback(timer* timer, zx_time_t now, void* arg) {
     // We are in IRQ context and cannot touch the timer state_tracker, so we
     // schedule a DPC to do so. TODO(cpu): figure out ways to reduce the lag.
@@ -14,6 +14,7 @@ MODULES += \
     kernel/lib/debuglog \
     kernel/lib/ktrace \
     kernel/lib/mtrace \
+    kernel/lib/sampler \
     kernel/object \
     kernel/syscalls \
 
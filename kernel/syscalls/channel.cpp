@@ -32,10 +32,12 @@ KCOUNTER(channel_msg_1k_bytes,  "kernel.channel.bytes.1k");
 KCOUNTER(channel_msg_4k_bytes,  "kernel.channel.bytes.4k");
 KCOUNTER(channel_msg_16k_bytes, "kernel.channel.bytes.16k");
 KCOUNTER(channel_msg_64k_bytes, "kernel.channel.bytes.64k");
+KCOUNTER_HISTOGRAM(channel_msg_size, "kernel.channel.msg_size");
 KCOUNTER(channel_msg_received,  "kernel.channel.messages");
 
 static void record_recv_msg_sz(uint32_t size) {
     kcounter_add(channel_msg_received, 1);
+    kcounter_histogram_add(channel_msg_size, size);
 
     switch(size) {
         case     0          : kcounter_add(channel_msg_0_bytes, 1);   break;
@@ -364,7 +366,8 @@ zx_status_t sys_channel_call_noretry(zx_handle_t handle_value, uint32_t options,
             return status;
     }
 
-    // TODO(ZX-970): ktrace channel calls; maybe two traces, maybe with txid.
+    // Call() emits the IPC_FLOW records for the request and the reply,
+    // since only it knows the txid.
 
     // Write message and wait for reply, deadline, or cancelation
     fbl::unique_ptr<MessagePacket> reply;
@@ -21,6 +21,7 @@
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
 #include <object/resource.h>
+#include <object/vm_object_dispatcher.h>
 
 #include <platform/debug.h>
 
@@ -145,6 +146,29 @@ zx_status_t sys_ktrace_control(
         name[sizeof(name) - 1] = 0;
         return ktrace_control(action, options, name);
     }
+    case KTRACE_ACTION_GET_VMO: {
+        fbl::RefPtr<VmObject> vmo;
+        if ((status = ktrace_get_vmo(options, &vmo)) != ZX_OK)
+            return status;
+        fbl::RefPtr<Dispatcher> dispatcher;
+        zx_rights_t rights;
+        if ((status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights)) != ZX_OK)
+            return status;
+        // The buffer is written with interrupts disabled, so consumers
+        // only get to read it (and can't decommit it); they advance
+        // their tails through the control VMO instead.
+        rights &= ~(ZX_RIGHT_EXECUTE | ZX_RIGHT_SET_PROPERTY);
+        if (options == KTRACE_VMO_BUFFER)
+            rights &= ~ZX_RIGHT_WRITE;
+        HandleOwner handle(Handle::Make(fbl::move(dispatcher), rights));
+        if (!handle)
+            return ZX_ERR_NO_MEMORY;
+        auto up = ProcessDispatcher::GetCurrent();
+        if (_ptr.reinterpret<zx_handle_t>().copy_to_user(up->MapHandleToValue(handle)) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+        up->AddHandle(fbl::move(handle));
+        return ZX_OK;
+    }
     default:
         return ktrace_control(action, options, nullptr);
     }
@@ -162,15 +186,9 @@ zx_status_t sys_ktrace_write(zx_handle_t handle, uint32_t event_id, uint32_t arg
         return ZX_ERR_INVALID_ARGS;
     }
 
-    uint32_t* args = static_cast<uint32_t*>(ktrace_open(TAG_PROBE_24(event_id)));
-    if (!args) {
-        //  There is not a single reason for failure. Assume it reached the end.
-        return ZX_ERR_UNAVAILABLE;
-    }
-
-    args[0] = arg0;
-    args[1] = arg1;
-    return ZX_OK;
+    // Fails if the probe group is disabled or this cpu's ring is full.
+    uint32_t args[2] = { arg0, arg1 };
+    return ktrace_write_record(TAG_PROBE_24(event_id), args);
 }
 
 // zx_status_t zx_mtrace_control
@@ -6,6 +6,7 @@
 
 #include <err.h>
 #include <inttypes.h>
+#include <string.h>
 #include <trace.h>
 
 #include <kernel/mp.h>
@@ -22,6 +23,7 @@
 #include <object/diagnostics.h>
 #include <object/handle.h>
 #include <object/job_dispatcher.h>
+#include <object/object_cache.h>
 #include <object/process_dispatcher.h>
 #include <object/resource_dispatcher.h>
 #include <object/resource.h>
@@ -30,7 +32,9 @@
 #include <object/vm_address_region_dispatcher.h>
 #include <object/vm_object_dispatcher.h>
 
+#include <fbl/alloc_checker.h>
 #include <fbl/ref_ptr.h>
+#include <fbl/unique_ptr.h>
 
 #include "priv.h"
 
@@ -84,6 +88,17 @@ private:
     size_t avail_ = 0;
 };
 
+// Generated table of syscall numbers and names.
+struct SyscallInfo {
+    uint32_t id;
+    uint32_t nargs;
+    const char* name;
+};
+
+constexpr SyscallInfo kSyscallInfo[] = {
+#include <zircon/syscall-ktrace-info.inc>
+};
+
 zx_status_t single_record_result(user_out_ptr<void> _buffer, size_t buffer_size,
                                  user_out_ptr<size_t> _actual,
                                  user_out_ptr<size_t> _avail,
@@ -326,6 +341,72 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
         return single_record_result(
             _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
     }
+    case ZX_INFO_TASK_FAULTS:
+    case ZX_INFO_TASK_SYSCALLS: {
+        fbl::RefPtr<Dispatcher> dispatcher;
+        auto error = up->GetDispatcherWithRights(handle, ZX_RIGHT_INSPECT, &dispatcher);
+        if (error < 0)
+            return error;
+
+        // The syscall table is too big for the stack. Without syscall stats
+        // there is nothing to put in it, and no records are returned.
+        fbl::unique_ptr<ThreadDispatcher::SyscallStats[]> syscalls;
+        if (topic == ZX_INFO_TASK_SYSCALLS && ThreadDispatcher::syscall_stats_enabled()) {
+            fbl::AllocChecker ac;
+            syscalls.reset(new (&ac) ThreadDispatcher::SyscallStats[ZX_SYS_COUNT]());
+            if (!ac.check())
+                return ZX_ERR_NO_MEMORY;
+        }
+
+        zx_info_task_faults_t faults = {};
+        if (auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher)) {
+            thread->AccumulateStats(&faults, syscalls.get());
+        } else if (auto process = DownCastDispatcher<ProcessDispatcher>(&dispatcher)) {
+            process->GetThreadStats(&faults, syscalls.get());
+        } else {
+            return ZX_ERR_WRONG_TYPE;
+        }
+
+        if (topic == ZX_INFO_TASK_FAULTS) {
+            return single_record_result(
+                _buffer, buffer_size, _actual, _avail, &faults, sizeof(faults));
+        }
+
+        size_t num_space_for = buffer_size / sizeof(zx_info_task_syscall_t);
+        size_t num_avail = 0;
+        user_out_ptr<zx_info_task_syscall_t> syscall_buf =
+            _buffer.reinterpret<zx_info_task_syscall_t>();
+        for (const auto& info : kSyscallInfo) {
+            if (!syscalls)
+                break;
+            const ThreadDispatcher::SyscallStats& stats = syscalls[info.id];
+            if (stats.count == 0)
+                continue;
+            if (num_avail < num_space_for) {
+                zx_info_task_syscall_t record = {};
+                strlcpy(record.name, info.name, sizeof(record.name));
+                record.count = stats.count;
+                record.time = stats.time;
+
+                // copy out one at a time
+                if (syscall_buf.copy_array_to_user(&record, 1, num_avail) != ZX_OK)
+                    return ZX_ERR_INVALID_ARGS;
+            }
+            num_avail++;
+        }
+
+        if (_actual) {
+            zx_status_t status = _actual.copy_to_user(MIN(num_avail, num_space_for));
+            if (status != ZX_OK)
+                return status;
+        }
+        if (_avail) {
+            zx_status_t status = _avail.copy_to_user(num_avail);
+            if (status != ZX_OK)
+                return status;
+        }
+        return ZX_OK;
+    }
     case ZX_INFO_PROCESS_MAPS: {
         fbl::RefPtr<ProcessDispatcher> process;
         zx_status_t status =
@@ -631,6 +712,84 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
     }
 
+    case ZX_INFO_OBJECT_CACHES: {
+        auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
+        if (status != ZX_OK)
+            return status;
+
+        size_t num_caches = ObjectCacheBase::Count();
+        size_t num_space_for = buffer_size / sizeof(zx_info_object_cache_t);
+        size_t num_to_copy = MIN(num_caches, num_space_for);
+
+        user_out_ptr<zx_info_object_cache_t> cache_buf =
+            _buffer.reinterpret<zx_info_object_cache_t>();
+
+        for (size_t i = 0; i < num_to_copy; i++) {
+            zx_info_object_cache_t info;
+            ObjectCacheBase::Get(i)->GetInfo(&info);
+
+            // copy out one at a time
+            if (cache_buf.copy_array_to_user(&info, 1, i) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+        }
+
+        if (_actual) {
+            zx_status_t status = _actual.copy_to_user(num_to_copy);
+            if (status != ZX_OK)
+                return status;
+        }
+        if (_avail) {
+            zx_status_t status = _avail.copy_to_user(num_caches);
+            if (status != ZX_OK)
+                return status;
+        }
+        return ZX_OK;
+    }
+
+    case ZX_INFO_SCHED_LATENCY: {
+        auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
+        if (status != ZX_OK)
+            return status;
+
+        size_t num_cpus = arch_max_num_cpus();
+        size_t num_space_for = buffer_size / sizeof(zx_info_sched_latency_t);
+        size_t num_to_copy = MIN(num_cpus, num_space_for);
+
+        user_out_ptr<zx_info_sched_latency_t> latency_buf =
+            _buffer.reinterpret<zx_info_sched_latency_t>();
+
+        // the kernel histograms have the same layout as the tail of the user struct, which
+        // is too big for the stack, so copy out the header and histograms separately
+        static_assert(sizeof(zx_info_sched_latency_t) ==
+                          offsetof(zx_info_sched_latency_t, wakeup) + sizeof(cpu_sched_latency),
+                      "");
+        for (unsigned int i = 0; i < static_cast<unsigned int>(num_to_copy); i++) {
+            user_out_ptr<zx_info_sched_latency_t> dst = latency_buf.element_offset(i);
+
+            // NOTE: the histograms are read without grabbing a lock; each bucket is
+            // wordwise so a snapshot may be skewed but not corrupted.
+            uint32_t header[2] = {i, mp_is_cpu_online(i) ? ZX_INFO_CPU_STATS_FLAG_ONLINE : 0u};
+            if (dst.reinterpret<uint32_t>().copy_array_to_user(header, 2) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+            if (dst.byte_offset(offsetof(zx_info_sched_latency_t, wakeup))
+                    .reinterpret<cpu_sched_latency>()
+                    .copy_to_user(percpu[i].sched_latency) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+        }
+
+        if (_actual) {
+            zx_status_t status = _actual.copy_to_user(num_to_copy);
+            if (status != ZX_OK)
+                return status;
+        }
+        if (_avail) {
+            zx_status_t status = _avail.copy_to_user(num_cpus);
+            if (status != ZX_OK)
+                return status;
+        }
+        return ZX_OK;
+    }
+
     default:
         return ZX_ERR_NOT_SUPPORTED;
     }
@@ -826,6 +985,22 @@ zx_status_t sys_object_set_property(zx_handle_t handle_value, uint32_t property,
             return status;
         return process->set_debug_addr(value);
     }
+    case ZX_PROP_SOCKET_RX_BUF_MAX: {
+        if (size < sizeof(size_t))
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        auto socket = DownCastDispatcher<SocketDispatcher>(&dispatcher);
+        if (!socket)
+            return ZX_ERR_WRONG_TYPE;
+        size_t value = 0;
+        zx_status_t status = _value.reinterpret<const size_t>().copy_from_user(&value);
+        if (status != ZX_OK)
+            return status;
+        // Larger buffers are pinned kernel memory, so they take the root resource; see
+        // sys_socket_set_rx_buf_max().
+        if (value > MBufChain::kSizeMaxDefault)
+            return ZX_ERR_OUT_OF_RANGE;
+        return socket->SetReceiveBufferMax(value);
+    }
     case ZX_PROP_SOCKET_RX_THRESHOLD: {
         if (size < sizeof(size_t))
             return ZX_ERR_BUFFER_TOO_SMALL;
@@ -13,9 +13,11 @@
 #include <string.h>
 #include <trace.h>
 
+#include <lib/user_copy/user_iovec.h>
 #include <lib/user_copy/user_ptr.h>
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
+#include <object/resource.h>
 #include <object/socket_dispatcher.h>
 
 #include <zircon/syscalls/policy.h>
@@ -25,6 +27,29 @@
 
 #define LOCAL_TRACE 0
 
+// Copies a zx_iovec_t array from user memory into |vec| and computes the total
+// capacity of the buffers it describes.
+static zx_status_t copy_iovec_from_user(user_in_ptr<const zx_iovec_t> vector, size_t count,
+                                        zx_iovec_t* vec, size_t* total) {
+    if (count > ZX_SOCKET_IOVEC_MAX)
+        return ZX_ERR_OUT_OF_RANGE;
+    if (count > 0u && !vector)
+        return ZX_ERR_INVALID_ARGS;
+    zx_status_t status = vector.copy_array_from_user(vec, count);
+    if (status != ZX_OK)
+        return status;
+
+    size_t sum = 0u;
+    for (size_t i = 0; i < count; ++i) {
+        if (vec[i].capacity > 0u && vec[i].buffer == nullptr)
+            return ZX_ERR_INVALID_ARGS;
+        if (add_overflow(sum, vec[i].capacity, &sum))
+            return ZX_ERR_INVALID_ARGS;
+    }
+    *total = sum;
+    return ZX_OK;
+}
+
 // zx_status_t zx_socket_create
 zx_status_t sys_socket_create(uint32_t options,
                               user_out_handle* out0,
@@ -124,6 +149,90 @@ zx_status_t sys_socket_read(zx_handle_t handle, uint32_t options,
     return status;
 }
 
+// zx_status_t zx_socket_writev
+zx_status_t sys_socket_writev(zx_handle_t handle, uint32_t options,
+                              user_in_ptr<const zx_iovec_t> vector, size_t vector_count,
+                              user_out_ptr<size_t> actual) {
+    LTRACEF("handle %x\n", handle);
+
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    zx_iovec_t vec[ZX_SOCKET_IOVEC_MAX];
+    size_t size;
+    zx_status_t status = copy_iovec_from_user(vector, vector_count, vec, &size);
+    if (status != ZX_OK)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<SocketDispatcher> socket;
+    status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &socket);
+    if (status != ZX_OK)
+        return status;
+
+    size_t nwritten;
+    status = socket->Write(user_in_iovec(vec, vector_count), size, &nwritten);
+
+    // Caller may ignore results if desired.
+    if (status == ZX_OK && actual)
+        status = actual.copy_to_user(nwritten);
+
+    return status;
+}
+
+// zx_status_t zx_socket_readv
+zx_status_t sys_socket_readv(zx_handle_t handle, uint32_t options,
+                             user_in_ptr<const zx_iovec_t> vector, size_t vector_count,
+                             user_out_ptr<size_t> actual) {
+    LTRACEF("handle %x\n", handle);
+
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    zx_iovec_t vec[ZX_SOCKET_IOVEC_MAX];
+    size_t size;
+    zx_status_t status = copy_iovec_from_user(vector, vector_count, vec, &size);
+    if (status != ZX_OK)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<SocketDispatcher> socket;
+    status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &socket);
+    if (status != ZX_OK)
+        return status;
+
+    size_t nread;
+    status = socket->Read(user_out_iovec(vec, vector_count), size, &nread);
+
+    // Caller may ignore results if desired.
+    if (status == ZX_OK && actual)
+        status = actual.copy_to_user(nread);
+
+    return status;
+}
+
+// zx_status_t zx_socket_set_rx_buf_max
+zx_status_t sys_socket_set_rx_buf_max(zx_handle_t handle, zx_handle_t rsrc, size_t size) {
+    LTRACEF("handle %x size %zu\n", handle, size);
+
+    // Unlike ZX_PROP_SOCKET_RX_BUF_MAX, this may size the buffer past
+    // MBufChain::kSizeMaxDefault, which pins kernel memory for the socket.
+    zx_status_t status;
+    if ((status = validate_resource(rsrc, ZX_RSRC_KIND_ROOT)) < 0)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<SocketDispatcher> socket;
+    status = up->GetDispatcherWithRights(handle, ZX_RIGHT_SET_PROPERTY, &socket);
+    if (status != ZX_OK)
+        return status;
+
+    return socket->SetReceiveBufferMax(size);
+}
+
 // zx_status_t zx_socket_share
 zx_status_t sys_socket_share(zx_handle_t handle, zx_handle_t other) {
     auto up = ProcessDispatcher::GetCurrent();
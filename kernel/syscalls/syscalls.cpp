@@ -10,9 +10,11 @@
 #include <lib/ktrace.h>
 #include <lib/vdso.h>
 #include <object/process_dispatcher.h>
+#include <object/thread_dispatcher.h>
 #include <platform.h>
 #include <syscalls/syscalls.h>
 #include <trace.h>
+#include <zircon/time.h>
 #include <zircon/zx-syscall-numbers.h>
 
 #include <inttypes.h>
@@ -52,6 +54,8 @@ inline syscall_result do_syscall(uint64_t syscall_num, uint64_t pc,
 
     ProcessDispatcher* current_process = ProcessDispatcher::GetCurrent();
     const uintptr_t vdso_code_address = current_process->vdso_code_address();
+    const bool account = unlikely(ThreadDispatcher::syscall_stats_enabled());
+    const zx_time_t start = account ? current_time() : 0;
 
     uint64_t ret;
     if (unlikely(!valid_pc(pc - vdso_code_address))) {
@@ -60,6 +64,11 @@ inline syscall_result do_syscall(uint64_t syscall_num, uint64_t pc,
         ret = make_call(current_process);
     }
 
+    if (account) {
+        ThreadDispatcher::GetCurrent()->AccountSyscall(
+            syscall_num, zx_time_sub_time(current_time(), start));
+    }
+
     LTRACEF_LEVEL(2, "t %p ret %#" PRIx64 "\n", get_current_thread(), ret);
 
     /* re-disable interrupts on the way out
@@ -0,0 +1,179 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "tests.h"
+
+#include <arch/ops.h>
+#include <fbl/algorithm.h>
+#include <inttypes.h>
+#include <kernel/event.h>
+#include <kernel/mp.h>
+#include <kernel/thread.h>
+#include <lib/heap.h>
+#include <lib/unittest/unittest.h>
+#include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// A freed small block should come straight back from the current cpu's cache
+// for the next allocation of the same size class. Other threads on this cpu
+// may allocate in between, so allow a few tries.
+bool cache_reuse() {
+    BEGIN_TEST;
+
+    cpu_mask_t old_affinity = get_current_thread()->cpu_affinity;
+    thread_set_cpu_affinity(get_current_thread(), cpu_num_to_mask(arch_curr_cpu_num()));
+
+    bool reused = false;
+    for (int i = 0; i < 3 && !reused; i++) {
+        void* a = malloc(1500);
+        ASSERT_NONNULL(a, "");
+        free(a);
+        // 1500 and 1536 are in the same size class.
+        void* b = malloc(1536);
+        ASSERT_NONNULL(b, "");
+        reused = (a == b);
+        free(b);
+    }
+    EXPECT_TRUE(reused, "freed block was not reused");
+
+    thread_set_cpu_affinity(get_current_thread(), old_affinity);
+    END_TEST;
+}
+
+// Blocks from every size class, and from either side of the largest one,
+// must be fully usable and must not overlap.
+bool sizes() {
+    BEGIN_TEST;
+
+    static const size_t kSizes[] = {
+        1, 15, 16, 17, 100, 128, 129, 255, 256, 257, 1000, 2047, 2048, 2049, 8192,
+    };
+    void* ptrs[fbl::count_of(kSizes)];
+    for (size_t i = 0; i < fbl::count_of(kSizes); i++) {
+        ptrs[i] = malloc(kSizes[i]);
+        ASSERT_NONNULL(ptrs[i], "");
+        memset(ptrs[i], static_cast<int>(i), kSizes[i]);
+    }
+    for (size_t i = 0; i < fbl::count_of(kSizes); i++) {
+        auto bytes = static_cast<uint8_t*>(ptrs[i]);
+        for (size_t j = 0; j < kSizes[i]; j++) {
+            if (bytes[j] != i) {
+                ASSERT_EQ(i, bytes[j], "block was overwritten");
+            }
+        }
+        free(ptrs[i]);
+    }
+
+    END_TEST;
+}
+
+// memalign() and realloc() blocks may be freed through the caches too.
+bool memalign_and_realloc() {
+    BEGIN_TEST;
+
+    for (size_t align = 16; align <= PAGE_SIZE; align *= 2) {
+        void* ptr = memalign(align, 200);
+        ASSERT_NONNULL(ptr, "");
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(ptr) & (align - 1), "");
+        memset(ptr, 0xa5, 200);
+        free(ptr);
+    }
+
+    auto ptr = static_cast<uint8_t*>(malloc(24));
+    ASSERT_NONNULL(ptr, "");
+    for (size_t i = 0; i < 24; i++) {
+        ptr[i] = static_cast<uint8_t>(i);
+    }
+    ptr = static_cast<uint8_t*>(realloc(ptr, 3000));
+    ASSERT_NONNULL(ptr, "");
+    for (size_t i = 0; i < 24; i++) {
+        EXPECT_EQ(i, ptr[i], "");
+    }
+    free(ptr);
+
+    END_TEST;
+}
+
+struct BenchArgs {
+    event_t* start;
+    size_t iterations;
+    bool failed;
+};
+
+constexpr size_t kBatchSize = 8;
+constexpr size_t kBenchSizes[kBatchSize] = {16, 40, 64, 100, 200, 512, 1000, 2048};
+
+int malloc_bench_thread(void* arg) {
+    auto args = static_cast<BenchArgs*>(arg);
+    event_wait(args->start);
+
+    void* ptrs[kBatchSize];
+    for (size_t i = 0; i < args->iterations; i++) {
+        for (size_t j = 0; j < kBatchSize; j++) {
+            ptrs[j] = malloc(kBenchSizes[j]);
+            if (ptrs[j] == nullptr) {
+                args->failed = true;
+            }
+        }
+        for (size_t j = 0; j < kBatchSize; j++) {
+            free(ptrs[j]);
+        }
+    }
+    return 0;
+}
+
+// Measures malloc/free throughput with an increasing number of threads, each
+// repeatedly allocating and then freeing a batch of mixed-size blocks.
+bool concurrent_throughput() {
+    BEGIN_TEST;
+
+    constexpr size_t kIterations = 20000;
+    const uint max_threads = arch_max_num_cpus();
+
+    for (uint num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        event_t start;
+        event_init(&start, false, 0);
+
+        thread_t* threads[SMP_MAX_CPUS];
+        BenchArgs args[SMP_MAX_CPUS];
+        for (uint i = 0; i < num_threads; i++) {
+            args[i] = {&start, kIterations, false};
+            threads[i] = thread_create("heap bench", malloc_bench_thread, &args[i],
+                                       DEFAULT_PRIORITY);
+            ASSERT_NONNULL(threads[i], "");
+            thread_resume(threads[i]);
+        }
+
+        zx_time_t begin = current_time();
+        event_signal(&start, true);
+        for (uint i = 0; i < num_threads; i++) {
+            ASSERT_EQ(ZX_OK, thread_join(threads[i], nullptr, ZX_TIME_INFINITE), "");
+            EXPECT_FALSE(args[i].failed, "allocation failed");
+        }
+        zx_duration_t elapsed = current_time() - begin;
+        event_destroy(&start);
+
+        uint64_t pairs = static_cast<uint64_t>(num_threads) * kIterations * kBatchSize;
+        printf("\n%u thread(s): %" PRIu64 " malloc/free pairs in %" PRIi64 " us, "
+               "%" PRIu64 " pairs/sec\n",
+               num_threads, pairs, elapsed / ZX_USEC(1),
+               elapsed > 0 ? pairs * ZX_SEC(1) / elapsed : 0);
+    }
+
+    END_TEST;
+}
+
+} // namespace
+
+UNITTEST_START_TESTCASE(heap_tests)
+UNITTEST("cache_reuse", cache_reuse)
+UNITTEST("sizes", sizes)
+UNITTEST("memalign_and_realloc", memalign_and_realloc)
+UNITTEST("concurrent_throughput", concurrent_throughput)
+UNITTEST_END_TESTCASE(heap_tests, "heap", "Kernel heap tests");
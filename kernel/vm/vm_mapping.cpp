@@ -12,6 +12,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <inttypes.h>
+#include <kernel/thread.h>
 #include <trace.h>
 #include <vm/fault.h>
 #include <vm/vm.h>
@@ -656,6 +657,15 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
         return status;
     }
 
+    if (pf_flags & VMM_PF_FLAG_HW_FAULT) {
+        thread_t* t = get_current_thread();
+        if (pf_flags & VMM_PF_FLAG_WRITE) {
+            t->page_faults.write++;
+        } else {
+            t->page_faults.read++;
+        }
+    }
+
     // if we read faulted, make sure we map or modify the page without any write permissions
     // this ensures we will fault again if a write is attempted so we can potentially
     // replace this page with a copy or a new one
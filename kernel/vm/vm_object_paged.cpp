@@ -14,6 +14,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <inttypes.h>
+#include <kernel/thread.h>
 #include <lib/console.h>
 #include <stdlib.h>
 #include <string.h>
@@ -460,6 +461,10 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
             LTRACEF("copy-on-write faulted in page %p, pa %#" PRIxPTR " copied from %p, pa %#" PRIxPTR "\n",
                     p, pa, p_clone, pa_clone);
 
+            if (pf_flags & VMM_PF_FLAG_HW_FAULT) {
+                get_current_thread()->page_faults.cow++;
+            }
+
             if (page_out) {
                 *page_out = p_clone;
             }
@@ -480,6 +485,9 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     // return the single global zero page
     if ((pf_flags & VMM_PF_FLAG_WRITE) == 0) {
         LTRACEF("returning the zero page\n");
+        if (pf_flags & VMM_PF_FLAG_HW_FAULT) {
+            get_current_thread()->page_faults.zero_fill++;
+        }
         if (page_out) {
             *page_out = vm_get_zero_page();
         }
@@ -523,6 +531,10 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
     LTRACEF("faulted in page %p, pa %#" PRIxPTR "\n", p, pa);
 
+    if (pf_flags & VMM_PF_FLAG_HW_FAULT) {
+        get_current_thread()->page_faults.zero_fill++;
+    }
+
     if (page_out) {
         *page_out = p;
     }
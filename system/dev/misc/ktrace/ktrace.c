@@ -72,6 +72,28 @@ static zx_status_t ktrace_ioctl(void* ctx, uint32_t op,
         uint32_t group_mask = *(uint32_t *)cmd;
         return zx_ktrace_control(get_root_resource(), KTRACE_ACTION_START, group_mask, NULL);
     }
+    case IOCTL_KTRACE_GET_BUFFER:
+    case IOCTL_KTRACE_GET_CONTROL: {
+        if (max < sizeof(zx_handle_t)) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        uint32_t which = (op == IOCTL_KTRACE_GET_BUFFER) ? KTRACE_VMO_BUFFER : KTRACE_VMO_CONTROL;
+        zx_handle_t h;
+        zx_status_t status = zx_ktrace_control(get_root_resource(), KTRACE_ACTION_GET_VMO, which, &h);
+        if (status < 0) {
+            return status;
+        }
+        *((zx_handle_t*) reply) = h;
+        *out_actual = sizeof(zx_handle_t);
+        return ZX_OK;
+    }
+    case IOCTL_KTRACE_SET_MODE: {
+        if (cmdlen != sizeof(uint32_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        uint32_t mode = *(uint32_t *)cmd;
+        return zx_ktrace_control(get_root_resource(), KTRACE_ACTION_SET_MODE, mode, NULL);
+    }
     case IOCTL_KTRACE_STOP: {
         zx_ktrace_control(get_root_resource(), KTRACE_ACTION_STOP, 0, NULL);
         zx_ktrace_control(get_root_resource(), KTRACE_ACTION_REWIND, 0, NULL);
@@ -312,6 +312,9 @@ zx_status_t MinfsCreator::CalculateRequiredSize(off_t* out) {
 
     uint32_t inodes = minfs::kMinfsDefaultInodeCount;
     uint32_t blocks = data_blocks_ + dir_blocks;
+    // Leave room for the journal reserved by mkfs, in proportion to the size of the data region.
+    blocks += fbl::min(blocks / (minfs::kMinfsJournalRatio - 1) + 1,
+                       minfs::kMinfsDefaultJournalBlocks);
 
     // Calculate number of blocks we will need for all minfs structures.
     uint32_t inoblks = (inodes + minfs::kMinfsInodesPerBlock - 1) / minfs::kMinfsInodesPerBlock;
@@ -0,0 +1,389 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares the results of perftest runs, as written by --out, and flags
+// the test cases that got significantly slower.
+//
+// Any number of baseline files may be given; the values of a test case are
+// pooled across them, so a history of earlier runs can serve as the
+// baseline.  A test case has regressed when a two-sided Mann-Whitney U test
+// finds its distribution changed (p < alpha) and its median grew by more
+// than the threshold.  All values are taken to be times, so larger is worse.
+
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr double kDefaultAlpha = 0.01;
+constexpr double kDefaultThresholdPercent = 5;
+
+// Test cases are identified by (test_suite, label).
+typedef std::pair<std::string, std::string> TestKey;
+typedef std::map<TestKey, std::vector<double>> Results;
+
+// A parser for the subset of JSON that perftest writes: an array of objects
+// whose members are strings, numbers or arrays of numbers.
+class Parser {
+public:
+    Parser(const char* filename, const std::string& text)
+        : filename_(filename), text_(text) {}
+
+    bool Parse(Results* results) {
+        if (!Expect('[')) {
+            return false;
+        }
+        if (Consume(']')) {
+            return AtEnd();
+        }
+        do {
+            if (!ParseTestCase(results)) {
+                return false;
+            }
+        } while (Consume(','));
+        return Expect(']') && AtEnd();
+    }
+
+private:
+    bool ParseTestCase(Results* results) {
+        std::string test_suite, label;
+        std::vector<double> values;
+        if (!Expect('{')) {
+            return false;
+        }
+        do {
+            std::string name;
+            if (!ParseString(&name) || !Expect(':')) {
+                return false;
+            }
+            bool ok;
+            if (name == "test_suite") {
+                ok = ParseString(&test_suite);
+            } else if (name == "label") {
+                ok = ParseString(&label);
+            } else if (name == "values") {
+                ok = ParseNumbers(&values);
+            } else {
+                ok = SkipValue();
+            }
+            if (!ok) {
+                return false;
+            }
+        } while (Consume(','));
+        if (!Expect('}')) {
+            return false;
+        }
+
+        std::vector<double>* dest = &(*results)[TestKey(test_suite, label)];
+        dest->insert(dest->end(), values.begin(), values.end());
+        return true;
+    }
+
+    bool ParseString(std::string* out) {
+        if (!Expect('"')) {
+            return false;
+        }
+        out->clear();
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if (c != '\\') {
+                out->push_back(c);
+                continue;
+            }
+            if (pos_ >= text_.size()) {
+                break;
+            }
+            c = text_[pos_++];
+            switch (c) {
+            case 'b': out->push_back('\b'); break;
+            case 'f': out->push_back('\f'); break;
+            case 'n': out->push_back('\n'); break;
+            case 'r': out->push_back('\r'); break;
+            case 't': out->push_back('\t'); break;
+            case 'u': {
+                // perftest only escapes single bytes this way.
+                if (pos_ + 4 > text_.size()) {
+                    return Error("truncated \\u escape");
+                }
+                unsigned long code = strtoul(text_.substr(pos_, 4).c_str(), nullptr, 16);
+                out->push_back(static_cast<char>(code));
+                pos_ += 4;
+                break;
+            }
+            default: out->push_back(c); break;
+            }
+        }
+        return Expect('"');
+    }
+
+    bool ParseNumber(double* out) {
+        SkipSpace();
+        const char* start = text_.c_str() + pos_;
+        char* end;
+        *out = strtod(start, &end);
+        if (end == start) {
+            return Error("expected a number");
+        }
+        pos_ += end - start;
+        return true;
+    }
+
+    bool ParseNumbers(std::vector<double>* out) {
+        if (!Expect('[')) {
+            return false;
+        }
+        if (Consume(']')) {
+            return true;
+        }
+        do {
+            double value;
+            if (!ParseNumber(&value)) {
+                return false;
+            }
+            out->push_back(value);
+        } while (Consume(','));
+        return Expect(']');
+    }
+
+    bool SkipValue() {
+        SkipSpace();
+        if (pos_ >= text_.size()) {
+            return Error("unexpected end of file");
+        }
+        std::string unused;
+        std::vector<double> unused_values;
+        double unused_value;
+        switch (text_[pos_]) {
+        case '"':
+            return ParseString(&unused);
+        case '[':
+            return ParseNumbers(&unused_values);
+        default:
+            return ParseNumber(&unused_value);
+        }
+    }
+
+    void SkipSpace() {
+        while (pos_ < text_.size() && strchr(" \t\r\n", text_[pos_]) != nullptr) {
+            pos_++;
+        }
+    }
+
+    bool Consume(char c) {
+        SkipSpace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool Expect(char c) {
+        if (Consume(c)) {
+            return true;
+        }
+        char msg[32];
+        snprintf(msg, sizeof(msg), "expected '%c'", c);
+        return Error(msg);
+    }
+
+    bool AtEnd() {
+        SkipSpace();
+        return pos_ == text_.size() || Error("trailing data");
+    }
+
+    bool Error(const char* msg) {
+        fprintf(stderr, "perfcompare: %s: offset %zu: %s\n", filename_, pos_, msg);
+        return false;
+    }
+
+    const char* filename_;
+    const std::string& text_;
+    size_t pos_ = 0;
+};
+
+bool ReadResults(const char* filename, Results* results) {
+    FILE* fp = fopen(filename, "r");
+    if (fp == nullptr) {
+        fprintf(stderr, "perfcompare: cannot open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    std::string text;
+    char buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        text.append(buf, len);
+    }
+    fclose(fp);
+    return Parser(filename, text).Parse(results);
+}
+
+double Median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return values.size() % 2 == 0 ? (values[mid - 1] + values[mid]) / 2 : values[mid];
+}
+
+// Returns the two-sided p-value of the Mann-Whitney U test that |a| and |b|
+// come from the same distribution, using the normal approximation with a
+// correction for ties.  This is accurate enough once both samples have
+// more than about 20 values, which perftest runs always do.
+double MannWhitneyP(const std::vector<double>& a, const std::vector<double>& b) {
+    struct Value {
+        double value;
+        bool from_a;
+    };
+    std::vector<Value> all;
+    all.reserve(a.size() + b.size());
+    for (double value : a) {
+        all.push_back({value, true});
+    }
+    for (double value : b) {
+        all.push_back({value, false});
+    }
+    std::sort(all.begin(), all.end(),
+              [](const Value& x, const Value& y) { return x.value < y.value; });
+
+    // Sum the ranks of |a|, giving tied values the mean of their ranks.
+    double rank_sum_a = 0;
+    double tie_term = 0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].value == all[i].value) {
+            j++;
+        }
+        double ties = static_cast<double>(j - i);
+        double rank = (static_cast<double>(i + 1) + static_cast<double>(j)) / 2;
+        for (size_t k = i; k < j; k++) {
+            if (all[k].from_a) {
+                rank_sum_a += rank;
+            }
+        }
+        tie_term += ties * ties * ties - ties;
+        i = j;
+    }
+
+    double n1 = static_cast<double>(a.size());
+    double n2 = static_cast<double>(b.size());
+    double n = n1 + n2;
+    double u = rank_sum_a - n1 * (n1 + 1) / 2;
+    double mean = n1 * n2 / 2;
+    double variance = n1 * n2 / 12 * ((n + 1) - tie_term / (n * (n - 1)));
+    if (variance <= 0) {
+        // Every value is the same.
+        return 1;
+    }
+    double z = (fabs(u - mean) - 0.5) / sqrt(variance);
+    if (z < 0) {
+        z = 0;
+    }
+    return erfc(z / sqrt(2));
+}
+
+void usage(void) {
+    fprintf(stderr,
+            "usage: perfcompare [options] <baseline.json>... <candidate.json>\n"
+            "Compares perftest results and flags regressions.  The values of a\n"
+            "test case are pooled across all the baseline files.  Exits with\n"
+            "status 1 if any test case regressed.\n"
+            "\n"
+            "options:\n"
+            "  -a <alpha>    significance level (default %g)\n"
+            "  -t <percent>  smallest change in the median to report (default %g)\n"
+            "  -v            list unchanged test cases too\n",
+            kDefaultAlpha, kDefaultThresholdPercent);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double alpha = kDefaultAlpha;
+    double threshold = kDefaultThresholdPercent;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:t:vh")) != -1) {
+        switch (opt) {
+        case 'a':
+            alpha = strtod(optarg, nullptr);
+            break;
+        case 't':
+            threshold = strtod(optarg, nullptr);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage();
+            return 2;
+        }
+    }
+    if (argc - optind < 2) {
+        usage();
+        return 2;
+    }
+
+    Results baseline;
+    Results candidate;
+    for (int i = optind; i < argc - 1; i++) {
+        if (!ReadResults(argv[i], &baseline)) {
+            return 2;
+        }
+    }
+    if (!ReadResults(argv[argc - 1], &candidate)) {
+        return 2;
+    }
+
+    printf("%12s %12s %8s %10s  %-10s %s\n",
+           "Base median", "New median", "Change", "p", "Result", "Test case");
+    int regressions = 0;
+    int improvements = 0;
+    for (const auto& entry : candidate) {
+        const std::string& label = entry.first.second;
+        const std::vector<double>& values = entry.second;
+        auto base = baseline.find(entry.first);
+        if (base == baseline.end() || base->second.empty() || values.empty()) {
+            printf("%12s %12s %8s %10s  %-10s %s\n", "-", "-", "-", "-", "new", label.c_str());
+            continue;
+        }
+
+        double base_median = Median(base->second);
+        double new_median = Median(values);
+        double change = base_median != 0 ? (new_median - base_median) / base_median * 100 : 0;
+        double p = MannWhitneyP(base->second, values);
+        const char* result = "same";
+        if (p < alpha && change > threshold) {
+            result = "REGRESSED";
+            regressions++;
+        } else if (p < alpha && change < -threshold) {
+            result = "improved";
+            improvements++;
+        } else if (!verbose) {
+            continue;
+        }
+        printf("%12.0f %12.0f %+7.1f%% %10.2g  %-10s %s\n",
+               base_median, new_median, change, p, result, label.c_str());
+    }
+    for (const auto& entry : baseline) {
+        if (candidate.find(entry.first) == candidate.end()) {
+            printf("%12s %12s %8s %10s  %-10s %s\n", "-", "-", "-", "-", "removed",
+                   entry.first.second.c_str());
+        }
+    }
+
+    printf("\n%zu test cases, %d regressed, %d improved\n",
+           candidate.size(), regressions, improvements);
+    return regressions > 0 ? 1 : 0;
+}
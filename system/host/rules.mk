@@ -21,7 +21,9 @@ HOSTAPPS := \
     $(LOCAL_DIR)/mkfs-msdosfs/rules.mk \
     $(LOCAL_DIR)/mkkdtb/rules.mk \
     $(LOCAL_DIR)/netprotocol/rules.mk \
+    $(LOCAL_DIR)/perfcompare/rules.mk \
     $(LOCAL_DIR)/runtests/rules.mk \
+    $(LOCAL_DIR)/sampler-report/rules.mk \
     $(LOCAL_DIR)/xdc-server/rules.mk \
     $(LOCAL_DIR)/zbi/rules.mk \
 
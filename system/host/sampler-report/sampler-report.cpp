@@ -0,0 +1,431 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Turns a profile written by the target's `sampler` tool into folded
+// stacks for flamegraph.pl, or into the legacy gperftools CPU profile
+// format that pprof reads.
+//
+// The profile is line oriented:
+//   period_ns <ns>
+//   sample <pid> <tid> <cpu> <time> <k|u> <pc> [<return address> ...]
+//   process <pid> <name>
+//   module <pid> <load address> <build id | -> <name>
+//
+// User pcs are resolved against the modules of their process.  Kernel pcs
+// are absolute addresses in zircon.elf.  Symbol names are looked up with
+// llvm-symbolizer when it is given, using unstripped binaries found by build
+// id in a .build-id directory (<dir>/<xx>/<rest>.debug).
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr char kKernelModule[] = "zircon.elf";
+
+struct Module {
+    uint64_t vaddr;
+    std::string build_id;
+    std::string name;
+};
+
+struct Process {
+    std::string name;
+    // Sorted by load address.
+    std::vector<Module> modules;
+};
+
+struct Sample {
+    uint64_t pid;
+    bool user;
+    // Innermost first.
+    std::vector<uint64_t> pcs;
+};
+
+struct Profile {
+    uint64_t period_ns = 0;
+    std::map<uint64_t, Process> processes;
+    std::vector<Sample> samples;
+};
+
+// A pc resolved to a file and an address within it.
+struct Location {
+    std::string module;
+    std::string file; // empty if no binary was found
+    uint64_t address;
+
+    bool operator<(const Location& other) const {
+        return std::tie(file, module, address) < std::tie(other.file, other.module, other.address);
+    }
+};
+
+bool ReadProfile(FILE* in, Profile* profile) {
+    char* line = nullptr;
+    size_t line_size = 0;
+    ssize_t len;
+    int lineno = 0;
+    bool ok = true;
+
+    while ((len = getline(&line, &line_size, in)) >= 0) {
+        lineno++;
+        if (len > 0 && line[len - 1] == '\n') {
+            line[len - 1] = '\0';
+        }
+        char* save;
+        const char* kind = strtok_r(line, " ", &save);
+        if (kind == nullptr || kind[0] == '#') {
+            continue;
+        }
+
+        std::vector<const char*> fields;
+        const char* field;
+        while ((field = strtok_r(nullptr, " ", &save)) != nullptr) {
+            fields.push_back(field);
+        }
+
+        if (!strcmp(kind, "period_ns") && fields.size() == 1) {
+            profile->period_ns = strtoull(fields[0], nullptr, 0);
+        } else if (!strcmp(kind, "sample") && fields.size() >= 5) {
+            Sample sample;
+            sample.pid = strtoull(fields[0], nullptr, 0);
+            sample.user = fields[4][0] == 'u';
+            for (size_t i = 5; i < fields.size(); i++) {
+                sample.pcs.push_back(strtoull(fields[i], nullptr, 0));
+            }
+            profile->samples.push_back(std::move(sample));
+        } else if (!strcmp(kind, "process") && fields.size() >= 2) {
+            std::string name = fields[1];
+            for (size_t i = 2; i < fields.size(); i++) {
+                name += std::string(" ") + fields[i];
+            }
+            profile->processes[strtoull(fields[0], nullptr, 0)].name = name;
+        } else if (!strcmp(kind, "module") && fields.size() == 4) {
+            Module module;
+            module.vaddr = strtoull(fields[1], nullptr, 0);
+            if (strcmp(fields[2], "-")) {
+                module.build_id = fields[2];
+            }
+            module.name = fields[3];
+            profile->processes[strtoull(fields[0], nullptr, 0)].modules.push_back(module);
+        } else {
+            fprintf(stderr, "sampler-report: line %d: cannot parse \"%s\"\n", lineno, kind);
+            ok = false;
+            break;
+        }
+    }
+    free(line);
+
+    for (auto& entry : profile->processes) {
+        std::vector<Module>& modules = entry.second.modules;
+        std::sort(modules.begin(), modules.end(), [](const Module& a, const Module& b) {
+            return a.vaddr < b.vaddr;
+        });
+    }
+    return ok;
+}
+
+class Reporter {
+public:
+    Reporter(const Profile& profile, const char* build_id_dir, const char* kernel)
+        : profile_(profile), build_id_dir_(build_id_dir), kernel_(kernel) {}
+
+    // Maps the |depth|th pc of |sample| to a location.  Return addresses
+    // are moved back into the call instruction so that they symbolize to
+    // the caller's line.
+    Location Resolve(const Sample& sample, size_t depth) const {
+        uint64_t pc = sample.pcs[depth];
+        if (depth > 0) {
+            pc--;
+        }
+        if (!sample.user) {
+            return Location{kKernelModule, kernel_ ? kernel_ : "", pc};
+        }
+
+        auto it = profile_.processes.find(sample.pid);
+        if (it != profile_.processes.end()) {
+            const std::vector<Module>& modules = it->second.modules;
+            auto module = std::upper_bound(
+                modules.begin(), modules.end(), pc,
+                [](uint64_t pc, const Module& m) { return pc < m.vaddr; });
+            if (module != modules.begin()) {
+                --module;
+                return Location{module->name, DebugFile(module->build_id), pc - module->vaddr};
+            }
+        }
+        return Location{"", "", pc};
+    }
+
+    std::string ProcessName(const Sample& sample) const {
+        if (!sample.user && sample.pid == 0) {
+            return "kernel";
+        }
+        auto it = profile_.processes.find(sample.pid);
+        if (it == profile_.processes.end() || it->second.name.empty()) {
+            return "pid " + std::to_string(sample.pid);
+        }
+        return it->second.name;
+    }
+
+    // Looks up function names for every location that has a binary.
+    bool Symbolize(const char* symbolizer) {
+        std::vector<Location> locations;
+        for (const Sample& sample : profile_.samples) {
+            for (size_t i = 0; i < sample.pcs.size(); i++) {
+                Location location = Resolve(sample, i);
+                if (!location.file.empty() && names_.find(location) == names_.end()) {
+                    names_[location] = "";
+                    locations.push_back(location);
+                }
+            }
+        }
+        if (locations.empty()) {
+            return true;
+        }
+
+        char input[] = "/tmp/sampler-report.XXXXXX";
+        int fd = mkstemp(input);
+        if (fd < 0) {
+            fprintf(stderr, "sampler-report: mkstemp: %s\n", strerror(errno));
+            return false;
+        }
+        FILE* f = fdopen(fd, "w");
+        for (const Location& location : locations) {
+            fprintf(f, "CODE \"%s\" %#" PRIx64 "\n", location.file.c_str(), location.address);
+        }
+        fclose(f);
+
+        std::string command = std::string(symbolizer) +
+                              " --functions=short --inlining=false --demangle < " + input;
+        FILE* out = popen(command.c_str(), "r");
+        if (out == nullptr) {
+            fprintf(stderr, "sampler-report: cannot run %s\n", symbolizer);
+            unlink(input);
+            return false;
+        }
+
+        // Each answer is a function line, a file:line line and a blank line.
+        char* line = nullptr;
+        size_t line_size = 0;
+        ssize_t len;
+        size_t index = 0;
+        int field = 0;
+        while ((len = getline(&line, &line_size, out)) >= 0 && index < locations.size()) {
+            if (len > 0 && line[len - 1] == '\n') {
+                line[--len] = '\0';
+            }
+            if (len == 0) {
+                index++;
+                field = 0;
+                continue;
+            }
+            if (field++ == 0 && strcmp(line, "??")) {
+                names_[locations[index]] = line;
+            }
+        }
+        free(line);
+        pclose(out);
+        unlink(input);
+        return true;
+    }
+
+    std::string FrameName(const Location& location) const {
+        auto it = names_.find(location);
+        if (it != names_.end() && !it->second.empty()) {
+            return it->second;
+        }
+        char offset[32];
+        snprintf(offset, sizeof(offset), "%#" PRIx64, location.address);
+        return location.module.empty() ? offset : location.module + "+" + offset;
+    }
+
+    // Writes one line per distinct stack, outermost frame first, prefixed
+    // by the process name and followed by its sample count.
+    void WriteFolded(FILE* out) const {
+        std::map<std::string, uint64_t> stacks;
+        for (const Sample& sample : profile_.samples) {
+            std::string stack = ProcessName(sample);
+            for (size_t i = sample.pcs.size(); i > 0; i--) {
+                std::string frame = FrameName(Resolve(sample, i - 1));
+                std::replace(frame.begin(), frame.end(), ';', ':');
+                stack += ";" + frame;
+            }
+            std::replace(stack.begin(), stack.end(), ' ', '_');
+            stacks[stack]++;
+        }
+        for (const auto& entry : stacks) {
+            fprintf(out, "%s %" PRIu64 "\n", entry.first.c_str(), entry.second);
+        }
+    }
+
+    // Writes the samples of process |pid| (and kernel samples taken while
+    // its threads were in the kernel) as a legacy CPU profile, followed by
+    // the memory map pprof uses to find the binaries.
+    bool WritePprof(FILE* out, uint64_t pid) const {
+        auto it = profile_.processes.find(pid);
+        if (it == profile_.processes.end()) {
+            fprintf(stderr, "sampler-report: no modules for pid %" PRIu64 "\n", pid);
+            return false;
+        }
+
+        auto word = [out](uint64_t value) { fwrite(&value, sizeof(value), 1, out); };
+        word(0);
+        word(3);
+        word(0);
+        word(profile_.period_ns / 1000);
+        word(0);
+        for (const Sample& sample : profile_.samples) {
+            if (sample.pid != pid || sample.pcs.empty()) {
+                continue;
+            }
+            word(1);
+            word(sample.pcs.size());
+            for (uint64_t pc : sample.pcs) {
+                word(pc);
+            }
+        }
+        word(0);
+        word(1);
+        word(0);
+
+        // A module is taken to extend to the next one.
+        const std::vector<Module>& modules = it->second.modules;
+        for (size_t i = 0; i < modules.size(); i++) {
+            uint64_t end = i + 1 < modules.size() ? modules[i + 1].vaddr : UINT64_C(1) << 47;
+            std::string file = DebugFile(modules[i].build_id);
+            fprintf(out, "%012" PRIx64 "-%012" PRIx64 " r-xp 00000000 00:00 0 %s\n",
+                    modules[i].vaddr, end, file.empty() ? modules[i].name.c_str() : file.c_str());
+        }
+        if (kernel_ != nullptr) {
+            fprintf(out, "ffffffff00000000-ffffffffffffffff r-xp ffffffff00000000 00:00 0 %s\n",
+                    kernel_);
+        }
+        return true;
+    }
+
+private:
+    std::string DebugFile(const std::string& build_id) const {
+        if (build_id_dir_ == nullptr || build_id.size() < 3) {
+            return "";
+        }
+        std::string file = std::string(build_id_dir_) + "/" + build_id.substr(0, 2) + "/" +
+                           build_id.substr(2) + ".debug";
+        return access(file.c_str(), R_OK) == 0 ? file : "";
+    }
+
+    const Profile& profile_;
+    const char* build_id_dir_;
+    const char* kernel_;
+    std::map<Location, std::string> names_;
+};
+
+void usage() {
+    fprintf(stderr,
+            "usage: sampler-report [options] <profile>\n"
+            "\n"
+            "Writes folded stacks for flamegraph.pl, or a pprof CPU profile.\n"
+            "\n"
+            "options:\n"
+            "  -b, --build-id-dir <dir>  find unstripped binaries in <dir>/<xx>/<rest>.debug\n"
+            "  -k, --kernel <file>       unstripped zircon.elf for kernel frames\n"
+            "  -s, --symbolizer <file>   llvm-symbolizer to name frames with\n"
+            "  -p, --pprof <pid>         write a pprof CPU profile for process <pid>\n"
+            "  -o, --output <file>       write to <file> instead of stdout\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    static const struct option opts[] = {
+        {"build-id-dir", required_argument, nullptr, 'b'},
+        {"kernel", required_argument, nullptr, 'k'},
+        {"symbolizer", required_argument, nullptr, 's'},
+        {"pprof", required_argument, nullptr, 'p'},
+        {"output", required_argument, nullptr, 'o'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    const char* build_id_dir = nullptr;
+    const char* kernel = nullptr;
+    const char* symbolizer = nullptr;
+    const char* output = nullptr;
+    bool pprof = false;
+    uint64_t pprof_pid = 0;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "b:k:s:p:o:h", opts, nullptr)) != -1) {
+        switch (opt) {
+        case 'b':
+            build_id_dir = optarg;
+            break;
+        case 'k':
+            kernel = optarg;
+            break;
+        case 's':
+            symbolizer = optarg;
+            break;
+        case 'p':
+            pprof = true;
+            pprof_pid = strtoull(optarg, nullptr, 0);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage();
+        return 1;
+    }
+
+    FILE* in = fopen(argv[optind], "r");
+    if (in == nullptr) {
+        fprintf(stderr, "sampler-report: cannot open %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+    Profile profile;
+    bool ok = ReadProfile(in, &profile);
+    fclose(in);
+    if (!ok) {
+        return 1;
+    }
+
+    FILE* out = stdout;
+    if (output != nullptr && (out = fopen(output, "w")) == nullptr) {
+        fprintf(stderr, "sampler-report: cannot open %s: %s\n", output, strerror(errno));
+        return 1;
+    }
+
+    Reporter reporter(profile, build_id_dir, kernel);
+    if (pprof) {
+        // pprof does its own symbolization.
+        ok = reporter.WritePprof(out, pprof_pid);
+    } else {
+        if (symbolizer != nullptr) {
+            ok = reporter.Symbolize(symbolizer);
+        }
+        reporter.WriteFolded(out);
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return ok ? 0 : 1;
+}
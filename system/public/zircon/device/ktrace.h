@@ -32,6 +32,21 @@ IOCTL_WRAPPER_OUT(ioctl_ktrace_get_handle, IOCTL_KTRACE_GET_HANDLE, zx_handle_t)
 #define IOCTL_KTRACE_STOP \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_KTRACE, 4)
 
+// return a read-only handle to the per-cpu trace buffer VMO
+// (layout: ktrace_buffer_header_t in lib/zircon-internal/ktrace.h)
+#define IOCTL_KTRACE_GET_BUFFER \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_KTRACE, 5)
+
+// select the buffer mode, tracing must be stopped
+// input: KTRACE_MODE_STREAMING or KTRACE_MODE_CIRCULAR
+#define IOCTL_KTRACE_SET_MODE \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_KTRACE, 6)
+
+// return a handle to the VMO holding the consumer tails
+// (one ktrace_cpu_control_t per cpu)
+#define IOCTL_KTRACE_GET_CONTROL \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_KTRACE, 7)
+
 static inline zx_status_t ioctl_ktrace_add_probe(int fd, const char* name, uint32_t* probe_id) {
     return fdio_ioctl(fd, IOCTL_KTRACE_ADD_PROBE,
                       name, strlen(name), probe_id, sizeof(uint32_t));
@@ -39,3 +54,6 @@ static inline zx_status_t ioctl_ktrace_add_probe(int fd, const char* name, uint3
 
 IOCTL_WRAPPER_IN(ioctl_ktrace_start, IOCTL_KTRACE_START, uint32_t);
 IOCTL_WRAPPER(ioctl_ktrace_stop, IOCTL_KTRACE_STOP);
+IOCTL_WRAPPER_OUT(ioctl_ktrace_get_buffer, IOCTL_KTRACE_GET_BUFFER, zx_handle_t);
+IOCTL_WRAPPER_IN(ioctl_ktrace_set_mode, IOCTL_KTRACE_SET_MODE, uint32_t);
+IOCTL_WRAPPER_OUT(ioctl_ktrace_get_control, IOCTL_KTRACE_GET_CONTROL, zx_handle_t);
@@ -0,0 +1,63 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// The kernel exports its counters as two read-only VMOs, which userboot
+// receives as PA_VMO_KERNEL_FILE handles and devmgr publishes under
+// /boot/kernel/<name>:
+//
+// - The descriptor VMO holds a kcounters_desc_vmo_t, naming every slot.
+// - The arena VMO is the live counter storage itself: max_cpus rows of
+//   num_counters int64_t slots, one row per CPU.  Slot |i| of CPU |cpu| is
+//   at index cpu * num_counters + i.  Slots are updated without atomics, so
+//   a read is only an approximation of the value on that CPU, and the value
+//   of a counter is the sum of its slots over all CPUs.
+#define KCOUNTERS_DESC_VMO_NAME "counters/desc"
+#define KCOUNTERS_ARENA_VMO_NAME "counters/arena"
+
+#define KCOUNTERS_DESC_MAGIC 0x3153544e434b5a00ull // "\0ZKCNTS1"
+
+// A counter that is summed over every CPU.
+#define KCOUNTER_TYPE_SUM ((uint32_t)1u)
+// One bucket of a log2 histogram.  A histogram occupies
+// KCOUNTER_HISTOGRAM_BUCKETS consecutive slots with the same name, whose
+// |bucket| fields run from 0 up.
+#define KCOUNTER_TYPE_HISTOGRAM ((uint32_t)2u)
+
+// Bucket 0 of a histogram counts values <= 0, and bucket b > 0 counts
+// values in [2^(b-1), 2^b).  The last bucket also counts every larger value.
+#define KCOUNTER_HISTOGRAM_BUCKETS 32u
+
+#define KCOUNTER_NAME_MAX 56u
+
+typedef struct kcounter_desc_entry {
+    // NUL-terminated.
+    char name[KCOUNTER_NAME_MAX];
+    uint32_t type;
+    // For KCOUNTER_TYPE_HISTOGRAM, which bucket this slot counts.
+    uint32_t bucket;
+} kcounter_desc_entry_t;
+
+typedef struct kcounters_desc_vmo {
+    uint64_t magic;
+    // Size of a row of the arena, in slots.
+    uint64_t num_counters;
+    // Number of rows in the arena.
+    uint64_t max_cpus;
+    // num_counters entries, sorted by name.
+    kcounter_desc_entry_t descriptors[];
+} kcounters_desc_vmo_t;
+
+// Returns the lower bound of the values counted by |bucket|.
+static inline int64_t kcounter_histogram_bucket_floor(uint32_t bucket) {
+    return bucket == 0 ? INT64_MIN : (int64_t)1 << (bucket - 1);
+}
+
+__END_CDECLS
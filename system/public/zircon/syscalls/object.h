@@ -36,6 +36,10 @@ typedef uint32_t zx_object_info_topic_t;
 #define ZX_INFO_PROCESS_HANDLE_STATS    ((zx_object_info_topic_t) 21u) // zx_info_process_handle_stats_t[1]
 #define ZX_INFO_SOCKET                  ((zx_object_info_topic_t) 22u) // zx_info_socket_t[1]
 #define ZX_INFO_VMO                     ((zx_object_info_topic_t) 23u) // zx_info_vmo_t[1]
+#define ZX_INFO_OBJECT_CACHES           ((zx_object_info_topic_t) 24u) // zx_info_object_cache_t[n]
+#define ZX_INFO_SCHED_LATENCY           ((zx_object_info_topic_t) 25u) // zx_info_sched_latency_t[n]
+#define ZX_INFO_TASK_FAULTS             ((zx_object_info_topic_t) 26u) // zx_info_task_faults_t[1]
+#define ZX_INFO_TASK_SYSCALLS           ((zx_object_info_topic_t) 27u) // zx_info_task_syscall_t[n]
 
 typedef uint32_t zx_obj_props_t;
 #define ZX_OBJ_PROP_NONE                ((zx_obj_props_t)0u)
@@ -105,9 +109,15 @@ typedef struct zx_info_thread {
     uint32_t wait_exception_port_type;
 } zx_info_thread_t;
 
+#define ZX_INFO_INVALID_CPU                 ((uint32_t)0xFFFFFFFFu)
+
 typedef struct zx_info_thread_stats {
     // Total accumulated running time of the thread.
     zx_duration_t total_runtime;
+
+    // CPU number that this thread was last scheduled on, or ZX_INFO_INVALID_CPU
+    // if the thread has never been scheduled on a CPU.
+    uint32_t last_scheduled_cpu;
 } zx_info_thread_stats_t;
 
 // Statistics about resources (e.g., memory) used by a task. Can be relatively
@@ -138,6 +148,35 @@ typedef struct zx_info_task_stats {
     size_t mem_scaled_shared_bytes;
 } zx_info_task_stats_t;
 
+// Page faults taken by a thread, or by all the threads of a process
+// including those that have exited.
+typedef struct zx_info_task_faults {
+    // Faults by reads and by writes.
+    uint64_t read_faults;
+    uint64_t write_faults;
+
+    // The subset of faults that copied a page from a parent VMO
+    // (copy-on-write), and that were satisfied with a zero page, either
+    // newly allocated or the shared zero page for reads.
+    uint64_t cow_faults;
+    uint64_t zero_fill_faults;
+} zx_info_task_faults_t;
+
+#define ZX_MAX_SYSCALL_NAME_LEN             ((size_t)32u)
+
+// Syscalls made by a thread, or by all the threads of a process including
+// those that have exited. There is one record for each syscall the task
+// has made at least once.
+typedef struct zx_info_task_syscall {
+    // The syscall name, without the "zx_" prefix.
+    char name[ZX_MAX_SYSCALL_NAME_LEN];
+
+    // The number of calls, and the total time spent in them, including
+    // any time spent blocked.
+    uint64_t count;
+    zx_duration_t time;
+} zx_info_task_syscall_t;
+
 typedef struct zx_info_vmar {
     // Base address of the region.
     uintptr_t base;
@@ -373,6 +412,35 @@ typedef struct zx_info_kmem_stats {
     uint64_t other_bytes;
 } zx_info_kmem_stats_t;
 
+// Statistics for one of the kernel's per-type object caches.
+typedef struct zx_info_object_cache {
+    // The kind of object the cache holds, e.g. "channel".
+    char name[ZX_MAX_NAME_LEN];
+
+    // The size of each object, in bytes.
+    uint64_t object_size;
+
+    // The number of slabs backing the cache, and their total size in bytes.
+    uint64_t slab_count;
+    uint64_t slab_bytes;
+
+    // The number of objects currently allocated to their users.
+    uint64_t live_objects;
+
+    // The number of free objects held in the per-cpu caches.
+    uint64_t cached_objects;
+
+    // The number of objects, live or cached, that came from the general heap
+    // because the cache had reached its slab limit.
+    uint64_t heap_objects;
+
+    // The total number of allocations and frees made through the cache, and
+    // how many allocations were satisfied by a per-cpu cache.
+    uint64_t alloc_count;
+    uint64_t free_count;
+    uint64_t cpu_cache_hits;
+} zx_info_object_cache_t;
+
 typedef struct zx_info_resource {
     // The resource kind; resource object kinds are detailed in the resource.md
     uint32_t kind;
@@ -387,6 +455,32 @@ typedef struct zx_info_resource {
 
 #define ZX_INFO_CPU_STATS_FLAG_ONLINE       (1u<<0)
 
+// Scheduler latency histograms are log-linear over nanoseconds: values below
+// 4ns have a bucket each, and every power of two above that is split into
+// ZX_SCHED_LATENCY_SUB_BUCKETS equal buckets.  Bucket |i| >= 4 starts at
+// (4 + i % 4) << (i / 4 - 1) nanoseconds.  The last bucket also counts every
+// larger value, so it starts at 7.5 seconds and has no upper bound.
+#define ZX_SCHED_LATENCY_SUB_BUCKETS        4u
+#define ZX_SCHED_LATENCY_BUCKETS            128u
+
+// Scheduler latency histograms for one cpu.
+typedef struct zx_info_sched_latency {
+    uint32_t cpu_number;
+    // ZX_INFO_CPU_STATS_FLAG_ONLINE if the cpu is online.
+    uint32_t flags;
+
+    // Time from a blocked thread being made ready to it running on this cpu.
+    uint64_t wakeup[ZX_SCHED_LATENCY_BUCKETS];
+
+    // Time a thread that was preempted, yielded or rescheduled spent back
+    // in this cpu's run queue before running again.
+    uint64_t run_queue[ZX_SCHED_LATENCY_BUCKETS];
+
+    // Time a thread had been running on this cpu when it was involuntarily
+    // preempted, by its time slice expiring or by a higher priority thread.
+    uint64_t preempted_slice[ZX_SCHED_LATENCY_BUCKETS];
+} zx_info_sched_latency_t;
+
 // Object properties.
 
 // Argument is a char[ZX_MAX_NAME_LEN].
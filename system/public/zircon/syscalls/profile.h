@@ -12,6 +12,7 @@ __BEGIN_CDECLS
 // clang-format off
 
 #define ZX_PROFILE_INFO_SCHEDULER   1
+#define ZX_PROFILE_INFO_CPU_MASK    2
 
 typedef struct zx_profile_scheduler {
     int32_t priority;
@@ -20,6 +21,12 @@ typedef struct zx_profile_scheduler {
     uint32_t quantum;
 } zx_profile_scheduler_t;
 
+// Restricts a thread to the cpus whose bits are set in |mask|, where
+// bit n is cpu n.
+typedef struct zx_profile_cpu_mask {
+    uint32_t mask;
+} zx_profile_cpu_mask_t;
+
 #define ZX_PRIORITY_LOWEST              0
 #define ZX_PRIORITY_LOW                 8
 #define ZX_PRIORITY_DEFAULT             16
@@ -30,6 +37,7 @@ typedef struct zx_profile_info {
     uint32_t type;                  // one of ZX_PROFILE_INFO_
     union {
         zx_profile_scheduler_t scheduler;
+        zx_profile_cpu_mask_t cpu_mask;
     };
 } zx_profile_info_t;
 
@@ -188,6 +188,12 @@ typedef struct zx_channel_call_args {
     uint32_t rd_num_handles;
 } zx_channel_call_args_t;
 
+// Structure for scatter/gather I/O, e.g. zx_socket_readv() and zx_socket_writev().
+typedef struct zx_iovec {
+    void* buffer;
+    size_t capacity;
+} zx_iovec_t;
+
 // Maximum number of wait items allowed for zx_object_wait_many()
 // TODO(ZX-1349) Re-lower this.
 #define ZX_WAIT_MANY_MAX_ITEMS ((size_t)16)
@@ -332,6 +338,10 @@ typedef uint64_t zx_off_t;
 // These can be passed to zx_socket_read() and zx_socket_write().
 #define ZX_SOCKET_CONTROL                   ((uint32_t)1u << 2)
 
+// Maximum number of zx_iovec_t entries accepted by zx_socket_readv() and
+// zx_socket_writev().
+#define ZX_SOCKET_IOVEC_MAX                 ((size_t)16u)
+
 // Flags which can be used to to control cache policy for APIs which map memory.
 #define ZX_CACHE_POLICY_CACHED              ((uint32_t)0u)
 #define ZX_CACHE_POLICY_UNCACHED            ((uint32_t)1u)
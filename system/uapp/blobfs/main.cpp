@@ -2,11 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <ctype.h>
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <libgen.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,6 +29,7 @@
 #include <trace-provider/provider.h>
 #include <zircon/process.h>
 #include <zircon/processargs.h>
+#include <zircon/syscalls.h>
 
 namespace {
 
@@ -97,6 +101,11 @@ int usage() {
             "\n"
             "options: -r|--readonly  Mount filesystem read-only\n"
             "         -m|--metrics   Collect filesystem metrics\n"
+            "         -c|--cache-size <MB>\n"
+            "                        Keep up to this much of closed blobs' data in memory\n"
+            "                        (by default, it is evicted as soon as they are closed)\n"
+            "         -w|--write-workers <N>\n"
+            "                        Hash and compress blobs being written on N threads\n"
             "         -h|--help      Display this message\n"
             "\n"
             "On Fuchsia, blobfs takes the block device argument by handle.\n"
@@ -111,6 +120,22 @@ int usage() {
     return -1;
 }
 
+// Parses |str| as a decimal number no larger than |max|.
+bool ParseNumber(const char* str, uint64_t max, uint64_t* out) {
+    // strtoull() would also accept leading whitespace and a sign.
+    if (!isdigit(static_cast<unsigned char>(str[0]))) {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    uint64_t value = strtoull(str, &end, 10);
+    if (errno != 0 || *end != '\0' || value > max) {
+        return false;
+    }
+    *out = value;
+    return true;
+}
+
 // Process options/commands and return open fd to device
 int ProcessArgs(int argc, char** argv, CommandFunction* func, blobfs::MountOptions* options) {
     while (1) {
@@ -118,11 +143,13 @@ int ProcessArgs(int argc, char** argv, CommandFunction* func, blobfs::MountOptio
             {"readonly", no_argument, nullptr, 'r'},
             {"metrics", no_argument, nullptr, 'm'},
             {"journal", no_argument, nullptr, 'j'},
+            {"cache-size", required_argument, nullptr, 'c'},
+            {"write-workers", required_argument, nullptr, 'w'},
             {"help", no_argument, nullptr, 'h'},
             {nullptr, 0, nullptr, 0},
         };
         int opt_index;
-        int c = getopt_long(argc, argv, "rmjh", opts, &opt_index);
+        int c = getopt_long(argc, argv, "rmjc:w:h", opts, &opt_index);
         if (c < 0) {
             break;
         }
@@ -136,6 +163,27 @@ int ProcessArgs(int argc, char** argv, CommandFunction* func, blobfs::MountOptio
         case 'j':
             options->journal = true;
             break;
+        case 'c': {
+            // The cache cannot usefully be larger than physical memory.
+            uint64_t megabytes;
+            if (!ParseNumber(optarg, zx_system_get_physmem() >> 20, &megabytes)) {
+                fprintf(stderr, "blobfs: Invalid cache size: %s\n", optarg);
+                return usage();
+            }
+            options->cache_policy = blobfs::CachePolicy::EvictLeastRecentlyUsed;
+            options->cache_size = megabytes << 20;
+            break;
+        }
+        case 'w': {
+            // Blobfs caps the workers at the number of CPUs.
+            uint64_t workers;
+            if (!ParseNumber(optarg, UINT32_MAX, &workers)) {
+                fprintf(stderr, "blobfs: Invalid number of write workers: %s\n", optarg);
+                return usage();
+            }
+            options->write_workers = static_cast<uint32_t>(workers);
+            break;
+        }
         case 'h':
         default:
             return usage();
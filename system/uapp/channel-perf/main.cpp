@@ -9,9 +9,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <threads.h>
 
 #include <fbl/algorithm.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <zircon/compiler.h>
 #include <zircon/syscalls.h>
 #include <zircon/time.h>
@@ -114,6 +116,111 @@ void do_test(uint32_t duration_sec, const TestArgs& test_args) {
            test_args.size, test_args.handles, test_args.queue, its_per_second);
 }
 
+// Echoes every message received on |arg| (a channel handle) back to the
+// sender until the other endpoint is closed.
+int echo_server(void* arg) {
+    zx_handle_t channel = static_cast<zx_handle_t>(reinterpret_cast<uintptr_t>(arg));
+    uint8_t data[ZX_CHANNEL_MAX_MSG_BYTES];
+
+    for (;;) {
+        zx_signals_t pending;
+        zx_status_t status = zx_object_wait_one(channel,
+                                                ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                                                ZX_TIME_INFINITE, &pending);
+        assert(status == ZX_OK);
+
+        uint32_t r_size = 0;
+        status = zx_channel_read(channel, 0u, data, nullptr, sizeof(data), 0u,
+                                 &r_size, nullptr);
+        if (status == ZX_ERR_PEER_CLOSED)
+            break;
+        assert(status == ZX_OK);
+
+        // The reply carries the request's txid (its first four bytes).
+        status = zx_channel_write(channel, 0u, data, r_size, nullptr, 0u);
+        assert(status == ZX_OK);
+    }
+
+    zx_handle_close(channel);
+    return 0;
+}
+
+int compare_durations(const void* a, const void* b) {
+    zx_duration_t lhs = *static_cast<const zx_duration_t*>(a);
+    zx_duration_t rhs = *static_cast<const zx_duration_t*>(b);
+    return lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+}
+
+// Returns the |per_mille|th per-mille of the sorted |samples|.
+zx_duration_t percentile(const fbl::Vector<zx_duration_t>& samples, uint32_t per_mille) {
+    size_t index = (samples.size() - 1) * per_mille / 1000u;
+    return samples[index];
+}
+
+// Measures zx_channel_call() round trips of |size| bytes to a server thread
+// that echoes each request, and reports the latency distribution.
+void do_call_test(uint32_t duration_sec, uint32_t size) {
+    __UNUSED zx_status_t status;
+
+    zx_duration_t duration_ns = ZX_SEC(duration_sec);
+
+    zx_handle_t mp[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
+    status = zx_channel_create(0u, &mp[0], &mp[1]);
+    assert(status == ZX_OK);
+
+    thrd_t server;
+    int rc = thrd_create(&server, echo_server,
+                         reinterpret_cast<void*>(static_cast<uintptr_t>(mp[1])));
+    assert(rc == thrd_success);
+
+    // Leave room for the txid at the start of the message.
+    size = fbl::max(size, static_cast<uint32_t>(sizeof(zx_txid_t)));
+    fbl::unique_ptr<uint8_t[]> wr_data(new uint8_t[size]);
+    fbl::unique_ptr<uint8_t[]> rd_data(new uint8_t[size]);
+    for (uint32_t i = 0; i < size; i++)
+        wr_data[i] = static_cast<uint8_t>(i);
+
+    zx_channel_call_args_t args = {
+        .wr_bytes = wr_data.get(),
+        .wr_handles = nullptr,
+        .rd_bytes = rd_data.get(),
+        .rd_handles = nullptr,
+        .wr_num_bytes = size,
+        .wr_num_handles = 0u,
+        .rd_num_bytes = size,
+        .rd_num_handles = 0u,
+    };
+
+    fbl::Vector<zx_duration_t> samples;
+    zx_time_t start_ns = zx_clock_get_monotonic();
+    zx_time_t end_ns = start_ns;
+    while (zx_time_sub_time(end_ns, start_ns) < duration_ns) {
+        uint32_t r_size = 0;
+        uint32_t r_handles = 0;
+        zx_time_t call_start = zx_clock_get_monotonic();
+        status = zx_channel_call(mp[0], 0u, ZX_TIME_INFINITE, &args, &r_size, &r_handles);
+        assert(status == ZX_OK);
+        assert(r_size == size);
+        end_ns = zx_clock_get_monotonic();
+        samples.push_back(zx_time_sub_time(end_ns, call_start));
+    }
+
+    // Closing our end makes the server exit.
+    status = zx_handle_close(mp[0]);
+    assert(status == ZX_OK);
+    rc = thrd_join(server, nullptr);
+    assert(rc == thrd_success);
+
+    qsort(samples.get(), samples.size(), sizeof(zx_duration_t), compare_durations);
+
+    double real_duration = static_cast<double>(zx_time_sub_time(end_ns, start_ns)) / 1000000000.0;
+    printf("call %" PRIu32 " bytes: %.0f calls/second, latency ns: "
+           "p50 %" PRId64 " p90 %" PRId64 " p99 %" PRId64 " p99.9 %" PRId64 " max %" PRId64 "\n",
+           size, static_cast<double>(samples.size()) / real_duration,
+           percentile(samples, 500), percentile(samples, 900), percentile(samples, 990),
+           percentile(samples, 999), samples[samples.size() - 1]);
+}
+
 }  // namespace
 
 int main(int argc, char** argv) {
@@ -124,6 +231,7 @@ int main(int argc, char** argv) {
         "  -h    show help (this)\n"
         "  -o    run single test (default)\n"
         "  -s    run suite (ignores -S/-H/-Q)\n"
+        "  -c    measure zx_channel_call() round trips instead (ignores -H/-Q)\n"
         "  -n N  set test repetition count to N (default: 1)\n"
         "  -d N  set test duration to N seconds (default: 5)\n"
         "  -S N  set message size to N bytes (default: 10)\n"
@@ -131,6 +239,7 @@ int main(int argc, char** argv) {
         "  -Q N  set message pre-queue count to N messages (default: 0)\n";
 
     bool run_suite = false;  // -o/-s
+    bool run_call = false;   // -c
     uint32_t duration = 5;   // -d
     uint32_t repeats = 1;    // -n
     // Ignored when running a suite:
@@ -141,7 +250,7 @@ int main(int argc, char** argv) {
     };
 
     int opt;
-    while ((opt = getopt(argc, argv, "+hosn:d:S:H:Q:")) != -1) {
+    while ((opt = getopt(argc, argv, "+hoscn:d:S:H:Q:")) != -1) {
         // Our option values are always unsigned numbers.
         uint32_t value = 0;
         if (optarg) {
@@ -163,6 +272,9 @@ int main(int argc, char** argv) {
             case 's':
                 run_suite = true;
                 break;
+            case 'c':
+                run_call = true;
+                break;
             case 'n':
                 assert(optarg);
                 repeats = value;
@@ -199,7 +311,15 @@ int main(int argc, char** argv) {
                    repeats);
         }
 
-        if (run_suite) {
+        if (run_call) {
+            if (run_suite) {
+                static constexpr uint32_t suite[] = {16, 100, 1000, 10000};
+                for (size_t i = 0; i < fbl::count_of(suite); i++)
+                    do_call_test(duration, suite[i]);
+            } else {
+                do_call_test(duration, test_args.size);
+            }
+        } else if (run_suite) {
             static constexpr TestArgs suite[] = {
                 {10, 0, 0},
                 {100, 0, 0},
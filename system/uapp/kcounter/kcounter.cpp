@@ -0,0 +1,291 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Prints the kernel counters, or watches how they change, by mapping the
+// VMOs the kernel exports them through (see <zircon/kcounters.h>).
+
+#include <fbl/unique_ptr.h>
+#include <lib/fdio/io.h>
+#include <lib/zx/time.h>
+#include <lib/zx/vmar.h>
+#include <lib/zx/vmo.h>
+#include <zircon/kcounters.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kDescPath[] = "/boot/kernel/" KCOUNTERS_DESC_VMO_NAME;
+constexpr char kArenaPath[] = "/boot/kernel/" KCOUNTERS_ARENA_VMO_NAME;
+constexpr uint32_t kDefaultIntervalMs = 1000;
+
+// Maps the whole VMO backing the file at |path| read-only.
+zx_status_t map_file(const char* path, const void** data, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    zx::vmo vmo;
+    zx_status_t status = fdio_get_vmo_exact(fd, vmo.reset_and_get_address());
+    close(fd);
+    if (status != ZX_OK) {
+        return status;
+    }
+    uint64_t vmo_size;
+    if ((status = vmo.get_size(&vmo_size)) != ZX_OK) {
+        return status;
+    }
+    uintptr_t addr;
+    status = zx::vmar::root_self()->map(0, vmo, 0, vmo_size, ZX_VM_PERM_READ, &addr);
+    if (status != ZX_OK) {
+        return status;
+    }
+    *data = reinterpret_cast<const void*>(addr);
+    *size = vmo_size;
+    return ZX_OK;
+}
+
+class Counters {
+public:
+    zx_status_t Init() {
+        const void* desc;
+        size_t desc_size;
+        zx_status_t status = map_file(kDescPath, &desc, &desc_size);
+        if (status != ZX_OK) {
+            fprintf(stderr, "kcounter: cannot map %s: %s\n", kDescPath,
+                    zx_status_get_string(status));
+            return status;
+        }
+        desc_ = static_cast<const kcounters_desc_vmo_t*>(desc);
+        if (desc_size < sizeof(*desc_) || desc_->magic != KCOUNTERS_DESC_MAGIC ||
+            desc_size < sizeof(*desc_) + desc_->num_counters * sizeof(kcounter_desc_entry_t)) {
+            fprintf(stderr, "kcounter: %s is not a counter descriptor table\n", kDescPath);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+
+        const void* arena;
+        size_t arena_size;
+        status = map_file(kArenaPath, &arena, &arena_size);
+        if (status != ZX_OK) {
+            fprintf(stderr, "kcounter: cannot map %s: %s\n", kArenaPath,
+                    zx_status_get_string(status));
+            return status;
+        }
+        if (arena_size < desc_->num_counters * desc_->max_cpus * sizeof(int64_t)) {
+            fprintf(stderr, "kcounter: %s is too small\n", kArenaPath);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        arena_ = static_cast<const volatile int64_t*>(arena);
+        return ZX_OK;
+    }
+
+    size_t num_slots() const { return desc_->num_counters; }
+    const kcounter_desc_entry_t& desc(size_t slot) const { return desc_->descriptors[slot]; }
+
+    // Returns the slot following the counter that starts at |slot|.
+    size_t next(size_t slot) const {
+        return desc(slot).type == KCOUNTER_TYPE_HISTOGRAM ?
+            slot + KCOUNTER_HISTOGRAM_BUCKETS : slot + 1;
+    }
+
+    // Stores the value of every slot, summed over all cpus, in |values|.
+    void Sample(int64_t* values) const {
+        const size_t n = desc_->num_counters;
+        for (size_t slot = 0; slot < n; ++slot) {
+            values[slot] = 0;
+        }
+        for (size_t cpu = 0; cpu < desc_->max_cpus; ++cpu) {
+            const volatile int64_t* row = arena_ + cpu * n;
+            for (size_t slot = 0; slot < n; ++slot) {
+                values[slot] += row[slot];
+            }
+        }
+    }
+
+private:
+    const kcounters_desc_vmo_t* desc_ = nullptr;
+    const volatile int64_t* arena_ = nullptr;
+};
+
+bool matches(const char* name, int num_prefixes, char* const* prefixes) {
+    if (num_prefixes == 0) {
+        return true;
+    }
+    for (int i = 0; i < num_prefixes; ++i) {
+        if (strncmp(name, prefixes[i], strlen(prefixes[i])) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Prints the non-empty buckets of the histogram at |values|, as
+// [<bucket lower bound>:<count>].
+void print_buckets(const int64_t* values) {
+    for (uint32_t bucket = 0; bucket < KCOUNTER_HISTOGRAM_BUCKETS; ++bucket) {
+        if (values[bucket] == 0) {
+            continue;
+        }
+        if (bucket == 0) {
+            printf(" [<=0:%" PRId64 "]", values[bucket]);
+        } else {
+            printf(" [%" PRId64 ":%" PRId64 "]",
+                   kcounter_histogram_bucket_floor(bucket), values[bucket]);
+        }
+    }
+}
+
+int64_t histogram_total(const int64_t* values) {
+    int64_t total = 0;
+    for (uint32_t bucket = 0; bucket < KCOUNTER_HISTOGRAM_BUCKETS; ++bucket) {
+        total += values[bucket];
+    }
+    return total;
+}
+
+void print_counters(const Counters& counters, const int64_t* values, bool all,
+                    int num_prefixes, char* const* prefixes) {
+    for (size_t slot = 0; slot < counters.num_slots(); slot = counters.next(slot)) {
+        const kcounter_desc_entry_t& desc = counters.desc(slot);
+        if (!matches(desc.name, num_prefixes, prefixes)) {
+            continue;
+        }
+        if (desc.type == KCOUNTER_TYPE_HISTOGRAM) {
+            int64_t total = histogram_total(&values[slot]);
+            if (total == 0 && !all) {
+                continue;
+            }
+            printf("%-48s %14" PRId64 " samples", desc.name, total);
+            print_buckets(&values[slot]);
+            printf("\n");
+        } else {
+            if (values[slot] == 0 && !all) {
+                continue;
+            }
+            printf("%-48s %14" PRId64 "\n", desc.name, values[slot]);
+        }
+    }
+}
+
+// Prints how every counter changed between |before| and |after|, |elapsed|
+// apart, into |delta|.
+void print_deltas(const Counters& counters, const int64_t* before, const int64_t* after,
+                  int64_t* delta, zx::duration elapsed, bool all,
+                  int num_prefixes, char* const* prefixes) {
+    const double seconds = static_cast<double>(elapsed.get()) / static_cast<double>(ZX_SEC(1));
+    for (size_t slot = 0; slot < counters.num_slots(); ++slot) {
+        delta[slot] = after[slot] - before[slot];
+    }
+    for (size_t slot = 0; slot < counters.num_slots(); slot = counters.next(slot)) {
+        const kcounter_desc_entry_t& desc = counters.desc(slot);
+        if (!matches(desc.name, num_prefixes, prefixes)) {
+            continue;
+        }
+        int64_t change = desc.type == KCOUNTER_TYPE_HISTOGRAM ?
+            histogram_total(&delta[slot]) : delta[slot];
+        if (change == 0 && !all) {
+            continue;
+        }
+        printf("%-48s %+14" PRId64 " %12.1f/s", desc.name, change,
+               static_cast<double>(change) / seconds);
+        if (desc.type == KCOUNTER_TYPE_HISTOGRAM) {
+            print_buckets(&delta[slot]);
+        }
+        printf("\n");
+    }
+}
+
+void usage(void) {
+    fprintf(stderr,
+            "usage: kcounter [options] [<prefix>...]\n"
+            "Prints the kernel counters whose names start with one of the\n"
+            "prefixes, or all of them.  Histograms are printed as\n"
+            "[<bucket lower bound>:<count>].\n"
+            "\n"
+            "options:\n"
+            "  -w          watch the counters, printing how much they changed and\n"
+            "              their rate of change every interval\n"
+            "  -i <ms>     interval between samples when watching (default %u)\n"
+            "  -n <count>  stop watching after <count> intervals (default: never)\n"
+            "  -a          also print counters that are zero or did not change\n",
+            kDefaultIntervalMs);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool watch = false;
+    bool all = false;
+    uint32_t interval_ms = kDefaultIntervalMs;
+    uint32_t count = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "wi:n:ah")) != -1) {
+        switch (opt) {
+        case 'w':
+            watch = true;
+            break;
+        case 'i':
+            interval_ms = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+            break;
+        case 'n':
+            count = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+            break;
+        case 'a':
+            all = true;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if (interval_ms == 0) {
+        usage();
+        return 1;
+    }
+    const int num_prefixes = argc - optind;
+    char* const* prefixes = argv + optind;
+
+    Counters counters;
+    if (counters.Init() != ZX_OK) {
+        return 1;
+    }
+
+    const size_t n = counters.num_slots();
+    fbl::unique_ptr<int64_t[]> before(new int64_t[n]);
+    counters.Sample(before.get());
+    if (!watch) {
+        print_counters(counters, before.get(), all, num_prefixes, prefixes);
+        return 0;
+    }
+
+    fbl::unique_ptr<int64_t[]> after(new int64_t[n]);
+    fbl::unique_ptr<int64_t[]> delta(new int64_t[n]);
+    zx::time last = zx::clock::get_monotonic();
+    zx::time deadline = last;
+    for (uint32_t i = 0; count == 0 || i < count; ++i) {
+        deadline += zx::msec(interval_ms);
+        zx::nanosleep(deadline);
+        counters.Sample(after.get());
+        zx::time now = zx::clock::get_monotonic();
+
+        printf("--- %" PRId64 ".%03" PRId64 "s\n", now.get() / ZX_SEC(1),
+               now.get() % ZX_SEC(1) / ZX_MSEC(1));
+        print_deltas(counters, before.get(), after.get(), delta.get(), now - last, all,
+                     num_prefixes, prefixes);
+        fflush(stdout);
+
+        before.swap(after);
+        last = now;
+    }
+    return 0;
+}
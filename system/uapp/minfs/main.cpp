@@ -82,6 +82,10 @@ int usage() {
                     "    -v|--verbose                  Some debug messages\n"
                     "    -r|--readonly                 Mount filesystem read-only\n"
                     "    -m|--metrics                  Collect filesystem metrics\n"
+                    "    -j|--journal                  Journal metadata (default)\n"
+                    "    -n|--no-journal               When mkfs, do not reserve a journal\n"
+                    "    -e|--extents                  When mkfs, map files with extent trees\n"
+                    "                                  rather than indirect blocks\n"
                     "    -s|--fvm_data_slices SLICES   When mkfs on top of FVM,\n"
                     "                                  preallocate |SLICES| slices of data. \n"
                     "    -h|--help                     Display this message\n"
@@ -120,13 +124,15 @@ int main(int argc, char** argv) {
             {"readonly", no_argument, nullptr, 'r'},
             {"metrics", no_argument, nullptr, 'm'},
             {"journal", no_argument, nullptr, 'j'},
+            {"no-journal", no_argument, nullptr, 'n'},
+            {"extents", no_argument, nullptr, 'e'},
             {"verbose", no_argument, nullptr, 'v'},
             {"fvm_data_slices", required_argument, nullptr, 's'},
             {"help", no_argument, nullptr, 'h'},
             {nullptr, 0, nullptr, 0},
         };
         int opt_index;
-        int c = getopt_long(argc, argv, "rmjvhs:", opts, &opt_index);
+        int c = getopt_long(argc, argv, "rmjnevhs:", opts, &opt_index);
         if (c < 0) {
             break;
         }
@@ -138,9 +144,15 @@ int main(int argc, char** argv) {
             options.metrics = true;
             break;
         case 'j':
-            //TODO(planders): Enable journaling here once minfs supports it.
-            fprintf(stderr, "minfs: Journaling option not supported\n");
-            return usage();
+            // Filesystems created with a journal always use it.
+            options.journal = true;
+            break;
+        case 'n':
+            options.journal = false;
+            break;
+        case 'e':
+            options.extents = true;
+            break;
         case 'v':
             options.verbose = true;
             break;
@@ -23,9 +23,14 @@
 
 enum sort_order {
     UNSORTED,
-    SORT_TIME_DELTA
+    SORT_TIME_DELTA,
+    SORT_FAULTS_DELTA,
+    SORT_SYSCALL_TIME_DELTA
 };
 
+// the most syscalls a thread is expected to have used
+#define MAX_SYSCALLS 256
+
 typedef struct {
     struct list_node node;
 
@@ -40,6 +45,15 @@ typedef struct {
     zx_info_thread_stats_t stats;
     char name[ZX_MAX_NAME_LEN];
     char proc_name[ZX_MAX_NAME_LEN];
+
+    // page fault and syscall accounting, only gathered with -s
+    zx_info_task_faults_t faults;
+    zx_info_task_syscall_t* syscalls;
+    size_t num_syscalls;
+    uint64_t delta_faults;
+    uint64_t delta_syscalls;
+    zx_duration_t delta_syscall_time;
+    char top_syscall[ZX_MAX_SYSCALL_NAME_LEN];
 } thread_info_t;
 
 // arguments
@@ -48,9 +62,11 @@ static int count = -1;
 static bool print_all = false;
 static bool raw_time = false;
 static enum sort_order sort_order = SORT_TIME_DELTA;
+static bool syscall_mode = false;
 
 // active locals
 static struct list_node thread_list = LIST_INITIAL_VALUE(thread_list);
+static zx_info_task_syscall_t syscall_buf[MAX_SYSCALLS];
 static char last_process_name[ZX_MAX_NAME_LEN];
 static zx_koid_t last_process_scanned;
 
@@ -88,6 +104,61 @@ static zx_status_t process_callback(void* unused_ctx, int depth,
     return status;
 }
 
+// Fetches the page fault and syscall counts of |thread| into |e|.
+static zx_status_t get_accounting(zx_handle_t thread, thread_info_t* e) {
+    zx_status_t status = zx_object_get_info(
+        thread, ZX_INFO_TASK_FAULTS, &e->faults, sizeof(e->faults), NULL, NULL);
+    if (status != ZX_OK) {
+        return status;
+    }
+    size_t actual;
+    status = zx_object_get_info(
+        thread, ZX_INFO_TASK_SYSCALLS, syscall_buf, sizeof(syscall_buf), &actual, NULL);
+    if (status != ZX_OK) {
+        return status;
+    }
+    e->syscalls = malloc(actual * sizeof(zx_info_task_syscall_t));
+    if (e->syscalls == NULL) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    memcpy(e->syscalls, syscall_buf, actual * sizeof(zx_info_task_syscall_t));
+    e->num_syscalls = actual;
+    return ZX_OK;
+}
+
+static uint64_t total_faults(const zx_info_task_faults_t* faults) {
+    return faults->read_faults + faults->write_faults;
+}
+
+// Computes the accounting deltas between the |old| and |new| scans of a
+// thread, including the syscall it spent the most time in.
+static void compute_accounting_delta(thread_info_t* old, const thread_info_t* new) {
+    old->delta_faults = total_faults(&new->faults) - total_faults(&old->faults);
+    old->delta_syscalls = 0;
+    old->delta_syscall_time = 0;
+    old->top_syscall[0] = '\0';
+
+    zx_duration_t top_time = 0;
+    for (size_t i = 0; i < new->num_syscalls; i++) {
+        const zx_info_task_syscall_t* cur = &new->syscalls[i];
+        uint64_t count = cur->count;
+        zx_duration_t time = cur->time;
+        for (size_t j = 0; j < old->num_syscalls; j++) {
+            if (!strcmp(old->syscalls[j].name, cur->name)) {
+                count -= old->syscalls[j].count;
+                time -= old->syscalls[j].time;
+                break;
+            }
+        }
+        old->delta_syscalls += count;
+        old->delta_syscall_time += time;
+        if (time > top_time) {
+            top_time = time;
+            strlcpy(old->top_syscall, cur->name, sizeof(old->top_syscall));
+        }
+    }
+}
+
 // Adds a thread's information to the thread_list
 static zx_status_t thread_callback(void* unused_ctx, int depth,
                                    zx_handle_t thread,
@@ -115,6 +186,12 @@ static zx_status_t thread_callback(void* unused_ctx, int depth,
     if (status != ZX_OK) {
         return status;
     }
+    if (syscall_mode) {
+        status = get_accounting(thread, &e);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
 
     // see if this thread is in the list
     thread_info_t* temp;
@@ -127,6 +204,13 @@ static zx_status_t thread_callback(void* unused_ctx, int depth,
                 zx_duration_sub_duration(e.stats.total_runtime, temp->stats.total_runtime);
             temp->info = e.info;
             temp->stats = e.stats;
+            if (syscall_mode) {
+                compute_accounting_delta(temp, &e);
+                free(temp->syscalls);
+                temp->faults = e.faults;
+                temp->syscalls = e.syscalls;
+                temp->num_syscalls = e.num_syscalls;
+            }
             return ZX_OK;
         }
     }
@@ -153,12 +237,18 @@ static void sort_threads(enum sort_order order) {
 
         bool found = false;
         list_for_every_entry (&new_list, t, thread_info_t, node) {
+            bool before = false;
             if (order == SORT_TIME_DELTA) {
-                if (e->delta_time > t->delta_time) {
-                    list_add_before(&t->node, &e->node);
-                    found = true;
-                    break;
-                }
+                before = e->delta_time > t->delta_time;
+            } else if (order == SORT_FAULTS_DELTA) {
+                before = e->delta_faults > t->delta_faults;
+            } else if (order == SORT_SYSCALL_TIME_DELTA) {
+                before = e->delta_syscall_time > t->delta_syscall_time;
+            }
+            if (before) {
+                list_add_before(&t->node, &e->node);
+                found = true;
+                break;
             }
         }
 
@@ -201,6 +291,38 @@ static void print_threads(void) {
     }
 }
 
+// Prints the page fault and syscall view of the threads.
+static void print_accounting(void) {
+    thread_info_t* e;
+    printf("%8s %8s %8s %8s %8s %8s %10s %7s %-20s %s\n",
+           "PID", "TID", "FAULTS", "COW", "ZERO", "WRITE", "SYSCALLS",
+           raw_time ? "SYS_NS" : "SYS%", "TOP_SYSCALL", "NAME");
+
+    int i = 0;
+    list_for_every_entry (&thread_list, e, thread_info_t, node) {
+        // only print threads that faulted or made syscalls
+        if (!print_all && e->delta_faults == 0 && e->delta_syscalls == 0)
+            continue;
+
+        char sys_time[16];
+        if (raw_time) {
+            snprintf(sys_time, sizeof(sys_time), "%ld", e->delta_syscall_time);
+        } else {
+            snprintf(sys_time, sizeof(sys_time), "%.2f",
+                     e->delta_syscall_time / (double)delay * 100);
+        }
+        printf("%8lu %8lu %8lu %8lu %8lu %8lu %10lu %7s %-20s %s:%s\n",
+               e->proc_koid, e->koid, e->delta_faults, e->faults.cow_faults,
+               e->faults.zero_fill_faults, e->faults.write_faults, e->delta_syscalls,
+               sys_time, e->top_syscall[0] ? e->top_syscall : "-",
+               e->proc_name, e->name);
+
+        // only print the first count items (or all, if count < 0)
+        if (++i == count)
+            break;
+    }
+}
+
 static void print_help(FILE* f) {
     fprintf(f, "Usage: top [options]\n");
     fprintf(f, "Options:\n");
@@ -210,13 +332,20 @@ static void print_help(FILE* f) {
     fprintf(f, " -n <times>      Run this many times and then exit\n");
     fprintf(f, " -o <sort field> Sort by different fields (default is time)\n");
     fprintf(f, " -r              Print raw time in nanoseconds\n");
+    fprintf(f, " -s              Show page faults and syscalls instead of cpu time\n");
     fprintf(f, "\nSupported sort fields:\n");
-    fprintf(f, "\tnone : no sorting, in job order\n");
-    fprintf(f, "\ttime : sort by delta time between scans\n");
+    fprintf(f, "\tnone     : no sorting, in job order\n");
+    fprintf(f, "\ttime     : sort by delta time between scans\n");
+    fprintf(f, "\tfaults   : sort by delta page faults between scans\n");
+    fprintf(f, "\tsyscalls : sort by delta syscall time between scans\n");
+    fprintf(f, "\nWith -s, FAULTS, SYSCALLS and SYS%% are deltas between scans,\n");
+    fprintf(f, "COW, ZERO and WRITE are the thread's total page faults of each kind,\n");
+    fprintf(f, "and TOP_SYSCALL is the syscall the thread spent the most time in.\n");
 }
 
 int main(int argc, char** argv) {
     int num_loops = -1;
+    bool sort_given = false;
     for (int i = 1; i < argc; ++i) {
         const char* arg = argv[i];
         if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) {
@@ -267,14 +396,21 @@ int main(int argc, char** argv) {
                 sort_order = UNSORTED;
             } else if (!strcmp(argv[i + 1], "time")) {
                 sort_order = SORT_TIME_DELTA;
+            } else if (!strcmp(argv[i + 1], "faults")) {
+                sort_order = SORT_FAULTS_DELTA;
+            } else if (!strcmp(argv[i + 1], "syscalls")) {
+                sort_order = SORT_SYSCALL_TIME_DELTA;
             } else {
                 fprintf(stderr, "Bad sort field\n");
                 print_help(stderr);
                 return 1;
             }
+            sort_given = true;
             i++;
         } else if (!strcmp(arg, "-r")) {
             raw_time = true;
+        } else if (!strcmp(arg, "-s")) {
+            syscall_mode = true;
         } else {
             fprintf(stderr, "Unknown option: %s\n", arg);
             print_help(stderr);
@@ -282,6 +418,10 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (syscall_mode && !sort_given) {
+        sort_order = SORT_SYSCALL_TIME_DELTA;
+    }
+
     // set stdin to non blocking
     fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
 
@@ -310,6 +450,7 @@ int main(int argc, char** argv) {
         list_for_every_entry_safe (&thread_list, e, temp, thread_info_t, node) {
             if (!e->scanned) {
                 list_delete(&e->node);
+                free(e->syscalls);
                 free(e);
             }
         }
@@ -325,7 +466,11 @@ int main(int argc, char** argv) {
         sort_threads(sort_order);
 
         // dump the list of threads
-        print_threads();
+        if (syscall_mode) {
+            print_accounting();
+        } else {
+            print_threads();
+        }
 
         if (num_loops > 0) {
             if (--num_loops == 0) {
@@ -0,0 +1,30 @@
+# Copyright 2018 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := userapp
+MODULE_GROUP := misc
+
+MODULE_SRCS += \
+    $(LOCAL_DIR)/sampler.cpp
+
+MODULE_LIBS := \
+    system/ulib/c \
+    system/ulib/fdio \
+    system/ulib/zircon \
+
+MODULE_STATIC_LIBS := \
+    system/ulib/elf-search \
+    system/ulib/fbl \
+    system/ulib/task-utils \
+    system/ulib/zx \
+    system/ulib/zxcpp \
+
+MODULE_FIDL_LIBS := \
+    system/fidl/fuchsia-sysinfo \
+
+include make/module.mk
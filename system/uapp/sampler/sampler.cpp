@@ -0,0 +1,287 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Runs a session of the kernel's sampling profiler and writes the samples,
+// along with the module layout of every sampled process, as a text profile
+// for the host side sampler-report tool to symbolize.
+
+#include <elf-search.h>
+#include <fbl/algorithm.h>
+#include <fbl/vector.h>
+#include <fuchsia/sysinfo/c/fidl.h>
+#include <lib/fdio/util.h>
+#include <lib/zircon-internal/mtrace.h>
+#include <lib/zircon-internal/sampler.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/process.h>
+#include <lib/zx/resource.h>
+#include <lib/zx/time.h>
+#include <lib/zx/vmar.h>
+#include <lib/zx/vmo.h>
+#include <task-utils/walker.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t kDefaultPeriodUs = 1000;
+constexpr uint32_t kDefaultDurationSec = 10;
+constexpr uint32_t kDefaultBufferKb = 1024;
+
+int compare_koids(const void* a, const void* b) {
+    zx_koid_t x = *static_cast<const zx_koid_t*>(a);
+    zx_koid_t y = *static_cast<const zx_koid_t*>(b);
+    return x < y ? -1 : x > y;
+}
+
+zx_status_t get_root_resource(zx::resource* root_resource) {
+    int fd = open("/dev/misc/sysinfo", O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "sampler: cannot open sysinfo: %s\n", strerror(errno));
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    zx::channel channel;
+    zx_status_t status = fdio_get_service_handle(fd, channel.reset_and_get_address());
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    zx_handle_t h;
+    zx_status_t fidl_status = fuchsia_sysinfo_DeviceGetRootResource(channel.get(), &status, &h);
+    if (fidl_status != ZX_OK) {
+        return fidl_status;
+    }
+    if (status != ZX_OK) {
+        return status;
+    }
+    root_resource->reset(h);
+    return ZX_OK;
+}
+
+// Finds the processes that were sampled and writes out their names and
+// module layout.  A process that exited during the session can no longer
+// be found; its samples are left unsymbolized.
+class ModuleDumper final : public TaskEnumerator {
+public:
+    ModuleDumper(const fbl::Vector<zx_koid_t>& pids, FILE* out)
+        : pids_(pids), out_(out) {}
+
+private:
+    zx_status_t OnProcess(int depth, zx_handle_t handle, zx_koid_t koid,
+                          zx_koid_t parent_koid) override {
+        if (bsearch(&koid, pids_.get(), pids_.size(), sizeof(zx_koid_t), compare_koids) == nullptr) {
+            return ZX_OK;
+        }
+        zx::unowned_process process(handle);
+        char name[ZX_MAX_NAME_LEN];
+        if (process->get_property(ZX_PROP_NAME, name, sizeof(name)) != ZX_OK) {
+            strcpy(name, "<unknown>");
+        }
+        fprintf(out_, "process %" PRIu64 " %s\n", koid, name);
+
+        ForEachModule(*process, [this, koid](const ModuleInfo& info) {
+            fprintf(out_, "module %" PRIu64 " %#" PRIxPTR " ", koid, info.vaddr);
+            for (uint8_t byte : info.build_id) {
+                fprintf(out_, "%02x", byte);
+            }
+            if (info.build_id.empty()) {
+                fprintf(out_, "-");
+            }
+            fprintf(out_, " %.*s\n", static_cast<int>(info.name.length()), info.name.data());
+        });
+        return ZX_OK;
+    }
+
+    bool has_on_process() const override { return true; }
+
+    const fbl::Vector<zx_koid_t>& pids_;
+    FILE* out_;
+};
+
+// Writes every record in the buffer and collects the koids of the user
+// processes seen, sorted and without duplicates.
+void write_samples(const uint8_t* base, FILE* out, fbl::Vector<zx_koid_t>* pids) {
+    auto header = reinterpret_cast<const sampler_buffer_header_t*>(base);
+    uint64_t total = 0;
+    uint64_t dropped = 0;
+
+    for (uint32_t cpu = 0; cpu < header->num_cpus; cpu++) {
+        auto region = reinterpret_cast<const sampler_cpu_header_t*>(
+            base + header->cpu_offset + cpu * header->cpu_stride);
+        const uint8_t* records = reinterpret_cast<const uint8_t*>(region + 1);
+        uint64_t written = fbl::min(region->written, region->size);
+        total += region->samples;
+        dropped += region->dropped;
+
+        for (uint64_t off = 0; off + sizeof(sampler_record_t) <= written;) {
+            auto rec = reinterpret_cast<const sampler_record_t*>(records + off);
+            size_t len = SAMPLER_RECORD_SIZE(rec->num_frames);
+            if (rec->num_frames > SAMPLER_MAX_FRAMES || off + len > written) {
+                fprintf(stderr, "sampler: corrupt record on cpu %u\n", cpu);
+                break;
+            }
+            bool user = rec->flags & SAMPLER_RECORD_USER;
+            fprintf(out, "sample %" PRIu64 " %" PRIu64 " %u %" PRIu64 " %c",
+                    rec->pid, rec->tid, rec->cpu, rec->time, user ? 'u' : 'k');
+            const uint64_t* pcs = SAMPLER_RECORD_PCS(rec);
+            for (uint16_t i = 0; i < rec->num_frames; i++) {
+                fprintf(out, " %#" PRIx64, pcs[i]);
+            }
+            fprintf(out, "\n");
+
+            if (user && (pids->is_empty() || (*pids)[pids->size() - 1] != rec->pid)) {
+                pids->push_back(rec->pid);
+            }
+            off += len;
+        }
+    }
+
+    qsort(pids->get(), pids->size(), sizeof(zx_koid_t), compare_koids);
+    size_t n = 0;
+    for (size_t i = 0; i < pids->size(); i++) {
+        if (n == 0 || (*pids)[n - 1] != (*pids)[i]) {
+            (*pids)[n++] = (*pids)[i];
+        }
+    }
+    while (pids->size() > n) {
+        pids->pop_back();
+    }
+
+    fprintf(stderr, "sampler: %" PRIu64 " samples, %" PRIu64 " dropped\n", total, dropped);
+}
+
+void usage(void) {
+    fprintf(stderr,
+            "usage: sampler [options]\n"
+            "Samples the running threads of every cpu and writes a profile\n"
+            "for the host tool sampler-report.\n"
+            "\n"
+            "options:\n"
+            "  -p <us>      sampling period in microseconds (default %" PRIu64 ")\n"
+            "  -d <sec>     duration of the session (default %u)\n"
+            "  -f <frames>  maximum frames per sample (default and max %u)\n"
+            "  -b <kb>      buffer size per cpu in KB (default %u)\n"
+            "  -k           sample kernel code only\n"
+            "  -u           sample user code only\n"
+            "  -o <file>    write the profile to <file> instead of stdout\n",
+            kDefaultPeriodUs, kDefaultDurationSec, SAMPLER_MAX_FRAMES, kDefaultBufferKb);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    zx_sampler_config_t config = {};
+    config.period_ns = ZX_USEC(kDefaultPeriodUs);
+    config.buffer_size = kDefaultBufferKb * 1024;
+    config.max_frames = SAMPLER_MAX_FRAMES;
+    config.flags = SAMPLER_FLAG_KERNEL | SAMPLER_FLAG_USER;
+    uint32_t duration = kDefaultDurationSec;
+    const char* output = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:d:f:b:kuo:h")) != -1) {
+        switch (opt) {
+        case 'p':
+            config.period_ns = ZX_USEC(strtoull(optarg, nullptr, 0));
+            break;
+        case 'd':
+            duration = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+            break;
+        case 'f':
+            config.max_frames = static_cast<uint16_t>(strtoul(optarg, nullptr, 0));
+            break;
+        case 'b':
+            config.buffer_size = static_cast<uint32_t>(strtoul(optarg, nullptr, 0) * 1024);
+            break;
+        case 'k':
+            config.flags = SAMPLER_FLAG_KERNEL;
+            break;
+        case 'u':
+            config.flags = SAMPLER_FLAG_USER;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    zx::resource root_resource;
+    zx_status_t status = get_root_resource(&root_resource);
+    if (status != ZX_OK) {
+        fprintf(stderr, "sampler: cannot get root resource: %s\n", zx_status_get_string(status));
+        return 1;
+    }
+
+    FILE* out = stdout;
+    if (output != nullptr && (out = fopen(output, "w")) == nullptr) {
+        fprintf(stderr, "sampler: cannot open %s: %s\n", output, strerror(errno));
+        return 1;
+    }
+
+    status = zx_mtrace_control(root_resource.get(), MTRACE_KIND_SAMPLER, MTRACE_SAMPLER_INIT, 0,
+                               &config, sizeof(config));
+    if (status != ZX_OK) {
+        fprintf(stderr, "sampler: cannot start session: %s\n", zx_status_get_string(status));
+        return 1;
+    }
+
+    zx::vmo vmo;
+    zx_handle_t vmo_handle;
+    status = zx_mtrace_control(root_resource.get(), MTRACE_KIND_SAMPLER, MTRACE_SAMPLER_GET_BUFFER,
+                               0, &vmo_handle, sizeof(vmo_handle));
+    if (status == ZX_OK) {
+        vmo.reset(vmo_handle);
+        status = zx_mtrace_control(root_resource.get(), MTRACE_KIND_SAMPLER, MTRACE_SAMPLER_START,
+                                   0, nullptr, 0);
+    }
+    if (status == ZX_OK) {
+        fprintf(stderr, "sampler: sampling every %" PRIu64 "us for %us\n",
+                config.period_ns / ZX_USEC(1), duration);
+        zx::nanosleep(zx::deadline_after(zx::sec(duration)));
+        status = zx_mtrace_control(root_resource.get(), MTRACE_KIND_SAMPLER, MTRACE_SAMPLER_STOP,
+                                   0, nullptr, 0);
+    }
+
+    uint64_t size = 0;
+    uintptr_t base = 0;
+    if (status == ZX_OK && (status = vmo.get_size(&size)) == ZX_OK) {
+        status = zx::vmar::root_self()->map(0, vmo, 0, size, ZX_VM_PERM_READ, &base);
+    }
+    if (status != ZX_OK) {
+        fprintf(stderr, "sampler: session failed: %s\n", zx_status_get_string(status));
+        zx_mtrace_control(root_resource.get(), MTRACE_KIND_SAMPLER, MTRACE_SAMPLER_FINI, 0,
+                          nullptr, 0);
+        return 1;
+    }
+
+    fprintf(out, "period_ns %" PRIu64 "\n", config.period_ns);
+    fbl::Vector<zx_koid_t> pids;
+    write_samples(reinterpret_cast<const uint8_t*>(base), out, &pids);
+    zx::vmar::root_self()->unmap(base, size);
+    zx_mtrace_control(root_resource.get(), MTRACE_KIND_SAMPLER, MTRACE_SAMPLER_FINI, 0,
+                      nullptr, 0);
+
+    ModuleDumper dumper(pids, out);
+    if ((status = dumper.WalkRootJobTree()) != ZX_OK) {
+        fprintf(stderr, "sampler: cannot walk job tree: %s\n", zx_status_get_string(status));
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,254 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Prints percentiles of the kernel's scheduler latency histograms
+// (ZX_INFO_SCHED_LATENCY), over an interval or since boot.
+
+#include <fbl/unique_ptr.h>
+#include <fuchsia/sysinfo/c/fidl.h>
+#include <lib/fdio/util.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/resource.h>
+#include <lib/zx/time.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t kDefaultDurationSec = 1;
+constexpr size_t kMaxCpus = 64;
+
+constexpr double kPercentiles[] = {50, 90, 99, 99.9};
+
+zx_status_t get_root_resource(zx::resource* root_resource) {
+    int fd = open("/dev/misc/sysinfo", O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "schedlat: cannot open sysinfo: %s\n", strerror(errno));
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    zx::channel channel;
+    zx_status_t status = fdio_get_service_handle(fd, channel.reset_and_get_address());
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    zx_handle_t h;
+    zx_status_t fidl_status = fuchsia_sysinfo_DeviceGetRootResource(channel.get(), &status, &h);
+    if (fidl_status != ZX_OK) {
+        return fidl_status;
+    }
+    if (status != ZX_OK) {
+        return status;
+    }
+    root_resource->reset(h);
+    return ZX_OK;
+}
+
+// The first nanosecond value that falls in |bucket|; see ZX_INFO_SCHED_LATENCY.
+uint64_t bucket_start(uint32_t bucket) {
+    if (bucket < ZX_SCHED_LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    uint32_t sub = bucket % ZX_SCHED_LATENCY_SUB_BUCKETS;
+    return static_cast<uint64_t>(ZX_SCHED_LATENCY_SUB_BUCKETS + sub)
+           << (bucket / ZX_SCHED_LATENCY_SUB_BUCKETS - 1);
+}
+
+struct Histogram {
+    uint64_t counts[ZX_SCHED_LATENCY_BUCKETS];
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (uint64_t count : counts) {
+            sum += count;
+        }
+        return sum;
+    }
+
+    // Returns the upper bound of the bucket holding the |percentile|th value,
+    // or -1 if that is the unbounded last bucket.
+    int64_t Percentile(double percentile) const {
+        uint64_t sum = total();
+        uint64_t rank = static_cast<uint64_t>(static_cast<double>(sum) * percentile / 100.0);
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < ZX_SCHED_LATENCY_BUCKETS - 1; i++) {
+            seen += counts[i];
+            if (seen > rank) {
+                return static_cast<int64_t>(bucket_start(i + 1));
+            }
+        }
+        return -1;
+    }
+
+    // Returns the upper bound of the highest non-empty bucket.
+    int64_t Max() const {
+        for (uint32_t i = ZX_SCHED_LATENCY_BUCKETS; i > 0; i--) {
+            if (counts[i - 1] != 0) {
+                return i == ZX_SCHED_LATENCY_BUCKETS ? -1 : static_cast<int64_t>(bucket_start(i));
+            }
+        }
+        return 0;
+    }
+};
+
+struct CpuLatency {
+    Histogram wakeup;
+    Histogram run_queue;
+    Histogram preempted_slice;
+};
+
+void accumulate(Histogram* dst, const uint64_t* now, const uint64_t* before) {
+    for (uint32_t i = 0; i < ZX_SCHED_LATENCY_BUCKETS; i++) {
+        dst->counts[i] += now[i] - (before ? before[i] : 0);
+    }
+}
+
+void format_duration(char* buf, size_t len, int64_t ns) {
+    if (ns < 0) {
+        snprintf(buf, len, "inf");
+    } else if (ns < ZX_USEC(10)) {
+        snprintf(buf, len, "%" PRId64 "ns", ns);
+    } else if (ns < ZX_MSEC(10)) {
+        snprintf(buf, len, "%" PRId64 "us", ns / ZX_USEC(1));
+    } else {
+        snprintf(buf, len, "%" PRId64 "ms", ns / ZX_MSEC(1));
+    }
+}
+
+void print_header() {
+    printf("%-5s %-16s %10s", "cpu", "latency", "count");
+    for (double p : kPercentiles) {
+        char name[16];
+        snprintf(name, sizeof(name), "p%g", p);
+        printf(" %8s", name);
+    }
+    printf(" %8s\n", "max");
+}
+
+void print_histogram(const char* cpu, const char* name, const Histogram& h) {
+    printf("%-5s %-16s %10" PRIu64, cpu, name, h.total());
+    char buf[16];
+    for (double p : kPercentiles) {
+        format_duration(buf, sizeof(buf), h.total() ? h.Percentile(p) : 0);
+        printf(" %8s", buf);
+    }
+    format_duration(buf, sizeof(buf), h.Max());
+    printf(" %8s\n", buf);
+}
+
+void print_cpu(const char* cpu, const CpuLatency& lat) {
+    print_histogram(cpu, "wakeup", lat.wakeup);
+    print_histogram(cpu, "run-queue", lat.run_queue);
+    print_histogram(cpu, "preempted-slice", lat.preempted_slice);
+}
+
+zx_status_t snapshot(const zx::resource& root, zx_info_sched_latency_t* info, size_t* num_cpus) {
+    size_t actual, avail;
+    zx_status_t status = root.get_info(ZX_INFO_SCHED_LATENCY, info,
+                                       kMaxCpus * sizeof(zx_info_sched_latency_t),
+                                       &actual, &avail);
+    *num_cpus = actual;
+    return status;
+}
+
+void usage(void) {
+    fprintf(stderr,
+            "usage: schedlat [options]\n"
+            "Prints percentiles of the scheduler's wakeup latency, run queue wait\n"
+            "and preempted time slice histograms.\n"
+            "\n"
+            "options:\n"
+            "  -d <sec>  measure over an interval of <sec> seconds (default %u);\n"
+            "            0 reports everything since boot\n"
+            "  -c        also print each cpu separately\n",
+            kDefaultDurationSec);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t duration = kDefaultDurationSec;
+    bool per_cpu = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:ch")) != -1) {
+        switch (opt) {
+        case 'd':
+            duration = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+            break;
+        case 'c':
+            per_cpu = true;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    zx::resource root_resource;
+    zx_status_t status = get_root_resource(&root_resource);
+    if (status != ZX_OK) {
+        fprintf(stderr, "schedlat: cannot get root resource: %s\n", zx_status_get_string(status));
+        return 1;
+    }
+
+    // The records are several KB each, so keep them off the stack.
+    fbl::unique_ptr<zx_info_sched_latency_t[]> before;
+    fbl::unique_ptr<zx_info_sched_latency_t[]> after(new zx_info_sched_latency_t[kMaxCpus]);
+    size_t num_cpus = 0;
+    if (duration > 0) {
+        before.reset(new zx_info_sched_latency_t[kMaxCpus]);
+        status = snapshot(root_resource, before.get(), &num_cpus);
+        if (status == ZX_OK) {
+            zx::nanosleep(zx::deadline_after(zx::sec(duration)));
+        }
+    }
+    if (status == ZX_OK) {
+        status = snapshot(root_resource, after.get(), &num_cpus);
+    }
+    if (status != ZX_OK) {
+        fprintf(stderr, "schedlat: cannot read latencies: %s\n", zx_status_get_string(status));
+        return 1;
+    }
+
+    fbl::unique_ptr<CpuLatency> total(new CpuLatency());
+    fbl::unique_ptr<CpuLatency> cpu(new CpuLatency());
+    print_header();
+    for (size_t i = 0; i < num_cpus; i++) {
+        const zx_info_sched_latency_t& now = after[i];
+        const zx_info_sched_latency_t* prev = before ? &before[i] : nullptr;
+        if (!(now.flags & ZX_INFO_CPU_STATS_FLAG_ONLINE)) {
+            continue;
+        }
+
+        memset(cpu.get(), 0, sizeof(*cpu));
+        accumulate(&cpu->wakeup, now.wakeup, prev ? prev->wakeup : nullptr);
+        accumulate(&cpu->run_queue, now.run_queue, prev ? prev->run_queue : nullptr);
+        accumulate(&cpu->preempted_slice, now.preempted_slice,
+                   prev ? prev->preempted_slice : nullptr);
+
+        accumulate(&total->wakeup, cpu->wakeup.counts, nullptr);
+        accumulate(&total->run_queue, cpu->run_queue.counts, nullptr);
+        accumulate(&total->preempted_slice, cpu->preempted_slice.counts, nullptr);
+
+        if (per_cpu) {
+            char name[8];
+            snprintf(name, sizeof(name), "%u", now.cpu_number);
+            print_cpu(name, *cpu);
+        }
+    }
+    print_cpu("all", *total);
+    return 0;
+}
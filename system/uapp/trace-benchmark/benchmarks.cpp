@@ -6,7 +6,9 @@
 
 #include <inttypes.h>
 #include <stdio.h>
+#include <threads.h>
 
+#include <fbl/atomic.h>
 #include <fbl/function.h>
 #include <lib/async/cpp/task.h>
 #include <trace-engine/buffer_internal.h>
@@ -34,7 +36,8 @@ public:
             // is a stress test so all the app is doing is filling the trace
             // buffer. :-)
             async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
-            BenchmarkHandler handler(&loop, spec_->mode, spec_->buffer_size);
+            BenchmarkHandler handler(&loop, spec_->mode, spec_->buffer_size,
+                                     spec_->thread_chunk_size);
 
             loop.StartThread("trace-engine loop", nullptr);
 
@@ -181,13 +184,99 @@ void RunBenchmarks(bool tracing_enabled, const BenchmarkSpec* spec) {
     }
 }
 
+// The thread counts the multi-thread benchmarks are run with.
+constexpr unsigned kMaxThreads = 8;
+constexpr unsigned kThreadCounts[] = {1, 2, 4, kMaxThreads};
+
+struct WriterThreads {
+    unsigned iterations;
+    // Set once every thread has been created, to start them together.
+    fbl::atomic<bool> go{false};
+};
+
+int WriterThread(void* arg) {
+    auto writers = static_cast<WriterThreads*>(arg);
+    while (!writers->go.load(fbl::memory_order_acquire)) {
+    }
+    for (unsigned i = 0; i < writers->iterations; ++i) {
+        TRACE_DURATION_BEGIN("+enabled", "name", "k1", 1);
+    }
+    return 0;
+}
+
+// Returns the time, in microseconds, for |num_threads| threads to each
+// write |iterations| records.
+float MeasureWriterThreads(unsigned num_threads, unsigned iterations) {
+    WriterThreads writers;
+    writers.iterations = iterations;
+
+    ZX_DEBUG_ASSERT(num_threads <= kMaxThreads);
+    thrd_t threads[kMaxThreads];
+    for (unsigned i = 0; i < num_threads; ++i) {
+        int result = thrd_create_with_name(&threads[i], WriterThread, &writers, "writer");
+        ZX_DEBUG_ASSERT(result == thrd_success);
+    }
+
+    zx_ticks_t start = zx_ticks_get();
+    writers.go.store(true, fbl::memory_order_release);
+    for (unsigned i = 0; i < num_threads; ++i) {
+        int result = thrd_join(threads[i], nullptr);
+        ZX_DEBUG_ASSERT(result == thrd_success);
+    }
+    zx_ticks_t stop = zx_ticks_get();
+    return (static_cast<float>(stop - start) * 1000000.f /
+            static_cast<float>(zx_ticks_per_second()));
+}
+
 } // namespace
 
+void RunMultiThreadBenchmarks(const BenchmarkSpec* spec) {
+    async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
+    BenchmarkHandler handler(&loop, spec->mode, spec->buffer_size,
+                             spec->thread_chunk_size);
+    loop.StartThread("trace-engine loop", nullptr);
+
+    for (unsigned num_threads : kThreadCounts) {
+        // Keep the total number of records the same for each thread count
+        // so that the buffer does not fill in oneshot mode.
+        unsigned iterations = spec->num_iterations / num_threads;
+        printf("\n* %s: %u threads, TRACE_DURATION_BEGIN macro with 1 int32 argument ...\n",
+               spec->name, num_threads);
+
+        float min = 0, max = 0;
+        float cumulative = 0;
+        for (unsigned i = 0; i < kNumTestRuns; ++i) {
+            handler.Start();
+            float rt = MeasureWriterThreads(num_threads, iterations);
+            handler.Stop();
+            zx::nanosleep(zx::deadline_after(zx::msec(10)));
+            if (min == 0 || min > rt)
+                min = rt;
+            if (max == 0 || max < rt)
+                max = rt;
+            cumulative += rt;
+        }
+
+        printf("  - run: %u test runs, %u iterations per thread per run\n",
+               kNumTestRuns, iterations);
+        printf("  - total (usec): min: %.3f, max: %.3f, ave: %.3f\n",
+               min, max, cumulative / kNumTestRuns);
+        // With no contention the cost each thread sees per event stays
+        // flat as threads are added.
+        printf("  - per-event per-thread (usec): min: %.3f\n",
+               min / static_cast<float>(iterations));
+    }
+
+    loop.Quit();
+    loop.JoinThreads();
+}
+
 void RunTracingDisabledBenchmarks() {
     static const BenchmarkSpec spec = {
         "disabled",
         TRACE_BUFFERING_MODE_ONESHOT, // unused
         0,
+        0,
         kDefaultRunIterations,
     };
     RunBenchmarks(false, &spec);
@@ -12,6 +12,9 @@ struct BenchmarkSpec {
     const char* name;
     trace_buffering_mode_t mode;
     size_t buffer_size;
+    // The size of per-thread record chunks, or zero to allocate every
+    // record from the shared buffer. See trace_engine_set_thread_chunk_size().
+    size_t thread_chunk_size;
     // The number of iterations is a parameter to make it easier to
     // experiment and debug.
     unsigned num_iterations;
@@ -23,5 +26,9 @@ void RunTracingDisabledBenchmarks();
 // Runs benchmarks which need tracing enabled.
 void RunTracingEnabledBenchmarks(const BenchmarkSpec* spec);
 
+// Runs benchmarks which write records from several threads at once, to
+// measure how the per-event cost scales with the number of threads.
+void RunMultiThreadBenchmarks(const BenchmarkSpec* spec);
+
 // Runs benchmarks with NTRACE macro defined.
 void RunNoTraceBenchmarks();
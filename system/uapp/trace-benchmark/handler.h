@@ -19,9 +19,10 @@ public:
     static constexpr int kWaitStoppedTimeoutSeconds = 10;
 
     BenchmarkHandler(async::Loop* loop, trace_buffering_mode_t mode,
-                     size_t buffer_size)
+                     size_t buffer_size, size_t thread_chunk_size)
         : loop_(loop),
           mode_(mode),
+          thread_chunk_size_(thread_chunk_size),
           buffer_(new uint8_t[buffer_size], buffer_size) {
         auto status = zx::event::create(0u, &observer_event_);
         ZX_DEBUG_ASSERT_MSG(status == ZX_OK,
@@ -43,7 +44,11 @@ public:
     trace_buffering_mode_t mode() const { return mode_; }
 
     void Start() {
-        zx_status_t status = trace_start_engine(loop_->dispatcher(),
+        zx_status_t status = trace_engine_set_thread_chunk_size(thread_chunk_size_);
+        ZX_DEBUG_ASSERT_MSG(status == ZX_OK,
+                            "trace_engine_set_thread_chunk_size returned %s\n",
+                            zx_status_get_string(status));
+        status = trace_start_engine(loop_->dispatcher(),
                                                 this, mode_,
                                                 buffer_.get(), buffer_.size());
         ZX_DEBUG_ASSERT_MSG(status == ZX_OK,
@@ -131,6 +136,7 @@ private:
 
     async::Loop* const loop_;
     const trace_buffering_mode_t mode_;
+    const size_t thread_chunk_size_;
     fbl::Array<uint8_t> const buffer_;
     zx::event observer_event_;
 };
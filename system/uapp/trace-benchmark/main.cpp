@@ -17,6 +17,8 @@ static constexpr size_t kLargeBufferSizeBytes = 16 * 1024 * 1024;
 // The number is chosen to make it easier to eyeball timing differences
 // between large and small.
 static constexpr size_t kSmallBufferSizeBytes = 16 * 1024;
+// The per-thread chunk size for the benchmarks that use them.
+static constexpr size_t kThreadChunkSizeBytes = 4096;
 
 } // namespace
 
@@ -30,30 +32,35 @@ int main(int argc, char** argv) {
             "oneshot, 16MB buffer",
             TRACE_BUFFERING_MODE_ONESHOT,
             kLargeBufferSizeBytes,
+            0,
             kDefaultRunIterations,
         },
         {
             "streaming, 16MB buffer",
             TRACE_BUFFERING_MODE_STREAMING,
             kLargeBufferSizeBytes,
+            0,
             kDefaultRunIterations,
         },
         {
             "circular, 16MB buffer",
             TRACE_BUFFERING_MODE_CIRCULAR,
             kLargeBufferSizeBytes,
+            0,
             kDefaultRunIterations,
         },
         {
             "streaming, 16K buffer",
             TRACE_BUFFERING_MODE_STREAMING,
             kSmallBufferSizeBytes,
+            0,
             kDefaultRunIterations,
         },
         {
             "circular, 16K buffer",
             TRACE_BUFFERING_MODE_CIRCULAR,
             kSmallBufferSizeBytes,
+            0,
             kDefaultRunIterations,
         },
     };
@@ -62,6 +69,43 @@ int main(int argc, char** argv) {
         RunTracingEnabledBenchmarks(&spec);
     }
 
+    // Compare allocating every record from the shared buffer with
+    // allocating from per-thread chunks as writer threads are added.
+    static const BenchmarkSpec multi_thread_specs[] = {
+        {
+            "oneshot, 16MB buffer",
+            TRACE_BUFFERING_MODE_ONESHOT,
+            kLargeBufferSizeBytes,
+            0,
+            kDefaultRunIterations,
+        },
+        {
+            "oneshot, 16MB buffer, 4K thread chunks",
+            TRACE_BUFFERING_MODE_ONESHOT,
+            kLargeBufferSizeBytes,
+            kThreadChunkSizeBytes,
+            kDefaultRunIterations,
+        },
+        {
+            "circular, 16MB buffer",
+            TRACE_BUFFERING_MODE_CIRCULAR,
+            kLargeBufferSizeBytes,
+            0,
+            kDefaultRunIterations,
+        },
+        {
+            "circular, 16MB buffer, 4K thread chunks",
+            TRACE_BUFFERING_MODE_CIRCULAR,
+            kLargeBufferSizeBytes,
+            kThreadChunkSizeBytes,
+            kDefaultRunIterations,
+        },
+    };
+
+    for (const auto& spec : multi_thread_specs) {
+        RunMultiThreadBenchmarks(&spec);
+    }
+
     printf("\nTracing benchmarks completed.\n");
     return 0;
 }
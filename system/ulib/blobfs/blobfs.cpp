@@ -38,6 +38,9 @@ using digest::MerkleTree;
 namespace blobfs {
 namespace {
 
+static_assert(kWriteSegmentSize % MerkleTree::kNodeSize == 0,
+              "Write segments must hold whole Merkle tree nodes");
+
 zx_status_t CheckFvmConsistency(const Superblock* info, int block_fd) {
     if ((info->flags & kBlobFlagFVM) == 0) {
         return ZX_OK;
@@ -151,23 +154,19 @@ Inode* Blobfs::GetNode(size_t index) const {
     return &reinterpret_cast<Inode*>(node_map_.start())[index];
 }
 
-zx_status_t VnodeBlob::Verify() const {
-    TRACE_DURATION("blobfs", "Blobfs::Verify");
+zx_status_t VnodeBlob::Verify(uint64_t off, uint64_t len) const {
+    TRACE_DURATION("blobfs", "Blobfs::Verify", "off", off, "len", len);
     fs::Ticker ticker(blobfs_->CollectingMetrics());
 
     const void* data = inode_.blob_size ? GetData() : nullptr;
     const void* tree = inode_.blob_size ? GetMerkle() : nullptr;
     const uint64_t data_size = inode_.blob_size;
     const uint64_t merkle_size = MerkleTree::GetTreeLength(data_size);
-    // TODO(smklein): We could lazily verify more of the VMO if
-    // we could fault in pages on-demand.
-    //
-    // For now, we aggressively verify the entire VMO up front.
     Digest digest;
     digest = reinterpret_cast<const uint8_t*>(&digest_[0]);
     zx_status_t status = MerkleTree::Verify(data, data_size, tree,
-                                            merkle_size, 0, data_size, digest);
-    blobfs_->UpdateMerkleVerifyMetrics(data_size, merkle_size, ticker.End());
+                                            merkle_size, off, len, digest);
+    blobfs_->UpdateMerkleVerifyMetrics(len, merkle_size, ticker.End());
 
     if (status != ZX_OK) {
         char name[Digest::kLength * 2 + 1];
@@ -178,6 +177,44 @@ zx_status_t VnodeBlob::Verify() const {
     return status;
 }
 
+zx_status_t VnodeBlob::InitExtents() {
+    if (!extents_.is_empty() || inode_.num_blocks == 0) {
+        return ZX_OK;
+    }
+    zx_status_t status = LoadExtents(inode_, blobfs_->info_.inode_count,
+                                     [this](uint32_t node_index) {
+                                         return blobfs_->GetNode(node_index);
+                                     },
+                                     &extents_, &container_nodes_);
+    if (status != ZX_OK) {
+        extents_.reset();
+        container_nodes_.reset();
+    }
+    return status;
+}
+
+template <typename RunFunc>
+zx_status_t VnodeBlob::ForEachRun(uint64_t block, uint64_t nblocks, RunFunc func) const {
+    const uint64_t data_start = DataStartBlock(blobfs_->info_);
+    uint64_t extent_block = 0;
+    for (size_t i = 0; i < extents_.size() && nblocks > 0; i++) {
+        const Extent& extent = extents_[i];
+        if (block < extent_block + extent.Length()) {
+            uint64_t offset = block - extent_block;
+            uint64_t length = fbl::min(nblocks, extent.Length() - offset);
+            zx_status_t status = func(block, data_start + extent.Start() + offset, length);
+            if (status != ZX_OK) {
+                return status;
+            }
+            block += length;
+            nblocks -= length;
+        }
+        extent_block += extent.Length();
+    }
+    ZX_DEBUG_ASSERT(nblocks == 0);
+    return ZX_OK;
+}
+
 zx_status_t VnodeBlob::InitVmos() {
     TRACE_DURATION("blobfs", "Blobfs::InitVmos");
 
@@ -194,6 +231,11 @@ zx_status_t VnodeBlob::InitVmos() {
         return ZX_OK;
     }
 
+    zx_status_t status;
+    if ((status = InitExtents()) != ZX_OK) {
+        return status;
+    }
+
     // Reverts blob back to uninitialized state on error.
     auto cleanup = fbl::MakeAutoCall([this]() { BlobCloseHandles(); });
 
@@ -203,7 +245,7 @@ zx_status_t VnodeBlob::InitVmos() {
         return ZX_ERR_OUT_OF_RANGE;
     }
 
-    zx_status_t status = mapping_.CreateAndMap(vmo_size, "blob");
+    status = mapping_.CreateAndMap(vmo_size, "blob");
     if (status != ZX_OK) {
         FS_TRACE_ERROR("Failed to initialize vmo; error: %d\n", status);
         return status;
@@ -212,17 +254,25 @@ zx_status_t VnodeBlob::InitVmos() {
         FS_TRACE_ERROR("Failed to attach VMO to block device; error: %d\n", status);
         return status;
     }
+    if ((status = verified_.Reset(data_blocks)) != ZX_OK) {
+        return status;
+    }
 
     if ((inode_.flags & kBlobFlagLZ4Compressed) != 0) {
+        // Compressed blobs can only be decompressed from the start, so they
+        // are read and verified in full.
         if ((status = InitCompressed()) != ZX_OK) {
             return status;
         }
-    } else {
-        if ((status = InitUncompressed()) != ZX_OK) {
+        if ((status = Verify(0, inode_.blob_size)) != ZX_OK) {
             return status;
         }
-    }
-    if ((status = Verify()) != ZX_OK) {
+        verified_.Set(0, data_blocks);
+    } else if ((inode_.flags & kBlobFlagChunkCompressed) != 0) {
+        if ((status = InitChunked()) != ZX_OK) {
+            return status;
+        }
+    } else if ((status = InitUncompressed()) != ZX_OK) {
         return status;
     }
 
@@ -230,12 +280,71 @@ zx_status_t VnodeBlob::InitVmos() {
     return ZX_OK;
 }
 
+zx_status_t VnodeBlob::LoadRange(uint64_t off, uint64_t len) {
+    if (len == 0) {
+        return ZX_OK;
+    }
+
+    // The nodes of the Merkle tree's bottom level are blocks of the blob.
+    static_assert(kBlobfsBlockSize == MerkleTree::kNodeSize,
+                  "Merkle nodes must be blocks of the blob");
+    const uint64_t end_block = fbl::round_up(off + len, kBlobfsBlockSize) / kBlobfsBlockSize;
+    size_t block = off / kBlobfsBlockSize;
+    while (!verified_.Get(block, end_block, &block)) {
+        // Read and verify the run of blocks up to the next verified one in
+        // a single request.
+        size_t run_end;
+        if (verified_.Find(true, block, end_block, 1, &run_end) != ZX_OK) {
+            run_end = end_block;
+        }
+        zx_status_t status;
+        if (seek_table_ != nullptr) {
+            // Chunks are decompressed and verified as a whole, so a run
+            // that is not verified is made up of whole chunks.
+            const uint64_t chunk_blocks = seek_table_->chunk_size() / kBlobfsBlockSize;
+            block = fbl::round_down(block, chunk_blocks);
+            run_end = fbl::min(fbl::round_up(run_end, chunk_blocks), BlobDataBlocks(inode_));
+            TRACE_DURATION("blobfs", "Blobfs::LoadRange", "block", block, "blocks",
+                           run_end - block);
+            if ((status = ReadChunks(seek_table_->ChunkAt(block * kBlobfsBlockSize),
+                                     seek_table_->ChunkAt((run_end - 1) * kBlobfsBlockSize) + 1))
+                != ZX_OK) {
+                return status;
+            }
+        } else {
+            TRACE_DURATION("blobfs", "Blobfs::LoadRange", "block", block, "blocks",
+                           run_end - block);
+            fs::Ticker ticker(blobfs_->CollectingMetrics());
+            fs::ReadTxn txn(blobfs_);
+            ForEachRun(MerkleTreeBlocks(inode_) + block, run_end - block,
+                       [this, &txn](uint64_t blob_block, uint64_t dev_block, uint64_t n) {
+                           txn.Enqueue(vmoid_, blob_block, dev_block, n);
+                           return ZX_OK;
+                       });
+            status = txn.Transact();
+            blobfs_->UpdateMerkleDiskReadMetrics((run_end - block) * kBlobfsBlockSize,
+                                                 ticker.End());
+            if (status != ZX_OK) {
+                return status;
+            }
+        }
+
+        uint64_t run_off = block * kBlobfsBlockSize;
+        uint64_t run_len = fbl::min(run_end * kBlobfsBlockSize, inode_.blob_size) - run_off;
+        if ((status = Verify(run_off, run_len)) != ZX_OK) {
+            return status;
+        }
+        verified_.Set(block, run_end);
+        block = run_end;
+    }
+    return ZX_OK;
+}
+
 zx_status_t VnodeBlob::InitCompressed() {
     TRACE_DURATION("blobfs", "Blobfs::InitCompressed", "size", inode_.blob_size,
                    "blocks", inode_.num_blocks);
     fs::Ticker ticker(blobfs_->CollectingMetrics());
     fs::ReadTxn txn(blobfs_);
-    uint64_t start = inode_.start_block + DataStartBlock(blobfs_->info_);
     uint64_t merkle_blocks = MerkleTreeBlocks(inode_);
 
     fzl::OwnedVmoMapper compressed_mapper;
@@ -261,10 +370,21 @@ zx_status_t VnodeBlob::InitCompressed() {
         blobfs_->DetachVmo(compressed_vmoid);
     });
 
-    // Read the uncompressed merkle tree.
-    txn.Enqueue(vmoid_, 0, start, merkle_blocks);
-    // Read the compressed data.
-    txn.Enqueue(compressed_vmoid, 0, start + merkle_blocks, compressed_blocks);
+    // Read the uncompressed merkle tree, followed by the compressed data.
+    ForEachRun(0, inode_.num_blocks,
+               [&](uint64_t blob_block, uint64_t dev_block, uint64_t n) {
+                   if (blob_block < merkle_blocks) {
+                       uint64_t merkle_run = fbl::min(n, merkle_blocks - blob_block);
+                       txn.Enqueue(vmoid_, blob_block, dev_block, merkle_run);
+                       blob_block += merkle_run;
+                       dev_block += merkle_run;
+                       n -= merkle_run;
+                   }
+                   if (n > 0) {
+                       txn.Enqueue(compressed_vmoid, blob_block - merkle_blocks, dev_block, n);
+                   }
+                   return ZX_OK;
+               });
 
     if ((status = txn.Transact()) != ZX_OK) {
         FS_TRACE_ERROR("Failed to flush read transaction: %d\n", status);
@@ -295,18 +415,147 @@ zx_status_t VnodeBlob::InitCompressed() {
 zx_status_t VnodeBlob::InitUncompressed() {
     TRACE_DURATION("blobfs", "Blobfs::InitUncompressed", "size", inode_.blob_size,
                    "blocks", inode_.num_blocks);
+    uint64_t length = MerkleTreeBlocks(inode_);
+    if (length == 0) {
+        return ZX_OK;
+    }
+
+    // Read the uncompressed merkle tree.  The data is read by LoadRange.
     fs::Ticker ticker(blobfs_->CollectingMetrics());
     fs::ReadTxn txn(blobfs_);
-    uint64_t start = inode_.start_block + DataStartBlock(blobfs_->info_);
-
-    // Read both the uncompressed merkle tree and data.
-    uint64_t length = BlobDataBlocks(inode_) + MerkleTreeBlocks(inode_);
-    txn.Enqueue(vmoid_, 0, start, length);
+    ForEachRun(0, length, [this, &txn](uint64_t blob_block, uint64_t dev_block, uint64_t n) {
+        txn.Enqueue(vmoid_, blob_block, dev_block, n);
+        return ZX_OK;
+    });
     zx_status_t status = txn.Transact();
     blobfs_->UpdateMerkleDiskReadMetrics(length * kBlobfsBlockSize, ticker.End());
     return status;
 }
 
+zx_status_t VnodeBlob::InitChunked() {
+    TRACE_DURATION("blobfs", "Blobfs::InitChunked", "size", inode_.blob_size,
+                   "blocks", inode_.num_blocks);
+    uint64_t merkle_blocks = MerkleTreeBlocks(inode_);
+    uint64_t compressed_blocks = inode_.num_blocks - merkle_blocks;
+    uint64_t table_blocks = fbl::min(fbl::round_up(SeekTable::SizeMax(inode_.blob_size),
+                                                   kBlobfsBlockSize) / kBlobfsBlockSize,
+                                     compressed_blocks);
+
+    fs::Ticker ticker(blobfs_->CollectingMetrics());
+    fzl::OwnedVmoMapper table_mapper;
+    zx_status_t status = table_mapper.CreateAndMap(table_blocks * kBlobfsBlockSize,
+                                                   "blob-seek-table");
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("Failed to initialize seek table vmo; error: %d\n", status);
+        return status;
+    }
+    vmoid_t table_vmoid;
+    if ((status = blobfs_->AttachVmo(table_mapper.vmo().get(), &table_vmoid)) != ZX_OK) {
+        FS_TRACE_ERROR("Failed to attach seek table VMO to blkdev: %d\n", status);
+        return status;
+    }
+    auto detach = fbl::MakeAutoCall([this, &table_vmoid]() {
+        blobfs_->DetachVmo(table_vmoid);
+    });
+
+    // Read the uncompressed merkle tree, and the seek table at the start of
+    // the compressed data.  The chunks are read by LoadRange.
+    fs::ReadTxn txn(blobfs_);
+    ForEachRun(0, merkle_blocks, [this, &txn](uint64_t blob_block, uint64_t dev_block,
+                                              uint64_t n) {
+        txn.Enqueue(vmoid_, blob_block, dev_block, n);
+        return ZX_OK;
+    });
+    ForEachRun(merkle_blocks, table_blocks,
+               [&txn, &table_vmoid, merkle_blocks](uint64_t blob_block, uint64_t dev_block,
+                                                   uint64_t n) {
+                   txn.Enqueue(table_vmoid, blob_block - merkle_blocks, dev_block, n);
+                   return ZX_OK;
+               });
+    status = txn.Transact();
+    blobfs_->UpdateMerkleDiskReadMetrics((merkle_blocks + table_blocks) * kBlobfsBlockSize,
+                                         ticker.End());
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<SeekTable> table(new (&ac) SeekTable());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if ((status = table->Init(table_mapper.start(), table_blocks * kBlobfsBlockSize,
+                              inode_.blob_size, compressed_blocks * kBlobfsBlockSize)) != ZX_OK) {
+        FS_TRACE_ERROR("Invalid seek table: %d\n", status);
+        return status;
+    }
+    seek_table_ = fbl::move(table);
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::ReadChunks(uint32_t first, uint32_t end) {
+    TRACE_DURATION("blobfs", "Blobfs::ReadChunks", "chunk", first, "chunks", end - first);
+    ZX_DEBUG_ASSERT(first < end && end <= seek_table_->num_chunks());
+    fs::Ticker ticker(blobfs_->CollectingMetrics());
+
+    // Read the blocks holding the compressed chunks in a single request.
+    const uint64_t first_block = seek_table_->CompressedStart(first) / kBlobfsBlockSize;
+    const uint64_t end_block = fbl::round_up(seek_table_->CompressedEnd(end - 1),
+                                             kBlobfsBlockSize) / kBlobfsBlockSize;
+    const uint64_t blocks = end_block - first_block;
+    fzl::OwnedVmoMapper compressed_mapper;
+    zx_status_t status = compressed_mapper.CreateAndMap(blocks * kBlobfsBlockSize,
+                                                        "compressed-chunks");
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("Failed to initialize compressed vmo; error: %d\n", status);
+        return status;
+    }
+    vmoid_t compressed_vmoid;
+    status = blobfs_->AttachVmo(compressed_mapper.vmo().get(), &compressed_vmoid);
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("Failed to attach compressed VMO to blkdev: %d\n", status);
+        return status;
+    }
+    auto detach = fbl::MakeAutoCall([this, &compressed_vmoid]() {
+        blobfs_->DetachVmo(compressed_vmoid);
+    });
+
+    fs::ReadTxn txn(blobfs_);
+    const uint64_t start = MerkleTreeBlocks(inode_) + first_block;
+    ForEachRun(start, blocks,
+               [&txn, &compressed_vmoid, start](uint64_t blob_block, uint64_t dev_block,
+                                                uint64_t n) {
+                   txn.Enqueue(compressed_vmoid, blob_block - start, dev_block, n);
+                   return ZX_OK;
+               });
+    if ((status = txn.Transact()) != ZX_OK) {
+        FS_TRACE_ERROR("Failed to flush read transaction: %d\n", status);
+        return status;
+    }
+
+    fs::Duration read_time = ticker.End();
+    ticker.Reset();
+
+    const uint8_t* compressed = static_cast<const uint8_t*>(compressed_mapper.start());
+    uint8_t* data = static_cast<uint8_t*>(GetData());
+    uint64_t size_uncompressed = 0;
+    for (uint32_t chunk = first; chunk < end; chunk++) {
+        uint64_t src_off = seek_table_->CompressedStart(chunk) - first_block * kBlobfsBlockSize;
+        status = Decompressor::DecompressChunk(
+            *seek_table_, chunk, data + static_cast<uint64_t>(chunk) * seek_table_->chunk_size(),
+            compressed + src_off);
+        if (status != ZX_OK) {
+            FS_TRACE_ERROR("Failed to decompress chunk %u: %d\n", chunk, status);
+            return status;
+        }
+        size_uncompressed += seek_table_->ChunkLength(chunk);
+    }
+
+    blobfs_->UpdateMerkleDecompressMetrics(blocks * kBlobfsBlockSize, size_uncompressed,
+                                           read_time, ticker.End());
+    return ZX_OK;
+}
+
 void VnodeBlob::PopulateInode(size_t node_index) {
     ZX_DEBUG_ASSERT(map_index_ == 0);
     ZX_DEBUG_ASSERT(inode_.start_block < kStartBlockMinimum);
@@ -336,6 +585,7 @@ VnodeBlob::VnodeBlob(Blobfs* bs)
 
 void VnodeBlob::BlobCloseHandles() {
     mapping_.Reset();
+    seek_table_.reset();
     readable_event_.reset();
 }
 
@@ -363,7 +613,7 @@ zx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
         // Toss a valid block to the null blob, to distinguish it from
         // unallocated nodes.
         inode_.start_block = kStartBlockMinimum;
-        if ((status = Verify()) != ZX_OK) {
+        if ((status = Verify(0, 0)) != ZX_OK) {
             return status;
         }
         SetState(kBlobStateDataWrite);
@@ -382,13 +632,35 @@ zx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
     if ((status = blobfs_->AttachVmo(mapping_.vmo().get(), &vmoid_)) != ZX_OK) {
         goto fail;
     }
+    if ((status = verified_.Reset(BlobDataBlocks(inode_))) != ZX_OK) {
+        goto fail;
+    }
 
-    // Reserve space for the blob.
-    if ((status = blobfs_->ReserveBlocks(inode_.num_blocks, &inode_.start_block)) != ZX_OK) {
+    // Reserve space for the blob, and a node for each extent container
+    // needed to list its extents.
+    if ((status = blobfs_->ReserveBlocks(inode_.num_blocks, &extents_)) != ZX_OK) {
         goto fail;
     }
+    inode_.start_block = extents_[0].Start();
+    for (uint64_t i = 0; i < ExtentContainerCount(extents_); i++) {
+        size_t node_index;
+        if ((status = blobfs_->ReserveNode(&node_index)) != ZX_OK) {
+            goto fail;
+        }
+        fbl::AllocChecker ac;
+        container_nodes_.push_back(static_cast<uint32_t>(node_index), &ac);
+        if (!ac.check()) {
+            blobfs_->FreeNode(nullptr, node_index);
+            status = ZX_ERR_NO_MEMORY;
+            goto fail;
+        }
+    }
 
     write_info_ = fbl::make_unique<WritebackInfo>();
+    if ((status = TaskGroup::Create(blobfs_->GetWorkerPool(),
+                                    &write_info_->segments)) != ZX_OK) {
+        goto fail;
+    }
     if (inode_.blob_size >= kCompressionMinBytesSaved) {
         size_t max = write_info_->compressor.BufferMax(inode_.blob_size);
         status = write_info_->compressed_blob.CreateAndMap(max, "compressed-blob");
@@ -396,7 +668,8 @@ zx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
             return status;
         }
         status = write_info_->compressor.Initialize(write_info_->compressed_blob.start(),
-                                                    write_info_->compressed_blob.size());
+                                                    write_info_->compressed_blob.size(),
+                                                    inode_.blob_size);
         if (status != ZX_OK) {
             fprintf(stderr, "blobfs: Failed to initialize compressor: %d\n", status);
             return status;
@@ -409,10 +682,48 @@ zx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
 
 fail:
     BlobCloseHandles();
+    ReleaseExtents();
     blobfs_->FreeNode(nullptr, map_index_);
     return status;
 }
 
+void VnodeBlob::TrimExtents(uint64_t num_blocks) {
+    ZX_DEBUG_ASSERT(num_blocks <= inode_.num_blocks);
+    uint64_t blocks = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < extents_.size(); i++) {
+        const Extent extent = extents_[i];
+        uint64_t keep = fbl::min(extent.Length(), num_blocks - blocks);
+        if (keep < extent.Length()) {
+            blobfs_->UnreserveBlocks(extent.Length() - keep, extent.Start() + keep);
+        }
+        if (keep > 0) {
+            extents_[i] = Extent(extent.Start(), keep);
+            count = i + 1;
+        }
+        blocks += keep;
+    }
+    while (extents_.size() > count) {
+        extents_.pop_back();
+    }
+    while (container_nodes_.size() > ExtentContainerCount(extents_)) {
+        blobfs_->FreeNode(nullptr, container_nodes_[container_nodes_.size() - 1]);
+        container_nodes_.pop_back();
+    }
+    inode_.num_blocks = num_blocks;
+}
+
+void VnodeBlob::ReleaseExtents() {
+    for (size_t i = 0; i < container_nodes_.size(); i++) {
+        blobfs_->FreeNode(nullptr, container_nodes_[i]);
+    }
+    for (size_t i = 0; i < extents_.size(); i++) {
+        blobfs_->UnreserveBlocks(extents_[i].Length(), extents_[i].Start());
+    }
+    container_nodes_.reset();
+    extents_.reset();
+}
+
 void* VnodeBlob::GetData() const {
     return fs::GetBlock(kBlobfsBlockSize, mapping_.start(), MerkleTreeBlocks(inode_));
 }
@@ -434,7 +745,9 @@ zx_status_t VnodeBlob::WriteMetadata() {
     // Update the on-disk hash.
     memcpy(inode_.merkle_root_hash, &digest_[0], Digest::kLength);
 
-    // All data has been written to the containing VMO.
+    // All data has been written to the containing VMO, and checked against
+    // the digest.
+    verified_.Set(0, BlobDataBlocks(inode_));
     SetState(kBlobStateReadable);
     if (readable_event_.is_valid()) {
         status = readable_event_.signal(0u, ZX_USER_SIGNAL_0);
@@ -447,11 +760,23 @@ zx_status_t VnodeBlob::WriteMetadata() {
     atomic_store(&syncing_, true);
 
     // Allocate and persist previously reserved blocks/node.
-    if (inode_.blob_size) {
-        blobfs_->PersistBlocks(wb.get(), inode_.num_blocks, inode_.start_block);
+    for (size_t i = 0; i < extents_.size(); i++) {
+        blobfs_->PersistBlocks(wb.get(), extents_[i].Length(), extents_[i].Start());
     }
 
+    if (!container_nodes_.is_empty()) {
+        inode_.flags |= kBlobFlagMultiExtent;
+        inode_.next_node = container_nodes_[0];
+    }
     blobfs_->PersistNode(wb.get(), map_index_, inode_);
+    for (size_t i = 0; i < container_nodes_.size(); i++) {
+        ExtentContainer container;
+        uint32_t next_node = i + 1 < container_nodes_.size() ? container_nodes_[i + 1] : 0;
+        InitExtentContainer(extents_, i, next_node, &container);
+        Inode node;
+        memcpy(&node, &container, sizeof(node));
+        blobfs_->PersistNode(wb.get(), container_nodes_[i], node);
+    }
     wb->SetSyncComplete();
     if ((status = blobfs_->EnqueueWork(fbl::move(wb), EnqueueType::kJournal)) != ZX_OK) {
         return status;
@@ -482,21 +807,16 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
 
         *actual = to_write;
         write_info_->bytes_written += to_write;
-
-        if (write_info_->compressor.Compressing()) {
-            if ((status = write_info_->compressor.Update(data, to_write)) != ZX_OK) {
-                return status;
-            }
-            ConsiderCompressionAbort();
-        }
+        SubmitSegments();
 
         // More data to write.
         if (write_info_->bytes_written < inode_.blob_size) {
-            return ZX_OK;
+            return EnqueueCompleteBlocks();
         }
 
-        // Only write data to disk once we've buffered the file into memory.
-        // This gives us a chance to try compressing the blob before we write it back.
+        // Only write the rest of the data to disk once we've buffered the
+        // file into memory.  This gives us a chance to try compressing the
+        // blob before we write it back.
         fbl::unique_ptr<WritebackWork> wb;
         if ((status = blobfs_->CreateWork(&wb, this)) != ZX_OK) {
             return status;
@@ -512,59 +832,76 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
             SetState(kBlobStateError);
         });
 
+        // Tracking generation time.
+        fs::Ticker generation_ticker(blobfs_->CollectingMetrics());
+        if ((status = write_info_->segments->Wait()) != ZX_OK) {
+            return status;
+        }
+
         if (write_info_->compressor.Compressing()) {
-            if ((status = write_info_->compressor.End()) != ZX_OK) {
-                return status;
-            }
             ConsiderCompressionAbort();
         }
 
-        uint64_t dev_offset = DataStartBlock(blobfs_->info_) + inode_.start_block + merkle_blocks;
         if (write_info_->compressor.Compressing()) {
+            if ((status = write_info_->compressor.End()) != ZX_OK) {
+                return status;
+            }
             uint64_t blocks = fbl::round_up(write_info_->compressor.Size(),
                                             kBlobfsBlockSize) / kBlobfsBlockSize;
-            if ((status = EnqueuePaginated(&wb, blobfs_, this,
-                                           write_info_->compressed_blob.vmo().get(),
-                                           0, dev_offset, blocks)) != ZX_OK) {
+            zx_handle_t vmo = write_info_->compressed_blob.vmo().get();
+            status = ForEachRun(merkle_blocks, blocks,
+                                [&](uint64_t blob_block, uint64_t dev_block, uint64_t n) {
+                                    return EnqueuePaginated(&wb, blobfs_, this, vmo,
+                                                            blob_block - merkle_blocks,
+                                                            dev_block, n);
+                                });
+            if (status != ZX_OK) {
                 return status;
             }
-            blocks += MerkleTreeBlocks(inode_);
+            blocks += merkle_blocks;
             ZX_DEBUG_ASSERT(inode_.num_blocks > blocks);
-            blobfs_->UnreserveBlocks(inode_.num_blocks - blocks,
-                                     inode_.start_block + blocks);
-            inode_.num_blocks = blocks;
-            inode_.flags |= kBlobFlagLZ4Compressed;
+            TrimExtents(blocks);
+            inode_.flags |= kBlobFlagChunkCompressed;
         } else {
+            // Some of the data may have been enqueued already.
             uint64_t blocks = fbl::round_up(inode_.blob_size, kBlobfsBlockSize) / kBlobfsBlockSize;
-            if ((status = EnqueuePaginated(&wb, blobfs_, this, mapping_.vmo().get(),
-                                           merkle_blocks, dev_offset, blocks)) != ZX_OK) {
+            uint64_t enqueued = write_info_->blocks_enqueued;
+            zx_handle_t vmo = mapping_.vmo().get();
+            status = ForEachRun(merkle_blocks + enqueued, blocks - enqueued,
+                                [&](uint64_t blob_block, uint64_t dev_block, uint64_t n) {
+                                    return EnqueuePaginated(&wb, blobfs_, this, vmo,
+                                                            blob_block, dev_block, n);
+                                });
+            if (status != ZX_OK) {
                 return status;
             }
         }
 
-        // TODO(smklein): As an optimization, use the CreateInit/Update/Final
-        // methods to create the merkle tree as we write data, rather than
-        // waiting until the data is fully downloaded to create the tree.
+        // The bottom level of the Merkle tree was hashed along with the
+        // segments; only the levels above it remain.
         size_t merkle_size = MerkleTree::GetTreeLength(inode_.blob_size);
         fs::Duration generation_time;
         if (merkle_size > 0) {
             Digest digest;
             void* merkle_data = GetMerkle();
             const void* blob_data = GetData();
-            fs::Ticker ticker(blobfs_->CollectingMetrics()); // Tracking generation time.
 
-            if ((status = MerkleTree::Create(blob_data, inode_.blob_size, merkle_data,
-                                             merkle_size, &digest)) != ZX_OK) {
+            if ((status = MerkleTree::CreateRoot(blob_data, inode_.blob_size, merkle_data,
+                                                 merkle_size, &digest)) != ZX_OK) {
                 return status;
             } else if (digest != digest_) {
                 // Downloaded blob did not match provided digest.
                 return ZX_ERR_IO_DATA_INTEGRITY;
             }
 
-            uint64_t dev_offset = DataStartBlock(blobfs_->info_) + inode_.start_block;
-            wb->Enqueue(mapping_.vmo().get(), 0, dev_offset, merkle_blocks);
-            generation_time = ticker.End();
-        } else if ((status = Verify()) != ZX_OK) {
+            zx_handle_t vmo = mapping_.vmo().get();
+            ForEachRun(0, merkle_blocks, [&](uint64_t blob_block, uint64_t dev_block,
+                                             uint64_t n) {
+                wb->Enqueue(vmo, blob_block, dev_block, n);
+                return ZX_OK;
+            });
+            generation_time = generation_ticker.End();
+        } else if ((status = Verify(0, inode_.blob_size)) != ZX_OK) {
             // Small blobs may not have associated Merkle Trees, and will
             // require validation, since we are not regenerating and checking
             // the digest.
@@ -591,9 +928,79 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
     return ZX_ERR_BAD_STATE;
 }
 
+void VnodeBlob::SubmitSegments() {
+    uint64_t end = write_info_->bytes_written;
+    if (end < inode_.blob_size) {
+        end = fbl::round_down(end, kWriteSegmentSize);
+    }
+    while (write_info_->bytes_submitted < end) {
+        uint64_t offset = write_info_->bytes_submitted;
+        uint64_t length = fbl::min(end - offset, kWriteSegmentSize);
+        write_info_->segments->Submit([this, offset, length]() {
+            return ProcessSegment(offset, length);
+        });
+        write_info_->bytes_submitted += length;
+    }
+}
+
+zx_status_t VnodeBlob::ProcessSegment(uint64_t offset, uint64_t length) {
+    TRACE_DURATION("blobfs", "Blobfs::ProcessSegment", "offset", offset, "length", length);
+    const void* blob_data = GetData();
+    zx_status_t status = MerkleTree::CreateLeaves(blob_data, inode_.blob_size, offset, length,
+                                                  GetMerkle(),
+                                                  MerkleTree::GetTreeLength(inode_.blob_size));
+    if (status != ZX_OK) {
+        return status;
+    }
+    // Once the compressed blob has grown too large, it is going to be
+    // dropped, so the rest of the blob need not be compressed.
+    if (CompressionWorthwhile()) {
+        return write_info_->compressor.CompressChunks(blob_data, offset, length);
+    }
+    return ZX_OK;
+}
+
+bool VnodeBlob::CompressionWorthwhile() const {
+    return write_info_->compressor.Compressing() &&
+           write_info_->compressor.Size() <= inode_.blob_size - kCompressionMinBytesSaved;
+}
+
+zx_status_t VnodeBlob::EnqueueCompleteBlocks() {
+    if (CompressionWorthwhile()) {
+        // The layout of the blob on disk is not known yet.
+        return ZX_OK;
+    }
+    uint64_t blocks = write_info_->bytes_written / kBlobfsBlockSize;
+    uint64_t enqueued = write_info_->blocks_enqueued;
+    if (blocks - enqueued < kWriteSegmentSize / kBlobfsBlockSize) {
+        return ZX_OK;
+    }
+
+    fbl::unique_ptr<WritebackWork> wb;
+    zx_status_t status;
+    if ((status = blobfs_->CreateWork(&wb, this)) != ZX_OK) {
+        return status;
+    }
+    zx_handle_t vmo = mapping_.vmo().get();
+    status = ForEachRun(MerkleTreeBlocks(inode_) + enqueued, blocks - enqueued,
+                        [&](uint64_t blob_block, uint64_t dev_block, uint64_t n) {
+                            return EnqueuePaginated(&wb, blobfs_, this, vmo,
+                                                    blob_block, dev_block, n);
+                        });
+    if (status != ZX_OK) {
+        wb->Reset(ZX_ERR_BAD_STATE);
+        return status;
+    }
+    if ((status = blobfs_->EnqueueWork(fbl::move(wb), EnqueueType::kData)) != ZX_OK) {
+        return status;
+    }
+    write_info_->blocks_enqueued = blocks;
+    return ZX_OK;
+}
+
 void VnodeBlob::ConsiderCompressionAbort() {
     ZX_DEBUG_ASSERT(write_info_->compressor.Compressing());
-    if (inode_.blob_size - kCompressionMinBytesSaved < write_info_->compressor.Size()) {
+    if (!CompressionWorthwhile()) {
         write_info_->compressor.Reset();
         write_info_->compressed_blob.Reset();
     }
@@ -626,13 +1033,16 @@ zx_status_t VnodeBlob::CloneVmo(zx_rights_t rights, zx_handle_t* out) {
     if (inode_.blob_size == 0) {
         return ZX_ERR_BAD_STATE;
     }
+    // Without a pager to fault pages in, clients must be handed a VMO that
+    // already holds the whole blob.
     zx_status_t status = InitVmos();
     if (status != ZX_OK) {
         return status;
     }
+    if ((status = LoadRange(0, inode_.blob_size)) != ZX_OK) {
+        return status;
+    }
 
-    // TODO(smklein): Only clone / verify the part of the vmo that
-    // was requested.
     const size_t merkle_bytes = MerkleTreeBlocks(inode_) * kBlobfsBlockSize;
     zx::vmo clone;
     if ((status = mapping_.vmo().clone(ZX_VMO_CLONE_COPY_ON_WRITE, merkle_bytes, inode_.blob_size,
@@ -702,6 +1112,9 @@ zx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
     if (len > (inode_.blob_size - off)) {
         len = inode_.blob_size - off;
     }
+    if ((status = LoadRange(off, len)) != ZX_OK) {
+        return status;
+    }
 
     const size_t merkle_bytes = MerkleTreeBlocks(inode_) * kBlobfsBlockSize;
     status = mapping_.vmo().read(data, merkle_bytes + off, len);
@@ -734,8 +1147,11 @@ zx_status_t VnodeBlob::VerifyBlob(Blobfs* bs, size_t node_index) {
     vn->SetState(kBlobStatePurged);
 
     // If we are unable to read in the blob from disk, this should also be a VerifyBlob error.
-    // Since InitVmos calls Verify as its final step, we can just return its result here.
-    return vn->InitVmos();
+    zx_status_t status = vn->InitVmos();
+    if (status != ZX_OK) {
+        return status;
+    }
+    return vn->LoadRange(0, vn->inode_.blob_size);
 }
 
 zx_status_t Blobfs::VerifyBlob(size_t node_index) {
@@ -775,22 +1191,75 @@ zx_status_t Blobfs::FindBlocks(size_t start, size_t num_blocks, size_t* blkno_ou
     return ZX_OK;
 }
 
-zx_status_t Blobfs::ReserveBlocks(size_t num_blocks, size_t* block_index_out) {
+zx_status_t Blobfs::FindFragmentedBlocks(size_t num_blocks, fbl::Vector<Extent>* out) {
+    size_t found = 0;
+    size_t start = 0;
+    while (found < num_blocks) {
+        // Find the next block which is neither allocated nor reserved.
+        size_t block_num;
+        if (block_map_.Find(false, start, block_map_.size(), 1, &block_num) != ZX_OK) {
+            out->reset();
+            return ZX_ERR_NO_SPACE;
+        }
+        size_t run_end;
+        if (reserved_blocks_.Get(block_num, block_num + 1)) {
+            reserved_blocks_.Get(block_num, block_map_.size(), &run_end);
+            start = run_end;
+            continue;
+        }
+
+        // Take the run of free blocks starting there, up to the next
+        // allocated or reserved block.
+        run_end = block_map_.size();
+        block_map_.Scan(block_num, block_map_.size(), false, &run_end);
+        size_t reserved;
+        if (reserved_blocks_.Find(true, block_num, run_end, 1, &reserved) == ZX_OK) {
+            run_end = reserved;
+        }
+        size_t length = fbl::min(run_end - block_num, num_blocks - found);
+        zx_status_t status = AppendExtents(block_num, length, out);
+        if (status != ZX_OK) {
+            out->reset();
+            return status;
+        }
+        found += length;
+        start = run_end;
+    }
+    return ZX_OK;
+}
+
+zx_status_t Blobfs::ReserveBlocks(size_t num_blocks, fbl::Vector<Extent>* out) {
+    TRACE_DURATION("blobfs", "Blobfs::ReserveBlocks", "num_blocks", num_blocks);
     zx_status_t status;
-    if ((status = FindBlocks(0, num_blocks, block_index_out) != ZX_OK)) {
+    size_t block_index;
+    if ((status = FindBlocks(0, num_blocks, &block_index) != ZX_OK)) {
         // If we have run out of blocks, attempt to add block slices via FVM.
         // The new 'hint' is the first location we could try to find blocks
         // after merely extending the allocation maps.
         size_t hint = block_map_.size() - fbl::min(num_blocks, block_map_.size());
 
         if ((status = AddBlocks(num_blocks) != ZX_OK) ||
-            (status = FindBlocks(hint, num_blocks, block_index_out)) != ZX_OK) {
-            LogAllocationFailure(num_blocks);
-            return ZX_ERR_NO_SPACE;
+            (status = FindBlocks(hint, num_blocks, &block_index)) != ZX_OK) {
+            // There is no run long enough for the whole blob, but the volume
+            // may still have enough free blocks in shorter runs.
+            if ((status = FindFragmentedBlocks(num_blocks, out)) != ZX_OK) {
+                LogAllocationFailure(num_blocks);
+                return status == ZX_ERR_NO_MEMORY ? status : ZX_ERR_NO_SPACE;
+            }
+            for (size_t i = 0; i < out->size(); i++) {
+                const Extent& extent = (*out)[i];
+                status = reserved_blocks_.Set(extent.Start(), extent.Start() + extent.Length());
+                ZX_DEBUG_ASSERT(status == ZX_OK);
+            }
+            return ZX_OK;
         }
     }
 
-    status = reserved_blocks_.Set(*block_index_out, *block_index_out + num_blocks);
+    if ((status = AppendExtents(block_index, num_blocks, out)) != ZX_OK) {
+        out->reset();
+        return status;
+    }
+    status = reserved_blocks_.Set(block_index, block_index + num_blocks);
     ZX_DEBUG_ASSERT(status == ZX_OK);
     return ZX_OK;
 }
@@ -970,6 +1439,11 @@ zx_status_t Blobfs::InitializeWriteback(const MountOptions& options) {
         return status;
     }
 
+    uint32_t workers = fbl::min(options.write_workers, zx_system_get_num_cpus());
+    if ((status = WorkerPool::Create(workers, &worker_pool_)) != ZX_OK) {
+        return status;
+    }
+
     // Replay any lingering journal entries.
     if ((status = journal_->Replay()) != ZX_OK) {
         return status;
@@ -1106,16 +1580,24 @@ zx_status_t Blobfs::PurgeBlob(VnodeBlob* vn) {
     case kBlobStateDataWrite:
     case kBlobStateError: {
         size_t node_index = vn->GetMapIndex();
-        uint64_t start_block = vn->GetNode().start_block;
-        uint64_t nblocks = vn->GetNode().num_blocks;
         zx_status_t status;
+        if ((status = vn->InitExtents()) != ZX_OK) {
+            return status;
+        }
         fbl::unique_ptr<WritebackWork> wb;
         if ((status = CreateWork(&wb, vn)) != ZX_OK) {
             return status;
         }
 
         FreeNode(wb.get(), node_index);
-        FreeBlocks(wb.get(), nblocks, start_block);
+        const fbl::Vector<uint32_t>& container_nodes = vn->GetContainerNodes();
+        for (size_t i = 0; i < container_nodes.size(); i++) {
+            FreeNode(wb.get(), container_nodes[i]);
+        }
+        const fbl::Vector<Extent>& extents = vn->GetExtents();
+        for (size_t i = 0; i < extents.size(); i++) {
+            FreeBlocks(wb.get(), extents[i].Length(), extents[i].Start());
+        }
         VnodeReleaseHard(vn);
         return EnqueueWork(fbl::move(wb), EnqueueType::kJournal);
     }
@@ -1163,7 +1645,8 @@ zx_status_t Blobfs::Readdir(fs::vdircookie_t* cookie, void* dirents, size_t len,
     dircookie_t* c = reinterpret_cast<dircookie_t*>(cookie);
 
     for (size_t i = c->index; i < info_.inode_count; ++i) {
-        if (GetNode(i)->start_block >= kStartBlockMinimum) {
+        if (GetNode(i)->start_block >= kStartBlockMinimum &&
+            (GetNode(i)->flags & kBlobFlagExtentContainer) == 0) {
             Digest digest(GetNode(i)->merkle_root_hash);
             char name[Digest::kLength * 2 + 1];
             zx_status_t r = digest.ToString(name, sizeof(name));
@@ -1434,6 +1917,23 @@ void Blobfs::UpdateMerkleDecompressMetrics(uint64_t size_compressed,
     }
 }
 
+void Blobfs::UpdateCacheMetrics(bool hit) {
+    if (CollectingMetrics()) {
+        if (hit) {
+            metrics_.cache_hits++;
+        } else {
+            metrics_.cache_misses++;
+        }
+    }
+}
+
+void Blobfs::UpdateEvictionMetrics(uint64_t size) {
+    if (CollectingMetrics()) {
+        metrics_.cache_evictions++;
+        metrics_.cache_bytes_evicted += size;
+    }
+}
+
 void Blobfs::UpdateMerkleVerifyMetrics(uint64_t size_data, uint64_t size_merkle,
                                        const fs::Duration& duration) {
     if (CollectingMetrics()) {
@@ -1456,6 +1956,7 @@ Blobfs::~Blobfs() {
     writeback_.reset();
 
     ZX_ASSERT(open_hash_.is_empty());
+    closed_lru_.clear();
     closed_hash_.clear();
 
     if (blockfd_) {
@@ -1476,6 +1977,7 @@ zx_status_t Blobfs::Create(fbl::unique_fd fd, const MountOptions& options,
     auto fs = fbl::unique_ptr<Blobfs>(new Blobfs(fbl::move(fd), info));
     fs->SetReadonly(options.readonly);
     fs->SetCachePolicy(options.cache_policy);
+    fs->SetCacheSize(options.cache_size);
     if (options.metrics) {
         fs->CollectMetrics();
     }
@@ -1546,10 +2048,13 @@ zx_status_t Blobfs::Create(fbl::unique_fd fd, const MountOptions& options,
 
 zx_status_t Blobfs::InitializeVnodes() {
     fbl::AutoLock lock(&hash_lock_);
+    closed_lru_.clear();
+    closed_lru_bytes_ = 0;
     closed_hash_.clear();
     for (size_t i = 0; i < info_.inode_count; ++i) {
         const Inode* inode = GetNode(i);
-        if (inode->start_block >= kStartBlockMinimum) {
+        if (inode->start_block >= kStartBlockMinimum &&
+            (inode->flags & kBlobFlagExtentContainer) == 0) {
             fbl::AllocChecker ac;
             Digest digest(inode->merkle_root_hash);
             fbl::RefPtr<VnodeBlob> vn = fbl::AdoptRef(new (&ac) VnodeBlob(this, digest));
@@ -1670,6 +2175,13 @@ zx_status_t Blobfs::VnodeInsertClosedLocked(fbl::RefPtr<VnodeBlob> vn) {
         break;
     case CachePolicy::NeverEvict:
         break;
+    case CachePolicy::EvictLeastRecentlyUsed:
+        if (vn->CachedBytes() > 0) {
+            closed_lru_bytes_ += vn->CachedBytes();
+            closed_lru_.push_front(vn.get());
+            EvictClosedLocked(cache_size_);
+        }
+        break;
     default:
         ZX_ASSERT_MSG(false, "Unexpected cache policy");
     }
@@ -1684,12 +2196,33 @@ fbl::RefPtr<VnodeBlob> Blobfs::VnodeUpgradeLocked(const uint8_t* key) {
     if (raw_vn == nullptr) {
         return nullptr;
     }
+    if (raw_vn->InLru()) {
+        closed_lru_.erase(*raw_vn);
+        closed_lru_bytes_ -= raw_vn->CachedBytes();
+    }
+    UpdateCacheMetrics(raw_vn->CachedBytes() > 0);
     open_hash_.insert(raw_vn);
     // To have existed in the closed_hash_, this RefPtr must have
     // been leaked.
     return fbl::internal::MakeRefPtrNoAdopt(raw_vn);
 }
 
+void Blobfs::EvictClosedLocked(uint64_t size) {
+    while (closed_lru_bytes_ > size) {
+        VnodeBlob* vn = closed_lru_.pop_back();
+        uint64_t bytes = vn->CachedBytes();
+        closed_lru_bytes_ -= bytes;
+        vn->TearDown();
+        UpdateEvictionMetrics(bytes);
+    }
+}
+
+void Blobfs::ShrinkCache() {
+    TRACE_DURATION("blobfs", "Blobfs::ShrinkCache");
+    fbl::AutoLock lock(&hash_lock_);
+    EvictClosedLocked(0);
+}
+
 zx_status_t Blobfs::OpenRootNode(fbl::RefPtr<VnodeBlob>* out) {
     fbl::AllocChecker ac;
     fbl::RefPtr<VnodeBlob> vn =
@@ -38,6 +38,104 @@ uint64_t MerkleTreeBlocks(const Inode& blobNode) {
     return fbl::round_up(size_merkle, kBlobfsBlockSize) / kBlobfsBlockSize;
 }
 
+zx_status_t AppendExtents(uint64_t start, uint64_t length, fbl::Vector<Extent>* extents) {
+    while (length > 0) {
+        uint64_t n = fbl::min(length, Extent::kMaxLength);
+        fbl::AllocChecker ac;
+        extents->push_back(Extent(start, n), &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        start += n;
+        length -= n;
+    }
+    return ZX_OK;
+}
+
+bool ExtentsAreContiguous(const fbl::Vector<Extent>& extents) {
+    for (size_t i = 1; i < extents.size(); i++) {
+        if (extents[i - 1].Start() + extents[i - 1].Length() != extents[i].Start()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t ExtentContainerCount(const fbl::Vector<Extent>& extents) {
+    if (ExtentsAreContiguous(extents)) {
+        return 0;
+    }
+    return fbl::round_up(extents.size(), kContainerMaxExtents) / kContainerMaxExtents;
+}
+
+void InitExtentContainer(const fbl::Vector<Extent>& extents, uint64_t index, uint32_t next_node,
+                         ExtentContainer* container) {
+    const uint64_t first = index * kContainerMaxExtents;
+    assert(first < extents.size());
+    *container = {};
+    container->flags = kBlobFlagExtentContainer;
+    container->extent_count = fbl::min<uint64_t>(extents.size() - first, kContainerMaxExtents);
+    for (uint64_t i = 0; i < container->extent_count; i++) {
+        container->extents[i] = extents[first + i];
+    }
+    container->start_block = container->extents[0].Start();
+    if (first + container->extent_count < extents.size()) {
+        container->next_node = next_node;
+    }
+}
+
+zx_status_t LoadExtents(const Inode& inode, uint64_t node_count, const NodeGetter& get_node,
+                        fbl::Vector<Extent>* extents, fbl::Vector<uint32_t>* container_nodes) {
+    if ((inode.flags & kBlobFlagMultiExtent) == 0) {
+        if (inode.num_blocks == 0) {
+            return ZX_OK;
+        }
+        return AppendExtents(inode.start_block, inode.num_blocks, extents);
+    }
+
+    uint64_t blocks = 0;
+    uint32_t node_index = inode.next_node;
+    // A chain can't be longer than the node map, which also stops us from
+    // following a cycle forever.
+    for (uint64_t containers = 0; blocks < inode.num_blocks; containers++) {
+        if (node_index >= node_count || containers >= node_count) {
+            FS_TRACE_ERROR("blobfs: Invalid extent container %u\n", node_index);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        const ExtentContainer* container =
+            reinterpret_cast<const ExtentContainer*>(get_node(node_index));
+        if (container == nullptr) {
+            return ZX_ERR_IO;
+        }
+        if ((container->flags & kBlobFlagExtentContainer) == 0 ||
+            container->extent_count == 0 || container->extent_count > kContainerMaxExtents ||
+            container->start_block != container->extents[0].Start()) {
+            FS_TRACE_ERROR("blobfs: Node %u is not a valid extent container\n", node_index);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        fbl::AllocChecker ac;
+        container_nodes->push_back(node_index, &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        for (uint64_t i = 0; i < container->extent_count; i++) {
+            const Extent& extent = container->extents[i];
+            if (extent.Start() < kStartBlockMinimum || extent.Length() == 0 ||
+                extent.Length() > inode.num_blocks - blocks) {
+                FS_TRACE_ERROR("blobfs: Invalid extent in container %u\n", node_index);
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
+            extents->push_back(extent, &ac);
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
+            }
+            blocks += extent.Length();
+        }
+        node_index = container->next_node;
+    }
+    return ZX_OK;
+}
+
 // Sanity check the metadata for the blobfs, given a maximum number of
 // available blocks.
 zx_status_t CheckSuperblock(const Superblock* info, uint64_t max) {
@@ -18,22 +18,42 @@ namespace blobfs {
 
 void BlobfsChecker::TraverseInodeBitmap() {
     for (unsigned n = 0; n < blobfs_->info_.inode_count; n++) {
-        Inode* inode = blobfs_->GetNode(n);
-        if (inode->start_block >= kStartBlockMinimum) {
+        // Copy the inode, since looking up its extent containers may move
+        // the node map out from under it.
+        Inode inode = *blobfs_->GetNode(n);
+        if (inode.start_block >= kStartBlockMinimum) {
             alloc_inodes_++;
-            inode_blocks_ += static_cast<uint32_t>(inode->num_blocks);
-
-            size_t start_block = inode->start_block;
-            size_t end_block = inode->start_block + inode->num_blocks;
+            if (inode.flags & kBlobFlagExtentContainer) {
+                // Checked along with the blob which references it.
+                alloc_containers_++;
+                continue;
+            }
+            inode_blocks_ += static_cast<uint32_t>(inode.num_blocks);
             bool valid = true;
 
-            size_t first_unset = 0;
-            if (!blobfs_->block_map_.Get(start_block, end_block, &first_unset)) {
-                FS_TRACE_ERROR("check: ino %u using blocks [%zu, %zu). "
-                               "Not fully allocated in block bitmap; first unset @%zu\n",
-                               n, start_block, end_block, first_unset);
+            fbl::Vector<Extent> extents;
+            fbl::Vector<uint32_t> container_nodes;
+            if (LoadExtents(inode, blobfs_->info_.inode_count,
+                            [this](uint32_t index) -> const Inode* {
+                                return blobfs_->GetNode(index);
+                            },
+                            &extents, &container_nodes) != ZX_OK) {
+                FS_TRACE_ERROR("check: ino %u has invalid extents\n", n);
                 valid = false;
             }
+            referenced_containers_ += static_cast<uint32_t>(container_nodes.size());
+
+            for (size_t i = 0; i < extents.size(); i++) {
+                size_t start_block = extents[i].Start();
+                size_t end_block = start_block + extents[i].Length();
+                size_t first_unset = 0;
+                if (!blobfs_->block_map_.Get(start_block, end_block, &first_unset)) {
+                    FS_TRACE_ERROR("check: ino %u using blocks [%zu, %zu). "
+                                   "Not fully allocated in block bitmap; first unset @%zu\n",
+                                   n, start_block, end_block, first_unset);
+                    valid = false;
+                }
+            }
 
             if (blobfs_->VerifyBlob(n) != ZX_OK) {
                 FS_TRACE_ERROR("check: detected inode %u with bad state\n", n);
@@ -82,6 +102,12 @@ zx_status_t BlobfsChecker::CheckAllocatedCounts() const {
         status = ZX_ERR_BAD_STATE;
     }
 
+    if (alloc_containers_ != referenced_containers_) {
+        FS_TRACE_ERROR("check: %u extent containers allocated, but %u referenced by blobs\n",
+                       alloc_containers_, referenced_containers_);
+        status = ZX_ERR_BAD_STATE;
+    }
+
     if (error_blobs_) {
         status = ZX_ERR_BAD_STATE;
     }
@@ -90,7 +116,8 @@ zx_status_t BlobfsChecker::CheckAllocatedCounts() const {
 }
 
 BlobfsChecker::BlobfsChecker()
-    : blobfs_(nullptr), alloc_inodes_(0), alloc_blocks_(0), error_blobs_(0), inode_blocks_(0) {};
+    : blobfs_(nullptr), alloc_inodes_(0), alloc_blocks_(0), error_blobs_(0), inode_blocks_(0),
+      alloc_containers_(0), referenced_containers_(0) {};
 
 void BlobfsChecker::Init(fbl::unique_ptr<Blobfs> blob) {
     blobfs_ = fbl::move(blob);
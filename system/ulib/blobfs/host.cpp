@@ -62,6 +62,19 @@ zx_status_t writeblk_offset(int fd, uint64_t bno, off_t offset, const void* data
     return ZX_OK;
 }
 
+// Returns the data block holding block |n| of a blob stored in |extents|,
+// counting from the start of its Merkle tree.
+uint64_t BlobBlock(const fbl::Vector<Extent>& extents, uint64_t n) {
+    for (size_t i = 0; i < extents.size(); i++) {
+        if (n < extents[i].Length()) {
+            return extents[i].Start() + n;
+        }
+        n -= extents[i].Length();
+    }
+    ZX_ASSERT_MSG(false, "blobfs: block %" PRIu64 " is past the end of the blob\n", n);
+    return 0;
+}
+
 // From a buffer, create a merkle tree.
 //
 // Given a mapped blob at |blob_data| of length |length|, compute the
@@ -90,7 +103,8 @@ zx_status_t buffer_compress(const FileMapping& mapping, MerkleInfo* out_info) {
     }
 
     zx_status_t status;
-    if ((status = compressor.Initialize(out_info->compressed_data.get(), max)) != ZX_OK) {
+    if ((status = compressor.Initialize(out_info->compressed_data.get(), max,
+                                        mapping.length())) != ZX_OK) {
         fprintf(stderr, "Failed to initialize blobfs compressor: %d\n", status);
         return status;
     }
@@ -130,9 +144,23 @@ zx_status_t blobfs_add_mapped_blob_with_merkle(Blobfs* bs, const FileMapping& ma
     // blob to the filesystem itself.
     static std::mutex add_blob_mutex_;
     std::lock_guard<std::mutex> lock(add_blob_mutex_);
-    fbl::unique_ptr<InodeBlock> inode_block;
+
+    // Find the blocks first, since the number of extent containers the blob
+    // needs depends on how fragmented they are.
+    Inode blob_inode = {};
+    blob_inode.blob_size = mapping.length();
+    const uint64_t num_blocks = MerkleTreeBlocks(blob_inode) + info.GetDataBlocks();
+    fbl::Vector<Extent> extents;
     zx_status_t status;
-    if ((status = bs->NewBlob(info.digest, &inode_block)) < 0) {
+    if ((status = bs->FindBlocks(num_blocks, &extents)) != ZX_OK) {
+        fprintf(stderr, "error: No blocks available\n");
+        return status;
+    }
+
+    fbl::unique_ptr<InodeBlock> inode_block;
+    fbl::Vector<uint32_t> container_nodes;
+    if ((status = bs->NewBlob(info.digest, ExtentContainerCount(extents), &inode_block,
+                              &container_nodes)) < 0) {
         return status;
     }
     if (inode_block == nullptr) {
@@ -142,18 +170,28 @@ zx_status_t blobfs_add_mapped_blob_with_merkle(Blobfs* bs, const FileMapping& ma
 
     Inode* inode = inode_block->GetInode();
     inode->blob_size = mapping.length();
-    inode->num_blocks = MerkleTreeBlocks(*inode) + info.GetDataBlocks();
-    inode->flags |= (info.compressed ? kBlobFlagLZ4Compressed : 0);
+    inode->num_blocks = num_blocks;
+    inode->start_block = extents[0].Start();
+    inode->flags |= (info.compressed ? kBlobFlagChunkCompressed : 0);
+    if (!container_nodes.is_empty()) {
+        inode->flags |= kBlobFlagMultiExtent;
+        inode->next_node = container_nodes[0];
+    }
 
-    if ((status = bs->AllocateBlocks(inode->num_blocks,
-                                     reinterpret_cast<size_t*>(&inode->start_block))) != ZX_OK) {
+    if ((status = bs->AllocateBlocks(extents)) != ZX_OK) {
         fprintf(stderr, "error: No blocks available\n");
         return status;
-    } else if ((status = bs->WriteData(inode, info.merkle.get(), data)) != ZX_OK) {
+    } else if ((status = bs->WriteData(inode, extents, info.merkle.get(), data)) != ZX_OK) {
         return status;
-    } else if ((status = bs->WriteBitmap(inode->num_blocks, inode->start_block)) != ZX_OK) {
+    }
+    for (size_t i = 0; i < extents.size(); i++) {
+        if ((status = bs->WriteBitmap(extents[i].Length(), extents[i].Start())) != ZX_OK) {
+            return status;
+        }
+    }
+    if ((status = bs->WriteNode(fbl::move(inode_block))) != ZX_OK) {
         return status;
-    } else if ((status = bs->WriteNode(fbl::move(inode_block))) != ZX_OK) {
+    } else if ((status = bs->WriteExtentContainers(extents, container_nodes)) != ZX_OK) {
         return status;
     } else if ((status = bs->WriteInfo()) != ZX_OK) {
         return status;
@@ -378,7 +416,9 @@ zx_status_t Blobfs::LoadBitmap() {
     return ZX_OK;
 }
 
-zx_status_t Blobfs::NewBlob(const Digest& digest, fbl::unique_ptr<InodeBlock>* out) {
+zx_status_t Blobfs::NewBlob(const Digest& digest, uint64_t container_count,
+                            fbl::unique_ptr<InodeBlock>* out,
+                            fbl::Vector<uint32_t>* container_nodes) {
     size_t ino = info_.inode_count;
 
     for (size_t i = 0; i < info_.inode_count; ++i) {
@@ -392,7 +432,8 @@ zx_status_t Blobfs::NewBlob(const Digest& digest, fbl::unique_ptr<InodeBlock>* o
         auto iblk = reinterpret_cast<const Inode*>(cache_.blk);
         auto observed_inode = &iblk[i % kBlobfsInodesPerBlock];
         if (observed_inode->start_block >= kStartBlockMinimum) {
-            if (digest == observed_inode->merkle_root_hash) {
+            if ((observed_inode->flags & kBlobFlagExtentContainer) == 0 &&
+                digest == observed_inode->merkle_root_hash) {
                 return ZX_ERR_ALREADY_EXISTS;
             }
         } else if (ino >= info_.inode_count) {
@@ -400,10 +441,17 @@ zx_status_t Blobfs::NewBlob(const Digest& digest, fbl::unique_ptr<InodeBlock>* o
             // first free value we find.
             // We still check all the remaining inodes to avoid adding a duplicate blob.
             ino = i;
+        } else if (container_nodes->size() < container_count) {
+            // The following free nodes hold the blob's extent containers.
+            fbl::AllocChecker ac;
+            container_nodes->push_back(static_cast<uint32_t>(i), &ac);
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
+            }
         }
     }
 
-    if (ino >= info_.inode_count) {
+    if (ino >= info_.inode_count || container_nodes->size() < container_count) {
         return ZX_ERR_NO_RESOURCES;
     }
 
@@ -429,15 +477,43 @@ zx_status_t Blobfs::NewBlob(const Digest& digest, fbl::unique_ptr<InodeBlock>* o
     return ZX_OK;
 }
 
-zx_status_t Blobfs::AllocateBlocks(size_t nblocks, size_t* blkno_out) {
-    zx_status_t status;
-    if ((status = block_map_.Find(false, 0, block_map_.size(), nblocks, blkno_out)) != ZX_OK) {
-        return status;
-    } else if ((status = block_map_.Set(*blkno_out, *blkno_out + nblocks)) != ZX_OK) {
-        return status;
+zx_status_t Blobfs::FindBlocks(size_t nblocks, fbl::Vector<Extent>* out) {
+    size_t blkno;
+    if (block_map_.Find(false, 0, block_map_.size(), nblocks, &blkno) == ZX_OK) {
+        return AppendExtents(blkno, nblocks, out);
+    }
+
+    // No single run is long enough, so take the free runs in order.
+    size_t found = 0;
+    size_t start = 0;
+    while (found < nblocks) {
+        if (block_map_.Find(false, start, block_map_.size(), 1, &blkno) != ZX_OK) {
+            out->reset();
+            return ZX_ERR_NO_SPACE;
+        }
+        size_t run_end = block_map_.size();
+        block_map_.Scan(blkno, block_map_.size(), false, &run_end);
+        size_t length = fbl::min(run_end - blkno, nblocks - found);
+        zx_status_t status;
+        if ((status = AppendExtents(blkno, length, out)) != ZX_OK) {
+            out->reset();
+            return status;
+        }
+        found += length;
+        start = run_end;
     }
+    return ZX_OK;
+}
 
-    info_.alloc_block_count += nblocks;
+zx_status_t Blobfs::AllocateBlocks(const fbl::Vector<Extent>& extents) {
+    for (size_t i = 0; i < extents.size(); i++) {
+        zx_status_t status;
+        if ((status = block_map_.Set(extents[i].Start(),
+                                     extents[i].Start() + extents[i].Length())) != ZX_OK) {
+            return status;
+        }
+        info_.alloc_block_count += extents[i].Length();
+    }
     return ZX_OK;
 }
 
@@ -466,12 +542,33 @@ zx_status_t Blobfs::WriteNode(fbl::unique_ptr<InodeBlock> ino_block) {
     return WriteBlock(cache_.bno, cache_.blk);
 }
 
-zx_status_t Blobfs::WriteData(Inode* inode, const void* merkle_data, const void* blob_data) {
+zx_status_t Blobfs::WriteExtentContainers(const fbl::Vector<Extent>& extents,
+                                          const fbl::Vector<uint32_t>& container_nodes) {
+    for (size_t i = 0; i < container_nodes.size(); i++) {
+        Inode* node = GetNode(container_nodes[i]);
+        if (node == nullptr) {
+            return ZX_ERR_IO;
+        }
+        ExtentContainer container;
+        uint32_t next_node = i + 1 < container_nodes.size() ? container_nodes[i + 1] : 0;
+        InitExtentContainer(extents, i, next_node, &container);
+        memcpy(node, &container, sizeof(container));
+        zx_status_t status;
+        if ((status = WriteBlock(cache_.bno, cache_.blk)) != ZX_OK) {
+            return status;
+        }
+    }
+    info_.alloc_inode_count += container_nodes.size();
+    return ZX_OK;
+}
+
+zx_status_t Blobfs::WriteData(Inode* inode, const fbl::Vector<Extent>& extents,
+                              const void* merkle_data, const void* blob_data) {
     const size_t merkle_blocks = MerkleTreeBlocks(*inode);
     const size_t data_blocks = inode->num_blocks - merkle_blocks;
     for (size_t n = 0; n < merkle_blocks; n++) {
         const void* data = fs::GetBlock(kBlobfsBlockSize, merkle_data, n);
-        uint64_t bno = data_start_block_ + inode->start_block + n;
+        uint64_t bno = data_start_block_ + BlobBlock(extents, n);
         zx_status_t status;
         if ((status = WriteBlock(bno, data)) != ZX_OK) {
             return status;
@@ -492,7 +589,7 @@ zx_status_t Blobfs::WriteData(Inode* inode, const void* merkle_data, const void*
             data = last_data;
         }
 
-        uint64_t bno = data_start_block_ + inode->start_block + merkle_blocks + n;
+        uint64_t bno = data_start_block_ + BlobBlock(extents, merkle_blocks + n);
         zx_status_t status;
         if ((status = WriteBlock(bno, data)) != ZX_OK) {
             return status;
@@ -554,6 +651,14 @@ Inode* Blobfs::GetNode(size_t index) {
 
 zx_status_t Blobfs::VerifyBlob(size_t node_index) {
     Inode inode = *GetNode(node_index);
+    fbl::Vector<Extent> extents;
+    fbl::Vector<uint32_t> container_nodes;
+    zx_status_t status = LoadExtents(inode, info_.inode_count,
+                                     [this](uint32_t index) { return GetNode(index); },
+                                     &extents, &container_nodes);
+    if (status != ZX_OK) {
+        return status;
+    }
 
     // Determine size for (uncompressed) data buffer.
     uint64_t data_blocks = BlobDataBlocks(inode);
@@ -567,10 +672,10 @@ zx_status_t Blobfs::VerifyBlob(size_t node_index) {
 
     // Create data buffer.
     fbl::unique_ptr<uint8_t[]> data(new uint8_t[target_size]);
-    if (inode.flags & kBlobFlagLZ4Compressed) {
+    if (inode.flags & (kBlobFlagLZ4Compressed | kBlobFlagChunkCompressed)) {
         // Read in uncompressed merkle blocks.
         for (unsigned i = 0; i < merkle_blocks; i++) {
-            ReadBlock(data_start_block_ + inode.start_block + i);
+            ReadBlock(data_start_block_ + BlobBlock(extents, i));
             memcpy(data.get() + (i * kBlobfsBlockSize), cache_.blk, kBlobfsBlockSize);
         }
 
@@ -587,16 +692,31 @@ zx_status_t Blobfs::VerifyBlob(size_t node_index) {
 
         // Read in all compressed blob data.
         for (unsigned i = 0; i < compressed_blocks; i++) {
-            ReadBlock(data_start_block_ + inode.start_block + i + merkle_blocks);
+            ReadBlock(data_start_block_ + BlobBlock(extents, i + merkle_blocks));
             memcpy(compressed_data.get() + (i * kBlobfsBlockSize), cache_.blk, kBlobfsBlockSize);
         }
 
         // Decompress the compressed data into the target buffer.
-        zx_status_t status;
         target_size = inode.blob_size;
         uint8_t* data_ptr = data.get() + (merkle_blocks * kBlobfsBlockSize);
-        if ((status = Decompressor::Decompress(data_ptr, &target_size, compressed_data.get(),
-                                               &compressed_size)) != ZX_OK) {
+        if (inode.flags & kBlobFlagChunkCompressed) {
+            SeekTable table;
+            if ((status = table.Init(compressed_data.get(), compressed_size, inode.blob_size,
+                                     compressed_size)) != ZX_OK) {
+                fprintf(stderr, "Invalid seek table: %d\n", status);
+                return status;
+            }
+            for (uint32_t i = 0; i < table.num_chunks(); i++) {
+                if ((status = Decompressor::DecompressChunk(
+                         table, i, data_ptr + static_cast<uint64_t>(i) * table.chunk_size(),
+                         compressed_data.get() + table.CompressedStart(i))) != ZX_OK) {
+                    fprintf(stderr, "Failed to decompress chunk %u: %d\n", i, status);
+                    return status;
+                }
+            }
+        } else if ((status = Decompressor::Decompress(data_ptr, &target_size,
+                                                      compressed_data.get(),
+                                                      &compressed_size)) != ZX_OK) {
             return status;
         }
         if (target_size != inode.blob_size) {
@@ -607,7 +727,7 @@ zx_status_t Blobfs::VerifyBlob(size_t node_index) {
     } else {
         // For uncompressed blobs, read entire blob straight into the data buffer.
         for (unsigned i = 0; i < inode.num_blocks; i++) {
-            ReadBlock(data_start_block_ + inode.start_block + i);
+            ReadBlock(data_start_block_ + BlobBlock(extents, i));
             memcpy(data.get() + (i * kBlobfsBlockSize), cache_.blk, kBlobfsBlockSize);
         }
     }
@@ -25,6 +25,7 @@
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_fd.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <fs/block-txn.h>
 #include <fs/managed-vfs.h>
 #include <fs/ticker.h>
@@ -44,6 +45,7 @@
 #include <blobfs/lz4.h>
 #include <blobfs/metrics.h>
 #include <blobfs/journal.h>
+#include <blobfs/worker-pool.h>
 #include <blobfs/writeback.h>
 
 namespace blobfs {
@@ -92,6 +94,13 @@ public:
     struct TypeWavlTraits {
         static WAVLTreeNodeState& node_state(VnodeBlob& b) { return b.type_wavl_state_; }
     };
+    using LruNodeState = fbl::DoublyLinkedListNodeState<VnodeBlob*>;
+    struct TypeLruTraits {
+        static LruNodeState& node_state(VnodeBlob& b) { return b.type_lru_state_; }
+    };
+    bool InLru() const {
+        return type_lru_state_.InContainer();
+    }
     const uint8_t* GetKey() const {
         return &digest_[0];
     };
@@ -126,6 +135,24 @@ public:
         return inode_;
     }
 
+    // Returns the number of bytes of memory holding the blob's Merkle tree
+    // and data, or zero if the blob has no VMO.
+    uint64_t CachedBytes() const {
+        return mapping_.vmo() ? mapping_.size() : 0;
+    }
+
+    // Reads in the extents of the blob, and the nodes of its extent
+    // containers, from the node map, if we haven't already.
+    zx_status_t InitExtents();
+
+    const fbl::Vector<Extent>& GetExtents() const {
+        return extents_;
+    }
+
+    const fbl::Vector<uint32_t>& GetContainerNodes() const {
+        return container_nodes_;
+    }
+
     // Constructs the "directory" blob
     VnodeBlob(Blobfs* bs);
     // Constructs actual blobs
@@ -157,6 +184,7 @@ public:
 
 private:
     friend struct TypeWavlTraits;
+    friend struct TypeLruTraits;
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VnodeBlob);
 
@@ -199,11 +227,33 @@ private:
     // depending on the state.
     zx_status_t WriteInternal(const void* data, size_t len, size_t* actual);
 
+    // Submits the segments of a blob being written which are complete to
+    // the worker pool, to be hashed and compressed while the rest of the
+    // blob is written.  The last segment is submitted once the whole blob
+    // has been written.
+    void SubmitSegments();
+
+    // Runs on the worker pool.  Writes the digests of the segment at
+    // [offset, offset + length) into the Merkle tree, and compresses it if
+    // compression is still worthwhile.
+    zx_status_t ProcessSegment(uint64_t offset, uint64_t length);
+
+    // Returns true if a blob being written may still end up compressed:
+    // its compressor is running and has not grown beyond the point where
+    // compression would save space.
+    bool CompressionWorthwhile() const;
+
+    // For a blob which will be written uncompressed, enqueues the data
+    // blocks written so far to the writeback queue, so that they are flushed
+    // while the rest of the blob is written.
+    zx_status_t EnqueueCompleteBlocks();
+
     // For a blob being written, consider stopping the compressor,
     // the blob to eventually be written uncompressed to disk.
     //
     // For blobs which don't compress very well, this provides an escape
-    // hatch to avoid wasting work.
+    // hatch to avoid wasting work.  Must not be called while segments are
+    // being processed.
     void ConsiderCompressionAbort();
 
     // Reads from a blob.
@@ -232,26 +282,59 @@ private:
     zx_status_t GetVmo(int flags, zx_handle_t* out) final;
     void Sync(SyncCallback closure) final;
 
-    // Read both VMOs into memory, if we haven't already.
+    // Creates the blob's VMO and reads in its Merkle tree, if we haven't
+    // already.  The data of the blob is read on demand by LoadRange(),
+    // except for blobs compressed as a single LZ4 frame, which can only be
+    // decompressed from the start and so are read, decompressed and
+    // verified in full.
     //
-    // TODO(ZX-1481): When we have can register the Blob Store as a pager
-    // service, and it can properly handle pages faults on a vnode's contents,
-    // then we can avoid reading the entire blob up-front. Until then, read
-    // the contents of a VMO into memory when it is opened.
+    // TODO(ZX-1481): When we can register the Blob Store as a pager
+    // service, LoadRange() can be driven by page faults on the VMOs handed
+    // out by GetVmo(), which for now must hold the whole blob.
     zx_status_t InitVmos();
 
+    // Ensures that the blocks of data covering [off, off + len) are in the
+    // VMO and verified, reading in and verifying only the runs of blocks
+    // that are not.
+    // InitVmos() must have already been called for this blob.
+    zx_status_t LoadRange(uint64_t off, uint64_t len);
+
     // Initialize a compressed blob by reading it from disk and decompressing
     // it.
     // Does not verify the blob.
     zx_status_t InitCompressed();
 
-    // Initialize a decompressed blob by reading it from disk.
-    // Does not verify the blob.
+    // Initialize an uncompressed blob by reading its Merkle tree from disk.
     zx_status_t InitUncompressed();
 
-    // Verify the integrity of the in-memory Blob.
-    // InitVmos() must have already been called for this blob.
-    zx_status_t Verify() const;
+    // Initialize a chunk-compressed blob by reading its Merkle tree and
+    // seek table from disk.
+    zx_status_t InitChunked();
+
+    // Reads the compressed chunks [first, end) of a chunk-compressed blob
+    // from disk and decompresses them into the VMO.
+    // Does not verify the chunks.
+    zx_status_t ReadChunks(uint32_t first, uint32_t end);
+
+    // Verify the integrity of the bytes [off, off + len) of the in-memory
+    // Blob, which must already be in the VMO along with the Merkle tree.
+    zx_status_t Verify(uint64_t off, uint64_t len) const;
+
+    // Calls |func(blob_block, dev_block, nblocks)| for each run of the
+    // blocks [block, block + nblocks) of the blob which is contiguous on
+    // disk.  Blocks of the blob are counted from the start of its Merkle
+    // tree.  Stops at, and returns, the first error returned by |func|.
+    template <typename RunFunc>
+    zx_status_t ForEachRun(uint64_t block, uint64_t nblocks, RunFunc func) const;
+
+    // Shrinks a blob being written to its first |num_blocks| blocks,
+    // releasing the reservations on the rest of its blocks and on the
+    // extent containers it no longer needs.
+    void TrimExtents(uint64_t num_blocks);
+
+    // Releases the reservations on the blocks and extent containers of a
+    // blob which could not be allocated.
+    void ReleaseExtents();
 
     // Called by the Vnode once the last write has completed, updating the
     // on-disk metadata.
@@ -262,6 +345,7 @@ private:
     void* GetMerkle() const;
 
     WAVLTreeNodeState type_wavl_state_ = {};
+    LruNodeState type_lru_state_ = {};
 
     Blobfs* const blobfs_;
     BlobFlags flags_ = {};
@@ -272,6 +356,9 @@ private:
     // 2) The Blob itself, aligned to the nearest kBlobfsBlockSize
     fzl::OwnedVmoMapper mapping_;
     vmoid_t vmoid_ = {};
+    // One bit per block of data, set once the block is in |mapping_| and has
+    // been verified against the Merkle tree.
+    bitmap::RawBitmapGeneric<bitmap::DefaultStorage> verified_;
 
     // Watches any clones of "vmo_" provided to clients.
     // Observes the ZX_VMO_ZERO_CHILDREN signal.
@@ -289,12 +376,27 @@ private:
     uint32_t fd_count_ = {};
     size_t map_index_ = {};
     Inode inode_ = {};
+    // The runs of blocks holding the blob, in order, and the nodes of the
+    // extent containers listing them, if the blob needs any.
+    fbl::Vector<Extent> extents_;
+    fbl::Vector<uint32_t> container_nodes_;
+
+    // Locates the chunks of a chunk-compressed blob while its VMO is
+    // populated on demand.
+    fbl::unique_ptr<SeekTable> seek_table_;
 
     // Data used exclusively during writeback.
     struct WritebackInfo {
         uint64_t bytes_written = {};
-        Compressor compressor;
+        // Bytes of the blob submitted to |segments|.
+        uint64_t bytes_submitted = {};
+        // Data blocks of the blob already enqueued to the writeback queue.
+        uint64_t blocks_enqueued = {};
+        ChunkedCompressor compressor;
         fzl::OwnedVmoMapper compressed_blob;
+        // The segments being hashed and compressed.  Declared last, so that
+        // it waits for them before the rest of the struct is destroyed.
+        fbl::unique_ptr<TaskGroup> segments;
     };
 
     fbl::unique_ptr<WritebackInfo> write_info_ = {};
@@ -330,14 +432,34 @@ enum class CachePolicy {
     // This option costs a significant amount of memory, but it results in high
     // performance.
     NeverEvict,
+
+    // When all references to a blob are closed, the blob keeps its data in
+    // memory, but the data of the least recently closed blobs is evicted
+    // whenever the closed blobs hold more than the cache size, or when the
+    // system runs low on memory.  Evicted blobs keep their inode and extents,
+    // so they can be reopened without another lookup in the node map.
+    EvictLeastRecentlyUsed,
 };
 
+// Default number of bytes of closed blobs' data kept in memory by
+// CachePolicy::EvictLeastRecentlyUsed.
+constexpr uint64_t kDefaultCacheSize = 32 * (1 << 20);
+
+// Default number of threads used to hash and compress blobs being written.
+constexpr uint32_t kDefaultWriteWorkers = 4;
+
 // Toggles that may be set on blobfs during initialization.
 struct MountOptions {
     bool readonly = false;
     bool metrics = false;
     bool journal = false;
     CachePolicy cache_policy = CachePolicy::EvictImmediately;
+    // Only used by CachePolicy::EvictLeastRecentlyUsed.
+    uint64_t cache_size = kDefaultCacheSize;
+    // Number of threads hashing and compressing blobs as they are written,
+    // capped at the number of CPUs.  With none, blobs are hashed and
+    // compressed on the thread writing them.
+    uint32_t write_workers = kDefaultWriteWorkers;
 };
 
 class Blobfs : public fs::ManagedVfs, public fbl::RefCounted<Blobfs>,
@@ -380,6 +502,7 @@ public:
                               const Superblock* info, fbl::unique_ptr<Blobfs>* out);
 
     void SetCachePolicy(CachePolicy policy) { cache_policy_ = policy; }
+    void SetCacheSize(uint64_t size) { cache_size_ = size; }
     void CollectMetrics() { collecting_metrics_ = true; }
     bool CollectingMetrics() const { return collecting_metrics_; }
     void DisableMetrics() { collecting_metrics_ = false; }
@@ -400,6 +523,10 @@ public:
     // Returns the capacity of the writeback buffer in blocks.
     size_t WritebackCapacity() const;
 
+    // Returns the pool which hashes and compresses blobs being written, or
+    // null if blobfs is readonly.
+    WorkerPool* GetWorkerPool() const { return worker_pool_.get(); }
+
     virtual ~Blobfs();
 
     // Invokes "open" on the root directory.
@@ -485,6 +612,18 @@ public:
     void UpdateMerkleVerifyMetrics(uint64_t size_data, uint64_t size_merkle,
                                    const fs::Duration& duration);
 
+    // Updates aggregate information about closed blobs being reopened, with
+    // (|hit|) or without their data still in memory.
+    void UpdateCacheMetrics(bool hit);
+
+    // Updates aggregate information about closed blobs whose data has been
+    // evicted from memory.
+    void UpdateEvictionMetrics(uint64_t size);
+
+    // Drops the data of every closed blob, as if the cache size were zero.
+    // Called when the system is running low on memory.
+    void ShrinkCache() __TA_EXCLUDES(hash_lock_);
+
     zx_status_t CreateWork(fbl::unique_ptr<WritebackWork>* out, VnodeBlob* vnode);
 
     // Enqueues |work| to the appropriate buffer. If |journal| is true and the journal is enabled,
@@ -543,11 +682,20 @@ private:
     // Precondition: The Vnode must not exist in |open_hash_|.
     fbl::RefPtr<VnodeBlob> VnodeUpgradeLocked(const uint8_t* key) __TA_REQUIRES(hash_lock_);
 
+    // Tears down the least recently closed blobs in |closed_lru_| until their
+    // data takes up no more than |size| bytes.
+    void EvictClosedLocked(uint64_t size) __TA_REQUIRES(hash_lock_);
+
     // Searches for |nblocks| free blocks between the block_map_ and reserved_blocks_ bitmaps.
     zx_status_t FindBlocks(size_t start, size_t nblocks, size_t* blkno_out);
 
-    // Reserves space for a block in memory. Does not update disk.
-    zx_status_t ReserveBlocks(size_t nblocks, size_t* blkno_out);
+    // Searches for |nblocks| free blocks in as few runs as a first fit over the block map
+    // allows, for when no single run is long enough. Appends the runs to |out|.
+    zx_status_t FindFragmentedBlocks(size_t nblocks, fbl::Vector<Extent>* out);
+
+    // Reserves space for |nblocks| blocks in memory, preferably as a single run, and
+    // appends the extents holding them to |out|. Does not update disk.
+    zx_status_t ReserveBlocks(size_t nblocks, fbl::Vector<Extent>* out);
 
     // Log information about blobfs' allocation when we run out of space.
     void LogAllocationFailure(size_t num_blocks) const;
@@ -609,11 +757,17 @@ private:
                                            VnodeBlob::TypeWavlTraits>;
     fbl::unique_ptr<WritebackQueue> writeback_;
     fbl::unique_ptr<Journal> journal_;
+    fbl::unique_ptr<WorkerPool> worker_pool_;
     Superblock info_;
 
     fbl::Mutex hash_lock_;
     WAVLTreeByMerkle open_hash_ __TA_GUARDED(hash_lock_){};   // All 'in use' blobs.
     WAVLTreeByMerkle closed_hash_ __TA_GUARDED(hash_lock_){}; // All 'closed' blobs.
+    // The closed blobs which still hold their data, most recently closed first,
+    // and the number of bytes of data they hold.
+    fbl::DoublyLinkedList<VnodeBlob*, VnodeBlob::TypeLruTraits> closed_lru_
+        __TA_GUARDED(hash_lock_);
+    uint64_t closed_lru_bytes_ __TA_GUARDED(hash_lock_) = 0;
 
     fbl::unique_fd blockfd_;
     block_info_t block_info_ = {};
@@ -643,6 +797,7 @@ private:
     BlobfsMetrics metrics_ = {};
 
     CachePolicy cache_policy_;
+    uint64_t cache_size_ = kDefaultCacheSize;
     fbl::Closure on_unmount_ = {};
 };
 
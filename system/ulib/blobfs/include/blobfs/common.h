@@ -10,7 +10,9 @@
 #include <bitmap/raw-bitmap.h>
 #include <bitmap/storage.h>
 #include <fbl/algorithm.h>
+#include <fbl/function.h>
 #include <fbl/macros.h>
+#include <fbl/vector.h>
 #include <fs/block-txn.h>
 #include <zircon/types.h>
 
@@ -28,6 +30,11 @@ namespace blobfs {
 constexpr uint64_t kCompressionMinBlocksSaved = 8;
 constexpr uint64_t kCompressionMinBytesSaved = kCompressionMinBlocksSaved * kBlobfsBlockSize;
 
+// Blobs being written are hashed and compressed a segment at a time, on a
+// pool of worker threads.  A segment holds a whole number of Merkle tree
+// nodes and of compression chunks.
+constexpr uint64_t kWriteSegmentSize = 8 * kBlobfsChunkSize;
+
 #ifdef __Fuchsia__
 using RawBitmap = bitmap::RawBitmapGeneric<bitmap::VmoStorage>;
 #else
@@ -45,6 +52,34 @@ int Mkfs(int fd, uint64_t block_count);
 
 uint64_t MerkleTreeBlocks(const Inode& blobNode);
 
+// Returns the node at |node_index| of the node map.  The node need only stay
+// valid until the next call.
+using NodeGetter = fbl::Function<const Inode*(uint32_t node_index)>;
+
+// Collects the extents holding the |inode.num_blocks| blocks of a blob, in
+// order, into |extents|, and the nodes of its extent containers (if any)
+// into |container_nodes|.  A run of blocks longer than Extent::kMaxLength is
+// split into several extents.  |node_count| is the number of nodes in the
+// node map.
+zx_status_t LoadExtents(const Inode& inode, uint64_t node_count, const NodeGetter& get_node,
+                        fbl::Vector<Extent>* extents, fbl::Vector<uint32_t>* container_nodes);
+
+// Appends the run of |length| blocks starting at |start| to |extents|,
+// split into extents no longer than Extent::kMaxLength.
+zx_status_t AppendExtents(uint64_t start, uint64_t length, fbl::Vector<Extent>* extents);
+
+// Returns whether |extents| hold one contiguous run of blocks, which the
+// inode can describe without extent containers.
+bool ExtentsAreContiguous(const fbl::Vector<Extent>& extents);
+
+// Returns the number of extent containers a blob stored in |extents| needs.
+uint64_t ExtentContainerCount(const fbl::Vector<Extent>& extents);
+
+// Fills in the |index|th extent container of a blob stored in |extents|.
+// |next_node| is the node of the following container, if there is one.
+void InitExtentContainer(const fbl::Vector<Extent>& extents, uint64_t index, uint32_t next_node,
+                         ExtentContainer* container);
+
 // Get a pointer to the nth block of the bitmap.
 inline void* GetRawBitmapData(const RawBitmap& bm, uint64_t n) {
     assert(n * kBlobfsBlockSize < bm.size());             // Accessing beyond end of bitmap
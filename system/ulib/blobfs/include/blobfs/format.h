@@ -15,6 +15,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __Fuchsia__
@@ -26,7 +27,7 @@
 namespace blobfs {
 constexpr uint64_t kBlobfsMagic0  = (0xac2153479e694d21ULL);
 constexpr uint64_t kBlobfsMagic1  = (0x985000d4d4d3d314ULL);
-constexpr uint32_t kBlobfsVersion = 0x00000006;
+constexpr uint32_t kBlobfsVersion = 0x00000008;
 
 constexpr uint32_t kBlobFlagClean        = 1;
 constexpr uint32_t kBlobFlagDirty        = 2;
@@ -198,6 +199,46 @@ constexpr uint64_t kStartBlockMinimum  = 1; // Smallest 'data' block possible.
 // Identifies that the on-disk storage of the blob is LZ4 compressed.
 constexpr uint32_t kBlobFlagLZ4Compressed = 0x00000001;
 
+// Identifies that the on-disk storage of the blob is split into chunks of
+// uncompressed data which are LZ4 compressed independently, so that any part
+// of the blob can be decompressed without decompressing what precedes it.
+//
+// The compressed data begins with a ChunkedHeader, followed by a seek table
+// of |num_chunks + 1| uint64_t offsets, relative to the start of the header.
+// Chunk |i| is an LZ4 frame stored in the bytes [offsets[i], offsets[i + 1]),
+// which decompresses to the |chunk_size| bytes of the blob starting at
+// |i * chunk_size| (the last chunk may be shorter).
+constexpr uint32_t kBlobFlagChunkCompressed = 0x00000002;
+
+constexpr uint64_t kBlobfsChunkedMagic = (0x6368756e6b6c7a34ULL);
+
+// Uncompressed size of the chunks written by blobfs.  Chunks are verified as
+// a whole, so their size must be a multiple of the Merkle tree node size.
+constexpr uint32_t kBlobfsChunkSize = 4 * kBlobfsBlockSize;
+
+struct ChunkedHeader {
+    uint64_t magic;
+    uint32_t chunk_size;
+    uint32_t num_chunks;
+};
+
+static_assert(sizeof(ChunkedHeader) == 16, "Blobfs ChunkedHeader size is wrong");
+
+// Size of the header and seek table of a chunk-compressed blob.
+constexpr uint64_t ChunkedSeekTableSize(uint64_t num_chunks) {
+    return sizeof(ChunkedHeader) + (num_chunks + 1) * sizeof(uint64_t);
+}
+
+// Identifies that the blob's blocks are not the single run of |num_blocks|
+// starting at |start_block|, but the extents listed, in order, by the chain
+// of ExtentContainers starting at the inode's |next_node|.  |start_block| is
+// then the start of the first extent.
+constexpr uint32_t kBlobFlagMultiExtent = 0x00000004;
+
+// Identifies a node of the node map which is an ExtentContainer, rather than
+// the Inode of a blob.
+constexpr uint32_t kBlobFlagExtentContainer = 0x00000008;
+
 using digest::Digest;
 
 struct Inode {
@@ -206,7 +247,7 @@ struct Inode {
     uint64_t num_blocks;
     uint64_t blob_size;
     uint32_t flags;
-    uint32_t reserved;
+    uint32_t next_node;
 };
 
 static_assert(sizeof(Inode) == kBlobfsInodeSize,
@@ -214,6 +255,49 @@ static_assert(sizeof(Inode) == kBlobfsInodeSize,
 static_assert(kBlobfsBlockSize % kBlobfsInodeSize == 0,
               "Blobfs Inodes should fit cleanly within a blobfs block");
 
+// A run of data blocks, packed into 64 bits: the first block in the low 48
+// bits and the number of blocks in the high 16.
+class Extent {
+public:
+    static constexpr uint64_t kMaxStart  = (1ULL << 48) - 1;
+    static constexpr uint64_t kMaxLength = (1ULL << 16) - 1;
+
+    constexpr Extent() : data_(0) {}
+    constexpr Extent(uint64_t start, uint64_t length)
+        : data_((start & kMaxStart) | (length << 48)) {}
+
+    constexpr uint64_t Start() const { return data_ & kMaxStart; }
+    constexpr uint64_t Length() const { return data_ >> 48; }
+
+private:
+    uint64_t data_;
+};
+
+static_assert(sizeof(Extent) == sizeof(uint64_t), "Blobfs Extent size is wrong");
+
+constexpr uint32_t kContainerMaxExtents = 4;
+
+// A node holding extents of a blob with kBlobFlagMultiExtent.  It is laid
+// out so that its |start_block| and |flags| are where an Inode keeps them:
+// |start_block| is the start of |extents[0]|, so that, like an allocated
+// Inode, it is never kStartBlockFree.
+struct ExtentContainer {
+    Extent   extents[kContainerMaxExtents];
+    uint64_t start_block;
+    uint64_t extent_count;
+    uint64_t reserved;
+    uint32_t flags;
+    // The next container of the blob, if the blob has more extents.
+    uint32_t next_node;
+};
+
+static_assert(sizeof(ExtentContainer) == kBlobfsInodeSize,
+              "Blobfs ExtentContainer size is wrong");
+static_assert(offsetof(ExtentContainer, start_block) == offsetof(Inode, start_block),
+              "Blobfs ExtentContainer must not look like a free Inode");
+static_assert(offsetof(ExtentContainer, flags) == offsetof(Inode, flags),
+              "Blobfs ExtentContainer flags must be an Inode's flags");
+
 // Number of blocks reserved for the blob itself
 constexpr uint64_t BlobDataBlocks(const Inode& blobNode) {
     return fbl::round_up(blobNode.blob_size, kBlobfsBlockSize) / kBlobfsBlockSize;
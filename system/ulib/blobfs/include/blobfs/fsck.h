@@ -30,6 +30,8 @@ private:
     uint32_t alloc_blocks_;
     uint32_t error_blobs_;
     uint32_t inode_blocks_;
+    uint32_t alloc_containers_;
+    uint32_t referenced_containers_;
 };
 
 zx_status_t Fsck(fbl::unique_ptr<Blobfs> vnode);
@@ -143,16 +143,27 @@ public:
 
     ~Blobfs() {}
 
-    // Checks to see if a blob already exists, and if not allocates a new node
-    zx_status_t NewBlob(const Digest& digest, fbl::unique_ptr<InodeBlock>* out);
+    // Checks to see if a blob already exists, and if not allocates a new node, along with
+    // |container_count| nodes for its extent containers, which are appended to
+    // |container_nodes|.
+    zx_status_t NewBlob(const Digest& digest, uint64_t container_count,
+                        fbl::unique_ptr<InodeBlock>* out, fbl::Vector<uint32_t>* container_nodes);
 
-    // Allocate |nblocks| starting at |*blkno_out| in memory
-    zx_status_t AllocateBlocks(size_t nblocks, size_t* blkno_out);
+    // Finds |nblocks| free blocks, as a single run if there is one long enough, and appends
+    // the extents holding them to |out|. Does not allocate them.
+    zx_status_t FindBlocks(size_t nblocks, fbl::Vector<Extent>* out);
 
-    zx_status_t WriteData(Inode* inode, const void* merkle_data,
-                          const void* blob_data);
+    // Allocate the blocks of |extents| in memory
+    zx_status_t AllocateBlocks(const fbl::Vector<Extent>& extents);
+
+    zx_status_t WriteData(Inode* inode, const fbl::Vector<Extent>& extents,
+                          const void* merkle_data, const void* blob_data);
     zx_status_t WriteBitmap(size_t nblocks, size_t start_block);
     zx_status_t WriteNode(fbl::unique_ptr<InodeBlock> ino_block);
+
+    // Writes the extent containers listing |extents| to |container_nodes|.
+    zx_status_t WriteExtentContainers(const fbl::Vector<Extent>& extents,
+                                      const fbl::Vector<uint32_t>& container_nodes);
     zx_status_t WriteInfo();
 
 private:
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <blobfs/format.h>
+#include <fbl/array.h>
+#include <fbl/atomic.h>
 #include <fbl/macros.h>
 #include <lz4/lz4frame.h>
 #include <zircon/types.h>
@@ -12,9 +15,14 @@ namespace blobfs {
 
 // A Compressor is used to compress a blob transparently before it is written
 // back to disk.
+//
+// The blob is compressed in the chunked format (kBlobFlagChunkCompressed),
+// one LZ4 frame per |chunk_size| bytes of the blob, with the seek table
+// filled in at the start of the buffer as each chunk is completed.
 class Compressor {
 public:
-    Compressor();
+    // |chunk_size| must be a multiple of kBlobfsBlockSize.
+    explicit Compressor(uint32_t chunk_size = kBlobfsChunkSize);
 
     ~Compressor();
 
@@ -30,11 +38,12 @@ public:
     size_t Size() const;
 
     // Initializes the compression object with a provided
-    // buffer of a specified size.
+    // buffer of a specified size, to compress a blob of
+    // size |blob_size|.
     //
     // Although Compressor uses this buffer, it does not own the buffer,
     // assuming that a parent object is responsible for the lifetime.
-    zx_status_t Initialize(void* buf, size_t buf_max);
+    zx_status_t Initialize(void* buf, size_t buf_max, size_t blob_size);
 
     // Returns the maximum possible size a buffer would need to be
     // in order to compress a blob of size |blob_size|.
@@ -46,7 +55,8 @@ public:
     zx_status_t Update(const void* data, size_t length);
 
     // Finishes the compression process. Must be called
-    // before compression is considered complete.
+    // before compression is considered complete, once all
+    // |blob_size| bytes have been passed to |Update()|.
     zx_status_t End();
 
 private:
@@ -58,10 +68,140 @@ private:
 
     size_t buf_remaining() const { return buf_max_ - buf_used_; }
 
+    uint64_t* SeekTable() const {
+        return reinterpret_cast<uint64_t*>(reinterpret_cast<uintptr_t>(buf_) +
+                                           sizeof(ChunkedHeader));
+    }
+
+    // Starts and finishes the LZ4 frame of the chunk |chunk_|.
+    zx_status_t BeginChunk();
+    zx_status_t EndChunk();
+
+    const uint32_t chunk_size_;
     LZ4F_compressionContext_t ctx_;
     void* buf_;
     size_t buf_max_;
     size_t buf_used_;
+    uint32_t num_chunks_;
+    // The chunk being compressed, and how much of it has been passed to
+    // |Update()|.
+    uint32_t chunk_;
+    size_t chunk_used_;
+    bool in_chunk_;
+};
+
+// A ChunkedCompressor produces the same chunked format as Compressor, but
+// compresses each chunk on its own, so that the chunks of a blob may be
+// compressed out of order and on several threads at once.
+//
+// Each chunk is compressed into a slot of the buffer reserved for it, and
+// |End()| packs the chunks together and fills in the seek table.
+class ChunkedCompressor {
+public:
+    // |chunk_size| must be a multiple of kBlobfsBlockSize.
+    explicit ChunkedCompressor(uint32_t chunk_size = kBlobfsChunkSize);
+
+    ~ChunkedCompressor();
+
+    uint32_t chunk_size() const { return chunk_size_; }
+
+    // Identifies if compression is underway.
+    bool Compressing() const {
+        return buf_ != nullptr;
+    }
+
+    // Resets the compression process.  Must not be called while
+    // |CompressChunks()| is running.
+    void Reset();
+
+    // Returns the compressed size of the chunks compressed so far, including
+    // the header and seek table.
+    size_t Size() const;
+
+    // Initializes the compressor with a buffer of |buf_max| bytes, which it
+    // does not own, to compress a blob of size |blob_size|.  |buf_max| must
+    // be at least |BufferMax(blob_size)|.
+    zx_status_t Initialize(void* buf, size_t buf_max, size_t blob_size);
+
+    // Returns the size of the buffer needed to compress a blob of size
+    // |blob_size|.
+    size_t BufferMax(size_t blob_size) const;
+
+    // Compresses the chunks of the blob at |blob| between |offset| and
+    // |offset + length|.  |offset| must be chunk-aligned, and |offset +
+    // length| must either be chunk-aligned or be the end of the blob.
+    //
+    // May be called concurrently for disjoint ranges.
+    zx_status_t CompressChunks(const void* blob, size_t offset, size_t length);
+
+    // Finishes the compression process, once every chunk has been compressed.
+    zx_status_t End();
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ChunkedCompressor);
+
+    uint8_t* Slot(uint32_t chunk) const {
+        return static_cast<uint8_t*>(buf_) + table_size_ + chunk * slot_size_;
+    }
+
+    uint64_t* SeekTable() const {
+        return reinterpret_cast<uint64_t*>(static_cast<uint8_t*>(buf_) + sizeof(ChunkedHeader));
+    }
+
+    const uint32_t chunk_size_;
+    // The most a chunk may compress to.
+    const size_t slot_size_;
+    void* buf_;
+    size_t blob_size_;
+    size_t table_size_;
+    uint32_t num_chunks_;
+    // The compressed size of each chunk, or zero if it has not been
+    // compressed yet.
+    fbl::Array<size_t> chunk_sizes_;
+    fbl::atomic<size_t> size_;
+};
+
+// A SeekTable locates the chunks of a chunk-compressed blob
+// (kBlobFlagChunkCompressed).
+class SeekTable {
+public:
+    SeekTable() = default;
+
+    // Returns an upper bound on the size of the header and seek table of a
+    // chunk-compressed blob of size |blob_size|, whatever its chunk size.
+    static uint64_t SizeMax(uint64_t blob_size);
+
+    // Validates and copies the header and seek table at the start of |buf|,
+    // which holds the first |buf_size| bytes of the |compressed_size| bytes
+    // of compressed data of a blob of size |blob_size|.
+    zx_status_t Init(const void* buf, size_t buf_size, uint64_t blob_size,
+                     uint64_t compressed_size);
+
+    uint32_t chunk_size() const { return chunk_size_; }
+    uint32_t num_chunks() const { return num_chunks_; }
+
+    // Returns the chunk holding the byte at offset |off| of the blob.
+    uint32_t ChunkAt(uint64_t off) const {
+        return static_cast<uint32_t>(off / chunk_size_);
+    }
+
+    // Returns the range of the compressed data holding chunk |chunk|.
+    uint64_t CompressedStart(uint32_t chunk) const { return offsets_[chunk]; }
+    uint64_t CompressedEnd(uint32_t chunk) const { return offsets_[chunk + 1]; }
+
+    // Returns the uncompressed size of chunk |chunk|.
+    uint64_t ChunkLength(uint32_t chunk) const {
+        uint64_t start = static_cast<uint64_t>(chunk) * chunk_size_;
+        return blob_size_ - start < chunk_size_ ? blob_size_ - start : chunk_size_;
+    }
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(SeekTable);
+
+    uint64_t blob_size_ = 0;
+    uint32_t chunk_size_ = 0;
+    uint32_t num_chunks_ = 0;
+    fbl::Array<uint64_t> offsets_;
 };
 
 // A Decompressor is used to decompress a blob transparently before it is
@@ -73,6 +213,13 @@ public:
     // filled (or both).
     static zx_status_t Decompress(void* target_buf, size_t* target_size,
                                   const void* src_buf, size_t* src_size);
+
+    // Decompress chunk |chunk| of the chunk-compressed blob described by
+    // |table| into |target_buf|, which must hold |table.ChunkLength(chunk)|
+    // bytes.  |src_buf| holds the chunk's compressed data, which is
+    // |table.CompressedEnd(chunk) - table.CompressedStart(chunk)| bytes.
+    static zx_status_t DecompressChunk(const SeekTable& table, uint32_t chunk,
+                                       void* target_buf, const void* src_buf);
 };
 
 } // namespace blobfs
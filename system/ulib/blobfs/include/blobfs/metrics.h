@@ -62,6 +62,15 @@ struct BlobfsMetrics {
     uint64_t blobs_verified_total_size_merkle = 0;
     zx::ticks total_verification_time_ticks = {};
 
+    // CACHE STATS
+
+    // Closed blobs reopened with their data still in memory, and without it.
+    uint64_t cache_hits = 0;
+    uint64_t cache_misses = 0;
+    // Closed blobs whose data was evicted from memory.
+    uint64_t cache_evictions = 0;
+    uint64_t cache_bytes_evicted = 0;
+
     // FVM STATS
     // TODO(smklein)
 };
@@ -0,0 +1,96 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <threads.h>
+
+#include <fbl/function.h>
+#include <fbl/intrusive_single_list.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <fs/queue.h>
+#include <zircon/types.h>
+
+namespace blobfs {
+
+// A fixed set of threads which run tasks in the order they are submitted.
+//
+// Used to hash and compress blobs while they are being written, so that
+// the work is spread across CPUs and overlapped with the client's writes.
+class WorkerPool {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(WorkerPool);
+
+    // Waits for the submitted tasks to run, then stops the workers.
+    ~WorkerPool();
+
+    // Starts a pool of |num_workers| threads.  A pool without workers runs
+    // each task on the thread which submits it.
+    static zx_status_t Create(uint32_t num_workers, fbl::unique_ptr<WorkerPool>* out);
+
+    uint32_t num_workers() const { return static_cast<uint32_t>(workers_.size()); }
+
+    // Runs |task| on one of the workers.
+    void Submit(fbl::Closure task);
+
+private:
+    struct Task : public fbl::SinglyLinkedListable<fbl::unique_ptr<Task>> {
+        fbl::Closure fn;
+    };
+    using TaskQueue = fs::Queue<fbl::unique_ptr<Task>>;
+
+    WorkerPool() = default;
+
+    static int WorkerThread(void* arg);
+
+    fbl::Vector<thrd_t> workers_;
+
+    // Signalled when a task is added, or when the pool is being destroyed.
+    cnd_t task_added_;
+    bool task_added_initialized_ = false;
+    fbl::Mutex lock_;
+    TaskQueue tasks_ __TA_GUARDED(lock_);
+    bool stopping_ __TA_GUARDED(lock_) = false;
+};
+
+// A set of tasks run on a WorkerPool, which can be waited on together.
+class TaskGroup {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(TaskGroup);
+
+    // Waits for any tasks still running.
+    ~TaskGroup();
+
+    // Creates a group running tasks on |pool|.  |pool| may be null, in which
+    // case tasks are run as they are submitted.
+    static zx_status_t Create(WorkerPool* pool, fbl::unique_ptr<TaskGroup>* out);
+
+    using TaskFunc = fbl::Function<zx_status_t()>;
+
+    // Runs |task| on the pool.
+    void Submit(TaskFunc task);
+
+    // Waits for every task submitted so far, and returns the first error any
+    // of them reported.
+    zx_status_t Wait();
+
+private:
+    explicit TaskGroup(WorkerPool* pool) : pool_(pool) {}
+
+    void Complete(zx_status_t status);
+
+    WorkerPool* const pool_;
+
+    // Signalled when the last pending task completes.
+    cnd_t tasks_done_;
+    bool tasks_done_initialized_ = false;
+    fbl::Mutex lock_;
+    uint32_t pending_ __TA_GUARDED(lock_) = 0;
+    zx_status_t status_ __TA_GUARDED(lock_) = ZX_OK;
+};
+
+} // namespace blobfs
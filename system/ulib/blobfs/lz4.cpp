@@ -4,9 +4,11 @@
 
 #include <lz4/lz4frame.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <fbl/macros.h>
 #include <fbl/unique_ptr.h>
@@ -19,7 +21,10 @@ namespace blobfs {
 
 constexpr size_t kLz4HeaderSize = 15;
 
-Compressor::Compressor() : buf_(nullptr) {}
+Compressor::Compressor(uint32_t chunk_size)
+    : chunk_size_(chunk_size), buf_(nullptr) {
+    ZX_DEBUG_ASSERT(chunk_size_ > 0 && chunk_size_ % kBlobfsBlockSize == 0);
+}
 
 Compressor::~Compressor() {
     Reset();
@@ -32,8 +37,17 @@ void Compressor::Reset() {
     buf_ = nullptr;
 }
 
-zx_status_t Compressor::Initialize(void* buf, size_t buf_max) {
+zx_status_t Compressor::Initialize(void* buf, size_t buf_max, size_t blob_size) {
     ZX_DEBUG_ASSERT(!Compressing());
+    uint64_t num_chunks = fbl::round_up(blob_size, chunk_size_) / chunk_size_;
+    if (num_chunks > UINT32_MAX) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    size_t table_size = ChunkedSeekTableSize(num_chunks);
+    if (buf_max < table_size) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+
     LZ4F_errorCode_t errc = LZ4F_createCompressionContext(&ctx_, LZ4F_VERSION);
     if (LZ4F_isError(errc)) {
         return ZX_ERR_NO_MEMORY;
@@ -41,35 +55,87 @@ zx_status_t Compressor::Initialize(void* buf, size_t buf_max) {
 
     buf_ = buf;
     buf_max_ = buf_max;
-    buf_used_ = 0;
+    buf_used_ = table_size;
+    num_chunks_ = static_cast<uint32_t>(num_chunks);
+    chunk_ = 0;
+    chunk_used_ = 0;
+    in_chunk_ = false;
 
-    size_t r = LZ4F_compressBegin(ctx_, Buffer(), buf_remaining(), nullptr);
-    if (LZ4F_isError(r)) {
-        return ZX_ERR_BUFFER_TOO_SMALL;
-    }
-    buf_used_ += r;
+    ChunkedHeader* header = reinterpret_cast<ChunkedHeader*>(buf_);
+    header->magic = kBlobfsChunkedMagic;
+    header->chunk_size = chunk_size_;
+    header->num_chunks = num_chunks_;
     return ZX_OK;
 }
 
 size_t Compressor::BufferMax(size_t blob_size) const {
-    return kLz4HeaderSize + LZ4F_compressBound(blob_size, nullptr);
+    size_t num_chunks = fbl::round_up(blob_size, chunk_size_) / chunk_size_;
+    return ChunkedSeekTableSize(num_chunks) +
+           num_chunks * (kLz4HeaderSize + LZ4F_compressBound(chunk_size_, nullptr));
 }
 
-zx_status_t Compressor::Update(const void* data, size_t length) {
-    size_t r = LZ4F_compressUpdate(ctx_, Buffer(), buf_remaining(), data, length, nullptr);
+zx_status_t Compressor::BeginChunk() {
+    ZX_DEBUG_ASSERT(!in_chunk_);
+    if (chunk_ == num_chunks_) {
+        // More data than the blob was initialized with.
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    SeekTable()[chunk_] = buf_used_;
+    size_t r = LZ4F_compressBegin(ctx_, Buffer(), buf_remaining(), nullptr);
     if (LZ4F_isError(r)) {
-        return ZX_ERR_IO_DATA_INTEGRITY;
+        return ZX_ERR_BUFFER_TOO_SMALL;
     }
     buf_used_ += r;
+    chunk_used_ = 0;
+    in_chunk_ = true;
     return ZX_OK;
 }
 
-zx_status_t Compressor::End() {
+zx_status_t Compressor::EndChunk() {
+    ZX_DEBUG_ASSERT(in_chunk_);
     size_t r = LZ4F_compressEnd(ctx_, Buffer(), buf_remaining(), nullptr);
     if (LZ4F_isError(r)) {
         return ZX_ERR_IO_DATA_INTEGRITY;
     }
     buf_used_ += r;
+    chunk_++;
+    in_chunk_ = false;
+    return ZX_OK;
+}
+
+zx_status_t Compressor::Update(const void* data_, size_t length) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(data_);
+    zx_status_t status;
+    while (length > 0) {
+        if (!in_chunk_ && (status = BeginChunk()) != ZX_OK) {
+            return status;
+        }
+        size_t n = fbl::min(length, chunk_size_ - chunk_used_);
+        size_t r = LZ4F_compressUpdate(ctx_, Buffer(), buf_remaining(), data, n, nullptr);
+        if (LZ4F_isError(r)) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        buf_used_ += r;
+        chunk_used_ += n;
+        data += n;
+        length -= n;
+        if (chunk_used_ == chunk_size_ && (status = EndChunk()) != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t Compressor::End() {
+    zx_status_t status;
+    if (in_chunk_ && (status = EndChunk()) != ZX_OK) {
+        return status;
+    }
+    if (chunk_ != num_chunks_) {
+        // Less data than the blob was initialized with.
+        return ZX_ERR_BAD_STATE;
+    }
+    SeekTable()[num_chunks_] = buf_used_;
     return ZX_OK;
 }
 
@@ -78,6 +144,150 @@ size_t Compressor::Size() const {
     return buf_used_;
 }
 
+ChunkedCompressor::ChunkedCompressor(uint32_t chunk_size)
+    : chunk_size_(chunk_size), slot_size_(LZ4F_compressFrameBound(chunk_size, nullptr)),
+      buf_(nullptr), size_(0) {
+    ZX_DEBUG_ASSERT(chunk_size_ > 0 && chunk_size_ % kBlobfsBlockSize == 0);
+}
+
+ChunkedCompressor::~ChunkedCompressor() {
+    Reset();
+}
+
+void ChunkedCompressor::Reset() {
+    buf_ = nullptr;
+    chunk_sizes_.reset();
+}
+
+zx_status_t ChunkedCompressor::Initialize(void* buf, size_t buf_max, size_t blob_size) {
+    ZX_DEBUG_ASSERT(!Compressing());
+    uint64_t num_chunks = fbl::round_up(blob_size, chunk_size_) / chunk_size_;
+    if (num_chunks > UINT32_MAX) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    if (buf_max < BufferMax(blob_size)) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+
+    fbl::AllocChecker ac;
+    chunk_sizes_.reset(new (&ac) size_t[num_chunks](), num_chunks);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    buf_ = buf;
+    blob_size_ = blob_size;
+    table_size_ = ChunkedSeekTableSize(num_chunks);
+    num_chunks_ = static_cast<uint32_t>(num_chunks);
+    size_.store(table_size_);
+
+    ChunkedHeader* header = reinterpret_cast<ChunkedHeader*>(buf_);
+    header->magic = kBlobfsChunkedMagic;
+    header->chunk_size = chunk_size_;
+    header->num_chunks = num_chunks_;
+    return ZX_OK;
+}
+
+size_t ChunkedCompressor::BufferMax(size_t blob_size) const {
+    size_t num_chunks = fbl::round_up(blob_size, chunk_size_) / chunk_size_;
+    return ChunkedSeekTableSize(num_chunks) + num_chunks * slot_size_;
+}
+
+zx_status_t ChunkedCompressor::CompressChunks(const void* blob, size_t offset, size_t length) {
+    TRACE_DURATION("blobfs", "ChunkedCompressor::CompressChunks", "offset", offset,
+                   "length", length);
+    ZX_DEBUG_ASSERT(Compressing());
+    if (offset + length > blob_size_) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    if (offset % chunk_size_ != 0 ||
+        ((offset + length) % chunk_size_ != 0 && offset + length != blob_size_)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    const uint8_t* data = static_cast<const uint8_t*>(blob) + offset;
+    uint32_t chunk = static_cast<uint32_t>(offset / chunk_size_);
+    while (length > 0) {
+        size_t n = fbl::min(length, static_cast<size_t>(chunk_size_));
+        size_t r = LZ4F_compressFrame(Slot(chunk), slot_size_, data, n, nullptr);
+        if (LZ4F_isError(r)) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        chunk_sizes_[chunk] = r;
+        size_.fetch_add(r);
+        data += n;
+        length -= n;
+        chunk++;
+    }
+    return ZX_OK;
+}
+
+zx_status_t ChunkedCompressor::End() {
+    ZX_DEBUG_ASSERT(Compressing());
+    uint8_t* buf = static_cast<uint8_t*>(buf_);
+    uint64_t used = table_size_;
+    for (uint32_t chunk = 0; chunk < num_chunks_; chunk++) {
+        if (chunk_sizes_[chunk] == 0) {
+            // Not every chunk of the blob was compressed.
+            return ZX_ERR_BAD_STATE;
+        }
+        // Chunks only ever move towards the start of the buffer.
+        memmove(buf + used, Slot(chunk), chunk_sizes_[chunk]);
+        SeekTable()[chunk] = used;
+        used += chunk_sizes_[chunk];
+    }
+    SeekTable()[num_chunks_] = used;
+    ZX_DEBUG_ASSERT(used == size_.load());
+    return ZX_OK;
+}
+
+size_t ChunkedCompressor::Size() const {
+    ZX_DEBUG_ASSERT(Compressing());
+    return size_.load();
+}
+
+uint64_t SeekTable::SizeMax(uint64_t blob_size) {
+    // Chunks are at least a block long.
+    return ChunkedSeekTableSize(fbl::round_up(blob_size, kBlobfsBlockSize) / kBlobfsBlockSize);
+}
+
+zx_status_t SeekTable::Init(const void* buf, size_t buf_size, uint64_t blob_size,
+                            uint64_t compressed_size) {
+    if (buf_size < sizeof(ChunkedHeader)) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    const ChunkedHeader* header = reinterpret_cast<const ChunkedHeader*>(buf);
+    if (header->magic != kBlobfsChunkedMagic || header->chunk_size == 0 ||
+        header->chunk_size % kBlobfsBlockSize != 0) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    uint64_t num_chunks = fbl::round_up(blob_size, header->chunk_size) / header->chunk_size;
+    uint64_t table_size = ChunkedSeekTableSize(num_chunks);
+    if (header->num_chunks != num_chunks || buf_size < table_size) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(header + 1);
+    if (offsets[0] != table_size || offsets[num_chunks] > compressed_size) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    for (uint64_t i = 0; i < num_chunks; i++) {
+        if (offsets[i] >= offsets[i + 1]) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+
+    fbl::AllocChecker ac;
+    offsets_.reset(new (&ac) uint64_t[num_chunks + 1], num_chunks + 1);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    memcpy(offsets_.get(), offsets, (num_chunks + 1) * sizeof(uint64_t));
+    blob_size_ = blob_size;
+    chunk_size_ = header->chunk_size;
+    num_chunks_ = header->num_chunks;
+    return ZX_OK;
+}
+
 zx_status_t Decompressor::Decompress(void* target_buf_, size_t* target_size,
                                      const void* src_buf_, size_t* src_size) {
     TRACE_DURATION("blobfs", "Decompressor::Decompress", "target_size", *target_size,
@@ -119,9 +329,12 @@ zx_status_t Decompressor::Decompress(void* target_buf_, size_t* target_size,
             break;
         }
 
+        // Don't let a corrupt frame lead us past the end of the source.
+        if (src_drained == *src_size) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
         dst_sz_next = *target_size - target_drained;
-        src_sz_next = r;
-
+        src_sz_next = fbl::min(r, *src_size - src_drained);
     }
 
     *target_size = target_drained;
@@ -129,4 +342,20 @@ zx_status_t Decompressor::Decompress(void* target_buf_, size_t* target_size,
     return ZX_OK;
 }
 
+zx_status_t Decompressor::DecompressChunk(const SeekTable& table, uint32_t chunk,
+                                          void* target_buf, const void* src_buf) {
+    ZX_DEBUG_ASSERT(chunk < table.num_chunks());
+    size_t target_size = table.ChunkLength(chunk);
+    size_t src_size = table.CompressedEnd(chunk) - table.CompressedStart(chunk);
+    const size_t expected_src_size = src_size;
+    zx_status_t status = Decompress(target_buf, &target_size, src_buf, &src_size);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (target_size != table.ChunkLength(chunk) || src_size != expected_src_size) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    return ZX_OK;
+}
+
 } // namespace blobfs
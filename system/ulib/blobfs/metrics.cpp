@@ -45,6 +45,11 @@ void BlobfsMetrics::Dump() const {
            TicksToMs(total_read_from_disk_time_ticks),
            bytes_read_from_disk / mb,
            TicksToMs(total_verification_time_ticks));
+    printf("Cache Info:\n");
+    printf("  Reopened %zu closed blobs from memory, %zu from disk\n", cache_hits,
+           cache_misses);
+    printf("  Evicted %zu closed blobs (%zu MB)\n", cache_evictions,
+           cache_bytes_evicted / mb);
 }
 
 } // namespace blobfs
@@ -25,6 +25,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/metrics.cpp \
     $(LOCAL_DIR)/rpc.cpp \
     $(LOCAL_DIR)/vnode.cpp \
+    $(LOCAL_DIR)/worker-pool.cpp \
     $(LOCAL_DIR)/writeback.cpp \
 
 MODULE_STATIC_LIBS := \
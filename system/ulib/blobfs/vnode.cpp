@@ -42,10 +42,14 @@ void VnodeBlob::fbl_recycle() {
 
 void VnodeBlob::TearDown() {
     ZX_ASSERT(clone_watcher_.object() == ZX_HANDLE_INVALID);
+    // Waits for any segments of a partially written blob still being
+    // processed, since they use the mapping.
+    write_info_.reset();
     if (mapping_.vmo()) {
         blobfs_->DetachVmo(vmoid_);
     }
     mapping_.Reset();
+    seek_table_.reset();
 }
 
 VnodeBlob::~VnodeBlob() {
@@ -0,0 +1,152 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <fbl/unique_ptr.h>
+
+#include <blobfs/worker-pool.h>
+
+namespace blobfs {
+
+WorkerPool::~WorkerPool() {
+    // Workers are only started once the condition variable is initialized.
+    if (!task_added_initialized_) {
+        return;
+    }
+
+    {
+        fbl::AutoLock lock(&lock_);
+        stopping_ = true;
+        cnd_broadcast(&task_added_);
+    }
+
+    for (thrd_t& worker : workers_) {
+        int r;
+        thrd_join(worker, &r);
+    }
+    cnd_destroy(&task_added_);
+}
+
+zx_status_t WorkerPool::Create(uint32_t num_workers, fbl::unique_ptr<WorkerPool>* out) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<WorkerPool> pool(new (&ac) WorkerPool());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if (cnd_init(&pool->task_added_) != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    pool->task_added_initialized_ = true;
+    pool->workers_.reserve(num_workers, &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    for (uint32_t i = 0; i < num_workers; i++) {
+        thrd_t worker;
+        if (thrd_create_with_name(&worker, WorkerPool::WorkerThread, pool.get(),
+                                  "blobfs-worker") != thrd_success) {
+            return ZX_ERR_NO_RESOURCES;
+        }
+        pool->workers_.push_back(worker);
+    }
+
+    *out = fbl::move(pool);
+    return ZX_OK;
+}
+
+void WorkerPool::Submit(fbl::Closure fn) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Task> task(new (&ac) Task());
+    if (workers_.is_empty() || !ac.check()) {
+        fn();
+        return;
+    }
+    task->fn = fbl::move(fn);
+
+    fbl::AutoLock lock(&lock_);
+    tasks_.push(fbl::move(task));
+    cnd_signal(&task_added_);
+}
+
+int WorkerPool::WorkerThread(void* arg) {
+    WorkerPool* pool = reinterpret_cast<WorkerPool*>(arg);
+    pool->lock_.Acquire();
+    while (true) {
+        while (!pool->tasks_.is_empty()) {
+            fbl::unique_ptr<Task> task = pool->tasks_.pop();
+            pool->lock_.Release();
+            task->fn();
+            task.reset();
+            pool->lock_.Acquire();
+        }
+
+        if (pool->stopping_) {
+            pool->lock_.Release();
+            return 0;
+        }
+
+        cnd_wait(&pool->task_added_, pool->lock_.GetInternal());
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    // Tasks are only submitted once the condition variable is initialized.
+    if (!tasks_done_initialized_) {
+        return;
+    }
+
+    Wait();
+    cnd_destroy(&tasks_done_);
+}
+
+zx_status_t TaskGroup::Create(WorkerPool* pool, fbl::unique_ptr<TaskGroup>* out) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<TaskGroup> group(new (&ac) TaskGroup(pool));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if (cnd_init(&group->tasks_done_) != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    group->tasks_done_initialized_ = true;
+
+    *out = fbl::move(group);
+    return ZX_OK;
+}
+
+void TaskGroup::Submit(TaskFunc task) {
+    {
+        fbl::AutoLock lock(&lock_);
+        pending_++;
+    }
+    if (pool_ == nullptr) {
+        Complete(task());
+        return;
+    }
+    pool_->Submit([this, task = fbl::move(task)]() {
+        Complete(task());
+    });
+}
+
+zx_status_t TaskGroup::Wait() {
+    fbl::AutoLock lock(&lock_);
+    while (pending_ > 0) {
+        cnd_wait(&tasks_done_, lock_.GetInternal());
+    }
+    return status_;
+}
+
+void TaskGroup::Complete(zx_status_t status) {
+    fbl::AutoLock lock(&lock_);
+    if (status_ == ZX_OK) {
+        status_ = status;
+    }
+    if (--pending_ == 0) {
+        cnd_broadcast(&tasks_done_);
+    }
+}
+
+} // namespace blobfs
@@ -7,11 +7,29 @@
 #include <cobalt-client/cpp/counter-internal.h>
 #include <cobalt-client/cpp/counter.h>
 #include <zircon/assert.h>
+#include <zircon/compiler.h>
 
 namespace cobalt_client {
 namespace internal {
 
-BaseCounter::BaseCounter(BaseCounter&& other) : counter_(other.Exchange(0)) {}
+namespace {
+// Shard handed to the next thread that asks for one.
+fbl::atomic<uint32_t> next_shard(0);
+
+// Shard of the current thread, or kShardCount until it is assigned one.
+thread_local uint32_t current_shard = kShardCount;
+} // namespace
+
+uint32_t GetShardIndex() {
+    if (unlikely(current_shard == kShardCount)) {
+        current_shard = next_shard.fetch_add(1, fbl::memory_order_relaxed) % kShardCount;
+    }
+    return current_shard;
+}
+
+BaseCounter::BaseCounter(BaseCounter&& other) : BaseCounter() {
+    shards_[0].value.store(other.Exchange(0), kMemoryOrder);
+}
 
 RemoteCounter::RemoteCounter(const RemoteMetricInfo& metric_info, EventBuffer buffer)
     : BaseCounter(), buffer_(fbl::move(buffer)), metric_info_(metric_info) {
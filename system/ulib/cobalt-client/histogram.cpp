@@ -10,6 +10,7 @@
 
 #include <cobalt-client/cpp/histogram-internal.h>
 #include <cobalt-client/cpp/metric-options.h>
+#include <fbl/algorithm.h>
 #include <fbl/limits.h>
 #include <fuchsia/cobalt/c/fidl.h>
 
@@ -87,15 +88,27 @@ void LoadLinear(HistogramOptions* options) {
 
 } // namespace
 
-BaseHistogram::BaseHistogram(uint32_t num_buckets) {
-    buckets_.reserve(num_buckets);
-    for (uint32_t i = 0; i < num_buckets; ++i) {
-        buckets_.push_back(BaseCounter());
+BaseHistogram::BaseHistogram(uint32_t num_buckets) : num_buckets_(num_buckets) {
+    shard_lines_ = fbl::round_up(num_buckets, kCountsPerLine) / kCountsPerLine;
+    const size_t size = kShardCount * shard_lines_;
+    lines_.reset(new Line[size]);
+    for (size_t i = 0; i < size; ++i) {
+        for (auto& count : lines_[i].counts) {
+            count.store(0, BaseCounter::kMemoryOrder);
+        }
     }
 }
 
 BaseHistogram::BaseHistogram(BaseHistogram&& other) = default;
 
+BaseHistogram::Count BaseHistogram::ExchangeCount(uint32_t bucket) {
+    Count count = 0;
+    for (uint32_t shard = 0; shard < kShardCount; ++shard) {
+        count += GetBucket(shard, bucket).exchange(0, BaseCounter::kMemoryOrder);
+    }
+    return count;
+}
+
 RemoteHistogram::RemoteHistogram(uint32_t num_buckets, const RemoteMetricInfo& metric_info,
                                  RemoteHistogram::EventBuffer buffer)
     : BaseHistogram(num_buckets), buffer_(fbl::move(buffer)), metric_info_(metric_info) {
@@ -120,10 +133,10 @@ bool RemoteHistogram::Flush(const RemoteHistogram::FlushFn& flush_handler) {
         return false;
     }
 
-    // Sets every bucket back to 0, not all buckets will be at the same instant, but
-    // eventual consistency in the backend is good enough.
+    // Merges the shards of every bucket and sets them back to 0, not all buckets will be
+    // at the same instant, but eventual consistency in the backend is good enough.
     for (uint32_t bucket_index = 0; bucket_index < bucket_buffer_.size(); ++bucket_index) {
-        bucket_buffer_[bucket_index].count = buckets_[bucket_index].Exchange();
+        bucket_buffer_[bucket_index].count = ExchangeCount(bucket_index);
     }
 
     flush_handler(metric_info_, buffer_, fbl::BindMember(&buffer_, &EventBuffer::CompleteFlush));
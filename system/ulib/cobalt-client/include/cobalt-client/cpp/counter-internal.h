@@ -19,11 +19,25 @@ namespace internal {
 // Note: Everything on this namespace is internal, no external users should rely
 // on the behaviour of any of these classes.
 
+// Number of shards that sharded metrics spread their updates across.
+constexpr uint32_t kShardCount = 8;
+
+// Size of a cache line, used to keep shards updated by different threads from
+// sharing one.
+constexpr size_t kCacheLineSize = 64;
+
+// Returns the shard, in [0, kShardCount), that the calling thread should update.
+// Threads are assigned a shard round-robin the first time they call this, so up
+// to kShardCount threads never contend with each other.
+uint32_t GetShardIndex();
+
 // BaseCounter and RemoteCounter differ in that the first is simply a thin wrapper over
 // an atomic while the second provides Cobalt Fidl specific API and holds more metric related
 // data for a full fledged metric.
 //
-// Thin wrapper on top of an atomic, which provides a fixed memory ordering for all calls.
+// Thin wrapper on top of a set of atomics, which provides a fixed memory ordering for all
+// calls. Increments go to the shard of the calling thread, so concurrent writers do not
+// bounce a cache line between them; reads sum every shard.
 // Calls are inlined to reduce overhead.
 class BaseCounter {
 public:
@@ -32,24 +46,46 @@ public:
     // All atomic operations use this memory order.
     static constexpr fbl::memory_order kMemoryOrder = fbl::memory_order::memory_order_relaxed;
 
-    BaseCounter() : counter_(0) {}
+    BaseCounter() {
+        for (auto& shard : shards_) {
+            shard.value.store(0, kMemoryOrder);
+        }
+    }
     BaseCounter(const BaseCounter&) = delete;
     BaseCounter(BaseCounter&&);
     BaseCounter& operator=(const BaseCounter&) = delete;
     BaseCounter& operator=(BaseCounter&&) = delete;
     ~BaseCounter() = default;
 
-    // Increments |counter_| by |val|.
-    void Increment(Type val = 1) { counter_.fetch_add(val, kMemoryOrder); }
-
-    // Returns the current value of|counter_| and resets it to |val|.
-    Type Exchange(Type val = 0) { return counter_.exchange(val, kMemoryOrder); }
-
-    // Returns the current value of |counter_|.
-    Type Load() const { return counter_.load(kMemoryOrder); }
+    // Increments the counter by |val|.
+    void Increment(Type val = 1) { shards_[GetShardIndex()].value.fetch_add(val, kMemoryOrder); }
+
+    // Returns the current value of the counter and resets it to |val|. Each shard is
+    // exchanged atomically, so every increment is returned exactly once, but increments
+    // racing with this call may be accounted to either side of it.
+    Type Exchange(Type val = 0) {
+        Type total = shards_[0].value.exchange(val, kMemoryOrder);
+        for (uint32_t i = 1; i < kShardCount; ++i) {
+            total += shards_[i].value.exchange(0, kMemoryOrder);
+        }
+        return total;
+    }
+
+    // Returns the current value of the counter.
+    Type Load() const {
+        Type total = 0;
+        for (const auto& shard : shards_) {
+            total += shard.value.load(kMemoryOrder);
+        }
+        return total;
+    }
 
 protected:
-    fbl::atomic<Type> counter_;
+    struct alignas(kCacheLineSize) Shard {
+        fbl::atomic<Type> value;
+    };
+
+    Shard shards_[kShardCount];
 };
 
 // Counter which represents a standalone cobalt metric. Provides API for converting
@@ -12,8 +12,10 @@
 #include <fbl/atomic.h>
 #include <fbl/function.h>
 #include <fbl/string.h>
+#include <fbl/unique_ptr.h>
 #include <fbl/vector.h>
 #include <lib/fidl/cpp/vector_view.h>
+#include <zircon/assert.h>
 
 namespace cobalt_client {
 namespace internal {
@@ -24,6 +26,10 @@ namespace internal {
 // that represent a histogram. Once constructed, unless moved, the class is thread-safe.
 // All allocations happen when constructed.
 //
+// Every shard (see GetShardIndex) has a row of its own with a counter for each bucket,
+// so threads recording samples concurrently do not contend on the same cache lines.
+// Rows are merged when the counts are read.
+//
 // This class is moveable but not copyable or assignable.
 // This class is thread-compatible.
 class BaseHistogram {
@@ -41,21 +47,52 @@ public:
 
     // Increases the count of the |bucket| bucket by 1.
     void IncrementCount(uint32_t bucket, Count val = 1) {
-        ZX_DEBUG_ASSERT_MSG(bucket < buckets_.size(),
-                            "IncrementCount bucket(%u) out of range(%lu).", bucket,
-                            buckets_.size());
-        buckets_[bucket].Increment(val);
+        ZX_DEBUG_ASSERT_MSG(bucket < num_buckets_,
+                            "IncrementCount bucket(%u) out of range(%u).", bucket, num_buckets_);
+        GetBucket(GetShardIndex(), bucket).fetch_add(val, BaseCounter::kMemoryOrder);
     }
 
     // Returns the count of the |bucket| bucket.
     Count GetCount(uint32_t bucket) const {
-        ZX_DEBUG_ASSERT_MSG(bucket < buckets_.size(), "GetCount bucket out of range.");
-        return buckets_[bucket].Load();
+        ZX_DEBUG_ASSERT_MSG(bucket < num_buckets_, "GetCount bucket out of range.");
+        Count count = 0;
+        for (uint32_t shard = 0; shard < kShardCount; ++shard) {
+            count += GetBucket(shard, bucket).load(BaseCounter::kMemoryOrder);
+        }
+        return count;
     }
 
 protected:
-    // Counter for the abs frequency of every histogram bucket.
-    fbl::Vector<BaseCounter> buckets_;
+    // Returns the count of the |bucket| bucket and resets it to 0.
+    Count ExchangeCount(uint32_t bucket);
+
+    // Number of bucket counters that fit in a cache line.
+    static constexpr uint32_t kCountsPerLine = kCacheLineSize / sizeof(fbl::atomic<Count>);
+
+    // A cache line worth of bucket counters. Rows are made of whole lines, so no two
+    // shards share one.
+    struct alignas(kCacheLineSize) Line {
+        fbl::atomic<Count> counts[kCountsPerLine];
+    };
+
+    fbl::atomic<Count>& GetBucket(uint32_t shard, uint32_t bucket) {
+        return lines_[shard * shard_lines_ + bucket / kCountsPerLine]
+            .counts[bucket % kCountsPerLine];
+    }
+
+    const fbl::atomic<Count>& GetBucket(uint32_t shard, uint32_t bucket) const {
+        return lines_[shard * shard_lines_ + bucket / kCountsPerLine]
+            .counts[bucket % kCountsPerLine];
+    }
+
+    // Number of buckets in the histogram.
+    uint32_t num_buckets_;
+
+    // Number of cache lines in the row of each shard.
+    uint32_t shard_lines_;
+
+    // Counter for the abs frequency of every histogram bucket, for every shard.
+    fbl::unique_ptr<Line[]> lines_;
 };
 
 // This class provides a histogram which represents a full fledged cobalt metric. The histogram
@@ -58,6 +58,20 @@ public:
     static zx_status_t Create(const void* data, size_t data_len, void* tree,
                               size_t tree_len, Digest* digest);
 
+    // Create() split in two, so that the bottom level of the tree, which is
+    // nearly all of the work, can be hashed in pieces as the data arrives.
+    //
+    // CreateLeaves() writes the digests of the data nodes between |offset|
+    // and |offset + length| into |tree|.  |offset| must be node-aligned, and
+    // |offset + length| must either be node-aligned or equal |data_len|.
+    // Calls for disjoint ranges may run concurrently.  Once every data node
+    // has been hashed, CreateRoot() completes |tree| and saves its root
+    // digest; the result is the same as that of Create().
+    static zx_status_t CreateLeaves(const void* data, size_t data_len, size_t offset,
+                                    size_t length, void* tree, size_t tree_len);
+    static zx_status_t CreateRoot(const void* data, size_t data_len, void* tree,
+                                  size_t tree_len, Digest* digest);
+
     // Checks the integrity of a the region of data given by the offset and
     // length.  It checks integrity using the given Merkle tree and trusted root
     // digest. |tree_len| must be at least as much as returned by
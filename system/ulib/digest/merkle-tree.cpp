@@ -14,6 +14,8 @@
 #include <zircon/assert.h>
 #include <zircon/errors.h>
 
+#include "node-hash.h"
+
 namespace digest {
 
 // Size of a node in bytes.  Defined in tree.h.
@@ -94,6 +96,10 @@ size_t NextAligned(size_t length) {
     return fbl::round_up(NextLength(length), MerkleTree::kNodeSize);
 }
 
+// The number of full nodes hashed together when verifying a level; their
+// digests are compared against the tree a batch at a time.
+constexpr size_t kVerifyBatch = 8;
+
 } // namespace
 
 ////////
@@ -107,12 +113,103 @@ size_t MerkleTree::GetTreeLength(size_t data_len) {
 zx_status_t MerkleTree::Create(const void* data, size_t data_len, void* tree, size_t tree_len,
                                Digest* digest) {
     zx_status_t rc;
-    MerkleTree mt;
-    if ((rc = mt.CreateInit(data_len, tree_len)) != ZX_OK ||
-        (rc = mt.CreateUpdate(data, data_len, tree)) != ZX_OK ||
-        (rc = mt.CreateFinal(tree, digest)) != ZX_OK) {
+    // Data that fits in a single node is hashed on its own.
+    if (data_len <= kNodeSize) {
+        MerkleTree mt;
+        if ((rc = mt.CreateInit(data_len, tree_len)) != ZX_OK ||
+            (rc = mt.CreateUpdate(data, data_len, tree)) != ZX_OK ||
+            (rc = mt.CreateFinal(tree, digest)) != ZX_OK) {
+            return rc;
+        }
+        return ZX_OK;
+    }
+    // Otherwise, with all of the data at hand, build the tree a level at a
+    // time, which lets whole levels be hashed in batches.
+    if (tree_len < GetTreeLength(data_len)) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    if ((rc = CreateLeaves(data, data_len, 0, data_len, tree, tree_len)) != ZX_OK) {
         return rc;
     }
+    return CreateRoot(data, data_len, tree, tree_len, digest);
+}
+
+zx_status_t MerkleTree::CreateLeaves(const void* data, size_t data_len, size_t offset,
+                                     size_t length, void* tree, size_t tree_len) {
+    ZX_DEBUG_ASSERT(offset + length >= offset);
+    // Must not overrun expected length, and must cover whole nodes.
+    if (offset + length > data_len) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    if (offset % kNodeSize != 0 || ((offset + length) % kNodeSize != 0 &&
+                                    offset + length != data_len)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    // Data that fits in a single node has no tree; CreateRoot hashes it.
+    if (data_len <= kNodeSize) {
+        return ZX_OK;
+    }
+    if (!data || !tree) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (tree_len < NextAligned(data_len)) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    const uint8_t* in = static_cast<const uint8_t*>(data) + offset;
+    uint8_t* out = static_cast<uint8_t*>(tree) + offset / kDigestsPerNode;
+    // Hash the full nodes together, then the partial node at the end of the
+    // data, if any.
+    size_t full = length / kNodeSize;
+    internal::HashNodes(in, offset, 0, full, out);
+    length -= full * kNodeSize;
+    if (length == 0) {
+        return ZX_OK;
+    }
+    in += full * kNodeSize;
+    offset += full * kNodeSize;
+    out += full * Digest::kLength;
+    Digest digest;
+    zx_status_t rc;
+    if ((rc = DigestInit(&digest, offset, length)) != ZX_OK) {
+        return rc;
+    }
+    DigestUpdate(&digest, in, offset, length);
+    DigestFinal(&digest, offset + length);
+    return digest.CopyTo(out, Digest::kLength);
+}
+
+zx_status_t MerkleTree::CreateRoot(const void* data, size_t data_len, void* tree,
+                                   size_t tree_len, Digest* digest) {
+    if (data_len <= kNodeSize) {
+        return Create(data, data_len, tree, tree_len, digest);
+    }
+    if (!tree || !digest) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (tree_len < GetTreeLength(data_len)) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    // Every level above the data is made of full nodes of digests, padded
+    // with zeros, so each is hashed into the one above in a single batch.
+    uint8_t* level_start = static_cast<uint8_t*>(tree);
+    size_t used = NextLength(data_len);
+    uint64_t level = 1;
+    while (true) {
+        size_t level_len = fbl::round_up(used, kNodeSize);
+        memset(level_start + used, 0, level_len - used);
+        if (level_len == kNodeSize) {
+            break;
+        }
+        size_t count = level_len / kNodeSize;
+        internal::HashNodes(level_start, 0, level, count, level_start + level_len);
+        level_start += level_len;
+        used = count * Digest::kLength;
+        ++level;
+    }
+    // The top of the tree is a single node, whose digest is the root.
+    uint8_t root[Digest::kLength];
+    internal::HashNodes(level_start, 0, level, 1, root);
+    *digest = root;
     return ZX_OK;
 }
 
@@ -306,9 +403,23 @@ zx_status_t MerkleTree::VerifyLevel(const void* data, size_t data_len, const voi
     length = fbl::min(finish, data_len) - offset;
     const uint8_t* in = static_cast<const uint8_t*>(data) + offset;
     // The digests are in the next level up.
-    Digest actual;
     const uint8_t* expected = static_cast<const uint8_t*>(tree) + (offset / kDigestsPerNode);
-    // Check the data of this level against the digests.
+    // Check the full nodes of this level against the digests a batch at a
+    // time.
+    uint8_t batch[kVerifyBatch * Digest::kLength];
+    while (length >= kNodeSize) {
+        size_t count = fbl::min(length / kNodeSize, kVerifyBatch);
+        internal::HashNodes(in, offset, level, count, batch);
+        if (memcmp(batch, expected, count * Digest::kLength) != 0) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        in += count * kNodeSize;
+        offset += count * kNodeSize;
+        length -= count * kNodeSize;
+        expected += count * Digest::kLength;
+    }
+    // Check the partial node at the end of the level, if any.
+    Digest actual;
     while (length > 0) {
         if ((rc = DigestInit(&actual, offset | level, data_len - offset)) != ZX_OK) {
             return rc;
@@ -0,0 +1,496 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "node-hash.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <digest/digest.h>
+#include <digest/merkle-tree.h>
+#include <fbl/atomic.h>
+#include <openssl/sha.h>
+#include <zircon/compiler.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+#include <arm_neon.h>
+#define NODE_HASH_ARM64_SHA2 1
+#ifdef __Fuchsia__
+#include <zircon/features.h>
+#include <zircon/syscalls.h>
+#else
+#include <sys/auxv.h>
+#endif
+#endif
+
+namespace digest {
+namespace internal {
+namespace {
+
+constexpr size_t kNodeSize = MerkleTree::kNodeSize;
+constexpr size_t kBlockSize = 64;
+
+// A node is hashed as a message of a 12 byte header, (offset | level) and
+// kNodeSize, followed by the node's data.  The header shifts the data by 12
+// bytes relative to the SHA-256 blocks, so the message takes kNumBlocks
+// blocks: the first holds the header and the start of the data, the middle
+// ones are taken straight from the data, and the last holds the end of the
+// data and the SHA-256 padding.
+constexpr size_t kHeaderSize = sizeof(uint64_t) + sizeof(uint32_t);
+constexpr size_t kNumBlocks = (kHeaderSize + kNodeSize) / kBlockSize + 1;
+constexpr size_t kTailSize = (kHeaderSize + kNodeSize) % kBlockSize;
+static_assert(kTailSize + 1 + sizeof(uint64_t) <= kBlockSize,
+              "SHA-256 padding must fit in the last block of a node");
+
+const uint32_t kInitialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+__UNUSED __ALIGNED(32) const uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+// Writes the first block of the message of the node at |node| to |block|.
+__UNUSED void FirstBlock(const uint8_t* node, uint64_t locality, uint8_t* block) {
+    uint32_t len32 = static_cast<uint32_t>(kNodeSize);
+    memcpy(block, &locality, sizeof(locality));
+    memcpy(block + sizeof(locality), &len32, sizeof(len32));
+    memcpy(block + kHeaderSize, node, kBlockSize - kHeaderSize);
+}
+
+// Returns block |i| of the message of the node at |node|, for 0 < i <
+// kNumBlocks - 1.
+__UNUSED const uint8_t* MiddleBlock(const uint8_t* node, size_t i) {
+    return node + i * kBlockSize - kHeaderSize;
+}
+
+// Writes the last block of the message of the node at |node| to |block|.
+__UNUSED void LastBlock(const uint8_t* node, uint8_t* block) {
+    memcpy(block, node + kNodeSize - kTailSize, kTailSize);
+    block[kTailSize] = 0x80;
+    memset(block + kTailSize + 1, 0, kBlockSize - kTailSize - 1 - sizeof(uint64_t));
+    uint64_t bits = (kHeaderSize + kNodeSize) * 8;
+    for (size_t i = 0; i < sizeof(bits); ++i) {
+        block[kBlockSize - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+// Hashes nodes one at a time with BoringSSL, which picks the best
+// single-stream implementation for the CPU itself.
+void HashNodesPortable(const uint8_t* data, uint64_t offset, uint64_t level, size_t count,
+                       uint8_t* out) {
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t header[kHeaderSize];
+        uint64_t locality = (offset + i * kNodeSize) | level;
+        uint32_t len32 = static_cast<uint32_t>(kNodeSize);
+        memcpy(header, &locality, sizeof(locality));
+        memcpy(header + sizeof(locality), &len32, sizeof(len32));
+        SHA256_CTX ctx;
+        SHA256_Init(&ctx);
+        SHA256_Update(&ctx, header, sizeof(header));
+        SHA256_Update(&ctx, data + i * kNodeSize, kNodeSize);
+        SHA256_Final(out + i * Digest::kLength, &ctx);
+    }
+}
+
+#if defined(__x86_64__)
+
+////////
+// x86-64 SHA extensions.  A round instruction depends on the one before it,
+// so the nodes are hashed two at a time, interleaved, to keep the SHA unit
+// busy.
+
+#define SHA_NI_TARGET __attribute__((target("sha,sse4.1")))
+
+constexpr size_t kShaNiLanes = 2;
+
+// Compresses one block into the state of each of |N| nodes.  The state is
+// kept in the ABEF/CDGH order the SHA instructions use.
+template <size_t N>
+SHA_NI_TARGET inline void ShaNiCompress(__m128i* abef, __m128i* cdgh,
+                                        const uint8_t* const* blocks) {
+    const __m128i kByteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i abef_save[N], cdgh_save[N], w[N][4];
+    for (size_t n = 0; n < N; ++n) {
+        abef_save[n] = abef[n];
+        cdgh_save[n] = cdgh[n];
+        for (size_t j = 0; j < 4; ++j) {
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks[n] + 16 * j));
+            w[n][j] = _mm_shuffle_epi8(m, kByteSwap);
+        }
+    }
+    for (size_t r = 0; r < 16; ++r) {
+        __m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(&kRoundConstants[4 * r]));
+        for (size_t n = 0; n < N; ++n) {
+            __m128i* m = w[n];
+            if (r >= 4) {
+                // W[r] = msg2(msg1(W[r-4], W[r-3]) + W[r-1..r-2 shifted], W[r-1]).
+                __m128i t = _mm_sha256msg1_epu32(m[r % 4], m[(r + 1) % 4]);
+                t = _mm_add_epi32(t, _mm_alignr_epi8(m[(r + 3) % 4], m[(r + 2) % 4], 4));
+                m[r % 4] = _mm_sha256msg2_epu32(t, m[(r + 3) % 4]);
+            }
+            __m128i msg = _mm_add_epi32(m[r % 4], k);
+            cdgh[n] = _mm_sha256rnds2_epu32(cdgh[n], abef[n], msg);
+            msg = _mm_shuffle_epi32(msg, 0x0e);
+            abef[n] = _mm_sha256rnds2_epu32(abef[n], cdgh[n], msg);
+        }
+    }
+    for (size_t n = 0; n < N; ++n) {
+        abef[n] = _mm_add_epi32(abef[n], abef_save[n]);
+        cdgh[n] = _mm_add_epi32(cdgh[n], cdgh_save[n]);
+    }
+}
+
+template <size_t N>
+SHA_NI_TARGET void ShaNiNodes(const uint8_t* data, uint64_t offset, uint64_t level,
+                              uint8_t* out) {
+    const __m128i kByteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    // Convert the initial state from ABCD/EFGH to ABEF/CDGH.
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(&kInitialState[0])), 0xb1);
+    __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(&kInitialState[4])), 0x1b);
+    __m128i abef[N], cdgh[N];
+    for (size_t n = 0; n < N; ++n) {
+        abef[n] = _mm_alignr_epi8(abcd, efgh, 8);
+        cdgh[n] = _mm_blend_epi16(efgh, abcd, 0xf0);
+    }
+
+    uint8_t first[N][kBlockSize];
+    uint8_t last[N][kBlockSize];
+    const uint8_t* blocks[N];
+    for (size_t n = 0; n < N; ++n) {
+        FirstBlock(data + n * kNodeSize, (offset + n * kNodeSize) | level, first[n]);
+        LastBlock(data + n * kNodeSize, last[n]);
+        blocks[n] = first[n];
+    }
+    ShaNiCompress<N>(abef, cdgh, blocks);
+    for (size_t i = 1; i < kNumBlocks - 1; ++i) {
+        for (size_t n = 0; n < N; ++n) {
+            blocks[n] = MiddleBlock(data + n * kNodeSize, i);
+        }
+        ShaNiCompress<N>(abef, cdgh, blocks);
+    }
+    for (size_t n = 0; n < N; ++n) {
+        blocks[n] = last[n];
+    }
+    ShaNiCompress<N>(abef, cdgh, blocks);
+
+    // Convert back to ABCD/EFGH, and write out big-endian.
+    for (size_t n = 0; n < N; ++n) {
+        __m128i feba = _mm_shuffle_epi32(abef[n], 0x1b);
+        __m128i dchg = _mm_shuffle_epi32(cdgh[n], 0xb1);
+        abcd = _mm_blend_epi16(feba, dchg, 0xf0);
+        efgh = _mm_alignr_epi8(dchg, feba, 8);
+        uint8_t* digest = out + n * Digest::kLength;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(digest), _mm_shuffle_epi8(abcd, kByteSwap));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(digest + 16),
+                         _mm_shuffle_epi8(efgh, kByteSwap));
+    }
+}
+
+void HashNodesShaNi(const uint8_t* data, uint64_t offset, uint64_t level, size_t count,
+                    uint8_t* out) {
+    for (; count >= kShaNiLanes; count -= kShaNiLanes) {
+        ShaNiNodes<kShaNiLanes>(data, offset, level, out);
+        data += kShaNiLanes * kNodeSize;
+        offset += kShaNiLanes * kNodeSize;
+        out += kShaNiLanes * Digest::kLength;
+    }
+    if (count != 0) {
+        ShaNiNodes<1>(data, offset, level, out);
+    }
+}
+
+////////
+// x86-64 AVX2.  Without SHA extensions, eight nodes are hashed at once, one
+// in each 32-bit lane of the vector registers.
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+constexpr size_t kAvx2Lanes = 8;
+
+AVX2_TARGET inline __m256i Rotr(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// Compresses one block into the state of each of the eight nodes.  Word |t|
+// of each node's block is read from |base + 4 * t + index[lane]|.
+AVX2_TARGET inline void Avx2Compress(__m256i* s, const uint8_t* base, __m256i index) {
+    const __m256i kByteSwap = _mm256_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL,
+                                                0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m256i w[16];
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (size_t t = 0; t < 64; ++t) {
+        __m256i wt;
+        if (t < 16) {
+            wt = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base + 4 * t), index, 1);
+            wt = _mm256_shuffle_epi8(wt, kByteSwap);
+        } else {
+            __m256i w15 = w[(t - 15) % 16];
+            __m256i w2 = w[(t - 2) % 16];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(Rotr(w15, 7), Rotr(w15, 18)),
+                                          _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(Rotr(w2, 17), Rotr(w2, 19)),
+                                          _mm256_srli_epi32(w2, 10));
+            wt = _mm256_add_epi32(_mm256_add_epi32(w[t % 16], s0),
+                                  _mm256_add_epi32(w[(t - 7) % 16], s1));
+        }
+        w[t % 16] = wt;
+
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(Rotr(e, 6), Rotr(e, 11)), Rotr(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, s1), _mm256_add_epi32(ch, wt));
+        t1 = _mm256_add_epi32(t1, _mm256_set1_epi32(static_cast<int>(kRoundConstants[t])));
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(Rotr(a, 2), Rotr(a, 13)), Rotr(a, 22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b),
+                                      _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        __m256i t2 = _mm256_add_epi32(s0, maj);
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+    s[0] = _mm256_add_epi32(s[0], a);
+    s[1] = _mm256_add_epi32(s[1], b);
+    s[2] = _mm256_add_epi32(s[2], c);
+    s[3] = _mm256_add_epi32(s[3], d);
+    s[4] = _mm256_add_epi32(s[4], e);
+    s[5] = _mm256_add_epi32(s[5], f);
+    s[6] = _mm256_add_epi32(s[6], g);
+    s[7] = _mm256_add_epi32(s[7], h);
+}
+
+AVX2_TARGET void Avx2Nodes(const uint8_t* data, uint64_t offset, uint64_t level, uint8_t* out) {
+    __m256i s[8];
+    for (size_t i = 0; i < 8; ++i) {
+        s[i] = _mm256_set1_epi32(static_cast<int>(kInitialState[i]));
+    }
+
+    // The first and last blocks of each node are composed side by side; the
+    // middle blocks are read in place, a node apart.
+    __ALIGNED(32) uint8_t edge[kAvx2Lanes][kBlockSize];
+    const __m256i edge_index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i edge_stride = _mm256_set1_epi32(kBlockSize);
+    const __m256i node_stride = _mm256_set1_epi32(kNodeSize);
+    for (size_t n = 0; n < kAvx2Lanes; ++n) {
+        FirstBlock(data + n * kNodeSize, (offset + n * kNodeSize) | level, edge[n]);
+    }
+    Avx2Compress(s, edge[0], _mm256_mullo_epi32(edge_index, edge_stride));
+    for (size_t i = 1; i < kNumBlocks - 1; ++i) {
+        Avx2Compress(s, MiddleBlock(data, i), _mm256_mullo_epi32(edge_index, node_stride));
+    }
+    for (size_t n = 0; n < kAvx2Lanes; ++n) {
+        LastBlock(data + n * kNodeSize, edge[n]);
+    }
+    Avx2Compress(s, edge[0], _mm256_mullo_epi32(edge_index, edge_stride));
+
+    __ALIGNED(32) uint32_t words[8][kAvx2Lanes];
+    for (size_t i = 0; i < 8; ++i) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(words[i]), s[i]);
+    }
+    for (size_t n = 0; n < kAvx2Lanes; ++n) {
+        uint8_t* digest = out + n * Digest::kLength;
+        for (size_t i = 0; i < 8; ++i) {
+            uint32_t word = __builtin_bswap32(words[i][n]);
+            memcpy(digest + 4 * i, &word, sizeof(word));
+        }
+    }
+}
+
+void HashNodesAvx2(const uint8_t* data, uint64_t offset, uint64_t level, size_t count,
+                   uint8_t* out) {
+    for (; count >= kAvx2Lanes; count -= kAvx2Lanes) {
+        Avx2Nodes(data, offset, level, out);
+        data += kAvx2Lanes * kNodeSize;
+        offset += kAvx2Lanes * kNodeSize;
+        out += kAvx2Lanes * Digest::kLength;
+    }
+    HashNodesPortable(data, offset, level, count, out);
+}
+
+bool HasShaNi() {
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, nullptr) < 7) {
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & (1u << 29)) != 0;
+}
+
+bool HasAvx2() {
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, nullptr) < 7) {
+        return false;
+    }
+    // The OS must save the YMM registers.
+    __cpuid(1, eax, ebx, ecx, edx);
+    if ((ecx & bit_OSXSAVE) == 0) {
+        return false;
+    }
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & (1u << 5)) != 0;
+}
+
+#elif defined(NODE_HASH_ARM64_SHA2)
+
+////////
+// ARMv8 SHA2 extensions.  As on x86, two nodes are interleaved to hide the
+// latency of the round instructions.
+
+constexpr size_t kSha2Lanes = 2;
+
+template <size_t N>
+inline void Sha2Compress(uint32x4_t* abcd, uint32x4_t* efgh, const uint8_t* const* blocks) {
+    uint32x4_t abcd_save[N], efgh_save[N], w[N][4];
+    for (size_t n = 0; n < N; ++n) {
+        abcd_save[n] = abcd[n];
+        efgh_save[n] = efgh[n];
+        for (size_t j = 0; j < 4; ++j) {
+            w[n][j] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks[n] + 16 * j)));
+        }
+    }
+    for (size_t r = 0; r < 16; ++r) {
+        uint32x4_t k = vld1q_u32(&kRoundConstants[4 * r]);
+        for (size_t n = 0; n < N; ++n) {
+            uint32x4_t* m = w[n];
+            if (r >= 4) {
+                m[r % 4] = vsha256su1q_u32(vsha256su0q_u32(m[r % 4], m[(r + 1) % 4]),
+                                           m[(r + 2) % 4], m[(r + 3) % 4]);
+            }
+            uint32x4_t msg = vaddq_u32(m[r % 4], k);
+            uint32x4_t prev = abcd[n];
+            abcd[n] = vsha256hq_u32(abcd[n], efgh[n], msg);
+            efgh[n] = vsha256h2q_u32(efgh[n], prev, msg);
+        }
+    }
+    for (size_t n = 0; n < N; ++n) {
+        abcd[n] = vaddq_u32(abcd[n], abcd_save[n]);
+        efgh[n] = vaddq_u32(efgh[n], efgh_save[n]);
+    }
+}
+
+template <size_t N>
+void Sha2Nodes(const uint8_t* data, uint64_t offset, uint64_t level, uint8_t* out) {
+    uint32x4_t abcd[N], efgh[N];
+    for (size_t n = 0; n < N; ++n) {
+        abcd[n] = vld1q_u32(&kInitialState[0]);
+        efgh[n] = vld1q_u32(&kInitialState[4]);
+    }
+
+    uint8_t first[N][kBlockSize];
+    uint8_t last[N][kBlockSize];
+    const uint8_t* blocks[N];
+    for (size_t n = 0; n < N; ++n) {
+        FirstBlock(data + n * kNodeSize, (offset + n * kNodeSize) | level, first[n]);
+        LastBlock(data + n * kNodeSize, last[n]);
+        blocks[n] = first[n];
+    }
+    Sha2Compress<N>(abcd, efgh, blocks);
+    for (size_t i = 1; i < kNumBlocks - 1; ++i) {
+        for (size_t n = 0; n < N; ++n) {
+            blocks[n] = MiddleBlock(data + n * kNodeSize, i);
+        }
+        Sha2Compress<N>(abcd, efgh, blocks);
+    }
+    for (size_t n = 0; n < N; ++n) {
+        blocks[n] = last[n];
+    }
+    Sha2Compress<N>(abcd, efgh, blocks);
+
+    for (size_t n = 0; n < N; ++n) {
+        uint8_t* digest = out + n * Digest::kLength;
+        vst1q_u8(digest, vrev32q_u8(vreinterpretq_u8_u32(abcd[n])));
+        vst1q_u8(digest + 16, vrev32q_u8(vreinterpretq_u8_u32(efgh[n])));
+    }
+}
+
+void HashNodesSha2(const uint8_t* data, uint64_t offset, uint64_t level, size_t count,
+                   uint8_t* out) {
+    for (; count >= kSha2Lanes; count -= kSha2Lanes) {
+        Sha2Nodes<kSha2Lanes>(data, offset, level, out);
+        data += kSha2Lanes * kNodeSize;
+        offset += kSha2Lanes * kNodeSize;
+        out += kSha2Lanes * Digest::kLength;
+    }
+    if (count != 0) {
+        Sha2Nodes<1>(data, offset, level, out);
+    }
+}
+
+bool HasSha2() {
+#ifdef __Fuchsia__
+    uint32_t features;
+    return zx_system_get_features(ZX_FEATURE_KIND_CPU, &features) == ZX_OK &&
+           (features & ZX_ARM64_FEATURE_ISA_SHA2) != 0;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#endif
+}
+
+#endif
+
+using HashNodesFn = void (*)(const uint8_t* data, uint64_t offset, uint64_t level,
+                             size_t count, uint8_t* out);
+
+HashNodesFn SelectHashNodes() {
+    HashNodesImpl impls[kMaxHashNodesImpls];
+    return impls[GetHashNodesImpls(impls) - 1].fn;
+}
+
+} // namespace
+
+void HashNodes(const uint8_t* data, uint64_t offset, uint64_t level, size_t count,
+               uint8_t* out) {
+    // Racing threads select the same implementation, so it doesn't matter
+    // which one stores it.
+    static fbl::atomic<HashNodesFn> hash_nodes(nullptr);
+    HashNodesFn fn = hash_nodes.load(fbl::memory_order_relaxed);
+    if (fn == nullptr) {
+        fn = SelectHashNodes();
+        hash_nodes.store(fn, fbl::memory_order_relaxed);
+    }
+    fn(data, offset, level, count, out);
+}
+
+size_t GetHashNodesImpls(HashNodesImpl* out) {
+    // Ordered from slowest to fastest.
+    size_t count = 0;
+    out[count++] = {"portable", HashNodesPortable};
+#if defined(__x86_64__)
+    if (HasAvx2()) {
+        out[count++] = {"avx2", HashNodesAvx2};
+    }
+    if (HasShaNi()) {
+        out[count++] = {"sha-ni", HashNodesShaNi};
+    }
+#elif defined(NODE_HASH_ARM64_SHA2)
+    if (HasSha2()) {
+        out[count++] = {"sha2", HashNodesSha2};
+    }
+#endif
+    return count;
+}
+
+} // namespace internal
+} // namespace digest
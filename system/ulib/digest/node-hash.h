@@ -0,0 +1,41 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace digest {
+namespace internal {
+
+// Writes the digests of |count| consecutive full nodes of level |level| of a
+// Merkle tree to |out|, |Digest::kLength| bytes each.  The nodes start at
+// |data|, and the first of them is at |offset| in its level.  Each digest is
+//    Hash((offset | level) + kNodeSize + node_data)
+// as MerkleTree hashes nodes.
+//
+// Since every full node is hashed the same way, the nodes are hashed
+// several at a time in the lanes of the CPU's SIMD or SHA extensions, where
+// it has them.
+void HashNodes(const uint8_t* data, uint64_t offset, uint64_t level, size_t count,
+               uint8_t* out);
+
+// An implementation of HashNodes, for tests.
+struct HashNodesImpl {
+    const char* name;
+    void (*fn)(const uint8_t* data, uint64_t offset, uint64_t level, size_t count,
+               uint8_t* out);
+};
+
+constexpr size_t kMaxHashNodesImpls = 3;
+
+// Writes the implementations of HashNodes which the CPU can run to |out|,
+// which has room for kMaxHashNodesImpls of them, and returns how many there
+// are.  The first is the portable one, which the others must match, and the
+// last is the one HashNodes uses.
+size_t GetHashNodesImpls(HashNodesImpl* out);
+
+} // namespace internal
+} // namespace digest
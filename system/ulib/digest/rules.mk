@@ -10,7 +10,8 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/digest.cpp \
-    $(LOCAL_DIR)/merkle-tree.cpp
+    $(LOCAL_DIR)/merkle-tree.cpp \
+    $(LOCAL_DIR)/node-hash.cpp
 
 MODULE_SO_NAME := digest
 MODULE_LIBS := system/ulib/c
@@ -22,6 +23,12 @@ MODULE_STATIC_LIBS := \
 
 include make/module.mk
 
+# Only node-hash.cpp uses the SHA2 instructions, and only if the CPU reports
+# them, so the rest of the library must not be built to assume them.
+ifeq ($(ARCH),arm64)
+$(BUILDDIR)/$(LOCAL_DIR)/$(LOCAL_DIR)/node-hash.cpp.o: MODULE_COMPILEFLAGS += -march=armv8-a+crypto
+endif
+
 
 MODULE := $(LOCAL_DIR).hostlib
 
@@ -33,7 +40,8 @@ MODULE_COMPILEFLAGS := \
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/digest.cpp \
-    $(LOCAL_DIR)/merkle-tree.cpp
+    $(LOCAL_DIR)/merkle-tree.cpp \
+    $(LOCAL_DIR)/node-hash.cpp
 
 MODULE_HOST_LIBS := \
     third_party/ulib/uboringssl.hostlib \
@@ -24,15 +24,20 @@ blk_t BitmapBlocksForSize(size_t size) {
 AllocatorPromise::~AllocatorPromise() {
     if (reserved_ > 0) {
         ZX_DEBUG_ASSERT(allocator_ != nullptr);
-        allocator_->Unreserve(reserved_);
+        allocator_->Unreserve(reserved_, next_, run_end_);
     }
 }
 
-size_t AllocatorPromise::Allocate(WriteTxn* txn) {
+size_t AllocatorPromise::Allocate(WriteTxn* txn, size_t goal) {
     ZX_DEBUG_ASSERT(allocator_ != nullptr);
     ZX_DEBUG_ASSERT(reserved_ > 0);
     reserved_--;
-    return allocator_->Allocate(txn);
+    if (goal != 0 && allocator_->IsFree(goal)) {
+        return allocator_->Allocate(txn, goal);
+    }
+    size_t index = allocator_->Allocate(txn, next_);
+    next_ = index + 1;
+    return index;
 }
 
 AllocatorFvmMetadata::AllocatorFvmMetadata() = default;
@@ -121,21 +126,40 @@ zx_status_t Allocator::Reserve(WriteTxn* txn, size_t count,
         ZX_DEBUG_ASSERT(GetAvailable() >= count);
     }
 
+    // Look for a run of |count| free elements, first-fit from the hint. If
+    // the pool is too fragmented, the promise allocates the first free
+    // elements after the hint instead.
+    size_t run_start = hint_;
+    if (count > 1 && hint_ < map_.size() &&
+        (map_.Find(false, hint_, map_.size(), count, &run_start) == ZX_OK ||
+         (hint_ > 0 && map_.Find(false, 0, hint_, count, &run_start) == ZX_OK))) {
+        // Later reservations start after this run, so that concurrent
+        // transactions do not interleave their elements.
+        hint_ = run_start + count;
+    }
+
     reserved_ += count;
-    (*out_promise).reset(new AllocatorPromise(this, count));
+    (*out_promise).reset(new AllocatorPromise(this, count, run_start));
     return ZX_OK;
 }
 
-void Allocator::Unreserve(size_t count) {
+void Allocator::Unreserve(size_t count, size_t next, size_t run_end) {
     ZX_DEBUG_ASSERT(reserved_ >= count);
     reserved_ -= count;
+
+    // Give back the unused tail of the run, unless another reservation has
+    // been placed after it already.
+    if (hint_ == run_end && next < run_end) {
+        hint_ = next;
+    }
 }
 
-size_t Allocator::Allocate(WriteTxn* txn) {
+size_t Allocator::Allocate(WriteTxn* txn, size_t start) {
     ZX_DEBUG_ASSERT(reserved_ > 0);
     size_t bitoff_start;
-    if (map_.Find(false, hint_, map_.size(), 1, &bitoff_start) != ZX_OK) {
-        ZX_ASSERT(map_.Find(false, 0, hint_, 1, &bitoff_start) == ZX_OK);
+    if (start >= map_.size() ||
+        map_.Find(false, start, map_.size(), 1, &bitoff_start) != ZX_OK) {
+        ZX_ASSERT(map_.Find(false, 0, map_.size(), 1, &bitoff_start) == ZX_OK);
     }
 
     ZX_ASSERT(map_.Set(bitoff_start, bitoff_start + 1) == ZX_OK);
@@ -144,7 +168,9 @@ size_t Allocator::Allocate(WriteTxn* txn) {
     metadata_.PoolAllocate(1);
     reserved_ -= 1;
     sb_->Write(txn);
-    hint_ = bitoff_start + 1;
+    if (bitoff_start >= hint_) {
+        hint_ = bitoff_start + 1;
+    }
     return bitoff_start;
 }
 
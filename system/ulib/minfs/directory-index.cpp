@@ -0,0 +1,164 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <lib/zircon-internal/fnv1hash.h>
+#include <zircon/assert.h>
+
+#include <minfs/directory-index.h>
+
+namespace minfs {
+namespace {
+
+// The initial number of slots of the hash table; must be a power of two.
+constexpr size_t kInitialSlots = 64;
+
+} // namespace
+
+DirectoryIndex::DirectoryIndex() = default;
+DirectoryIndex::~DirectoryIndex() = default;
+
+uint32_t DirectoryIndex::Hash(fbl::StringPiece name) {
+    return fnv1a32(name.data(), name.length());
+}
+
+zx_status_t DirectoryIndex::AddEntry(fbl::StringPiece name, size_t off) {
+    ZX_DEBUG_ASSERT(off < kMinfsMaxDirectorySize);
+    // Keep the table at most half full, counting removed slots, so that
+    // probe sequences stay short.
+    if ((entry_count_ + removed_count_ + 1) * 2 > slots_.size()) {
+        zx_status_t status = Grow();
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
+    const uint32_t hash = Hash(name);
+    const size_t mask = slots_.size() - 1;
+    for (size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+        Slot& slot = slots_[pos];
+        if (slot.off == kSlotFree || slot.off == kSlotRemoved) {
+            if (slot.off == kSlotRemoved) {
+                removed_count_--;
+            }
+            slot.hash = hash;
+            slot.off = static_cast<uint32_t>(off);
+            entry_count_++;
+            return ZX_OK;
+        }
+    }
+}
+
+void DirectoryIndex::RemoveEntry(fbl::StringPiece name, size_t off) {
+    const uint32_t hash = Hash(name);
+    size_t cursor = 0;
+    size_t candidate;
+    while (FindEntry(hash, &cursor, &candidate)) {
+        if (candidate == off) {
+            // |cursor| is one past the slot which held the candidate.
+            Slot& slot = slots_[(hash + cursor - 1) & (slots_.size() - 1)];
+            slot.off = kSlotRemoved;
+            entry_count_--;
+            removed_count_++;
+            return;
+        }
+    }
+    ZX_DEBUG_ASSERT_MSG(false, "Removing unindexed direntry at %zu\n", off);
+}
+
+bool DirectoryIndex::FindEntry(uint32_t hash, size_t* cursor, size_t* out_off) const {
+    const size_t mask = slots_.size() - 1;
+    while (*cursor < slots_.size()) {
+        const Slot& slot = slots_[(hash + *cursor) & mask];
+        (*cursor)++;
+        if (slot.off == kSlotFree) {
+            return false;
+        } else if (slot.off != kSlotRemoved && slot.hash == hash) {
+            *out_off = slot.off;
+            return true;
+        }
+    }
+    return false;
+}
+
+zx_status_t DirectoryIndex::Grow() {
+    size_t capacity = fbl::max(slots_.size(), kInitialSlots);
+    while ((entry_count_ + 1) * 4 > capacity) {
+        capacity *= 2;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::Array<Slot> slots(new (&ac) Slot[capacity], capacity);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i].off = kSlotFree;
+    }
+
+    const size_t mask = capacity - 1;
+    for (size_t i = 0; i < slots_.size(); i++) {
+        const Slot& slot = slots_[i];
+        if (slot.off == kSlotFree || slot.off == kSlotRemoved) {
+            continue;
+        }
+        size_t pos = slot.hash & mask;
+        while (slots[pos].off != kSlotFree) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = slot;
+    }
+    slots_ = fbl::move(slots);
+    removed_count_ = 0;
+    return ZX_OK;
+}
+
+size_t DirectoryIndex::LowerBound(size_t off) const {
+    size_t lo = 0;
+    size_t hi = space_.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (space_[mid] < off) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+zx_status_t DirectoryIndex::AddSpace(size_t off) {
+    ZX_DEBUG_ASSERT(off < kMinfsMaxDirectorySize);
+    size_t i = LowerBound(off);
+    if (i < space_.size() && space_[i] == off) {
+        return ZX_OK;
+    }
+    fbl::AllocChecker ac;
+    space_.insert(i, static_cast<uint32_t>(off), &ac);
+    return ac.check() ? ZX_OK : ZX_ERR_NO_MEMORY;
+}
+
+void DirectoryIndex::RemoveSpace(size_t off) {
+    size_t i = LowerBound(off);
+    if (i < space_.size() && space_[i] == off) {
+        space_.erase(i);
+    }
+}
+
+bool DirectoryIndex::HasSpace(size_t off) const {
+    size_t i = LowerBound(off);
+    return i < space_.size() && space_[i] == off;
+}
+
+bool DirectoryIndex::FindSpaceBefore(size_t off, size_t* out_off) const {
+    size_t i = LowerBound(off);
+    if (i == 0) {
+        return false;
+    }
+    *out_off = space_[i - 1];
+    return true;
+}
+
+} // namespace minfs
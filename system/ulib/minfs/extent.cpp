@@ -0,0 +1,419 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Maps the blocks of inodes with kMinfsInodeFlagExtents through their extent tree.
+//
+// The nodes of the tree which have been read are cached by the vnode in numbered
+// slots: on Fuchsia, slot i is block i of the indirect VMO (which an extent mapped
+// vnode has no other use for), so that nodes can be written back from it.
+
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fs/block-txn.h>
+
+#include "minfs-private.h"
+
+namespace minfs {
+namespace {
+
+// The slot which designates the root of the tree, within the inode.
+constexpr uint32_t kExtentRootSlot = UINT32_MAX;
+
+// Returns the index of the last entry of |header| which starts at or before |n|,
+// or -1 if there is none.
+int FindExtent(const ExtentHeader* header, blk_t n) {
+    const Extent* extents = GetExtents(header);
+    int lo = 0;
+    int hi = header->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (extents[mid].file_block <= n) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo - 1;
+}
+
+// Inserts |extent| before entry |index| of a node which is not full.
+void InsertExtent(ExtentHeader* header, int index, const Extent& extent) {
+    ZX_DEBUG_ASSERT(header->count < header->max);
+    Extent* extents = GetExtents(header);
+    memmove(&extents[index + 1], &extents[index], (header->count - index) * sizeof(Extent));
+    extents[index] = extent;
+    header->count++;
+}
+
+// Index nodes are never empty: nodes are freed when their last entry is removed.
+bool IsValidNode(const ExtentHeader* header, uint16_t max, uint16_t depth) {
+    return header->magic == kMinfsExtentMagic && header->max == max &&
+           header->count <= max && header->depth == depth &&
+           (depth == 0 || header->count > 0);
+}
+
+} // namespace
+
+void InitExtentRoot(Inode* inode) {
+    inode->flags |= kMinfsInodeFlagExtents;
+    memset(inode->dnum, 0, sizeof(blk_t) * (kMinfsDirect + kMinfsIndirect + kMinfsDoublyIndirect));
+    ExtentHeader* root = GetExtentRoot(inode);
+    root->magic = kMinfsExtentMagic;
+    root->max = kMinfsExtentsPerRoot;
+}
+
+ExtentHeader* VnodeMinfs::GetExtentNode(uint32_t slot) {
+    if (slot == kExtentRootSlot) {
+        return GetExtentRoot(&inode_);
+    }
+    ZX_DEBUG_ASSERT(slot < extent_nodes_.size() && extent_nodes_[slot] != 0);
+#ifdef __Fuchsia__
+    uintptr_t addr = reinterpret_cast<uintptr_t>(vmo_indirect_->start());
+    return GetExtentHeader(reinterpret_cast<void*>(addr + kMinfsBlockSize * slot));
+#else
+    return GetExtentHeader(extent_blocks_[slot].get());
+#endif
+}
+
+zx_status_t VnodeMinfs::ExtentSlotNew(blk_t bno, uint32_t* out_slot) {
+    uint32_t slot = 0;
+    while (slot < extent_nodes_.size() && extent_nodes_[slot] != 0) {
+        slot++;
+    }
+
+    fbl::AllocChecker ac;
+#ifdef __Fuchsia__
+    zx_status_t status;
+    if (vmo_indirect_ == nullptr) {
+        vmo_indirect_ = fzl::ResizeableVmoMapper::Create(kMinfsBlockSize, "minfs-extents");
+        if (vmo_indirect_ == nullptr) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        if ((status = fs_->bc_->AttachVmo(vmo_indirect_->vmo().get(), &vmoid_indirect_)) != ZX_OK) {
+            vmo_indirect_ = nullptr;
+            return status;
+        }
+    }
+    // Growing the VMO may move its mapping, which invalidates the nodes returned by
+    // GetExtentNode().
+    if (vmo_indirect_->size() < (slot + 1) * kMinfsBlockSize) {
+        if ((status = vmo_indirect_->Grow(vmo_indirect_->size() * 2)) != ZX_OK) {
+            return status;
+        }
+    }
+#else
+    if (slot == extent_blocks_.size()) {
+        fbl::unique_ptr<uint8_t[]> block(new (&ac) uint8_t[kMinfsBlockSize]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        extent_blocks_.push_back(fbl::move(block), &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+#endif
+    if (slot == extent_nodes_.size()) {
+        extent_nodes_.push_back(bno, &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+    } else {
+        extent_nodes_[slot] = bno;
+    }
+    *out_slot = slot;
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::ExtentNodeLoad(blk_t bno, uint16_t depth, uint32_t* out_slot) {
+    for (uint32_t slot = 0; slot < extent_nodes_.size(); slot++) {
+        if (extent_nodes_[slot] == bno) {
+            *out_slot = slot;
+            return ZX_OK;
+        }
+    }
+
+    if (bno == 0 || bno >= fs_->Info().block_count) {
+        FS_TRACE_ERROR("minfs: ino#%u: extent node @%u out of range\n", ino_, bno);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    uint32_t slot;
+    zx_status_t status;
+    if ((status = ExtentSlotNew(bno, &slot)) != ZX_OK) {
+        return status;
+    }
+#ifdef __Fuchsia__
+    fs::ReadTxn txn(fs_->bc_.get());
+    txn.Enqueue(vmoid_indirect_, slot, bno + fs_->Info().dat_block, 1);
+    status = txn.Transact();
+#else
+    status = fs_->ReadDat(bno, extent_blocks_[slot].get());
+#endif
+    if (status == ZX_OK && !IsValidNode(GetExtentNode(slot), kMinfsExtentsPerNode, depth)) {
+        FS_TRACE_ERROR("minfs: ino#%u: bad extent node @%u\n", ino_, bno);
+        status = ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    if (status != ZX_OK) {
+        extent_nodes_[slot] = 0;
+        return status;
+    }
+    *out_slot = slot;
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::ExtentNodeNew(Transaction* state, uint16_t depth, uint32_t* out_slot) {
+    blk_t bno;
+    fs_->BlockNew(state, 0, &bno);
+    inode_.block_count++;
+    zx_status_t status;
+    if ((status = ExtentSlotNew(bno, out_slot)) != ZX_OK) {
+        fs_->BlockFree(state->GetWork(), bno);
+        inode_.block_count--;
+        return status;
+    }
+    ExtentHeader* header = GetExtentNode(*out_slot);
+    memset(header, 0, kMinfsBlockSize);
+    header->magic = kMinfsExtentMagic;
+    header->depth = depth;
+    header->max = kMinfsExtentsPerNode;
+    return ZX_OK;
+}
+
+void VnodeMinfs::ExtentNodeWrite(WritebackWork* wb, uint32_t slot) {
+    if (slot == kExtentRootSlot) {
+        // The root is written with the inode.
+        return;
+    }
+    blk_t bno = extent_nodes_[slot];
+    fs_->ValidateBno(bno);
+#ifdef __Fuchsia__
+    wb->Enqueue(vmo_indirect_->vmo().get(), slot, bno + fs_->Info().dat_block, 1);
+#else
+    fs_->bc_->Writeblk(bno + fs_->Info().dat_block, GetExtentNode(slot));
+#endif
+}
+
+void VnodeMinfs::ExtentNodeFree(WritebackWork* wb, uint32_t slot) {
+    ZX_DEBUG_ASSERT(slot != kExtentRootSlot);
+    fs_->BlockFree(wb, extent_nodes_[slot]);
+    inode_.block_count--;
+    extent_nodes_[slot] = 0;
+}
+
+zx_status_t VnodeMinfs::ExtentFindLeaf(blk_t n, uint32_t* out_slot) {
+    const ExtentHeader* root = GetExtentRoot(&inode_);
+    if (!IsValidNode(root, kMinfsExtentsPerRoot, root->depth) ||
+        root->depth > kMinfsExtentMaxDepth) {
+        FS_TRACE_ERROR("minfs: ino#%u: bad extent root\n", ino_);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    uint32_t slot = kExtentRootSlot;
+    for (const ExtentHeader* header = root; header->depth > 0; header = GetExtentNode(slot)) {
+        int index = fbl::max(FindExtent(header, n), 0);
+        zx_status_t status;
+        uint16_t depth = static_cast<uint16_t>(header->depth - 1);
+        if ((status = ExtentNodeLoad(GetExtents(header)[index].start, depth, &slot)) != ZX_OK) {
+            return status;
+        }
+    }
+    *out_slot = slot;
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::ExtentInsert(Transaction* state, const Extent& extent) {
+    zx_status_t status;
+    ExtentHeader* root = GetExtentRoot(&inode_);
+    if (root->count == root->max) {
+        // Move the entries of the root into a new node, which becomes its only child.
+        uint32_t child;
+        if ((status = ExtentNodeNew(state, root->depth, &child)) != ZX_OK) {
+            return status;
+        }
+        root = GetExtentRoot(&inode_);
+        ExtentHeader* header = GetExtentNode(child);
+        memcpy(GetExtents(header), GetExtents(root), root->count * sizeof(Extent));
+        header->count = root->count;
+        root->depth++;
+        root->count = 1;
+        GetExtents(root)[0] = { GetExtents(header)[0].file_block, extent_nodes_[child], 0 };
+        ExtentNodeWrite(state->GetWork(), child);
+    }
+
+    // Descend to the leaf which should hold |extent|, splitting full nodes on the way
+    // so that there is always room for a new entry in the parent.
+    uint32_t slot = kExtentRootSlot;
+    while (GetExtentNode(slot)->depth > 0) {
+        ExtentHeader* header = GetExtentNode(slot);
+        int index = FindExtent(header, extent.file_block);
+        if (index < 0) {
+            index = 0;
+            GetExtents(header)[0].file_block = extent.file_block;
+            ExtentNodeWrite(state->GetWork(), slot);
+        }
+        uint32_t child;
+        uint16_t depth = static_cast<uint16_t>(header->depth - 1);
+        if ((status = ExtentNodeLoad(GetExtents(header)[index].start, depth, &child)) != ZX_OK) {
+            return status;
+        }
+        if (GetExtentNode(child)->count == kMinfsExtentsPerNode) {
+            uint32_t sibling;
+            if ((status = ExtentNodeNew(state, depth, &sibling)) != ZX_OK) {
+                return status;
+            }
+            header = GetExtentNode(slot);
+            ExtentHeader* left = GetExtentNode(child);
+            ExtentHeader* right = GetExtentNode(sibling);
+            uint16_t half = left->count / 2;
+            right->count = static_cast<uint16_t>(left->count - half);
+            memcpy(GetExtents(right), &GetExtents(left)[half], right->count * sizeof(Extent));
+            left->count = half;
+            const Extent entry = { GetExtents(right)[0].file_block, extent_nodes_[sibling], 0 };
+            InsertExtent(header, index + 1, entry);
+            ExtentNodeWrite(state->GetWork(), slot);
+            ExtentNodeWrite(state->GetWork(), child);
+            ExtentNodeWrite(state->GetWork(), sibling);
+            if (extent.file_block >= entry.file_block) {
+                child = sibling;
+            }
+        }
+        slot = child;
+    }
+
+    ExtentHeader* leaf = GetExtentNode(slot);
+    InsertExtent(leaf, FindExtent(leaf, extent.file_block) + 1, extent);
+    ExtentNodeWrite(state->GetWork(), slot);
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::ExtentBlockGet(Transaction* state, blk_t n, blk_t* bno) {
+    if (n >= extent_cache_.file_block && n - extent_cache_.file_block < extent_cache_.length) {
+        *bno = extent_cache_.start + (n - extent_cache_.file_block);
+        return ZX_OK;
+    }
+
+    zx_status_t status;
+    uint32_t slot;
+    if ((status = ExtentFindLeaf(n, &slot)) != ZX_OK) {
+        return status;
+    }
+    ExtentHeader* leaf = GetExtentNode(slot);
+    int index = FindExtent(leaf, n);
+    if (index >= 0) {
+        const Extent& extent = GetExtents(leaf)[index];
+        if (n - extent.file_block < extent.length) {
+            fs_->ValidateBno(extent.start);
+            extent_cache_ = extent;
+            *bno = extent.start + (n - extent.file_block);
+            return ZX_OK;
+        }
+    }
+    if (state == nullptr) {
+        *bno = 0;
+        return ZX_OK;
+    }
+
+    // Prefer the block following the extent which ends at |n|, so that the extent can
+    // be lengthened rather than adding a new one.
+    Extent* prev = nullptr;
+    if (index >= 0 && GetExtents(leaf)[index].file_block + GetExtents(leaf)[index].length == n) {
+        prev = &GetExtents(leaf)[index];
+    }
+    const ExtentHeader* root = GetExtentRoot(&inode_);
+    if (prev == nullptr && root->count == root->max && root->depth == kMinfsExtentMaxDepth) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    fs_->BlockNew(state, prev ? prev->start + prev->length : alloc_goal_, bno);
+    alloc_goal_ = *bno + 1;
+    inode_.block_count++;
+    fs_->ValidateBno(*bno);
+
+    if (prev != nullptr && *bno == prev->start + prev->length) {
+        prev->length++;
+        extent_cache_ = *prev;
+        ExtentNodeWrite(state->GetWork(), slot);
+    } else {
+        const Extent extent = { n, *bno, 1 };
+        if ((status = ExtentInsert(state, extent)) != ZX_OK) {
+            fs_->BlockFree(state->GetWork(), *bno);
+            inode_.block_count--;
+            return status;
+        }
+        extent_cache_ = extent;
+    }
+    InodeSync(state->GetWork(), kMxFsSyncDefault);
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::ExtentShrinkNode(WritebackWork* wb, uint32_t slot, blk_t start) {
+    bool dirty = false;
+    zx_status_t status;
+    while (GetExtentNode(slot)->count > 0) {
+        ExtentHeader* header = GetExtentNode(slot);
+        Extent* last = &GetExtents(header)[header->count - 1];
+        if (header->depth == 0) {
+            // Free the blocks of the last extent which are at or after |start|.
+            blk_t keep = last->file_block < start ? fbl::min(start - last->file_block,
+                                                             last->length) : 0;
+            for (blk_t i = keep; i < last->length; i++) {
+                fs_->ValidateBno(last->start + i);
+                fs_->BlockFree(wb, last->start + i);
+                inode_.block_count--;
+            }
+            dirty |= keep < last->length;
+            last->length = keep;
+            if (keep > 0) {
+                break;
+            }
+            header->count--;
+            continue;
+        }
+
+        const blk_t file_block = last->file_block;
+        uint32_t child;
+        uint16_t depth = static_cast<uint16_t>(header->depth - 1);
+        if ((status = ExtentNodeLoad(last->start, depth, &child)) != ZX_OK) {
+            return status;
+        }
+        if ((status = ExtentShrinkNode(wb, child, start)) != ZX_OK) {
+            return status;
+        }
+        header = GetExtentNode(slot);
+        if (GetExtentNode(child)->count == 0) {
+            ExtentNodeFree(wb, child);
+            header->count--;
+            dirty = true;
+        }
+        if (file_block < start) {
+            break;
+        }
+    }
+    if (dirty && slot != kExtentRootSlot && GetExtentNode(slot)->count > 0) {
+        ExtentNodeWrite(wb, slot);
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::ExtentBlocksShrink(WritebackWork* wb, blk_t start) {
+    const ExtentHeader* root = GetExtentRoot(&inode_);
+    if (!IsValidNode(root, kMinfsExtentsPerRoot, root->depth) ||
+        root->depth > kMinfsExtentMaxDepth) {
+        FS_TRACE_ERROR("minfs: ino#%u: bad extent root\n", ino_);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    extent_cache_ = {};
+    zx_status_t status;
+    if ((status = ExtentShrinkNode(wb, kExtentRootSlot, start)) != ZX_OK) {
+        return status;
+    }
+    if (GetExtentRoot(&inode_)->count == 0) {
+        GetExtentRoot(&inode_)->depth = 0;
+    }
+    return ZX_OK;
+}
+
+} // namespace minfs
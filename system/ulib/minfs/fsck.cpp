@@ -9,6 +9,7 @@
 
 #include <minfs/format.h>
 #include <minfs/fsck.h>
+#include <minfs/journal.h>
 #include "minfs-private.h"
 
 // #define DEBUG_PRINTF
@@ -25,6 +26,7 @@ public:
     MinfsChecker();
     zx_status_t Init(fbl::unique_ptr<Bcache> bc, const Superblock* info);
     void CheckReserved();
+    zx_status_t CheckJournal();
     zx_status_t CheckInode(ino_t ino, ino_t parent, bool dot_or_dotdot);
     zx_status_t CheckUnlinkedInodes();
     zx_status_t CheckForUnusedBlocks() const;
@@ -52,6 +54,13 @@ private:
                                ino_t parent, uint32_t flags);
     const char* CheckDataBlock(blk_t bno);
     zx_status_t CheckFile(Inode* inode, ino_t ino);
+    // Checks the extent tree of an extent mapped inode.
+    zx_status_t CheckExtents(Inode* inode, ino_t ino);
+    // Checks the node |header| of the extent tree of |ino|, which holds at most |max|
+    // entries, and the subtree below it. |next_blk| is the file block following the
+    // last extent checked so far, and |block_count| the number of blocks found so far.
+    zx_status_t CheckExtentNode(const ExtentHeader* header, ino_t ino, uint16_t max,
+                                blk_t* next_blk, uint32_t* block_count);
 
     fbl::unique_ptr<Minfs> fs_;
     RawBitmap checked_inodes_;
@@ -181,6 +190,10 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
         return status;
     }
 
+    // Large directories are looked up through an index built from their direntries. Validate
+    // that each direntry can be found through it, which also detects duplicate names.
+    const bool indexed = vn->UseDirectoryIndex();
+
     size_t off = 0;
     while (true) {
         uint32_t data[MINFS_DIRENT_SIZE];
@@ -209,6 +222,10 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
             if (flags & CD_DUMP) {
                 xprintf("ino#%u: de[%u]: <empty> reclen=%u\n", ino, eno, rlen);
             }
+            if (indexed && !vn->index_->HasSpace(off)) {
+                FS_TRACE_ERROR("check: ino#%u: de[%u]: free dirent missing from index\n", ino, eno);
+                return ZX_ERR_BAD_STATE;
+            }
         } else {
             // Re-read the dirent to acquire the full name
             uint32_t record_full[DirentSize(NAME_MAX)];
@@ -244,6 +261,19 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
                     FS_TRACE_ERROR("check: ino#%u: de[%u]: '..' ino=%u (not parent!)\n", ino, eno, de->ino);
                 }
             }
+            if (indexed) {
+                DirArgs args = DirArgs();
+                args.name = fbl::StringPiece(de->name, de->namelen);
+                if ((status = vn->LookupDirent(&args, VnodeMinfs::DirentCallbackFind)) != ZX_OK) {
+                    FS_TRACE_ERROR("check: ino#%u: de[%u]: '%.*s' missing from index: %d\n",
+                                   ino, eno, de->namelen, de->name, status);
+                    return ZX_ERR_BAD_STATE;
+                } else if (args.offs.off != off) {
+                    FS_TRACE_ERROR("check: ino#%u: de[%u]: duplicate name '%.*s'\n",
+                                   ino, eno, de->namelen, de->name);
+                    return ZX_ERR_IO_DATA_INTEGRITY;
+                }
+            }
             //TODO: check for cycles (non-dot/dotdot dir ref already in checked bitmap)
             if (flags & CD_DUMP) {
                 xprintf("ino#%u: de[%u]: ino=%u type=%u '%.*s' %s\n", ino, eno, de->ino, de->type,
@@ -295,7 +325,122 @@ const char* MinfsChecker::CheckDataBlock(blk_t bno) {
     return nullptr;
 }
 
+zx_status_t MinfsChecker::CheckExtentNode(const ExtentHeader* header, ino_t ino, uint16_t max,
+                                          blk_t* next_blk, uint32_t* block_count) {
+    if ((header->magic != kMinfsExtentMagic) || (header->max != max) ||
+        (header->count > max)) {
+        FS_TRACE_ERROR("check: ino#%u: bad extent node\n", ino);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    const Extent* extents = GetExtents(header);
+    for (unsigned n = 0; n < header->count; n++) {
+        const Extent& extent = extents[n];
+        if (extent.file_block < *next_blk) {
+            FS_TRACE_WARN("check: ino#%u: extent at block %u overlaps the previous one\n",
+                          ino, extent.file_block);
+            conforming_ = false;
+        }
+        const char* msg;
+        if (header->depth == 0) {
+            if ((extent.length == 0) || (extent.file_block >= kMinfsMaxFileBlock) ||
+                (extent.length > kMinfsMaxFileBlock - extent.file_block)) {
+                FS_TRACE_WARN("check: ino#%u: extent at block %u has bad length %u\n",
+                              ino, extent.file_block, extent.length);
+                conforming_ = false;
+                continue;
+            }
+            for (blk_t i = 0; i < extent.length; i++) {
+                if ((msg = CheckDataBlock(extent.start + i)) != nullptr) {
+                    FS_TRACE_WARN("check: ino#%u: block %u(@%u): %s\n",
+                                  ino, extent.file_block + i, extent.start + i, msg);
+                    conforming_ = false;
+                }
+            }
+            *block_count += extent.length;
+            *next_blk = extent.file_block + extent.length;
+            continue;
+        }
+
+        if ((extent.start == 0) || (extent.start >= fs_->Info().block_count)) {
+            FS_TRACE_ERROR("check: ino#%u: extent node (@%u) out of range\n", ino, extent.start);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        if ((msg = CheckDataBlock(extent.start)) != nullptr) {
+            FS_TRACE_WARN("check: ino#%u: extent node (@%u): %s\n", ino, extent.start, msg);
+            conforming_ = false;
+        }
+        (*block_count)++;
+
+        uint8_t data[kMinfsBlockSize];
+        zx_status_t status;
+        if ((status = fs_->ReadDat(extent.start, data)) != ZX_OK) {
+            return status;
+        }
+        const ExtentHeader* child = GetExtentHeader(data);
+        if (child->depth != header->depth - 1) {
+            FS_TRACE_ERROR("check: ino#%u: extent node (@%u) has depth %u, expected %u\n",
+                           ino, extent.start, child->depth, header->depth - 1);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        if (child->count == 0) {
+            FS_TRACE_WARN("check: ino#%u: extent node (@%u) is empty\n", ino, extent.start);
+            conforming_ = false;
+        } else if (GetExtents(child)[0].file_block < extent.file_block) {
+            FS_TRACE_WARN("check: ino#%u: extent node (@%u) starts before its key\n",
+                          ino, extent.start);
+            conforming_ = false;
+        }
+        if ((status = CheckExtentNode(child, ino, kMinfsExtentsPerNode, next_blk,
+                                      block_count)) != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t MinfsChecker::CheckExtents(Inode* inode, ino_t ino) {
+    if ((fs_->Info().flags & kMinfsFlagExtents) == 0) {
+        FS_TRACE_WARN("check: ino#%u: extent mapped on a volume without extents\n", ino);
+        conforming_ = false;
+    }
+    const ExtentHeader* root = GetExtentRoot(inode);
+    if (root->depth > kMinfsExtentMaxDepth) {
+        FS_TRACE_ERROR("check: ino#%u: extent tree too deep (%u)\n", ino, root->depth);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    blk_t next_blk = 0;
+    uint32_t block_count = 0;
+    zx_status_t status;
+    if ((status = CheckExtentNode(root, ino, kMinfsExtentsPerRoot, &next_blk,
+                                  &block_count)) != ZX_OK) {
+        return status;
+    }
+    if (next_blk) {
+        unsigned max_blocks = fbl::round_up(inode->size, kMinfsBlockSize) / kMinfsBlockSize;
+        if (next_blk > max_blocks) {
+            FS_TRACE_WARN("check: ino#%u: filesize too small\n", ino);
+            conforming_ = false;
+        }
+    }
+    if (block_count != inode->block_count) {
+        FS_TRACE_WARN("check: ino#%u: block count %u, actual blocks %u\n",
+             ino, inode->block_count, block_count);
+        conforming_ = false;
+    }
+    return ZX_OK;
+}
+
 zx_status_t MinfsChecker::CheckFile(Inode* inode, ino_t ino) {
+    if (inode->flags & ~kMinfsInodeFlagExtents) {
+        FS_TRACE_WARN("check: ino#%u: unknown flags %#x\n", ino, inode->flags);
+        conforming_ = false;
+    }
+    if (inode->flags & kMinfsInodeFlagExtents) {
+        return CheckExtents(inode, ino);
+    }
+
     xprintf("Direct blocks: \n");
     for (unsigned n = 0; n < kMinfsDirect; n++) {
         xprintf(" %d,", inode->dnum[n]);
@@ -415,6 +560,39 @@ void MinfsChecker::CheckReserved() {
     }
 }
 
+zx_status_t MinfsChecker::CheckJournal() {
+    const Superblock& info = fs_->Info();
+    if ((info.flags & kMinfsFlagJournal) == 0) {
+        return ZX_OK;
+    }
+
+    // The journal is allocated, but not referenced by any inode.
+    const blk_t start = info.journal_block;
+    const blk_t end = start + info.journal_block_count;
+    if (!fs_->block_allocator_->map_.Get(start, end)) {
+        FS_TRACE_WARN("check: journal blocks: not marked in-use\n");
+        conforming_ = false;
+    }
+    for (blk_t bno = start; bno < end; bno++) {
+        if (fs_->block_allocator_->map_.Get(bno, bno + 1)) {
+            checked_blocks_.Set(bno, bno + 1);
+            alloc_blocks_++;
+        }
+    }
+
+    uint8_t data[kMinfsBlockSize];
+    zx_status_t status;
+    if ((status = fs_->ReadDat(start, data)) != ZX_OK) {
+        FS_TRACE_ERROR("check: could not read journal info block\n");
+        return status;
+    }
+    if ((status = CheckJournalInfo(data)) != ZX_OK) {
+        FS_TRACE_ERROR("check: journal info block is corrupt\n");
+        return status;
+    }
+    return ZX_OK;
+}
+
 zx_status_t MinfsChecker::CheckInode(ino_t ino, ino_t parent, bool dot_or_dotdot) {
     Inode inode;
     zx_status_t status;
@@ -589,13 +767,23 @@ MinfsChecker::MinfsChecker()
     : conforming_(true), fs_(nullptr), alloc_inodes_(0), alloc_blocks_(0), links_() {};
 
 zx_status_t MinfsChecker::Init(fbl::unique_ptr<Bcache> bc, const Superblock* info) {
+    // Replaying the journal may update the superblock, so the filesystem is
+    // created first, and the rest is sized according to its superblock.
+    zx_status_t status;
+    fbl::unique_ptr<Minfs> fs;
+    if ((status = Minfs::Create(fbl::move(bc), info, &fs)) != ZX_OK) {
+        FS_TRACE_ERROR("MinfsChecker::Create Failed to Create Minfs: %d\n", status);
+        return status;
+    }
+    fs_ = fbl::move(fs);
+    info = &fs_->Info();
+
     links_.reset(new int32_t[info->inode_count]{0}, info->inode_count);
     links_[0] = -1;
 
     cached_doubly_indirect_ = 0;
     cached_indirect_ = 0;
 
-    zx_status_t status;
     if ((status = checked_inodes_.Reset(info->inode_count)) != ZX_OK) {
         FS_TRACE_ERROR("MinfsChecker::Init Failed to reset checked inodes: %d\n", status);
         return status;
@@ -604,12 +792,6 @@ zx_status_t MinfsChecker::Init(fbl::unique_ptr<Bcache> bc, const Superblock* inf
         FS_TRACE_ERROR("MinfsChecker::Init Failed to reset checked blocks: %d\n", status);
         return status;
     }
-    fbl::unique_ptr<Minfs> fs;
-    if ((status = Minfs::Create(fbl::move(bc), info, &fs)) != ZX_OK) {
-        FS_TRACE_ERROR("MinfsChecker::Create Failed to Create Minfs: %d\n", status);
-        return status;
-    }
-    fs_ = fbl::move(fs);
 
     return ZX_OK;
 }
@@ -637,6 +819,11 @@ zx_status_t Fsck(fbl::unique_ptr<Bcache> bc) {
 
     chk.CheckReserved();
 
+    if ((status = chk.CheckJournal()) != ZX_OK) {
+        FS_TRACE_ERROR("Fsck: CheckJournal failure: %d\n", status);
+        return status;
+    }
+
     //TODO: check root not a directory
     if ((status = chk.CheckInode(1, 1, 0)) != ZX_OK) {
         FS_TRACE_ERROR("Fsck: CheckInode failure: %d\n", status);
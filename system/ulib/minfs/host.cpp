@@ -103,6 +103,10 @@ struct fakeFs {
 } // namespace anonymous
 
 int emu_mkfs(const char* path) {
+    return emu_mkfs(path, minfs::MountOptions());
+}
+
+int emu_mkfs(const char* path, const minfs::MountOptions& options) {
     fbl::unique_fd fd(open(path, O_RDWR));
     if (!fd) {
         fprintf(stderr, "error: could not open path %s\n", path);
@@ -123,7 +127,7 @@ int emu_mkfs(const char* path) {
         return -1;
     }
 
-    return Mkfs(fbl::move(bc));
+    return Mkfs(options, fbl::move(bc));
 }
 
 int emu_mount(const char* path) {
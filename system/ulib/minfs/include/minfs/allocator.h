@@ -39,18 +39,29 @@ public:
     ~AllocatorPromise();
 
     // Allocate a new item in allocator_. Return the index of the newly allocated item.
-    size_t Allocate(WriteTxn* txn);
+    //
+    // Items are taken in order from the run of free items set aside by the
+    // reservation, unless |goal| is non-zero and free, in which case |goal| is
+    // allocated instead. Callers extending an existing object pass the item
+    // following its last one, so that the object stays contiguous.
+    size_t Allocate(WriteTxn* txn, size_t goal = 0);
 private:
     friend class Allocator;
 
     // Constructor which only allows creation through an Allocator.
-    AllocatorPromise(Allocator* allocator, size_t reserved) : allocator_(allocator),
-                                                              reserved_(reserved) {
+    AllocatorPromise(Allocator* allocator, size_t reserved, size_t run_start) :
+        allocator_(allocator), reserved_(reserved), next_(run_start),
+        run_end_(run_start + reserved) {
         ZX_DEBUG_ASSERT(allocator != nullptr);
     }
 
     Allocator* allocator_ = nullptr;
     size_t reserved_ = 0;
+
+    // The next item to allocate, and the end of the run of items found free
+    // when the reservation was made.
+    size_t next_ = 0;
+    size_t run_end_ = 0;
 };
 
 // Represents the FVM-related information for the allocator, including
@@ -197,6 +208,9 @@ public:
 
     // Reserve |count| elements. This is required in order to later allocate them.
     // Outputs a |promise| which contains reservation details.
+    //
+    // When possible, the promise allocates from a run of |count| contiguous
+    // free elements, and later reservations are placed after that run.
     zx_status_t Reserve(WriteTxn* txn, size_t count, fbl::unique_ptr<AllocatorPromise>* promise);
 
     // Free an item from the allocator.
@@ -212,15 +226,22 @@ private:
     // Extend the on-disk extent containing map_.
     zx_status_t Extend(WriteTxn* txn);
 
-    // Allocate an element and return the newly allocated index.
-    size_t Allocate(WriteTxn* txn);
+    // Allocate the first free element at or after |start|, wrapping around
+    // to the start of the pool, and return the newly allocated index.
+    size_t Allocate(WriteTxn* txn, size_t start);
+
+    // Return true if the element at |index| may be allocated.
+    bool IsFree(size_t index) const {
+        return index < map_.size() && !map_.Get(index, index + 1);
+    }
 
     // Write back the allocation of the following items to disk.
     void Persist(WriteTxn* txn, size_t index, size_t count);
 
     // Unreserve |count| elements. This may be called in the event of failure, or if we
-    // over-reserved initially.
-    void Unreserve(size_t count);
+    // over-reserved initially. |next| and |run_end| describe the part of the
+    // promise's run which was not allocated.
+    void Unreserve(size_t count, size_t next, size_t run_end);
 
     // Return the number of total available elements, after taking reservations into account.
     size_t GetAvailable() {
@@ -21,6 +21,7 @@ struct WriteRequest {
     size_t vmo_offset;
     size_t dev_offset;
     size_t length;
+    bool data; // File data, which is not journaled
 };
 
 // A transaction consisting of enqueued VMOs to be written
@@ -40,6 +41,11 @@ public:
     // Identify that a block should be written to disk at a later point in time.
     void Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset, uint64_t nblocks);
 
+    // Identify that a block of file data should be written to disk at a later
+    // point in time. Unlike metadata, file data is not written to the journal.
+    void EnqueueData(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                     uint64_t nblocks);
+
     fbl::Vector<WriteRequest>& Requests() { return requests_; }
 
     size_t BlkCount() const;
@@ -52,6 +58,9 @@ protected:
     zx_status_t Flush(zx_handle_t vmo, vmoid_t vmoid);
 
 private:
+    void EnqueueRequest(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                        uint64_t nblocks, bool data);
+
     Bcache* bc_;
     fbl::Vector<WriteRequest> requests_;
 };
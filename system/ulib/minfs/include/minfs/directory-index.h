@@ -0,0 +1,103 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file describes the in-memory index of the direntries of a large
+// MinFS directory.
+
+#pragma once
+
+#include <fbl/array.h>
+#include <fbl/macros.h>
+#include <fbl/string_piece.h>
+#include <fbl/vector.h>
+#include <zircon/types.h>
+
+#include <minfs/format.h>
+
+namespace minfs {
+
+// Directories smaller than this are searched linearly, without an index.
+constexpr size_t kMinfsDirectoryIndexMinSize = kMinfsBlockSize;
+
+// DirectoryIndex locates the direntries of a directory without reading the
+// whole directory. It holds:
+//
+// - A hash table from the hash of each name in the directory to the offset of
+//   its direntry. Distinct names may share a hash, so every candidate offset
+//   must be checked against the direntry on disk.
+// - The sorted offsets of all direntries with free space: all free direntries,
+//   and all used direntries whose record is large enough to be split.
+//
+// The index is not stored on disk. It is built by reading the directory once,
+// and must be updated by each change to the direntries of the directory.
+// Direntries never move, so the offsets of existing entries remain valid as
+// entries are added and removed.
+//
+// This class is thread-compatible.
+class DirectoryIndex {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(DirectoryIndex);
+
+    DirectoryIndex();
+    ~DirectoryIndex();
+
+    static uint32_t Hash(fbl::StringPiece name);
+
+    // Records that the direntry at |off| is named |name|.
+    zx_status_t AddEntry(fbl::StringPiece name, size_t off);
+
+    // Removes the direntry at |off|, named |name|, from the index.
+    void RemoveEntry(fbl::StringPiece name, size_t off);
+
+    // Returns in |out_off| the offset of the next direntry which may be named
+    // |name|, whose hash is |hash|. |cursor| must be zero on the first call,
+    // and is updated on each call. Returns false once all candidates have
+    // been returned.
+    bool FindEntry(uint32_t hash, size_t* cursor, size_t* out_off) const;
+
+    // Records that the direntry at |off| has free space.
+    zx_status_t AddSpace(size_t off);
+
+    // Records that the direntry at |off| has no free space, or has been
+    // merged into another direntry.
+    void RemoveSpace(size_t off);
+
+    bool HasSpace(size_t off) const;
+
+    // Returns in |out_off| the offset of the last direntry with free space
+    // before |off|. Since every free direntry has free space, this is the
+    // direntry preceding |off|, if that direntry is free.
+    bool FindSpaceBefore(size_t off, size_t* out_off) const;
+
+    // Direntries with free space, in increasing order of offset.
+    size_t SpaceCount() const { return space_.size(); }
+    size_t SpaceAt(size_t i) const { return space_[i]; }
+
+private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t off;
+    };
+
+    // Values of |Slot::off| for slots which do not hold a direntry.
+    static constexpr uint32_t kSlotFree = UINT32_MAX;
+    static constexpr uint32_t kSlotRemoved = UINT32_MAX - 1;
+
+    static_assert(kMinfsMaxDirectorySize < kSlotRemoved,
+                  "Direntry offsets must not collide with the reserved slot values");
+
+    // Resizes the hash table so that it can hold at least one more entry.
+    zx_status_t Grow();
+
+    // Returns the index within |space_| of the first offset not less than |off|.
+    size_t LowerBound(size_t off) const;
+
+    fbl::Array<Slot> slots_;
+    size_t entry_count_ = 0;
+    size_t removed_count_ = 0;
+
+    fbl::Vector<uint32_t> space_;
+};
+
+} // namespace minfs
@@ -17,6 +17,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // clang-format off
@@ -33,11 +34,27 @@ typedef uint32_t ino_t;
 
 constexpr uint64_t kMinfsMagic0         = (0x002153466e694d21ULL);
 constexpr uint64_t kMinfsMagic1         = (0x385000d3d3d3d304ULL);
-constexpr uint32_t kMinfsVersion        = 0x00000006;
+
+// Each optional on-disk feature bumps the version, and an image records the
+// oldest version that understands the features it uses, so that older
+// drivers (which only accept their own version) refuse it rather than
+// mounting it and ignoring the feature.
+constexpr uint32_t kMinfsVersionBase    = 0x00000006; // Oldest supported version
+constexpr uint32_t kMinfsVersionJournal = 0x00000007; // Adds kMinfsFlagJournal
+constexpr uint32_t kMinfsVersionExtents = 0x00000008; // Adds kMinfsFlagExtents
+constexpr uint32_t kMinfsVersion        = kMinfsVersionExtents;
 
 constexpr ino_t    kMinfsRootIno        = 1;
 constexpr uint32_t kMinfsFlagClean      = 0x00000001; // Currently unused
 constexpr uint32_t kMinfsFlagFVM        = 0x00000002; // Mounted on FVM
+constexpr uint32_t kMinfsFlagJournal    = 0x00000004; // Metadata is journaled
+constexpr uint32_t kMinfsFlagExtents    = 0x00000008; // New inodes are extent mapped
+
+// Returns the version to record in the superblock of an image with |flags|.
+constexpr uint32_t MinfsVersionForFlags(uint32_t flags) {
+    return (flags & kMinfsFlagExtents) ? kMinfsVersionExtents :
+           (flags & kMinfsFlagJournal) ? kMinfsVersionJournal : kMinfsVersionBase;
+}
 constexpr uint32_t kMinfsBlockSize      = 8192;
 constexpr uint32_t kMinfsBlockBits      = (kMinfsBlockSize * 8);
 constexpr uint32_t kMinfsInodeSize      = 256;
@@ -60,6 +77,23 @@ constexpr uint64_t kMinfsMaxFileBlock = (fbl::numeric_limits<uint32_t>::max() /
                                         - 1;
 constexpr uint64_t kMinfsMaxFileSize  = kMinfsMaxFileBlock * kMinfsBlockSize;
 
+// Inode flags
+constexpr uint32_t kMinfsInodeFlagExtents = 0x00000001; // Blocks are mapped by an extent tree
+
+// The extent tree of an inode replaces its direct and indirect block
+// numbers. Its root is stored in their place within the inode, and the
+// remaining nodes each occupy a data block.
+constexpr uint16_t kMinfsExtentMagic       = 0xe7e7;
+constexpr uint32_t kMinfsExtentHeaderSize  = 8;
+constexpr uint32_t kMinfsExtentSize        = 12;
+constexpr uint32_t kMinfsExtentsPerRoot    = ((kMinfsDirect + kMinfsIndirect +
+                                               kMinfsDoublyIndirect) * sizeof(blk_t) -
+                                              kMinfsExtentHeaderSize) / kMinfsExtentSize;
+constexpr uint32_t kMinfsExtentsPerNode    = (kMinfsBlockSize - kMinfsExtentHeaderSize) /
+                                             kMinfsExtentSize;
+// A full tree of this depth maps more than kMinfsMaxFileBlock extents.
+constexpr uint32_t kMinfsExtentMaxDepth    = 3;
+
 constexpr uint32_t kMinfsTypeFile = 8;
 constexpr uint32_t kMinfsTypeDir  = 4;
 
@@ -79,6 +113,23 @@ constexpr size_t kMinfsMinimumSlices = 5;
 
 constexpr uint64_t kMinfsDefaultInodeCount = 32768;
 
+// The metadata journal occupies a run of data blocks, reserved when the
+// filesystem is created, which holds an info block followed by a single
+// journal entry: a header block, the journaled metadata blocks, and a
+// commit block.
+constexpr uint64_t kMinfsJournalMagic       = (0x6c6e726a73666e6dULL);
+constexpr uint64_t kMinfsJournalHeaderMagic = (0x6864726a73666e6dULL);
+constexpr uint64_t kMinfsJournalCommitMagic = (0x746d636a73666e6dULL);
+
+// Blocks of the journal which do not hold journaled metadata:
+// the info block, the entry header block and the entry commit block.
+constexpr uint32_t kMinfsJournalOverheadBlocks = 3;
+constexpr uint32_t kMinfsMinimumJournalBlocks  = 16;
+constexpr uint32_t kMinfsDefaultJournalBlocks  = 256;
+// Mkfs reserves at most one journal block for every
+// |kMinfsJournalRatio| data blocks.
+constexpr uint32_t kMinfsJournalRatio          = 16;
+
 struct Superblock {
     uint64_t magic0;
     uint64_t magic1;
@@ -104,10 +155,44 @@ struct Superblock {
 
     ino_t unlinked_head;    // Index to the first unlinked (but open) inode.
     ino_t unlinked_tail;    // Index to the last unlinked (but open) inode.
+
+    // The following fields are only valid with (flags & kMinfsFlagJournal):
+    blk_t journal_block;          // First data block of the journal
+    uint32_t journal_block_count; // Blocks allocated to the journal
 };
 
 static_assert(sizeof(Superblock) <= kMinfsBlockSize,
               "minfs info size is wrong");
+
+struct JournalInfo {
+    uint64_t magic;
+    // Entries with a smaller sequence number have already been written to
+    // their final location, and must not be replayed.
+    uint64_t sequence;
+    uint32_t checksum;   // crc32 of the preceding fields
+};
+
+static_assert(sizeof(JournalInfo) <= kMinfsBlockSize, "minfs journal info size is wrong");
+
+constexpr uint32_t kMinfsJournalMaxEntryBlocks = (kMinfsBlockSize - 24) / sizeof(blk_t);
+
+struct JournalHeader {
+    uint64_t magic;
+    uint64_t sequence;
+    uint32_t num_blocks; // Number of journaled blocks following the header
+    uint32_t reserved;
+    blk_t target_blocks[kMinfsJournalMaxEntryBlocks]; // Absolute destination of each block
+};
+
+static_assert(sizeof(JournalHeader) <= kMinfsBlockSize, "minfs journal header size is wrong");
+
+struct JournalCommit {
+    uint64_t magic;
+    uint64_t sequence;
+    uint32_t checksum;   // crc32 of the header block and the journaled blocks
+};
+
+static_assert(sizeof(JournalCommit) <= kMinfsBlockSize, "minfs journal commit size is wrong");
 // Notes:
 // - the ibm, abm, ino, and dat regions must be in that order
 //   and may not overlap
@@ -121,6 +206,12 @@ static_assert(sizeof(Superblock) <= kMinfsBlockSize,
 //     ino_block + ino / kMinfsInodesPerBlock
 //   at offset: ino % kMinfsInodesPerBlock
 // - inode 0 is never used, should be marked allocated but ignored
+// - the journal, if any, is a run of data blocks which is marked
+//   allocated in the abm, but is not referenced by any inode
+// - inodes are created with an extent tree if the superblock has
+//   kMinfsFlagExtents; inodes which predate the flag keep their direct
+//   and indirect blocks, and both kinds may be found on the same volume
+// - the extents within a node are sorted by file_block and do not overlap
 
 struct Inode {
     uint32_t magic;
@@ -134,7 +225,8 @@ struct Inode {
     uint32_t dirent_count;          // for directories
     ino_t last_inode;               // index to the previous unlinked inode
     ino_t next_inode;               // index to the next unlinked inode
-    uint32_t rsvd[3];
+    uint32_t flags;                 // kMinfsInodeFlag*
+    uint32_t rsvd[2];
     blk_t dnum[kMinfsDirect];    // direct blocks
     blk_t inum[kMinfsIndirect];  // indirect blocks
     blk_t dinum[kMinfsDoublyIndirect]; // doubly indirect blocks
@@ -143,6 +235,53 @@ struct Inode {
 static_assert(sizeof(Inode) == kMinfsInodeSize,
               "minfs inode size is wrong");
 
+struct ExtentHeader {
+    uint16_t magic;
+    uint16_t depth;                 // 0 if the entries are extents, otherwise the
+                                    // height of the subtrees the entries point at
+    uint16_t count;                 // entries in use
+    uint16_t max;                   // entries which fit in the node
+};
+
+// Within a leaf, maps |length| blocks of the file starting at |file_block| onto the
+// data blocks starting at |start|. Within an index node, points at the node in
+// block |start|, whose entries all map file blocks at or after |file_block|, and
+// |length| is unused.
+struct Extent {
+    blk_t file_block;
+    blk_t start;
+    blk_t length;
+};
+
+static_assert(sizeof(ExtentHeader) == kMinfsExtentHeaderSize, "minfs extent header size is wrong");
+static_assert(sizeof(Extent) == kMinfsExtentSize, "minfs extent size is wrong");
+static_assert(kMinfsExtentHeaderSize + kMinfsExtentsPerRoot * kMinfsExtentSize <=
+              sizeof(Inode) - offsetof(Inode, dnum), "minfs extent root does not fit the inode");
+
+// The header of the extent tree of an inode with kMinfsInodeFlagExtents, or of a node
+// block, which is followed by its entries.
+inline ExtentHeader* GetExtentHeader(void* node) {
+    return reinterpret_cast<ExtentHeader*>(node);
+}
+
+inline ExtentHeader* GetExtentRoot(Inode* inode) {
+    return GetExtentHeader(inode->dnum);
+}
+
+inline const ExtentHeader* GetExtentRoot(const Inode* inode) {
+    return reinterpret_cast<const ExtentHeader*>(inode->dnum);
+}
+
+inline Extent* GetExtents(ExtentHeader* header) {
+    return reinterpret_cast<Extent*>(reinterpret_cast<uint8_t*>(header) +
+                                     kMinfsExtentHeaderSize);
+}
+
+inline const Extent* GetExtents(const ExtentHeader* header) {
+    return reinterpret_cast<const Extent*>(reinterpret_cast<const uint8_t*>(header) +
+                                           kMinfsExtentHeaderSize);
+}
+
 struct Dirent {
     ino_t ino;                      // inode number
     uint32_t reclen;                // Low 28 bits: Length of record
@@ -19,6 +19,7 @@
 #include <fbl/macros.h>
 #include <fbl/unique_ptr.h>
 #include <minfs/bcache.h>
+#include <minfs/minfs.h>
 
 #define PATH_PREFIX "::"
 #define PREFIX_SIZE 2
@@ -33,6 +34,7 @@ static inline bool host_path(const char* path) {
     return false;
 }
 int emu_mkfs(const char* path);
+int emu_mkfs(const char* path, const minfs::MountOptions& options);
 int emu_mount(const char* path);
 int emu_mount_bcache(fbl::unique_ptr<minfs::Bcache> bc);
 bool emu_is_mounted();
@@ -0,0 +1,172 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file describes the metadata journal of MinFS.
+
+#pragma once
+
+#ifdef __Fuchsia__
+#include <lib/fzl/owned-vmo-mapper.h>
+#endif
+
+#include <fbl/algorithm.h>
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+
+#include <minfs/bcache.h>
+#include <minfs/format.h>
+
+namespace minfs {
+
+// Returns the absolute block number of the info block of the journal.
+inline blk_t JournalStartBlock(const Superblock& info) {
+    return info.dat_block + info.journal_block;
+}
+
+// Returns the number of metadata blocks a single journal entry may hold.
+inline uint32_t JournalEntryCapacity(const Superblock& info) {
+    return fbl::min(info.journal_block_count - kMinfsJournalOverheadBlocks,
+                    kMinfsJournalMaxEntryBlocks);
+}
+
+// Returns ZX_OK if |blk| holds a valid journal info block.
+zx_status_t CheckJournalInfo(const void* blk);
+
+// Writes an empty journal, whose next entry has sequence number |sequence|,
+// to the journal blocks reserved in |info|.
+zx_status_t InitJournal(Bcache* bc, const Superblock& info, uint64_t sequence);
+
+// Writes the metadata of the journal entry of the filesystem described by
+// |info| to its final location, if the entry was committed but may not have
+// been written in place, and then marks the journal as empty.
+//
+// Must be called before any metadata is read. Returns the sequence number of
+// the next journal entry in |out_sequence|.
+zx_status_t ReplayJournal(Bcache* bc, const Superblock& info, uint64_t* out_sequence);
+
+#ifdef __Fuchsia__
+
+class WritebackWork;
+
+// Writes groups of WritebackWork to disk through the metadata journal.
+//
+// The writeback thread adds every work waiting in the writeback buffer to a
+// group with |Add|, and then writes the group with |Commit|:
+//
+// 1. File data is written in place.
+// 2. The metadata of the group is written to the journal as a single entry,
+//    holding the final contents of each metadata block the group modifies.
+// 3. Once the entry is on disk, the metadata is written in place.
+//
+// Concurrent transactions thus share the cost of each entry, and metadata
+// blocks which several of them modify (such as the bitmaps, the inode table
+// and directories) are written once per group rather than once per
+// transaction.
+//
+// Since an entry is written in place before the next group begins, the
+// journal holds at most one entry, and only that entry may need to be
+// replayed after a crash.
+class Journal {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Journal);
+
+    // Creates a journal for the journal blocks of |info|, whose next entry has
+    // sequence number |sequence|, as returned by ReplayJournal.
+    static zx_status_t Create(Bcache* bc, const Superblock& info, uint64_t sequence,
+                              fbl::unique_ptr<Journal>* out);
+    ~Journal();
+
+    // Adds the writes of |work|, which must have been copied to the writeback
+    // buffer, to the current group.
+    //
+    // Returns false, leaving the group unchanged, if |work| must wait for the
+    // next group: because its metadata would not fit in the entry, or because
+    // it writes file data to a block the group writes as metadata. The first
+    // work of a group is always added.
+    bool Add(WritebackWork* work);
+
+    // Writes all works added since the previous call to disk. The writeback
+    // buffer is identified by |buffer_vmoid|, and mapped at |buffer|.
+    zx_status_t Commit(vmoid_t buffer_vmoid, const void* buffer);
+
+private:
+    // A single block write, from the writeback buffer.
+    struct BlockWrite {
+        blk_t target;        // Absolute destination on disk
+        blk_t buffer_block;  // Source block within the writeback buffer
+        uint32_t order;      // Position within the group, for sorting data writes
+    };
+
+    // A block device request, in units of MinFS blocks.
+    struct Request {
+        vmoid_t vmoid;
+        blk_t vmo_block;
+        blk_t dev_block;
+        blk_t length;
+    };
+
+    Journal(Bcache* bc, blk_t start_block, uint32_t capacity, uint64_t sequence,
+            fzl::OwnedVmoMapper mapper);
+
+    // Returns the index of |target| among the metadata of the current group,
+    // or |metadata_.size()| if the group does not write |target| as metadata.
+    size_t FindMetadata(blk_t target) const;
+
+    // Returns true if |target| was written as metadata by the last entry.
+    bool InLastEntry(blk_t target) const;
+
+    // Orders BlockWrites by destination, and then by their order within the
+    // group.
+    static int CompareWrites(const void* a, const void* b);
+
+    // Appends a write of |length| blocks to |requests|, merging it with the
+    // last request when they are contiguous.
+    static void AddRequest(fbl::Vector<Request>* requests, vmoid_t vmoid, blk_t vmo_block,
+                           blk_t dev_block, blk_t length);
+
+    // Issues |requests| to the block device, and waits for them to complete.
+    zx_status_t Transact(const fbl::Vector<Request>& requests);
+
+    // Marks the entry in the journal as written in place, so that it will not
+    // be replayed.
+    zx_status_t WriteInfo();
+
+    // Writes the file data of the group in place, merging writes to
+    // contiguous blocks.
+    zx_status_t WriteData(vmoid_t buffer_vmoid, const void* buffer);
+
+    // Writes the metadata of the group to the journal.
+    zx_status_t WriteEntry(vmoid_t buffer_vmoid, const void* buffer);
+
+    // Clears the current group.
+    void Reset();
+
+    Bcache* bc_;
+    const blk_t start_block_;
+    const uint32_t capacity_;
+    uint64_t sequence_;
+
+    // Holds the info, header and commit blocks of the journal, followed by
+    // the staging area used to merge writes of file data.
+    fzl::OwnedVmoMapper mapper_;
+    vmoid_t vmoid_ = VMOID_INVALID;
+
+    // The writes of the current group. |metadata_| holds one write for each
+    // block, which is the last write to that block within the group.
+    size_t work_count_ = 0;
+    fbl::Vector<BlockWrite> metadata_;
+    fbl::Vector<BlockWrite> data_;
+    // Set if the group writes to a block the entry in the journal would
+    // overwrite if it was replayed.
+    bool invalidate_ = false;
+
+    // The sorted destinations of the entry currently in the journal, if it
+    // has not been marked as written in place.
+    fbl::Vector<blk_t> last_entry_;
+};
+
+#endif // __Fuchsia__
+
+} // namespace minfs
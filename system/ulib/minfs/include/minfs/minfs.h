@@ -29,6 +29,13 @@ struct MountOptions {
 
     // Number of slices to preallocate for data when the filesystem is created.
     uint32_t fvm_data_slices = 1;
+    // Reserve a metadata journal when the filesystem is created. Filesystems
+    // with a journal always write their metadata through it.
+    bool journal = true;
+    // Map the blocks of new files with extent trees when the filesystem is created,
+    // rather than with direct and indirect blocks. Such filesystems cannot be
+    // mounted by drivers which predate extents.
+    bool extents = false;
 };
 
 // Format the partition backed by |bc| as MinFS.
@@ -25,6 +25,7 @@
 #include <minfs/bcache.h>
 #include <minfs/block-txn.h>
 #include <minfs/format.h>
+#include <minfs/journal.h>
 
 namespace minfs {
 
@@ -53,6 +54,14 @@ public:
     // consumed.
     size_t Complete(zx_handle_t vmo, vmoid_t vmoid);
 
+    // Signals that the enqueued work has been transacted by other means (such
+    // as the journal) with |status|, and resets the WritebackWork to its
+    // initial state.
+    //
+    // Returns the number of blocks of the writeback buffer that have been
+    // consumed.
+    size_t Finish(zx_status_t status);
+
     // Adds a closure to the WritebackWork, such that it will be signalled
     // when the WritebackWork is flushed to disk.
     // If no closure is set, nothing will get signalled.
@@ -96,9 +105,9 @@ public:
         return inode_promise_->Allocate(work_.get());
     }
 
-    size_t AllocateBlock() {
+    size_t AllocateBlock(size_t goal = 0) {
         ZX_DEBUG_ASSERT(block_promise_ != nullptr);
-        return block_promise_->Allocate(work_.get());
+        return block_promise_->Allocate(work_.get(), goal);
     }
 
     void SetWork(fbl::unique_ptr<WritebackWork> work) {
@@ -128,7 +137,11 @@ private:
 class WritebackBuffer {
 public:
     // Calls constructor, return an error if anything goes wrong.
+    //
+    // If |journal| is not null, works are written to disk in groups through
+    // the journal; otherwise, each work is written in place on its own.
     static zx_status_t Create(Bcache* bc, fzl::OwnedVmoMapper mapper,
+                              fbl::unique_ptr<Journal> journal,
                               fbl::unique_ptr<WritebackBuffer>* out);
     ~WritebackBuffer();
 
@@ -143,7 +156,7 @@ public:
     void Enqueue(fbl::unique_ptr<WritebackWork> work) __TA_EXCLUDES(writeback_lock_);
 
 private:
-    WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper);
+    WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper, fbl::unique_ptr<Journal> journal);
 
     // Blocks until |blocks| blocks of data are free for the caller.
     // Returns |ZX_OK| with the lock still held in this case.
@@ -162,6 +175,11 @@ private:
     // safely guarantee that space exists within the buffer.
     void CopyToBufferLocked(WriteTxn* txn) __TA_REQUIRES(writeback_lock_);
 
+    // Writes as many works from the front of the work queue as the journal
+    // accepts as a single group, and releases their space in the writeback
+    // buffer. Drops the lock while the group is written.
+    void CommitGroupLocked() __TA_REQUIRES(writeback_lock_);
+
     static int WritebackThread(void* arg);
 
     // The waiter struct may be used as a stack-allocated queue for producers.
@@ -197,6 +215,8 @@ private:
     size_t start_ __TA_GUARDED(writeback_lock_){};
     size_t len_ __TA_GUARDED(writeback_lock_){};
     const size_t cap_ = 0;
+    // Only accessed by the writeback thread. May be null.
+    fbl::unique_ptr<Journal> journal_;
 };
 
 #endif
@@ -0,0 +1,537 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/array.h>
+#include <fbl/auto_call.h>
+#include <fbl/unique_ptr.h>
+#include <fs/block-txn.h>
+#include <fs/trace.h>
+#include <lib/cksum.h>
+
+#include <minfs/journal.h>
+
+#include "minfs-private.h"
+
+namespace minfs {
+namespace {
+
+uint32_t InfoChecksum(const JournalInfo* info) {
+    return crc32(0, reinterpret_cast<const uint8_t*>(info), offsetof(JournalInfo, checksum));
+}
+
+// Fills the journal info block |blk|, marking entries with a sequence number
+// smaller than |sequence| as written in place.
+void InitInfo(void* blk, uint64_t sequence) {
+    memset(blk, 0, kMinfsBlockSize);
+    JournalInfo* info = reinterpret_cast<JournalInfo*>(blk);
+    info->magic = kMinfsJournalMagic;
+    info->sequence = sequence;
+    info->checksum = InfoChecksum(info);
+}
+
+zx_status_t CheckJournalRange(const Superblock& info) {
+    if ((info.journal_block == 0) ||
+        (info.journal_block_count < kMinfsMinimumJournalBlocks) ||
+        (info.journal_block > info.block_count) ||
+        (info.journal_block_count > info.block_count - info.journal_block)) {
+        FS_TRACE_ERROR("minfs: journal (%u, %u blocks) out of range\n", info.journal_block,
+                       info.journal_block_count);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    return ZX_OK;
+}
+
+} // namespace
+
+zx_status_t CheckJournalInfo(const void* blk) {
+    const JournalInfo* info = reinterpret_cast<const JournalInfo*>(blk);
+    if ((info->magic != kMinfsJournalMagic) || (info->checksum != InfoChecksum(info))) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    return ZX_OK;
+}
+
+zx_status_t InitJournal(Bcache* bc, const Superblock& info, uint64_t sequence) {
+    zx_status_t status;
+    if ((status = CheckJournalRange(info)) != ZX_OK) {
+        return status;
+    }
+
+    uint8_t blk[kMinfsBlockSize];
+    InitInfo(blk, sequence);
+    if ((status = bc->Writeblk(JournalStartBlock(info), blk)) != ZX_OK) {
+        return status;
+    }
+    // Leave no stale entry behind the info block.
+    memset(blk, 0, sizeof(blk));
+    return bc->Writeblk(JournalStartBlock(info) + 1, blk);
+}
+
+zx_status_t ReplayJournal(Bcache* bc, const Superblock& info, uint64_t* out_sequence) {
+    TRACE_DURATION("minfs", "ReplayJournal");
+    *out_sequence = 0;
+    if ((info.flags & kMinfsFlagJournal) == 0) {
+        return ZX_OK;
+    }
+
+    zx_status_t status;
+    if ((status = CheckJournalRange(info)) != ZX_OK) {
+        return status;
+    }
+    const blk_t start = JournalStartBlock(info);
+    const uint32_t capacity = JournalEntryCapacity(info);
+
+    uint8_t blk[kMinfsBlockSize];
+    if ((status = bc->Readblk(start, blk)) != ZX_OK) {
+        return status;
+    }
+    if ((status = CheckJournalInfo(blk)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: bad journal info block\n");
+        return status;
+    }
+    const uint64_t sequence = reinterpret_cast<const JournalInfo*>(blk)->sequence;
+    *out_sequence = sequence;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> header_blk(new (&ac) uint8_t[kMinfsBlockSize]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if ((status = bc->Readblk(start + 1, header_blk.get())) != ZX_OK) {
+        return status;
+    }
+    const JournalHeader* header = reinterpret_cast<const JournalHeader*>(header_blk.get());
+    if ((header->magic != kMinfsJournalHeaderMagic) || (header->sequence < sequence) ||
+        (header->num_blocks == 0) || (header->num_blocks > capacity)) {
+        // The journal holds no entry which must be replayed.
+        return ZX_OK;
+    }
+
+    const uint32_t count = header->num_blocks;
+    fbl::unique_ptr<uint8_t[]> payload(new (&ac) uint8_t[count * kMinfsBlockSize]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    uint32_t checksum = crc32(0, header_blk.get(), kMinfsBlockSize);
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t* data = &payload[i * kMinfsBlockSize];
+        if ((status = bc->Readblk(start + 2 + i, data)) != ZX_OK) {
+            return status;
+        }
+        checksum = crc32(checksum, data, kMinfsBlockSize);
+    }
+    if ((status = bc->Readblk(start + 2 + count, blk)) != ZX_OK) {
+        return status;
+    }
+    const JournalCommit* commit = reinterpret_cast<const JournalCommit*>(blk);
+    if ((commit->magic != kMinfsJournalCommitMagic) || (commit->sequence != header->sequence) ||
+        (commit->checksum != checksum)) {
+        // The entry was not completely written, so none of its metadata was
+        // written in place either.
+        return ZX_OK;
+    }
+
+    FS_TRACE_WARN("minfs: replaying journal entry %" PRIu64 " (%u blocks)\n", header->sequence,
+                  count);
+    for (uint32_t i = 0; i < count; i++) {
+        const blk_t target = header->target_blocks[i];
+        if ((target >= info.dat_block + info.block_count) ||
+            ((target >= start) && (target < start + info.journal_block_count))) {
+            FS_TRACE_ERROR("minfs: journal entry targets invalid block %u\n", target);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        if ((status = bc->Writeblk(target, &payload[i * kMinfsBlockSize])) != ZX_OK) {
+            return status;
+        }
+    }
+
+    // Once the metadata is in place, the entry must not be replayed again:
+    // it would undo any later modification of the same blocks.
+    const uint64_t next_sequence = header->sequence + 1;
+    if (bc->Sync() != ZX_OK) {
+        return ZX_ERR_IO;
+    }
+    InitInfo(blk, next_sequence);
+    if ((status = bc->Writeblk(start, blk)) != ZX_OK) {
+        return status;
+    }
+    if (bc->Sync() != ZX_OK) {
+        return ZX_ERR_IO;
+    }
+    *out_sequence = next_sequence;
+    return ZX_OK;
+}
+
+#ifdef __Fuchsia__
+
+namespace {
+
+// Info, header and commit blocks, within the journal VMO.
+constexpr blk_t kInfoVmoBlock = 0;
+constexpr blk_t kHeaderVmoBlock = 1;
+constexpr blk_t kCommitVmoBlock = 2;
+
+// The journal VMO also holds a staging area, in which writes of file data to
+// contiguous blocks are gathered into a single request.
+constexpr blk_t kClusterVmoBlock = kMinfsJournalOverheadBlocks;
+constexpr blk_t kClusterBlocks = 128;
+
+int CompareBlocks(const void* a, const void* b) {
+    blk_t lhs = *reinterpret_cast<const blk_t*>(a);
+    blk_t rhs = *reinterpret_cast<const blk_t*>(b);
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+} // namespace
+
+zx_status_t Journal::Create(Bcache* bc, const Superblock& info, uint64_t sequence,
+                            fbl::unique_ptr<Journal>* out) {
+    ZX_DEBUG_ASSERT(info.flags & kMinfsFlagJournal);
+    zx_status_t status;
+    if ((status = CheckJournalRange(info)) != ZX_OK) {
+        return status;
+    }
+
+    fzl::OwnedVmoMapper mapper;
+    if ((status = mapper.CreateAndMap((kMinfsJournalOverheadBlocks + kClusterBlocks) *
+                                      kMinfsBlockSize, "minfs-journal")) != ZX_OK) {
+        return status;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Journal> journal(new (&ac) Journal(bc, JournalStartBlock(info),
+                                                       JournalEntryCapacity(info), sequence,
+                                                       fbl::move(mapper)));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if ((status = bc->AttachVmo(journal->mapper_.vmo().get(), &journal->vmoid_)) != ZX_OK) {
+        return status;
+    }
+
+    *out = fbl::move(journal);
+    return ZX_OK;
+}
+
+Journal::Journal(Bcache* bc, blk_t start_block, uint32_t capacity, uint64_t sequence,
+                 fzl::OwnedVmoMapper mapper)
+    : bc_(bc), start_block_(start_block), capacity_(capacity), sequence_(sequence),
+      mapper_(fbl::move(mapper)) {}
+
+Journal::~Journal() {
+    // Every group has been written in place by now. Mark the last entry as
+    // such, so that a cleanly unmounted filesystem has nothing to replay.
+    if (!last_entry_.is_empty()) {
+        WriteInfo();
+    }
+    if (vmoid_ != VMOID_INVALID) {
+        block_fifo_request_t request;
+        request.group = bc_->BlockGroupID();
+        request.vmoid = vmoid_;
+        request.opcode = BLOCKIO_CLOSE_VMO;
+        bc_->Transaction(&request, 1);
+    }
+}
+
+size_t Journal::FindMetadata(blk_t target) const {
+    for (size_t i = 0; i < metadata_.size(); i++) {
+        if (metadata_[i].target == target) {
+            return i;
+        }
+    }
+    return metadata_.size();
+}
+
+bool Journal::InLastEntry(blk_t target) const {
+    return bsearch(&target, last_entry_.get(), last_entry_.size(), sizeof(blk_t),
+                   CompareBlocks) != nullptr;
+}
+
+bool Journal::Add(WritebackWork* work) {
+    const fbl::Vector<WriteRequest>& requests = work->Requests();
+
+    if (work_count_ > 0) {
+        size_t new_metadata = 0;
+        for (const WriteRequest& request : requests) {
+            for (blk_t i = 0; i < request.length; i++) {
+                const blk_t target = static_cast<blk_t>(request.dev_offset + i);
+                const bool in_group = FindMetadata(target) != metadata_.size();
+                if (request.data && in_group) {
+                    // Data is written before the metadata of the group, so it
+                    // cannot overwrite a metadata block of the same group.
+                    return false;
+                } else if (!request.data && !in_group) {
+                    new_metadata++;
+                }
+            }
+        }
+        if (metadata_.size() + new_metadata > capacity_) {
+            return false;
+        }
+    }
+
+    for (const WriteRequest& request : requests) {
+        for (blk_t i = 0; i < request.length; i++) {
+            BlockWrite write;
+            write.target = static_cast<blk_t>(request.dev_offset + i);
+            write.buffer_block = static_cast<blk_t>(request.vmo_offset + i);
+            write.order = static_cast<uint32_t>(data_.size());
+            if (request.data) {
+                invalidate_ |= InLastEntry(write.target);
+                data_.push_back(write);
+                continue;
+            }
+            size_t index = FindMetadata(write.target);
+            if (index != metadata_.size()) {
+                // Only the final contents of the block are journaled.
+                metadata_[index].buffer_block = write.buffer_block;
+            } else {
+                metadata_.push_back(write);
+            }
+        }
+    }
+    work_count_++;
+    return true;
+}
+
+int Journal::CompareWrites(const void* a, const void* b) {
+    const BlockWrite* lhs = reinterpret_cast<const BlockWrite*>(a);
+    const BlockWrite* rhs = reinterpret_cast<const BlockWrite*>(b);
+    if (lhs->target != rhs->target) {
+        return (lhs->target > rhs->target) - (lhs->target < rhs->target);
+    }
+    return (lhs->order > rhs->order) - (lhs->order < rhs->order);
+}
+
+void Journal::AddRequest(fbl::Vector<Request>* requests, vmoid_t vmoid, blk_t vmo_block,
+                         blk_t dev_block, blk_t length) {
+    if (!requests->is_empty()) {
+        Request& last = (*requests)[requests->size() - 1];
+        if ((last.vmoid == vmoid) && (last.vmo_block + last.length == vmo_block) &&
+            (last.dev_block + last.length == dev_block)) {
+            last.length += length;
+            return;
+        }
+    }
+    Request request;
+    request.vmoid = vmoid;
+    request.vmo_block = vmo_block;
+    request.dev_block = dev_block;
+    request.length = length;
+    requests->push_back(request);
+}
+
+zx_status_t Journal::Transact(const fbl::Vector<Request>& requests) {
+    if (requests.is_empty()) {
+        return ZX_OK;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::Array<block_fifo_request_t> blk_reqs(new (&ac) block_fifo_request_t[requests.size()],
+                                              requests.size());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    const uint32_t kDiskBlocksPerMinfsBlock = kMinfsBlockSize / bc_->DeviceBlockSize();
+    for (size_t i = 0; i < requests.size(); i++) {
+        blk_reqs[i].group = bc_->BlockGroupID();
+        blk_reqs[i].vmoid = requests[i].vmoid;
+        blk_reqs[i].opcode = BLOCKIO_WRITE;
+        blk_reqs[i].vmo_offset = requests[i].vmo_block * kDiskBlocksPerMinfsBlock;
+        blk_reqs[i].dev_offset = requests[i].dev_block * kDiskBlocksPerMinfsBlock;
+        blk_reqs[i].length = requests[i].length * kDiskBlocksPerMinfsBlock;
+    }
+    return bc_->Transaction(blk_reqs.get(), requests.size());
+}
+
+zx_status_t Journal::WriteInfo() {
+    InitInfo(fs::GetBlock(kMinfsBlockSize, mapper_.start(), kInfoVmoBlock), sequence_);
+
+    fbl::Vector<Request> requests;
+    AddRequest(&requests, vmoid_, kInfoVmoBlock, start_block_, 1);
+    zx_status_t status = Transact(requests);
+    if (status == ZX_OK && bc_->Sync() != ZX_OK) {
+        status = ZX_ERR_IO;
+    }
+    if (status == ZX_OK) {
+        last_entry_.reset();
+    }
+    return status;
+}
+
+zx_status_t Journal::WriteEntry(vmoid_t buffer_vmoid, const void* buffer) {
+    TRACE_DURATION("minfs", "Journal::WriteEntry", "blocks", metadata_.size());
+    const uint32_t count = static_cast<uint32_t>(metadata_.size());
+
+    void* header_blk = fs::GetBlock(kMinfsBlockSize, mapper_.start(), kHeaderVmoBlock);
+    memset(header_blk, 0, kMinfsBlockSize);
+    JournalHeader* header = reinterpret_cast<JournalHeader*>(header_blk);
+    header->magic = kMinfsJournalHeaderMagic;
+    header->sequence = sequence_;
+    header->num_blocks = count;
+
+    fbl::Vector<Request> requests;
+    AddRequest(&requests, vmoid_, kHeaderVmoBlock, start_block_ + 1, 1);
+    for (uint32_t i = 0; i < count; i++) {
+        header->target_blocks[i] = metadata_[i].target;
+        AddRequest(&requests, buffer_vmoid, metadata_[i].buffer_block, start_block_ + 2 + i, 1);
+    }
+
+    uint32_t checksum = crc32(0, static_cast<const uint8_t*>(header_blk), kMinfsBlockSize);
+    for (uint32_t i = 0; i < count; i++) {
+        const void* data = fs::GetBlock(kMinfsBlockSize, buffer, metadata_[i].buffer_block);
+        checksum = crc32(checksum, static_cast<const uint8_t*>(data), kMinfsBlockSize);
+    }
+
+    void* commit_blk = fs::GetBlock(kMinfsBlockSize, mapper_.start(), kCommitVmoBlock);
+    memset(commit_blk, 0, kMinfsBlockSize);
+    JournalCommit* commit = reinterpret_cast<JournalCommit*>(commit_blk);
+    commit->magic = kMinfsJournalCommitMagic;
+    commit->sequence = sequence_;
+    commit->checksum = checksum;
+    AddRequest(&requests, vmoid_, kCommitVmoBlock, start_block_ + 2 + count, 1);
+
+    zx_status_t status = Transact(requests);
+    if (status == ZX_OK && bc_->Sync() != ZX_OK) {
+        status = ZX_ERR_IO;
+    }
+    return status;
+}
+
+zx_status_t Journal::WriteData(vmoid_t buffer_vmoid, const void* buffer) {
+    TRACE_DURATION("minfs", "Journal::WriteData", "blocks", data_.size());
+
+    // Sort by destination, keeping only the last write to each block.
+    qsort(data_.get(), data_.size(), sizeof(BlockWrite), CompareWrites);
+    size_t count = 0;
+    for (size_t i = 0; i < data_.size(); i++) {
+        if (i + 1 < data_.size() && data_[i + 1].target == data_[i].target) {
+            continue;
+        }
+        data_[count++] = data_[i];
+    }
+
+    // Each work copies its data to the writeback buffer next to its own
+    // metadata, so a file written by many small transactions is contiguous on
+    // disk but not in the buffer. Such runs are copied to the staging area,
+    // and written by a single request.
+    fbl::Vector<Request> requests;
+    blk_t staged = 0;
+    size_t start = 0;
+    while (start < count) {
+        size_t end = start + 1;
+        bool contiguous_source = true;
+        while (end < count && end - start < kClusterBlocks &&
+               data_[end].target == data_[end - 1].target + 1) {
+            contiguous_source &= (data_[end].buffer_block == data_[end - 1].buffer_block + 1);
+            end++;
+        }
+        const blk_t length = static_cast<blk_t>(end - start);
+
+        if (length == 1 || contiguous_source) {
+            AddRequest(&requests, buffer_vmoid, data_[start].buffer_block, data_[start].target,
+                       length);
+        } else {
+            if (staged + length > kClusterBlocks) {
+                // The staging area is reused once the requests reading from
+                // it have completed.
+                zx_status_t status;
+                if ((status = Transact(requests)) != ZX_OK) {
+                    return status;
+                }
+                requests.reset();
+                staged = 0;
+            }
+            for (size_t i = start; i < end; i++) {
+                memcpy(fs::GetBlock(kMinfsBlockSize, mapper_.start(),
+                                    kClusterVmoBlock + staged + (i - start)),
+                       fs::GetBlock(kMinfsBlockSize, buffer, data_[i].buffer_block),
+                       kMinfsBlockSize);
+            }
+            AddRequest(&requests, vmoid_, kClusterVmoBlock + staged, data_[start].target,
+                       length);
+            staged += length;
+        }
+        start = end;
+    }
+    return Transact(requests);
+}
+
+zx_status_t Journal::Commit(vmoid_t buffer_vmoid, const void* buffer) {
+    TRACE_DURATION("minfs", "Journal::Commit", "works", work_count_);
+    auto reset = fbl::MakeAutoCall([this]() { Reset(); });
+
+    // A single work may modify more metadata than an entry holds; it is
+    // written in place without journaling.
+    const bool journaled = metadata_.size() <= capacity_;
+    zx_status_t status;
+    if ((invalidate_ || !journaled) && !last_entry_.is_empty()) {
+        if ((status = WriteInfo()) != ZX_OK) {
+            return status;
+        }
+    }
+
+    if ((status = WriteData(buffer_vmoid, buffer)) != ZX_OK) {
+        return status;
+    }
+
+    if (metadata_.is_empty()) {
+        return ZX_OK;
+    }
+
+    if (journaled) {
+        if ((status = WriteEntry(buffer_vmoid, buffer)) != ZX_OK) {
+            return status;
+        }
+    }
+
+    qsort(metadata_.get(), metadata_.size(), sizeof(BlockWrite), CompareWrites);
+    fbl::Vector<Request> requests;
+    for (const BlockWrite& write : metadata_) {
+        AddRequest(&requests, buffer_vmoid, write.buffer_block, write.target, 1);
+    }
+    if ((status = Transact(requests)) != ZX_OK) {
+        return status;
+    }
+    // The next entry overwrites this one, so the metadata must be on disk
+    // before it is written.
+    if (bc_->Sync() != ZX_OK) {
+        return ZX_ERR_IO;
+    }
+
+    if (journaled) {
+        fbl::AllocChecker ac;
+        last_entry_.reset();
+        last_entry_.reserve(metadata_.size(), &ac);
+        if (!ac.check()) {
+            // Be conservative: mark the entry as written in place, so that
+            // no later group needs to know its destinations.
+            sequence_++;
+            return WriteInfo();
+        }
+        for (const BlockWrite& write : metadata_) {
+            last_entry_.push_back(write.target);
+        }
+        sequence_++;
+    }
+    return ZX_OK;
+}
+
+void Journal::Reset() {
+    work_count_ = 0;
+    metadata_.reset();
+    data_.reset();
+    invalidate_ = false;
+}
+
+#endif // __Fuchsia__
+
+} // namespace minfs
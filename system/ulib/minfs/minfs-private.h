@@ -10,6 +10,7 @@
 #include <inttypes.h>
 
 #ifdef __Fuchsia__
+#include <bitmap/rle-bitmap.h>
 #include <fbl/auto_lock.h>
 #include <fs/managed-vfs.h>
 #include <fs/remote.h>
@@ -28,6 +29,7 @@
 #include <fbl/macros.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <fs/block-txn.h>
 #include <fs/locking.h>
 #include <fs/ticker.h>
@@ -36,6 +38,7 @@
 #include <fs/vnode.h>
 #include <lib/zircon-internal/fnv1hash.h>
 #include <minfs/allocator.h>
+#include <minfs/directory-index.h>
 #include <minfs/format.h>
 #include <minfs/inode-manager.h>
 #include <minfs/superblock.h>
@@ -78,6 +81,10 @@ constexpr uint32_t kMxFsSyncCtime = (1 << 1);
 
 constexpr uint32_t kMinfsBlockCacheSize = 64;
 
+// Bounds of the readahead window of a sequential reader, in blocks.
+constexpr blk_t kMinfsMinReadaheadBlocks = 4;
+constexpr blk_t kMinfsMaxReadaheadBlocks = 256;
+
 // Used by fsck
 class MinfsChecker;
 class VnodeMinfs;
@@ -145,8 +152,8 @@ public:
     fbl::RefPtr<VnodeMinfs> VnodeLookup(uint32_t ino) FS_TA_EXCLUDES(hash_lock_);
     void VnodeRelease(VnodeMinfs* vn) FS_TA_EXCLUDES(hash_lock_);
 
-    // Allocate a new data block.
-    void BlockNew(Transaction* state, blk_t* out_bno);
+    // Allocate a new data block, preferring |goal| if it is non-zero and free.
+    void BlockNew(Transaction* state, blk_t goal, blk_t* out_bno);
 
     // Free a data block.
     void BlockFree(WriteTxn* txn, blk_t bno);
@@ -434,6 +441,19 @@ private:
     // Enumerates directories.
     zx_status_t ForEachDirent(DirArgs* args, const DirentCallback func);
 
+    // Calls a callback 'func' on the direntry named |args->name|, if any. Unlike ForEachDirent,
+    // uses the directory index for large directories, rather than reading every direntry.
+    zx_status_t LookupDirent(DirArgs* args, const DirentCallback func);
+
+    // Finds an offset where there is space for a direntry of |args->reclen| bytes, as
+    // ForEachDirent with DirentCallbackFindSpace would, using the directory index for large
+    // directories. Returns ZX_ERR_NOT_FOUND if the directory is full.
+    zx_status_t FindDirentSpace(DirArgs* args);
+
+    // Returns true if |index_| describes this directory, building it first if the directory is
+    // large enough to be indexed. Directories below kMinfsDirectoryIndexMinSize are not indexed.
+    bool UseDirectoryIndex();
+
     // Directory callback functions.
     //
     // The following functions are passable to |ForEachDirent|, which reads the parent directory,
@@ -448,6 +468,7 @@ private:
     static zx_status_t DirentCallbackUpdateInode(fbl::RefPtr<VnodeMinfs>, Dirent*,
                                                  DirArgs*);
     static zx_status_t DirentCallbackFindSpace(fbl::RefPtr<VnodeMinfs>, Dirent*, DirArgs*);
+    static zx_status_t DirentCallbackIndex(fbl::RefPtr<VnodeMinfs>, Dirent*, DirArgs*);
 
     // Appends a new directory at the specified offset within |args|. This requires a prior call to
     // DirentCallbackFindSpace to find an offset where there is space for the direntry. It takes
@@ -616,6 +637,34 @@ private:
     // bnos
     zx_status_t BlocksShrink(Transaction* state, blk_t start);
 
+    // Returns true if the blocks of the vnode are mapped by an extent tree, rather than
+    // by direct and indirect blocks.
+    bool IsExtentMapped() const { return (inode_.flags & kMinfsInodeFlagExtents) != 0; }
+
+    // The extent tree counterparts of BlockGet and BlocksShrink, used for extent mapped
+    // vnodes (see extent.cpp).
+    zx_status_t ExtentBlockGet(Transaction* state, blk_t n, blk_t* bno);
+    zx_status_t ExtentBlocksShrink(WritebackWork* wb, blk_t start);
+
+    // Returns the node of the extent tree in |slot|. The pointer is invalidated by
+    // reading or allocating other nodes.
+    ExtentHeader* GetExtentNode(uint32_t slot);
+    // Returns a free slot for the node in block |bno|.
+    zx_status_t ExtentSlotNew(blk_t bno, uint32_t* out_slot);
+    // Returns the slot of the node of |depth| in block |bno|, reading it if necessary.
+    zx_status_t ExtentNodeLoad(blk_t bno, uint16_t depth, uint32_t* out_slot);
+    // Allocates a block for a new, empty node of |depth|.
+    zx_status_t ExtentNodeNew(Transaction* state, uint16_t depth, uint32_t* out_slot);
+    void ExtentNodeWrite(WritebackWork* wb, uint32_t slot);
+    void ExtentNodeFree(WritebackWork* wb, uint32_t slot);
+    // Returns the slot of the leaf which maps (or would map) block |n| of the file.
+    zx_status_t ExtentFindLeaf(blk_t n, uint32_t* out_slot);
+    // Adds |extent|, which does not overlap any other, to the tree.
+    zx_status_t ExtentInsert(Transaction* state, const Extent& extent);
+    // Frees the blocks at and after |start| mapped by the subtree in |slot|, and the
+    // nodes which no longer map any.
+    zx_status_t ExtentShrinkNode(WritebackWork* wb, uint32_t slot, blk_t start);
+
     // Update the vnode's inode and write it to disk.
     void InodeSync(WritebackWork* wb, uint32_t flags);
 
@@ -634,6 +683,10 @@ private:
     zx_status_t InitVmo();
     zx_status_t InitIndirectVmo();
 
+    // Reads the blocks [start, end) of the file into the VMO, skipping blocks which
+    // have been loaded already.
+    zx_status_t LoadVmoBlocks(blk_t start, blk_t end);
+
     // Loads indirect blocks up to and including the doubly indirect block at |index|.
     zx_status_t LoadIndirectWithinDoublyIndirect(uint32_t index);
 
@@ -670,16 +723,26 @@ private:
 #ifdef __Fuchsia__
     // TODO(smklein): When we have can register MinFS as a pager service, and
     // it can properly handle pages faults on a vnode's contents, then we can
-    // avoid reading the entire file up-front. Until then, read the contents of
-    // a VMO into memory when it is read/written.
+    // avoid managing the contents of the VMO ourselves. Until then, blocks of
+    // the file are read into the VMO when they are read/written.
     zx::vmo vmo_{};
     uint64_t vmo_size_ = 0;
 
+    // The blocks of vmo_ which hold the contents of the file.
+    bitmap::RleBitmap vmo_loaded_;
+
+    // Sequential access detection: the offset following the last read, and
+    // the number of blocks to read ahead of the next read.
+    uint64_t read_next_ = 0;
+    blk_t readahead_blocks_ = 0;
+
     // vmo_indirect_ contains all indirect and doubly indirect blocks in the following order:
     // First kMinfsIndirect blocks                                - initial set of indirect blocks
     // Next kMinfsDoublyIndirect blocks                           - doubly indirect blocks
     // Next kMinfsDoublyIndirect * kMinfsDirectPerIndirect blocks - indirect blocks pointed to
     //                                                              by doubly indirect blocks
+    // If the vnode is extent mapped, it instead holds the nodes of the extent tree which have
+    // been read, with the node in slot i at block i.
     fbl::unique_ptr<fzl::ResizeableVmoMapper> vmo_indirect_;
 
     vmoid_t vmoid_{};
@@ -692,6 +755,27 @@ private:
     ino_t ino_{};
     Inode inode_{};
 
+    // Index of the direntries of a large directory; built on first use, and kept until the
+    // vnode is released.
+    fbl::unique_ptr<DirectoryIndex> index_;
+
+#ifndef __Fuchsia__
+    // The nodes of the extent tree which have been read, by slot.
+    fbl::Vector<fbl::unique_ptr<uint8_t[]>> extent_blocks_;
+#endif
+    // The block holding the node of the extent tree in each slot, or zero if the slot is
+    // free.
+    fbl::Vector<blk_t> extent_nodes_;
+    // The extent which mapped the last block looked up, so that sequential accesses do
+    // not search the tree.
+    Extent extent_cache_ = {};
+
+    // The block following the last block allocated to this vnode, which is
+    // preferred for its next allocation so that sequential writes produce
+    // contiguous files. Zero if no block has been allocated since the vnode
+    // was opened.
+    blk_t alloc_goal_ = 0;
+
     // This field tracks the current number of file descriptors with
     // an open reference to this Vnode. Notably, this is distinct from the
     // VnodeMinfs's own refcount, since there may still be filesystem
@@ -723,8 +807,12 @@ constexpr size_t GetVmoSizeForDoublyIndirect() {
 }
 
 // Tries to calculate the required number of blocks into |num_req_blocks|
-// for a write at the given |offset| and |length|.
-zx_status_t GetRequiredBlockCount(size_t offset, size_t length, uint32_t* num_req_blocks);
+// for a write to |inode| at the given |offset| and |length|.
+zx_status_t GetRequiredBlockCount(const Inode& inode, size_t offset, size_t length,
+                                  uint32_t* num_req_blocks);
+
+// Marks |inode| as extent mapped, with an empty extent tree.
+void InitExtentRoot(Inode* inode);
 
 // write the inode data of this vnode to disk (default does not update time values)
 void SyncVnode(fbl::RefPtr<VnodeMinfs> vn, uint32_t flags);
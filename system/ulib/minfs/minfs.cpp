@@ -27,6 +27,7 @@
 #endif
 
 #include <minfs/fsck.h>
+#include <minfs/journal.h>
 #include <minfs/minfs.h>
 
 #include "minfs-private.h"
@@ -84,6 +85,10 @@ void DumpInfo(const Superblock* info) {
     xprintf("minfs: inode table  @ %10u\n", info->ino_block);
     xprintf("minfs: data blocks  @ %10u\n", info->dat_block);
     xprintf("minfs: FVM-aware: %s\n", (info->flags & kMinfsFlagFVM) ? "YES" : "NO");
+    if (info->flags & kMinfsFlagJournal) {
+        xprintf("minfs: journal @ %10u (%u blocks)\n", info->journal_block,
+                info->journal_block_count);
+    }
 }
 
 void DumpInode(const Inode* inode, ino_t ino) {
@@ -101,11 +106,16 @@ zx_status_t CheckSuperblock(const Superblock* info, Bcache* bc) {
         FS_TRACE_ERROR("minfs: bad magic\n");
         return ZX_ERR_INVALID_ARGS;
     }
-    if (info->version != kMinfsVersion) {
+    if ((info->version < kMinfsVersionBase) || (info->version > kMinfsVersion)) {
         FS_TRACE_ERROR("minfs: FS Version: %08x. Driver version: %08x\n", info->version,
                        kMinfsVersion);
         return ZX_ERR_INVALID_ARGS;
     }
+    if (info->version < MinfsVersionForFlags(info->flags)) {
+        FS_TRACE_ERROR("minfs: FS Version: %08x does not support flags %08x\n", info->version,
+                       info->flags);
+        return ZX_ERR_INVALID_ARGS;
+    }
     if ((info->block_size != kMinfsBlockSize) || (info->inode_size != kMinfsInodeSize)) {
         FS_TRACE_ERROR("minfs: bsz/isz %u/%u unsupported\n", info->block_size, info->inode_size);
         return ZX_ERR_INVALID_ARGS;
@@ -224,6 +234,16 @@ zx_status_t CheckSuperblock(const Superblock* info, Bcache* bc) {
             return ZX_ERR_INVALID_ARGS;
         }
     }
+    if (info->flags & kMinfsFlagJournal) {
+        // Data blocks 0 and 1 hold the null block and the root directory.
+        if ((info->journal_block < 2) ||
+            (info->journal_block_count < kMinfsMinimumJournalBlocks) ||
+            (info->journal_block > info->block_count) ||
+            (info->journal_block_count > info->block_count - info->journal_block)) {
+            FS_TRACE_ERROR("minfs: Journal out of range\n");
+            return ZX_ERR_INVALID_ARGS;
+        }
+    }
     // TODO: validate layout
     return 0;
 }
@@ -320,6 +340,16 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WritebackWork* wb) {
     TRACE_DURATION("minfs", "Minfs::InoFree", "ino", vn->ino_);
 
     inodes_->Free(wb, vn->ino_);
+    if (vn->IsExtentMapped()) {
+        zx_status_t status;
+        if ((status = vn->ExtentBlocksShrink(wb, 0)) != ZX_OK) {
+            return status;
+        }
+        ZX_DEBUG_ASSERT(vn->inode_.block_count == 0);
+        ZX_DEBUG_ASSERT(vn->IsUnlinked());
+        return ZX_OK;
+    }
+
     uint32_t block_count = vn->inode_.block_count;
 
     // release all direct blocks
@@ -660,8 +690,8 @@ zx_status_t Minfs::VnodeGet(fbl::RefPtr<VnodeMinfs>* out, ino_t ino) {
 }
 
 // Allocate a new data block from the block bitmap.
-void Minfs::BlockNew(Transaction* state, blk_t* out_bno) {
-    size_t allocated_bno = state->AllocateBlock();
+void Minfs::BlockNew(Transaction* state, blk_t goal, blk_t* out_bno) {
+    size_t allocated_bno = state->AllocateBlock(goal);
     *out_bno = static_cast<blk_t>(allocated_bno);
 }
 
@@ -702,6 +732,28 @@ zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const Superblock* info,
     fbl::unique_ptr<SuperblockManager> sb;
     zx_status_t status;
 
+    // Metadata must be read only once the journal has been replayed, which
+    // may also have updated the superblock.
+    uint64_t journal_sequence = 0;
+    uint8_t replayed_info[kMinfsBlockSize];
+    bool replay = (info->flags & kMinfsFlagJournal) != 0;
+#ifndef __Fuchsia__
+    // The journal holds absolute block numbers, which do not apply to the
+    // layout of sparse images.
+    replay &= bc->extent_lengths_.size() == 0;
+#endif
+    if (replay) {
+        if ((status = ReplayJournal(bc.get(), *info, &journal_sequence)) != ZX_OK) {
+            FS_TRACE_ERROR("Minfs::Create failed to replay journal: %d\n", status);
+            return status;
+        }
+        if ((status = bc->Readblk(0, replayed_info)) != ZX_OK) {
+            FS_TRACE_ERROR("Minfs::Create failed to read superblock: %d\n", status);
+            return status;
+        }
+        info = reinterpret_cast<const Superblock*>(replayed_info);
+    }
+
     if ((status = SuperblockManager::Create(bc.get(), info, &sb)) != ZX_OK) {
         FS_TRACE_ERROR("Minfs::Create failed to initialize superblock: %d\n", status);
         return status;
@@ -770,8 +822,18 @@ zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const Superblock* info,
         return status;
     }
 
+    fbl::unique_ptr<Journal> journal;
+    if (info->flags & kMinfsFlagJournal) {
+        status = Journal::Create(bc.get(), *info, journal_sequence, &journal);
+        if (status != ZX_OK) {
+            FS_TRACE_ERROR("Minfs::Create failed to initialize journal: %d\n", status);
+            return status;
+        }
+    }
+
     fbl::unique_ptr<WritebackBuffer> writeback;
-    status = WritebackBuffer::Create(bc.get(), fbl::move(mapper), &writeback);
+    status = WritebackBuffer::Create(bc.get(), fbl::move(mapper), fbl::move(journal),
+                                     &writeback);
     if (status != ZX_OK) {
         return status;
     }
@@ -799,7 +861,8 @@ zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const Superblock* info,
     return ZX_OK;
 }
 
-zx_status_t GetRequiredBlockCount(size_t offset, size_t length, blk_t* num_req_blocks) {
+zx_status_t GetRequiredBlockCount(const Inode& inode, size_t offset, size_t length,
+                                  blk_t* num_req_blocks) {
     if (length == 0) {
         // Return early if no data needs to be written.
         *num_req_blocks = 0;
@@ -812,6 +875,20 @@ zx_status_t GetRequiredBlockCount(size_t offset, size_t length, blk_t* num_req_b
     blk_t last_direct = static_cast<blk_t>((offset + length - 1) / kMinfsBlockSize);
     blk_t reserve_blocks = last_direct - first_direct + 1;
 
+    if (inode.flags & kMinfsInodeFlagExtents) {
+        if (last_direct >= kMinfsMaxFileBlock) {
+            return ZX_ERR_OUT_OF_RANGE;
+        }
+        // Adding an extent may split a full node on each level of the tree, and grow the
+        // root by a level. Splits leave nodes half full, and a full node which is not new
+        // maps at least kMinfsExtentsPerNode blocks, so each level splits at most once for
+        // each quarter node of blocks in the range, and once at either end of it.
+        const blk_t levels = GetExtentRoot(&inode)->depth + 2;
+        *num_req_blocks = reserve_blocks +
+                          levels * (2 + reserve_blocks / (kMinfsExtentsPerNode / 4));
+        return ZX_OK;
+    }
+
     if (last_direct >= kMinfsDirect) {
         // If direct blocks go into indirect range, adjust the indices accordingly.
         first_direct = fbl::max(first_direct, kMinfsDirect) - kMinfsDirect;
@@ -927,7 +1004,6 @@ zx_status_t Mkfs(const MountOptions& options, fbl::unique_ptr<Bcache> bc) {
     memset(&info, 0x00, sizeof(info));
     info.magic0 = kMinfsMagic0;
     info.magic1 = kMinfsMagic1;
-    info.version = kMinfsVersion;
     info.flags = kMinfsFlagClean;
     info.block_size = kMinfsBlockSize;
     info.inode_size = kMinfsInodeSize;
@@ -1027,6 +1103,20 @@ zx_status_t Mkfs(const MountOptions& options, fbl::unique_ptr<Bcache> bc) {
         info.dat_block = kFVMBlockDataStart;
     }
 
+    // Reserve a journal, following the root directory, in proportion to the
+    // size of the data region.
+    const uint32_t journal_blocks = fbl::min(info.block_count / kMinfsJournalRatio,
+                                             kMinfsDefaultJournalBlocks);
+    if (options.journal && journal_blocks >= kMinfsMinimumJournalBlocks) {
+        info.flags |= kMinfsFlagJournal;
+        info.journal_block = 2;
+        info.journal_block_count = journal_blocks;
+    }
+    if (options.extents) {
+        info.flags |= kMinfsFlagExtents;
+    }
+    info.version = MinfsVersionForFlags(info.flags);
+
     DumpInfo(&info);
 
     RawBitmap abm;
@@ -1072,6 +1162,15 @@ zx_status_t Mkfs(const MountOptions& options, fbl::unique_ptr<Bcache> bc) {
     abm.Set(0, 2);
     info.alloc_block_count += 2;
 
+    if (info.flags & kMinfsFlagJournal) {
+        abm.Set(info.journal_block, info.journal_block + info.journal_block_count);
+        info.alloc_block_count += info.journal_block_count;
+        if ((status = InitJournal(bc.get(), info, 1)) != ZX_OK) {
+            FS_TRACE_ERROR("mkfs: Failed to write journal\n");
+            return status;
+        }
+    }
+
     // write allocation bitmap
     for (uint32_t n = 0; n < abmblks; n++) {
         void* bmdata = fs::GetBlock(kMinfsBlockSize, abm.StorageUnsafe()->GetData(), n);
@@ -1099,7 +1198,14 @@ zx_status_t Mkfs(const MountOptions& options, fbl::unique_ptr<Bcache> bc) {
     ino[kMinfsRootIno].block_count = 1;
     ino[kMinfsRootIno].link_count = 2;
     ino[kMinfsRootIno].dirent_count = 2;
-    ino[kMinfsRootIno].dnum[0] = 1;
+    if (info.flags & kMinfsFlagExtents) {
+        InitExtentRoot(&ino[kMinfsRootIno]);
+        ExtentHeader* root = GetExtentRoot(&ino[kMinfsRootIno]);
+        GetExtents(root)[0] = { 0, 1, 1 };
+        root->count = 1;
+    } else {
+        ino[kMinfsRootIno].dnum[0] = 1;
+    }
     bc->Writeblk(info.ino_block, blk);
 
     memset(blk, 0, sizeof(blk));
@@ -13,8 +13,11 @@ MODULE_COMPILEFLAGS += -fvisibility=hidden
 COMMON_SRCS := \
     $(LOCAL_DIR)/allocator.cpp \
     $(LOCAL_DIR)/bcache.cpp \
+    $(LOCAL_DIR)/directory-index.cpp \
+    $(LOCAL_DIR)/extent.cpp \
     $(LOCAL_DIR)/fsck.cpp \
     $(LOCAL_DIR)/inode-manager.cpp \
+    $(LOCAL_DIR)/journal.cpp \
     $(LOCAL_DIR)/minfs.cpp \
     $(LOCAL_DIR)/superblock.cpp \
     $(LOCAL_DIR)/vnode.cpp \
@@ -41,6 +44,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/zircon-internal \
     system/ulib/zx \
     system/ulib/zxcpp \
+    third_party/ulib/cksum \
 
 MODULE_LIBS := \
     system/ulib/async.default \
@@ -69,6 +73,7 @@ MODULE_HOST_COMPILEFLAGS := \
     -Isystem/ulib/fs/include \
     -Isystem/ulib/fzl/include \
     -Isystem/ulib/zxcpp/include \
+    -Ithird_party/ulib/cksum/include \
 
 # host minfs lib
 
@@ -85,5 +90,6 @@ MODULE_HEADER_DEPS += system/ulib/zircon-internal
 MODULE_HOST_LIBS := \
     system/ulib/fbl.hostlib \
     system/ulib/fs.hostlib \
+    third_party/ulib/cksum.hostlib \
 
 include make/module.mk
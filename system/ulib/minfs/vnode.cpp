@@ -75,6 +75,17 @@ zx_status_t NextDirent(Dirent* de, DirectoryOffset* offs) {
     return kDirIteratorNext;
 }
 
+// Returns true if another direntry could be added within the record of the direntry at |off|:
+// either because it is free, or because it is larger than its name requires.
+bool DirentHasSpace(Dirent* de, size_t off) {
+    if (de->ino == 0) {
+        return true;
+    }
+    uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, off));
+    uint32_t size = static_cast<uint32_t>(DirentSize(de->namelen));
+    return (reclen > size) && (reclen - size >= DirentSize(1));
+}
+
 #ifdef __Fuchsia__
 
 // MinfsConnection overrides the base Connection class to allow Minfs to
@@ -148,6 +159,18 @@ void VnodeMinfs::InodeSync(WritebackWork* wb, uint32_t flags) {
 // the file. Does not update mtime/atime.
 zx_status_t VnodeMinfs::BlocksShrink(Transaction* state, blk_t start) {
     ZX_DEBUG_ASSERT(state != nullptr);
+    if (IsExtentMapped()) {
+        const uint32_t block_count = inode_.block_count;
+        zx_status_t status;
+        if ((status = ExtentBlocksShrink(state->GetWork(), start)) != ZX_OK) {
+            return status;
+        }
+        if (inode_.block_count != block_count) {
+            InodeSync(state->GetWork(), kMxFsSyncDefault);
+        }
+        return ZX_OK;
+    }
+
     BlockOpArgs op_args(start, static_cast<blk_t>(kMinfsMaxFileBlock - start), nullptr);
     zx_status_t status;
     if ((status = ApplyOperation(state, BlockOp::kDelete, &op_args)) != ZX_OK) {
@@ -255,12 +278,15 @@ zx_status_t VnodeMinfs::InitIndirectVmo() {
 }
 
 // Since we cannot yet register the filesystem as a paging service (and cleanly
-// fault on pages when they are actually needed), we currently read an entire
-// file to a VMO when a file's data block are accessed.
+// fault on pages when they are actually needed), file data is read into a VMO
+// by the vnode itself. The VMO spans the whole file, but only the blocks which
+// have been accessed are read from disk; |vmo_loaded_| tracks which blocks of
+// the VMO hold the contents of the file.
 //
-// TODO(smklein): Even this hack can be optimized; a bitmap could be used to
-// track all 'empty/read/dirty' blocks for each vnode, rather than reading
-// the entire file.
+// The indirect blocks of the file are read up front, so that the blocks of any
+// range of the file can be found without further metadata reads. The nodes of
+// an extent tree are read as they are needed instead, since a file which is
+// mostly contiguous has few of them.
 zx_status_t VnodeMinfs::InitVmo() {
     if (vmo_.is_valid()) {
         return ZX_OK;
@@ -273,6 +299,9 @@ zx_status_t VnodeMinfs::InitVmo() {
         return status;
     }
     vmo_size_ = vmo_size;
+    vmo_loaded_.ClearAll();
+    read_next_ = 0;
+    readahead_blocks_ = 0;
 
     zx_object_set_property(vmo_.get(), ZX_PROP_NAME, "minfs-inode", 11);
 
@@ -280,7 +309,6 @@ zx_status_t VnodeMinfs::InitVmo() {
         vmo_.reset();
         return status;
     }
-    fs::ReadTxn txn(fs_->bc_.get());
     uint32_t dnum_count = 0;
     uint32_t inum_count = 0;
     uint32_t dinum_count = 0;
@@ -290,89 +318,82 @@ zx_status_t VnodeMinfs::InitVmo() {
                                ticker.End());
     });
 
-    // Initialize all direct blocks
-    blk_t bno;
+    if (IsExtentMapped()) {
+        ValidateVmoTail();
+        return ZX_OK;
+    }
+
     for (uint32_t d = 0; d < kMinfsDirect; d++) {
-        if ((bno = inode_.dnum[d]) != 0) {
-            fs_->ValidateBno(bno);
+        if (inode_.dnum[d] != 0) {
             dnum_count++;
-            txn.Enqueue(vmoid_, d, bno + fs_->Info().dat_block, 1);
         }
     }
-
-    // Initialize all indirect blocks
     for (uint32_t i = 0; i < kMinfsIndirect; i++) {
-        blk_t ibno;
-        if ((ibno = inode_.inum[i]) != 0) {
-            fs_->ValidateBno(ibno);
+        if (inode_.inum[i] != 0) {
             inum_count++;
-
-            // Only initialize the indirect vmo if it is being used.
-            if ((status = InitIndirectVmo()) != ZX_OK) {
-                vmo_.reset();
-                return status;
-            }
-
-            uint32_t* ientry;
-            ReadIndirectVmoBlock(i, &ientry);
-
-            for (uint32_t j = 0; j < kMinfsDirectPerIndirect; j++) {
-                if ((bno = ientry[j]) != 0) {
-                    fs_->ValidateBno(bno);
-                    uint32_t n = kMinfsDirect + i * kMinfsDirectPerIndirect + j;
-                    txn.Enqueue(vmoid_, n, bno + fs_->Info().dat_block, 1);
-                }
-            }
         }
     }
-
-    // Initialize all doubly indirect blocks
     for (uint32_t i = 0; i < kMinfsDoublyIndirect; i++) {
-        blk_t dibno;
-
-        if ((dibno = inode_.dinum[i]) != 0) {
-            fs_->ValidateBno(dibno);
+        if (inode_.dinum[i] != 0) {
             dinum_count++;
+        }
+    }
 
-            // Only initialize the doubly indirect vmo if it is being used.
-            if ((status = InitIndirectVmo()) != ZX_OK) {
+    // Load the indirect blocks, and the indirect blocks within each doubly
+    // indirect block.
+    if (inum_count != 0 || dinum_count != 0) {
+        if ((status = InitIndirectVmo()) != ZX_OK) {
+            vmo_.reset();
+            return status;
+        }
+    }
+    for (uint32_t i = 0; i < kMinfsDoublyIndirect; i++) {
+        if (inode_.dinum[i] != 0) {
+            fs_->ValidateBno(inode_.dinum[i]);
+            if ((status = LoadIndirectWithinDoublyIndirect(i)) != ZX_OK) {
                 vmo_.reset();
                 return status;
             }
-
-            uint32_t* dientry;
-            ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(i), &dientry);
-
-            for (uint32_t j = 0; j < kMinfsDirectPerIndirect; j++) {
-                blk_t ibno;
-                if ((ibno = dientry[j]) != 0) {
-                    fs_->ValidateBno(ibno);
-
-                    // Only initialize the indirect vmo if it is being used.
-                    if ((status = LoadIndirectWithinDoublyIndirect(i)) != ZX_OK) {
-                        vmo_.reset();
-                        return status;
-                    }
-
-                    uint32_t* ientry;
-                    ReadIndirectVmoBlock(GetVmoOffsetForIndirect(i) + j, &ientry);
-
-                    for (uint32_t k = 0; k < kMinfsDirectPerIndirect; k++) {
-                        if ((bno = ientry[k]) != 0) {
-                            fs_->ValidateBno(bno);
-                            uint32_t n = kMinfsDirect + kMinfsIndirect * kMinfsDirectPerIndirect
-                                         + j * kMinfsDirectPerIndirect + k;
-                            txn.Enqueue(vmoid_, n, bno + fs_->Info().dat_block, 1);
-                        }
-                    }
-                }
-            }
         }
     }
 
-    status = txn.Transact();
     ValidateVmoTail();
-    return status;
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::LoadVmoBlocks(blk_t start, blk_t end) {
+    size_t first_unloaded;
+    if (vmo_loaded_.Get(start, end, &first_unloaded)) {
+        return ZX_OK;
+    }
+    start = static_cast<blk_t>(first_unloaded);
+    TRACE_DURATION("minfs", "VnodeMinfs::LoadVmoBlocks", "start", start, "end", end);
+
+    // Blocks which are already loaded may hold writes which are newer than
+    // the contents of the disk, so they are skipped. Contiguous blocks are
+    // merged into a single request by the transaction.
+    fs::ReadTxn txn(fs_->bc_.get());
+    for (blk_t n = start; n < end; n++) {
+        if (vmo_loaded_.Get(n, n + 1)) {
+            continue;
+        }
+        blk_t bno;
+        zx_status_t status;
+        if ((status = BlockGet(nullptr, n, &bno)) != ZX_OK) {
+            return status;
+        }
+        // Holes in the file are left as zeroes in the VMO.
+        if (bno != 0) {
+            fs_->ValidateBno(bno);
+            txn.Enqueue(vmoid_, n, bno + fs_->Info().dat_block, 1);
+        }
+    }
+
+    zx_status_t status;
+    if ((status = txn.Transact()) != ZX_OK) {
+        return status;
+    }
+    return vmo_loaded_.Set(start, end);
 }
 #endif
 
@@ -384,7 +405,8 @@ void VnodeMinfs::AllocateIndirect(Transaction* state, blk_t index, IndirectArgs*
 
     // allocate new indirect block
     blk_t bno;
-    fs_->BlockNew(state, &bno);
+    fs_->BlockNew(state, alloc_goal_, &bno);
+    alloc_goal_ = bno + 1;
 
 #ifdef __Fuchsia__
     ClearIndirectVmoBlock(args->GetOffset() + index);
@@ -413,7 +435,8 @@ zx_status_t VnodeMinfs::BlockOpDirect(Transaction* state, DirectArgs* params) {
             case BlockOp::kWrite: {
                 ZX_DEBUG_ASSERT(state != nullptr);
                 if (bno == 0) {
-                    fs_->BlockNew(state, &bno);
+                    fs_->BlockNew(state, alloc_goal_, &bno);
+                    alloc_goal_ = bno + 1;
                     inode_.block_count++;
                 }
 
@@ -692,6 +715,10 @@ zx_status_t VnodeMinfs::ApplyOperation(Transaction* state, BlockOp op, BlockOpAr
 }
 
 zx_status_t VnodeMinfs::BlockGet(Transaction* state, blk_t n, blk_t* bno) {
+    if (IsExtentMapped()) {
+        return ExtentBlockGet(state, n, bno);
+    }
+
 #ifdef __Fuchsia__
     if (n >= kMinfsDirect) {
         zx_status_t status;
@@ -781,6 +808,7 @@ zx_status_t VnodeMinfs::UnlinkChild(Transaction* state,
     size_t off = offs->off;
     size_t off_next = off + MinfsReclen(de, off);
     Dirent de_prev, de_next;
+    bool merged_next = false;
     zx_status_t status;
 
     // Read the direntries we're considering merging with.
@@ -798,6 +826,7 @@ zx_status_t VnodeMinfs::UnlinkChild(Transaction* state,
             return status;
         }
         if (de_next.ino == 0) {
+            merged_next = true;
             coalesced_size += MinfsReclen(&de_next, off_next);
             // If the next entry *was* last, then 'de' is now last.
             de->reclen |= (de_next.reclen & kMinfsReclenLast);
@@ -831,6 +860,19 @@ zx_status_t VnodeMinfs::UnlinkChild(Transaction* state,
         return status;
     }
 
+    if (index_ != nullptr) {
+        index_->RemoveEntry(fbl::StringPiece(de->name, de->namelen), offs->off);
+        if (merged_next) {
+            index_->RemoveSpace(off_next);
+        }
+        if (off != offs->off) {
+            // Merged into the previous dirent, which is already free.
+            index_->RemoveSpace(offs->off);
+        } else if (index_->AddSpace(off) != ZX_OK) {
+            index_.reset();
+        }
+    }
+
     if (de->reclen & kMinfsReclenLast) {
         // Truncating the directory merely removed unused space; if it fails,
         // the directory contents are still valid.
@@ -999,6 +1041,21 @@ zx_status_t VnodeMinfs::DirentCallbackFindSpace(fbl::RefPtr<VnodeMinfs> vndir, D
     }
 }
 
+zx_status_t VnodeMinfs::DirentCallbackIndex(fbl::RefPtr<VnodeMinfs> vndir, Dirent* de,
+                                            DirArgs* args) {
+    zx_status_t status;
+    if ((de->ino != 0) &&
+        (status = vndir->index_->AddEntry(fbl::StringPiece(de->name, de->namelen),
+                                          args->offs.off)) != ZX_OK) {
+        return status;
+    }
+    if (DirentHasSpace(de, args->offs.off) &&
+        (status = vndir->index_->AddSpace(args->offs.off)) != ZX_OK) {
+        return status;
+    }
+    return NextDirent(de, &args->offs);
+}
+
 zx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
     char data[kMinfsMaxDirentSize];
     Dirent* de = reinterpret_cast<Dirent*>(data);
@@ -1010,6 +1067,7 @@ zx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
         return status;
     }
 
+    const size_t orig_off = args->offs.off;
     uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, args->offs.off));
     if (de->ino == 0) {
         // empty entry, do we fit?
@@ -1047,9 +1105,20 @@ zx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
     memcpy(de->name, args->name.data(), de->namelen);
     if ((status = WriteExactInternal(args->state, de, DirentSize(de->namelen),
                                      args->offs.off)) != ZX_OK) {
+        // The existing entry may have been shrunk; rebuild the index on next use.
+        index_.reset();
         return status;
     }
 
+    if (index_ != nullptr) {
+        index_->RemoveSpace(orig_off);
+        if ((DirentHasSpace(de, args->offs.off) &&
+             index_->AddSpace(args->offs.off) != ZX_OK) ||
+            index_->AddEntry(args->name, args->offs.off) != ZX_OK) {
+            index_.reset();
+        }
+    }
+
     if (args->type == kMinfsTypeDir) {
         // Child directory has '..' which will point to parent directory
         inode_.link_count++;
@@ -1106,6 +1175,118 @@ zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
     return ZX_ERR_NOT_FOUND;
 }
 
+bool VnodeMinfs::UseDirectoryIndex() {
+    if (index_ != nullptr) {
+        return true;
+    } else if (inode_.size < kMinfsDirectoryIndexMinSize) {
+        return false;
+    }
+
+    TRACE_DURATION("minfs", "VnodeMinfs::UseDirectoryIndex", "size", inode_.size);
+    fbl::AllocChecker ac;
+    index_.reset(new (&ac) DirectoryIndex());
+    if (!ac.check()) {
+        return false;
+    }
+    DirArgs args = DirArgs();
+    zx_status_t status = ForEachDirent(&args, DirentCallbackIndex);
+    if (status != ZX_ERR_NOT_FOUND) {
+        // Either the directory could not be read, or the index could not be allocated.
+        // Fall back to reading the directory.
+        FS_TRACE_WARN("minfs: Failed to index directory #%u: %d\n", ino_, status);
+        index_.reset();
+        return false;
+    }
+    return true;
+}
+
+zx_status_t VnodeMinfs::LookupDirent(DirArgs* args, const DirentCallback func) {
+    if (!UseDirectoryIndex()) {
+        return ForEachDirent(args, func);
+    }
+
+    char data[kMinfsMaxDirentSize];
+    Dirent* de = reinterpret_cast<Dirent*>(data);
+    const uint32_t hash = DirectoryIndex::Hash(args->name);
+    size_t cursor = 0;
+    size_t off;
+    while (index_->FindEntry(hash, &cursor, &off)) {
+        size_t r;
+        zx_status_t status = ReadInternal(data, kMinfsMaxDirentSize, off, &r);
+        if (status != ZX_OK) {
+            return status;
+        } else if ((status = ValidateDirent(de, r, off)) != ZX_OK) {
+            return status;
+        } else if ((de->ino == 0) || fbl::StringPiece(de->name, de->namelen) != args->name) {
+            continue;
+        }
+
+        // The callback may unlink the direntry, which requires the offset of the previous
+        // direntry if that one is free.
+        args->offs.off = off;
+        args->offs.off_prev = off;
+        size_t off_prev;
+        if (index_->FindSpaceBefore(off, &off_prev)) {
+            Dirent de_prev;
+            if ((status = ReadExactInternal(&de_prev, MINFS_DIRENT_SIZE, off_prev)) != ZX_OK) {
+                return status;
+            } else if ((status = ValidateDirent(&de_prev, MINFS_DIRENT_SIZE,
+                                                off_prev)) != ZX_OK) {
+                return status;
+            }
+            if ((de_prev.ino == 0) && (off_prev + MinfsReclen(&de_prev, off_prev) == off)) {
+                args->offs.off_prev = off_prev;
+            }
+        }
+
+        switch ((status = func(fbl::RefPtr<VnodeMinfs>(this), de, args))) {
+        case kDirIteratorNext:
+            break;
+        case kDirIteratorSaveSync:
+            inode_.seq_num++;
+            InodeSync(args->state->GetWork(), kMxFsSyncMtime);
+            args->state->GetWork()->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
+            return ZX_OK;
+        case kDirIteratorDone:
+        default:
+            return status;
+        }
+    }
+
+    return ZX_ERR_NOT_FOUND;
+}
+
+zx_status_t VnodeMinfs::FindDirentSpace(DirArgs* args) {
+    if (!UseDirectoryIndex()) {
+        return ForEachDirent(args, DirentCallbackFindSpace);
+    }
+
+    // Only the header of each direntry is needed to check whether it has enough space.
+    Dirent de;
+    for (size_t i = 0; i < index_->SpaceCount(); i++) {
+        const size_t off = index_->SpaceAt(i);
+        zx_status_t status = ReadExactInternal(&de, MINFS_DIRENT_SIZE, off);
+        if (status != ZX_OK) {
+            return status;
+        } else if ((status = ValidateDirent(&de, MINFS_DIRENT_SIZE, off)) != ZX_OK) {
+            return status;
+        }
+
+        args->offs.off = off;
+        args->offs.off_prev = off;
+        switch ((status = DirentCallbackFindSpace(fbl::RefPtr<VnodeMinfs>(this), &de, args))) {
+        case kDirIteratorNext:
+            break;
+        case kDirIteratorDone:
+            return ZX_OK;
+        default:
+            return status;
+        }
+    }
+
+    return ZX_ERR_NOT_FOUND;
+}
+
 void VnodeMinfs::fbl_recycle() {
     ZX_DEBUG_ASSERT(fd_count_ == 0);
     if (!IsUnlinked()) {
@@ -1231,11 +1412,36 @@ zx_status_t VnodeMinfs::ReadInternal(void* data, size_t len, size_t off, size_t*
 #ifdef __Fuchsia__
     if ((status = InitVmo()) != ZX_OK) {
         return status;
-    } else if ((status = vmo_.read(data, off, len)) != ZX_OK) {
-        return status;
+    }
+
+    // A read which starts where the previous one ended doubles the readahead
+    // window; any other read disables readahead until the reader becomes
+    // sequential again.
+    if (off == read_next_) {
+        readahead_blocks_ = fbl::clamp(readahead_blocks_ * 2, kMinfsMinReadaheadBlocks,
+                                       kMinfsMaxReadaheadBlocks);
     } else {
-        *actual = len;
+        readahead_blocks_ = 0;
+    }
+    read_next_ = off + len;
+
+    // Load the requested blocks and the window following them, once less
+    // than half of the window has been loaded already, so that the window
+    // is filled by a few large requests rather than one block at a time.
+    const blk_t file_blocks = static_cast<blk_t>(vmo_size_ / kMinfsBlockSize);
+    const blk_t start = static_cast<blk_t>(off / kMinfsBlockSize);
+    const blk_t end = static_cast<blk_t>(fbl::round_up(off + len, kMinfsBlockSize) /
+                                         kMinfsBlockSize);
+    const blk_t mark = fbl::min(end + readahead_blocks_ / 2, file_blocks);
+    if (!vmo_loaded_.Get(start, mark) &&
+        (status = LoadVmoBlocks(start, fbl::min(end + readahead_blocks_, file_blocks))) != ZX_OK) {
+        return status;
+    }
+
+    if ((status = vmo_.read(data, off, len)) != ZX_OK) {
+        return status;
     }
+    *actual = len;
 #else
     void* start = data;
     uint32_t n = off / kMinfsBlockSize;
@@ -1292,7 +1498,7 @@ zx_status_t VnodeMinfs::Write(const void* data, size_t len, size_t offset,
 
     blk_t reserve_blocks;
     // Calculate maximum number of blocks to reserve for this write operation.
-    zx_status_t status = GetRequiredBlockCount(offset, len, &reserve_blocks);
+    zx_status_t status = GetRequiredBlockCount(inode_, offset, len, &reserve_blocks);
     if (status != ZX_OK) {
         return status;
     }
@@ -1359,10 +1565,19 @@ zx_status_t VnodeMinfs::WriteInternal(Transaction* state, const void* data,
             vmo_size_ = new_size;
         }
 
+        // A partial write must not discard the rest of the block, so the block
+        // is loaded before it is modified.
+        if ((xfer < kMinfsBlockSize) && (status = LoadVmoBlocks(n, n + 1)) != ZX_OK) {
+            goto done;
+        }
+
         // Update this block of the in-memory VMO
         if ((status = vmo_.write(data, xfer_off, xfer)) != ZX_OK) {
             goto done;
         }
+        if ((status = vmo_loaded_.Set(n, n + 1)) != ZX_OK) {
+            goto done;
+        }
 
         // Update this block on-disk
         blk_t bno;
@@ -1370,7 +1585,11 @@ zx_status_t VnodeMinfs::WriteInternal(Transaction* state, const void* data,
             goto done;
         }
         ZX_DEBUG_ASSERT(bno != 0);
-        state->GetWork()->Enqueue(vmo_.get(), n, bno + fs_->Info().dat_block, 1);
+        if (IsDirectory()) {
+            state->GetWork()->Enqueue(vmo_.get(), n, bno + fs_->Info().dat_block, 1);
+        } else {
+            state->GetWork()->EnqueueData(vmo_.get(), n, bno + fs_->Info().dat_block, 1);
+        }
 #else
         blk_t bno;
         if ((status = BlockGet(state, n, &bno))) {
@@ -1438,7 +1657,7 @@ zx_status_t VnodeMinfs::LookupInternal(fbl::RefPtr<fs::Vnode>* out, fbl::StringP
     auto get_metrics = fbl::MakeAutoCall([&ticker, &success, this]() {
         fs_->UpdateLookupMetrics(success, ticker.End());
     });
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) < 0) {
+    if ((status = LookupDirent(&args, DirentCallbackFind)) < 0) {
         return status;
     }
     fbl::RefPtr<VnodeMinfs> vn;
@@ -1593,6 +1812,9 @@ void VnodeMinfs::Allocate(Minfs* fs, uint32_t type, fbl::RefPtr<VnodeMinfs>* out
     (*out)->inode_.magic = MinfsMagic(type);
     (*out)->inode_.create_time = (*out)->inode_.modify_time = GetTimeUTC();
     (*out)->inode_.link_count = (type == kMinfsTypeDir ? 2 : 1);
+    if (fs->Info().flags & kMinfsFlagExtents) {
+        InitExtentRoot(&(*out)->inode_);
+    }
 }
 
 zx_status_t VnodeMinfs::Recreate(Minfs* fs, ino_t ino, fbl::RefPtr<VnodeMinfs>* out) {
@@ -1627,7 +1849,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     args.name = name;
     // ensure file does not exist
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
+    if ((status = LookupDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
         return ZX_ERR_ALREADY_EXISTS;
     }
 
@@ -1638,7 +1860,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     // before updating any other metadata.
     args.type = type;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
-    status = ForEachDirent(&args, DirentCallbackFindSpace);
+    status = FindDirentSpace(&args);
     if (status == ZX_ERR_NOT_FOUND) {
         return ZX_ERR_NO_SPACE;
     } else if (status != ZX_OK) {
@@ -1648,7 +1870,8 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     // Calculate maximum blocks to reserve for the current directory, based on the size and offset
     // of the new direntry (Assuming that the offset is the current size of the directory).
     blk_t reserve_blocks = 0;
-    if ((status = GetRequiredBlockCount(inode_.size, args.reclen, &reserve_blocks)) != ZX_OK) {
+    if ((status = GetRequiredBlockCount(inode_, inode_.size, args.reclen,
+                                        &reserve_blocks)) != ZX_OK) {
         return status;
     }
 
@@ -1760,7 +1983,7 @@ zx_status_t VnodeMinfs::Unlink(fbl::StringPiece name, bool must_be_dir) {
     args.name = name;
     args.type = must_be_dir ? kMinfsTypeDir : 0;
     args.state = state.get();
-    status = ForEachDirent(&args, DirentCallbackUnlink);
+    status = LookupDirent(&args, DirentCallbackUnlink);
     if (status == ZX_OK) {
         state->GetWork()->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
         fs_->CommitTransaction(fbl::move(state));
@@ -1796,8 +2019,6 @@ zx_status_t VnodeMinfs::Truncate(size_t len) {
 zx_status_t VnodeMinfs::TruncateInternal(Transaction* state, size_t len) {
     zx_status_t r = 0;
 #ifdef __Fuchsia__
-    // TODO(smklein): We should only init up to 'len'; no need
-    // to read in the portion of a large file we plan on deleting.
     if ((r = InitVmo()) != ZX_OK) {
         FS_TRACE_ERROR("minfs: Truncate failed to initialize VMO: %d\n", r);
         return ZX_ERR_IO;
@@ -1842,6 +2063,10 @@ zx_status_t VnodeMinfs::TruncateInternal(Transaction* state, size_t len) {
             if (bno != 0) {
                 size_t adjust = len % kMinfsBlockSize;
 #ifdef __Fuchsia__
+                if ((r = LoadVmoBlocks(rel_bno, rel_bno + 1)) != ZX_OK) {
+                    FS_TRACE_ERROR("minfs: Truncate failed to load last block: %d\n", r);
+                    return ZX_ERR_IO;
+                }
                 if ((r = vmo_.read(bdata, len - adjust, adjust)) != ZX_OK) {
                     FS_TRACE_ERROR("minfs: Truncate failed to read last block: %d\n", r);
                     return ZX_ERR_IO;
@@ -1852,7 +2077,13 @@ zx_status_t VnodeMinfs::TruncateInternal(Transaction* state, size_t len) {
                     FS_TRACE_ERROR("minfs: Truncate failed to write last block: %d\n", r);
                     return ZX_ERR_IO;
                 }
-                state->GetWork()->Enqueue(vmo_.get(), rel_bno, bno + fs_->Info().dat_block, 1);
+                if (IsDirectory()) {
+                    state->GetWork()->Enqueue(vmo_.get(), rel_bno,
+                                              bno + fs_->Info().dat_block, 1);
+                } else {
+                    state->GetWork()->EnqueueData(vmo_.get(), rel_bno,
+                                                  bno + fs_->Info().dat_block, 1);
+                }
 #else
                 if (fs_->bc_->Readblk(bno + fs_->Info().dat_block, bdata)) {
                     return ZX_ERR_IO;
@@ -1928,7 +2159,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     // acquire the 'oldname' node (it must exist)
     DirArgs args = DirArgs();
     args.name = oldname;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) < 0) {
+    if ((status = LookupDirent(&args, DirentCallbackFind)) < 0) {
         return status;
     } else if ((status = fs_->VnodeGet(&oldvn, args.ino)) < 0) {
         return status;
@@ -1951,7 +2182,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     args.type = oldvn->IsDirectory() ? kMinfsTypeDir : kMinfsTypeFile;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(newname.length())));
 
-    status = newdir->ForEachDirent(&args, DirentCallbackFindSpace);
+    status = newdir->FindDirentSpace(&args);
     if (status == ZX_ERR_NOT_FOUND) {
         return ZX_ERR_NO_SPACE;
     } else if (status != ZX_OK) {
@@ -1962,8 +2193,8 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
 
     // Reserve potential blocks to add a new direntry to newdir.
     blk_t reserved_blocks;
-    if ((status = GetRequiredBlockCount(newdir->GetInode()->size, args.reclen, &reserved_blocks))
-        != ZX_OK) {
+    if ((status = GetRequiredBlockCount(*newdir->GetInode(), newdir->GetInode()->size,
+                                        args.reclen, &reserved_blocks)) != ZX_OK) {
         return status;
     }
 
@@ -1977,7 +2208,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     args.state = state.get();
     args.name = newname;
     args.ino = oldvn->ino_;
-    status = newdir->ForEachDirent(&args, DirentCallbackAttemptRename);
+    status = newdir->LookupDirent(&args, DirentCallbackAttemptRename);
     if (status == ZX_ERR_NOT_FOUND) {
         // if 'newname' does not exist, create it
         args.offs = append_offs;
@@ -1998,7 +2229,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
         auto vn = fbl::RefPtr<VnodeMinfs>::Downcast(vn_fs);
         args.name = "..";
         args.ino = newdir->ino_;
-        if ((status = vn->ForEachDirent(&args, DirentCallbackUpdateInode)) < 0) {
+        if ((status = vn->LookupDirent(&args, DirentCallbackUpdateInode)) < 0) {
             return status;
         }
     }
@@ -2009,7 +2240,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
 
     // finally, remove oldname from its original position
     args.name = oldname;
-    if ((status = ForEachDirent(&args, DirentCallbackForceUnlink)) != ZX_OK) {
+    if ((status = LookupDirent(&args, DirentCallbackForceUnlink)) != ZX_OK) {
         return status;
     }
     state->GetWork()->PinVnode(oldvn);
@@ -2039,7 +2270,7 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
     DirArgs args = DirArgs();
     args.name = name;
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
+    if ((status = LookupDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
         return (status == ZX_OK) ? ZX_ERR_ALREADY_EXISTS : status;
     }
 
@@ -2047,7 +2278,7 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
     // before updating any other metadata.
     args.type = kMinfsTypeFile; // We can't hard link directories
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
-    status = ForEachDirent(&args, DirentCallbackFindSpace);
+    status = FindDirentSpace(&args);
     if (status == ZX_ERR_NOT_FOUND) {
         return ZX_ERR_NO_SPACE;
     } else if (status != ZX_OK) {
@@ -2056,8 +2287,8 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
 
     // Reserve potential blocks to write a new direntry.
     blk_t reserved_blocks;
-    if ((status = GetRequiredBlockCount(GetInode()->size, args.reclen, &reserved_blocks))
-        != ZX_OK) {
+    if ((status = GetRequiredBlockCount(*GetInode(), GetInode()->size, args.reclen,
+                                        &reserved_blocks)) != ZX_OK) {
         return status;
     }
 
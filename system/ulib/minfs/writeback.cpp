@@ -30,9 +30,19 @@ namespace minfs {
 
 void WriteTxn::Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
                        uint64_t nblocks) {
+    EnqueueRequest(vmo, vmo_offset, dev_offset, nblocks, false);
+}
+
+void WriteTxn::EnqueueData(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                           uint64_t nblocks) {
+    EnqueueRequest(vmo, vmo_offset, dev_offset, nblocks, true);
+}
+
+void WriteTxn::EnqueueRequest(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                              uint64_t nblocks, bool data) {
     ValidateVmoSize(vmo, static_cast<blk_t>(vmo_offset));
     for (size_t i = 0; i < requests_.size(); i++) {
-        if (requests_[i].vmo != vmo) {
+        if (requests_[i].vmo != vmo || requests_[i].data != data) {
             continue;
         }
 
@@ -57,6 +67,7 @@ void WriteTxn::Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset
     request.vmo_offset = vmo_offset;
     request.dev_offset = dev_offset;
     request.length = nblocks;
+    request.data = data;
     requests_.push_back(fbl::move(request));
 }
 
@@ -118,7 +129,13 @@ void WritebackWork::Reset() {
 // consumed
 size_t WritebackWork::Complete(zx_handle_t vmo, vmoid_t vmoid) {
     size_t blk_count = BlkCount();
-    zx_status_t status = Flush(vmo, vmoid);
+    Finish(Flush(vmo, vmoid));
+    return blk_count;
+}
+
+size_t WritebackWork::Finish(zx_status_t status) {
+    size_t blk_count = BlkCount();
+    Requests().reset();
     if (closure_) {
         closure_(status);
     }
@@ -153,8 +170,10 @@ void WritebackWork::PinVnode(fbl::RefPtr<VnodeMinfs> vn) {
 #ifdef __Fuchsia__
 
 zx_status_t WritebackBuffer::Create(Bcache* bc, fzl::OwnedVmoMapper mapper,
+                                    fbl::unique_ptr<Journal> journal,
                                     fbl::unique_ptr<WritebackBuffer>* out) {
-    fbl::unique_ptr<WritebackBuffer> wb(new WritebackBuffer(bc, fbl::move(mapper)));
+    fbl::unique_ptr<WritebackBuffer> wb(new WritebackBuffer(bc, fbl::move(mapper),
+                                                            fbl::move(journal)));
     if (wb->mapper_.size() % kMinfsBlockSize != 0) {
         return ZX_ERR_INVALID_ARGS;
     } else if (cnd_init(&wb->consumer_cvar_) != thrd_success) {
@@ -175,9 +194,10 @@ zx_status_t WritebackBuffer::Create(Bcache* bc, fzl::OwnedVmoMapper mapper,
     return ZX_OK;
 }
 
-WritebackBuffer::WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper) :
+WritebackBuffer::WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper,
+                                 fbl::unique_ptr<Journal> journal) :
     bc_(bc), unmounting_(false), mapper_(fbl::move(mapper)),
-    cap_(mapper_.size() / kMinfsBlockSize) {}
+    cap_(mapper_.size() / kMinfsBlockSize), journal_(fbl::move(journal)) {}
 
 WritebackBuffer::~WritebackBuffer() {
     // Block until the background thread completes itself.
@@ -270,6 +290,7 @@ void WritebackBuffer::CopyToBufferLocked(WriteTxn* txn) {
             request.vmo_offset = 0;
             request.dev_offset = dev_offset;
             request.length = wb_len;
+            request.data = reqs[i].data;
             i++;
             reqs.insert(i, request);
         }
@@ -310,12 +331,41 @@ void WritebackBuffer::Enqueue(fbl::unique_ptr<WritebackWork> work) {
     cnd_signal(&consumer_cvar_);
 }
 
+void WritebackBuffer::CommitGroupLocked() {
+    TRACE_DURATION("minfs", "WritebackBuffer::CommitGroupLocked");
+    WorkQueue group;
+    while (!work_queue_.is_empty() && journal_->Add(&work_queue_.front())) {
+        group.push(work_queue_.pop());
+    }
+
+    // Stay unlocked while writing the group, so that producers may keep
+    // filling the writeback buffer with the next one.
+    writeback_lock_.Release();
+    zx_status_t status = journal_->Commit(buffer_vmoid_, mapper_.start());
+    size_t blks_consumed = 0;
+    while (!group.is_empty()) {
+        auto work = group.pop();
+        blks_consumed += work->Finish(status);
+        TRACE_FLOW_END("minfs", "writeback", reinterpret_cast<trace_flow_id_t>(work.get()));
+    }
+
+    writeback_lock_.Acquire();
+    start_ = (start_ + blks_consumed) % cap_;
+    len_ -= blks_consumed;
+    cnd_signal(&producer_cvar_);
+}
+
 int WritebackBuffer::WritebackThread(void* arg) {
     WritebackBuffer* b = reinterpret_cast<WritebackBuffer*>(arg);
 
     b->writeback_lock_.Acquire();
     while (true) {
         while (!b->work_queue_.is_empty()) {
+            if (b->journal_ != nullptr) {
+                b->CommitGroupLocked();
+                continue;
+            }
+
             auto work = b->work_queue_.pop();
             TRACE_DURATION("minfs", "WritebackBuffer::WritebackThread");
 
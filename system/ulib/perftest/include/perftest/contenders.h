@@ -0,0 +1,58 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <threads.h>
+
+#include <fbl/atomic.h>
+#include <fbl/function.h>
+#include <fbl/vector.h>
+#include <zircon/assert.h>
+
+namespace perftest {
+
+// Background threads that call a function in a loop until destroyed, to
+// contend with the thread being measured (for locks in the kernel, or for
+// the cache lines of a shared data structure).
+class Contenders {
+public:
+    Contenders(uint32_t count, fbl::Function<void()> func)
+        : func_(fbl::move(func)) {
+        for (uint32_t i = 0; i < count; ++i) {
+            thrd_t thread;
+            ZX_ASSERT(thrd_create(&thread, ThreadFunc, this) == thrd_success);
+            threads_.push_back(thread);
+        }
+        // Wait for every contender to be running so that the first
+        // iterations of the measured loop are contended too.
+        while (started_.load() != count) {
+            thrd_yield();
+        }
+    }
+
+    ~Contenders() {
+        stop_.store(true);
+        for (auto& thread : threads_) {
+            ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+        }
+    }
+
+private:
+    static int ThreadFunc(void* arg) {
+        auto* self = static_cast<Contenders*>(arg);
+        self->started_.fetch_add(1);
+        while (!self->stop_.load(fbl::memory_order_relaxed)) {
+            self->func_();
+        }
+        return 0;
+    }
+
+    const fbl::Function<void()> func_;
+    fbl::Vector<thrd_t> threads_;
+    fbl::atomic<uint32_t> started_{0};
+    fbl::atomic<bool> stop_{false};
+};
+
+} // namespace perftest
@@ -31,6 +31,9 @@ struct SummaryStatistics {
     double mean;
     double std_dev;
     double median;
+    // Half the width of the 95% confidence interval for the mean, using
+    // Student's t distribution.  Zero if there are fewer than two values.
+    double ci95;
 };
 
 // This represents the results for a particular test case.  It contains a
@@ -52,6 +55,11 @@ struct TestCaseResults {
 
     SummaryStatistics GetSummaryStatistics() const;
 
+    // Removes values outside Tukey's fences (more than 1.5 times the
+    // interquartile range beyond the first or third quartile), keeping the
+    // remaining values in order.  Returns the number of values removed.
+    size_t RejectOutliers();
+
     fbl::String test_suite;
     fbl::String label;
     fbl::String unit;
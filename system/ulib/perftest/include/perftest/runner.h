@@ -20,17 +20,54 @@ struct NamedTest {
 
 typedef fbl::Vector<NamedTest> TestList;
 
+// Bounds on the number of runs picked by calibration.
+constexpr uint32_t kMinCalibratedRunCount = 10;
+constexpr uint32_t kMaxCalibratedRunCount = 100000;
+// Number of runs used to time a test for calibration when no warm-up runs
+// were requested.
+constexpr uint32_t kCalibrationRunCount = 10;
+
+// Controls how each test is repeated.
+struct RunOptions {
+    // Number of runs to record.
+    uint32_t run_count = 1000;
+    // Number of runs to do and discard before recording, so that caches,
+    // TLBs and lazily allocated memory are warm.
+    uint32_t warmup_count = 0;
+    // If non-zero, replaces run_count with the number of runs that takes
+    // about this long, as timed by the warm-up runs.
+    double target_seconds = 0;
+    // Whether to drop outliers from the recorded times; see
+    // TestCaseResults::RejectOutliers().
+    bool reject_outliers = false;
+};
+
 bool RunTests(const char* test_suite, TestList* test_list,
-              uint32_t run_count, const char* regex_string,
+              const RunOptions& options, const char* regex_string,
               FILE* log_stream, ResultsSet* results_set);
 
+inline bool RunTests(const char* test_suite, TestList* test_list,
+                     uint32_t run_count, const char* regex_string,
+                     FILE* log_stream, ResultsSet* results_set) {
+    RunOptions options;
+    options.run_count = run_count;
+    return RunTests(test_suite, test_list, options, regex_string, log_stream,
+                    results_set);
+}
+
+// Picks the number of runs that will take about |target_seconds| for a test
+// whose runs take |ns_per_run| each.
+uint32_t CalibrateRunCount(double ns_per_run, double target_seconds);
+
 struct CommandArgs {
     const char* output_filename = nullptr;
     // Note that this default matches any string.
     const char* filter_regex = "";
-    uint32_t run_count = 1000;
+    RunOptions run_options;
     bool enable_tracing = false;
     double startup_delay_seconds = 0;
+    // The cpu to run the tests on, or -1 to let the scheduler decide.
+    int32_t cpu = -1;
 };
 
 void ParseCommandArgs(int argc, char** argv, CommandArgs* dest);
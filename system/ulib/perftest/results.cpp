@@ -49,14 +49,17 @@ int CompareDoubles(const void* ptr1, const void* ptr2) {
     return 0;
 }
 
-double Median(const fbl::Vector<double>& values) {
-    // Make a sorted copy of the vector.
-    fbl::Vector<double> copy;
-    copy.reserve(values.size());
+void SortedCopy(const fbl::Vector<double>& values, fbl::Vector<double>* copy) {
+    copy->reserve(values.size());
     for (double value : values) {
-        copy.push_back(value);
+        copy->push_back(value);
     }
-    qsort(copy.get(), copy.size(), sizeof(copy[0]), CompareDoubles);
+    qsort(copy->get(), copy->size(), sizeof((*copy)[0]), CompareDoubles);
+}
+
+double Median(const fbl::Vector<double>& values) {
+    fbl::Vector<double> copy;
+    SortedCopy(values, &copy);
 
     size_t index = copy.size() / 2;
     // Interpolate two values if necessary.
@@ -66,6 +69,46 @@ double Median(const fbl::Vector<double>& values) {
     return copy[index];
 }
 
+// Returns the |fraction| quantile of the sorted |values|, interpolating
+// linearly between the closest ranks.
+double Quantile(const fbl::Vector<double>& sorted, double fraction) {
+    double pos = fraction * static_cast<double>(sorted.size() - 1);
+    size_t index = static_cast<size_t>(pos);
+    if (index + 1 >= sorted.size()) {
+        return sorted[sorted.size() - 1];
+    }
+    double weight = pos - static_cast<double>(index);
+    return sorted[index] * (1 - weight) + sorted[index + 1] * weight;
+}
+
+// Two-sided 97.5th percentile of Student's t distribution for 1 to 30
+// degrees of freedom; beyond that the normal approximation is close enough.
+constexpr double kStudentT975[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+double ConfidenceInterval95(const fbl::Vector<double>& values, double mean) {
+    size_t count = values.size();
+    if (count < 2) {
+        return 0;
+    }
+    double sum_of_squared_diffs = 0.0;
+    for (double value : values) {
+        double diff = value - mean;
+        sum_of_squared_diffs += diff * diff;
+    }
+    // Use the sample standard deviation here, not the population one that
+    // we report as std_dev.
+    double sample_std_dev =
+        sqrt(sum_of_squared_diffs / static_cast<double>(count - 1));
+    size_t degrees = count - 1;
+    double t = degrees <= fbl::count_of(kStudentT975)
+                   ? kStudentT975[degrees - 1] : 1.960;
+    return t * sample_std_dev / sqrt(static_cast<double>(count));
+}
+
 } // namespace
 
 SummaryStatistics TestCaseResults::GetSummaryStatistics() const {
@@ -77,9 +120,34 @@ SummaryStatistics TestCaseResults::GetSummaryStatistics() const {
         .mean = mean,
         .std_dev = StdDev(values, mean),
         .median = Median(values),
+        .ci95 = ConfidenceInterval95(values, mean),
     };
 }
 
+size_t TestCaseResults::RejectOutliers() {
+    if (values.size() < 4) {
+        return 0;
+    }
+    fbl::Vector<double> sorted;
+    SortedCopy(values, &sorted);
+    double q1 = Quantile(sorted, 0.25);
+    double q3 = Quantile(sorted, 0.75);
+    double low = q1 - 1.5 * (q3 - q1);
+    double high = q3 + 1.5 * (q3 - q1);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (values[i] >= low && values[i] <= high) {
+            values[kept++] = values[i];
+        }
+    }
+    size_t rejected = values.size() - kept;
+    while (values.size() > kept) {
+        values.pop_back();
+    }
+    return rejected;
+}
+
 void WriteJSONString(FILE* out_file, const char* string) {
     fputc('"', out_file);
     for (const char* ptr = string; *ptr; ptr++) {
@@ -171,17 +239,17 @@ bool ResultsSet::WriteJSONFile(const char* output_filename) const {
 
 void ResultsSet::PrintSummaryStatistics(FILE* out_file) const {
     // Print table headings row.
-    fprintf(out_file, "%10s %10s %10s %10s %10s %-12s %15s %s\n",
-            "Mean", "Std dev", "Min", "Max", "Median", "Unit",
+    fprintf(out_file, "%10s %10s %10s %10s %10s %10s %-12s %15s %s\n",
+            "Mean", "95% CI +/-", "Std dev", "Min", "Max", "Median", "Unit",
             "Mean Mbytes/sec", "Test case");
     if (results_.size() == 0) {
         fprintf(out_file, "(No test results)\n");
     }
     for (const auto& test : results_) {
         SummaryStatistics stats = test.GetSummaryStatistics();
-        fprintf(out_file, "%10.0f %10.0f %10.0f %10.0f %10.0f %-12s",
-                stats.mean, stats.std_dev, stats.min, stats.max, stats.median,
-                test.unit.c_str());
+        fprintf(out_file, "%10.0f %10.0f %10.0f %10.0f %10.0f %10.0f %-12s",
+                stats.mean, stats.ci95, stats.std_dev, stats.min, stats.max,
+                stats.median, test.unit.c_str());
         // Output the throughput column.
         if (test.bytes_processed_per_run != 0 && test.unit == "nanoseconds") {
             double bytes_per_second =
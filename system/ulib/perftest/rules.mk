@@ -20,6 +20,7 @@ MODULE_LIBS := \
     system/ulib/async-loop.cpp \
     system/ulib/c \
     system/ulib/fbl \
+    system/ulib/fdio \
     system/ulib/trace \
     system/ulib/trace-engine \
     system/ulib/trace-provider \
@@ -27,6 +28,9 @@ MODULE_LIBS := \
     system/ulib/zircon \
     system/ulib/zx \
 
+MODULE_FIDL_LIBS := \
+    system/fidl/fuchsia-sysinfo \
+
 MODULE_PACKAGE := src
 
 include make/module.mk
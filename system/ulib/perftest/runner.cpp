@@ -4,22 +4,30 @@
 
 #include <perftest/runner.h>
 
+#include <fcntl.h>
 #include <getopt.h>
 #include <pthread.h>
 #include <regex.h>
+#include <unistd.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/function.h>
 #include <fbl/string.h>
 #include <fbl/string_printf.h>
 #include <fbl/vector.h>
+#include <fuchsia/sysinfo/c/fidl.h>
 #include <lib/async-loop/cpp/loop.h>
+#include <lib/fdio/util.h>
 #include <trace-engine/context.h>
 #include <trace-engine/instrumentation.h>
 #include <trace-provider/provider.h>
 #include <trace/event.h>
 #include <unittest/unittest.h>
 #include <zircon/assert.h>
+#include <zircon/process.h>
+#include <zircon/status.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/profile.h>
 
 namespace perftest {
 namespace {
@@ -136,6 +144,15 @@ public:
         return nullptr;
     }
 
+    // Returns the mean time taken by a run, in nanoseconds.
+    double GetMeanRunTime() const {
+        double nanoseconds_per_tick =
+            1e9 / static_cast<double>(zx_ticks_per_second());
+        uint64_t time_taken = GetTimestamp(run_count_, 0) - GetTimestamp(0, 0);
+        return static_cast<double>(time_taken) * nanoseconds_per_tick /
+               static_cast<double>(run_count_);
+    }
+
     void CopyTimeResults(const char* test_suite, const char* test_name,
                          ResultsSet* dest) const {
         // bytes_processed_per_run is used for calculating throughput, but
@@ -280,6 +297,95 @@ private:
     uint64_t bytes_processed_per_run_ = 0;
 };
 
+// Runs |test_func| |run_count| times without recording any results, and
+// sets |ns_per_run| to the mean time taken by a run.
+bool TimeRuns(const char* test_name, const fbl::Function<TestFunc>& test_func,
+              uint32_t run_count, double* ns_per_run, fbl::String* error_out) {
+    RepeatStateImpl state(run_count);
+    const char* error = state.RunTestFunc(test_name, test_func);
+    if (error) {
+        *error_out = error;
+        return false;
+    }
+    *ns_per_run = state.GetMeanRunTime();
+    return true;
+}
+
+// Converts |optarg| for option |name| to a uint32_t, exiting on failure.
+uint32_t ParseUint32Arg(const char* name, bool allow_zero) {
+    char* end;
+    long val = strtol(optarg, &end, 0);
+    // Check that the string contains only a non-negative number and that
+    // the number doesn't overflow.
+    if (val != static_cast<uint32_t>(val) || *end != '\0' ||
+        *optarg == '\0' || (val == 0 && !allow_zero)) {
+        fprintf(stderr, "Invalid argument for --%s: \"%s\"\n", name, optarg);
+        exit(1);
+    }
+    return static_cast<uint32_t>(val);
+}
+
+// Converts |optarg| for option |name| to a double, exiting on failure.
+double ParseDoubleArg(const char* name) {
+    char* end;
+    double val = strtod(optarg, &end);
+    if (*end != '\0' || *optarg == '\0') {
+        fprintf(stderr, "Invalid argument for --%s: \"%s\"\n", name, optarg);
+        exit(1);
+    }
+    return val;
+}
+
+zx_status_t GetRootResource(zx_handle_t* root_resource) {
+    int fd = open("/dev/misc/sysinfo", O_RDWR);
+    if (fd < 0) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    zx_handle_t channel;
+    zx_status_t status = fdio_get_service_handle(fd, &channel);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    zx_status_t fidl_status = fuchsia_sysinfo_DeviceGetRootResource(
+        channel, &status, root_resource);
+    zx_handle_close(channel);
+    if (fidl_status != ZX_OK) {
+        return fidl_status;
+    }
+    return status;
+}
+
+// Restricts the current thread to |cpu|.  Creating the profile that does
+// this needs the root resource.
+bool PinToCpu(int32_t cpu) {
+    zx_handle_t root_resource;
+    zx_status_t status = GetRootResource(&root_resource);
+    if (status != ZX_OK) {
+        fprintf(stderr, "Cannot get the root resource for --cpu: %s\n",
+                zx_status_get_string(status));
+        return false;
+    }
+
+    zx_profile_info_t info = {};
+    info.type = ZX_PROFILE_INFO_CPU_MASK;
+    info.cpu_mask.mask = 1u << cpu;
+    zx_handle_t profile;
+    status = zx_profile_create(root_resource, &info, &profile);
+    zx_handle_close(root_resource);
+    if (status == ZX_OK) {
+        status = zx_object_set_profile(zx_thread_self(), profile, 0);
+        zx_handle_close(profile);
+    }
+    if (status != ZX_OK) {
+        fprintf(stderr, "Cannot pin to cpu %d: %s\n", cpu,
+                zx_status_get_string(status));
+        return false;
+    }
+    return true;
+}
+
 } // namespace
 
 void RegisterTest(const char* name, fbl::Function<TestFunc> test_func) {
@@ -310,9 +416,20 @@ bool RunTest(const char* test_suite, const char* test_name,
 
 namespace internal {
 
-bool RunTests(const char* test_suite, TestList* test_list, uint32_t run_count,
-              const char* regex_string, FILE* log_stream,
-              ResultsSet* results_set) {
+uint32_t CalibrateRunCount(double ns_per_run, double target_seconds) {
+    double runs = target_seconds * 1e9 / fbl::max(ns_per_run, 1.0);
+    if (runs < kMinCalibratedRunCount) {
+        return kMinCalibratedRunCount;
+    }
+    if (runs > kMaxCalibratedRunCount) {
+        return kMaxCalibratedRunCount;
+    }
+    return static_cast<uint32_t>(runs);
+}
+
+bool RunTests(const char* test_suite, TestList* test_list,
+              const RunOptions& options, const char* regex_string,
+              FILE* log_stream, ResultsSet* results_set) {
     // Compile the regular expression.
     regex_t regex;
     int err = regcomp(&regex, regex_string, REG_EXTENDED);
@@ -342,13 +459,45 @@ bool RunTests(const char* test_suite, TestList* test_list, uint32_t run_count,
         fprintf(log_stream, "[ RUN      ] %s\n", test_name);
 
         fbl::String error_string;
-        if (!RunTest(test_suite, test_name, test_case.test_func, run_count,
-                     results_set, &error_string)) {
+        uint32_t run_count = options.run_count;
+        uint32_t trial_count = options.warmup_count;
+        if (options.target_seconds > 0 && trial_count == 0) {
+            trial_count = kCalibrationRunCount;
+        }
+        bool passed = true;
+        if (trial_count > 0) {
+            double ns_per_run;
+            passed = TimeRuns(test_name, test_case.test_func, trial_count,
+                              &ns_per_run, &error_string);
+            if (passed && options.target_seconds > 0) {
+                run_count = CalibrateRunCount(ns_per_run,
+                                              options.target_seconds);
+                fprintf(log_stream, "Calibrated to %u runs (%.0f ns/run)\n",
+                        run_count, ns_per_run);
+            }
+        }
+        size_t first_new_case = results_set->results()->size();
+        if (passed) {
+            passed = RunTest(test_suite, test_name, test_case.test_func,
+                             run_count, results_set, &error_string);
+        }
+        if (!passed) {
             fprintf(log_stream, "Error: %s\n", error_string.c_str());
             fprintf(log_stream, "[  FAILED  ] %s\n", test_name);
             ok = false;
             continue;
         }
+        if (options.reject_outliers) {
+            for (size_t i = first_new_case; i < results_set->results()->size();
+                 ++i) {
+                TestCaseResults* results = &(*results_set->results())[i];
+                size_t rejected = results->RejectOutliers();
+                if (rejected > 0) {
+                    fprintf(log_stream, "Rejected %zu of %u values of %s as outliers\n",
+                            rejected, run_count, results->label.c_str());
+                }
+            }
+        }
         fprintf(log_stream, "[       OK ] %s\n", test_name);
     }
 
@@ -372,6 +521,11 @@ void ParseCommandArgs(int argc, char** argv, CommandArgs* dest) {
         {"runs", required_argument, nullptr, 'r'},
         {"enable-tracing", no_argument, nullptr, 't'},
         {"startup-delay", required_argument, nullptr, 'd'},
+        {"warmup", required_argument, nullptr, 'w'},
+        {"target-time", required_argument, nullptr, 'T'},
+        {"reject-outliers", no_argument, nullptr, 'R'},
+        {"cpu", required_argument, nullptr, 'c'},
+        {nullptr, 0, nullptr, 0},
     };
     optind = 1;
     for (;;) {
@@ -386,35 +540,39 @@ void ParseCommandArgs(int argc, char** argv, CommandArgs* dest) {
         case 'f':
             dest->filter_regex = optarg;
             break;
-        case 'r': {
-            // Convert string to number (uint32_t).
-            char* end;
-            long val = strtol(optarg, &end, 0);
-            // Check that the string contains only a positive number and
-            // that the number doesn't overflow.
-            if (val != static_cast<uint32_t>(val) || *end != '\0' ||
-                *optarg == '\0' || val == 0) {
-                fprintf(stderr, "Invalid argument for --runs: \"%s\"\n",
+        case 'r':
+            dest->run_options.run_count = ParseUint32Arg("runs", false);
+            break;
+        case 't':
+            dest->enable_tracing = true;
+            break;
+        case 'd':
+            dest->startup_delay_seconds = ParseDoubleArg("startup-delay");
+            break;
+        case 'w':
+            dest->run_options.warmup_count = ParseUint32Arg("warmup", true);
+            break;
+        case 'T': {
+            double val = ParseDoubleArg("target-time");
+            if (val <= 0) {
+                fprintf(stderr, "Invalid argument for --target-time: \"%s\"\n",
                         optarg);
                 exit(1);
             }
-            dest->run_count = static_cast<uint32_t>(val);
+            dest->run_options.target_seconds = val;
             break;
         }
-        case 't':
-            dest->enable_tracing = true;
+        case 'R':
+            dest->run_options.reject_outliers = true;
             break;
-        case 'd': {
-            // Convert string to number (double type).
-            char* end;
-            double val = strtod(optarg, &end);
-            if (*end != '\0' || *optarg == '\0') {
-                fprintf(stderr,
-                        "Invalid argument for --startup-delay: \"%s\"\n",
+        case 'c': {
+            uint32_t cpu = ParseUint32Arg("cpu", true);
+            if (cpu >= zx_system_get_num_cpus()) {
+                fprintf(stderr, "Invalid argument for --cpu: \"%s\"\n",
                         optarg);
                 exit(1);
             }
-            dest->startup_delay_seconds = val;
+            dest->cpu = static_cast<int32_t>(cpu);
             break;
         }
         default:
@@ -456,8 +614,12 @@ static bool PerfTestMode(const char* test_suite, int argc, char** argv) {
         static_cast<zx_duration_t>(ZX_SEC(1) * args.startup_delay_seconds);
     zx_nanosleep(zx_deadline_after(duration));
 
+    if (args.cpu >= 0 && !PinToCpu(args.cpu)) {
+        return false;
+    }
+
     ResultsSet results;
-    bool success = RunTests(test_suite, g_tests, args.run_count,
+    bool success = RunTests(test_suite, g_tests, args.run_options,
                             args.filter_regex, stdout, &results);
 
     printf("\n");
@@ -501,6 +663,19 @@ int PerfTestMain(int argc, char** argv, const char* test_suite) {
                "to run.  By default, all the tests are run.\n"
                "  --runs NUMBER\n"
                "      Number of times to run each test.\n"
+               "  --warmup NUMBER\n"
+               "      Number of times to run each test before the runs that "
+               "are recorded.  The default is 0.\n"
+               "  --target-time SECONDS\n"
+               "      Pick the number of runs of each test so that it takes "
+               "about SECONDS, timing it with the warm-up runs (or 10 extra "
+               "runs if there are none).  This overrides --runs.\n"
+               "  --reject-outliers\n"
+               "      Drop times that are more than 1.5 interquartile ranges "
+               "beyond the first or third quartile.\n"
+               "  --cpu NUMBER\n"
+               "      Run the tests on the given CPU only.  This needs "
+               "access to the root resource.\n"
                "  --enable-tracing\n"
                "      Enable use of Fuchsia tracing: Enable registering as a "
                "TraceProvider.  This is off by default because the "
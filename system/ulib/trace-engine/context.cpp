@@ -70,6 +70,21 @@
 // Note that the handler is free to save buffers at whatever rate it can
 // manage. The protocol allows for records to be dropped if buffers can't be
 // saved fast enough.
+//
+// Notes on per-thread chunks
+// --------------------------
+//
+// Every allocation from a rolling buffer is an atomic add to
+// |rolling_buffer_current_|, so threads writing records concurrently all
+// contend for the same cache line. When a thread chunk size is configured
+// (see |trace_engine_set_thread_chunk_size()|) each thread instead allocates
+// a chunk of that size from the rolling buffer and bump-allocates its
+// records within it, keeping the chunk pointers in its context cache
+// alongside its string and thread tables. The unused remainder of a chunk is
+// always covered by a padding record, so readers see a well-formed stream no
+// matter when the buffer is saved. A chunk is abandoned as soon as its
+// thread notices the rolling buffer has switched: after that its buffer may
+// be saved or reused. Durable records are not allocated from chunks.
 
 #include "context_impl.h"
 
@@ -92,9 +107,11 @@ fbl::atomic<uint32_t> g_next_generation{1u};
 
 trace_context::trace_context(void* buffer, size_t buffer_num_bytes,
                              trace_buffering_mode_t buffering_mode,
-                             trace_handler_t* handler)
+                             trace_handler_t* handler,
+                             size_t thread_chunk_size)
     : generation_(trace::g_next_generation.fetch_add(1u, fbl::memory_order_relaxed) + 1u),
       buffering_mode_(buffering_mode),
+      thread_chunk_size_(thread_chunk_size),
       buffer_start_(reinterpret_cast<uint8_t*>(buffer)),
       buffer_end_(buffer_start_ + buffer_num_bytes),
       header_(reinterpret_cast<trace_buffer_header*>(buffer)),
@@ -102,12 +119,37 @@ trace_context::trace_context(void* buffer, size_t buffer_num_bytes,
     ZX_DEBUG_ASSERT(buffer_num_bytes >= kMinPhysicalBufferSize);
     ZX_DEBUG_ASSERT(buffer_num_bytes <= kMaxPhysicalBufferSize);
     ZX_DEBUG_ASSERT(generation_ != 0u);
+    ZX_DEBUG_ASSERT((thread_chunk_size_ & 7) == 0);
+    ZX_DEBUG_ASSERT(thread_chunk_size_ <= TRACE_ENCODED_RECORD_MAX_LENGTH);
     ComputeBufferSizes();
 }
 
 trace_context::~trace_context() = default;
 
 uint64_t* trace_context::AllocRecord(size_t num_bytes) {
+    uint32_t wrapped_count;
+    return AllocRecord(num_bytes, &wrapped_count);
+}
+
+uint64_t* trace_context::AllocThreadChunk(uint32_t* out_wrapped_count) {
+    ZX_DEBUG_ASSERT(thread_chunk_size_ != 0u);
+    uint64_t* chunk = AllocRecord(thread_chunk_size_, out_wrapped_count);
+    if (likely(chunk))
+        WritePaddingRecord(chunk, thread_chunk_size_);
+    return chunk;
+}
+
+void trace_context::WritePaddingRecord(uint64_t* ptr, size_t num_bytes) {
+    ZX_DEBUG_ASSERT(num_bytes != 0u && (num_bytes & 7) == 0);
+    ZX_DEBUG_ASSERT(num_bytes <= TRACE_ENCODED_RECORD_MAX_LENGTH);
+    *ptr = trace::MetadataRecordFields::Type::Make(
+               trace::ToUnderlyingType(trace::RecordType::kMetadata)) |
+           trace::MetadataRecordFields::RecordSize::Make(num_bytes >> 3) |
+           trace::MetadataRecordFields::MetadataType::Make(
+               trace::ToUnderlyingType(trace::MetadataType::kPadding));
+}
+
+uint64_t* trace_context::AllocRecord(size_t num_bytes, uint32_t* out_wrapped_count) {
     ZX_DEBUG_ASSERT((num_bytes & 7) == 0);
     if (unlikely(num_bytes > TRACE_ENCODED_RECORD_MAX_LENGTH))
         return nullptr;
@@ -128,6 +170,7 @@ uint64_t* trace_context::AllocRecord(size_t num_bytes) {
         // Note: There's no worry of an overflow in the calcs here.
         if (likely(buffer_offset + num_bytes <= rolling_buffer_size_)) {
             uint8_t* ptr = rolling_buffer_start_[buffer_number] + buffer_offset;
+            *out_wrapped_count = wrapped_count;
             return reinterpret_cast<uint64_t*>(ptr); // success!
         }
 
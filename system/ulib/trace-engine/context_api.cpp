@@ -137,6 +137,14 @@ struct ContextCache {
 
     // Storage for the external thread entries.
     ThreadEntry thread_entries[kMaxThreadEntries];
+
+    // The unused part of this thread's record chunk, if any.
+    // See |trace_engine_set_thread_chunk_size()|.
+    uint64_t* chunk_ptr{nullptr};
+    uint64_t* chunk_end{nullptr};
+
+    // The wrapped count of the rolling buffer |chunk_ptr| points into.
+    uint32_t chunk_wrapped_count{0u};
 };
 thread_local fbl::unique_ptr<ContextCache> tls_cache{};
 
@@ -155,6 +163,8 @@ ContextCache* GetCurrentContextCache(uint32_t generation) {
     cache->thread_ref = trace_make_unknown_thread_ref();
     cache->string_table.clear();
     cache->thread_table.clear();
+    cache->chunk_ptr = nullptr;
+    cache->chunk_end = nullptr;
     return cache;
 }
 
@@ -200,6 +210,47 @@ ThreadEntry* CacheThreadEntry(uint32_t generation, zx_koid_t thread_koid) {
     return entry;
 }
 
+// Records larger than this fraction of a chunk are allocated directly from
+// the rolling buffer so that they don't waste most of a chunk.
+constexpr size_t kMaxChunkRecordFraction = 4u;
+
+// Allocates a record from the calling thread's chunk, carving a new chunk
+// from the rolling buffer when the current one is exhausted or belongs to
+// a buffer that has since been switched out.
+uint64_t* AllocChunkRecord(trace_context_t* context, size_t num_bytes) {
+    ContextCache* cache = GetCurrentContextCache(context->generation());
+    if (unlikely(!cache))
+        return context->AllocRecord(num_bytes);
+
+    uint64_t* ptr = cache->chunk_ptr;
+    size_t num_words = num_bytes >> 3;
+    if (unlikely(!ptr ||
+                 static_cast<size_t>(cache->chunk_end - ptr) < num_words ||
+                 !context->IsThreadChunkCurrent(cache->chunk_wrapped_count))) {
+        // Any unused space in the old chunk is already padded.
+        ptr = context->AllocThreadChunk(&cache->chunk_wrapped_count);
+        if (unlikely(!ptr)) {
+            cache->chunk_ptr = nullptr;
+            return nullptr;
+        }
+        cache->chunk_end = ptr + (context->thread_chunk_size() >> 3);
+    }
+
+    cache->chunk_ptr = ptr + num_words;
+    if (cache->chunk_ptr != cache->chunk_end) {
+        trace_context::WritePaddingRecord(
+            cache->chunk_ptr, (cache->chunk_end - cache->chunk_ptr) << 3);
+    }
+    return ptr;
+}
+
+uint64_t* AllocRecord(trace_context_t* context, size_t num_bytes) {
+    size_t chunk_size = context->thread_chunk_size();
+    if (likely(chunk_size == 0u) || num_bytes > chunk_size / kMaxChunkRecordFraction)
+        return context->AllocRecord(num_bytes);
+    return AllocChunkRecord(context, num_bytes);
+}
+
 inline constexpr uint64_t MakeRecordHeader(RecordType type, size_t size) {
     return RecordFields::Type::Make(ToUnderlyingType(type)) |
            RecordFields::RecordSize::Make(size >> 3);
@@ -269,12 +320,12 @@ size_t SizeOfEncodedArgs(const trace_arg_t* args, size_t num_args) {
 class Payload {
 public:
     explicit Payload(trace_context_t* context, size_t num_bytes)
-        : ptr_(context->AllocRecord(num_bytes)) {}
+        : ptr_(AllocRecord(context, num_bytes)) {}
 
     explicit Payload(trace_context_t* context, bool rqst_durable, size_t num_bytes)
         : ptr_(rqst_durable && context->UsingDurableBuffer()
                ? context->AllocDurableRecord(num_bytes)
-               : context->AllocRecord(num_bytes)) {}
+               : AllocRecord(context, num_bytes)) {}
 
     explicit operator bool() const {
         return ptr_ != nullptr;
@@ -1119,7 +1170,7 @@ void trace_context_write_thread_record(
 }
 
 void* trace_context_alloc_record(trace_context_t* context, size_t num_bytes) {
-    return context->AllocRecord(num_bytes);
+    return trace::AllocRecord(context, num_bytes);
 }
 
 void trace_context_snapshot_buffer_header(
@@ -28,7 +28,7 @@ void trace_engine_request_save_buffer(uint32_t wrapped_count,
 // Implements the opaque type declared in <trace-engine/context.h>.
 struct trace_context {
     trace_context(void* buffer, size_t buffer_num_bytes, trace_buffering_mode_t buffering_mode,
-                  trace_handler_t* handler);
+                  trace_handler_t* handler, size_t thread_chunk_size);
 
     ~trace_context();
 
@@ -48,6 +48,11 @@ struct trace_context {
 
     trace_buffering_mode_t buffering_mode() const { return buffering_mode_; }
 
+    // The size of the chunks threads allocate their records from, or zero
+    // if records are allocated directly from the rolling buffer.
+    // See |trace_engine_set_thread_chunk_size()|.
+    size_t thread_chunk_size() const { return thread_chunk_size_; }
+
     uint64_t num_records_dropped() const {
         return num_records_dropped_.load(fbl::memory_order_relaxed);
     }
@@ -72,6 +77,28 @@ struct trace_context {
     bool AllocThreadIndex(trace_thread_index_t* out_index);
     bool AllocStringIndex(trace_string_index_t* out_index);
 
+    // Allocates a chunk of |thread_chunk_size()| bytes from the rolling
+    // buffer for the calling thread to allocate its records from.
+    // The chunk is filled with a padding record. Records must be carved from
+    // the front of the chunk, and the space remaining after each record must
+    // be covered by a new padding record before the record is written.
+    // |*out_wrapped_count| is set to the wrapped count of the buffer the
+    // chunk was allocated from, to be passed to |IsThreadChunkCurrent()|.
+    uint64_t* AllocThreadChunk(uint32_t* out_wrapped_count);
+
+    // Return true if records may still be allocated from a chunk obtained
+    // from |AllocThreadChunk()| with |wrapped_count|.
+    // Once the rolling buffer has switched, the chunk's buffer may be saved
+    // (streaming) or reused (circular) at any time.
+    bool IsThreadChunkCurrent(uint32_t wrapped_count) const {
+        return CurrentWrappedCount() == wrapped_count;
+    }
+
+    // Writes a padding record that covers |num_bytes| at |ptr|.
+    // |num_bytes| must be a non-zero multiple of 8 no larger than
+    // |TRACE_ENCODED_RECORD_MAX_LENGTH|.
+    static void WritePaddingRecord(uint64_t* ptr, size_t num_bytes);
+
     // This is called by the handler when it has been notified that a buffer
     // has been saved.
     // |wrapped_count| is the wrapped count at the time the buffer save request
@@ -200,6 +227,8 @@ private:
 
     void ComputeBufferSizes();
 
+    uint64_t* AllocRecord(size_t num_bytes, uint32_t* out_wrapped_count);
+
     void MarkDurableBufferFull(uint64_t last_offset);
 
     void MarkOneshotBufferFull(uint64_t last_offset);
@@ -241,6 +270,9 @@ private:
     // The buffering mode.
     trace_buffering_mode_t const buffering_mode_;
 
+    // The size of per-thread record chunks, or zero if not using them.
+    size_t const thread_chunk_size_;
+
     // Buffer start and end pointers.
     // These encapsulate the entire physical buffer.
     uint8_t* const buffer_start_;
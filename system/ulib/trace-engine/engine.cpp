@@ -105,6 +105,11 @@ constexpr uint32_t kBufferCounterShift = 8;
 constexpr uint32_t kBufferCounterIncrement = 1 << kBufferCounterShift;
 constexpr uint32_t kBufferCounterMask = 0xffffff00;
 
+// Size of the per-thread record chunks for the next trace, or zero.
+// Rules:
+//   - can only be accessed or modified while holding g_engine_mutex
+size_t g_thread_chunk_size __TA_GUARDED(g_engine_mutex) {0u};
+
 // Trace context.
 // Rules:
 //   - can only be modified while holding g_engine_mutex and engine is stopped
@@ -220,7 +225,8 @@ zx_status_t trace_start_engine(async_dispatcher_t* dispatcher,
     g_dispatcher = dispatcher;
     g_handler = handler;
     g_disposition = ZX_OK;
-    g_context = new trace_context(buffer, buffer_num_bytes, buffering_mode, handler);
+    g_context = new trace_context(buffer, buffer_num_bytes, buffering_mode, handler,
+                                  g_thread_chunk_size);
     g_event = fbl::move(event);
 
     g_context->InitBufferHeader();
@@ -298,6 +304,23 @@ void trace_engine_request_save_buffer(uint32_t wrapped_count,
     });
 }
 
+zx_status_t trace_engine_set_thread_chunk_size(size_t chunk_size) {
+    if (chunk_size != 0u &&
+        (chunk_size < TRACE_ENGINE_MIN_THREAD_CHUNK_SIZE ||
+         chunk_size > TRACE_ENCODED_RECORD_MAX_LENGTH ||
+         (chunk_size & 7) != 0)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    fbl::AutoLock lock(&g_engine_mutex);
+
+    if (g_state.load(fbl::memory_order_relaxed) != TRACE_STOPPED)
+        return ZX_ERR_BAD_STATE;
+
+    g_thread_chunk_size = chunk_size;
+    return ZX_OK;
+}
+
 // This is called by the handler after it has saved a buffer.
 // |wrapped_count| and |durable_end| are the values that were passed to it,
 // and are passed back to us for sanity checking purposes.
@@ -126,6 +126,31 @@ __EXPORT zx_status_t trace_start_engine(async_dispatcher_t* dispatcher,
 // This function is thread-safe.
 __EXPORT zx_status_t trace_stop_engine(zx_status_t disposition);
 
+// Sets the size of the per-thread record chunks used by subsequent traces.
+//
+// By default every record is allocated from the trace buffer with an atomic
+// update of a single shared offset, which becomes a point of contention when
+// many threads write trace events concurrently.  When |chunk_size| is
+// non-zero, each thread instead claims |chunk_size| bytes of the buffer at a
+// time and allocates the records it writes from that chunk without touching
+// shared state.  The unused tail of a chunk is filled with a padding record.
+//
+// The trade-off is that up to one partially filled chunk per writing thread
+// is wasted whenever a buffer fills, so this is best suited to buffers that
+// are large relative to |chunk_size| times the number of writing threads.
+//
+// |chunk_size| is zero to disable per-thread chunks, otherwise it must be a
+// multiple of 8 between |TRACE_ENGINE_MIN_THREAD_CHUNK_SIZE| and
+// |TRACE_ENCODED_RECORD_MAX_LENGTH|.
+//
+// Returns |ZX_OK| on success.
+// Returns |ZX_ERR_INVALID_ARGS| if |chunk_size| is not valid.
+// Returns |ZX_ERR_BAD_STATE| if tracing is not stopped.
+//
+// This function is thread-safe.
+#define TRACE_ENGINE_MIN_THREAD_CHUNK_SIZE ((size_t)512u)
+__EXPORT zx_status_t trace_engine_set_thread_chunk_size(size_t chunk_size);
+
 // Asynchronously notifies the engine that buffers up to |wrapped_count|
 // have been saved.
 //
@@ -0,0 +1,109 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <fbl/function.h>
+#include <fbl/intrusive_hash_table.h>
+#include <fbl/intrusive_single_list.h>
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+
+#include <lib/zircon-internal/ktrace.h>
+#include <zircon/types.h>
+#include <trace-reader/records.h>
+
+namespace trace {
+
+// Turns the kernel's CHANNEL_WRITE_FLOW and CHANNEL_READ_FLOW records
+// (KTRACE_GRP_IPC_FLOW) into flow events, so a viewer can follow a message
+// from the thread that wrote it to the thread that read it.
+//
+// Every message the kernel traces gets a flow id, which its write record
+// and its read record share.  A message that is not part of a transaction
+// becomes a flow that begins at its write and ends at its read.
+//
+// Transactions (zx_channel_call() and FIDL requests) carry a nonzero txid,
+// and the reply is written to the endpoint the request was read from with
+// the same txid.  The request and reply are stitched into a single flow:
+// it begins at the request write, steps at the request read and the reply
+// write, and ends at the reply read.  Since a request's read is only known
+// to be a step once its reply is written, it is held back until then, so
+// the events are not emitted in timestamp order.  Calls made by a server
+// while it handles a request are flows of their own.
+//
+// Records should be fed in timestamp order, as KTraceMerger emits them.
+class KTraceFlowStitcher {
+public:
+    // Called once for each flow event.
+    using RecordConsumer = fbl::Function<void(Record)>;
+
+    explicit KTraceFlowStitcher(RecordConsumer record_consumer);
+    ~KTraceFlowStitcher();
+
+    // Category and name of the emitted events.
+    static const char kCategory[];
+    static const char kName[];
+
+    // Processes |record|.  Records other than the IPC flow records are
+    // ignored.
+    void AddRecord(const ktrace_header_t* record);
+
+    // Ends the flows of the requests that were read but never replied to.
+    void Finish();
+
+    // Number of flow events emitted so far.
+    uint64_t event_count() const { return event_count_; }
+
+private:
+    // Requests are matched to their replies by the endpoint that read the
+    // request, which is the one that writes the reply, and the txid.
+    struct TransactionKey {
+        zx_koid_t koid;
+        uint32_t txid;
+
+        bool operator==(const TransactionKey& other) const {
+            return koid == other.koid && txid == other.txid;
+        }
+        bool operator<(const TransactionKey& other) const {
+            return koid < other.koid || (koid == other.koid && txid < other.txid);
+        }
+    };
+
+    // A request that was read and is waiting for its reply.
+    struct PendingRead : public fbl::SinglyLinkedListable<fbl::unique_ptr<PendingRead>> {
+        TransactionKey key;
+        ktrace_rec_flow_t record;
+        uint64_t flow_id;
+
+        TransactionKey GetKey() const { return key; }
+        static size_t GetHash(const TransactionKey& key) {
+            return static_cast<size_t>(key.koid * 31 + key.txid);
+        }
+    };
+
+    // A reply in flight, whose events belong to the flow of its request.
+    struct Reply : public fbl::SinglyLinkedListable<fbl::unique_ptr<Reply>> {
+        uint64_t reply_flow_id;
+        uint64_t flow_id;
+
+        uint64_t GetKey() const { return reply_flow_id; }
+        static size_t GetHash(uint64_t key) { return key; }
+    };
+
+    void HandleWrite(const ktrace_rec_flow_t& record);
+    void HandleRead(const ktrace_rec_flow_t& record);
+    void Emit(const ktrace_rec_flow_t& record, EventData data);
+
+    RecordConsumer record_consumer_;
+    fbl::HashTable<TransactionKey, fbl::unique_ptr<PendingRead>> pending_reads_;
+    fbl::HashTable<uint64_t, fbl::unique_ptr<Reply>> replies_;
+    uint64_t event_count_ = 0;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(KTraceFlowStitcher);
+};
+
+} // namespace trace
@@ -0,0 +1,92 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <fbl/function.h>
+#include <fbl/macros.h>
+#include <fbl/vector.h>
+
+#include <lib/zircon-internal/ktrace.h>
+
+namespace trace {
+
+// Merges the per-cpu record streams of the kernel trace buffer (see
+// lib/zircon-internal/ktrace.h) into a single stream ordered by timestamp.
+//
+// Each cpu's stream is already in timestamp order, so merging is a k-way
+// merge of the records buffered for each cpu.  Name records carry no
+// timestamp and are passed through as soon as they are parsed, which keeps
+// them ahead of the records that refer to them.
+//
+// When draining a live buffer, records from a cpu that has not been
+// drained yet may still be older than records already buffered for
+// another, so |Flush| takes a horizon below which the caller knows every
+// cpu's records have been seen (typically the tick count sampled before
+// the drain).  |Finish| flushes everything once tracing has stopped.
+class KTraceMerger {
+public:
+    // Called once for each record.  |record| points to KTRACE_LEN(tag)
+    // bytes and is only valid for the duration of the call.
+    using RecordConsumer = fbl::Function<void(const ktrace_header_t* record)>;
+
+    // Callback invoked when a stream is found to be corrupt.
+    using ErrorHandler = fbl::Function<void(uint32_t cpu, const char* message)>;
+
+    KTraceMerger(uint32_t num_cpus, RecordConsumer record_consumer,
+                 ErrorHandler error_handler);
+    ~KTraceMerger();
+
+    uint32_t num_cpus() const { return static_cast<uint32_t>(cpus_.size()); }
+
+    // Returns true for records without a timestamp (the TAG_*_NAME family).
+    static bool IsNameRecord(uint32_t tag);
+
+    // Appends |len| bytes of |cpu|'s stream.  Records may be split across
+    // calls.  Returns false if |cpu| is out of range or its stream is
+    // corrupt, in which case the rest of that stream is discarded.
+    bool AddBytes(uint32_t cpu, const void* data, size_t len);
+
+    // Copies the new records out of every cpu ring of a mapped streaming
+    // mode buffer and advances each cpu's tail in |control| to release the
+    // space.  |buffer| and |control| must be the start of the mapped buffer
+    // and control VMOs.  Returns the number of bytes consumed, or -1 if the
+    // buffer header is not recognized.
+    ssize_t Drain(const ktrace_buffer_header_t* buffer, ktrace_cpu_control_t* control);
+
+    // Emits, in timestamp order, every buffered record older than
+    // |horizon|.
+    void Flush(uint64_t horizon);
+
+    // Emits all buffered records.
+    void Finish() { Flush(UINT64_MAX); }
+
+    // Number of records emitted so far.
+    uint64_t record_count() const { return record_count_; }
+
+private:
+    struct CpuStream {
+        fbl::Vector<uint8_t> bytes;
+        size_t pos = 0;
+        bool corrupt = false;
+    };
+
+    // Returns the next complete record buffered for |stream|, or nullptr.
+    static const ktrace_header_t* Peek(const CpuStream& stream);
+    void Emit(const ktrace_header_t* record);
+    void PassNames(uint32_t cpu);
+
+    RecordConsumer record_consumer_;
+    ErrorHandler error_handler_;
+    fbl::Vector<CpuStream> cpus_;
+    uint64_t record_count_ = 0;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(KTraceMerger);
+};
+
+} // namespace trace
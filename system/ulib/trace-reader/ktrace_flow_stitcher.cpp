@@ -0,0 +1,102 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <trace-reader/ktrace_flow_stitcher.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/vector.h>
+
+namespace trace {
+const char KTraceFlowStitcher::kCategory[] = "kernel:ipc";
+const char KTraceFlowStitcher::kName[] = "channel_message";
+
+KTraceFlowStitcher::KTraceFlowStitcher(RecordConsumer record_consumer)
+    : record_consumer_(fbl::move(record_consumer)) {}
+
+KTraceFlowStitcher::~KTraceFlowStitcher() = default;
+
+void KTraceFlowStitcher::AddRecord(const ktrace_header_t* record) {
+    if (record->tag != TAG_CHANNEL_WRITE_FLOW && record->tag != TAG_CHANNEL_READ_FLOW) {
+        return;
+    }
+    const auto& rec = *reinterpret_cast<const ktrace_rec_flow_t*>(record);
+    if (rec.tag == TAG_CHANNEL_WRITE_FLOW) {
+        HandleWrite(rec);
+    } else {
+        HandleRead(rec);
+    }
+}
+
+void KTraceFlowStitcher::HandleWrite(const ktrace_rec_flow_t& record) {
+    if (record.txid != 0) {
+        TransactionKey key{record.koid, record.txid};
+        fbl::unique_ptr<PendingRead> request = pending_reads_.erase(key);
+        if (request) {
+            Emit(request->record, EventData(EventData::FlowStep{request->flow_id}));
+            Emit(record, EventData(EventData::FlowStep{request->flow_id}));
+
+            fbl::AllocChecker ac;
+            fbl::unique_ptr<Reply> reply(new (&ac) Reply());
+            if (ac.check()) {
+                reply->reply_flow_id = record.flow_id;
+                reply->flow_id = request->flow_id;
+                replies_.insert(fbl::move(reply));
+            }
+            return;
+        }
+    }
+    Emit(record, EventData(EventData::FlowBegin{record.flow_id}));
+}
+
+void KTraceFlowStitcher::HandleRead(const ktrace_rec_flow_t& record) {
+    fbl::unique_ptr<Reply> reply = replies_.erase(record.flow_id);
+    if (reply) {
+        Emit(record, EventData(EventData::FlowEnd{reply->flow_id}));
+        return;
+    }
+
+    if (record.txid != 0) {
+        TransactionKey key{record.koid, record.txid};
+        // A txid can only be reused once its transaction is over, so an
+        // older request with the same key was never replied to.
+        fbl::unique_ptr<PendingRead> stale = pending_reads_.erase(key);
+        if (stale) {
+            Emit(stale->record, EventData(EventData::FlowEnd{stale->flow_id}));
+        }
+
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<PendingRead> request(new (&ac) PendingRead());
+        if (ac.check()) {
+            request->key = key;
+            request->record = record;
+            request->flow_id = record.flow_id;
+            pending_reads_.insert(fbl::move(request));
+            return;
+        }
+    }
+    Emit(record, EventData(EventData::FlowEnd{record.flow_id}));
+}
+
+void KTraceFlowStitcher::Finish() {
+    for (const auto& request : pending_reads_) {
+        Emit(request.record, EventData(EventData::FlowEnd{request.flow_id}));
+    }
+    pending_reads_.clear();
+    replies_.clear();
+}
+
+void KTraceFlowStitcher::Emit(const ktrace_rec_flow_t& record, EventData data) {
+    fbl::Vector<Argument> arguments;
+    arguments.push_back(Argument("channel", ArgumentValue::MakeKoid(record.koid)));
+    if (record.txid != 0) {
+        arguments.push_back(Argument("txid", ArgumentValue::MakeUint32(record.txid)));
+    }
+    // The kernel records the thread's koid but not its process's.
+    record_consumer_(Record(Record::Event{
+        record.ts, ProcessThread(ZX_KOID_INVALID, record.tid),
+        kCategory, kName, fbl::move(arguments), fbl::move(data)}));
+    event_count_++;
+}
+
+} // namespace trace
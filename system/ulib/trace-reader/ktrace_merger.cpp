@@ -0,0 +1,167 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <trace-reader/ktrace_merger.h>
+
+#include <string.h>
+
+#include <fbl/algorithm.h>
+
+namespace trace {
+namespace {
+
+const ktrace_cpu_header_t* CpuHeader(const ktrace_buffer_header_t* buffer, uint32_t cpu) {
+    return reinterpret_cast<const ktrace_cpu_header_t*>(
+        reinterpret_cast<const uint8_t*>(buffer) + buffer->cpu_offset +
+        cpu * buffer->cpu_stride);
+}
+
+} // namespace
+
+KTraceMerger::KTraceMerger(uint32_t num_cpus, RecordConsumer record_consumer,
+                           ErrorHandler error_handler)
+    : record_consumer_(fbl::move(record_consumer)),
+      error_handler_(fbl::move(error_handler)) {
+    cpus_.reserve(num_cpus);
+    for (uint32_t i = 0; i < num_cpus; i++) {
+        cpus_.push_back(CpuStream());
+    }
+}
+
+KTraceMerger::~KTraceMerger() = default;
+
+bool KTraceMerger::IsNameRecord(uint32_t tag) {
+    // Name records are META events 0x020 through 0x02F.
+    return KTRACE_GROUP(tag) == KTRACE_GRP_META && (KTRACE_EVENT(tag) & 0xFF0) == 0x020;
+}
+
+bool KTraceMerger::AddBytes(uint32_t cpu, const void* data, size_t len) {
+    if (cpu >= cpus_.size()) {
+        error_handler_(cpu, "no such cpu");
+        return false;
+    }
+    CpuStream& stream = cpus_[cpu];
+    if (stream.corrupt) {
+        return false;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    stream.bytes.reserve(stream.bytes.size() + len);
+    for (size_t i = 0; i < len; i++) {
+        stream.bytes.push_back(bytes[i]);
+    }
+    PassNames(cpu);
+    return !stream.corrupt;
+}
+
+ssize_t KTraceMerger::Drain(const ktrace_buffer_header_t* buffer,
+                            ktrace_cpu_control_t* control) {
+    if (buffer->magic != KTRACE_BUFFER_MAGIC || buffer->num_cpus != cpus_.size()) {
+        return -1;
+    }
+
+    ssize_t total = 0;
+    for (uint32_t i = 0; i < buffer->num_cpus; i++) {
+        const ktrace_cpu_header_t* cpu = CpuHeader(buffer, i);
+        const uint8_t* ring = reinterpret_cast<const uint8_t*>(cpu + 1);
+        uint64_t head = __atomic_load_n(&cpu->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = control[i].tail;
+        uint64_t size = cpu->size;
+        if (head - tail > size) {
+            error_handler_(i, "ring tail is out of range");
+            __atomic_store_n(&control[i].tail, head, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        size_t len = static_cast<size_t>(head - tail);
+        size_t off = static_cast<size_t>(tail % size);
+        size_t first = fbl::min(len, static_cast<size_t>(size) - off);
+        AddBytes(i, ring + off, first);
+        AddBytes(i, ring, len - first);
+
+        // Hand the space back to the kernel only after the copy.
+        __atomic_store_n(&control[i].tail, head, __ATOMIC_RELEASE);
+        total += len;
+    }
+    return total;
+}
+
+const ktrace_header_t* KTraceMerger::Peek(const CpuStream& stream) {
+    size_t avail = stream.bytes.size() - stream.pos;
+    if (stream.corrupt || avail < sizeof(uint32_t)) {
+        return nullptr;
+    }
+    const ktrace_header_t* record =
+        reinterpret_cast<const ktrace_header_t*>(stream.bytes.get() + stream.pos);
+    size_t len = KTRACE_LEN(record->tag);
+    if (len == 0 || len > avail) {
+        return nullptr;
+    }
+    return record;
+}
+
+void KTraceMerger::Emit(const ktrace_header_t* record) {
+    record_count_++;
+    record_consumer_(record);
+}
+
+void KTraceMerger::PassNames(uint32_t cpu) {
+    CpuStream& stream = cpus_[cpu];
+    for (;;) {
+        if (stream.bytes.size() - stream.pos >= sizeof(uint32_t)) {
+            uint32_t tag;
+            memcpy(&tag, stream.bytes.get() + stream.pos, sizeof(tag));
+            if (KTRACE_LEN(tag) == 0) {
+                error_handler_(cpu, "zero length record");
+                stream.corrupt = true;
+                return;
+            }
+        }
+        const ktrace_header_t* record = Peek(stream);
+        if (record == nullptr || !IsNameRecord(record->tag)) {
+            return;
+        }
+        Emit(record);
+        stream.pos += KTRACE_LEN(record->tag);
+    }
+}
+
+void KTraceMerger::Flush(uint64_t horizon) {
+    for (;;) {
+        uint32_t next_cpu = 0;
+        const ktrace_header_t* next = nullptr;
+        for (uint32_t i = 0; i < cpus_.size(); i++) {
+            const ktrace_header_t* record = Peek(cpus_[i]);
+            if (record == nullptr || record->ts >= horizon) {
+                continue;
+            }
+            if (next == nullptr || record->ts < next->ts) {
+                next = record;
+                next_cpu = i;
+            }
+        }
+        if (next == nullptr) {
+            break;
+        }
+        Emit(next);
+        cpus_[next_cpu].pos += KTRACE_LEN(next->tag);
+        PassNames(next_cpu);
+    }
+
+    // Drop the bytes that have been consumed.
+    for (CpuStream& stream : cpus_) {
+        if (stream.pos == 0) {
+            continue;
+        }
+        fbl::Vector<uint8_t> rest;
+        rest.reserve(stream.bytes.size() - stream.pos);
+        for (size_t i = stream.pos; i < stream.bytes.size(); i++) {
+            rest.push_back(stream.bytes[i]);
+        }
+        stream.bytes.swap(rest);
+        stream.pos = 0;
+    }
+}
+
+} // namespace trace
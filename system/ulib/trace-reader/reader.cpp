@@ -150,6 +150,9 @@ bool TraceReader::ReadMetadataRecord(Chunk& record, RecordHeader header) {
         }
         break;
     }
+    case MetadataType::kPadding:
+        // Unused space in the buffer, see trace_engine_set_thread_chunk_size().
+        break;
     default: {
         // Ignore unknown metadata types for forward compatibility.
         ReportError(fbl::StringPrintf(
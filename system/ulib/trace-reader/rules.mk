@@ -12,6 +12,8 @@ MODULE_TYPE := userlib
 MODULE_COMPILEFLAGS += -fvisibility=hidden
 
 MODULE_SRCS = \
+    $(LOCAL_DIR)/ktrace_flow_stitcher.cpp \
+    $(LOCAL_DIR)/ktrace_merger.cpp \
     $(LOCAL_DIR)/reader.cpp \
     $(LOCAL_DIR)/reader_internal.cpp \
     $(LOCAL_DIR)/records.cpp
@@ -36,11 +38,14 @@ MODULE_TYPE := hostlib
 MODULE_COMPILEFLAGS += -fvisibility=hidden
 
 MODULE_SRCS = \
+    $(LOCAL_DIR)/ktrace_flow_stitcher.cpp \
+    $(LOCAL_DIR)/ktrace_merger.cpp \
     $(LOCAL_DIR)/reader.cpp \
     $(LOCAL_DIR)/records.cpp
 
 MODULE_COMPILEFLAGS := \
     -Isystem/ulib/trace-engine/include \
+    -Isystem/ulib/zircon-internal/include \
     -Isystem/ulib/fbl/include
 
 MODULE_HOST_LIBS := \
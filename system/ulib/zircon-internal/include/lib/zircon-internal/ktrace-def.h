@@ -46,6 +46,10 @@ KTRACE_DEF(0x122,32B,PROC_EXIT,TASKS) // pid
 KTRACE_DEF(0x130,32B,CHANNEL_CREATE,IPC) // id0, id1, flags
 KTRACE_DEF(0x131,32B,CHANNEL_WRITE,IPC) // id0, bytes, handles
 KTRACE_DEF(0x132,32B,CHANNEL_READ,IPC) // id1, bytes, handles
+// The flow id of a message is shared by the record of its write and the
+// record of its read, so a reader can link the two.
+KTRACE_DEF(0x133,FLOW,CHANNEL_WRITE_FLOW,IPC_FLOW) // id0, flow, txid
+KTRACE_DEF(0x134,FLOW,CHANNEL_READ_FLOW,IPC_FLOW) // id1, flow, txid
 
 KTRACE_DEF(0x140,32B,PORT_WAIT,IPC) // id
 KTRACE_DEF(0x141,32B,PORT_WAIT_DONE,IPC) // id, status
@@ -23,6 +23,7 @@ __BEGIN_CDECLS
 
 #define KTRACE_TAG_16B(e,g)       KTRACE_TAG(e,g,16)
 #define KTRACE_TAG_32B(e,g)       KTRACE_TAG(e,g,32)
+#define KTRACE_TAG_FLOW(e,g)      KTRACE_TAG(e,g,40)
 #define KTRACE_TAG_NAME(e,g)      KTRACE_TAG(e,g,48)
 
 #define KTRACE_LEN(tag)           (((tag)&0xF)<<3)
@@ -37,7 +38,6 @@ __BEGIN_CDECLS
 #define KTRACE_VERSION            (0x00020000)
 
 // Filter Groups
-#define KTRACE_GRP_ALL            0xFFF
 #define KTRACE_GRP_META           0x001
 #define KTRACE_GRP_LIFECYCLE      0x002
 #define KTRACE_GRP_SCHEDULER      0x004
@@ -46,6 +46,11 @@ __BEGIN_CDECLS
 #define KTRACE_GRP_IRQ            0x020
 #define KTRACE_GRP_PROBE          0x040
 #define KTRACE_GRP_ARCH           0x080
+#define KTRACE_GRP_IPC_FLOW       0x100
+
+// Every group but IPC_FLOW, which records every channel message and
+// has to be asked for by name.
+#define KTRACE_GRP_ALL            (0xFFF & ~KTRACE_GRP_IPC_FLOW)
 
 #define KTRACE_GRP_TO_MASK(grp)   ((grp) << 20)
 
@@ -68,6 +73,19 @@ typedef struct ktrace_rec_32b {
     uint32_t d;
 } ktrace_rec_32b_t;
 
+typedef struct ktrace_rec_flow {
+    uint32_t tag;
+    uint32_t tid;
+    uint64_t ts;
+    uint64_t koid;
+    uint64_t flow_id;
+    uint32_t txid;
+    uint32_t reserved;
+} ktrace_rec_flow_t;
+
+static_assert(sizeof(ktrace_rec_flow_t) == 40,
+              "ktrace_rec_flow_t does not match KTRACE_TAG_FLOW");
+
 typedef struct ktrace_rec_name {
     uint32_t tag;
     uint32_t id;
@@ -84,9 +102,82 @@ enum {
 #define TAG_PROBE_24(n) KTRACE_TAG(((n)|0x800),KTRACE_GRP_PROBE,24)
 
 // Actions for ktrace control
-#define KTRACE_ACTION_START     1 // options = grpmask, 0 = all
+#define KTRACE_ACTION_START     1 // options = grpmask, 0 = KTRACE_GRP_ALL
 #define KTRACE_ACTION_STOP      2 // options ignored
 #define KTRACE_ACTION_REWIND    3 // options ignored
 #define KTRACE_ACTION_NEW_PROBE 4 // options ignored, ptr = name
+#define KTRACE_ACTION_SET_MODE  5 // options = KTRACE_MODE_*, tracing must be stopped
+#define KTRACE_ACTION_GET_VMO   6 // options = KTRACE_VMO_*, ptr = zx_handle_t* out
+
+// Buffer modes, selected with KTRACE_ACTION_SET_MODE or ktrace.mode=
+#define KTRACE_MODE_STREAMING   0 // drop new records when a cpu's ring is full
+#define KTRACE_MODE_CIRCULAR    1 // overwrite the oldest records (flight recorder)
+
+// VMOs returned by KTRACE_ACTION_GET_VMO
+#define KTRACE_VMO_BUFFER       0 // the trace buffer, read-only
+#define KTRACE_VMO_CONTROL      1 // the consumer tails, read/write
+
+// Layout of the trace buffer VMO
+//
+// The buffer starts with a ktrace_buffer_header_t, followed by one
+// region per cpu at cpu_offset + cpu * cpu_stride.  Each region is a
+// ktrace_cpu_header_t followed by a ring of |size| bytes of records.
+//
+// |head| and |tail| are monotonic byte counts, the live records are
+// at ring offsets [tail % size, head % size) and may wrap around the
+// end of the ring.  Records are always a multiple of 8 bytes, as is
+// the ring size, so a record's tag word never straddles the wrap.
+//
+// The buffer is only written by the kernel, which publishes |head| with
+// release semantics after the record bytes are written.  Its contents
+// describe the buffer to consumers; the kernel keeps its own copy of the
+// layout and of the ring positions and never reads them back.
+//
+// In streaming mode a consumer releases the space of the records it has
+// copied out by advancing its tail for that cpu (with release semantics)
+// in the control VMO, which holds one ktrace_cpu_control_t per cpu.  The
+// kernel ignores a consumer tail outside of the live records of the ring.
+// Records that do not fit are dropped and counted in |dropped|.  In
+// circular mode the kernel advances |tail| itself, ignoring the control
+// VMO, and a consumer should only snapshot the ring while stopped.
+// Rewinding the buffer resets the consumer tails to zero.
+
+#define KTRACE_BUFFER_MAGIC     0x6b747263 // 'ktrc'
+
+typedef struct ktrace_buffer_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_cpus;
+    uint32_t mode;
+    uint64_t ticks_per_ms;
+    uint64_t cpu_offset;
+    uint64_t cpu_stride;
+} ktrace_buffer_header_t;
+
+typedef struct ktrace_cpu_header {
+    uint64_t head;
+    uint64_t dropped;
+    uint64_t size;
+    uint32_t cpu;
+    uint32_t reserved0;
+    uint64_t reserved1[4];
+
+    // the oldest live record, as last seen by the kernel
+    uint64_t tail;
+    uint64_t reserved2[7];
+} ktrace_cpu_header_t;
+
+static_assert(sizeof(ktrace_cpu_header_t) == 128,
+              "ktrace_cpu_header_t is not 128 bytes");
+
+// One per cpu in the control VMO, each on its own cache line.
+typedef struct ktrace_cpu_control {
+    // written by the consumer in streaming mode
+    uint64_t tail;
+    uint64_t reserved[7];
+} ktrace_cpu_control_t;
+
+static_assert(sizeof(ktrace_cpu_control_t) == 64,
+              "ktrace_cpu_control_t is not 64 bytes");
 
 __END_CDECLS
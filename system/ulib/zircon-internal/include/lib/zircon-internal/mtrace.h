@@ -16,6 +16,7 @@ __BEGIN_CDECLS
 // interim.
 #define MTRACE_KIND_INSNTRACE 0
 #define MTRACE_KIND_CPUPERF 1
+#define MTRACE_KIND_SAMPLER 2
 
 // Actions for instruction tracing control
 
@@ -77,4 +78,28 @@ __BEGIN_CDECLS
 
 #define MTRACE_CPUPERF_OPTIONS_CPU(options) ((options) & MTRACE_CPUPERF_OPTIONS_CPU_MASK)
 
+// Actions for the timer driven sampling profiler
+// See lib/zircon-internal/sampler.h for the buffer layout.
+
+// Allocate the sample buffer for a session.
+// The argument is a zx_sampler_config_t.
+#define MTRACE_SAMPLER_INIT 0
+
+// Return a read-only handle to the sample buffer VMO.
+// The argument is a zx_handle_t to fill in.
+#define MTRACE_SAMPLER_GET_BUFFER 1
+
+// Start taking samples on every cpu.
+// Must be called after INIT with sampling off.
+#define MTRACE_SAMPLER_START 2
+
+// Stop taking samples.
+// May be called multiple times.
+#define MTRACE_SAMPLER_STOP 3
+
+// Free the sample buffer.
+// Must be called with sampling off.
+// Handles returned by GET_BUFFER stay valid.
+#define MTRACE_SAMPLER_FINI 4
+
 __END_CDECLS
@@ -0,0 +1,84 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Data shared between the kernel's timer driven sampling profiler
+// (mtrace kind MTRACE_KIND_SAMPLER) and the tools that read its buffer.
+
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+#define SAMPLER_BUFFER_MAGIC    0x6c706d73 // 'smpl'
+
+// Limits on zx_sampler_config_t
+#define SAMPLER_MIN_PERIOD_NS   10000u  // 10us
+#define SAMPLER_MAX_FRAMES      32u
+#define SAMPLER_MAX_BUFFER_SIZE (64u * 1024 * 1024) // per cpu
+
+// zx_sampler_config_t.flags
+#define SAMPLER_FLAG_KERNEL     (1u << 0) // sample threads running kernel code
+#define SAMPLER_FLAG_USER       (1u << 1) // sample threads running user code
+
+typedef struct zx_sampler_config {
+    // Time between samples on each cpu.
+    uint64_t period_ns;
+    // Bytes of samples to keep for each cpu.
+    uint32_t buffer_size;
+    // Maximum number of pcs in each sample, including the sampled pc.
+    uint16_t max_frames;
+    uint16_t flags;
+} zx_sampler_config_t;
+
+// The sample buffer starts with a sampler_buffer_header_t, followed by
+// one region per cpu at cpu_offset + cpu * cpu_stride.  Each region is a
+// sampler_cpu_header_t followed by |size| bytes of packed sample records.
+// The kernel publishes |written| with release semantics after each record
+// so the buffer can be read while a session is running.
+
+typedef struct sampler_buffer_header {
+    uint32_t magic;
+    uint32_t num_cpus;
+    uint64_t period_ns;
+    uint64_t cpu_offset;
+    uint64_t cpu_stride;
+} sampler_buffer_header_t;
+
+typedef struct sampler_cpu_header {
+    uint64_t size;
+    uint64_t written;
+    uint64_t samples;
+    // samples lost because the region was full
+    uint64_t dropped;
+} sampler_cpu_header_t;
+
+// sampler_record_t.flags
+#define SAMPLER_RECORD_USER     (1u << 0) // pcs are user addresses
+
+typedef struct sampler_record {
+    // monotonic time of the sample, in ns
+    uint64_t time;
+    // koids of the sampled thread and its process, 0 for kernel threads
+    uint64_t pid;
+    uint64_t tid;
+    uint16_t cpu;
+    uint16_t flags;
+    uint16_t num_frames;
+    uint16_t reserved;
+    // Followed by |num_frames| uint64_t pcs: the sampled pc, then the
+    // return addresses found by walking the frame pointer chain,
+    // innermost first.
+} sampler_record_t;
+
+static_assert(sizeof(sampler_record_t) == 32, "sampler_record_t is not 32 bytes");
+
+#define SAMPLER_RECORD_SIZE(num_frames) \
+    (sizeof(sampler_record_t) + (num_frames) * sizeof(uint64_t))
+#define SAMPLER_RECORD_PCS(record) \
+    ((const uint64_t*)((const sampler_record_t*)(record) + 1))
+
+__END_CDECLS
@@ -6,6 +6,7 @@
 
 #include <lib/zx/handle.h>
 #include <lib/zx/object.h>
+#include <lib/zx/resource.h>
 
 namespace zx {
 
@@ -38,6 +39,20 @@ public:
                      size_t* actual) const {
         return zx_socket_read(get(), flags, buffer, len, actual);
     }
+
+    zx_status_t writev(uint32_t flags, const zx_iovec_t* vector, size_t count,
+                       size_t* actual) const {
+        return zx_socket_writev(get(), flags, vector, count, actual);
+    }
+
+    zx_status_t readv(uint32_t flags, const zx_iovec_t* vector, size_t count,
+                      size_t* actual) const {
+        return zx_socket_readv(get(), flags, vector, count, actual);
+    }
+
+    zx_status_t set_rx_buf_max(const resource& resource, size_t size) const {
+        return zx_socket_set_rx_buf_max(get(), resource.get(), size);
+    }
 };
 
 using unowned_socket = unowned<socket>;
@@ -2,12 +2,17 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
+#include <blobfs/common.h>
 #include <blobfs/format.h>
+#include <blobfs/lz4.h>
+#include <blobfs/worker-pool.h>
 #include <digest/digest.h>
 #include <digest/merkle-tree.h>
 #include <fbl/algorithm.h>
@@ -113,6 +118,170 @@ fbl::String GetNameForOrder(ReadOrder order) {
     return "";
 }
 
+// A file of the corpus the compression benchmark is run on.
+struct CorpusFile {
+    fbl::unique_ptr<char[]> data;
+    size_t size;
+};
+
+// Directory holding the real binaries used as the compression corpus.
+constexpr char kCorpusPath[] = "/boot/bin";
+
+// Reads the files in |kCorpusPath| which blobfs would consider compressing,
+// up to |max_bytes| of them in total.
+bool LoadCorpus(size_t max_bytes, fbl::Vector<CorpusFile>* out) {
+    BEGIN_HELPER;
+    DIR* dir = opendir(kCorpusPath);
+    ASSERT_NONNULL(dir, strerror(errno));
+    size_t total = 0;
+    struct dirent* de;
+    while ((de = readdir(dir)) != nullptr && total < max_bytes) {
+        fbl::String path = fbl::StringPrintf("%s/%s", kCorpusPath, de->d_name);
+        fbl::unique_fd fd(open(path.c_str(), O_RDONLY));
+        struct stat st;
+        if (!fd || fstat(fd.get(), &st) != 0 || !S_ISREG(st.st_mode) ||
+            static_cast<size_t>(st.st_size) < blobfs::kCompressionMinBytesSaved) {
+            continue;
+        }
+        CorpusFile file;
+        file.size = fbl::min(static_cast<size_t>(st.st_size), max_bytes - total);
+        fbl::AllocChecker ac;
+        file.data.reset(new (&ac) char[file.size]);
+        ASSERT_TRUE(ac.check());
+        ASSERT_EQ(StreamAll(read, fd.get(), file.data.get(), file.size), 0, strerror(errno));
+        total += file.size;
+        out->push_back(fbl::move(file));
+    }
+    closedir(dir);
+    END_HELPER;
+}
+
+// Compresses each file of a corpus as blobfs would store it, in chunks of
+// |chunk_size| bytes, and measures reads at random offsets, each of which
+// needs to decompress only the chunk that holds it.  Larger chunks compress
+// better, and make each read slower.
+class CompressionTest {
+public:
+    CompressionTest(const fbl::Vector<CorpusFile>* corpus, uint32_t chunk_size)
+        : corpus_(corpus), chunk_size_(chunk_size) {}
+
+    bool RandomReadTest(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        state->DeclareStep("seek_table");
+        state->DeclareStep("decompress");
+        state->SetBytesProcessedPerRun(chunk_size_);
+        ASSERT_GT(corpus_->size(), 0);
+
+        fbl::Vector<fbl::unique_ptr<char[]>> compressed;
+        fbl::Vector<size_t> compressed_sizes;
+        size_t total_size = 0;
+        size_t total_compressed = 0;
+        for (const auto& file : *corpus_) {
+            blobfs::Compressor compressor(chunk_size_);
+            size_t max = compressor.BufferMax(file.size);
+            fbl::AllocChecker ac;
+            fbl::unique_ptr<char[]> buf(new (&ac) char[max]);
+            ASSERT_TRUE(ac.check());
+            ASSERT_EQ(compressor.Initialize(buf.get(), max, file.size), ZX_OK);
+            ASSERT_EQ(compressor.Update(file.data.get(), file.size), ZX_OK);
+            ASSERT_EQ(compressor.End(), ZX_OK);
+            total_size += file.size;
+            total_compressed += fbl::round_up(compressor.Size(), blobfs::kBlobfsBlockSize);
+            compressed.push_back(fbl::move(buf));
+            compressed_sizes.push_back(compressor.Size());
+        }
+        printf("%s: %zu bytes in %zu files compressed to %zu bytes (%.1f%%)\n", kCorpusPath,
+               total_size, corpus_->size(), total_compressed,
+               100.0 * static_cast<double>(total_compressed) / static_cast<double>(total_size));
+
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<char[]> buffer(new (&ac) char[chunk_size_]);
+        ASSERT_TRUE(ac.check());
+        while (state->KeepRunning()) {
+            size_t index = rand_r(fixture->mutable_seed()) % corpus_->size();
+            const CorpusFile& file = (*corpus_)[index];
+            blobfs::SeekTable table;
+            ASSERT_EQ(table.Init(compressed[index].get(), blobfs::SeekTable::SizeMax(file.size),
+                                 file.size, compressed_sizes[index]), ZX_OK);
+            uint32_t chunk = table.ChunkAt(rand_r(fixture->mutable_seed()) % file.size);
+            state->NextStep();
+            ASSERT_EQ(blobfs::Decompressor::DecompressChunk(
+                          table, chunk, buffer.get(),
+                          compressed[index].get() + table.CompressedStart(chunk)),
+                      ZX_OK);
+        }
+        END_HELPER;
+    }
+
+private:
+    const fbl::Vector<CorpusFile>* corpus_;
+    const uint32_t chunk_size_;
+};
+
+// Hashes and compresses a blob of |blob_size| bytes as blobfs does while the
+// blob is being written: a segment at a time, on a pool of |workers|
+// threads.  The blob is half incompressible, so that it is compressed to
+// the end.  This runs in-process, since the number of workers of a mounted
+// blobfs can't be chosen through fs-management.
+class IngestTest {
+public:
+    IngestTest(size_t blob_size, uint32_t workers)
+        : blob_size_(blob_size), workers_(workers) {}
+
+    bool HashAndCompressTest(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        state->DeclareStep("segments");
+        state->DeclareStep("finish");
+        state->SetBytesProcessedPerRun(blob_size_);
+
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[blob_size_]);
+        ASSERT_TRUE(ac.check());
+        for (size_t i = 0; i < blob_size_; i++) {
+            data[i] = (i % 2) ? static_cast<uint8_t>(rand_r(fixture->mutable_seed())) : 0;
+        }
+        size_t tree_len = MerkleTree::GetTreeLength(blob_size_);
+        fbl::unique_ptr<uint8_t[]> tree(new (&ac) uint8_t[tree_len]);
+        ASSERT_TRUE(ac.check());
+        blobfs::ChunkedCompressor compressor;
+        size_t max = compressor.BufferMax(blob_size_);
+        fbl::unique_ptr<uint8_t[]> compressed(new (&ac) uint8_t[max]);
+        ASSERT_TRUE(ac.check());
+        fbl::unique_ptr<blobfs::WorkerPool> pool;
+        ASSERT_EQ(blobfs::WorkerPool::Create(workers_, &pool), ZX_OK);
+
+        while (state->KeepRunning()) {
+            ASSERT_EQ(compressor.Initialize(compressed.get(), max, blob_size_), ZX_OK);
+            fbl::unique_ptr<blobfs::TaskGroup> segments;
+            ASSERT_EQ(blobfs::TaskGroup::Create(pool.get(), &segments), ZX_OK);
+            for (size_t offset = 0; offset < blob_size_; offset += blobfs::kWriteSegmentSize) {
+                size_t length = fbl::min(blob_size_ - offset, blobfs::kWriteSegmentSize);
+                segments->Submit([&, offset, length]() {
+                    zx_status_t status = MerkleTree::CreateLeaves(data.get(), blob_size_, offset,
+                                                                  length, tree.get(), tree_len);
+                    if (status != ZX_OK) {
+                        return status;
+                    }
+                    return compressor.CompressChunks(data.get(), offset, length);
+                });
+            }
+            ASSERT_EQ(segments->Wait(), ZX_OK);
+            state->NextStep();
+
+            Digest digest;
+            ASSERT_EQ(compressor.End(), ZX_OK);
+            ASSERT_EQ(MerkleTree::CreateRoot(data.get(), blob_size_, tree.get(), tree_len,
+                                             &digest), ZX_OK);
+            compressor.Reset();
+        }
+        END_HELPER;
+    }
+
+private:
+    const size_t blob_size_;
+    const uint32_t workers_;
+};
+
 // Creates a an in memory blob.
 bool MakeBlob(fbl::String fs_path, size_t blob_size, unsigned int* seed,
               fbl::unique_ptr<BlobInfo>* out) {
@@ -167,6 +336,179 @@ fbl::String GetNegativeLookupPath(const fbl::String& fs_path) {
     return negative_path;
 }
 
+// Measures writes to an aged image.  The disk is filled, mostly with large
+// blobs and then with blobs of one to four blocks, and every other small blob
+// is unlinked, so that no run of free blocks is longer than a few blocks and
+// every blob written must be split across many extents.
+class AgedWriteTest {
+public:
+    AgedWriteTest(size_t blob_size, bool age) : blob_size_(blob_size), age_(age) {}
+
+    bool WriteTest(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        state->DeclareStep("write");
+        state->DeclareStep("unlink");
+        state->SetBytesProcessedPerRun(blob_size_);
+        if (age_) {
+            ASSERT_TRUE(Age(fixture));
+        }
+
+        fbl::unique_ptr<BlobInfo> blob;
+        ASSERT_TRUE(MakeBlob(fixture->fs_path(), blob_size_, fixture->mutable_seed(), &blob));
+        while (state->KeepRunning()) {
+            fbl::unique_fd fd(open(blob->path.c_str(), O_CREAT | O_RDWR));
+            ASSERT_TRUE(fd, strerror(errno));
+            ASSERT_EQ(ftruncate(fd.get(), blob_size_), 0, strerror(errno));
+            ASSERT_EQ(StreamAll(write, fd.get(), blob->data.get(), blob->size_data), 0,
+                      strerror(errno));
+            ASSERT_EQ(fsync(fd.get()), 0);
+            ASSERT_EQ(close(fd.release()), 0);
+            state->NextStep();
+
+            ASSERT_EQ(unlink(blob->path.c_str()), 0, strerror(errno));
+        }
+        END_HELPER;
+    }
+
+private:
+    // Large enough that filling the disk with them is quick, and small
+    // enough that they leave little of the disk to the small blobs.
+    static constexpr size_t kBallastSize = 16 * 1024 * 1024;
+    static constexpr size_t kMaxSmallBlocks = 4;
+
+    bool Age(Fixture* fixture) {
+        BEGIN_HELPER;
+        ASSERT_TRUE(Fill(fixture, kBallastSize, 1, nullptr));
+        fbl::Vector<fbl::String> paths;
+        ASSERT_TRUE(Fill(fixture, blobfs::kBlobfsBlockSize, kMaxSmallBlocks, &paths));
+        for (size_t i = 0; i < paths.size(); i += 2) {
+            ASSERT_EQ(unlink(paths[i].c_str()), 0, strerror(errno));
+        }
+        END_HELPER;
+    }
+
+    // Writes blobs of one to |max_units| times |unit_size| bytes until the
+    // disk is full, appending their paths to |paths| if it is not null.
+    bool Fill(Fixture* fixture, size_t unit_size, size_t max_units,
+              fbl::Vector<fbl::String>* paths) {
+        BEGIN_HELPER;
+        while (true) {
+            size_t size = unit_size * (1 + rand_r(fixture->mutable_seed()) % max_units);
+            fbl::unique_ptr<BlobInfo> blob;
+            ASSERT_TRUE(MakeBlob(fixture->fs_path(), size, fixture->mutable_seed(), &blob));
+            fbl::unique_fd fd(open(blob->path.c_str(), O_CREAT | O_RDWR));
+            ASSERT_TRUE(fd, strerror(errno));
+            if (ftruncate(fd.get(), size) < 0) {
+                ASSERT_EQ(errno, ENOSPC, strerror(errno));
+                break;
+            }
+            ASSERT_EQ(StreamAll(write, fd.get(), blob->data.get(), blob->size_data), 0,
+                      strerror(errno));
+            if (paths != nullptr) {
+                paths->push_back(fbl::String(blob->path.c_str()));
+            }
+        }
+        END_HELPER;
+    }
+
+    const size_t blob_size_;
+    const bool age_;
+};
+
+// Replays a synthetic trace of application launches.  Each application is a
+// handful of blobs of its own plus a few of a set of blobs shared by every
+// application, as shared libraries are, and launching it opens, reads and
+// closes each of them.  Applications are launched with a skewed popularity,
+// so a few of them are launched often, and all of them together hold more
+// data than blobfs keeps in memory for closed blobs.
+class LaunchTraceTest {
+public:
+    LaunchTraceTest(size_t app_count, size_t blobs_per_app)
+        : app_count_(app_count), blobs_per_app_(blobs_per_app) {}
+
+    bool LaunchTest(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        state->DeclareStep("launch");
+        ASSERT_TRUE(MakeApps(fixture));
+
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<char[]> buffer(new (&ac) char[kMaxBlobSize]);
+        ASSERT_TRUE(ac.check());
+
+        while (state->KeepRunning()) {
+            // The minimum of two uniform picks favours the first applications.
+            size_t app = fbl::min(rand_r(fixture->mutable_seed()) % app_count_,
+                                  rand_r(fixture->mutable_seed()) % app_count_);
+            for (size_t i = 0; i < kSharedPerApp; i++) {
+                ASSERT_TRUE(ReadBlob(shared_[(app + i) % shared_.size()], buffer.get()));
+            }
+            for (size_t i = 0; i < blobs_per_app_; i++) {
+                ASSERT_TRUE(ReadBlob(apps_[app * blobs_per_app_ + i], buffer.get()));
+            }
+        }
+        END_HELPER;
+    }
+
+    // Disk space needed by the blobs of the applications.
+    size_t RequiredDiskSpace() const {
+        return (kSharedCount + app_count_ * blobs_per_app_) *
+               (kMaxBlobSize + 2 * MerkleTree::kNodeSize + blobfs::kBlobfsInodeSize);
+    }
+
+private:
+    static constexpr size_t kSharedCount = 16;
+    static constexpr size_t kSharedPerApp = 8;
+    static constexpr size_t kMaxBlobSize = 1 << 20;
+
+    struct TraceBlob {
+        fbl::String path;
+        size_t size;
+    };
+
+    bool MakeApps(Fixture* fixture) {
+        BEGIN_HELPER;
+        if (!shared_.is_empty()) {
+            return true;
+        }
+        for (size_t i = 0; i < kSharedCount; i++) {
+            ASSERT_TRUE(WriteBlob(fixture, &shared_));
+        }
+        for (size_t i = 0; i < app_count_ * blobs_per_app_; i++) {
+            ASSERT_TRUE(WriteBlob(fixture, &apps_));
+        }
+        END_HELPER;
+    }
+
+    // Writes a blob of between 16 Kb and |kMaxBlobSize| bytes, and appends
+    // it to |blobs|.
+    bool WriteBlob(Fixture* fixture, fbl::Vector<TraceBlob>* blobs) {
+        BEGIN_HELPER;
+        size_t size = (16 << 10) << (rand_r(fixture->mutable_seed()) % 7);
+        fbl::unique_ptr<BlobInfo> blob;
+        ASSERT_TRUE(MakeBlob(fixture->fs_path(), size, fixture->mutable_seed(), &blob));
+        fbl::unique_fd fd(open(blob->path.c_str(), O_CREAT | O_RDWR));
+        ASSERT_TRUE(fd, strerror(errno));
+        ASSERT_EQ(ftruncate(fd.get(), size), 0, strerror(errno));
+        ASSERT_EQ(StreamAll(write, fd.get(), blob->data.get(), blob->size_data), 0,
+                  strerror(errno));
+        blobs->push_back(TraceBlob{fbl::String(blob->path.c_str()), size});
+        END_HELPER;
+    }
+
+    bool ReadBlob(const TraceBlob& blob, char* buffer) {
+        BEGIN_HELPER;
+        fbl::unique_fd fd(open(blob.path.c_str(), O_RDONLY));
+        ASSERT_TRUE(fd, strerror(errno));
+        ASSERT_EQ(StreamAll(read, fd.get(), buffer, blob.size), 0, strerror(errno));
+        END_HELPER;
+    }
+
+    const size_t app_count_;
+    const size_t blobs_per_app_;
+    fbl::Vector<TraceBlob> shared_;
+    fbl::Vector<TraceBlob> apps_;
+};
+
 class BlobfsTest {
 public:
     BlobfsTest(BlobfsInfo&& info)
@@ -277,6 +619,46 @@ public:
         END_HELPER;
     }
 
+    // Measure the time taken to open a blob, read |read_size| bytes at an
+    // offset that is 0 or, if |random_offset|, a random multiple of
+    // |read_size|, and close it again.  Unless blobfs keeps a cache of
+    // closed blobs (blobfs --cache-size) that holds them all, closing a
+    // blob eventually evicts it, so reads go to disk; with a |read_size| of
+    // 1 at offset 0 this is the time to first byte.
+    bool PartialReadTest(size_t read_size, bool random_offset, perftest::RepeatState* state,
+                         Fixture* fixture) {
+        BEGIN_HELPER;
+        state->DeclareStep("open");
+        state->DeclareStep("read");
+        state->DeclareStep("close");
+        state->SetBytesProcessedPerRun(read_size);
+        ASSERT_GT(info_.paths.size(), 0);
+        ASSERT_LE(read_size, info_.blob_size);
+
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<char[]> buffer(new (&ac) char[read_size]);
+        ASSERT_TRUE(ac.check());
+
+        const size_t num_offsets = info_.blob_size / read_size;
+        uint64_t current = 0;
+        while (state->KeepRunning()) {
+            fbl::unique_fd fd(open(info_.paths[current % info_.paths.size()].c_str(), O_RDONLY));
+            ASSERT_TRUE(fd);
+            state->NextStep();
+            off_t offset = 0;
+            if (random_offset) {
+                offset = static_cast<off_t>((rand_r(fixture->mutable_seed()) % num_offsets) *
+                                            read_size);
+            }
+            ASSERT_EQ(pread(fd.get(), buffer.get(), read_size, offset),
+                      static_cast<ssize_t>(read_size));
+            state->NextStep();
+            ASSERT_EQ(close(fd.release()), 0);
+            ++current;
+        }
+        END_HELPER;
+    }
+
 private:
     void SortPathsByOrder(ReadOrder order, unsigned int* seed) {
         switch (order) {
@@ -318,6 +700,9 @@ bool RunBenchmark(int argc, char** argv) {
         128 * 1024,  // 128 Kb
         1024 * 1024, // 1 MB
     };
+    // Blobs are read in units of Merkle tree nodes, so partial reads are
+    // measured for blobs spanning several of them.
+    constexpr size_t kPartialReadSize = 16 * 1024;
     const size_t blob_counts[] = {
         10,
         100,
@@ -379,11 +764,157 @@ bool RunBenchmark(int argc, char** argv) {
                     testcase.tests.push_back(fbl::move(read_test));
                 }
             }
+
+            if (blob_count > 0 && blob_size > kPartialReadSize) {
+                const size_t required_disk_space =
+                    blob_count * (blob_size + 2 * MerkleTree::kNodeSize + blobfs::kBlobfsInodeSize);
+                TestInfo first_byte_test;
+                first_byte_test.name = fbl::StringPrintf(
+                    "%s/%s/%luBlobs/FirstByte", disk_format_string_[f_opts.fs_type],
+                    size.c_str(), blob_count);
+                first_byte_test.test_fn = [test_index,
+                                           &blobfs_tests](perftest::RepeatState* state,
+                                                          fs_test_utils::Fixture* fixture) {
+                    return blobfs_tests[test_index].PartialReadTest(1, false, state, fixture);
+                };
+                first_byte_test.required_disk_space = required_disk_space;
+                testcase.tests.push_back(fbl::move(first_byte_test));
+
+                TestInfo partial_read_test;
+                partial_read_test.name = fbl::StringPrintf(
+                    "%s/%s/%luBlobs/PartialRead%s", disk_format_string_[f_opts.fs_type],
+                    size.c_str(), blob_count, GetNameForSize(kPartialReadSize).c_str());
+                partial_read_test.test_fn = [test_index,
+                                             &blobfs_tests](perftest::RepeatState* state,
+                                                            fs_test_utils::Fixture* fixture) {
+                    return blobfs_tests[test_index].PartialReadTest(kPartialReadSize, true,
+                                                                    state, fixture);
+                };
+                partial_read_test.required_disk_space = required_disk_space;
+                testcase.tests.push_back(fbl::move(partial_read_test));
+            }
             testcases.push_back(fbl::move(testcase));
             ++test_index;
         }
     }
 
+    // Compression ratio against random read latency, over a sweep of chunk
+    // sizes.  The largest chunks are as big as most binaries, and so compress
+    // about as well as a single LZ4 frame per blob would.
+    const uint32_t chunk_sizes[] = {
+        blobfs::kBlobfsBlockSize,
+        2 * blobfs::kBlobfsBlockSize,
+        blobfs::kBlobfsChunkSize,
+        16 * blobfs::kBlobfsBlockSize,
+        128 * blobfs::kBlobfsBlockSize,
+    };
+    fbl::Vector<CorpusFile> corpus;
+    fbl::Vector<CompressionTest> compression_tests;
+    const size_t corpus_max_bytes = (p_opts.is_unittest) ? (1 << 20) : (32 << 20);
+    if (!LoadCorpus(corpus_max_bytes, &corpus)) {
+        return false;
+    }
+    if (corpus.size() > 0) {
+        TestCaseInfo testcase;
+        testcase.teardown = false;
+        testcase.sample_count = kSampleCount;
+        for (auto chunk_size : chunk_sizes) {
+            compression_tests.push_back(CompressionTest(&corpus, chunk_size));
+            size_t index = compression_tests.size() - 1;
+            TestInfo read_test;
+            read_test.name = fbl::StringPrintf("%s/Compression/%sChunks/RandomRead",
+                                               disk_format_string_[f_opts.fs_type],
+                                               GetNameForSize(chunk_size).c_str());
+            read_test.test_fn = [index, &compression_tests](perftest::RepeatState* state,
+                                                            fs_test_utils::Fixture* fixture) {
+                return compression_tests[index].RandomReadTest(state, fixture);
+            };
+            testcase.tests.push_back(fbl::move(read_test));
+        }
+        testcases.push_back(fbl::move(testcase));
+    }
+
+    // Write throughput on an aged image, where blobs can only be allocated as
+    // many short extents.  Aging fills the whole disk, so it is skipped when
+    // running as a unittest.
+    const size_t aged_blob_sizes[] = {
+        128 * 1024,  // 128 Kb
+        1024 * 1024, // 1 MB
+    };
+    fbl::Vector<AgedWriteTest> aged_tests;
+    for (auto blob_size : aged_blob_sizes) {
+        aged_tests.push_back(AgedWriteTest(blob_size, !p_opts.is_unittest));
+        size_t index = aged_tests.size() - 1;
+        TestCaseInfo testcase;
+        testcase.teardown = false;
+        testcase.sample_count = kSampleCount;
+        TestInfo write_test;
+        write_test.name = fbl::StringPrintf("%s/Aged/%s/Write",
+                                            disk_format_string_[f_opts.fs_type],
+                                            GetNameForSize(blob_size).c_str());
+        write_test.test_fn = [index, &aged_tests](perftest::RepeatState* state,
+                                                  fs_test_utils::Fixture* fixture) {
+            return aged_tests[index].WriteTest(state, fixture);
+        };
+        testcase.tests.push_back(fbl::move(write_test));
+        testcases.push_back(fbl::move(testcase));
+    }
+
+    // Ingestion throughput of the hashing and compression done while blobs
+    // are written, by number of worker threads.
+    const size_t ingest_blob_sizes[] = {
+        1024 * 1024,       // 1 MB
+        10 * 1024 * 1024,  // 10 MB
+        100 * 1024 * 1024, // 100 MB
+    };
+    const uint32_t ingest_workers[] = {1, 2, 4, 8};
+    fbl::Vector<IngestTest> ingest_tests;
+    {
+        TestCaseInfo testcase;
+        testcase.teardown = false;
+        testcase.sample_count = kSampleCount;
+        for (auto blob_size : ingest_blob_sizes) {
+            if (p_opts.is_unittest && blob_size > (1 << 20)) {
+                continue;
+            }
+            for (auto workers : ingest_workers) {
+                ingest_tests.push_back(IngestTest(blob_size, workers));
+                size_t index = ingest_tests.size() - 1;
+                TestInfo ingest_test;
+                ingest_test.name = fbl::StringPrintf("%s/Ingest/%s/%uWorkers",
+                                                     disk_format_string_[f_opts.fs_type],
+                                                     GetNameForSize(blob_size).c_str(), workers);
+                ingest_test.test_fn = [index, &ingest_tests](perftest::RepeatState* state,
+                                                             fs_test_utils::Fixture* fixture) {
+                    return ingest_tests[index].HashAndCompressTest(state, fixture);
+                };
+                testcase.tests.push_back(fbl::move(ingest_test));
+            }
+        }
+        testcases.push_back(fbl::move(testcase));
+    }
+
+    // Launch latency over a trace of application launches whose blobs do not
+    // all fit in a cache of closed blobs of blobfs::kDefaultCacheSize.
+    constexpr size_t kBlobsPerApp = 4;
+    const size_t app_count = (p_opts.is_unittest) ? 2 : 64;
+    LaunchTraceTest launch_test(app_count, kBlobsPerApp);
+    {
+        TestCaseInfo testcase;
+        testcase.teardown = false;
+        testcase.sample_count = kSampleCount;
+        TestInfo trace_test;
+        trace_test.name = fbl::StringPrintf("%s/LaunchTrace/%zuApps/Launch",
+                                            disk_format_string_[f_opts.fs_type], app_count);
+        trace_test.test_fn = [&launch_test](perftest::RepeatState* state,
+                                            fs_test_utils::Fixture* fixture) {
+            return launch_test.LaunchTest(state, fixture);
+        };
+        trace_test.required_disk_space = launch_test.RequiredDiskSpace();
+        testcase.tests.push_back(fbl::move(trace_test));
+        testcases.push_back(fbl::move(testcase));
+    }
+
     return fs_test_utils::RunTestCases(f_opts, p_opts, testcases);
 }
 
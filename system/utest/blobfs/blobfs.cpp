@@ -23,6 +23,7 @@
 #include <fbl/intrusive_double_list.h>
 #include <fbl/unique_fd.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <fs-management/fvm.h>
 #include <fs-management/mount.h>
 #include <fs-management/ramdisk.h>
@@ -1037,6 +1038,50 @@ static bool UseAfterUnlink(BlobfsTest* blobfsTest) {
     END_HELPER;
 }
 
+// Reads back more blobs than blobfs keeps in memory once they are closed, so
+// that reopening them must read in the blobs whose data has been evicted,
+// while a blob which is still mapped keeps its data.  Blobfs only keeps
+// closed blobs when mounted with --cache-size, and evicts them otherwise.
+static bool ReopenEvictedBlobs(BlobfsTest* blobfsTest) {
+    BEGIN_HELPER;
+    constexpr size_t kBlobSize = 1 << 20;
+    // Larger than blobfs::kDefaultCacheSize.
+    constexpr size_t kBlobCount = 48;
+
+    fbl::unique_ptr<blob_info_t> mapped_info;
+    ASSERT_TRUE(GenerateRandomBlob(kBlobSize, &mapped_info));
+    fbl::unique_fd fd;
+    ASSERT_TRUE(MakeBlob(mapped_info.get(), &fd));
+    void* addr = mmap(NULL, mapped_info->size_data, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    ASSERT_NE(addr, MAP_FAILED, "Could not mmap blob");
+    ASSERT_EQ(close(fd.release()), 0);
+
+    fbl::Vector<fbl::unique_ptr<blob_info_t>> blobs;
+    for (size_t i = 0; i < kBlobCount; i++) {
+        fbl::unique_ptr<blob_info_t> info;
+        ASSERT_TRUE(GenerateRandomBlob(kBlobSize, &info));
+        ASSERT_TRUE(MakeBlob(info.get(), &fd));
+        ASSERT_EQ(close(fd.release()), 0);
+        blobs.push_back(fbl::move(info));
+    }
+
+    // Read the blobs in the order they were closed, and then in reverse, so
+    // that both the least and the most recently closed blobs are reopened.
+    for (size_t i = 0; i < 2 * kBlobCount; i++) {
+        const blob_info_t* info = (i < kBlobCount) ? blobs[i].get()
+                                                   : blobs[2 * kBlobCount - i - 1].get();
+        fd.reset(open(info->path, O_RDONLY));
+        ASSERT_TRUE(fd, "Failed to reopen blob");
+        ASSERT_TRUE(VerifyContents(fd.get(), info->data.get(), info->size_data));
+        ASSERT_EQ(close(fd.release()), 0);
+    }
+
+    ASSERT_EQ(memcmp(addr, mapped_info->data.get(), mapped_info->size_data), 0,
+              "Mmap data invalid");
+    ASSERT_EQ(munmap(addr, mapped_info->size_data), 0);
+    END_HELPER;
+}
+
 static bool WriteAfterRead(BlobfsTest* blobfsTest) {
     BEGIN_HELPER;
     for (size_t i = 0; i < 16; i++) {
@@ -1325,6 +1370,70 @@ static bool CreateUmountRemountSmall(BlobfsTest* blobfsTest) {
     END_HELPER;
 }
 
+// Reads pieces of a blob out of order after a remount, so that they are read
+// from disk and verified piecemeal, then maps the whole blob.
+static bool CheckPartialReadsAfterRemount(BlobfsTest* blobfsTest, blob_info_t* info) {
+    BEGIN_HELPER;
+    constexpr size_t kNodeSize = digest::MerkleTree::kNodeSize;
+    ASSERT_GE(info->size_data, kNodeSize * 20);
+
+    fbl::unique_fd fd;
+    ASSERT_TRUE(MakeBlob(info, &fd));
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_TRUE(blobfsTest->Remount(), "Could not re-mount blobfs");
+
+    fd.reset(open(info->path, O_RDONLY));
+    ASSERT_TRUE(fd, "Failed to open blob");
+    const struct {
+        size_t offset;
+        size_t length;
+    } kReads[] = {
+        {info->size_data - 10, 10},          // The partial last node.
+        {kNodeSize * 7 + 5, 1},              // A single byte.
+        {kNodeSize * 5 - 1, kNodeSize + 2},  // Straddling three nodes.
+        {kNodeSize * 6, kNodeSize * 4},      // Partly read already.
+        {0, 1},
+    };
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<char[]> buf(new (&ac) char[kNodeSize * 4]);
+    ASSERT_TRUE(ac.check());
+    for (const auto& r : kReads) {
+        ASSERT_EQ(pread(fd.get(), buf.get(), r.length, r.offset), static_cast<ssize_t>(r.length));
+        ASSERT_EQ(memcmp(buf.get(), &info->data[r.offset], r.length), 0);
+    }
+
+    void* addr = mmap(nullptr, info->size_data, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    ASSERT_NE(addr, MAP_FAILED, "Could not mmap blob");
+    ASSERT_EQ(memcmp(addr, info->data.get(), info->size_data), 0);
+    ASSERT_EQ(munmap(addr, info->size_data), 0);
+    ASSERT_TRUE(VerifyContents(fd.get(), info->data.get(), info->size_data));
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_EQ(unlink(info->path), 0);
+    END_HELPER;
+}
+
+static bool PartialReadsAfterRemount(BlobfsTest* blobfsTest) {
+    BEGIN_HELPER;
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateRandomBlob(digest::MerkleTree::kNodeSize * 20 + 100, &info));
+    ASSERT_TRUE(CheckPartialReadsAfterRemount(blobfsTest, info.get()));
+    END_HELPER;
+}
+
+// As above, for a blob which is stored compressed, and so is read a chunk at
+// a time.
+static bool PartialReadsCompressedAfterRemount(BlobfsTest* blobfsTest) {
+    BEGIN_HELPER;
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateBlob([](char* data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            data[i] = static_cast<char>((i / 64) % 251);
+        }
+    }, digest::MerkleTree::kNodeSize * 20 + 100, &info));
+    ASSERT_TRUE(CheckPartialReadsAfterRemount(blobfsTest, info.get()));
+    END_HELPER;
+}
+
 static bool check_not_readable(int fd) {
     BEGIN_HELPER;
     struct pollfd fds;
@@ -1875,6 +1984,47 @@ static bool TestHugeBlobRandom(BlobfsTest* blobfsTest) {
     END_HELPER;
 }
 
+// Writes blobs in small pieces, so that they are hashed and compressed while
+// they are still being written, and so that the data of blobs which don't
+// compress well is written back early.
+static bool TestStreamedWrite(BlobfsTest* blobfsTest) {
+    BEGIN_HELPER;
+    constexpr size_t kBlobSize = 3 * (1 << 20) + 4321;
+    constexpr size_t kWriteSize = 20000;
+    fbl::unique_ptr<blob_info_t> infos[3];
+    ASSERT_TRUE(GenerateRandomBlob(kBlobSize, &infos[0]));
+    ASSERT_TRUE(GenerateBlob([](char* data, size_t length) {
+        memset(data, 'a', length);
+    }, kBlobSize, &infos[1]));
+    // Compresses well at first, but not by the end.
+    ASSERT_TRUE(GenerateBlob([](char* data, size_t length) {
+        memset(data, 'a', length / 4);
+        RandomFill(data + length / 4, length - length / 4);
+    }, kBlobSize, &infos[2]));
+
+    for (const auto& info : infos) {
+        fbl::unique_fd fd(open(info->path, O_CREAT | O_RDWR));
+        ASSERT_TRUE(fd, "Failed to create blob");
+        ASSERT_EQ(ftruncate(fd.get(), info->size_data), 0);
+        for (size_t off = 0; off < info->size_data; off += kWriteSize) {
+            size_t len = fbl::min(kWriteSize, info->size_data - off);
+            ASSERT_EQ(StreamAll(write, fd.get(), &info->data[off], len), 0,
+                      "Failed to write Data");
+        }
+        ASSERT_TRUE(VerifyContents(fd.get(), info->data.get(), info->size_data));
+        ASSERT_EQ(close(fd.release()), 0);
+    }
+
+    ASSERT_TRUE(blobfsTest->Remount());
+    for (const auto& info : infos) {
+        fbl::unique_fd fd(open(info->path, O_RDONLY));
+        ASSERT_TRUE(fd, "Failed to-reopen blob");
+        ASSERT_TRUE(VerifyContents(fd.get(), info->data.get(), info->size_data));
+        ASSERT_EQ(unlink(info->path), 0);
+    }
+    END_HELPER;
+}
+
 static bool TestHugeBlobCompressible(BlobfsTest* blobfsTest) {
     BEGIN_HELPER;
     fbl::unique_ptr<blob_info_t> info;
@@ -2348,12 +2498,12 @@ static bool TestCompressorBufferTooSmall(void) {
     fbl::AllocChecker ac;
     fbl::unique_ptr<char[]> buf(new (&ac) char[buf_size]);
     EXPECT_EQ(ac.check(), true);
-    ASSERT_EQ(c.Initialize(buf.get(), buf_size), ZX_OK);
 
     // Create data that is just too big to fit within this buffer size.
     size_t data_size = 0;
     while (c.BufferMax(++data_size) <= buf_size) {}
     ASSERT_GT(data_size, 0);
+    ASSERT_EQ(c.Initialize(buf.get(), buf_size, data_size), ZX_OK);
 
     unsigned int seed = 0;
     fbl::unique_ptr<char[]> data(new (&ac) char[data_size]);
@@ -2363,7 +2513,91 @@ static bool TestCompressorBufferTooSmall(void) {
         data[i] = static_cast<char>(rand_r(&seed));
     }
 
-    ASSERT_EQ(c.Update(&data, data_size), ZX_ERR_IO_DATA_INTEGRITY);
+    ASSERT_NE(c.Update(data.get(), data_size), ZX_OK);
+    END_TEST;
+}
+
+// Ensure that each chunk of a chunk-compressed blob can be decompressed on
+// its own, and that Compressor holds the blob to the size it was given.
+static bool TestCompressorChunks(void) {
+    BEGIN_TEST;
+    const size_t data_size = blobfs::kBlobfsChunkSize * 5 + 100;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<char[]> data(new (&ac) char[data_size]);
+    ASSERT_TRUE(ac.check());
+    for (size_t i = 0; i < data_size; i++) {
+        data[i] = static_cast<char>((i / 64) % 251);
+    }
+
+    blobfs::Compressor c;
+    const size_t buf_size = c.BufferMax(data_size);
+    fbl::unique_ptr<char[]> buf(new (&ac) char[buf_size]);
+    ASSERT_TRUE(ac.check());
+    ASSERT_EQ(c.Initialize(buf.get(), buf_size, data_size), ZX_OK);
+    // Updates needn't be aligned to chunks.
+    ASSERT_EQ(c.Update(data.get(), 1000), ZX_OK);
+    ASSERT_EQ(c.Update(data.get() + 1000, data_size - 1000), ZX_OK);
+    ASSERT_EQ(c.Update(data.get(), 1), ZX_ERR_OUT_OF_RANGE);
+    ASSERT_EQ(c.End(), ZX_OK);
+    ASSERT_LT(c.Size(), data_size);
+
+    blobfs::SeekTable table;
+    ASSERT_EQ(table.Init(buf.get(), c.Size(), data_size - 1, c.Size()), ZX_ERR_IO_DATA_INTEGRITY);
+    ASSERT_EQ(table.Init(buf.get(), c.Size(), data_size, c.Size()), ZX_OK);
+    ASSERT_EQ(table.num_chunks(), 6u);
+    ASSERT_EQ(table.ChunkLength(5), 100u);
+
+    fbl::unique_ptr<char[]> out(new (&ac) char[blobfs::kBlobfsChunkSize]);
+    ASSERT_TRUE(ac.check());
+    for (uint32_t chunk = table.num_chunks(); chunk-- > 0;) {
+        ASSERT_EQ(blobfs::Decompressor::DecompressChunk(
+                      table, chunk, out.get(), buf.get() + table.CompressedStart(chunk)),
+                  ZX_OK);
+        ASSERT_EQ(memcmp(out.get(), &data[chunk * blobfs::kBlobfsChunkSize],
+                         table.ChunkLength(chunk)), 0);
+    }
+    END_TEST;
+}
+
+// Ensure that ChunkedCompressor produces the chunked format whatever order
+// its chunks are compressed in, and only once all of them are.
+static bool TestChunkedCompressor(void) {
+    BEGIN_TEST;
+    const size_t data_size = blobfs::kBlobfsChunkSize * 5 + 100;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<char[]> data(new (&ac) char[data_size]);
+    ASSERT_TRUE(ac.check());
+    for (size_t i = 0; i < data_size; i++) {
+        data[i] = static_cast<char>((i / 64) % 251);
+    }
+
+    blobfs::ChunkedCompressor c;
+    const size_t buf_size = c.BufferMax(data_size);
+    fbl::unique_ptr<char[]> buf(new (&ac) char[buf_size]);
+    ASSERT_TRUE(ac.check());
+    ASSERT_EQ(c.Initialize(buf.get(), buf_size - 1, data_size), ZX_ERR_BUFFER_TOO_SMALL);
+    ASSERT_EQ(c.Initialize(buf.get(), buf_size, data_size), ZX_OK);
+    const size_t split = 3 * blobfs::kBlobfsChunkSize;
+    ASSERT_EQ(c.CompressChunks(data.get(), 1000, split), ZX_ERR_INVALID_ARGS);
+    ASSERT_EQ(c.CompressChunks(data.get(), split, data_size - split), ZX_OK);
+    ASSERT_EQ(c.End(), ZX_ERR_BAD_STATE);
+    ASSERT_EQ(c.CompressChunks(data.get(), 0, split), ZX_OK);
+    ASSERT_EQ(c.End(), ZX_OK);
+    ASSERT_LT(c.Size(), data_size);
+
+    blobfs::SeekTable table;
+    ASSERT_EQ(table.Init(buf.get(), c.Size(), data_size, c.Size()), ZX_OK);
+    ASSERT_EQ(table.num_chunks(), 6u);
+
+    fbl::unique_ptr<char[]> out(new (&ac) char[blobfs::kBlobfsChunkSize]);
+    ASSERT_TRUE(ac.check());
+    for (uint32_t chunk = 0; chunk < table.num_chunks(); chunk++) {
+        ASSERT_EQ(blobfs::Decompressor::DecompressChunk(
+                      table, chunk, out.get(), buf.get() + table.CompressedStart(chunk)),
+                  ZX_OK);
+        ASSERT_EQ(memcmp(out.get(), &data[chunk * blobfs::kBlobfsChunkSize],
+                         table.ChunkLength(chunk)), 0);
+    }
     END_TEST;
 }
 
@@ -2596,6 +2830,72 @@ static bool TestLargeBlob() {
     END_TEST;
 }
 
+// Fills blobfs with single-block blobs and unlinks every other one, so that
+// no run of free blocks is longer than a block, then writes a blob far larger
+// than any run, which must be split across many extents.
+static bool TestFragmentedAllocation() {
+    BEGIN_TEST;
+
+    BlobfsTest blobfsTest(FsTestType::kNormal);
+
+    blobfs::Superblock superblock;
+    superblock.flags = 0;
+    superblock.inode_count = blobfs::kBlobfsDefaultInodeCount;
+    superblock.journal_block_count = blobfs::kDefaultJournalBlocks;
+    superblock.data_block_count = 512;
+
+    uint64_t blobfs_blocks = blobfs::TotalBlocks(superblock);
+    uint64_t ramdisk_blocks = (blobfs_blocks * blobfs::kBlobfsBlockSize)
+                              / blobfsTest.GetBlockSize();
+    blobfsTest.SetBlockCount(ramdisk_blocks);
+
+    ASSERT_TRUE(blobfsTest.Init());
+
+    fbl::Vector<fbl::unique_ptr<blob_info_t>> blobs;
+    while (true) {
+        fbl::unique_ptr<blob_info_t> info;
+        ASSERT_TRUE(GenerateRandomBlob(blobfs::kBlobfsBlockSize, &info));
+
+        fbl::unique_fd fd(open(info->path, O_CREAT | O_RDWR));
+        ASSERT_TRUE(fd, "Failed to create blob");
+        if (ftruncate(fd.get(), info->size_data) < 0) {
+            ASSERT_EQ(errno, ENOSPC, "Blobfs expected to run out of space");
+            break;
+        }
+        ASSERT_EQ(StreamAll(write, fd.get(), info->data.get(), info->size_data), 0,
+                  "Failed to write Data");
+        ASSERT_EQ(close(fd.release()), 0);
+        blobs.push_back(fbl::move(info));
+    }
+    ASSERT_GT(blobs.size(), 64);
+
+    size_t free_blocks = 0;
+    for (size_t i = 0; i < blobs.size(); i += 2) {
+        ASSERT_EQ(unlink(blobs[i]->path), 0);
+        free_blocks++;
+    }
+
+    // Half of the free blocks, plus a block of Merkle tree.
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateRandomBlob((free_blocks / 2) * blobfs::kBlobfsBlockSize, &info));
+    fbl::unique_fd fd;
+    ASSERT_TRUE(MakeBlob(info.get(), &fd));
+    ASSERT_EQ(close(fd.release()), 0);
+
+    ASSERT_TRUE(blobfsTest.Remount(), "Could not re-mount blobfs");
+    fd.reset(open(info->path, O_RDONLY));
+    ASSERT_TRUE(fd, "Failed to open blob");
+    ASSERT_TRUE(VerifyContents(fd.get(), info->data.get(), info->size_data));
+    ASSERT_EQ(close(fd.release()), 0);
+
+    // Unlinking the blob frees all of its extents and extent containers.
+    ASSERT_EQ(unlink(info->path), 0);
+    ASSERT_TRUE(blobfsTest.Remount(), "Could not re-mount blobfs");
+
+    ASSERT_TRUE(blobfsTest.Teardown());
+    END_TEST;
+}
+
 // TODO(ZX-2416): Add tests to manually corrupt journal entries/metadata.
 
 BEGIN_TEST_CASE(blobfs_tests)
@@ -2608,6 +2908,7 @@ RUN_TESTS(MEDIUM, TestReaddir)
 RUN_TESTS(MEDIUM, TestDiskTooSmall)
 RUN_TEST_FVM(MEDIUM, TestQueryInfo)
 RUN_TESTS(MEDIUM, UseAfterUnlink)
+RUN_TESTS(MEDIUM, ReopenEvictedBlobs)
 RUN_TESTS(MEDIUM, WriteAfterRead)
 RUN_TESTS(MEDIUM, WriteAfterUnlink)
 RUN_TESTS(MEDIUM, ReadTooLarge)
@@ -2619,6 +2920,8 @@ RUN_TESTS(MEDIUM, UmountWithOpenFile)
 RUN_TESTS(MEDIUM, UmountWithMappedFile)
 RUN_TESTS(MEDIUM, UmountWithOpenMappedFile)
 RUN_TESTS(MEDIUM, CreateUmountRemountSmall)
+RUN_TESTS(MEDIUM, PartialReadsAfterRemount)
+RUN_TESTS(MEDIUM, PartialReadsCompressedAfterRemount)
 RUN_TESTS(MEDIUM, EarlyRead)
 RUN_TESTS(MEDIUM, WaitForRead)
 RUN_TESTS(MEDIUM, WriteSeekIgnored)
@@ -2628,6 +2931,7 @@ RUN_TESTS(MEDIUM, RootDirectory)
 RUN_TESTS(MEDIUM, TestPartialWrite)
 RUN_TESTS(MEDIUM, TestPartialWriteSleepRamdisk)
 RUN_TESTS(MEDIUM, TestAlternateWrite)
+RUN_TESTS(MEDIUM, TestStreamedWrite)
 RUN_TESTS(LARGE, TestHugeBlobRandom)
 RUN_TESTS(LARGE, TestHugeBlobCompressible)
 RUN_TESTS(LARGE, CreateUmountRemountLarge)
@@ -2639,9 +2943,12 @@ RUN_TEST_FVM(MEDIUM, ResizePartition)
 RUN_TEST_FVM(MEDIUM, CorruptAtMount)
 RUN_TESTS(LARGE, CreateWriteReopen)
 RUN_TEST(TestCompressorBufferTooSmall)
+RUN_TEST(TestCompressorChunks)
+RUN_TEST(TestChunkedCompressor)
 RUN_TEST_MEDIUM(TestCreateFailure)
 RUN_TEST_MEDIUM(TestExtendFailure)
 RUN_TEST_LARGE(TestLargeBlob)
+RUN_TEST_LARGE(TestFragmentedAllocation)
 RUN_TESTS(SMALL, TestFailedWrite)
 END_TEST_CASE(blobfs_tests)
 
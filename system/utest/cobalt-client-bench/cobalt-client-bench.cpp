@@ -0,0 +1,81 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures the cost of recording into cobalt-client metrics while other
+// threads record into the same metric, as the filesystems do on their I/O
+// paths.  The SharedAtomic cases increment a single atomic instead, which
+// is what every metric did before it was sharded.
+
+#include <cobalt-client/cpp/counter-internal.h>
+#include <cobalt-client/cpp/histogram-internal.h>
+#include <fbl/atomic.h>
+#include <fbl/string_printf.h>
+#include <perftest/contenders.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+
+namespace {
+
+using cobalt_client::internal::BaseCounter;
+using cobalt_client::internal::BaseHistogram;
+
+constexpr uint32_t kHistogramBuckets = 10;
+
+// Measure the time taken to increment an atomic shared by |threads| threads.
+bool SharedAtomicIncrementTest(perftest::RepeatState* state, uint32_t threads) {
+    fbl::atomic<uint64_t> counter(0);
+    perftest::Contenders background(threads - 1, [&counter] {
+        counter.fetch_add(1, fbl::memory_order_relaxed);
+    });
+
+    while (state->KeepRunning()) {
+        counter.fetch_add(1, fbl::memory_order_relaxed);
+    }
+    return true;
+}
+
+// Measure the time taken to increment a counter shared by |threads| threads.
+bool CounterIncrementTest(perftest::RepeatState* state, uint32_t threads) {
+    BaseCounter counter;
+    perftest::Contenders background(threads - 1, [&counter] { counter.Increment(); });
+
+    while (state->KeepRunning()) {
+        counter.Increment();
+    }
+    ZX_ASSERT(counter.Load() > 0);
+    return true;
+}
+
+// Measure the time taken to add a sample to a histogram shared by |threads|
+// threads, which all record into the same bucket.
+bool HistogramIncrementTest(perftest::RepeatState* state, uint32_t threads) {
+    BaseHistogram histogram(kHistogramBuckets);
+    perftest::Contenders background(threads - 1, [&histogram] { histogram.IncrementCount(1); });
+
+    while (state->KeepRunning()) {
+        histogram.IncrementCount(1);
+    }
+    ZX_ASSERT(histogram.GetCount(1) > 0);
+    return true;
+}
+
+void RegisterTests() {
+    static const uint32_t kThreads[] = {1, 2, 8};
+    for (auto threads : kThreads) {
+        auto name = fbl::StringPrintf("CobaltClient/SharedAtomic/Increment/%uthreads",
+                                      threads);
+        perftest::RegisterTest(name.c_str(), SharedAtomicIncrementTest, threads);
+        name = fbl::StringPrintf("CobaltClient/Counter/Increment/%uthreads", threads);
+        perftest::RegisterTest(name.c_str(), CounterIncrementTest, threads);
+        name = fbl::StringPrintf("CobaltClient/Histogram/Increment/%uthreads", threads);
+        perftest::RegisterTest(name.c_str(), HistogramIncrementTest, threads);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+} // namespace
+
+int main(int argc, char** argv) {
+    return perftest::PerfTestMain(argc, argv, "fuchsia.zircon.cobalt_client");
+}
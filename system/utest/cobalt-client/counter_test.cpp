@@ -225,6 +225,57 @@ bool TestExchangeMultiThread() {
     END_TEST;
 }
 
+struct ShardArgs {
+    // Counter to be operated on.
+    BaseCounter* counter;
+
+    // Shard assigned to the thread.
+    uint32_t shard;
+};
+
+int ShardFn(void* args) {
+    ShardArgs* shard_args = static_cast<ShardArgs*>(args);
+    shard_args->shard = GetShardIndex();
+    if (GetShardIndex() != shard_args->shard) {
+        return thrd_error;
+    }
+    shard_args->counter->Increment();
+    return thrd_success;
+}
+
+// Verify that up to kShardCount threads are each given a shard of their own, and that
+// increments from every shard are accounted for.
+bool TestShardPerThread() {
+    BEGIN_TEST;
+    BaseCounter counter;
+    thrd_t thread_ids[kShardCount];
+    ShardArgs args[kShardCount];
+
+    // Threads get their shard on first use, so they run one at a time to be assigned
+    // consecutive shards.
+    for (uint32_t i = 0; i < kShardCount; ++i) {
+        args[i].counter = &counter;
+        ASSERT_EQ(thrd_create(&thread_ids[i], ShardFn, &args[i]), thrd_success);
+        int result;
+        ASSERT_EQ(thrd_join(thread_ids[i], &result), thrd_success);
+        ASSERT_EQ(result, thrd_success);
+    }
+
+    for (uint32_t i = 0; i < kShardCount; ++i) {
+        ASSERT_LT(args[i].shard, kShardCount);
+        for (uint32_t j = i + 1; j < kShardCount; ++j) {
+            EXPECT_NE(args[i].shard, args[j].shard);
+        }
+    }
+
+    ASSERT_EQ(counter.Load(), kShardCount);
+    BaseCounter moved(fbl::move(counter));
+    ASSERT_EQ(counter.Load(), 0);
+    ASSERT_EQ(moved.Exchange(), kShardCount);
+    ASSERT_EQ(moved.Load(), 0);
+    END_TEST;
+}
+
 // Verify that the metadata used to create the counter is part of the flushes observation
 // and that the current value of the counter is correct, plus resets to 0 after flush.
 bool TestFlush() {
@@ -349,6 +400,7 @@ RUN_TEST(TestExchange)
 RUN_TEST(TestExchangeByVal)
 RUN_TEST(TestIncrementMultiThread)
 RUN_TEST(TestExchangeMultiThread)
+RUN_TEST(TestShardPerThread)
 END_TEST_CASE(BaseCounterTest)
 
 BEGIN_TEST_CASE(RemoteCounterTest)
@@ -14,6 +14,7 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <fbl/algorithm.h>
 
@@ -898,6 +899,80 @@ bool job_children_smoke() {
     return jobch_helper_smoke(ZX_INFO_JOB_CHILDREN, kTestJobChildJobs);
 }
 
+// Tests that ZX_INFO_TASK_FAULTS counts the faults of touching new pages.
+bool task_faults_smoke() {
+    BEGIN_TEST;
+    constexpr size_t kNumPages = 4;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(kNumPages * PAGE_SIZE, 0u, &vmo), ZX_OK);
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0, vmo, 0,
+                          kNumPages * PAGE_SIZE, &addr),
+              ZX_OK);
+
+    zx_info_task_faults_t before;
+    ASSERT_EQ(zx_object_get_info(zx_thread_self(), ZX_INFO_TASK_FAULTS,
+                                 &before, sizeof(before), nullptr, nullptr),
+              ZX_OK);
+    for (size_t i = 0; i < kNumPages; i++) {
+        reinterpret_cast<volatile uint8_t*>(addr)[i * PAGE_SIZE] = 1;
+    }
+    zx_info_task_faults_t after;
+    ASSERT_EQ(zx_object_get_info(zx_thread_self(), ZX_INFO_TASK_FAULTS,
+                                 &after, sizeof(after), nullptr, nullptr),
+              ZX_OK);
+    EXPECT_GE(after.write_faults - before.write_faults, kNumPages);
+    EXPECT_GE(after.zero_fill_faults - before.zero_fill_faults, kNumPages);
+
+    // The process total includes this thread.
+    zx_info_task_faults_t process;
+    ASSERT_EQ(zx_object_get_info(zx_process_self(), ZX_INFO_TASK_FAULTS,
+                                 &process, sizeof(process), nullptr, nullptr),
+              ZX_OK);
+    EXPECT_GE(process.write_faults, after.write_faults);
+    EXPECT_GE(process.zero_fill_faults, after.zero_fill_faults);
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, kNumPages * PAGE_SIZE), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    END_TEST;
+}
+
+// Tests that ZX_INFO_TASK_SYSCALLS counts syscalls by name.
+bool task_syscalls_smoke() {
+    BEGIN_TEST;
+    constexpr uint64_t kNumCalls = 5;
+    char name[ZX_MAX_NAME_LEN];
+    for (uint64_t i = 0; i < kNumCalls; i++) {
+        ASSERT_EQ(zx_object_get_property(zx_thread_self(), ZX_PROP_NAME, name, sizeof(name)),
+                  ZX_OK);
+    }
+
+    zx_info_task_syscall_t syscalls[64];
+    size_t actual;
+    size_t avail;
+    ASSERT_EQ(zx_object_get_info(zx_thread_self(), ZX_INFO_TASK_SYSCALLS, syscalls,
+                                 sizeof(syscalls), &actual, &avail),
+              ZX_OK);
+    EXPECT_EQ(actual, avail);
+    if (actual == 0) {
+        // We have made syscalls, so the kernel is not counting them.
+        unittest_printf("syscall stats disabled (kernel.syscall-stats), skipping\n");
+        END_TEST;
+    }
+
+    bool found = false;
+    for (size_t i = 0; i < actual; i++) {
+        EXPECT_GT(syscalls[i].count, 0u);
+        if (!strcmp(syscalls[i].name, "object_get_property")) {
+            EXPECT_GE(syscalls[i].count, kNumCalls);
+            EXPECT_GT(syscalls[i].time, 0);
+            found = true;
+        }
+    }
+    EXPECT_TRUE(found);
+    END_TEST;
+}
+
 uint32_t handle_count_or_zero(zx_handle_t handle) {
     zx_info_handle_count_t info;
     if (ZX_OK != zx_object_get_info(
@@ -1053,6 +1128,19 @@ RUN_SINGLE_ENTRY_TESTS(ZX_INFO_THREAD_STATS, zx_info_thread_stats_t, zx_thread_s
 RUN_TEST((wrong_handle_type_fails<ZX_INFO_THREAD_STATS, zx_info_thread_t, get_test_job>));
 RUN_TEST((wrong_handle_type_fails<ZX_INFO_THREAD_STATS, zx_info_thread_t, get_test_process>));
 
+RUN_TEST(task_faults_smoke);
+RUN_SINGLE_ENTRY_TESTS(ZX_INFO_TASK_FAULTS, zx_info_task_faults_t, zx_thread_self);
+RUN_SINGLE_ENTRY_TESTS(ZX_INFO_TASK_FAULTS, zx_info_task_faults_t, get_test_process);
+RUN_TEST((wrong_handle_type_fails<ZX_INFO_TASK_FAULTS, zx_info_task_faults_t, get_test_job>));
+
+// Not RUN_MULTI_ENTRY_TESTS: the number of entries can grow between calls.
+RUN_TEST(task_syscalls_smoke);
+RUN_TEST((invalid_handle_fails<ZX_INFO_TASK_SYSCALLS, zx_info_task_syscall_t>));
+RUN_TEST((null_avail_actual_succeeds<ZX_INFO_TASK_SYSCALLS, zx_info_task_syscall_t, zx_thread_self>));
+RUN_TEST((bad_buffer_fails<ZX_INFO_TASK_SYSCALLS, zx_info_task_syscall_t, zx_thread_self>));
+RUN_TEST((multi_zero_buffer_succeeds<ZX_INFO_TASK_SYSCALLS, zx_thread_self>));
+RUN_TEST((wrong_handle_type_fails<ZX_INFO_TASK_SYSCALLS, zx_info_task_syscall_t, get_test_job>));
+
 // ZX_INFO_PROCESS_THREADS tests.
 // TODO(dbort): Use RUN_MULTI_ENTRY_TESTS instead. |short_buffer_succeeds| and
 // |partially_unmapped_buffer_fails| currently fail because those tests expect
@@ -27,6 +27,16 @@ static bool make_profile_fails(void) {
         profile_info.type = ZX_PROFILE_INFO_SCHEDULER;
         profile_info.scheduler.priority = ZX_PRIORITY_HIGHEST + 1;
         ASSERT_EQ(zx_profile_create(rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+
+        profile_info.type = ZX_PROFILE_INFO_CPU_MASK;
+        profile_info.cpu_mask.mask = 0;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+
+        uint32_t num_cpus = zx_system_get_num_cpus();
+        if (num_cpus < 32) {
+            profile_info.cpu_mask.mask = 1u << num_cpus;
+            ASSERT_EQ(zx_profile_create(rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+        }
     }
 
     END_TEST;
@@ -61,7 +71,50 @@ static bool change_priority_via_profile(void) {
     END_TEST;
 }
 
+static bool change_affinity_via_profile(void) {
+    BEGIN_TEST;
+
+    zx_handle_t rrh = get_root_resource();
+    if (rrh == ZX_HANDLE_INVALID) {
+        unittest_printf("no root resource. skipping test\n");
+    } else {
+        zx_profile_info_t profile_info = { 0 };
+        profile_info.type = ZX_PROFILE_INFO_CPU_MASK;
+
+        // Pin to the last cpu, so that on a multi-cpu system the thread
+        // has to move off the boot cpu.
+        uint32_t num_cpus = zx_system_get_num_cpus();
+        uint32_t pinned_cpu = (num_cpus < 32 ? num_cpus : 32) - 1;
+
+        zx_handle_t pinned;
+        profile_info.cpu_mask.mask = 1u << pinned_cpu;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &pinned), ZX_OK, "");
+
+        zx_handle_t unpinned;
+        profile_info.cpu_mask.mask = num_cpus < 32 ? (1u << num_cpus) - 1 : ~0u;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &unpinned), ZX_OK, "");
+
+        ASSERT_EQ(zx_object_set_profile(zx_thread_self(), pinned, 0), ZX_OK, "");
+        // Block so that the thread is scheduled again under the new mask,
+        // then check where it ran.
+        for (int i = 0; i < 10; i++) {
+            zx_nanosleep(ZX_USEC(100));
+            zx_info_thread_stats_t stats;
+            ASSERT_EQ(zx_object_get_info(zx_thread_self(), ZX_INFO_THREAD_STATS,
+                                         &stats, sizeof(stats), NULL, NULL), ZX_OK, "");
+            ASSERT_EQ(stats.last_scheduled_cpu, pinned_cpu, "thread ran outside its cpu mask");
+        }
+        ASSERT_EQ(zx_object_set_profile(zx_thread_self(), unpinned, 0), ZX_OK, "");
+
+        ASSERT_EQ(zx_handle_close(pinned), ZX_OK, "");
+        ASSERT_EQ(zx_handle_close(unpinned), ZX_OK, "");
+    }
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(profile_tests)
 RUN_TEST(make_profile_fails)
 RUN_TEST(change_priority_via_profile)
+RUN_TEST(change_affinity_via_profile)
 END_TEST_CASE(profile_tests)
@@ -10,6 +10,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+extern zx_handle_t get_root_resource(void);
+
 static zx_signals_t get_satisfied_signals(zx_handle_t handle) {
     zx_signals_t pending = 0;
     zx_object_wait_one(handle, 0u, 0u, &pending);
@@ -1153,6 +1155,167 @@ bool socket_share_consumes_on_failure(void) {
     END_TEST;
 }
 
+static bool socket_writev_readv(void) {
+    BEGIN_TEST;
+
+    zx_handle_t h0, h1;
+    ASSERT_EQ(zx_socket_create(0, &h0, &h1), ZX_OK, "");
+
+    char a[] = "hello, ";
+    char b[] = "scatter";
+    char c[] = "/gather";
+    zx_iovec_t wvec[] = {
+        {a, 7u},
+        {NULL, 0u},
+        {b, 7u},
+        {c, 7u},
+    };
+    size_t count = 0;
+    EXPECT_EQ(zx_socket_writev(h0, 0u, wvec, countof(wvec), &count), ZX_OK, "");
+    EXPECT_EQ(count, 21u, "");
+
+    char r0[4] = {0};
+    char r1[32] = {0};
+    zx_iovec_t rvec[] = {
+        {r0, sizeof(r0)},
+        {r1, sizeof(r1)},
+    };
+    count = 0;
+    EXPECT_EQ(zx_socket_readv(h1, 0u, rvec, countof(rvec), &count), ZX_OK, "");
+    EXPECT_EQ(count, 21u, "");
+    EXPECT_EQ(memcmp(r0, "hell", 4), 0, "");
+    EXPECT_EQ(memcmp(r1, "o, scatter/gather", 17), 0, "");
+
+    EXPECT_EQ(zx_socket_readv(h1, 0u, rvec, countof(rvec), &count), ZX_ERR_SHOULD_WAIT, "");
+
+    // Too many entries and non-zero options are rejected.
+    zx_iovec_t many[ZX_SOCKET_IOVEC_MAX + 1] = {};
+    EXPECT_EQ(zx_socket_writev(h0, 0u, many, countof(many), &count), ZX_ERR_OUT_OF_RANGE, "");
+    EXPECT_EQ(zx_socket_writev(h0, ZX_SOCKET_CONTROL, wvec, countof(wvec), &count),
+              ZX_ERR_INVALID_ARGS, "");
+
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+
+    END_TEST;
+}
+
+static bool socket_datagram_writev_readv(void) {
+    BEGIN_TEST;
+
+    zx_handle_t h0, h1;
+    ASSERT_EQ(zx_socket_create(ZX_SOCKET_DATAGRAM, &h0, &h1), ZX_OK, "");
+
+    // A single datagram gathered from several buffers, one of which is larger than a page.
+    const size_t big_size = 3 * 4096 + 17;
+    char* big = malloc(big_size);
+    ASSERT_NONNULL(big, "");
+    for (size_t i = 0; i < big_size; ++i) {
+        big[i] = (char)i;
+    }
+    char head[] = "head";
+    zx_iovec_t wvec[] = {
+        {head, 4u},
+        {big, big_size},
+    };
+    size_t count = 0;
+    EXPECT_EQ(zx_socket_writev(h0, 0u, wvec, countof(wvec), &count), ZX_OK, "");
+    EXPECT_EQ(count, 4u + big_size, "");
+    EXPECT_EQ(zx_socket_write(h0, 0u, "next", 4u, &count), ZX_OK, "");
+
+    char* rbig = malloc(big_size);
+    ASSERT_NONNULL(rbig, "");
+    char rhead[4] = {0};
+    zx_iovec_t rvec[] = {
+        {rhead, sizeof(rhead)},
+        {rbig, big_size},
+    };
+    EXPECT_EQ(zx_socket_readv(h1, 0u, rvec, countof(rvec), &count), ZX_OK, "");
+    EXPECT_EQ(count, 4u + big_size, "");
+    EXPECT_EQ(memcmp(rhead, head, 4), 0, "");
+    EXPECT_EQ(memcmp(rbig, big, big_size), 0, "");
+
+    char next[8] = {0};
+    EXPECT_EQ(zx_socket_read(h1, 0u, next, sizeof(next), &count), ZX_OK, "");
+    EXPECT_EQ(count, 4u, "");
+    EXPECT_EQ(memcmp(next, "next", 4), 0, "");
+
+    free(big);
+    free(rbig);
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+
+    END_TEST;
+}
+
+static bool socket_set_rx_buf_max(void) {
+    BEGIN_TEST;
+
+    zx_handle_t h0, h1;
+    ASSERT_EQ(zx_socket_create(0, &h0, &h1), ZX_OK, "");
+
+    size_t value = 0;
+    ASSERT_EQ(zx_object_get_property(h1, ZX_PROP_SOCKET_RX_BUF_MAX, &value, sizeof(value)),
+              ZX_OK, "");
+    const size_t default_max = value;
+
+    // Growing the buffer past its default takes the root resource.
+    const size_t big_max = 4 * 1024 * 1024;
+    value = big_max;
+    EXPECT_EQ(zx_object_set_property(h1, ZX_PROP_SOCKET_RX_BUF_MAX, &value, sizeof(value)),
+              ZX_ERR_OUT_OF_RANGE, "");
+    EXPECT_EQ(zx_socket_set_rx_buf_max(h1, ZX_HANDLE_INVALID, big_max), ZX_ERR_BAD_HANDLE, "");
+    EXPECT_EQ(zx_socket_set_rx_buf_max(h1, h0, big_max), ZX_ERR_WRONG_TYPE, "");
+
+    zx_handle_t rrh = get_root_resource();
+    if (rrh == ZX_HANDLE_INVALID) {
+        unittest_printf("no root resource. skipping large buffer\n");
+        zx_handle_close(h0);
+        zx_handle_close(h1);
+        END_TEST;
+    }
+
+    // Grow the receive buffer of h1 and see that h0 can now write more at once.
+    ASSERT_EQ(zx_socket_set_rx_buf_max(h1, rrh, big_max), ZX_OK, "");
+    ASSERT_EQ(zx_object_get_property(h0, ZX_PROP_SOCKET_TX_BUF_MAX, &value, sizeof(value)),
+              ZX_OK, "");
+    EXPECT_EQ(value, big_max, "");
+
+    char* buffer = malloc(big_max);
+    ASSERT_NONNULL(buffer, "");
+    memset(buffer, 'x', big_max);
+    size_t written = 0;
+    EXPECT_EQ(zx_socket_write(h0, 0u, buffer, big_max, &written), ZX_OK, "");
+    EXPECT_EQ(written, big_max, "");
+    EXPECT_FALSE(get_satisfied_signals(h0) & ZX_SOCKET_WRITABLE, "");
+
+    // Shrinking below the buffered amount keeps the data but the socket stays full.
+    value = default_max;
+    ASSERT_EQ(zx_object_set_property(h1, ZX_PROP_SOCKET_RX_BUF_MAX, &value, sizeof(value)),
+              ZX_OK, "");
+    EXPECT_EQ(zx_socket_write(h0, 0u, buffer, 1u, &written), ZX_ERR_SHOULD_WAIT, "");
+    size_t nread = 0;
+    EXPECT_EQ(zx_socket_read(h1, 0u, buffer, big_max, &nread), ZX_OK, "");
+    EXPECT_EQ(nread, big_max, "");
+    EXPECT_TRUE(get_satisfied_signals(h0) & ZX_SOCKET_WRITABLE, "");
+
+    // Out of range values are rejected.
+    value = 0;
+    EXPECT_EQ(zx_object_set_property(h1, ZX_PROP_SOCKET_RX_BUF_MAX, &value, sizeof(value)),
+              ZX_ERR_OUT_OF_RANGE, "");
+    value = SIZE_MAX;
+    EXPECT_EQ(zx_object_set_property(h1, ZX_PROP_SOCKET_RX_BUF_MAX, &value, sizeof(value)),
+              ZX_ERR_OUT_OF_RANGE, "");
+    EXPECT_EQ(zx_socket_set_rx_buf_max(h1, rrh, SIZE_MAX),
+              ZX_ERR_OUT_OF_RANGE, "");
+
+    free(buffer);
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(socket_tests)
 RUN_TEST(socket_basic)
 RUN_TEST(socket_signals)
@@ -1173,6 +1336,9 @@ RUN_TEST(socket_accept)
 RUN_TEST(socket_share_invalid_handle)
 RUN_TEST(socket_share_consumes_on_failure)
 RUN_TEST(socket_signals2)
+RUN_TEST(socket_writev_readv)
+RUN_TEST(socket_datagram_writev_readv)
+RUN_TEST(socket_set_rx_buf_max)
 END_TEST_CASE(socket_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -0,0 +1,102 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <digest/merkle-tree.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <digest/digest.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+// These benchmarks compare the throughput of building a Merkle tree with
+// Create(), which hashes each level of the tree in batches of nodes, against
+// streaming the same data through CreateUpdate(), which hashes one node at a
+// time, and measure the throughput of Verify().  They build with the target
+// and the host tests, to compare the two.
+using digest::Digest;
+using digest::MerkleTree;
+
+const size_t kSizes[] = {
+    128 * 1024,
+    1024 * 1024,
+    16 * 1024 * 1024,
+};
+const int kIterations = 4;
+
+uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+double Throughput(size_t data_len, uint64_t elapsed_ns) {
+    double bytes = static_cast<double>(data_len) * kIterations;
+    return bytes / (static_cast<double>(elapsed_ns) / 1e9) / (1024 * 1024);
+}
+
+bool BenchmarkSize(size_t data_len) {
+    BEGIN_HELPER;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[data_len]);
+    ASSERT_TRUE(ac.check());
+    size_t tree_len = MerkleTree::GetTreeLength(data_len);
+    fbl::unique_ptr<uint8_t[]> tree(new (&ac) uint8_t[tree_len]);
+    ASSERT_TRUE(ac.check());
+    for (size_t i = 0; i < data_len; ++i) {
+        data[i] = static_cast<uint8_t>(rand());
+    }
+
+    Digest streamed;
+    uint64_t start = NowNs();
+    for (int i = 0; i < kIterations; ++i) {
+        MerkleTree mt;
+        ASSERT_EQ(mt.CreateInit(data_len, tree_len), ZX_OK);
+        ASSERT_EQ(mt.CreateUpdate(data.get(), data_len, tree.get()), ZX_OK);
+        ASSERT_EQ(mt.CreateFinal(tree.get(), &streamed), ZX_OK);
+    }
+    uint64_t stream_ns = NowNs() - start;
+
+    Digest created;
+    start = NowNs();
+    for (int i = 0; i < kIterations; ++i) {
+        ASSERT_EQ(MerkleTree::Create(data.get(), data_len, tree.get(), tree_len, &created),
+                  ZX_OK);
+    }
+    uint64_t create_ns = NowNs() - start;
+    ASSERT_TRUE(created == streamed, "Create and CreateUpdate disagree");
+
+    start = NowNs();
+    for (int i = 0; i < kIterations; ++i) {
+        ASSERT_EQ(MerkleTree::Verify(data.get(), data_len, tree.get(), tree_len, 0, data_len,
+                                     created),
+                  ZX_OK);
+    }
+    uint64_t verify_ns = NowNs() - start;
+
+    printf("%8zu KB: CreateUpdate %7.1f MB/s, Create %7.1f MB/s, Verify %7.1f MB/s\n",
+           data_len / 1024, Throughput(data_len, stream_ns), Throughput(data_len, create_ns),
+           Throughput(data_len, verify_ns));
+    END_HELPER;
+}
+
+bool BenchmarkMerkleTree(void) {
+    BEGIN_TEST;
+    printf("\n");
+    for (size_t data_len : kSizes) {
+        ASSERT_TRUE(BenchmarkSize(data_len));
+    }
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(MerkleTreeBenchmarks)
+RUN_TEST_PERFORMANCE(BenchmarkMerkleTree)
+END_TEST_CASE(MerkleTreeBenchmarks)
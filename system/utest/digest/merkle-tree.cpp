@@ -7,10 +7,13 @@
 #include <stdlib.h>
 
 #include <digest/digest.h>
+#include <fbl/algorithm.h>
 #include <zircon/assert.h>
 #include <zircon/status.h>
 #include <unittest/unittest.h>
 
+#include "../../ulib/digest/node-hash.h"
+
 namespace {
 
 ////////////////
@@ -362,6 +365,116 @@ bool CreateCAll(void) {
     END_TEST;
 }
 
+// Used by CreateLeavesAll below.
+bool CreateLeaves(size_t data_len, const char* digest) {
+    zx_status_t rc;
+    size_t tree_len = MerkleTree::GetTreeLength(data_len);
+    // Hash the data nodes one at a time, last to first.
+    size_t offset = fbl::round_up(data_len, kNodeSize);
+    while (offset > 0) {
+        offset -= kNodeSize;
+        size_t length = fbl::min(data_len - offset, kNodeSize);
+        ASSERT_OK(MerkleTree::CreateLeaves(gData, data_len, offset, length, gTree,
+                                           tree_len));
+    }
+    Digest actual;
+    ASSERT_OK(MerkleTree::CreateRoot(gData, data_len, gTree, tree_len, &actual));
+    Digest expected;
+    ASSERT_OK(expected.Parse(digest, strlen(digest)));
+    ASSERT_TRUE(actual == expected, "Incorrect root digest");
+    return true;
+}
+
+bool CreateLeavesAll(void) {
+    BEGIN_TEST;
+    for (size_t i = 0; i < kNumCases; ++i) {
+        if (!CreateLeaves(kCases[i].data_len, kCases[i].digest)) {
+            unittest_printf_critical(
+                "CreateLeavesAll failed with data length of %zu\n",
+                kCases[i].data_len);
+        }
+    }
+    END_TEST;
+}
+
+bool CreateLeavesUnaligned(void) {
+    BEGIN_TEST_WITH_RC;
+    size_t tree_len = MerkleTree::GetTreeLength(kUnalignedLarge);
+    ASSERT_ERR(ZX_ERR_INVALID_ARGS,
+               MerkleTree::CreateLeaves(gData, kUnalignedLarge, 1, kNodeSize,
+                                        gTree, tree_len));
+    ASSERT_ERR(ZX_ERR_INVALID_ARGS,
+               MerkleTree::CreateLeaves(gData, kUnalignedLarge, 0, kNodeSize - 1,
+                                        gTree, tree_len));
+    ASSERT_ERR(ZX_ERR_OUT_OF_RANGE,
+               MerkleTree::CreateLeaves(gData, kUnalignedLarge, kLarge, kNodeSize,
+                                        gTree, tree_len));
+    ASSERT_OK(MerkleTree::CreateLeaves(gData, kUnalignedLarge, kLarge,
+                                       kUnalignedLarge - kLarge, gTree, tree_len));
+    END_TEST;
+}
+
+// Checks that trees built in batches match those built node by node, for
+// data lengths which leave each possible remainder of nodes.
+bool CreateMatchesCreateUpdate(void) {
+    BEGIN_TEST_WITH_RC;
+    static uint8_t tree[kNodeSize * 3];
+    for (size_t num_nodes = 2; num_nodes <= 20; ++num_nodes) {
+        size_t data_len = num_nodes * kNodeSize - (num_nodes % 2 == 0 ? 0 : 7);
+        size_t tree_len = MerkleTree::GetTreeLength(data_len);
+        for (uint64_t i = 0; i < data_len; ++i) {
+            gData[i] = static_cast<uint8_t>(rand());
+        }
+        MerkleTree merkleTree;
+        ASSERT_OK(merkleTree.CreateInit(data_len, tree_len));
+        ASSERT_OK(merkleTree.CreateUpdate(gData, data_len, tree));
+        Digest expected;
+        ASSERT_OK(merkleTree.CreateFinal(tree, &expected));
+        Digest actual;
+        ASSERT_OK(MerkleTree::Create(gData, data_len, gTree, tree_len, &actual));
+        ASSERT_TRUE(actual == expected, "Incorrect root digest");
+        ASSERT_EQ(memcmp(tree, gTree, tree_len), 0, "Incorrect tree");
+        ASSERT_OK(MerkleTree::Verify(gData, data_len, gTree, tree_len, 0,
+                                     data_len, actual));
+    }
+    memset(gData, 0xff, sizeof(gData));
+    END_TEST;
+}
+
+// Checks each implementation of HashNodes the CPU can run against the
+// portable one, for every remainder of nodes left over by its lanes.
+bool HashNodesImplsMatch(void) {
+    BEGIN_TEST;
+    // Enough for two full batches of the widest implementation and a
+    // remainder of each size.
+    constexpr size_t kMaxNodes = 24;
+    static uint8_t expected[kMaxNodes * Digest::kLength];
+    static uint8_t actual[kMaxNodes * Digest::kLength];
+    digest::internal::HashNodesImpl impls[digest::internal::kMaxHashNodesImpls];
+    size_t num_impls = digest::internal::GetHashNodesImpls(impls);
+    for (uint64_t i = 0; i < kMaxNodes * kNodeSize; ++i) {
+        gData[i] = static_cast<uint8_t>(rand());
+    }
+    for (size_t level = 0; level < 2; ++level) {
+        for (size_t count = 1; count <= kMaxNodes; ++count) {
+            uint64_t offset = 3 * kNodeSize;
+            impls[0].fn(gData, offset, level, count, expected);
+            for (size_t i = 1; i < num_impls; ++i) {
+                memset(actual, 0, sizeof(actual));
+                impls[i].fn(gData, offset, level, count, actual);
+                if (memcmp(actual, expected, count * Digest::kLength) != 0) {
+                    unittest_printf_critical("%s differs for %zu nodes at level %zu\n",
+                                             impls[i].name, count, level);
+                }
+                ASSERT_EQ(memcmp(actual, expected, count * Digest::kLength), 0,
+                          "Incorrect node digests");
+            }
+        }
+    }
+    memset(gData, 0xff, sizeof(gData));
+    END_TEST;
+}
+
 bool CreateByteByByte(void) {
     BEGIN_TEST_WITH_RC;
     size_t tree_len = MerkleTree::GetTreeLength(kSmall);
@@ -718,6 +831,10 @@ RUN_TEST(CreateFinalIncompleteData)
 RUN_TEST(CreateAll)
 RUN_TEST(CreateFinalCAll)
 RUN_TEST(CreateCAll)
+RUN_TEST(CreateLeavesAll)
+RUN_TEST(CreateLeavesUnaligned)
+RUN_TEST(CreateMatchesCreateUpdate)
+RUN_TEST(HashNodesImplsMatch)
 RUN_TEST(CreateByteByByte)
 RUN_TEST(CreateMissingData)
 RUN_TEST(CreateMissingTree)
@@ -11,6 +11,7 @@ MODULE_TYPE := usertest
 MODULE_SRCS += \
     $(LOCAL_DIR)/digest.cpp \
     $(LOCAL_DIR)/merkle-tree.cpp \
+    $(LOCAL_DIR)/merkle-tree-bench.cpp \
     $(LOCAL_DIR)/main.c
 
 MODULE_NAME := digest-test
@@ -28,3 +29,27 @@ MODULE_STATIC_LIBS := \
     system/ulib/fbl \
 
 include make/module.mk
+
+MODULE := $(LOCAL_DIR).hostapp
+
+MODULE_TYPE := hosttest
+
+MODULE_NAME := digest-test
+
+MODULE_SRCS := \
+    $(LOCAL_DIR)/merkle-tree-bench.cpp \
+    $(LOCAL_DIR)/main.c
+
+MODULE_COMPILEFLAGS := \
+    -Isystem/ulib/digest/include \
+    -Isystem/ulib/fbl/include \
+    -Isystem/ulib/unittest/include \
+
+MODULE_HOST_LIBS := \
+    system/ulib/digest.hostlib \
+    system/ulib/unittest.hostlib \
+    system/ulib/pretty.hostlib \
+    third_party/ulib/uboringssl.hostlib \
+    system/ulib/fbl.hostlib \
+
+include make/module.mk
@@ -6,12 +6,16 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <threads.h>
+#include <unistd.h>
 
+#include <fbl/alloc_checker.h>
 #include <fbl/function.h>
 #include <fbl/string.h>
 #include <fbl/string_buffer.h>
 #include <fbl/string_printf.h>
 #include <fbl/unique_fd.h>
+#include <fbl/unique_ptr.h>
 #include <fs-management/mount.h>
 #include <fs-test-utils/fixture.h>
 #include <fs-test-utils/perftest.h>
@@ -40,12 +44,14 @@ bool WriteBigFile(ssize_t data_size, perftest::RepeatState* state, Fixture* fixt
     fbl::unique_fd fd(open(GetBigFilePath(*fixture).c_str(), O_CREAT | O_WRONLY));
     ASSERT_TRUE(fd);
     state->DeclareStep("write");
-    uint8_t data[data_size];
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[data_size]);
+    ASSERT_TRUE(ac.check());
     uint8_t pattern = static_cast<uint8_t>(rand_r(fixture->mutable_seed()) % (1 << 8));
-    memset(data, pattern, data_size);
+    memset(data.get(), pattern, data_size);
 
     while (state->KeepRunning()) {
-        ASSERT_EQ(write(fd.get(), data, data_size), data_size);
+        ASSERT_EQ(write(fd.get(), data.get(), data_size), data_size);
     }
 
     END_HELPER;
@@ -58,10 +64,12 @@ bool ReadBigFile(ssize_t data_size, perftest::RepeatState* state, Fixture* fixtu
     uint8_t pattern = static_cast<uint8_t>(rand_r(fixture->mutable_seed()) % (1 << 8));
     ASSERT_TRUE(fd);
     state->DeclareStep("read");
-    uint8_t data[data_size];
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[data_size]);
+    ASSERT_TRUE(ac.check());
 
     while (state->KeepRunning()) {
-        ASSERT_EQ(read(fd.get(), data, data_size), data_size);
+        ASSERT_EQ(read(fd.get(), data.get(), data_size), data_size);
         ASSERT_EQ(data[0], pattern);
     }
 
@@ -156,6 +164,144 @@ private:
     fbl::StringBuffer<fs_test_utils::kPathSize> path_;
 };
 
+constexpr size_t kSmallFileSize = 8 * 1024;
+
+// Creates a new file at |path|, writes |kSmallFileSize| bytes of |data| to it
+// and waits until they are on disk. Returns 0 on success.
+int CreateSmallFile(const char* path, const uint8_t* data) {
+    fbl::unique_fd fd(open(path, O_CREAT | O_EXCL | O_WRONLY, 0644));
+    if (!fd) {
+        return -1;
+    }
+    if (write(fd.get(), data, kSmallFileSize) != static_cast<ssize_t>(kSmallFileSize)) {
+        return -1;
+    }
+    return fsync(fd.get());
+}
+
+// Wrapper so state can be shared across calls.
+//
+// Measures the latency of creating, writing and syncing small files, which is
+// dominated by the cost of committing metadata. When several threads do so
+// concurrently, their metadata may be committed together.
+class SmallFileOp {
+public:
+    explicit SmallFileOp(uint32_t thread_count) : thread_count_(thread_count) {}
+    SmallFileOp(const SmallFileOp&) = delete;
+    SmallFileOp(SmallFileOp&&) = delete;
+    SmallFileOp& operator=(const SmallFileOp&) = delete;
+    SmallFileOp& operator=(SmallFileOp&&) = delete;
+    ~SmallFileOp() = default;
+
+    // Each step creates one file per thread, until |state::KeepGoing| returns false.
+    bool CreateWriteSync(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        uint8_t pattern = static_cast<uint8_t>(rand_r(fixture->mutable_seed()) % (1 << 8));
+        memset(data_, pattern, sizeof(data_));
+
+        Worker workers[kMaxThreads];
+        thrd_t threads[kMaxThreads];
+        ASSERT_LE(thread_count_, kMaxThreads);
+        while (state->KeepRunning()) {
+            for (uint32_t i = 0; i < thread_count_; i++) {
+                workers[i].data = data_;
+                workers[i].path = fbl::StringPrintf("%s/small-%u-%u", fixture->fs_path().c_str(),
+                                                    i, file_count_);
+                ASSERT_EQ(thrd_create(&threads[i], &SmallFileOp::WorkerThread, &workers[i]),
+                          thrd_success);
+            }
+            for (uint32_t i = 0; i < thread_count_; i++) {
+                int result;
+                ASSERT_EQ(thrd_join(threads[i], &result), thrd_success);
+                ASSERT_EQ(result, 0, workers[i].path.c_str());
+            }
+            file_count_++;
+        }
+        END_HELPER;
+    }
+
+    static constexpr uint32_t kMaxThreads = 16;
+
+private:
+    struct Worker {
+        fbl::String path;
+        const uint8_t* data;
+    };
+
+    static int WorkerThread(void* arg) {
+        Worker* worker = static_cast<Worker*>(arg);
+        return CreateSmallFile(worker->path.c_str(), worker->data);
+    }
+
+    const uint32_t thread_count_;
+    uint32_t file_count_ = 0;
+    uint8_t data_[kSmallFileSize];
+};
+
+// Wrapper so state can be shared across calls.
+//
+// Measures the latency of creating, looking up and unlinking empty files in a
+// single directory, as the number of entries in that directory grows.
+class DirectoryOp {
+public:
+    DirectoryOp() = default;
+    DirectoryOp(const DirectoryOp&) = delete;
+    DirectoryOp(DirectoryOp&&) = delete;
+    DirectoryOp& operator=(const DirectoryOp&) = delete;
+    DirectoryOp& operator=(DirectoryOp&&) = delete;
+    ~DirectoryOp() = default;
+
+    // Creates one file per step, until |state::KeepGoing| returns false.
+    bool Create(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        ASSERT_EQ(mkdir(GetDirPath(*fixture).c_str(), 0666), 0);
+        file_count_ = 0;
+        while (state->KeepRunning()) {
+            fbl::String path = GetFilePath(*fixture, file_count_);
+            fbl::unique_fd fd(open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644));
+            ASSERT_TRUE(fd, path.c_str());
+            file_count_++;
+        }
+        END_HELPER;
+    }
+
+    // Looks up each file, in the order in which they were created.
+    bool Stat(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        uint32_t i = 0;
+        while (state->KeepRunning()) {
+            ASSERT_LT(i, file_count_);
+            fbl::String path = GetFilePath(*fixture, i++);
+            struct stat buff;
+            ASSERT_EQ(stat(path.c_str(), &buff), 0, path.c_str());
+        }
+        END_HELPER;
+    }
+
+    // Unlinks each file, in the order in which they were created.
+    bool Unlink(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        uint32_t i = 0;
+        while (state->KeepRunning()) {
+            ASSERT_LT(i, file_count_);
+            fbl::String path = GetFilePath(*fixture, i++);
+            ASSERT_EQ(unlink(path.c_str()), 0, path.c_str());
+        }
+        END_HELPER;
+    }
+
+private:
+    static fbl::String GetDirPath(const Fixture& fixture) {
+        return fbl::StringPrintf("%s/dir", fixture.fs_path().c_str());
+    }
+
+    static fbl::String GetFilePath(const Fixture& fixture, uint32_t i) {
+        return fbl::StringPrintf("%s/dir/%05u", fixture.fs_path().c_str(), i);
+    }
+
+    uint32_t file_count_ = 0;
+};
+
 } // namespace
 
 bool RunBenchmark(int argc, char** argv) {
@@ -204,6 +350,41 @@ bool RunBenchmark(int argc, char** argv) {
         testcases.push_back(fbl::move(testcase));
     }
 
+    // Sequential read and write of a 1 GB file, in operations of increasing size. Each write
+    // spans many blocks, so this measures the contiguity of block allocation and the clustering
+    // of writeback; a fresh read of the file measures readahead.
+    const size_t sequential_op_sizes[] = {
+        64 * 1024,
+        256 * 1024,
+        1024 * 1024,
+    };
+    constexpr size_t kSequentialFileSize = 1 << 30;
+
+    for (size_t op_size : sequential_op_sizes) {
+        TestCaseInfo testcase;
+        testcase.sample_count = static_cast<uint32_t>(kSequentialFileSize / op_size);
+        testcase.name = fbl::StringPrintf("%s/Bigfile/%zuKbytes/%u-Ops",
+                                          disk_format_string_[f_opts.fs_type], op_size / 1024,
+                                          testcase.sample_count);
+        testcase.teardown = true;
+
+        TestInfo write_test, read_test;
+        write_test.name = fbl::StringPrintf("%s/SequentialWrite", testcase.name.c_str());
+        write_test.test_fn = [op_size](perftest::RepeatState* state, Fixture* fixture) {
+            return WriteBigFile(static_cast<ssize_t>(op_size), state, fixture);
+        };
+        write_test.required_disk_space = kSequentialFileSize;
+        testcase.tests.push_back(fbl::move(write_test));
+
+        read_test.name = fbl::StringPrintf("%s/SequentialRead", testcase.name.c_str());
+        read_test.test_fn = [op_size](perftest::RepeatState* state, Fixture* fixture) {
+            return ReadBigFile(static_cast<ssize_t>(op_size), state, fixture);
+        };
+        read_test.required_disk_space = kSequentialFileSize;
+        testcase.tests.push_back(fbl::move(read_test));
+        testcases.push_back(fbl::move(testcase));
+    }
+
     // Path walk tests.
     const int path_walk_sample_counts[] = {
         125,
@@ -238,6 +419,70 @@ bool RunBenchmark(int argc, char** argv) {
         testcases.push_back(fbl::move(testcase));
     }
 
+    // Small file tests.
+    const int small_file_sample_counts[] = {
+        128,
+        512,
+    };
+    const uint32_t small_file_thread_counts[] = {
+        1,
+        8,
+    };
+
+    fbl::Vector<fbl::unique_ptr<SmallFileOp>> sf_ops;
+    for (uint32_t thread_count : small_file_thread_counts) {
+        sf_ops.push_back(fbl::make_unique<SmallFileOp>(thread_count));
+        SmallFileOp* sf_op = sf_ops[sf_ops.size() - 1].get();
+        for (int test_sample_count : small_file_sample_counts) {
+            TestCaseInfo testcase;
+            testcase.name = fbl::StringPrintf("%s/SmallFile/8Kbytes/%u-Threads/%d-Ops",
+                                              disk_format_string_[f_opts.fs_type], thread_count,
+                                              test_sample_count);
+            testcase.sample_count = test_sample_count;
+            testcase.teardown = true;
+
+            TestInfo create_test;
+            create_test.name = fbl::StringPrintf("%s/CreateWriteSync", testcase.name.c_str());
+            create_test.test_fn = fbl::BindMember(sf_op, &SmallFileOp::CreateWriteSync);
+            create_test.required_disk_space = test_sample_count * thread_count * kSmallFileSize;
+            testcase.tests.push_back(fbl::move(create_test));
+            testcases.push_back(fbl::move(testcase));
+        }
+    }
+
+    // Directory size tests. The largest directory is bounded by the number of
+    // inodes of a MinFS volume without FVM.
+    const int directory_sample_counts[] = {
+        1000,
+        10000,
+        30000,
+    };
+
+    DirectoryOp dir_op;
+    for (int test_sample_count : directory_sample_counts) {
+        TestCaseInfo testcase;
+        testcase.name = fbl::StringPrintf("%s/Directory/%d-Entries",
+                                          disk_format_string_[f_opts.fs_type], test_sample_count);
+        testcase.sample_count = test_sample_count;
+        testcase.teardown = true;
+
+        TestInfo create_test;
+        create_test.name = fbl::StringPrintf("%s/Create", testcase.name.c_str());
+        create_test.test_fn = fbl::BindMember(&dir_op, &DirectoryOp::Create);
+        testcase.tests.push_back(fbl::move(create_test));
+
+        TestInfo stat_test;
+        stat_test.name = fbl::StringPrintf("%s/Stat", testcase.name.c_str());
+        stat_test.test_fn = fbl::BindMember(&dir_op, &DirectoryOp::Stat);
+        testcase.tests.push_back(fbl::move(stat_test));
+
+        TestInfo unlink_test;
+        unlink_test.name = fbl::StringPrintf("%s/Unlink", testcase.name.c_str());
+        unlink_test.test_fn = fbl::BindMember(&dir_op, &DirectoryOp::Unlink);
+        testcase.tests.push_back(fbl::move(unlink_test));
+        testcases.push_back(fbl::move(testcase));
+    }
+
     return fs_test_utils::RunTestCases(f_opts, p_opts, testcases);
 }
 } // namespace fs_bench
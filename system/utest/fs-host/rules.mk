@@ -15,6 +15,8 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/util.cpp \
     $(LOCAL_DIR)/test-basic.cpp \
     $(LOCAL_DIR)/test-directory.cpp \
+    $(LOCAL_DIR)/test-extents.cpp \
+    $(LOCAL_DIR)/test-journal.cpp \
     $(LOCAL_DIR)/test-maxfile.cpp \
     $(LOCAL_DIR)/test-rw-workers.cpp \
     $(LOCAL_DIR)/test-sparse.cpp \
@@ -37,11 +39,13 @@ MODULE_COMPILEFLAGS := \
     -Isystem/ulib/fdio/include \
     -Isystem/ulib/zircon-internal/include \
     -Isystem/ulib/zircon/include \
+    -Ithird_party/ulib/cksum/include \
 
 MODULE_HOST_LIBS := \
     system/ulib/unittest.hostlib \
     system/ulib/pretty.hostlib \
     system/ulib/minfs.hostlib \
+    third_party/ulib/cksum.hostlib \
     system/ulib/fbl.hostlib \
     system/ulib/fs.hostlib \
 
@@ -0,0 +1,266 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Tests the extent trees which map the blocks of files on filesystems
+// created with kMinfsFlagExtents.
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fbl/unique_fd.h>
+#include <fbl/unique_ptr.h>
+#include <minfs/bcache.h>
+#include <minfs/format.h>
+#include <minfs/fsck.h>
+#include <minfs/minfs.h>
+
+#include "util.h"
+
+namespace {
+
+using minfs::ExtentHeader;
+using minfs::Inode;
+using minfs::kMinfsBlockSize;
+
+constexpr char kImagePath[] = "/tmp/zircon-fs-test-extents";
+
+minfs::MountOptions ExtentOptions() {
+    minfs::MountOptions options;
+    options.extents = true;
+    return options;
+}
+
+// Reads the inode of |path| from the image of the mounted filesystem, which
+// the host writes through to.
+bool ReadInode(const char* path, Inode* out) {
+    BEGIN_HELPER;
+    struct stat st;
+    ASSERT_EQ(emu_stat(path, &st), 0);
+    fbl::unique_fd fd(open(MOUNT_PATH, O_RDONLY));
+    ASSERT_TRUE(fd);
+    minfs::Superblock info;
+    ASSERT_EQ(pread(fd.get(), &info, sizeof(info), 0), (ssize_t)sizeof(info));
+    off_t off = static_cast<off_t>(info.ino_block) * kMinfsBlockSize + st.st_ino * sizeof(Inode);
+    ASSERT_EQ(pread(fd.get(), out, sizeof(*out), off), (ssize_t)sizeof(*out));
+    ASSERT_NE(out->flags & minfs::kMinfsInodeFlagExtents, 0);
+    END_HELPER;
+}
+
+uint8_t BlockFill(unsigned file, size_t n) {
+    return static_cast<uint8_t>(file * 127 + n);
+}
+
+bool WriteBlocks(int fd, unsigned file, size_t start, size_t count) {
+    BEGIN_HELPER;
+    uint8_t data[kMinfsBlockSize];
+    for (size_t n = start; n < start + count; n++) {
+        memset(data, BlockFill(file, n), sizeof(data));
+        ASSERT_EQ(emu_pwrite(fd, data, sizeof(data), n * kMinfsBlockSize), (ssize_t)sizeof(data));
+    }
+    END_HELPER;
+}
+
+// Checks that |path| holds |count| blocks written by WriteBlocks.
+bool CheckBlocks(const char* path, unsigned file, size_t count) {
+    BEGIN_HELPER;
+    struct stat st;
+    ASSERT_EQ(emu_stat(path, &st), 0);
+    ASSERT_EQ(st.st_size, (off_t)(count * kMinfsBlockSize));
+    int fd = emu_open(path, O_RDONLY, 0644);
+    ASSERT_GT(fd, 0);
+    uint8_t data[kMinfsBlockSize];
+    uint8_t expected[kMinfsBlockSize];
+    for (size_t n = 0; n < count; n++) {
+        memset(expected, BlockFill(file, n), sizeof(expected));
+        ASSERT_EQ(emu_pread(fd, data, sizeof(data), n * kMinfsBlockSize), (ssize_t)sizeof(data));
+        ASSERT_EQ(memcmp(data, expected, sizeof(data)), 0);
+    }
+    ASSERT_EQ(emu_close(fd), 0);
+    END_HELPER;
+}
+
+// A file written sequentially is mapped by a single extent, without any
+// metadata blocks.
+bool TestExtentsSequential(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kBlocks = 4096;
+    constexpr size_t kBlocksPerWrite = 128;
+    const char* path = "::sequential";
+    int fd = emu_open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0);
+    fbl::unique_ptr<uint8_t[]> data(new uint8_t[kBlocksPerWrite * kMinfsBlockSize]);
+    for (size_t n = 0; n < kBlocks; n += kBlocksPerWrite) {
+        for (size_t i = 0; i < kBlocksPerWrite; i++) {
+            memset(&data[i * kMinfsBlockSize], BlockFill(0, n + i), kMinfsBlockSize);
+        }
+        ASSERT_STREAM_ALL(emu_write, fd, data.get(), kBlocksPerWrite * kMinfsBlockSize);
+    }
+    ASSERT_EQ(emu_close(fd), 0);
+
+    Inode inode;
+    ASSERT_TRUE(ReadInode(path, &inode));
+    const ExtentHeader* root = minfs::GetExtentRoot(&inode);
+    ASSERT_EQ(root->depth, 0);
+    ASSERT_EQ(root->count, 1);
+    ASSERT_EQ(minfs::GetExtents(root)[0].length, kBlocks);
+    ASSERT_EQ(inode.block_count, kBlocks);
+
+    ASSERT_TRUE(CheckBlocks(path, 0, kBlocks));
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+// Files written a block at a time in turn are fragmented enough to need
+// several levels of extent tree.
+bool TestExtentsFragmented(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kBlocks = 2048;
+    const char* paths[] = { "::fragmented0", "::fragmented1" };
+    int fds[2];
+    for (unsigned file = 0; file < 2; file++) {
+        fds[file] = emu_open(paths[file], O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fds[file], 0);
+    }
+    for (size_t n = 0; n < kBlocks; n++) {
+        for (unsigned file = 0; file < 2; file++) {
+            ASSERT_TRUE(WriteBlocks(fds[file], file, n, 1));
+        }
+    }
+
+    Inode inode;
+    ASSERT_TRUE(ReadInode(paths[0], &inode));
+    const ExtentHeader* root = minfs::GetExtentRoot(&inode);
+    ASSERT_EQ(root->depth, 1);
+    ASSERT_GT(root->count, kBlocks / minfs::kMinfsExtentsPerNode);
+    ASSERT_EQ(inode.block_count, kBlocks + root->count);
+    ASSERT_TRUE(CheckBlocks(paths[0], 0, kBlocks));
+    ASSERT_TRUE(CheckBlocks(paths[1], 1, kBlocks));
+    ASSERT_EQ(run_fsck(), 0);
+
+    // Truncation frees the extents past the new end of the file, and the
+    // nodes which no longer map any.
+    ASSERT_EQ(emu_ftruncate(fds[0], kBlocks / 4 * kMinfsBlockSize), 0);
+    ASSERT_TRUE(ReadInode(paths[0], &inode));
+    ASSERT_EQ(inode.block_count, kBlocks / 4 + root->count);
+    ASSERT_TRUE(CheckBlocks(paths[0], 0, kBlocks / 4));
+    ASSERT_EQ(run_fsck(), 0);
+
+    // The file may be extended again after truncation.
+    ASSERT_TRUE(WriteBlocks(fds[0], 0, kBlocks / 4, kBlocks / 4));
+    ASSERT_TRUE(CheckBlocks(paths[0], 0, kBlocks / 2));
+    ASSERT_EQ(run_fsck(), 0);
+
+    ASSERT_EQ(emu_ftruncate(fds[0], 0), 0);
+    ASSERT_TRUE(ReadInode(paths[0], &inode));
+    ASSERT_EQ(root->depth, 0);
+    ASSERT_EQ(root->count, 0);
+    ASSERT_EQ(inode.block_count, 0);
+    ASSERT_EQ(run_fsck(), 0);
+
+    for (unsigned file = 0; file < 2; file++) {
+        ASSERT_EQ(emu_close(fds[file]), 0);
+    }
+    END_TEST;
+}
+
+// Holes are left unmapped, and filling them in adds extents between the
+// existing ones.
+bool TestExtentsSparse(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kBlocks = 64;
+    const char* path = "::sparse";
+    int fd = emu_open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0);
+    for (size_t n = 0; n < kBlocks; n += 2) {
+        ASSERT_TRUE(WriteBlocks(fd, 0, kBlocks - 2 - n, 1));
+    }
+    Inode inode;
+    ASSERT_TRUE(ReadInode(path, &inode));
+    ASSERT_EQ(inode.block_count, kBlocks / 2 + minfs::GetExtentRoot(&inode)->count);
+    ASSERT_EQ(run_fsck(), 0);
+
+    uint8_t data[kMinfsBlockSize];
+    uint8_t zeroes[kMinfsBlockSize] = {};
+    ASSERT_EQ(emu_pread(fd, data, sizeof(data), kMinfsBlockSize), (ssize_t)sizeof(data));
+    ASSERT_EQ(memcmp(data, zeroes, sizeof(data)), 0);
+
+    for (size_t n = 1; n < kBlocks; n += 2) {
+        ASSERT_TRUE(WriteBlocks(fd, 0, n, 1));
+    }
+    ASSERT_TRUE(WriteBlocks(fd, 0, kBlocks - 1, 1));
+    ASSERT_TRUE(CheckBlocks(path, 0, kBlocks));
+    ASSERT_EQ(run_fsck(), 0);
+
+    ASSERT_EQ(emu_close(fd), 0);
+    END_TEST;
+}
+
+bool CreateImage(bool extents, fbl::unique_ptr<minfs::Bcache>* out, minfs::Superblock* info) {
+    BEGIN_HELPER;
+    constexpr uint32_t kImageBlocks = 8192;
+    unlink(kImagePath);
+    fbl::unique_fd fd(open(kImagePath, O_RDWR | O_CREAT | O_EXCL, 0644));
+    ASSERT_TRUE(fd);
+    ASSERT_EQ(ftruncate(fd.get(), kImageBlocks * kMinfsBlockSize), 0);
+
+    fbl::unique_ptr<minfs::Bcache> bc;
+    ASSERT_EQ(minfs::Bcache::Create(&bc, fbl::move(fd), kImageBlocks), ZX_OK);
+    minfs::MountOptions options = {};
+    options.extents = extents;
+    ASSERT_EQ(minfs::Mkfs(options, fbl::move(bc)), ZX_OK);
+
+    fd.reset(open(kImagePath, O_RDWR));
+    ASSERT_TRUE(fd);
+    ASSERT_EQ(minfs::Bcache::Create(out, fbl::move(fd), kImageBlocks), ZX_OK);
+    uint8_t blk[kMinfsBlockSize];
+    ASSERT_EQ((*out)->Readblk(0, blk), ZX_OK);
+    memcpy(info, blk, sizeof(*info));
+    END_HELPER;
+}
+
+// Images with extents are stamped with the oldest version which knows about
+// them, and one with an older version is rejected. Images created without
+// extents map the blocks of their root directory directly.
+bool TestExtentsVersion(void) {
+    BEGIN_TEST;
+
+    fbl::unique_ptr<minfs::Bcache> bc;
+    minfs::Superblock info;
+    ASSERT_TRUE(CreateImage(false, &bc, &info));
+    ASSERT_EQ(info.flags & minfs::kMinfsFlagExtents, 0);
+    ASSERT_EQ(info.version, minfs::kMinfsVersionJournal);
+    uint8_t blk[kMinfsBlockSize];
+    ASSERT_EQ(bc->Readblk(info.ino_block, blk), ZX_OK);
+    const Inode* root = &reinterpret_cast<const Inode*>(blk)[minfs::kMinfsRootIno];
+    ASSERT_EQ(root->flags, 0);
+    ASSERT_EQ(root->dnum[0], 1);
+    ASSERT_EQ(minfs::Fsck(fbl::move(bc)), ZX_OK);
+
+    ASSERT_TRUE(CreateImage(true, &bc, &info));
+    ASSERT_NE(info.flags & minfs::kMinfsFlagExtents, 0);
+    ASSERT_EQ(info.version, minfs::kMinfsVersionExtents);
+    info.version = minfs::kMinfsVersionJournal;
+    memset(blk, 0, sizeof(blk));
+    memcpy(blk, &info, sizeof(info));
+    ASSERT_EQ(bc->Writeblk(0, blk), ZX_OK);
+    ASSERT_NE(minfs::Fsck(fbl::move(bc)), ZX_OK);
+
+    ASSERT_EQ(unlink(kImagePath), 0);
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(minfs_extent_tests)
+setup_fs_test(DEFAULT_DISK_SIZE, ExtentOptions());
+RUN_TEST_MEDIUM(TestExtentsSequential)
+RUN_TEST_MEDIUM(TestExtentsFragmented)
+RUN_TEST(TestExtentsSparse)
+RUN_TEST(TestExtentsVersion)
+END_FS_TEST_CASE(minfs_extent_tests)
@@ -0,0 +1,230 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Tests the replay of the minfs metadata journal, by writing entries to
+// the journal of an image directly and replaying them.
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fbl/unique_fd.h>
+#include <fbl/unique_ptr.h>
+#include <lib/cksum.h>
+#include <minfs/bcache.h>
+#include <minfs/format.h>
+#include <minfs/fsck.h>
+#include <minfs/journal.h>
+#include <minfs/minfs.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+using minfs::Bcache;
+using minfs::blk_t;
+using minfs::Superblock;
+
+constexpr char kImagePath[] = "/tmp/zircon-fs-test-journal";
+constexpr uint32_t kImageBlocks = 8192;
+
+enum class Damage {
+    kNone,
+    kTorn,     // The commit block was never written
+    kChecksum, // The commit block does not match the entry
+    kSequence, // The commit block belongs to another entry
+};
+
+// Formats an image and opens a block cache on it.
+bool CreateImage(bool journal, fbl::unique_ptr<Bcache>* out, Superblock* info) {
+    BEGIN_HELPER;
+    unlink(kImagePath);
+    fbl::unique_fd fd(open(kImagePath, O_RDWR | O_CREAT | O_EXCL, 0644));
+    ASSERT_TRUE(fd);
+    ASSERT_EQ(ftruncate(fd.get(), kImageBlocks * minfs::kMinfsBlockSize), 0);
+
+    fbl::unique_ptr<Bcache> bc;
+    ASSERT_EQ(Bcache::Create(&bc, fbl::move(fd), kImageBlocks), ZX_OK);
+    minfs::MountOptions options = {};
+    options.journal = journal;
+    ASSERT_EQ(minfs::Mkfs(options, fbl::move(bc)), ZX_OK);
+
+    fd.reset(open(kImagePath, O_RDWR));
+    ASSERT_TRUE(fd);
+    ASSERT_EQ(Bcache::Create(out, fbl::move(fd), kImageBlocks), ZX_OK);
+    uint8_t blk[minfs::kMinfsBlockSize];
+    ASSERT_EQ((*out)->Readblk(0, blk), ZX_OK);
+    memcpy(info, blk, sizeof(*info));
+    END_HELPER;
+}
+
+bool ReadSequence(Bcache* bc, const Superblock& info, uint64_t* out) {
+    BEGIN_HELPER;
+    uint8_t blk[minfs::kMinfsBlockSize];
+    ASSERT_EQ(bc->Readblk(minfs::JournalStartBlock(info), blk), ZX_OK);
+    ASSERT_EQ(minfs::CheckJournalInfo(blk), ZX_OK);
+    *out = reinterpret_cast<const minfs::JournalInfo*>(blk)->sequence;
+    END_HELPER;
+}
+
+bool CheckBlock(Bcache* bc, blk_t bno, uint8_t fill) {
+    BEGIN_HELPER;
+    uint8_t blk[minfs::kMinfsBlockSize];
+    uint8_t expected[minfs::kMinfsBlockSize];
+    memset(expected, fill, sizeof(expected));
+    ASSERT_EQ(bc->Readblk(bno, blk), ZX_OK);
+    ASSERT_EQ(memcmp(blk, expected, sizeof(blk)), 0);
+    END_HELPER;
+}
+
+// Writes a journal entry with sequence number |sequence|, which sets every
+// byte of |target| to |fill|.
+bool WriteEntry(Bcache* bc, const Superblock& info, uint64_t sequence, blk_t target,
+                uint8_t fill, Damage damage) {
+    BEGIN_HELPER;
+    const blk_t start = minfs::JournalStartBlock(info);
+
+    uint8_t header_blk[minfs::kMinfsBlockSize] = {};
+    auto header = reinterpret_cast<minfs::JournalHeader*>(header_blk);
+    header->magic = minfs::kMinfsJournalHeaderMagic;
+    header->sequence = sequence;
+    header->num_blocks = 1;
+    header->target_blocks[0] = target;
+    ASSERT_EQ(bc->Writeblk(start + 1, header_blk), ZX_OK);
+
+    uint8_t data[minfs::kMinfsBlockSize];
+    memset(data, fill, sizeof(data));
+    ASSERT_EQ(bc->Writeblk(start + 2, data), ZX_OK);
+
+    uint8_t commit_blk[minfs::kMinfsBlockSize] = {};
+    if (damage != Damage::kTorn) {
+        auto commit = reinterpret_cast<minfs::JournalCommit*>(commit_blk);
+        commit->magic = minfs::kMinfsJournalCommitMagic;
+        commit->sequence = (damage == Damage::kSequence) ? sequence + 1 : sequence;
+        commit->checksum = crc32(crc32(0, header_blk, sizeof(header_blk)), data, sizeof(data));
+        if (damage == Damage::kChecksum) {
+            commit->checksum ^= 1;
+        }
+    }
+    ASSERT_EQ(bc->Writeblk(start + 3, commit_blk), ZX_OK);
+    END_HELPER;
+}
+
+// A block of the inode table which a fresh filesystem does not use.
+blk_t TargetBlock(const Superblock& info) {
+    return info.ino_block + 1;
+}
+
+bool TestJournalReplay(void) {
+    BEGIN_TEST;
+
+    fbl::unique_ptr<Bcache> bc;
+    Superblock info;
+    ASSERT_TRUE(CreateImage(true, &bc, &info));
+    ASSERT_NE(info.flags & minfs::kMinfsFlagJournal, 0);
+    ASSERT_EQ(info.version, minfs::kMinfsVersionJournal);
+
+    uint64_t sequence;
+    ASSERT_TRUE(ReadSequence(bc.get(), info, &sequence));
+    const blk_t target = TargetBlock(info);
+    ASSERT_TRUE(WriteEntry(bc.get(), info, sequence, target, 0xab, Damage::kNone));
+
+    // A committed entry is written in place, and marked as such.
+    uint64_t next_sequence;
+    ASSERT_EQ(minfs::ReplayJournal(bc.get(), info, &next_sequence), ZX_OK);
+    ASSERT_EQ(next_sequence, sequence + 1);
+    ASSERT_TRUE(CheckBlock(bc.get(), target, 0xab));
+    uint64_t stored_sequence;
+    ASSERT_TRUE(ReadSequence(bc.get(), info, &stored_sequence));
+    ASSERT_EQ(stored_sequence, sequence + 1);
+
+    // It is not replayed again over later modifications of its blocks.
+    uint8_t blk[minfs::kMinfsBlockSize];
+    memset(blk, 0xcd, sizeof(blk));
+    ASSERT_EQ(bc->Writeblk(target, blk), ZX_OK);
+    ASSERT_EQ(minfs::ReplayJournal(bc.get(), info, &next_sequence), ZX_OK);
+    ASSERT_EQ(next_sequence, sequence + 1);
+    ASSERT_TRUE(CheckBlock(bc.get(), target, 0xcd));
+
+    ASSERT_EQ(unlink(kImagePath), 0);
+    END_TEST;
+}
+
+template <Damage damage>
+bool TestJournalIgnoresDamagedEntry(void) {
+    BEGIN_TEST;
+
+    fbl::unique_ptr<Bcache> bc;
+    Superblock info;
+    ASSERT_TRUE(CreateImage(true, &bc, &info));
+
+    uint64_t sequence;
+    ASSERT_TRUE(ReadSequence(bc.get(), info, &sequence));
+    const blk_t target = TargetBlock(info);
+    ASSERT_TRUE(CheckBlock(bc.get(), target, 0));
+    ASSERT_TRUE(WriteEntry(bc.get(), info, sequence, target, 0xab, damage));
+
+    uint64_t next_sequence;
+    ASSERT_EQ(minfs::ReplayJournal(bc.get(), info, &next_sequence), ZX_OK);
+    ASSERT_EQ(next_sequence, sequence);
+    ASSERT_TRUE(CheckBlock(bc.get(), target, 0));
+
+    ASSERT_EQ(unlink(kImagePath), 0);
+    END_TEST;
+}
+
+bool TestJournalStaleEntry(void) {
+    BEGIN_TEST;
+
+    fbl::unique_ptr<Bcache> bc;
+    Superblock info;
+    ASSERT_TRUE(CreateImage(true, &bc, &info));
+
+    uint64_t sequence;
+    ASSERT_TRUE(ReadSequence(bc.get(), info, &sequence));
+    ASSERT_EQ(minfs::InitJournal(bc.get(), info, sequence + 2), ZX_OK);
+    const blk_t target = TargetBlock(info);
+    ASSERT_TRUE(WriteEntry(bc.get(), info, sequence + 1, target, 0xab, Damage::kNone));
+
+    uint64_t next_sequence;
+    ASSERT_EQ(minfs::ReplayJournal(bc.get(), info, &next_sequence), ZX_OK);
+    ASSERT_EQ(next_sequence, sequence + 2);
+    ASSERT_TRUE(CheckBlock(bc.get(), target, 0));
+
+    ASSERT_EQ(unlink(kImagePath), 0);
+    END_TEST;
+}
+
+// Images are stamped with the oldest version which knows about the journal,
+// and one with an older version is rejected.
+bool TestJournalVersion(void) {
+    BEGIN_TEST;
+
+    fbl::unique_ptr<Bcache> bc;
+    Superblock info;
+    ASSERT_TRUE(CreateImage(false, &bc, &info));
+    ASSERT_EQ(info.flags & minfs::kMinfsFlagJournal, 0);
+    ASSERT_EQ(info.version, minfs::kMinfsVersionBase);
+    ASSERT_EQ(minfs::Fsck(fbl::move(bc)), ZX_OK);
+
+    ASSERT_TRUE(CreateImage(true, &bc, &info));
+    info.version = minfs::kMinfsVersionBase;
+    uint8_t blk[minfs::kMinfsBlockSize] = {};
+    memcpy(blk, &info, sizeof(info));
+    ASSERT_EQ(bc->Writeblk(0, blk), ZX_OK);
+    ASSERT_NE(minfs::Fsck(fbl::move(bc)), ZX_OK);
+
+    ASSERT_EQ(unlink(kImagePath), 0);
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(minfs_journal_tests)
+RUN_TEST(TestJournalReplay)
+RUN_TEST(TestJournalIgnoresDamagedEntry<Damage::kTorn>)
+RUN_TEST(TestJournalIgnoresDamagedEntry<Damage::kChecksum>)
+RUN_TEST(TestJournalIgnoresDamagedEntry<Damage::kSequence>)
+RUN_TEST(TestJournalStaleEntry)
+RUN_TEST(TestJournalVersion)
+END_TEST_CASE(minfs_journal_tests)
@@ -11,7 +11,7 @@
 
 #include <minfs/fsck.h>
 
-void setup_fs_test(size_t disk_size) {
+void setup_fs_test(size_t disk_size, const minfs::MountOptions& options) {
     int r = open(MOUNT_PATH, O_RDWR | O_CREAT | O_EXCL, 0755);
 
     if (r < 0) {
@@ -29,7 +29,7 @@ void setup_fs_test(size_t disk_size) {
         exit(-1);
     }
 
-    if (emu_mkfs(MOUNT_PATH) < 0) {
+    if (emu_mkfs(MOUNT_PATH, options) < 0) {
         fprintf(stderr, "Unable to run mkfs\n");
         exit(-1);
     }
@@ -16,7 +16,7 @@ typedef struct expected_dirent {
     unsigned char d_type;
 } expected_dirent_t;
 
-void setup_fs_test(size_t disk_size);
+void setup_fs_test(size_t disk_size, const minfs::MountOptions& options = minfs::MountOptions());
 void teardown_fs_test(void);
 int run_fsck(void);
 
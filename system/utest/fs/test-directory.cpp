@@ -215,6 +215,67 @@ bool TestDirectoryCoalesceLargeRecord(void) {
     END_TEST;
 }
 
+// Filesystems may index large directories rather than searching them
+// linearly. Exercise lookups, unlinks which coalesce direntries, and creates
+// which reuse the freed space in a directory large enough to be indexed, and
+// check that the result is consistent, including across a remount.
+bool TestDirectoryLargeReuse(void) {
+    BEGIN_TEST;
+
+    const int kNumFiles = 1024;
+    char path[PATH_MAX];
+    ASSERT_EQ(mkdir("::reuse", 0755), 0);
+    for (int i = 0; i < kNumFiles; i++) {
+        snprintf(path, sizeof(path), "::reuse/%0*d", 1 + i % 16, i);
+        int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0, path);
+        ASSERT_EQ(close(fd), 0);
+    }
+
+    // Unlink every other file, and then every fourth, so that the freed
+    // direntries are merged with both of their neighbors.
+    const int steps[] = {2, 4};
+    for (int step : steps) {
+        for (int i = step / 2; i < kNumFiles; i += step) {
+            snprintf(path, sizeof(path), "::reuse/%0*d", 1 + i % 16, i);
+            ASSERT_EQ(unlink(path), 0, path);
+        }
+    }
+
+    // Reuse the freed space with longer names.
+    for (int i = 1; i < kNumFiles; i += 2) {
+        snprintf(path, sizeof(path), "::reuse/new-%0*d", 1 + i % 24, i);
+        int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0, path);
+        ASSERT_EQ(close(fd), 0);
+    }
+
+    if (test_info->can_be_mounted) {
+        ASSERT_TRUE(check_remount());
+    }
+
+    struct stat s;
+    for (int i = 0; i < kNumFiles; i++) {
+        snprintf(path, sizeof(path), "::reuse/%0*d", 1 + i % 16, i);
+        ASSERT_EQ(stat(path, &s), (i % 4 == 0) ? 0 : -1, path);
+        snprintf(path, sizeof(path), "::reuse/new-%0*d", 1 + i % 24, i);
+        ASSERT_EQ(stat(path, &s), (i % 2 == 1) ? 0 : -1, path);
+    }
+
+    for (int i = 0; i < kNumFiles; i++) {
+        if (i % 4 == 0) {
+            snprintf(path, sizeof(path), "::reuse/%0*d", 1 + i % 16, i);
+            ASSERT_EQ(unlink(path), 0, path);
+        } else if (i % 2 == 1) {
+            snprintf(path, sizeof(path), "::reuse/new-%0*d", 1 + i % 24, i);
+            ASSERT_EQ(unlink(path), 0, path);
+        }
+    }
+    ASSERT_EQ(rmdir("::reuse"), 0);
+
+    END_TEST;
+}
+
 bool TestDirectoryTrailingSlash(void) {
     BEGIN_TEST;
 
@@ -463,6 +524,7 @@ RUN_FOR_ALL_FILESYSTEMS(directory_tests,
     RUN_TEST_MEDIUM(TestDirectoryCoalesceLargeRecord)
     RUN_TEST_MEDIUM(TestDirectoryFilenameMax)
     RUN_TEST_LARGE(TestDirectoryLarge)
+    RUN_TEST_LARGE(TestDirectoryLargeReuse)
     RUN_TEST_MEDIUM(TestDirectoryTrailingSlash)
     RUN_TEST_MEDIUM(TestDirectoryReaddir)
     RUN_TEST_LARGE(TestDirectoryReaddirRmAll)
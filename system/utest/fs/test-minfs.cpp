@@ -88,6 +88,14 @@ bool TestQueryInfo() {
     expected_info.total_bytes = kSliceSize;
     // TODO(ZX-1372): Adjust this once minfs accounting on truncate is fixed.
     expected_info.used_bytes = 2 * minfs::kMinfsBlockSize;
+    // Mkfs also reserves data blocks for the metadata journal.
+    const uint32_t kJournalBlocks =
+        fbl::min(static_cast<uint32_t>(kSliceSize / minfs::kMinfsBlockSize) /
+                     minfs::kMinfsJournalRatio,
+                 minfs::kMinfsDefaultJournalBlocks);
+    if (kJournalBlocks >= minfs::kMinfsMinimumJournalBlocks) {
+        expected_info.used_bytes += kJournalBlocks * minfs::kMinfsBlockSize;
+    }
     // The inode table's implementation is currently a flat array on disk.
     expected_info.total_nodes = kSliceSize / sizeof(minfs::Inode);
     // The "zero-th" inode is reserved, as well as the root directory.
@@ -112,9 +112,73 @@ bool TestOffsetOperations(void) {
     END_TEST;
 }
 
+// Test that partial writes and out-of-order reads of a file which is not cached
+// in memory observe the contents of the file on disk.
+bool TestUncachedAccess(void) {
+    BEGIN_TEST;
+
+    srand(0xC0FFEE);
+
+    constexpr size_t kFileSize = 1 << 20;
+    constexpr size_t kChunkSize = 8192;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> expected(new (&ac) uint8_t[kFileSize]);
+    ASSERT_TRUE(ac.check());
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[kFileSize]);
+    ASSERT_TRUE(ac.check());
+    for (size_t i = 0; i < kFileSize; i++) {
+        expected[i] = static_cast<uint8_t>(rand());
+    }
+
+    const char* filename = "::uncached_access";
+    fbl::unique_fd fd(open(filename, O_RDWR | O_CREAT, 0644));
+    ASSERT_TRUE(fd);
+    ASSERT_EQ(write(fd.get(), expected.get(), kFileSize), kFileSize);
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_TRUE(check_remount());
+
+    // Overwrite small, unaligned ranges of the file.
+    fd.reset(open(filename, O_RDWR));
+    ASSERT_TRUE(fd);
+    const size_t offsets[] = { 1, kChunkSize - 3, 10 * kChunkSize + 77, kFileSize - 5 };
+    for (size_t off : offsets) {
+        uint8_t data[4];
+        for (size_t i = 0; i < sizeof(data); i++) {
+            data[i] = static_cast<uint8_t>(rand());
+        }
+        ASSERT_EQ(pwrite(fd.get(), data, sizeof(data), off), sizeof(data));
+        memcpy(&expected[off], data, fbl::min(sizeof(data), kFileSize - off));
+    }
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_TRUE(check_remount());
+
+    // Read the file backwards, and then sequentially.
+    fd.reset(open(filename, O_RDONLY));
+    ASSERT_TRUE(fd);
+    for (size_t off = kFileSize; off > 0; off -= kChunkSize) {
+        ASSERT_EQ(pread(fd.get(), &buf[off - kChunkSize], kChunkSize, off - kChunkSize),
+                  kChunkSize);
+    }
+    ASSERT_EQ(memcmp(buf.get(), expected.get(), kFileSize), 0);
+    ASSERT_TRUE(check_remount());
+    fd.reset(open(filename, O_RDONLY));
+    ASSERT_TRUE(fd);
+    memset(buf.get(), 0, kFileSize);
+    for (size_t off = 0; off < kFileSize; off += kChunkSize) {
+        ASSERT_EQ(read(fd.get(), &buf[off], kChunkSize), kChunkSize);
+    }
+    ASSERT_EQ(memcmp(buf.get(), expected.get(), kFileSize), 0);
+
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_EQ(unlink(filename), 0);
+
+    END_TEST;
+}
+
 }  // namespace
 
 RUN_FOR_ALL_FILESYSTEMS(rw_tests,
     RUN_TEST_MEDIUM(TestZeroLengthOperations)
     RUN_TEST_MEDIUM(TestOffsetOperations)
+    RUN_TEST_MEDIUM(TestUncachedAccess)
 )
@@ -520,7 +520,6 @@ bool TestBlobfsCompressor() {
     // Pretend we're going to compress only one byte of data.
     const size_t buf_size = compressor.BufferMax(1);
     fbl::unique_ptr<char[]> buf(new char[buf_size]);
-    ASSERT_EQ(compressor.Initialize(buf.get(), buf_size), ZX_OK);
 
     // Create data as large as possible that will fit still within this buffer.
     size_t data_size = 0;
@@ -531,6 +530,7 @@ bool TestBlobfsCompressor() {
     ASSERT_GT(data_size, 0);
     ASSERT_EQ(compressor.BufferMax(data_size), buf_size);
     ASSERT_GT(compressor.BufferMax(data_size+1), buf_size);
+    ASSERT_EQ(compressor.Initialize(buf.get(), buf_size, data_size), ZX_OK);
 
     unsigned int seed = 0;
     for (size_t i = 0; i < data_size; i++) {
@@ -0,0 +1,142 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <fbl/string_printf.h>
+#include <fbl/unique_ptr.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/process.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+
+#include "subprocess.h"
+
+namespace {
+
+constexpr char kEchoSubprocess[] = "channel-echo";
+
+// Reads messages from |channel| and writes them back until the peer is
+// closed.
+void ChannelEcho(zx::channel channel) {
+    fbl::unique_ptr<char[]> buffer(new char[ZX_CHANNEL_MAX_MSG_BYTES]);
+    for (;;) {
+        zx_signals_t observed;
+        ZX_ASSERT(channel.wait_one(ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                                   zx::time::infinite(), &observed) == ZX_OK);
+        if (!(observed & ZX_CHANNEL_READABLE)) {
+            return;
+        }
+        uint32_t bytes;
+        ZX_ASSERT(channel.read(0, buffer.get(), ZX_CHANNEL_MAX_MSG_BYTES, &bytes,
+                               nullptr, 0, nullptr) == ZX_OK);
+        ZX_ASSERT(channel.write(0, buffer.get(), bytes, nullptr, 0) == ZX_OK);
+    }
+}
+
+int ChannelEchoThread(void* arg) {
+    ChannelEcho(zx::channel(static_cast<zx_handle_t>(reinterpret_cast<uintptr_t>(arg))));
+    return 0;
+}
+
+// Measure the times taken to write and then read back a message of |size|
+// bytes through a channel, in the same thread.
+bool ChannelWriteReadTest(perftest::RepeatState* state, uint32_t size) {
+    state->DeclareStep("write");
+    state->DeclareStep("read");
+    state->SetBytesProcessedPerRun(size);
+
+    zx::channel channel1;
+    zx::channel channel2;
+    ZX_ASSERT(zx::channel::create(0, &channel1, &channel2) == ZX_OK);
+    fbl::unique_ptr<char[]> buffer(new char[size]);
+    memset(buffer.get(), 0, size);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(channel1.write(0, buffer.get(), size, nullptr, 0) == ZX_OK);
+        state->NextStep();
+        uint32_t bytes;
+        ZX_ASSERT(channel2.read(0, buffer.get(), size, &bytes, nullptr, 0,
+                                nullptr) == ZX_OK);
+        ZX_ASSERT(bytes == size);
+    }
+    return true;
+}
+
+// Measure the round trip time of zx_channel_call() with a message of |size|
+// bytes to an echo server running in another thread, or in another process
+// if |cross_process| is true.
+bool ChannelCallTest(perftest::RepeatState* state, uint32_t size,
+                     bool cross_process) {
+    state->SetBytesProcessedPerRun(size);
+
+    zx::channel channel;
+    zx::channel server;
+    ZX_ASSERT(zx::channel::create(0, &channel, &server) == ZX_OK);
+    zx::process process;
+    thrd_t thread;
+    if (cross_process) {
+        process = LaunchSubprocess(kEchoSubprocess, fbl::move(server));
+    } else {
+        ZX_ASSERT(thrd_create(&thread, ChannelEchoThread,
+                              reinterpret_cast<void*>(server.release())) ==
+                  thrd_success);
+    }
+
+    // zx_channel_call() needs room for the transaction id.
+    ZX_ASSERT(size >= sizeof(zx_txid_t));
+    fbl::unique_ptr<char[]> request(new char[size]);
+    fbl::unique_ptr<char[]> reply(new char[size]);
+    memset(request.get(), 0, size);
+    zx_channel_call_args_t args = {
+        .wr_bytes = request.get(),
+        .wr_handles = nullptr,
+        .rd_bytes = reply.get(),
+        .rd_handles = nullptr,
+        .wr_num_bytes = size,
+        .wr_num_handles = 0,
+        .rd_num_bytes = size,
+        .rd_num_handles = 0,
+    };
+
+    while (state->KeepRunning()) {
+        uint32_t bytes;
+        uint32_t handles;
+        ZX_ASSERT(channel.call(0, zx::time::infinite(), &args, &bytes,
+                               &handles) == ZX_OK);
+        ZX_ASSERT(bytes == size);
+    }
+
+    channel.reset();
+    if (cross_process) {
+        WaitForSubprocess(process);
+    } else {
+        ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    RegisterSubprocess(kEchoSubprocess, ChannelEcho);
+
+    static const uint32_t kSizesBytes[] = {
+        64,
+        1024,
+        32768,
+        65536,
+    };
+    for (auto size : kSizesBytes) {
+        auto name = fbl::StringPrintf("Channel/WriteRead/%ubytes", size);
+        perftest::RegisterTest(name.c_str(), ChannelWriteReadTest, size);
+    }
+    for (auto size : kSizesBytes) {
+        auto name = fbl::StringPrintf("Channel/Call/CrossThread/%ubytes", size);
+        perftest::RegisterTest(name.c_str(), ChannelCallTest, size, false);
+        name = fbl::StringPrintf("Channel/Call/CrossProcess/%ubytes", size);
+        perftest::RegisterTest(name.c_str(), ChannelCallTest, size, true);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
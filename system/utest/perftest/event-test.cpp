@@ -0,0 +1,189 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <fbl/atomic.h>
+#include <fbl/string_printf.h>
+#include <fbl/vector.h>
+#include <lib/zx/event.h>
+#include <lib/zx/eventpair.h>
+#include <lib/zx/process.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+
+#include "subprocess.h"
+
+namespace {
+
+constexpr char kPongSubprocess[] = "eventpair-pong";
+
+// Background threads that toggle a user signal on |object| until told to
+// stop, to contend with the thread being measured.
+template <typename Object>
+class SignalContenders {
+public:
+    SignalContenders(const Object* object, uint32_t count) : object_(object) {
+        for (uint32_t i = 0; i < count; ++i) {
+            thrd_t thread;
+            ZX_ASSERT(thrd_create(&thread, ThreadFunc, this) == thrd_success);
+            threads_.push_back(thread);
+        }
+        // Wait for every contender to be running so that the first
+        // iterations of the measured loop are contended too.
+        while (started_.load() != count) {
+            thrd_yield();
+        }
+    }
+
+    ~SignalContenders() {
+        stop_.store(true);
+        for (auto& thread : threads_) {
+            ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+        }
+    }
+
+private:
+    static int ThreadFunc(void* arg) {
+        auto* self = static_cast<SignalContenders*>(arg);
+        self->started_.fetch_add(1);
+        while (!self->stop_.load(fbl::memory_order_relaxed)) {
+            ZX_ASSERT(self->object_->signal(0, ZX_USER_SIGNAL_1) == ZX_OK);
+            ZX_ASSERT(self->object_->signal(ZX_USER_SIGNAL_1, 0) == ZX_OK);
+        }
+        return 0;
+    }
+
+    const Object* object_;
+    fbl::Vector<thrd_t> threads_;
+    fbl::atomic<uint32_t> started_{0};
+    fbl::atomic<bool> stop_{false};
+};
+
+// Measure the times taken to set and then clear a signal on an event that
+// has no waiters, while |contenders| other threads signal the same event.
+bool EventSignalTest(perftest::RepeatState* state, uint32_t contenders) {
+    state->DeclareStep("set");
+    state->DeclareStep("clear");
+
+    zx::event event;
+    ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+    SignalContenders<zx::event> background(&event, contenders);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(event.signal(0, ZX_USER_SIGNAL_0) == ZX_OK);
+        state->NextStep();
+        ZX_ASSERT(event.signal(ZX_USER_SIGNAL_0, 0) == ZX_OK);
+    }
+    return true;
+}
+
+// As above, but for one endpoint of an eventpair signalling itself.
+bool EventPairSignalTest(perftest::RepeatState* state, uint32_t contenders) {
+    state->DeclareStep("set");
+    state->DeclareStep("clear");
+
+    zx::eventpair event1;
+    zx::eventpair event2;
+    ZX_ASSERT(zx::eventpair::create(0, &event1, &event2) == ZX_OK);
+    SignalContenders<zx::eventpair> background(&event1, contenders);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(event1.signal(0, ZX_USER_SIGNAL_0) == ZX_OK);
+        state->NextStep();
+        ZX_ASSERT(event1.signal(ZX_USER_SIGNAL_0, 0) == ZX_OK);
+    }
+    return true;
+}
+
+// Waits for the peer to signal |event|, then clears the signal and signals
+// the peer in reply, until the peer is closed.
+void EventPairPong(const zx::eventpair& event) {
+    for (;;) {
+        zx_signals_t observed;
+        ZX_ASSERT(event.wait_one(ZX_USER_SIGNAL_0 | ZX_EVENTPAIR_PEER_CLOSED,
+                                 zx::time::infinite(), &observed) == ZX_OK);
+        if (observed & ZX_EVENTPAIR_PEER_CLOSED) {
+            return;
+        }
+        ZX_ASSERT(event.signal(ZX_USER_SIGNAL_0, 0) == ZX_OK);
+        ZX_ASSERT(event.signal_peer(0, ZX_USER_SIGNAL_0) == ZX_OK);
+    }
+}
+
+int EventPairPongThread(void* arg) {
+    EventPairPong(*static_cast<zx::eventpair*>(arg));
+    return 0;
+}
+
+// The subprocess side of a cross-process handoff: the eventpair arrives
+// as the handle of the first message on |channel|.
+void EventPairPongSubprocess(zx::channel channel) {
+    ZX_ASSERT(channel.wait_one(ZX_CHANNEL_READABLE, zx::time::infinite(),
+                               nullptr) == ZX_OK);
+    zx_handle_t handle;
+    uint32_t bytes;
+    uint32_t handles;
+    ZX_ASSERT(channel.read(0, nullptr, 0, &bytes, &handle, 1,
+                           &handles) == ZX_OK);
+    ZX_ASSERT(handles == 1);
+    EventPairPong(zx::eventpair(handle));
+}
+
+// Measure the round trip time of signalling a thread that is waiting on an
+// eventpair, in another thread or process, and waiting for it to signal
+// back.
+bool EventPairHandoffTest(perftest::RepeatState* state, bool cross_process) {
+    zx::eventpair event;
+    zx::eventpair remote;
+    ZX_ASSERT(zx::eventpair::create(0, &event, &remote) == ZX_OK);
+
+    zx::process process;
+    thrd_t thread;
+    if (cross_process) {
+        zx::channel channel;
+        zx::channel channel_remote;
+        ZX_ASSERT(zx::channel::create(0, &channel, &channel_remote) == ZX_OK);
+        process = LaunchSubprocess(kPongSubprocess, fbl::move(channel_remote));
+        zx_handle_t handle = remote.release();
+        ZX_ASSERT(channel.write(0, nullptr, 0, &handle, 1) == ZX_OK);
+    } else {
+        ZX_ASSERT(thrd_create(&thread, EventPairPongThread, &remote) ==
+                  thrd_success);
+    }
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(event.signal_peer(0, ZX_USER_SIGNAL_0) == ZX_OK);
+        ZX_ASSERT(event.wait_one(ZX_USER_SIGNAL_0, zx::time::infinite(),
+                                 nullptr) == ZX_OK);
+        ZX_ASSERT(event.signal(ZX_USER_SIGNAL_0, 0) == ZX_OK);
+    }
+
+    event.reset();
+    if (cross_process) {
+        WaitForSubprocess(process);
+    } else {
+        ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    RegisterSubprocess(kPongSubprocess, EventPairPongSubprocess);
+    perftest::RegisterTest("EventPair/Handoff/CrossThread",
+                           EventPairHandoffTest, false);
+    perftest::RegisterTest("EventPair/Handoff/CrossProcess",
+                           EventPairHandoffTest, true);
+
+    static const uint32_t kContenders[] = {0, 1, 3, 7};
+    for (uint32_t contenders : kContenders) {
+        auto name = fbl::StringPrintf("EventSignal/%ucontenders", contenders);
+        perftest::RegisterTest(name.c_str(), EventSignalTest, contenders);
+        name = fbl::StringPrintf("EventPairSignal/%ucontenders", contenders);
+        perftest::RegisterTest(name.c_str(), EventPairSignalTest, contenders);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
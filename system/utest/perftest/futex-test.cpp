@@ -0,0 +1,79 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+// Values of the futex that the two threads of a handoff take turns on.
+enum : zx_futex_t {
+    kMainTurn,
+    kPartnerTurn,
+    kStop,
+};
+
+zx_futex_t LoadTurn(const zx_futex_t* turn) {
+    return __atomic_load_n(turn, __ATOMIC_ACQUIRE);
+}
+
+// Hands the turn to the other thread and wakes it.
+void PassTurn(zx_futex_t* turn, zx_futex_t value) {
+    __atomic_store_n(turn, value, __ATOMIC_RELEASE);
+    ZX_ASSERT(zx_futex_wake(turn, 1) == ZX_OK);
+}
+
+// Blocks until |turn| no longer holds |value|.
+void WaitWhile(const zx_futex_t* turn, zx_futex_t value) {
+    while (LoadTurn(turn) == value) {
+        zx_status_t status = zx_futex_wait(turn, value, ZX_TIME_INFINITE);
+        ZX_ASSERT(status == ZX_OK || status == ZX_ERR_BAD_STATE);
+    }
+}
+
+int PartnerThread(void* arg) {
+    auto* turn = static_cast<zx_futex_t*>(arg);
+    for (;;) {
+        WaitWhile(turn, kMainTurn);
+        if (LoadTurn(turn) == kStop) {
+            return 0;
+        }
+        PassTurn(turn, kMainTurn);
+    }
+}
+
+// Measure the time taken by zx_futex_wake() when there is nothing to wake.
+bool FutexWakeNoWaitersTest() {
+    zx_futex_t futex = 0;
+    ZX_ASSERT(zx_futex_wake(&futex, 1) == ZX_OK);
+    return true;
+}
+
+// Measure the round trip time of waking a thread blocked on a futex and
+// blocking until it wakes this thread in turn.
+bool FutexHandoffTest(perftest::RepeatState* state) {
+    zx_futex_t turn = kMainTurn;
+    thrd_t thread;
+    ZX_ASSERT(thrd_create(&thread, PartnerThread, &turn) == thrd_success);
+
+    while (state->KeepRunning()) {
+        PassTurn(&turn, kPartnerTurn);
+        WaitWhile(&turn, kPartnerTurn);
+    }
+
+    PassTurn(&turn, kStop);
+    ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    return true;
+}
+
+void RegisterTests() {
+    perftest::RegisterSimpleTest<FutexWakeNoWaitersTest>("Futex/WakeNoWaiters");
+    perftest::RegisterTest("Futex/Handoff/CrossThread", FutexHandoffTest);
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
@@ -0,0 +1,65 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/string_printf.h>
+#include <lib/zx/event.h>
+#include <perftest/contenders.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+
+namespace {
+
+// Measure the times taken to duplicate a handle and to close the duplicate,
+// while |contenders| other threads of this process do the same with a
+// handle of their own, contending for the process's handle table.
+bool HandleDuplicateCloseTest(perftest::RepeatState* state,
+                              uint32_t contenders) {
+    state->DeclareStep("duplicate");
+    state->DeclareStep("close");
+
+    zx::event event;
+    ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+    zx::event other;
+    ZX_ASSERT(zx::event::create(0, &other) == ZX_OK);
+
+    perftest::Contenders background(contenders, [&other] {
+        zx::event dup;
+        ZX_ASSERT(other.duplicate(ZX_RIGHT_SAME_RIGHTS, &dup) == ZX_OK);
+    });
+
+    while (state->KeepRunning()) {
+        zx::event dup;
+        ZX_ASSERT(event.duplicate(ZX_RIGHT_SAME_RIGHTS, &dup) == ZX_OK);
+        state->NextStep();
+    }
+    return true;
+}
+
+// Measure the time taken to replace a handle with a new one to the same
+// object.
+bool HandleReplaceTest(perftest::RepeatState* state) {
+    zx::event event;
+    ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+    zx::event dup;
+    ZX_ASSERT(event.duplicate(ZX_RIGHT_SAME_RIGHTS, &dup) == ZX_OK);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(dup.replace(ZX_RIGHT_SAME_RIGHTS, &dup) == ZX_OK);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const uint32_t kContenders[] = {0, 1, 3};
+    for (uint32_t contenders : kContenders) {
+        auto name = fbl::StringPrintf("Handle/DuplicateClose/%ucontenders",
+                                      contenders);
+        perftest::RegisterTest(name.c_str(), HandleDuplicateCloseTest,
+                               contenders);
+    }
+    perftest::RegisterTest("Handle/Replace", HandleReplaceTest);
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
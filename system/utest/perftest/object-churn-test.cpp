@@ -0,0 +1,216 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/atomic.h>
+#include <fbl/string_printf.h>
+#include <fbl/vector.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/event.h>
+#include <lib/zx/eventpair.h>
+#include <lib/zx/fifo.h>
+#include <lib/zx/port.h>
+#include <lib/zx/socket.h>
+#include <lib/zx/timer.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls/port.h>
+
+namespace {
+
+// These tests measure the cost of creating and destroying kernel objects in
+// batches, the pattern that stresses the kernel's object allocator rather
+// than just the syscall path (which HandleCreate_* already covers).
+//
+// Each iteration creates kBatchSize objects and then closes all of them.
+// Optionally, background threads churn the same object type at the same time
+// so that allocations on several CPUs contend with each other.
+
+constexpr size_t kBatchSize = 64;
+
+// The handles to a batch of objects.  Each Create*() function below fills in
+// a Batch with kBatchSize objects (plus their peers), and Close() destroys
+// them.
+class Batch {
+public:
+    void push_back(zx::handle handle) {
+        ZX_ASSERT(count_ < fbl::count_of(handles_));
+        handles_[count_++] = fbl::move(handle);
+    }
+
+    void Close() {
+        for (size_t i = 0; i < count_; ++i) {
+            handles_[i].reset();
+        }
+        count_ = 0;
+    }
+
+private:
+    zx::handle handles_[kBatchSize * 2 + 1];
+    size_t count_ = 0;
+};
+
+void CreateChannels(Batch* batch) {
+    for (size_t i = 0; i < kBatchSize; ++i) {
+        zx::channel handle1;
+        zx::channel handle2;
+        ZX_ASSERT(zx::channel::create(0, &handle1, &handle2) == ZX_OK);
+        batch->push_back(zx::handle(handle1.release()));
+        batch->push_back(zx::handle(handle2.release()));
+    }
+}
+
+void CreateEvents(Batch* batch) {
+    for (size_t i = 0; i < kBatchSize; ++i) {
+        zx::event handle;
+        ZX_ASSERT(zx::event::create(0, &handle) == ZX_OK);
+        batch->push_back(zx::handle(handle.release()));
+    }
+}
+
+void CreateEventPairs(Batch* batch) {
+    for (size_t i = 0; i < kBatchSize; ++i) {
+        zx::eventpair handle1;
+        zx::eventpair handle2;
+        ZX_ASSERT(zx::eventpair::create(0, &handle1, &handle2) == ZX_OK);
+        batch->push_back(zx::handle(handle1.release()));
+        batch->push_back(zx::handle(handle2.release()));
+    }
+}
+
+void CreateFifos(Batch* batch) {
+    for (size_t i = 0; i < kBatchSize; ++i) {
+        zx::fifo handle1;
+        zx::fifo handle2;
+        ZX_ASSERT(zx::fifo::create(2, 16, 0, &handle1, &handle2) == ZX_OK);
+        batch->push_back(zx::handle(handle1.release()));
+        batch->push_back(zx::handle(handle2.release()));
+    }
+}
+
+void CreatePorts(Batch* batch) {
+    for (size_t i = 0; i < kBatchSize; ++i) {
+        zx::port handle;
+        ZX_ASSERT(zx::port::create(0, &handle) == ZX_OK);
+        batch->push_back(zx::handle(handle.release()));
+    }
+}
+
+void CreateSockets(Batch* batch) {
+    for (size_t i = 0; i < kBatchSize; ++i) {
+        zx::socket handle1;
+        zx::socket handle2;
+        ZX_ASSERT(zx::socket::create(0, &handle1, &handle2) == ZX_OK);
+        batch->push_back(zx::handle(handle1.release()));
+        batch->push_back(zx::handle(handle2.release()));
+    }
+}
+
+void CreateTimers(Batch* batch) {
+    for (size_t i = 0; i < kBatchSize; ++i) {
+        zx::timer handle;
+        ZX_ASSERT(zx::timer::create(0, ZX_CLOCK_MONOTONIC, &handle) == ZX_OK);
+        batch->push_back(zx::handle(handle.release()));
+    }
+}
+
+// Creates port observers rather than handles: each event gets an async wait
+// registered on a port.  The observers are destroyed along with the events.
+void CreatePortObservers(Batch* batch) {
+    zx::port port;
+    ZX_ASSERT(zx::port::create(0, &port) == ZX_OK);
+    for (size_t i = 0; i < kBatchSize; ++i) {
+        zx::event event;
+        ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+        ZX_ASSERT(event.wait_async(port, i, ZX_USER_SIGNAL_0,
+                                   ZX_WAIT_ASYNC_ONCE) == ZX_OK);
+        batch->push_back(zx::handle(event.release()));
+    }
+    batch->push_back(zx::handle(port.release()));
+}
+
+using CreateFunc = void (*)(Batch* batch);
+
+// Background threads that run |create| in a loop until told to stop.
+class Churners {
+public:
+    Churners(CreateFunc create, uint32_t count) : create_(create) {
+        for (uint32_t i = 0; i < count; ++i) {
+            thrd_t thread;
+            ZX_ASSERT(thrd_create(&thread, ThreadFunc, this) == thrd_success);
+            threads_.push_back(thread);
+        }
+        while (started_.load() != count) {
+            thrd_yield();
+        }
+    }
+
+    ~Churners() {
+        stop_.store(true);
+        for (auto& thread : threads_) {
+            ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+        }
+    }
+
+private:
+    static int ThreadFunc(void* arg) {
+        auto* self = static_cast<Churners*>(arg);
+        self->started_.fetch_add(1);
+        Batch batch;
+        while (!self->stop_.load()) {
+            self->create_(&batch);
+            batch.Close();
+        }
+        return 0;
+    }
+
+    CreateFunc create_;
+    fbl::atomic<uint32_t> started_{0};
+    fbl::atomic<bool> stop_{false};
+    fbl::Vector<thrd_t> threads_;
+};
+
+bool ChurnTest(perftest::RepeatState* state, CreateFunc create,
+               uint32_t contenders) {
+    state->DeclareStep("create");
+    state->DeclareStep("close");
+
+    Churners churners(create, contenders);
+    Batch batch;
+    while (state->KeepRunning()) {
+        create(&batch);
+        state->NextStep();
+        batch.Close();
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const struct {
+        const char* name;
+        CreateFunc create;
+    } kTypes[] = {
+        {"Channel", CreateChannels},
+        {"Event", CreateEvents},
+        {"EventPair", CreateEventPairs},
+        {"Fifo", CreateFifos},
+        {"Port", CreatePorts},
+        {"PortObserver", CreatePortObservers},
+        {"Socket", CreateSockets},
+        {"Timer", CreateTimers},
+    };
+    for (const auto& type : kTypes) {
+        for (uint32_t contenders : {0, 3}) {
+            auto name = fbl::StringPrintf("ObjectChurn/%s/%zu/%uContenders",
+                                          type.name, kBatchSize, contenders);
+            perftest::RegisterTest(name.c_str(), ChurnTest, type.create,
+                                   contenders);
+        }
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
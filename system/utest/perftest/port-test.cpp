@@ -0,0 +1,136 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <lib/zx/channel.h>
+#include <lib/zx/port.h>
+#include <lib/zx/process.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls/port.h>
+
+#include "subprocess.h"
+
+namespace {
+
+constexpr char kPongSubprocess[] = "port-pong";
+
+// Packets with this key tell the other side of a handoff to exit.
+constexpr uint64_t kStopKey = 1;
+
+zx_port_packet_t UserPacket(uint64_t key) {
+    zx_port_packet_t packet = {};
+    packet.key = key;
+    packet.type = ZX_PKT_TYPE_USER;
+    return packet;
+}
+
+// Waits for a packet on |ping| and queues one on |pong| in reply, until
+// told to stop.
+void PortPong(const zx::port& ping, const zx::port& pong) {
+    for (;;) {
+        zx_port_packet_t packet;
+        ZX_ASSERT(ping.wait(zx::time::infinite(), &packet) == ZX_OK);
+        if (packet.key == kStopKey) {
+            return;
+        }
+        ZX_ASSERT(pong.queue(&packet) == ZX_OK);
+    }
+}
+
+struct PortPair {
+    zx::port ping;
+    zx::port pong;
+};
+
+int PortPongThread(void* arg) {
+    auto* ports = static_cast<PortPair*>(arg);
+    PortPong(ports->ping, ports->pong);
+    return 0;
+}
+
+// The subprocess side of a cross-process handoff: the two ports arrive as
+// the handles of the first message on |channel|.
+void PortPongSubprocess(zx::channel channel) {
+    ZX_ASSERT(channel.wait_one(ZX_CHANNEL_READABLE, zx::time::infinite(),
+                               nullptr) == ZX_OK);
+    zx_handle_t handles[2];
+    uint32_t bytes;
+    uint32_t num_handles;
+    ZX_ASSERT(channel.read(0, nullptr, 0, &bytes, handles, 2,
+                           &num_handles) == ZX_OK);
+    ZX_ASSERT(num_handles == 2);
+    PortPong(zx::port(handles[0]), zx::port(handles[1]));
+}
+
+// Measure the times taken to queue a user packet on a port and to then
+// dequeue it, in the same thread.
+bool PortQueueWaitTest(perftest::RepeatState* state) {
+    state->DeclareStep("queue");
+    state->DeclareStep("wait");
+
+    zx::port port;
+    ZX_ASSERT(zx::port::create(0, &port) == ZX_OK);
+    zx_port_packet_t packet = UserPacket(0);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(port.queue(&packet) == ZX_OK);
+        state->NextStep();
+        ZX_ASSERT(port.wait(zx::time::infinite(), &packet) == ZX_OK);
+    }
+    return true;
+}
+
+// Measure the round trip time of queueing a packet for a thread waiting on
+// a port, in another thread or process, and waiting for it to queue one
+// back on a second port.
+bool PortHandoffTest(perftest::RepeatState* state, bool cross_process) {
+    PortPair ports;
+    ZX_ASSERT(zx::port::create(0, &ports.ping) == ZX_OK);
+    ZX_ASSERT(zx::port::create(0, &ports.pong) == ZX_OK);
+    zx::port ping;
+    zx::port pong;
+    ZX_ASSERT(ports.ping.duplicate(ZX_RIGHT_SAME_RIGHTS, &ping) == ZX_OK);
+    ZX_ASSERT(ports.pong.duplicate(ZX_RIGHT_SAME_RIGHTS, &pong) == ZX_OK);
+
+    zx::process process;
+    thrd_t thread;
+    if (cross_process) {
+        zx::channel channel;
+        zx::channel remote;
+        ZX_ASSERT(zx::channel::create(0, &channel, &remote) == ZX_OK);
+        process = LaunchSubprocess(kPongSubprocess, fbl::move(remote));
+        zx_handle_t handles[] = {ports.ping.release(), ports.pong.release()};
+        ZX_ASSERT(channel.write(0, nullptr, 0, handles, 2) == ZX_OK);
+    } else {
+        ZX_ASSERT(thrd_create(&thread, PortPongThread, &ports) == thrd_success);
+    }
+
+    zx_port_packet_t packet = UserPacket(0);
+    while (state->KeepRunning()) {
+        ZX_ASSERT(ping.queue(&packet) == ZX_OK);
+        ZX_ASSERT(pong.wait(zx::time::infinite(), &packet) == ZX_OK);
+    }
+
+    packet = UserPacket(kStopKey);
+    ZX_ASSERT(ping.queue(&packet) == ZX_OK);
+    if (cross_process) {
+        WaitForSubprocess(process);
+    } else {
+        ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    RegisterSubprocess(kPongSubprocess, PortPongSubprocess);
+
+    perftest::RegisterTest("Port/QueueWait", PortQueueWaitTest);
+    perftest::RegisterTest("Port/Handoff/CrossThread", PortHandoffTest, false);
+    perftest::RegisterTest("Port/Handoff/CrossProcess", PortHandoffTest, true);
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
@@ -70,6 +70,49 @@ static bool TestSummaryStatistics() {
     END_TEST;
 }
 
+static bool TestConfidenceInterval() {
+    BEGIN_TEST;
+
+    perftest::ResultsSet results;
+    perftest::TestCaseResults* test_case =
+        results.AddTestCase("results_test", "ExampleNullSyscall", "nanoseconds");
+    test_case->AppendValue(100);
+    EXPECT_EQ(test_case->GetSummaryStatistics().ci95, 0);
+
+    // The sample standard deviation of {100, 102, 104, 106} is
+    // sqrt(20/3), and t(0.975, 3) is 3.182.
+    test_case->AppendValue(102);
+    test_case->AppendValue(104);
+    test_case->AppendValue(106);
+    double ci95 = test_case->GetSummaryStatistics().ci95;
+    EXPECT_GT(ci95, 4.10);
+    EXPECT_LT(ci95, 4.11);
+
+    END_TEST;
+}
+
+static bool TestRejectOutliers() {
+    BEGIN_TEST;
+
+    perftest::ResultsSet results;
+    perftest::TestCaseResults* test_case =
+        results.AddTestCase("results_test", "ExampleNullSyscall", "nanoseconds");
+    const double kValues[] = {10, 11, 1000, 12, 11, 10, 12, 1, 11};
+    for (double value : kValues) {
+        test_case->AppendValue(value);
+    }
+    EXPECT_EQ(test_case->RejectOutliers(), 2);
+    // The remaining values keep their order.
+    const double kExpected[] = {10, 11, 12, 11, 10, 12, 11};
+    ASSERT_EQ(test_case->values.size(), fbl::count_of(kExpected));
+    for (size_t i = 0; i < fbl::count_of(kExpected); ++i) {
+        EXPECT_EQ(test_case->values[i], kExpected[i]);
+    }
+    EXPECT_EQ(test_case->RejectOutliers(), 0);
+
+    END_TEST;
+}
+
 // Test escaping special characters in strings in JSON output.
 static bool TestJsonStringEscaping() {
     BEGIN_TEST;
@@ -89,5 +132,7 @@ static bool TestJsonStringEscaping() {
 BEGIN_TEST_CASE(perf_results_output_tests)
 RUN_TEST(TestJsonOutput)
 RUN_TEST(TestSummaryStatistics)
+RUN_TEST(TestConfidenceInterval)
+RUN_TEST(TestRejectOutliers)
 RUN_TEST(TestJsonStringEscaping)
 END_TEST_CASE(perf_results_output_tests)
@@ -9,17 +9,28 @@ MODULE := $(LOCAL_DIR)
 MODULE_TYPE := usertest
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/channel-test.cpp \
     $(LOCAL_DIR)/clock-test.cpp \
+    $(LOCAL_DIR)/event-test.cpp \
+    $(LOCAL_DIR)/futex-test.cpp \
     $(LOCAL_DIR)/handle-creation-test.cpp \
+    $(LOCAL_DIR)/handle-test.cpp \
     $(LOCAL_DIR)/malloc-test.cpp \
     $(LOCAL_DIR)/memcpy-test.cpp \
     $(LOCAL_DIR)/mutex-test.cpp \
     $(LOCAL_DIR)/null-test.cpp \
+    $(LOCAL_DIR)/object-churn-test.cpp \
+    $(LOCAL_DIR)/port-test.cpp \
     $(LOCAL_DIR)/process-test.cpp \
     $(LOCAL_DIR)/results-test.cpp \
     $(LOCAL_DIR)/runner-test.cpp \
     $(LOCAL_DIR)/sleep-test.cpp \
+    $(LOCAL_DIR)/socket-test.cpp \
+    $(LOCAL_DIR)/subprocess.cpp \
     $(LOCAL_DIR)/syscalls-test.cpp \
+    $(LOCAL_DIR)/thread-test.cpp \
+    $(LOCAL_DIR)/timer-test.cpp \
+    $(LOCAL_DIR)/vm-test.cpp \
 
 MODULE_NAME := perf-test
 
@@ -44,4 +55,7 @@ MODULE_LIBS := \
     system/ulib/unittest \
     system/ulib/zircon \
 
+MODULE_FIDL_LIBS := \
+    system/fidl/fuchsia-sysinfo \
+
 include make/module.mk
@@ -9,6 +9,8 @@
 
 #include <fbl/algorithm.h>
 
+#include "subprocess.h"
+
 // This is a helper for creating a FILE* that we can redirect output to, in
 // order to make the tests below less noisy.  We don't look at the output
 // that is sent to the stream.
@@ -312,11 +314,95 @@ static bool TestParsingCommandArgs() {
     perftest::internal::CommandArgs args;
     perftest::internal::ParseCommandArgs(
         fbl::count_of(argv), const_cast<char**>(argv), &args);
-    EXPECT_EQ(args.run_count, 123);
+    EXPECT_EQ(args.run_options.run_count, 123);
     EXPECT_STR_EQ(args.output_filename, "dest_file");
     EXPECT_STR_EQ(args.filter_regex, "some_regex");
     EXPECT_TRUE(args.enable_tracing);
     EXPECT_EQ(args.startup_delay_seconds, 456);
+    // Options that were not given keep their defaults.
+    EXPECT_EQ(args.run_options.warmup_count, 0);
+    EXPECT_EQ(args.run_options.target_seconds, 0);
+    EXPECT_FALSE(args.run_options.reject_outliers);
+    EXPECT_EQ(args.cpu, -1);
+
+    END_TEST;
+}
+
+static bool TestParsingStatisticsCommandArgs() {
+    BEGIN_TEST;
+
+    const char* argv[] = {"unused_argv0", "--warmup", "20",
+                          "--target-time=0.5", "--reject-outliers",
+                          "--cpu", "0"};
+    perftest::internal::CommandArgs args;
+    perftest::internal::ParseCommandArgs(
+        fbl::count_of(argv), const_cast<char**>(argv), &args);
+    EXPECT_EQ(args.run_options.warmup_count, 20);
+    EXPECT_EQ(args.run_options.target_seconds, 0.5);
+    EXPECT_TRUE(args.run_options.reject_outliers);
+    EXPECT_EQ(args.cpu, 0);
+
+    END_TEST;
+}
+
+static bool TestCalibrateRunCount() {
+    BEGIN_TEST;
+
+    using perftest::internal::CalibrateRunCount;
+    // 1ms per run for 2 seconds.
+    EXPECT_EQ(CalibrateRunCount(1e6, 2.0), 2000);
+    // Slow tests still get a minimum number of runs.
+    EXPECT_EQ(CalibrateRunCount(1e9, 1.0),
+              perftest::internal::kMinCalibratedRunCount);
+    // Fast tests are capped, including ones too fast to time.
+    EXPECT_EQ(CalibrateRunCount(1.0, 10.0),
+              perftest::internal::kMaxCalibratedRunCount);
+    EXPECT_EQ(CalibrateRunCount(0.0, 1.0),
+              perftest::internal::kMaxCalibratedRunCount);
+
+    END_TEST;
+}
+
+// Test that warm-up runs are done but not recorded, and that calibration
+// replaces the requested run count.
+static bool TestWarmupAndCalibration() {
+    BEGIN_TEST;
+
+    uint32_t total_runs = 0;
+    auto test_func = [&](perftest::RepeatState* state) {
+        while (state->KeepRunning()) {
+            ++total_runs;
+        }
+        return true;
+    };
+    perftest::internal::TestList test_list;
+    perftest::internal::NamedTest test{"example_test", test_func};
+    test_list.push_back(fbl::move(test));
+
+    perftest::internal::RunOptions options;
+    options.run_count = 7;
+    options.warmup_count = 3;
+    perftest::ResultsSet results;
+    DummyOutputStream out;
+    EXPECT_TRUE(perftest::internal::RunTests(
+                    "test-suite", &test_list, options, "", out.fp(),
+                    &results));
+    ASSERT_EQ(results.results()->size(), 1);
+    EXPECT_EQ((*results.results())[0].values.size(), 7);
+    EXPECT_EQ(total_runs, 10);
+
+    // The runs of an empty loop are fast, so calibrating to a millisecond
+    // should want more than the minimum.
+    options.target_seconds = 0.001;
+    perftest::ResultsSet calibrated;
+    EXPECT_TRUE(perftest::internal::RunTests(
+                    "test-suite", &test_list, options, "", out.fp(),
+                    &calibrated));
+    ASSERT_EQ(calibrated.results()->size(), 1);
+    size_t runs = (*calibrated.results())[0].values.size();
+    EXPECT_GE(runs, perftest::internal::kMinCalibratedRunCount);
+    EXPECT_LE(runs, perftest::internal::kMaxCalibratedRunCount);
+    EXPECT_NE(runs, 7);
 
     END_TEST;
 }
@@ -331,8 +417,14 @@ RUN_TEST(TestBadNextStepCalls)
 RUN_TEST(TestBytesProcessedParameter)
 RUN_TEST(TestBytesProcessedParameterMultistep)
 RUN_TEST(TestParsingCommandArgs)
+RUN_TEST(TestParsingStatisticsCommandArgs)
+RUN_TEST(TestCalibrateRunCount)
+RUN_TEST(TestWarmupAndCalibration)
 END_TEST_CASE(perftest_runner_test)
 
 int main(int argc, char** argv) {
+    if (RunSubprocessIfRequested(argc, argv)) {
+        return 0;
+    }
     return perftest::PerfTestMain(argc, argv, "fuchsia.zircon.perf_test");
 }
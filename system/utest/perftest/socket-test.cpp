@@ -0,0 +1,106 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/algorithm.h>
+#include <fbl/string_printf.h>
+#include <fbl/unique_ptr.h>
+#include <lib/zx/socket.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls/object.h>
+
+namespace {
+
+// Creates a stream socket pair whose buffer in the endpoint0 -> endpoint1
+// direction can hold at least |size| bytes.  Buffers larger than the default
+// take the root resource, which perftests are not given, so |size| must fit
+// in the default buffer.
+void CreateSocket(size_t size, zx::socket* endpoint0, zx::socket* endpoint1) {
+    ZX_ASSERT(zx::socket::create(0, endpoint0, endpoint1) == ZX_OK);
+    size_t max = 0;
+    ZX_ASSERT(endpoint1->get_property(ZX_PROP_SOCKET_RX_BUF_MAX, &max,
+                                      sizeof(max)) == ZX_OK);
+    ZX_ASSERT(max >= size);
+}
+
+// Measure the times taken to write and then read back a block of |size|
+// bytes through a stream socket, in the same thread.
+bool SocketWriteReadTest(perftest::RepeatState* state, size_t size) {
+    state->DeclareStep("write");
+    state->DeclareStep("read");
+    state->SetBytesProcessedPerRun(size);
+
+    zx::socket socket1;
+    zx::socket socket2;
+    CreateSocket(size, &socket1, &socket2);
+    fbl::unique_ptr<char[]> buffer(new char[size]);
+    memset(buffer.get(), 0, size);
+
+    while (state->KeepRunning()) {
+        size_t actual;
+        ZX_ASSERT(socket1.write(0, buffer.get(), size, &actual) == ZX_OK);
+        ZX_ASSERT(actual == size);
+        state->NextStep();
+        ZX_ASSERT(socket2.read(0, buffer.get(), size, &actual) == ZX_OK);
+        ZX_ASSERT(actual == size);
+    }
+    return true;
+}
+
+// As SocketWriteReadTest, but the block is split into |count| equal pieces
+// that are gathered and scattered with zx_socket_writev() and
+// zx_socket_readv().
+bool SocketWritevReadvTest(perftest::RepeatState* state, size_t size,
+                           size_t count) {
+    state->DeclareStep("writev");
+    state->DeclareStep("readv");
+    state->SetBytesProcessedPerRun(size);
+
+    zx::socket socket1;
+    zx::socket socket2;
+    CreateSocket(size, &socket1, &socket2);
+    fbl::unique_ptr<char[]> buffer(new char[size]);
+    memset(buffer.get(), 0, size);
+
+    zx_iovec_t vec[ZX_SOCKET_IOVEC_MAX];
+    ZX_ASSERT(count <= fbl::count_of(vec));
+    const size_t piece = size / count;
+    for (size_t i = 0; i < count; ++i) {
+        vec[i].buffer = buffer.get() + i * piece;
+        vec[i].capacity = (i == count - 1) ? size - i * piece : piece;
+    }
+
+    while (state->KeepRunning()) {
+        size_t actual;
+        ZX_ASSERT(socket1.writev(0, vec, count, &actual) == ZX_OK);
+        ZX_ASSERT(actual == size);
+        state->NextStep();
+        ZX_ASSERT(socket2.readv(0, vec, count, &actual) == ZX_OK);
+        ZX_ASSERT(actual == size);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const size_t kSizesBytes[] = {
+        64,
+        1024,
+        4096,
+        16384,
+        65536,
+        131072,
+    };
+    for (auto size : kSizesBytes) {
+        auto name = fbl::StringPrintf("Socket/WriteRead/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), SocketWriteReadTest, size);
+    }
+    for (auto size : kSizesBytes) {
+        auto name = fbl::StringPrintf("Socket/WritevReadv/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), SocketWritevReadvTest, size,
+                               static_cast<size_t>(4));
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
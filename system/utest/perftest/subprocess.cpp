@@ -0,0 +1,78 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "subprocess.h"
+
+#include <fbl/algorithm.h>
+#include <fbl/type_support.h>
+#include <lib/fdio/spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <zircon/assert.h>
+#include <zircon/processargs.h>
+
+namespace {
+
+constexpr char kSubprocessOption[] = "--subprocess";
+constexpr size_t kMaxSubprocesses = 16;
+
+struct Subprocess {
+    const char* name;
+    SubprocessFunc* func;
+};
+
+// These need to be POD because they are populated by constructors, like
+// the list of tests in the perftest runner.
+Subprocess g_subprocesses[kMaxSubprocesses];
+size_t g_subprocess_count;
+const char* g_program_path;
+
+} // namespace
+
+void RegisterSubprocess(const char* name, SubprocessFunc* func) {
+    ZX_ASSERT(g_subprocess_count < kMaxSubprocesses);
+    g_subprocesses[g_subprocess_count++] = Subprocess{name, func};
+}
+
+zx::process LaunchSubprocess(const char* name, zx::channel channel) {
+    ZX_ASSERT(g_program_path != nullptr);
+    const char* argv[] = {g_program_path, kSubprocessOption, name, nullptr};
+    fdio_spawn_action_t actions[] = {
+        {.action = FDIO_SPAWN_ACTION_ADD_HANDLE,
+         .h = {.id = PA_HND(PA_USER0, 0), .handle = channel.release()}},
+    };
+    zx::process process;
+    char err_msg[FDIO_SPAWN_ERR_MSG_MAX_LENGTH];
+    zx_status_t status = fdio_spawn_etc(
+        ZX_HANDLE_INVALID, FDIO_SPAWN_CLONE_ALL, g_program_path, argv, nullptr,
+        fbl::count_of(actions), actions, process.reset_and_get_address(),
+        err_msg);
+    if (status != ZX_OK) {
+        fprintf(stderr, "Cannot launch subprocess %s: %d (%s)\n", name,
+                status, err_msg);
+    }
+    ZX_ASSERT(status == ZX_OK);
+    return process;
+}
+
+void WaitForSubprocess(const zx::process& process) {
+    ZX_ASSERT(process.wait_one(ZX_PROCESS_TERMINATED, zx::time::infinite(),
+                               nullptr) == ZX_OK);
+}
+
+bool RunSubprocessIfRequested(int argc, char** argv) {
+    g_program_path = argv[0];
+    if (argc != 3 || strcmp(argv[1], kSubprocessOption) != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < g_subprocess_count; ++i) {
+        if (strcmp(argv[2], g_subprocesses[i].name) == 0) {
+            zx::channel channel(zx_take_startup_handle(PA_HND(PA_USER0, 0)));
+            ZX_ASSERT(channel.is_valid());
+            g_subprocesses[i].func(fbl::move(channel));
+            return true;
+        }
+    }
+    ZX_PANIC("Unknown subprocess: %s\n", argv[2]);
+}
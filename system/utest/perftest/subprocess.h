@@ -0,0 +1,30 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <lib/zx/channel.h>
+#include <lib/zx/process.h>
+
+// Support for tests that measure IPC with another process.  The test binary
+// launches a copy of itself with "--subprocess NAME" and a channel to the
+// parent; the copy runs the function registered as NAME and exits.
+
+typedef void SubprocessFunc(zx::channel channel);
+
+// Registers |func| to run in subprocesses launched with |name|.  This is
+// meant to be called from PERFTEST_CTOR functions.
+void RegisterSubprocess(const char* name, SubprocessFunc* func);
+
+// Launches a subprocess running the function registered as |name|, and
+// passes it |channel|.
+zx::process LaunchSubprocess(const char* name, zx::channel channel);
+
+// Waits for |process| to exit, which a subprocess is expected to do once
+// the peer of its channel is closed.
+void WaitForSubprocess(const zx::process& process);
+
+// To be called first thing in main().  If this process was launched as a
+// subprocess, runs its function and returns true.
+bool RunSubprocessIfRequested(int argc, char** argv);
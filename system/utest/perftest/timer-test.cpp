@@ -0,0 +1,101 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <lib/zx/event.h>
+#include <lib/zx/timer.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+
+namespace {
+
+// Measure the times taken to arm a timer and to cancel it before it fires.
+bool TimerSetCancelTest(perftest::RepeatState* state) {
+    state->DeclareStep("set");
+    state->DeclareStep("cancel");
+
+    zx::timer timer;
+    ZX_ASSERT(zx::timer::create(0, ZX_CLOCK_MONOTONIC, &timer) == ZX_OK);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(timer.set(zx::deadline_after(zx::sec(60)), zx::nsec(0)) ==
+                  ZX_OK);
+        state->NextStep();
+        ZX_ASSERT(timer.cancel() == ZX_OK);
+    }
+    return true;
+}
+
+// Measure the time taken to arm a timer with a deadline that has already
+// passed and to wait for it to fire, in the same thread.
+bool TimerFireTest(perftest::RepeatState* state) {
+    state->DeclareStep("set");
+    state->DeclareStep("wait");
+
+    zx::timer timer;
+    ZX_ASSERT(zx::timer::create(0, ZX_CLOCK_MONOTONIC, &timer) == ZX_OK);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(timer.set(zx::time(0), zx::nsec(0)) == ZX_OK);
+        state->NextStep();
+        ZX_ASSERT(timer.wait_one(ZX_TIMER_SIGNALED, zx::time::infinite(),
+                                 nullptr) == ZX_OK);
+    }
+    return true;
+}
+
+struct TimerWaiter {
+    zx::timer timer;
+    zx::event done;
+};
+
+// Waits for the timer to fire, disarms it and reports back through
+// |done|, until ZX_USER_SIGNAL_0 is raised on the timer.
+int TimerWaiterThread(void* arg) {
+    auto* waiter = static_cast<TimerWaiter*>(arg);
+    for (;;) {
+        zx_signals_t observed;
+        ZX_ASSERT(waiter->timer.wait_one(ZX_TIMER_SIGNALED | ZX_USER_SIGNAL_0,
+                                         zx::time::infinite(),
+                                         &observed) == ZX_OK);
+        if (observed & ZX_USER_SIGNAL_0) {
+            return 0;
+        }
+        ZX_ASSERT(waiter->timer.cancel() == ZX_OK);
+        ZX_ASSERT(waiter->done.signal(0, ZX_USER_SIGNAL_0) == ZX_OK);
+    }
+}
+
+// Measure the round trip time of arming a timer, with a deadline that has
+// already passed, that another thread is waiting on, and of that thread
+// reporting back through an event.
+bool TimerFireCrossThreadTest(perftest::RepeatState* state) {
+    TimerWaiter waiter;
+    ZX_ASSERT(zx::timer::create(0, ZX_CLOCK_MONOTONIC, &waiter.timer) == ZX_OK);
+    ZX_ASSERT(zx::event::create(0, &waiter.done) == ZX_OK);
+    thrd_t thread;
+    ZX_ASSERT(thrd_create(&thread, TimerWaiterThread, &waiter) == thrd_success);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(waiter.timer.set(zx::time(0), zx::nsec(0)) == ZX_OK);
+        ZX_ASSERT(waiter.done.wait_one(ZX_USER_SIGNAL_0, zx::time::infinite(),
+                                       nullptr) == ZX_OK);
+        ZX_ASSERT(waiter.done.signal(ZX_USER_SIGNAL_0, 0) == ZX_OK);
+    }
+
+    // Stop the waiter with a user signal on the timer.
+    ZX_ASSERT(waiter.timer.signal(0, ZX_USER_SIGNAL_0) == ZX_OK);
+    ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    return true;
+}
+
+void RegisterTests() {
+    perftest::RegisterTest("Timer/SetCancel", TimerSetCancelTest);
+    perftest::RegisterTest("Timer/Fire", TimerFireTest);
+    perftest::RegisterTest("Timer/Fire/CrossThread", TimerFireCrossThreadTest);
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
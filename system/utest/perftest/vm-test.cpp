@@ -0,0 +1,127 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/string_printf.h>
+#include <fbl/unique_ptr.h>
+#include <lib/zx/vmar.h>
+#include <lib/zx/vmo.h>
+#include <perftest/contenders.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+
+namespace {
+
+// Measure the times taken to write |size| bytes to a VMO and then to read
+// them back, while |contenders| other threads write to the same VMO.
+bool VmoWriteReadTest(perftest::RepeatState* state, size_t size,
+                      uint32_t contenders) {
+    state->DeclareStep("write");
+    state->DeclareStep("read");
+    state->SetBytesProcessedPerRun(size);
+
+    zx::vmo vmo;
+    ZX_ASSERT(zx::vmo::create(size, 0, &vmo) == ZX_OK);
+    fbl::unique_ptr<char[]> buffer(new char[size]);
+    memset(buffer.get(), 0, size);
+    // Commit the pages so that the first run doesn't measure faulting
+    // them in.
+    ZX_ASSERT(vmo.write(buffer.get(), 0, size) == ZX_OK);
+
+    perftest::Contenders background(contenders, [&vmo] {
+        char byte = 0;
+        ZX_ASSERT(vmo.write(&byte, 0, sizeof(byte)) == ZX_OK);
+    });
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(vmo.write(buffer.get(), 0, size) == ZX_OK);
+        state->NextStep();
+        ZX_ASSERT(vmo.read(buffer.get(), 0, size) == ZX_OK);
+    }
+    return true;
+}
+
+// Measure the times taken to make a copy-on-write clone of a committed VMO
+// of |size| bytes and to close it.
+bool VmoCloneTest(perftest::RepeatState* state, size_t size) {
+    state->DeclareStep("clone");
+    state->DeclareStep("close");
+
+    zx::vmo vmo;
+    ZX_ASSERT(zx::vmo::create(size, 0, &vmo) == ZX_OK);
+    ZX_ASSERT(vmo.op_range(ZX_VMO_OP_COMMIT, 0, size, nullptr, 0) == ZX_OK);
+
+    while (state->KeepRunning()) {
+        zx::vmo clone;
+        ZX_ASSERT(vmo.clone(ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, &clone) ==
+                  ZX_OK);
+        state->NextStep();
+    }
+    return true;
+}
+
+// Measure the times taken to map a committed VMO of |size| bytes into the
+// root VMAR and to unmap it, while |contenders| other threads map and unmap
+// a page of their own.  With |populate|, the mapping is created with
+// ZX_VM_MAP_RANGE, so the page tables are filled in up front.
+bool VmarMapUnmapTest(perftest::RepeatState* state, size_t size,
+                      bool populate, uint32_t contenders) {
+    state->DeclareStep("map");
+    state->DeclareStep("unmap");
+
+    zx::vmo vmo;
+    ZX_ASSERT(zx::vmo::create(size, 0, &vmo) == ZX_OK);
+    ZX_ASSERT(vmo.op_range(ZX_VMO_OP_COMMIT, 0, size, nullptr, 0) == ZX_OK);
+    const zx_vm_option_t options = ZX_VM_PERM_READ | ZX_VM_PERM_WRITE |
+                                   (populate ? ZX_VM_MAP_RANGE : 0);
+
+    perftest::Contenders background(contenders, [&vmo] {
+        uintptr_t addr;
+        ZX_ASSERT(zx::vmar::root_self()->map(0, vmo, 0, PAGE_SIZE,
+                                             ZX_VM_PERM_READ, &addr) == ZX_OK);
+        ZX_ASSERT(zx::vmar::root_self()->unmap(addr, PAGE_SIZE) == ZX_OK);
+    });
+
+    while (state->KeepRunning()) {
+        uintptr_t addr;
+        ZX_ASSERT(zx::vmar::root_self()->map(0, vmo, 0, size, options,
+                                             &addr) == ZX_OK);
+        state->NextStep();
+        ZX_ASSERT(zx::vmar::root_self()->unmap(addr, size) == ZX_OK);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const size_t kSizesBytes[] = {
+        4096,
+        65536,
+        1048576,
+    };
+    static const uint32_t kContenders[] = {0, 3};
+    for (auto size : kSizesBytes) {
+        for (auto contenders : kContenders) {
+            auto name = fbl::StringPrintf("Vmo/WriteRead/%zubytes/%ucontenders",
+                                          size, contenders);
+            perftest::RegisterTest(name.c_str(), VmoWriteReadTest, size,
+                                   contenders);
+        }
+        auto name = fbl::StringPrintf("Vmo/Clone/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), VmoCloneTest, size);
+    }
+    for (auto size : kSizesBytes) {
+        for (auto contenders : kContenders) {
+            auto name = fbl::StringPrintf("Vmar/MapUnmap/%zubytes/%ucontenders",
+                                          size, contenders);
+            perftest::RegisterTest(name.c_str(), VmarMapUnmapTest, size, false,
+                                   contenders);
+            name = fbl::StringPrintf("Vmar/MapRangeUnmap/%zubytes/%ucontenders",
+                                     size, contenders);
+            perftest::RegisterTest(name.c_str(), VmarMapUnmapTest, size, true,
+                                   contenders);
+        }
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
@@ -0,0 +1,179 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <trace-reader/ktrace_flow_stitcher.h>
+
+#include <stdint.h>
+
+#include <fbl/vector.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+struct Seen {
+    trace::EventType type;
+    trace_flow_id_t id;
+    uint64_t ts;
+};
+
+trace::KTraceFlowStitcher::RecordConsumer MakeRecordConsumer(fbl::Vector<Seen>* out) {
+    return [out](trace::Record record) {
+        const trace::Record::Event& event = record.GetEvent();
+        trace_flow_id_t id = 0;
+        switch (event.type()) {
+        case trace::EventType::kFlowBegin:
+            id = event.data.GetFlowBegin().id;
+            break;
+        case trace::EventType::kFlowStep:
+            id = event.data.GetFlowStep().id;
+            break;
+        case trace::EventType::kFlowEnd:
+            id = event.data.GetFlowEnd().id;
+            break;
+        default:
+            break;
+        }
+        out->push_back(Seen{event.type(), id, event.timestamp});
+    };
+}
+
+ktrace_rec_flow_t MakeRecord(uint32_t tag, uint64_t ts, zx_koid_t koid, uint32_t txid,
+                             uint64_t flow_id) {
+    ktrace_rec_flow_t rec = {};
+    rec.tag = tag;
+    rec.tid = 1;
+    rec.ts = ts;
+    rec.koid = koid;
+    rec.flow_id = flow_id;
+    rec.txid = txid;
+    return rec;
+}
+
+void Write(trace::KTraceFlowStitcher* stitcher, uint64_t ts, zx_koid_t koid, uint32_t txid,
+           uint64_t flow_id) {
+    ktrace_rec_flow_t rec = MakeRecord(TAG_CHANNEL_WRITE_FLOW, ts, koid, txid, flow_id);
+    stitcher->AddRecord(reinterpret_cast<const ktrace_header_t*>(&rec));
+}
+
+void Read(trace::KTraceFlowStitcher* stitcher, uint64_t ts, zx_koid_t koid, uint32_t txid,
+          uint64_t flow_id) {
+    ktrace_rec_flow_t rec = MakeRecord(TAG_CHANNEL_READ_FLOW, ts, koid, txid, flow_id);
+    stitcher->AddRecord(reinterpret_cast<const ktrace_header_t*>(&rec));
+}
+
+bool one_way_message_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<Seen> seen;
+    trace::KTraceFlowStitcher stitcher(MakeRecordConsumer(&seen));
+
+    // Other records are ignored.
+    ktrace_rec_32b_t other = {};
+    other.tag = TAG_CHANNEL_WRITE;
+    other.ts = 5;
+    stitcher.AddRecord(reinterpret_cast<const ktrace_header_t*>(&other));
+
+    Write(&stitcher, 10, 100, 0, 0x100000007);
+    Read(&stitcher, 20, 101, 0, 0x100000007);
+    ASSERT_EQ(2u, seen.size());
+    EXPECT_EQ(trace::EventType::kFlowBegin, seen[0].type);
+    EXPECT_EQ(0x100000007u, seen[0].id);
+    EXPECT_EQ(10u, seen[0].ts);
+    EXPECT_EQ(trace::EventType::kFlowEnd, seen[1].type);
+    EXPECT_EQ(0x100000007u, seen[1].id);
+    EXPECT_EQ(20u, seen[1].ts);
+    EXPECT_EQ(2u, stitcher.event_count());
+
+    END_TEST;
+}
+
+bool transaction_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<Seen> seen;
+    trace::KTraceFlowStitcher stitcher(MakeRecordConsumer(&seen));
+
+    // The client writes a request on endpoint 100, the server reads it and
+    // writes the reply on endpoint 101, and the client reads the reply.
+    Write(&stitcher, 10, 100, 0x80000001, 1);
+    Read(&stitcher, 20, 101, 0x80000001, 1);
+    // The request's read is held until the reply shows up.
+    ASSERT_EQ(1u, seen.size());
+    Write(&stitcher, 30, 101, 0x80000001, 2);
+    Read(&stitcher, 40, 100, 0x80000001, 2);
+
+    ASSERT_EQ(4u, seen.size());
+    EXPECT_EQ(trace::EventType::kFlowBegin, seen[0].type);
+    EXPECT_EQ(10u, seen[0].ts);
+    EXPECT_EQ(trace::EventType::kFlowStep, seen[1].type);
+    EXPECT_EQ(20u, seen[1].ts);
+    EXPECT_EQ(trace::EventType::kFlowStep, seen[2].type);
+    EXPECT_EQ(30u, seen[2].ts);
+    EXPECT_EQ(trace::EventType::kFlowEnd, seen[3].type);
+    EXPECT_EQ(40u, seen[3].ts);
+    for (const auto& event : seen) {
+        EXPECT_EQ(1u, event.id);
+    }
+
+    END_TEST;
+}
+
+bool unanswered_request_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<Seen> seen;
+    trace::KTraceFlowStitcher stitcher(MakeRecordConsumer(&seen));
+
+    Write(&stitcher, 10, 100, 5, 1);
+    Read(&stitcher, 20, 101, 5, 1);
+    // The same txid on the same endpoint ends the first request's flow.
+    Write(&stitcher, 30, 100, 5, 2);
+    Read(&stitcher, 40, 101, 5, 2);
+    ASSERT_EQ(3u, seen.size());
+    EXPECT_EQ(trace::EventType::kFlowEnd, seen[2].type);
+    EXPECT_EQ(1u, seen[2].id);
+    EXPECT_EQ(20u, seen[2].ts);
+
+    stitcher.Finish();
+    ASSERT_EQ(4u, seen.size());
+    EXPECT_EQ(trace::EventType::kFlowEnd, seen[3].type);
+    EXPECT_EQ(2u, seen[3].id);
+    EXPECT_EQ(40u, seen[3].ts);
+
+    END_TEST;
+}
+
+bool full_koid_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<Seen> seen;
+    trace::KTraceFlowStitcher stitcher(MakeRecordConsumer(&seen));
+
+    // Endpoints whose koids only differ above bit 31 are not confused.
+    Write(&stitcher, 10, 100, 5, 1);
+    Read(&stitcher, 20, 0x100000065, 5, 1);
+    Write(&stitcher, 30, 101, 5, 2);
+    ASSERT_EQ(2u, seen.size());
+    EXPECT_EQ(trace::EventType::kFlowBegin, seen[1].type);
+    EXPECT_EQ(2u, seen[1].id);
+
+    Write(&stitcher, 40, 0x100000065, 5, 3);
+    ASSERT_EQ(4u, seen.size());
+    EXPECT_EQ(trace::EventType::kFlowStep, seen[2].type);
+    EXPECT_EQ(1u, seen[2].id);
+    EXPECT_EQ(20u, seen[2].ts);
+    EXPECT_EQ(trace::EventType::kFlowStep, seen[3].type);
+    EXPECT_EQ(1u, seen[3].id);
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(ktrace_flow_stitcher_tests)
+RUN_TEST(one_way_message_test)
+RUN_TEST(transaction_test)
+RUN_TEST(unanswered_request_test)
+RUN_TEST(full_koid_test)
+END_TEST_CASE(ktrace_flow_stitcher_tests)
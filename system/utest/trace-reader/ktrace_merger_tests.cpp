@@ -0,0 +1,257 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <trace-reader/ktrace_merger.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fbl/vector.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+struct Seen {
+    uint32_t tag;
+    uint64_t ts;
+};
+
+trace::KTraceMerger::RecordConsumer MakeRecordConsumer(fbl::Vector<Seen>* out) {
+    return [out](const ktrace_header_t* record) {
+        out->push_back(Seen{record->tag, record->ts});
+    };
+}
+
+trace::KTraceMerger::ErrorHandler MakeErrorHandler(int* out_errors) {
+    return [out_errors](uint32_t cpu, const char* message) {
+        (*out_errors)++;
+    };
+}
+
+ktrace_rec_32b_t MakeRecord(uint32_t event, uint64_t ts) {
+    ktrace_rec_32b_t rec = {};
+    rec.tag = KTRACE_TAG_32B(event, KTRACE_GRP_SCHEDULER);
+    rec.ts = ts;
+    return rec;
+}
+
+// A name record as the kernel writes it: 12 byte header, name, padding.
+struct NameRecord {
+    uint32_t tag;
+    uint32_t id;
+    uint32_t arg;
+    char name[20];
+};
+
+NameRecord MakeName(uint32_t id, const char* name) {
+    NameRecord rec = {};
+    rec.tag = (TAG_THREAD_NAME & 0xFFFFFFF0) | (sizeof(NameRecord) >> 3);
+    rec.id = id;
+    strncpy(rec.name, name, sizeof(rec.name) - 1);
+    return rec;
+}
+
+bool merges_by_timestamp_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<Seen> seen;
+    int errors = 0;
+    trace::KTraceMerger merger(2, MakeRecordConsumer(&seen), MakeErrorHandler(&errors));
+
+    ktrace_rec_32b_t cpu0[] = {MakeRecord(1, 10), MakeRecord(2, 30), MakeRecord(3, 50)};
+    ktrace_rec_32b_t cpu1[] = {MakeRecord(4, 20), MakeRecord(5, 40), MakeRecord(6, 60)};
+    EXPECT_TRUE(merger.AddBytes(0, cpu0, sizeof(cpu0)));
+    EXPECT_TRUE(merger.AddBytes(1, cpu1, sizeof(cpu1)));
+    merger.Finish();
+
+    ASSERT_EQ(6u, seen.size());
+    for (size_t i = 0; i < seen.size(); i++) {
+        EXPECT_EQ((i + 1) * 10, seen[i].ts);
+    }
+    EXPECT_EQ(0, errors);
+    EXPECT_EQ(6u, merger.record_count());
+
+    END_TEST;
+}
+
+bool split_records_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<Seen> seen;
+    int errors = 0;
+    trace::KTraceMerger merger(1, MakeRecordConsumer(&seen), MakeErrorHandler(&errors));
+
+    ktrace_rec_32b_t recs[] = {MakeRecord(1, 1), MakeRecord(2, 2)};
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(recs);
+    EXPECT_TRUE(merger.AddBytes(0, bytes, 20));
+    merger.Finish();
+    EXPECT_EQ(0u, seen.size());
+
+    EXPECT_TRUE(merger.AddBytes(0, bytes + 20, sizeof(recs) - 20));
+    merger.Finish();
+    ASSERT_EQ(2u, seen.size());
+    EXPECT_EQ(1u, seen[0].ts);
+    EXPECT_EQ(2u, seen[1].ts);
+    EXPECT_EQ(0, errors);
+
+    END_TEST;
+}
+
+bool horizon_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<Seen> seen;
+    int errors = 0;
+    trace::KTraceMerger merger(2, MakeRecordConsumer(&seen), MakeErrorHandler(&errors));
+
+    ktrace_rec_32b_t cpu0[] = {MakeRecord(1, 10), MakeRecord(2, 30)};
+    EXPECT_TRUE(merger.AddBytes(0, cpu0, sizeof(cpu0)));
+    merger.Flush(20);
+    ASSERT_EQ(1u, seen.size());
+    EXPECT_EQ(10u, seen[0].ts);
+
+    // A late record from the other cpu still lands in order.
+    ktrace_rec_32b_t cpu1[] = {MakeRecord(3, 25)};
+    EXPECT_TRUE(merger.AddBytes(1, cpu1, sizeof(cpu1)));
+    merger.Finish();
+    ASSERT_EQ(3u, seen.size());
+    EXPECT_EQ(25u, seen[1].ts);
+    EXPECT_EQ(30u, seen[2].ts);
+
+    END_TEST;
+}
+
+bool names_pass_through_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<Seen> seen;
+    int errors = 0;
+    trace::KTraceMerger merger(2, MakeRecordConsumer(&seen), MakeErrorHandler(&errors));
+
+    EXPECT_TRUE(trace::KTraceMerger::IsNameRecord(TAG_THREAD_NAME));
+    EXPECT_TRUE(trace::KTraceMerger::IsNameRecord(TAG_PROBE_NAME));
+    EXPECT_FALSE(trace::KTraceMerger::IsNameRecord(TAG_VERSION));
+    EXPECT_FALSE(trace::KTraceMerger::IsNameRecord(TAG_CONTEXT_SWITCH));
+
+    // A name on cpu 1 is emitted before the (earlier) record on cpu 0 is
+    // merged, and before the record on cpu 1 that follows it.
+    ktrace_rec_32b_t cpu0[] = {MakeRecord(1, 10)};
+    struct {
+        NameRecord name;
+        ktrace_rec_32b_t rec;
+    } cpu1 = {MakeName(42, "worker"), MakeRecord(2, 20)};
+    EXPECT_TRUE(merger.AddBytes(0, cpu0, sizeof(cpu0)));
+    EXPECT_TRUE(merger.AddBytes(1, &cpu1, sizeof(cpu1)));
+    ASSERT_EQ(1u, seen.size());
+    EXPECT_TRUE(trace::KTraceMerger::IsNameRecord(seen[0].tag));
+
+    merger.Finish();
+    ASSERT_EQ(3u, seen.size());
+    EXPECT_EQ(10u, seen[1].ts);
+    EXPECT_EQ(20u, seen[2].ts);
+    EXPECT_EQ(0, errors);
+
+    END_TEST;
+}
+
+bool corrupt_stream_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<Seen> seen;
+    int errors = 0;
+    trace::KTraceMerger merger(1, MakeRecordConsumer(&seen), MakeErrorHandler(&errors));
+
+    uint64_t zero[4] = {};
+    EXPECT_FALSE(merger.AddBytes(0, zero, sizeof(zero)));
+    EXPECT_EQ(1, errors);
+
+    ktrace_rec_32b_t rec = MakeRecord(1, 1);
+    EXPECT_FALSE(merger.AddBytes(0, &rec, sizeof(rec)));
+    EXPECT_FALSE(merger.AddBytes(1, &rec, sizeof(rec)));
+    merger.Finish();
+    EXPECT_EQ(0u, seen.size());
+
+    END_TEST;
+}
+
+bool drain_wrapped_ring_test() {
+    BEGIN_TEST;
+
+    // Two cpus, each with a 128 byte ring (four 32 byte records).
+    constexpr size_t kRingSize = 128;
+    constexpr size_t kStride = sizeof(ktrace_cpu_header_t) + kRingSize;
+    constexpr size_t kOffset = sizeof(ktrace_buffer_header_t);
+    uint64_t storage[(kOffset + 2 * kStride) / sizeof(uint64_t)] = {};
+    uint8_t* base = reinterpret_cast<uint8_t*>(storage);
+
+    auto buffer = reinterpret_cast<ktrace_buffer_header_t*>(base);
+    buffer->magic = KTRACE_BUFFER_MAGIC;
+    buffer->version = KTRACE_VERSION;
+    buffer->num_cpus = 2;
+    buffer->mode = KTRACE_MODE_STREAMING;
+    buffer->cpu_offset = kOffset;
+    buffer->cpu_stride = kStride;
+
+    auto cpu = [&](uint32_t i) {
+        return reinterpret_cast<ktrace_cpu_header_t*>(base + kOffset + i * kStride);
+    };
+    auto ring = [&](uint32_t i) {
+        return reinterpret_cast<ktrace_rec_32b_t*>(cpu(i) + 1);
+    };
+    for (uint32_t i = 0; i < 2; i++) {
+        cpu(i)->cpu = i;
+        cpu(i)->size = kRingSize;
+    }
+    ktrace_cpu_control_t control[2] = {};
+
+    // cpu 0 has wrapped: records at ring slots 3, 0 (tail 96, head 160).
+    ring(0)[3] = MakeRecord(1, 10);
+    ring(0)[0] = MakeRecord(2, 30);
+    cpu(0)->tail = 96;
+    cpu(0)->head = 160;
+    control[0].tail = 96;
+    ring(1)[0] = MakeRecord(3, 20);
+    cpu(1)->head = 32;
+
+    fbl::Vector<Seen> seen;
+    int errors = 0;
+    trace::KTraceMerger merger(2, MakeRecordConsumer(&seen), MakeErrorHandler(&errors));
+
+    EXPECT_EQ(96, merger.Drain(buffer, control));
+    EXPECT_EQ(160u, control[0].tail);
+    EXPECT_EQ(32u, control[1].tail);
+    merger.Finish();
+    ASSERT_EQ(3u, seen.size());
+    EXPECT_EQ(10u, seen[0].ts);
+    EXPECT_EQ(20u, seen[1].ts);
+    EXPECT_EQ(30u, seen[2].ts);
+
+    // Nothing new to drain.
+    EXPECT_EQ(0, merger.Drain(buffer, control));
+    EXPECT_EQ(0, errors);
+
+    // A tail outside the live records is reported and skipped to head.
+    control[1].tail = 1000;
+    EXPECT_EQ(0, merger.Drain(buffer, control));
+    EXPECT_EQ(1, errors);
+    EXPECT_EQ(32u, control[1].tail);
+
+    buffer->magic = 0;
+    EXPECT_EQ(-1, merger.Drain(buffer, control));
+    EXPECT_EQ(1, errors);
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(ktrace_merger_tests)
+RUN_TEST(merges_by_timestamp_test)
+RUN_TEST(split_records_test)
+RUN_TEST(horizon_test)
+RUN_TEST(names_pass_through_test)
+RUN_TEST(corrupt_stream_test)
+RUN_TEST(drain_wrapped_ring_test)
+END_TEST_CASE(ktrace_merger_tests)
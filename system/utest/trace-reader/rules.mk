@@ -5,6 +5,8 @@
 LOCAL_DIR := $(GET_LOCAL_DIR)
 
 reader_tests := \
+    $(LOCAL_DIR)/ktrace_flow_stitcher_tests.cpp \
+    $(LOCAL_DIR)/ktrace_merger_tests.cpp \
     $(LOCAL_DIR)/main.c \
     $(LOCAL_DIR)/reader_tests.cpp \
     $(LOCAL_DIR)/records_tests.cpp
@@ -53,6 +55,7 @@ MODULE_HOST_LIBS := \
 MODULE_COMPILEFLAGS := \
     -Isystem/ulib/trace-engine/include \
     -Isystem/ulib/trace-reader/include \
+    -Isystem/ulib/zircon-internal/include \
     -Isystem/ulib/fbl/include \
     -Isystem/ulib/unittest/include \
 
@@ -676,6 +676,102 @@ bool TestShutdownWhenFull() {
     END_TRACE_TEST;
 }
 
+bool TestThreadChunkSize() {
+    BEGIN_TRACE_TEST;
+
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              trace_engine_set_thread_chunk_size(TRACE_ENGINE_MIN_THREAD_CHUNK_SIZE - 8));
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              trace_engine_set_thread_chunk_size(TRACE_ENCODED_RECORD_MAX_LENGTH + 8));
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              trace_engine_set_thread_chunk_size(TRACE_ENGINE_MIN_THREAD_CHUNK_SIZE + 4));
+    EXPECT_EQ(ZX_OK, trace_engine_set_thread_chunk_size(TRACE_ENCODED_RECORD_MAX_LENGTH));
+
+    fixture_start_tracing();
+    EXPECT_EQ(ZX_ERR_BAD_STATE, trace_engine_set_thread_chunk_size(0u));
+    fixture_stop_tracing();
+
+    EXPECT_EQ(ZX_OK, trace_engine_set_thread_chunk_size(0u));
+
+    END_TRACE_TEST;
+}
+
+bool TestThreadChunks() {
+    BEGIN_TRACE_TEST;
+
+    ASSERT_EQ(ZX_OK, trace_engine_set_thread_chunk_size(TRACE_ENGINE_MIN_THREAD_CHUNK_SIZE));
+    fixture_start_tracing();
+
+    // Each thread writes to its own chunk, so the second record written by
+    // this thread lands ahead of the record written by the other thread.
+    TRACE_INSTANT("+enabled", "name", TRACE_SCOPE_GLOBAL, "k1", TA_INT32(1));
+    RunThread([] {
+        TRACE_INSTANT("+enabled", "name", TRACE_SCOPE_GLOBAL, "k2", TA_INT32(2));
+    });
+    TRACE_INSTANT("+enabled", "name", TRACE_SCOPE_GLOBAL, "k3", TA_INT32(3));
+
+    ASSERT_RECORDS(R"X(String(index: 1, "+enabled")
+String(index: 2, "k1")
+String(index: 3, "process")
+KernelObject(koid: <>, type: thread, name: "initial-thread", {process: koid(<>)})
+Thread(index: 1, <>)
+String(index: 4, "name")
+Event(ts: <>, pt: <>, category: "+enabled", name: "name", Instant(scope: global), {k1: int32(1)})
+String(index: 9, "k3")
+Event(ts: <>, pt: <>, category: "+enabled", name: "name", Instant(scope: global), {k3: int32(3)})
+String(index: 5, "+enabled")
+String(index: 6, "k2")
+String(index: 7, "process")
+KernelObject(koid: <>, type: thread, name: "thrd_t:<>/TLS=<>", {process: koid(<>)})
+Thread(index: 2, <>)
+String(index: 8, "name")
+Event(ts: <>, pt: <>, category: "+enabled", name: "name", Instant(scope: global), {k2: int32(2)})
+)X",
+                   "");
+
+    EXPECT_EQ(ZX_OK, trace_engine_set_thread_chunk_size(0u));
+
+    END_TRACE_TEST;
+}
+
+bool TestThreadChunksMultipleThreads() {
+    constexpr size_t kNumThreads = 4;
+    constexpr size_t kNumEvents = 1000;
+
+    BEGIN_TRACE_TEST;
+
+    ASSERT_EQ(ZX_OK, trace_engine_set_thread_chunk_size(TRACE_ENGINE_MIN_THREAD_CHUNK_SIZE));
+    fixture_start_tracing();
+
+    thrd_t threads[kNumThreads];
+    for (auto& thread : threads) {
+        int result = thrd_create(&thread, [](void*) {
+            for (size_t i = 0; i < kNumEvents; ++i) {
+                TRACE_INSTANT("+enabled", "name", TRACE_SCOPE_THREAD, "k1", TA_INT32(1));
+            }
+            return 0;
+        }, nullptr);
+        ASSERT_EQ(thrd_success, result);
+    }
+    for (auto& thread : threads) {
+        ASSERT_EQ(thrd_success, thrd_join(thread, nullptr));
+    }
+
+    // Every record must be intact, with padding between the chunks skipped.
+    fbl::Vector<trace::Record> records;
+    ASSERT_TRUE(fixture_compare_n_records(0u, "", &records));
+    size_t num_events = 0;
+    for (const auto& record : records) {
+        if (record.type() == trace::RecordType::kEvent)
+            ++num_events;
+    }
+    EXPECT_EQ(kNumThreads * kNumEvents, num_events);
+
+    EXPECT_EQ(ZX_OK, trace_engine_set_thread_chunk_size(0u));
+
+    END_TRACE_TEST;
+}
+
 // NOTE: The functions for writing trace records are exercised by other trace tests.
 
 } // namespace
@@ -698,4 +794,7 @@ RUN_TEST(TestEventWithInlineEverything)
 RUN_TEST(TestCircularMode)
 RUN_TEST(TestStreamingMode)
 RUN_TEST(TestShutdownWhenFull)
+RUN_TEST(TestThreadChunkSize)
+RUN_TEST(TestThreadChunks)
+RUN_TEST(TestThreadChunksMultipleThreads)
 END_TEST_CASE(engine_tests)